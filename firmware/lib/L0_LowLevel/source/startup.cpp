@@ -358,6 +358,9 @@ static void isr_forwarder_routine(void)
      */
     const unsigned char isr_num = (*((unsigned char*) 0xE000ED04)) - 16; // (SCB->ICSR & 0xFF) - 16;
     vTraceStoreISRBegin(isr_num);
+#if SYS_CFG_SCHED_TRACE
+    sched_trace_isr_enter(isr_num);
+#endif
 
     /* Lookup the function pointer we want to call and make the call */
     isr_func_t isr_to_service = g_isr_array[isr_num];
@@ -374,6 +377,9 @@ static void isr_forwarder_routine(void)
     {
         isr_to_service();
     }
+#if SYS_CFG_SCHED_TRACE
+    sched_trace_isr_exit(isr_num);
+#endif
     vTraceStoreISREnd(0);
 
     /* Inform FreeRTOS that we have exited the ISR */
@@ -97,11 +97,16 @@
  * 2 - Get from the pool defined by configTOTAL_HEAP_SIZE with free()
  * 3 - Just redirect FreeRTOS memory to malloc() and free()
  * 4 - Same as 2, but coalescencent blocks can be combined.
+ * 6 - TLSF allocator with O(1) malloc() and free() that replaces malloc() too, so FreeRTOS,
+ *     C and C++ share one heap with a region for each RAM bank.  Stacks go to SRAM first,
+ *     and DMA buffers only to SRAM_AHB (see heap_tlsf.c.inc and region_heap.h)
  *
  * configTOTAL_HEAP_SIZE only matters when scheme 1, 2 or 4 is used above.
+ * configTLSF_MAIN_STACK_SIZE is the stack left for the interrupts when scheme 6 is used.
  */
 #define configMEM_MANG_TYPE             3
 #define configTOTAL_HEAP_SIZE           ( ( size_t ) ( 24 * 1024 ) )
+#define configTLSF_MAIN_STACK_SIZE      ( 2 * 1024 )
 /** @} */
 
 /* Stack size and utility functions */
@@ -163,11 +168,21 @@
 	#define configPRIO_BITS       5        /* 32 priority levels */
 #endif
 
+/**
+ * BUILD_CFG_HOST_PORT is set by tools/HostPort to run the firmware on a Linux host using
+ * portable/posix instead of portable/no_mpu.  There are no interrupt priorities or fault
+ * registers there.
+ */
+#if BUILD_CFG_HOST_PORT
+#define configKERNEL_INTERRUPT_PRIORITY 	    0
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY 	0
+#else
 #include "lpc_isr.h"
 /* The lowest priority. */
 #define configKERNEL_INTERRUPT_PRIORITY 	    ( IP_KERNEL <<   (8 - configPRIO_BITS) )
 /* Priority 5, or 160 as only the top three bits are implemented. */
 #define configMAX_SYSCALL_INTERRUPT_PRIORITY 	( IP_SYSCALL <<  (8 - configPRIO_BITS) )
+#endif
 /* ARM Cortex M3 has hardware instruction to count leading zeroes */
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION    1
 
@@ -181,12 +196,43 @@
     *
     * Poor man's trace just records the last task that was running before a potential system crash ;(
     */
+    #if !BUILD_CFG_HOST_PORT
     #include "fault_registers.h"
-    #define traceTASK_SWITCHED_IN()                                                  \
+    #define traceLAST_RUNNING_TASK()                                                 \
                  do {                                                                \
                      uint32_t *pTaskName = (uint32_t*)(pxCurrentTCB->pcTaskName);    \
                      FAULT_LAST_RUNNING_TASK_NAME = *pTaskName;                      \
                  } while (0)
+    #else
+    #define traceLAST_RUNNING_TASK()
+    #endif
+
+    /*
+    * The scheduling trace (sched_trace.h) stores the trace id of each task in its task tag,
+    * and records the hooks below to a ring.  ISRs are recorded by isr_forwarder_routine().
+    */
+    #if SYS_CFG_SCHED_TRACE
+    #include "sched_trace.h"
+    #define configUSE_APPLICATION_TASK_TAG          1
+    #define SCHED_TRACE_TASK_ID(pxTCB)              ((uint8_t)(uintptr_t)(pxTCB)->pxTaskTag)
+
+    #define traceTASK_CREATE(pxNewTCB)                                                             \
+                (pxNewTCB)->pxTaskTag = (TaskHookFunction_t)(uintptr_t)sched_trace_add_task((pxNewTCB)->pcTaskName)
+    #define traceTASK_SWITCHED_IN()                                                  \
+                 do {                                                                \
+                     traceLAST_RUNNING_TASK();                                       \
+                     sched_trace_switch_in(SCHED_TRACE_TASK_ID(pxCurrentTCB));       \
+                 } while (0)
+    #define traceMOVED_TASK_TO_READY_STATE(pxTCB)   sched_trace_task_ready(SCHED_TRACE_TASK_ID(pxTCB))
+    #define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) sched_trace_block(sched_trace_ev_block_recv, (pxQueue))
+    #define traceBLOCKING_ON_QUEUE_SEND(pxQueue)    sched_trace_block(sched_trace_ev_block_send, (pxQueue))
+    #define traceTASK_DELAY()                       sched_trace_delay(xTicksToDelay)
+    #define traceTASK_DELAY_UNTIL(xTimeToWake)      sched_trace_delay((xTimeToWake) - xTickCount)
+    #define traceTASK_NOTIFY_TAKE_BLOCK()           sched_trace_record(sched_trace_ev_block_notify, 0, 0)
+    #define traceTASK_NOTIFY_WAIT_BLOCK()           sched_trace_record(sched_trace_ev_block_notify, 0, 0)
+    #else
+    #define traceTASK_SWITCHED_IN()                 traceLAST_RUNNING_TASK()
+    #endif
 
     #ifdef __cplusplus
     extern "C" {
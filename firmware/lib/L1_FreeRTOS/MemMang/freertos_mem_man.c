@@ -26,6 +26,8 @@
     #include "heap_4.c.inc"
 #elif 5 == configMEM_MANG_TYPE
     #include "heap_5.c.inc"
+#elif 6 == configMEM_MANG_TYPE
+    #include "heap_tlsf.c.inc"
 #else
     #error "configMEM_MANG_TYPE is not defined correctly"
 #endif
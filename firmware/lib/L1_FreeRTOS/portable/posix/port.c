@@ -0,0 +1,489 @@
+/*     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+
+/**
+ * @file
+ * @brief FreeRTOS port that runs the firmware as a Linux process, see portmacro.h
+ *
+ * Each task runs on its own host thread, but only the thread of pxCurrentTCB runs at
+ * any time and the others wait on their semaphore.  A context switch posts the
+ * semaphore of the next task and waits on its own one.  The FreeRTOS stack of a task
+ * only stores the pointer to its thread, and the thread uses the host stack.
+ *
+ * Interrupts are simulated by a host thread that raises the tick (and any interrupt of
+ * a peripheral stand-in) by sending SIGUSR1 to the running task.  The signal handler
+ * runs the interrupt handlers on the task's thread like a real interrupt, unless the
+ * interrupts are disabled, in which case they stay pending until they are enabled.
+ *
+ * A task that is interrupted in the middle of the C library (such as printf() or
+ * malloc()) may be holding a lock of the library, so it is only switched out by the
+ * signal handler if it was interrupted in the code of the executable.  Otherwise the
+ * switch is pended until the task leaves a critical section, makes a FreeRTOS call,
+ * or the next tick interrupts it in the executable.  For the same reason the
+ * executable must not be linked statically.
+ *
+ * This file is only compiled off-target (see tools/HostPort).
+ */
+#ifndef __arm__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* REG_RIP of ucontext_t */
+#endif
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+
+/// Host thread of a task
+typedef struct {
+    pthread_t thread;           ///< The host thread
+    sem_t wake;                 ///< Posted when the task is switched in
+    TaskFunction_t code;        ///< Task function
+    void *params;               ///< Parameter of the task function
+} port_thread_t;
+
+/** @{ State of the simulated CPU.  Only the running task changes these. */
+static volatile sig_atomic_t g_irq_masked = 1;      ///< Interrupts are disabled
+static volatile sig_atomic_t g_in_isr = 0;          ///< Interrupt handlers are running
+static volatile sig_atomic_t g_yield_pending = 0;   ///< Context switch is pended (PendSV)
+static UBaseType_t g_critical_nesting = 0;          ///< Nesting of critical sections
+/** @} */
+
+/** @{ Simulated interrupt controller; these are set by any thread */
+static volatile uint32_t g_pending_irqs = 0;        ///< Bit mask of the pending interrupts
+static volatile uint32_t g_pending_ticks = 0;       ///< Count of the pending ticks
+static void (*g_irq_handlers[portHOST_MAX_INTERRUPTS])(void);
+/** @} */
+
+static volatile sig_atomic_t g_scheduler_running = 0;
+static sem_t g_scheduler_end;                       ///< Posted by vPortEndScheduler()
+static pthread_t g_tick_thread;
+static uint32_t g_tick_period_us = 1000000UL / configTICK_RATE_HZ;
+static __thread port_thread_t *s_self = NULL;       ///< Thread of the task running on this host thread
+
+/* The running task, from tasks.c */
+extern void * volatile pxCurrentTCB;
+
+/* Code range of the executable, from the linker */
+extern char __executable_start[];
+extern char etext[];
+
+
+
+/// @returns the thread of the running task
+static inline port_thread_t *prvCurrentThread( void )
+{
+	/* The first member of the TCB is pxTopOfStack, where pxPortInitialiseStack()
+	stored the pointer to the thread. */
+	port_thread_t *pxThread;
+	const StackType_t *pxTopOfStack = *( StackType_t * volatile * ) pxCurrentTCB;
+	memcpy( &pxThread, pxTopOfStack, sizeof( pxThread ) );
+	return pxThread;
+}
+
+/// Waits until the thread is switched in
+static void prvWaitToRun( port_thread_t *pxThread )
+{
+	while( 0 != sem_wait( &pxThread->wake ) )
+	{
+		/* Interrupted by a signal that was not for the running task */
+	}
+}
+
+/// Switches to the task selected by the scheduler; interrupts must be disabled
+static void prvSwitchContext( void )
+{
+	port_thread_t *pxPrevious = prvCurrentThread();
+	port_thread_t *pxNext;
+
+	g_yield_pending = 0;
+	vTaskSwitchContext();
+	pxNext = prvCurrentThread();
+
+	if( pxNext != pxPrevious )
+	{
+		sem_post( &pxNext->wake );
+		prvWaitToRun( pxPrevious );
+	}
+}
+
+/**
+ * Runs the pending interrupts, and the pended context switch if xCanSwitch is set, then
+ * enables the interrupts.  This is called by the running task when the interrupts were
+ * enabled, or become enabled.
+ */
+static void prvServiceInterrupts( BaseType_t xCanSwitch )
+{
+	for( ;; )
+	{
+		uint32_t ulIrqs, ulTicks;
+		g_irq_masked = 1;
+
+		if( 0 != g_pending_irqs || 0 != g_pending_ticks )
+		{
+			g_in_isr = 1;
+			/* Ticks are counted such that they are not lost if the host is slow */
+			ulTicks = __atomic_exchange_n( &g_pending_ticks, 0, __ATOMIC_SEQ_CST );
+			while( ulTicks-- > 0 )
+			{
+				if( pdFALSE != xTaskIncrementTick() )
+				{
+					g_yield_pending = 1;
+				}
+			}
+			while( 0 != ( ulIrqs = __atomic_exchange_n( &g_pending_irqs, 0, __ATOMIC_SEQ_CST ) ) )
+			{
+				while( 0 != ulIrqs )
+				{
+					const uint32_t ulIrq = ( uint32_t ) __builtin_ctz( ulIrqs );
+					ulIrqs &= ~( 1UL << ulIrq );
+					if( NULL != g_irq_handlers[ ulIrq ] )
+					{
+						g_irq_handlers[ ulIrq ]();
+					}
+				}
+			}
+			g_in_isr = 0;
+			continue;
+		}
+
+		if( 0 != g_yield_pending && pdFALSE != xCanSwitch )
+		{
+			prvSwitchContext();
+			continue;
+		}
+
+		g_irq_masked = 0;
+
+		/* An interrupt that was raised while the interrupts were disabled was ignored
+		by the signal handler, so check again after they are enabled. */
+		if( 0 == g_pending_irqs && 0 == g_pending_ticks )
+		{
+			break;
+		}
+	}
+}
+
+/// @returns true if the program counter of the interrupted code is in the executable
+static BaseType_t prvInterruptedInExecutable( const void *pvContext )
+{
+	const ucontext_t *pxContext = ( const ucontext_t * ) pvContext;
+	const char *pcPC;
+
+	#if defined( __x86_64__ )
+		pcPC = ( const char * ) pxContext->uc_mcontext.gregs[ REG_RIP ];
+	#elif defined( __i386__ )
+		pcPC = ( const char * ) pxContext->uc_mcontext.gregs[ REG_EIP ];
+	#elif defined( __aarch64__ )
+		pcPC = ( const char * ) pxContext->uc_mcontext.pc;
+	#else
+		/* Only switch outside of the interrupts, which still works but a task that
+		never makes a FreeRTOS call is not preempted. */
+		( void ) pxContext;
+		return pdFALSE;
+	#endif
+
+	return ( pcPC >= __executable_start && pcPC < etext ) ? pdTRUE : pdFALSE;
+}
+
+/// The interrupt signal
+static void prvSignalHandler( int sig, siginfo_t *pxInfo, void *pvContext )
+{
+	const int iSavedErrno = errno;
+	( void ) sig;
+	( void ) pxInfo;
+
+	/* The signal may have been sent to a task that got switched out in the meantime, in
+	which case the next task services the interrupt after it is switched in. */
+	if( 0 != g_scheduler_running && 0 == g_irq_masked && NULL != s_self && s_self == prvCurrentThread() )
+	{
+		prvServiceInterrupts( prvInterruptedInExecutable( pvContext ) );
+	}
+
+	errno = iSavedErrno;
+}
+
+/// Interrupt signal mask of a host thread
+static void prvSetInterruptSignal( int iHow )
+{
+	sigset_t xSignals;
+	sigemptyset( &xSignals );
+	sigaddset( &xSignals, SIGUSR1 );
+	pthread_sigmask( iHow, &xSignals, NULL );
+}
+
+/// Host thread of a task
+static void *prvTaskThread( void *pvParameters )
+{
+	port_thread_t *pxThread = ( port_thread_t * ) pvParameters;
+	s_self = pxThread;
+	prvSetInterruptSignal( SIG_UNBLOCK );
+
+	/* The task that switched to us left the interrupts disabled */
+	prvWaitToRun( pxThread );
+	prvServiceInterrupts( pdTRUE );
+
+	pxThread->code( pxThread->params );
+
+	/* Tasks must not return, same as the other ports */
+	fprintf( stderr, "FreeRTOS task returned\n" );
+	abort();
+	return NULL;
+}
+
+/// Host thread that raises the tick interrupt
+static void *prvTickThread( void *pvParameters )
+{
+	struct timespec xNext;
+	( void ) pvParameters;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNext );
+	while( 0 != g_scheduler_running )
+	{
+		xNext.tv_nsec += ( long ) g_tick_period_us * 1000L;
+		while( xNext.tv_nsec >= 1000000000L )
+		{
+			xNext.tv_nsec -= 1000000000L;
+			xNext.tv_sec++;
+		}
+		while( EINTR == clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &xNext, NULL ) )
+		{
+		}
+
+		__atomic_add_fetch( &g_pending_ticks, 1, __ATOMIC_SEQ_CST );
+		vPortHostRaiseInterrupt( portHOST_TICK_INTERRUPT );
+	}
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+StackType_t *pxPortInitialiseStack( StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters )
+{
+	/* The thread is not freed if the task is deleted because a task that deletes
+	itself is still waiting on its semaphore. */
+	port_thread_t *pxThread = ( port_thread_t * ) calloc( 1, sizeof( port_thread_t ) );
+	pthread_attr_t xAttr;
+
+	configASSERT( NULL != pxThread );
+	pxThread->code = pxCode;
+	pxThread->params = pvParameters;
+	sem_init( &pxThread->wake, 0, 0 );
+
+	/* The new thread inherits our signal mask, so block the interrupts until it
+	unblocks them itself after it is set up. */
+	prvSetInterruptSignal( SIG_BLOCK );
+	pthread_attr_init( &xAttr );
+	pthread_attr_setdetachstate( &xAttr, PTHREAD_CREATE_DETACHED );
+	if( 0 != pthread_create( &pxThread->thread, &xAttr, prvTaskThread, pxThread ) )
+	{
+		perror( "pthread_create()" );
+		abort();
+	}
+	pthread_attr_destroy( &xAttr );
+	if( NULL != s_self )
+	{
+		prvSetInterruptSignal( SIG_UNBLOCK );
+	}
+
+	/* Store the pointer of the thread at the 8-byte aligned top of the stack */
+	pxTopOfStack -= 2;
+	memcpy( pxTopOfStack, &pxThread, sizeof( pxThread ) );
+	return pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortStartScheduler( void )
+{
+	struct sigaction xAction;
+	port_thread_t *pxFirst;
+
+	/* The main thread (and the tick thread it creates) never takes the interrupts */
+	prvSetInterruptSignal( SIG_BLOCK );
+
+	memset( &xAction, 0, sizeof( xAction ) );
+	xAction.sa_sigaction = prvSignalHandler;
+	xAction.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset( &xAction.sa_mask );
+	sigaction( SIGUSR1, &xAction, NULL );
+
+	sem_init( &g_scheduler_end, 0, 0 );
+	g_scheduler_running = 1;
+
+	if( 0 != pthread_create( &g_tick_thread, NULL, prvTickThread, NULL ) )
+	{
+		perror( "pthread_create()" );
+		return pdFALSE;
+	}
+
+	/* Interrupts are disabled by vTaskStartScheduler(), and the first task enables them */
+	pxFirst = prvCurrentThread();
+	sem_post( &pxFirst->wake );
+
+	while( 0 != sem_wait( &g_scheduler_end ) )
+	{
+	}
+	pthread_join( g_tick_thread, NULL );
+	return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+	port_thread_t *pxSelf = s_self;
+
+	/* The tasks stay blocked until the process exits */
+	g_irq_masked = 1;
+	g_scheduler_running = 0;
+	sem_post( &g_scheduler_end );
+
+	if( NULL != pxSelf )
+	{
+		for( ;; )
+		{
+			prvWaitToRun( pxSelf );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+	g_yield_pending = 1;
+
+	/* Pended until the interrupts are enabled, same as the PendSV */
+	if( 0 == g_irq_masked && 0 != g_scheduler_running )
+	{
+		prvServiceInterrupts( pdTRUE );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+	g_irq_masked = 1;
+	g_critical_nesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+	/* The interrupts stay disabled until the scheduler is started */
+	configASSERT( g_critical_nesting > 0 );
+	if( 0 == --g_critical_nesting && 0 != g_scheduler_running )
+	{
+		prvServiceInterrupts( pdTRUE );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+	g_irq_masked = 1;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+	if( 0 == g_critical_nesting && 0 == g_in_isr && 0 != g_scheduler_running )
+	{
+		prvServiceInterrupts( pdTRUE );
+	}
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulPortSetInterruptMask( void )
+{
+	const uint32_t ulWasMasked = ( uint32_t ) g_irq_masked;
+	g_irq_masked = 1;
+	return ulWasMasked;
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( uint32_t ulMask )
+{
+	if( 0 == ulMask )
+	{
+		vPortEnableInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortIsInsideInterrupt( void )
+{
+	return ( 0 != g_in_isr ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortHostSetInterruptHandler( uint32_t ulInterrupt, void ( *pvHandler )( void ) )
+{
+	configASSERT( ulInterrupt > portHOST_TICK_INTERRUPT && ulInterrupt < portHOST_MAX_INTERRUPTS );
+	g_irq_handlers[ ulInterrupt ] = pvHandler;
+}
+/*-----------------------------------------------------------*/
+
+void vPortHostRaiseInterrupt( uint32_t ulInterrupt )
+{
+	if( portHOST_TICK_INTERRUPT != ulInterrupt )
+	{
+		__atomic_or_fetch( &g_pending_irqs, 1UL << ulInterrupt, __ATOMIC_SEQ_CST );
+	}
+
+	if( 0 != g_scheduler_running )
+	{
+		/* A switch may be in progress, and then the next task services the interrupt */
+		pthread_kill( prvCurrentThread()->thread, SIGUSR1 );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortHostWaitForInterrupt( void )
+{
+	sigset_t xSignals, xOld;
+	sigemptyset( &xSignals );
+	sigaddset( &xSignals, SIGUSR1 );
+
+	/* Block the signal such that it cannot arrive between the check and the wait */
+	pthread_sigmask( SIG_BLOCK, &xSignals, &xOld );
+	if( 0 == g_pending_irqs && 0 == g_pending_ticks && 0 == g_yield_pending )
+	{
+		sigsuspend( &xOld );
+	}
+	pthread_sigmask( SIG_SETMASK, &xOld, NULL );
+
+	/* The switch was pended if the signal arrived in sigsuspend() */
+	portENTER_CRITICAL();
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vPortHostSetTickPeriod( uint32_t ulMicroseconds )
+{
+	g_tick_period_us = ( ulMicroseconds > 0 ) ? ulMicroseconds : 1;
+}
+
+#endif /* #ifndef __arm__ */
@@ -0,0 +1,155 @@
+/*     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+
+/**
+ * @file
+ * @brief Port specific definitions of the host (POSIX threads) port, @see port.c
+ */
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Type definitions. */
+#define portCHAR		char
+#define portFLOAT		float
+#define portDOUBLE		double
+#define portLONG		long
+#define portSHORT		short
+#define portSTACK_TYPE	uint32_t
+#define portBASE_TYPE	long
+#define portPOINTER_SIZE_TYPE	uintptr_t
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#if( configUSE_16_BIT_TICKS == 1 )
+	typedef uint16_t TickType_t;
+	#define portMAX_DELAY ( TickType_t ) 0xffff
+#else
+	typedef uint32_t TickType_t;
+	#define portMAX_DELAY ( TickType_t ) 0xffffffffUL
+	#define portTICK_TYPE_IS_ATOMIC 1
+#endif
+/*-----------------------------------------------------------*/
+
+/* Architecture specifics. */
+#define portSTACK_GROWTH			( -1 )
+#define portTICK_PERIOD_MS			( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT			8
+/*-----------------------------------------------------------*/
+
+/* Scheduler utilities.  A yield inside of a critical section or an interrupt is
+pended until it ends, the same as the PendSV of the Cortex-M3 port. */
+extern void vPortYield( void );
+#define portYIELD()									vPortYield()
+#define portEND_SWITCHING_ISR( xSwitchRequired )	if( xSwitchRequired != pdFALSE ) portYIELD()
+#define portYIELD_FROM_ISR( x )						portEND_SWITCHING_ISR( x )
+/*-----------------------------------------------------------*/
+
+/* Critical section management.  Interrupts are simulated, so disabling them
+only keeps the simulated interrupts pending. */
+extern void vPortEnterCritical( void );
+extern void vPortExitCritical( void );
+extern void vPortDisableInterrupts( void );
+extern void vPortEnableInterrupts( void );
+extern uint32_t ulPortSetInterruptMask( void );
+extern void vPortClearInterruptMask( uint32_t ulMask );
+#define portSET_INTERRUPT_MASK_FROM_ISR()		ulPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)	vPortClearInterruptMask(x)
+#define portDISABLE_INTERRUPTS()				vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()					vPortEnableInterrupts()
+#define portENTER_CRITICAL()					vPortEnterCritical()
+#define portEXIT_CRITICAL()						vPortExitCritical()
+/*-----------------------------------------------------------*/
+
+/* Task function macros as described on the FreeRTOS.org WEB site. */
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+/*-----------------------------------------------------------*/
+
+/* Architecture specific optimisations. */
+#ifndef configUSE_PORT_OPTIMISED_TASK_SELECTION
+	#define configUSE_PORT_OPTIMISED_TASK_SELECTION 1
+#endif
+
+#if configUSE_PORT_OPTIMISED_TASK_SELECTION == 1
+
+	/* Check the configuration. */
+	#if( configMAX_PRIORITIES > 32 )
+		#error configUSE_PORT_OPTIMISED_TASK_SELECTION can only be set to 1 when configMAX_PRIORITIES is less than or equal to 32.
+	#endif
+
+	/* Store/clear the ready priorities in a bit map. */
+	#define portRECORD_READY_PRIORITY( uxPriority, uxReadyPriorities ) ( uxReadyPriorities ) |= ( 1UL << ( uxPriority ) )
+	#define portRESET_READY_PRIORITY( uxPriority, uxReadyPriorities ) ( uxReadyPriorities ) &= ~( 1UL << ( uxPriority ) )
+	#define portGET_HIGHEST_PRIORITY( uxTopPriority, uxReadyPriorities ) uxTopPriority = ( 31UL - ( uint32_t ) __builtin_clz( ( uint32_t ) ( uxReadyPriorities ) ) )
+
+#endif /* configUSE_PORT_OPTIMISED_TASK_SELECTION */
+/*-----------------------------------------------------------*/
+
+#define portNOP()
+#define portINLINE	__inline
+#ifndef portFORCE_INLINE
+	#define portFORCE_INLINE inline __attribute__(( always_inline))
+#endif
+
+/// @returns pdTRUE if called from a simulated interrupt
+extern BaseType_t xPortIsInsideInterrupt( void );
+/*-----------------------------------------------------------*/
+
+/**
+ * @{ Simulated interrupts of the host port
+ * Host threads that stand in for peripherals (such as a UART reading stdin) must not
+ * call FreeRTOS functions.  They raise a simulated interrupt instead, and its handler
+ * runs on the thread of the running task like a real interrupt, such that it can use
+ * the FromISR() functions.  The interrupts are serviced in order of their number; 0 is
+ * the tick.
+ */
+#define portHOST_MAX_INTERRUPTS		32
+#define portHOST_TICK_INTERRUPT		0
+
+/// Registers the handler of a simulated interrupt number (1 to portHOST_MAX_INTERRUPTS - 1)
+void vPortHostSetInterruptHandler( uint32_t ulInterrupt, void ( *pvHandler )( void ) );
+
+/// Raises a simulated interrupt; this can be called from any thread
+void vPortHostRaiseInterrupt( uint32_t ulInterrupt );
+
+/**
+ * Sleeps until the next interrupt, for the idle hook.  Without this, the idle task
+ * uses a whole CPU of the host.
+ */
+void vPortHostWaitForInterrupt( void );
+
+/**
+ * Sets the host time of a tick in microseconds (default 1000000 / configTICK_RATE_HZ)
+ * Shorter ticks run the timing of the firmware faster than real time.
+ */
+void vPortHostSetTickPeriod( uint32_t ulMicroseconds );
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORTMACRO_H */
@@ -21,28 +21,51 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
 
 #include "char_dev.hpp"
+#include "stream_printf.h"
 #include "utilities.h"      // system_get_timer_ms();
 
 
 
+uint32_t CharDev::read(void *pData, uint32_t len, unsigned int timeout)
+{
+    char *p = (char*) pData;
+    uint32_t count = 0;
+
+    if (len > 0 && getChar(p, timeout)) {
+        for (count = 1; count < len && getChar(p + count, 0); count++) {
+            ;
+        }
+    }
+
+    return count;
+}
+
+uint32_t CharDev::write(const void *pData, uint32_t len, unsigned int timeout)
+{
+    const char *p = (const char*) pData;
+    uint32_t count = 0;
+
+    while (count < len && putChar(p[count], timeout)) {
+        count++;
+    }
+
+    return count;
+}
+
 bool CharDev::put(const char* pString, unsigned int timeout)
 {
     if (!pString) {
         return false;
     }
 
-    while(*pString) {
-        if(!putChar(*pString++, timeout)) {
-            return false;
-        }
-    }
-
-    return true;
+    const uint32_t len = strlen(pString);
+    return (len == write(pString, len, timeout));
 }
 
 void CharDev::putline(const char* pBuff, unsigned int timeout)
@@ -78,47 +101,23 @@ bool CharDev::gets(char* pBuff, int maxLen, unsigned int timeout)
     return success;
 }
 
+/// Output function of printf() that writes each chunk of the text to the device
+static bool char_dev_printf_out(const char *data, uint32_t len, void *arg)
+{
+    CharDev *dev = (CharDev*) arg;
+    return (len == dev->write(data, len));
+}
+
 int CharDev::printf(const char *format, ...)
 {
     if (taskSCHEDULER_RUNNING == xTaskGetSchedulerState()) {
         xSemaphoreTake(mPrintfSemaphore, portMAX_DELAY);
     }
 
-        int len = 0;
         va_list args;
         va_start(args, format);
-
-        do {
-            va_list args_copy;
-            va_copy(args_copy, args);
-            len = vsnprintf(mpPrintfMem, mPrintfMemSize, format, args_copy);
-            va_end(args_copy);
-
-            if (len >= mPrintfMemSize) {
-                const int align = 16;
-                mPrintfMemSize = (align + ((len/align) * align));
-                /* TO DO :
-                 * Do not know why realloc() doesn't work.  It is a combination of C++ class
-                 * use combined with va_args and realloc itself.  It seems to work in vector
-                 * and str classes though.
-                 */
-                if (0) {
-                    if (mpPrintfMem) {
-                        free(mpPrintfMem);
-                    }
-                    mpPrintfMem = (char*) malloc(mPrintfMemSize);
-                }
-                else {
-                    mpPrintfMem = (char*) realloc(mpPrintfMem, mPrintfMemSize);
-                }
-            }
-            else {
-                break;
-            }
-        } while (mpPrintfMem);
-
+        const int len = stream_vprintf(char_dev_printf_out, this, format, args);
         va_end(args);
-        this->put(mpPrintfMem);
 
     if (taskSCHEDULER_RUNNING == xTaskGetSchedulerState()) {
         xSemaphoreGive(mPrintfSemaphore);
@@ -142,7 +141,7 @@ int CharDev::scanf(const char *format, ...)
     return parsed;
 }
 
-CharDev::CharDev() : mpPrintfMem(NULL), mPrintfMemSize(0), mReady(false)
+CharDev::CharDev() : mReady(false)
 {
     mPrintfSemaphore = xSemaphoreCreateMutex();
     vTraceSetMutexName(mPrintfSemaphore, "printf sem");
@@ -150,7 +149,5 @@ CharDev::CharDev() : mpPrintfMem(NULL), mPrintfMemSize(0), mReady(false)
 
 CharDev::~CharDev()
 {
-    if (mpPrintfMem) {
-        free(mpPrintfMem);
-    }
+
 }
@@ -20,6 +20,8 @@
  * @file
  * @brief Provides a 'char' device base class functionality for stream oriented char devices
  *
+ * 20261016 : printf() streams to write() without a heap buffer, see stream_printf.h
+ * 20261016 : Added read() and write() to transfer the data in bulk
  * 20140420 : Reverted back to non-static members
  * 20131201 : Initial version
  */
@@ -61,6 +63,23 @@ class CharDev
          */
         virtual bool putChar(char out, unsigned int timeout=portMAX_DELAY) = 0;
 
+        /**
+         * Reads up to len bytes.  This waits up to the timeout for the first byte, and then
+         * reads the bytes that are already received without waiting.
+         * The default implementation uses getChar(), and the devices override this to copy
+         * the data without a virtual call and a queue operation per byte.
+         * @returns the number of bytes read, or 0 if nothing was received within the timeout
+         */
+        virtual uint32_t read(void *pData, uint32_t len, unsigned int timeout=portMAX_DELAY);
+
+        /**
+         * Writes len bytes, and waits up to the timeout for each byte (or block of data)
+         * that does not fit in the output buffer.
+         * The default implementation uses putChar().
+         * @returns the number of bytes written, which is less than len if the timeout expired
+         */
+        virtual uint32_t write(const void *pData, uint32_t len, unsigned int timeout=portMAX_DELAY);
+
         /**
          * Optional flush to flush out all the data
          */
@@ -83,7 +102,8 @@ class CharDev
         bool gets(char* pBuff, int maxLen, unsigned int timeout=0xffffffff);
 
         /**
-         * Just like printf, except it will print to this output interface
+         * Just like printf, except it will print to this output interface.
+         * The text is formatted in small chunks on the stack that are passed to write().
          * @returns the number of characters printed
          */
         int printf(const char *format, ...);
@@ -95,11 +115,6 @@ class CharDev
          */
         int scanf(const char *format, ...);
 
-        /**
-         * Get the size for the printf() memory used by printf() function
-         */
-        inline uint16_t getPrintfMemSize(void) const { return mPrintfMemSize; }
-
         /**
          * @{  This API just provides a means to set a flag if UART is ready or not
          *     This doesn't cause any change to the way UART functions.
@@ -113,8 +128,6 @@ class CharDev
         virtual ~CharDev();
 
     private:
-        char *mpPrintfMem;                  ///< Heap pointer used by printf()
-        uint16_t mPrintfMemSize;            ///< Size of heap used by printf()
         SemaphoreHandle_t mPrintfSemaphore; ///< Semaphore to lock printf()
         bool mReady;                        ///< Marker if device is ready or not
 };
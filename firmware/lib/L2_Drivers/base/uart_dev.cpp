@@ -20,11 +20,15 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "uart_dev.hpp"
 #include "LPC17xx.h"
 #include "utilities.h"      // system_get_timer_ms();
 #include "lpc_sys.h"
+#if (6 == configMEM_MANG_TYPE)
+#include "region_heap.h"    // sys_heap_malloc()
+#endif
 
 
 
@@ -33,6 +37,9 @@ bool UartDev::getChar(char* pInputChar, unsigned int timeout)
     if (!pInputChar || !mRxQueue) {
         return false;
     }
+    else if (mpDma) {
+        return (1 == dmaRead(pInputChar, 1, timeout));
+    }
     else if (taskSCHEDULER_RUNNING == xTaskGetSchedulerState()) {
         return xQueueReceive(mRxQueue, pInputChar, timeout);
     }
@@ -56,23 +63,70 @@ bool UartDev::putChar(char out, unsigned int timeout)
         return true;
     }
 
+    if (mpDma) {
+        return (1 == dmaWrite(&out, 1, timeout));
+    }
+
     /* FreeRTOS running, so send to queue and if queue is full, return false */
     if(! xQueueSend(mTxQueue, &out, timeout)) {
         return false;
     }
 
-    /* If transmitter is not busy, send out the oldest char from the queue,
-     * and let the transmitter empty interrupt empty out the queue thereafter.
-     */
-    const int uart_tx_is_idle = (1 << 6);
-    if (mpUARTRegBase->LSR & uart_tx_is_idle)
-    {
-        if (xQueueReceive(mTxQueue, &out, 0)) {
-            mpUARTRegBase->THR = out;
+    queueStartTx();
+    return true;
+}
+
+uint32_t UartDev::read(void *pData, uint32_t len, unsigned int timeout)
+{
+    char *p = (char*) pData;
+    uint32_t count = 0;
+
+    if (!pData || 0 == len || !mRxQueue) {
+        return 0;
+    }
+    else if (mpDma) {
+        return dmaRead(pData, len, timeout);
+    }
+    else if (taskSCHEDULER_RUNNING != xTaskGetSchedulerState()) {
+        return CharDev::read(pData, len, timeout);
+    }
+
+    if (xQueueReceive(mRxQueue, p, timeout)) {
+        for (count = 1; count < len && xQueueReceive(mRxQueue, p + count, 0); count++) {
+            ;
         }
     }
 
-    return true;
+    return count;
+}
+
+uint32_t UartDev::write(const void *pData, uint32_t len, unsigned int timeout)
+{
+    const char *p = (const char*) pData;
+    uint32_t count = 0;
+
+    if (!pData || !mTxQueue) {
+        return 0;
+    }
+    else if (taskSCHEDULER_RUNNING != xTaskGetSchedulerState()) {
+        return CharDev::write(pData, len, timeout);
+    }
+    else if (mpDma) {
+        return dmaWrite(pData, len, timeout);
+    }
+
+    /* Queue the data that fits, and start the transmitter before waiting for more space */
+    for (count = 0; count < len; count++) {
+        if (!xQueueSend(mTxQueue, p + count, 0)) {
+            queueStartTx();
+            if (!xQueueSend(mTxQueue, p + count, timeout)) {
+                break;
+            }
+        }
+    }
+
+    queueStartTx();
+    return count;
 }
 
 bool UartDev::flush(void)
@@ -108,6 +162,21 @@ void UartDev::setBaudRate(unsigned int baudRate)
     mpUARTRegBase->LCR = 3; // Disable DLAB and set 8bit per char
 }
 
+void UartDev::queueStartTx(void)
+{
+    /* If transmitter is not busy, send out the oldest char from the queue,
+     * and let the transmitter empty interrupt empty out the queue thereafter.
+     */
+    const int uart_tx_is_idle = (1 << 6);
+    char out = 0;
+    if (mpUARTRegBase->LSR & uart_tx_is_idle)
+    {
+        if (xQueueReceive(mTxQueue, &out, 0)) {
+            mpUARTRegBase->THR = out;
+        }
+    }
+}
+
 void UartDev::handleInterrupt()
 {
     /**
@@ -123,6 +192,11 @@ void UartDev::handleInterrupt()
     char c = 0;
     unsigned charsSent = 0;
 
+    if (mpDma) {
+        dmaHandleInterrupt();
+        return;
+    }
+
     uint16_t reasonForInterrupt = (mpUARTRegBase->IIR & 0xE);
     {
         /**
@@ -198,7 +272,8 @@ UartDev::UartDev(unsigned int* pUARTBaseAddr) : CharDev(),
         mPeripheralClock(0),
         mRxQWatermark(0),
         mTxQWatermark(0),
-        mLastActivityTime(0)
+        mLastActivityTime(0),
+        mpDma(0)
 {
 
 }
@@ -262,3 +337,318 @@ bool UartDev::init(unsigned int pclk, unsigned int baudRate,
 
     return (0 != mRxQueue && 0 != mTxQueue);
 }
+
+bool UartDev::enableDma(uint32_t rxBufSize, uint32_t txBufSize, void *pMem)
+{
+    uint8_t rxChannel = 0, txChannel = 0, rxRequest = 0, txRequest = 0;
+
+    if (mpDma) {
+        return true;
+    }
+    else if (!mRxQueue || !mTxQueue) {
+        return false;
+    }
+    else if (LPC_UART0_BASE == (unsigned int) mpUARTRegBase) {
+        rxChannel = LPC_DMA_CH_UART0_RX; rxRequest = LPC_DMA_REQ_UART0_RX;
+        txChannel = LPC_DMA_CH_UART0_TX; txRequest = LPC_DMA_REQ_UART0_TX;
+    }
+    else if (LPC_UART2_BASE == (unsigned int) mpUARTRegBase) {
+        rxChannel = LPC_DMA_CH_UART2_RX; rxRequest = LPC_DMA_REQ_UART2_RX;
+        txChannel = LPC_DMA_CH_UART2_TX; txRequest = LPC_DMA_REQ_UART2_TX;
+    }
+    else if (LPC_UART3_BASE == (unsigned int) mpUARTRegBase) {
+        rxChannel = LPC_DMA_CH_UART3_RX; rxRequest = LPC_DMA_REQ_UART3_RX;
+        txChannel = LPC_DMA_CH_UART3_TX; txRequest = LPC_DMA_REQ_UART3_TX;
+    }
+    else {
+        return false;
+    }
+
+    /* Each half of the receive ring is one linked list item of 8 byte bursts */
+    if (rxBufSize < 16 || rxBufSize > 2 * LPC_DMA_MAX_TRANSFER || (rxBufSize % 16) || txBufSize < 16) {
+        return false;
+    }
+
+    void *pAllocated = 0;
+    if (!pMem) {
+#if (6 == configMEM_MANG_TYPE)
+        pMem = pAllocated = sys_heap_malloc(getDmaMemSize(rxBufSize, txBufSize), REGION_HEAP_DMA);
+#endif
+        if (!pMem) {
+            return false;
+        }
+    }
+
+    dma_t *dma = (dma_t*) pMem;
+    uint8_t *rxBuf = (uint8_t*) (dma + 1);
+    uint8_t *txBuf = rxBuf + rxBufSize;
+    memset(dma, 0, sizeof(*dma));
+
+    dma->rxSignal = xSemaphoreCreateBinary();
+    dma->txSignal = xSemaphoreCreateBinary();
+    dma->txLock = xSemaphoreCreateMutex();
+    if (!dma->rxSignal || !dma->txSignal || !dma->txLock ||
+        !lpc_dma_attach(rxChannel, dmaRxCallback, this) ||
+        !lpc_dma_attach(txChannel, dmaTxCallback, this))
+    {
+        if (dma->rxSignal) vSemaphoreDelete(dma->rxSignal);
+        if (dma->txSignal) vSemaphoreDelete(dma->txSignal);
+        if (dma->txLock) vSemaphoreDelete(dma->txLock);
+        free(pAllocated);
+        return false;
+    }
+    vTraceSetSemaphoreName(dma->rxSignal, "UART RX-DMA");
+    vTraceSetSemaphoreName(dma->txSignal, "UART TX-DMA");
+    vTraceSetMutexName(dma->txLock, "UART TX-DMA Mutex");
+
+    dma->rxChannel = rxChannel;
+    dma->txChannel = txChannel;
+    dma->txRequest = txRequest;
+    dma->rxQueuePending = (0 != uxQueueMessagesWaiting(mRxQueue));
+    uart_dma_rx_init(&dma->rx, rxBuf, rxBufSize, dmaGetRxPos, this);
+    uart_dma_tx_init(&dma->tx, txBuf, txBufSize);
+
+    const uint32_t half = rxBufSize / 2;
+    const uint32_t rxControl = LPC_DMA_CTRL_SIZE(half) | LPC_DMA_CTRL_SRC_BURST(2) | LPC_DMA_CTRL_DST_BURST(2) |
+                               LPC_DMA_CTRL_DST_INC | LPC_DMA_CTRL_TC_INT;
+    for (int i = 0; i < 2; i++) {
+        dma->rxLli[i].src = (uint32_t) &mpUARTRegBase->RBR;
+        dma->rxLli[i].dst = (uint32_t) (rxBuf + i * half);
+        dma->rxLli[i].next = (uint32_t) &dma->rxLli[!i];
+        dma->rxLli[i].control = rxControl;
+    }
+
+    /* Let the interrupt driven transmission finish before the DMA takes over the UART */
+    flush();
+    while (! (mpUARTRegBase->LSR & (1 << 6)));
+
+    lpc_dma_init();
+
+    taskENTER_CRITICAL();
+    {
+        /* Only the line status interrupt stays enabled, the receive interrupt is armed while a task waits */
+        mpUARTRegBase->IER = (1 << 2);
+
+        /* FIFO enabled, DMA mode, and 8 char receive trigger to match the DMA burst size */
+        mpUARTRegBase->FCR = (1 << 0) | (1 << 3) | (2 << 6);
+
+        mpDma = dma;
+        lpc_dma_start(rxChannel, &dma->rxLli[0], LPC_DMA_CFG_SRC_REQ(rxRequest) | LPC_DMA_CFG_PERIPH_TO_MEM |
+                                                 LPC_DMA_CFG_ERR_INT | LPC_DMA_CFG_TC_INT);
+    }
+    taskEXIT_CRITICAL();
+
+    return true;
+}
+
+uint32_t UartDev::dmaRead(void *pData, uint32_t len, unsigned int timeout)
+{
+    dma_t *dma = mpDma;
+    uint32_t count = 0;
+
+    /* Data that was received by the interrupt before the DMA mode started is read first */
+    if (dma->rxQueuePending) {
+        char *p = (char*) pData;
+        while (count < len && xQueueReceive(mRxQueue, p + count, 0)) {
+            count++;
+        }
+        if (count > 0) {
+            return count;
+        }
+        dma->rxQueuePending = false;
+    }
+
+    const uint32_t available = uart_dma_rx_get_count(&dma->rx);
+    if (available > mRxQWatermark) {
+        mRxQWatermark = available;
+    }
+    if ((count = uart_dma_rx_read(&dma->rx, pData, len)) || 0 == timeout) {
+        return count;
+    }
+    else if (taskSCHEDULER_RUNNING != xTaskGetSchedulerState()) {
+        unsigned int timeout_of_char = sys_get_uptime_ms() + timeout;
+        while (0 == (count = uart_dma_rx_read(&dma->rx, pData, len))) {
+            if (sys_get_uptime_ms() > timeout_of_char) {
+                break;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Arm the receive interrupt to wake up on the next burst of data, or when the line goes
+     * idle with less than a burst in the FIFO (character timeout).  The ring is checked again
+     * after arming in case the data arrived just before.
+     */
+    const TickType_t start = xTaskGetTickCount();
+    dma->rxWaiting = true;
+    while (1) {
+        taskENTER_CRITICAL();
+        mpUARTRegBase->IER |= (1 << 0);
+        taskEXIT_CRITICAL();
+
+        if ((count = uart_dma_rx_read(&dma->rx, pData, len))) {
+            break;
+        }
+
+        const TickType_t waited = xTaskGetTickCount() - start;
+        if (portMAX_DELAY != timeout && waited >= timeout) {
+            break;
+        }
+        xSemaphoreTake(dma->rxSignal, (portMAX_DELAY == timeout) ? portMAX_DELAY : (timeout - waited));
+    }
+    dma->rxWaiting = false;
+
+    taskENTER_CRITICAL();
+    mpUARTRegBase->IER &= ~(1 << 0);
+    taskEXIT_CRITICAL();
+
+    return count;
+}
+
+uint32_t UartDev::dmaWrite(const void *pData, uint32_t len, unsigned int timeout)
+{
+    dma_t *dma = mpDma;
+    const char *p = (const char*) pData;
+    const TickType_t start = xTaskGetTickCount();
+    uint32_t count = 0;
+
+    /* The ring has a single writer, so the tasks take turns to copy and move its head */
+    if (!xSemaphoreTake(dma->txLock, timeout)) {
+        return 0;
+    }
+
+    while (1) {
+        count += uart_dma_tx_write(&dma->tx, p + count, len - count);
+
+        const uint32_t pending = uart_dma_tx_get_pending(&dma->tx);
+        if (pending > mTxQWatermark) {
+            mTxQWatermark = pending;
+        }
+
+        taskENTER_CRITICAL();
+        dmaStartTx();
+        taskEXIT_CRITICAL();
+
+        if (count == len) {
+            break;
+        }
+
+        /* Wait for the DMA to finish a block, the ring is checked again after setting the flag */
+        dma->txWaiting = true;
+        if (0 == uart_dma_tx_get_space(&dma->tx)) {
+            const TickType_t waited = xTaskGetTickCount() - start;
+            if (portMAX_DELAY != timeout && waited >= timeout) {
+                dma->txWaiting = false;
+                break;
+            }
+            xSemaphoreTake(dma->txSignal, (portMAX_DELAY == timeout) ? portMAX_DELAY : (timeout - waited));
+        }
+        dma->txWaiting = false;
+    }
+
+    xSemaphoreGive(dma->txLock);
+    return count;
+}
+
+void UartDev::dmaStartTx(void)
+{
+    dma_t *dma = mpDma;
+    LPC_GPDMACH_TypeDef *ch = lpc_dma_get_channel(dma->txChannel);
+    uart_dma_seg_t seg[2];
+
+    /* Nothing to do if the DMA is still sending the previous block (dmaTxCallback() starts the next one) */
+    if (ch->DMACCConfig & LPC_DMA_CFG_ENABLE) {
+        return;
+    }
+
+    const uint32_t segments = uart_dma_tx_start(&dma->tx, seg, LPC_DMA_MAX_TRANSFER);
+    if (0 == segments) {
+        return;
+    }
+
+    /* The first item is copied to the channel registers, only the second one is read by the DMA */
+    lpc_dma_lli_t first;
+    first.src = (uint32_t) seg[0].ptr;
+    first.dst = (uint32_t) &mpUARTRegBase->THR;
+    first.next = 0;
+    first.control = LPC_DMA_CTRL_SIZE(seg[0].len) | LPC_DMA_CTRL_SRC_INC;
+
+    if (2 == segments) {
+        dma->txLli.src = (uint32_t) seg[1].ptr;
+        dma->txLli.dst = (uint32_t) &mpUARTRegBase->THR;
+        dma->txLli.next = 0;
+        dma->txLli.control = LPC_DMA_CTRL_SIZE(seg[1].len) | LPC_DMA_CTRL_SRC_INC | LPC_DMA_CTRL_TC_INT;
+        first.next = (uint32_t) &dma->txLli;
+    }
+    else {
+        first.control |= LPC_DMA_CTRL_TC_INT;
+    }
+
+    lpc_dma_start(dma->txChannel, &first, LPC_DMA_CFG_DST_REQ(dma->txRequest) | LPC_DMA_CFG_MEM_TO_PERIPH |
+                                          LPC_DMA_CFG_ERR_INT | LPC_DMA_CFG_TC_INT);
+}
+
+void UartDev::dmaHandleInterrupt(void)
+{
+    const uint16_t dataAvailable = (2 << 1);
+    const uint16_t dataTimeout   = (6 << 1);
+    long switchRequired = 0;
+
+    /**
+     * The receive interrupt is only enabled while a task waits for data.  The DMA reads the
+     * data, so disable the interrupt (it stays pending until the DMA empties the FIFO) and
+     * wake up the task.
+     */
+    const uint16_t reasonForInterrupt = (mpUARTRegBase->IIR & 0xE);
+    if (dataAvailable == reasonForInterrupt || dataTimeout == reasonForInterrupt) {
+        mpUARTRegBase->IER &= ~(1 << 0);
+        mLastActivityTime = xTaskGetTickCountFromISR();
+        if (mpDma->rxWaiting) {
+            xSemaphoreGiveFromISR(mpDma->rxSignal, &switchRequired);
+        }
+    }
+    else {
+        /* Read LSR register to clear Line Status Interrupt */
+        (void) mpUARTRegBase->LSR;
+    }
+
+    portEND_SWITCHING_ISR(switchRequired);
+}
+
+uint32_t UartDev::dmaGetRxPos(void *pUart)
+{
+    UartDev *uart = (UartDev*) pUart;
+    const LPC_GPDMACH_TypeDef *ch = lpc_dma_get_channel(uart->mpDma->rxChannel);
+    return ch->DMACCDestAddr - (uint32_t) uart->mpDma->rx.buf;
+}
+
+bool UartDev::dmaRxCallback(void *pUart, bool error)
+{
+    UartDev *uart = (UartDev*) pUart;
+    long switchRequired = 0;
+
+    /* An error (bus fault) stops the channel, which is not expected with the buffers in the AHB SRAM */
+    if (!error) {
+        uart_dma_rx_half_done(&uart->mpDma->rx);
+        uart->mLastActivityTime = xTaskGetTickCountFromISR();
+        if (uart->mpDma->rxWaiting) {
+            xSemaphoreGiveFromISR(uart->mpDma->rxSignal, &switchRequired);
+        }
+    }
+    return switchRequired;
+}
+
+bool UartDev::dmaTxCallback(void *pUart, bool error)
+{
+    UartDev *uart = (UartDev*) pUart;
+    long switchRequired = 0;
+
+    (void) error;
+    uart_dma_tx_done(&uart->mpDma->tx);
+    uart->dmaStartTx();
+    if (uart->mpDma->txWaiting) {
+        xSemaphoreGiveFromISR(uart->mpDma->txSignal, &switchRequired);
+    }
+    return switchRequired;
+}
@@ -20,6 +20,7 @@
  * @file
  * @brief Provides UART Base class functionality for UART peripherals
  *
+ *  10162026 : Added the DMA mode, see enableDma()
  *  12012013 : Split functionality to char_dev.hpp and inherited this object
  *  10102013 : Make init() public, and protect from re-init leaking memory through xQueueCreate()
  *  05122013 : Added version history
@@ -34,6 +35,8 @@
 
 #include "char_dev.hpp"
 #include "LPC17xx.h"
+#include "lpc_dma.h"
+#include "uart_dma.h"
 
 
 
@@ -83,15 +86,51 @@ class UartDev : public CharDev
          */
         bool putChar(char out, unsigned int timeout=portMAX_DELAY);
 
+        /** @{ Bulk transfers, @see CharDev::read() and CharDev::write()
+         *  These copy to the rings in DMA mode, and make one queue call per byte otherwise.
+         */
+        uint32_t read(void *pData, uint32_t len, unsigned int timeout=portMAX_DELAY);
+        uint32_t write(const void *pData, uint32_t len, unsigned int timeout=portMAX_DELAY);
+        /** @} */
+
         /// Flushed all pending transmission of the uart queue
         bool flush(void);
 
+        /**
+         * Moves the data with the GPDMA instead of one byte at a time by the UART interrupt.
+         * Receive is a circular DMA to a ring, and the UART interrupt is only enabled while a
+         * task waits for data, to wake it up on new data or when the line goes idle.  Transmit
+         * sends straight from a ring with a DMA linked list and one interrupt per block.
+         * See uart_dma.h for the design, and its host model of the interrupts per KB.
+         *
+         * @param rxBufSize  The size of the receive ring (a multiple of 16, up to 8176)
+         * @param txBufSize  The size of the transmit ring
+         * @param pMem       Memory of getDmaMemSize() bytes in the AHB SRAM that the DMA can access.
+         *                   If NULL, it is allocated with sys_heap_malloc() which needs heap scheme 6
+         *                   because the other schemes allocate from the SRAM the DMA cannot access.
+         * @returns false if this UART has no DMA channels, or the memory could not be allocated
+         * @note Call after init(), before the data is received.  Data in the receive queue is read first.
+         */
+        bool enableDma(uint32_t rxBufSize=1024, uint32_t txBufSize=1024, void *pMem=0);
+
+        /// @returns the memory needed by enableDma()
+        static inline uint32_t getDmaMemSize(uint32_t rxBufSize, uint32_t txBufSize)
+        {
+            return sizeof(dma_t) + rxBufSize + txBufSize;
+        }
+
+        /// @returns true if the DMA mode is enabled
+        inline bool isDmaEnabled(void) const { return 0 != mpDma; }
+
+        /// @returns the number of bytes dropped because the receive ring was full in DMA mode
+        inline uint32_t getDmaRxLostCount(void) const { return mpDma ? mpDma->rx.lost : 0; }
+
         /**
          * @{ Get the Rx and Tx queue information
          * Watermarks provide the queue's usage to access the capacity usage
          */
-        inline unsigned int getRxQueueSize() const { return uxQueueMessagesWaiting(mRxQueue); }
-        inline unsigned int getTxQueueSize() const { return uxQueueMessagesWaiting(mTxQueue); }
+        inline unsigned int getRxQueueSize() const { return mpDma ? uart_dma_rx_get_count(&mpDma->rx) : uxQueueMessagesWaiting(mRxQueue); }
+        inline unsigned int getTxQueueSize() const { return mpDma ? uart_dma_tx_get_pending(&mpDma->tx) : uxQueueMessagesWaiting(mTxQueue); }
         inline unsigned int getRxQueueWatermark() const { return mRxQWatermark; }
         inline unsigned int getTxQueueWatermark() const { return mTxQWatermark; }
         /** @} */
@@ -138,6 +177,36 @@ class UartDev : public CharDev
     private:
         UartDev(); /** Disallowed constructor */
 
+        /// State of the DMA mode, allocated along with the rings in memory that the DMA can access
+        typedef struct {
+            uart_dma_rx_t rx;               ///< Receive ring
+            uart_dma_tx_t tx;               ///< Transmit ring
+            lpc_dma_lli_t rxLli[2];         ///< The two halves of the receive ring that link to each other
+            lpc_dma_lli_t txLli;            ///< Second segment of a transmit block that wraps around
+            uint8_t rxChannel;              ///< DMA channel of receive
+            uint8_t txChannel;              ///< DMA channel of transmit
+            uint8_t txRequest;              ///< DMA request number of transmit
+            bool rxQueuePending;            ///< True if the receive queue had data when the DMA mode started
+            volatile bool rxWaiting;        ///< True if a task waits on rxSignal
+            volatile bool txWaiting;        ///< True if a task waits on txSignal
+            SemaphoreHandle_t rxSignal;     ///< Given when data arrives while a task waits
+            SemaphoreHandle_t txSignal;     ///< Given at the end of a block while a task waits
+            SemaphoreHandle_t txLock;       ///< Mutex of the writers of the transmit ring
+        } dma_t;
+
+        /// Writes the first byte of the transmit queue if the transmitter is idle
+        void queueStartTx(void);
+
+        /// @{ DMA mode functions, @see enableDma()
+        uint32_t dmaRead(void *pData, uint32_t len, unsigned int timeout);
+        uint32_t dmaWrite(const void *pData, uint32_t len, unsigned int timeout);
+        void dmaStartTx(void);
+        void dmaHandleInterrupt(void);
+        static uint32_t dmaGetRxPos(void *pUart);
+        static bool dmaRxCallback(void *pUart, bool error);
+        static bool dmaTxCallback(void *pUart, bool error);
+        /// @}
+
         LPC_UART_TypeDef* mpUARTRegBase;///< Pointer to UART's memory map
         QueueHandle_t mRxQueue;         ///< Queue for UARTs receive buffer
         QueueHandle_t mTxQueue;         ///< Queue for UARTs transmit buffer
@@ -145,6 +214,7 @@ class UartDev : public CharDev
         uint16_t mRxQWatermark;         ///< Watermark of Rx Queue
         uint16_t mTxQWatermark;         ///< Watermark of Tx Queue
         TickType_t mLastActivityTime;   ///< updated each time last rx interrupt occurs
+        dma_t *mpDma;                   ///< State of the DMA mode, or NULL if not enabled
 };
 
 
@@ -127,7 +127,7 @@ typedef void (*can_void_func_t)(uint32_t);
  * @param baudrate_kbps  The CAN Bus baud-rate, such as 100, 250, 500, 1000
  *                       Precise, external crystal should be used for higher than 100kbps
  * @param rxq_size  The size of the received messages queue
- * @param txq_size  The size of the transmit messages queue
+ * @param txq_size  The size of the transmit messages queue (24 bytes per message)
  *
  * @param bus_off_cb  The callback function when CAN BUS enters BUS error state
  * @param data_ovr_cb The callback function when CAN BUS encounters data-overrun
@@ -157,15 +157,17 @@ bool CAN_rx(can_t can, can_msg_t *msg, uint32_t timeout_ms);
  * @param can  The can bus type.  @see can_t
  * @param msg  The CAN message
  * @param timeout_ms  If FreeRTOS is running, the task will block for timeout_ms
- *                    if HW buffers and the transmit queue is full.
+ *                    if the transmit queue is full.
  *                    If FreeRTOS is not running the timeout is simply, ignored, and
- *                    false is returned if all three HW buffers are full.
+ *                    false is returned if the transmit queue is full.
  *
- * The transmit queue is only used if all three buffers of the CAN hardware are busy,
- * in which case, the transmission complete interrupt will later send the queued msg.
- * @return  If CAN message was either sent, or queued, true is returned.  If all the
- *          hardware buffers are full, and the queue is full, then false is returned
- *          if timeout occurs waiting for the queue to empty.
+ * The message is queued in the order of its CAN ID priority (the same order as the CAN bus
+ * arbitration), and all three buffers of the CAN hardware are loaded from the queue, so the
+ * highest priority message is sent next.  Messages of the same ID are sent in the order of
+ * CAN_tx().  The transmission complete interrupt loads the queued messages as buffers are sent.
+ * @see can_txq.h
+ * @return  If CAN message was either sent, or queued, true is returned.  If the queue is full,
+ *          then false is returned if timeout occurs waiting for the queue to have space.
  *
  * @code
  *      can_msg_t msg;
@@ -181,6 +183,7 @@ bool CAN_tx(can_t can, can_msg_t *msg, uint32_t timeout_ms);
 /** @{ CAN Bus Error and Reset API
  * If the CAN BUS encounters error(s), it may turn off, in which case no more
  * transmissions will take place.  This must be corrected by the user.
+ * CAN_reset_bus() can be called from a task, or from the bus_off_cb in the CAN interrupt.
  */
 bool CAN_is_bus_off(can_t can);
 void CAN_reset_bus(can_t can);
@@ -188,7 +191,7 @@ void CAN_reset_bus(can_t can);
 
 /** @{ Watermark and counter API */
 uint16_t CAN_get_rx_watermark(can_t can); ///< RX FreeRTOS Queue watermark
-uint16_t CAN_get_tx_watermark(can_t can); ///< TX FreeRTOS Queue watermark
+uint16_t CAN_get_tx_watermark(can_t can); ///< TX Queue watermark (messages waiting for a HW buffer)
 uint16_t CAN_get_tx_count(can_t can); ///< Number of messages written to the CAN HW
 uint16_t CAN_get_rx_count(can_t can); ///< Number of messages successfully queued from CAN interrupt (not including dropped)
 /** @} */
@@ -312,6 +315,8 @@ uint8_t CAN_fullcan_get_num_entries(void);
 
 /**
  * Enable CAN filter for BOTH CANs; hardware doesn't allow to enable for just ONE CAN controller.
+ * @see can_filter.h to build the filter from any set of IDs and ranges instead of sorted lists.
+ *
  * @param std_id_list        List of 11-bit IDs to generate an ACK for (can be NULL)
  * @param sid_cnt            The size of the can_std_id_t array
  *
@@ -0,0 +1,321 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @ingroup Drivers
+ * @brief Builds the CAN acceptance filter from any set of IDs and ID ranges
+ *
+ * Instead of hand-building the sorted lists of CAN_setup_filter(), add the IDs to accept in
+ * any order, and can_filter_compile() builds the image of the acceptance filter RAM:
+ *  - IDs and ranges that overlap or touch are merged
+ *  - A single ID is an entry of the ID list, and two or more IDs are a group
+ *  - Each section is sorted, and an odd count of standard IDs gets a disabled entry
+ *  - FullCAN IDs go to the FullCAN section, and their messages after the end of the table
+ *
+ * This gives the smallest table for the set of IDs, and the table reports how much of the
+ * 2K filter RAM it uses.  CAN_setup_filter_table() then writes the table to the hardware.
+ *
+ * The IDs that a node receives can come straight from the DBC file:
+ * "dbc_parse.py -i 243.dbc -s MOTOR -f" generates the dbc_rx_msg_ids[] array for can_filter_add_ids().
+ *
+ * @code
+ *      static can_filter_range_t ranges[8];
+ *      static can_filter_table_t table;
+ *      can_filter_t filter;
+ *
+ *      can_filter_init(&filter, ranges, 8);
+ *      can_filter_add_ids(&filter, can1, false, dbc_rx_msg_ids, sizeof(dbc_rx_msg_ids) / sizeof(dbc_rx_msg_ids[0]));
+ *      can_filter_add_range(&filter, can1, true, 0x18FF0000, 0x18FF00FF);
+ *      can_filter_add_fullcan(&filter, can1, 0x100);
+ *      if (can_filter_compile(&filter, &table)) {
+ *          CAN_setup_filter_table(&table);
+ *      }
+ * @endcode
+ */
+#ifndef CAN_FILTER_H__
+#define CAN_FILTER_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+
+
+
+#define CAN_FILTER_RAM_SIZE     2048    ///< Bytes of the acceptance filter RAM
+#define CAN_FILTER_FULLCAN_MSG  12      ///< Bytes of each FullCAN message stored after the table
+
+/// Type of the IDs of a range
+typedef enum {
+    can_filter_fullcan,     ///< 11-bit ID received by FullCAN
+    can_filter_std,         ///< 11-bit IDs
+    can_filter_ext,         ///< 29-bit IDs
+} can_filter_type_t;
+
+/// An inclusive range of IDs to accept
+typedef struct {
+    uint32_t low;           ///< First ID
+    uint32_t high;          ///< Last ID
+    uint8_t can;            ///< can_t of the IDs
+    uint8_t type;           ///< can_filter_type_t of the IDs
+} can_filter_range_t;
+
+/// The IDs added to the filter
+typedef struct {
+    can_filter_range_t *ranges; ///< The IDs and ranges added
+    uint16_t max;               ///< Max number of ranges
+    uint16_t count;             ///< Number of ranges
+} can_filter_t;
+
+/// The acceptance filter RAM and registers built by can_filter_compile()
+typedef struct {
+    uint32_t ram[CAN_FILTER_RAM_SIZE / 4];  ///< Image of the acceptance filter RAM
+    uint16_t sff_sa;            ///< Byte offset of the standard ID list (and the size of the FullCAN section)
+    uint16_t sff_grp_sa;        ///< Byte offset of the standard ID groups
+    uint16_t eff_sa;            ///< Byte offset of the extended ID list
+    uint16_t eff_grp_sa;        ///< Byte offset of the extended ID groups
+    uint16_t end_of_table;      ///< Byte offset of the end of the table, and the start of the FullCAN messages
+    uint16_t fullcan_entries;   ///< Number of FullCAN entries (including a disabled entry to make it even)
+    uint16_t used_bytes;        ///< Bytes used of the RAM by the table and the FullCAN messages
+} can_filter_table_t;
+
+/// Result of can_filter_lookup()
+typedef enum {
+    can_filter_rejected,    ///< The message is not acknowledged
+    can_filter_accepted,    ///< The message goes to the receive buffer (CAN_rx())
+    can_filter_to_fullcan,  ///< The message is stored to its FullCAN message
+} can_filter_result_t;
+
+/**
+ * Initializes the filter
+ * @param mem  The memory of the ranges
+ * @param max  The max number of IDs and ranges that can be added
+ */
+void can_filter_init(can_filter_t *f, can_filter_range_t *mem, uint16_t max);
+
+/**
+ * Adds an inclusive range of IDs to accept
+ * @returns false if the IDs are invalid or there is no memory for more ranges
+ */
+bool can_filter_add_range(can_filter_t *f, can_t can, bool is_29bit, uint32_t low, uint32_t high);
+
+/// Adds an ID to accept
+static inline bool can_filter_add(can_filter_t *f, can_t can, bool is_29bit, uint32_t id)
+{
+    return can_filter_add_range(f, can, is_29bit, id, id);
+}
+
+/// Adds a list of IDs to accept, such as the dbc_rx_msg_ids[] generated from the DBC file
+bool can_filter_add_ids(can_filter_t *f, can_t can, bool is_29bit, const uint32_t *ids, uint32_t count);
+
+/**
+ * Adds an 11-bit ID that is received by FullCAN.  @see CAN_fullcan_get_entry_ptr()
+ * @note Each FullCAN ID uses 14 bytes (the entry and its message) versus the 2 bytes of an ID
+ */
+bool can_filter_add_fullcan(can_filter_t *f, can_t can, uint16_t id);
+
+/**
+ * Builds the smallest table that accepts the IDs added to the filter
+ * @param f      The filter; its ranges are sorted and merged
+ * @param table  The table built
+ * @returns false if the table does not fit the RAM (table->used_bytes is the size it needs)
+ */
+bool can_filter_compile(can_filter_t *f, can_filter_table_t *table);
+
+/**
+ * Looks up a message in a table the way the acceptance filter hardware does: it searches
+ * each sorted section of the table with a binary search.  This is used by the host tests.
+ * @param [out] fc_idx  The index of the FullCAN entry if the result is can_filter_to_fullcan (can be NULL)
+ */
+can_filter_result_t can_filter_lookup(const can_filter_table_t *table, can_t can, bool is_29bit, uint32_t id,
+                                      uint16_t *fc_idx);
+
+/**
+ * Writes the table to the acceptance filter RAM and registers, and enables the filter
+ * (FullCAN mode if the table has FullCAN entries).  This is implemented by the CAN driver.
+ * @warning CAN BUS should not be enabled to do this because the CAN Filter is put to
+ *          OFF mode while the table is written.
+ * @note This replaces CAN_fullcan_add_entry() and CAN_setup_filter().
+ */
+bool CAN_setup_filter_table(const can_filter_table_t *table);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @returns true if one of the ranges added accepts the message (the reference for the table)
+static inline bool test_can_filter_match(const can_filter_range_t *ranges, uint32_t count,
+                                         can_t can, bool is_29bit, uint32_t id)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        const bool ext = (can_filter_ext == ranges[i].type);
+        if (ranges[i].can == can && ext == is_29bit && id >= ranges[i].low && id <= ranges[i].high) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void test_can_filter(void)
+{
+    can_filter_range_t mem[160], added[64];
+    can_filter_table_t table;
+    can_filter_t f;
+    uint16_t fc_idx = 0;
+
+    /* The table of the CAN_setup_filter() example is the same, but the IDs are in any order */
+    can_filter_init(&f, mem, 8);
+    assert(can_filter_add(&f, can1, false, 0x130));
+    assert(can_filter_add(&f, can1, false, 0x110));
+    assert(can_filter_add_range(&f, can2, false, 0x300, 0x400));
+    assert(can_filter_add(&f, can1, false, 0x100));
+    assert(can_filter_add_range(&f, can1, false, 0x150, 0x200));
+    assert(can_filter_add(&f, can1, false, 0x120));
+    assert(can_filter_add_range(&f, can1, true, 0x3500, 0x4500));
+    assert(can_filter_compile(&f, &table));
+    assert(0 == table.sff_sa && 8 == table.sff_grp_sa && 16 == table.eff_sa);
+    assert(16 == table.eff_grp_sa && 24 == table.end_of_table && 24 == table.used_bytes);
+    assert(0x01000110 == table.ram[0] && 0x01200130 == table.ram[1]);
+    assert(0x01500200 == table.ram[2] && 0x23002400 == table.ram[3]);
+    assert(0x3500 == table.ram[4] && 0x4500 == table.ram[5]);
+
+    /* Invalid IDs, and no memory for more */
+    assert(!can_filter_add(&f, can_max, false, 0x100));
+    assert(!can_filter_add(&f, can1, false, 0x800));
+    assert(!can_filter_add(&f, can1, true, 0x20000000));
+    assert(!can_filter_add_range(&f, can1, false, 0x200, 0x100));
+    assert(!can_filter_add_fullcan(&f, can1, 0x800));
+    assert(can_filter_add(&f, can1, false, 0x7FF));
+    assert(!can_filter_add(&f, can1, false, 0x7FE));
+
+    /* Ranges that overlap or touch are merged, an odd count of IDs gets a disabled entry */
+    can_filter_init(&f, mem, 16);
+    assert(can_filter_add_range(&f, can1, false, 0x10, 0x1F));
+    assert(can_filter_add_range(&f, can1, false, 0x20, 0x2F));
+    assert(can_filter_add_range(&f, can1, false, 0x18, 0x28));
+    assert(can_filter_add(&f, can1, false, 0x40));
+    assert(can_filter_add(&f, can1, false, 0x40));
+    assert(can_filter_add(&f, can2, false, 0x40));
+    assert(can_filter_add(&f, can1, false, 0x42));
+    assert(can_filter_add_range(&f, can1, true, 0x1000, 0x1000));
+    assert(can_filter_add_range(&f, can1, true, 0x1001, 0x1005));
+    assert(can_filter_compile(&f, &table));
+    assert(0 == table.sff_sa && 8 == table.sff_grp_sa && 12 == table.eff_sa);
+    assert(12 == table.eff_grp_sa && 20 == table.end_of_table && 20 == table.used_bytes);
+    assert(0x00400042 == table.ram[0] && 0x2040FFFF == table.ram[1] && 0x0010002F == table.ram[2]);
+    assert(can_filter_accepted == can_filter_lookup(&table, can2, false, 0x40, NULL));
+    assert(can_filter_rejected == can_filter_lookup(&table, can2, false, 0x42, NULL));
+    assert(can_filter_rejected == can_filter_lookup(&table, can1, false, 0x41, NULL));
+    assert(can_filter_accepted == can_filter_lookup(&table, can1, true, 0x1003, NULL));
+    assert(can_filter_rejected == can_filter_lookup(&table, can1, false, 0x1003 & 0x7FF, NULL));
+
+    /* FullCAN entries come first, and their messages are at the end of the table in the same order */
+    can_filter_init(&f, mem, 16);
+    assert(can_filter_add_fullcan(&f, can1, 0x300));
+    assert(can_filter_add_fullcan(&f, can1, 0x100));
+    assert(can_filter_add_fullcan(&f, can2, 0x100));
+    assert(can_filter_add(&f, can1, false, 0x200));
+    assert(can_filter_compile(&f, &table));
+    assert(4 == table.fullcan_entries && 8 == table.sff_sa && 12 == table.sff_grp_sa && 12 == table.end_of_table);
+    assert(12 + 4 * CAN_FILTER_FULLCAN_MSG == table.used_bytes);
+    assert(0x01000300 == table.ram[0] && 0x2100FFFF == table.ram[1]);
+    assert(can_filter_to_fullcan == can_filter_lookup(&table, can1, false, 0x300, &fc_idx) && 1 == fc_idx);
+    assert(can_filter_to_fullcan == can_filter_lookup(&table, can2, false, 0x100, &fc_idx) && 2 == fc_idx);
+    assert(can_filter_accepted == can_filter_lookup(&table, can1, false, 0x200, NULL));
+    assert(can_filter_rejected == can_filter_lookup(&table, can2, false, 0x300, NULL));
+
+    /* FullCAN IDs that touch are not merged */
+    can_filter_init(&f, mem, 16);
+    assert(can_filter_add_fullcan(&f, can1, 0x11) && can_filter_add_fullcan(&f, can1, 0x10));
+    assert(can_filter_add_fullcan(&f, can1, 0x11));
+    assert(can_filter_compile(&f, &table) && 2 == table.fullcan_entries && 0x00100011 == table.ram[0]);
+
+    /* A table that does not fit reports the size it needs */
+    can_filter_init(&f, mem, 150);
+    for (uint32_t i = 0; i < 150; i++) {
+        assert(can_filter_add_fullcan(&f, can1, i * 2));
+    }
+    assert(!can_filter_compile(&f, &table) && 150 * 14 == table.used_bytes);
+    can_filter_init(&f, mem, 64);
+    for (uint32_t i = 0; i < 64; i++) {
+        assert(can_filter_add(&f, can2, true, i * 2));
+    }
+    assert(can_filter_compile(&f, &table) && 256 == table.used_bytes);
+
+    /* Random sets of IDs and ranges: the hardware lookup of the table matches the IDs added */
+    srand(1);
+    for (uint32_t round = 0; round < 300; round++) {
+        const uint32_t count = 1 + rand() % 64;
+        const uint32_t spread = (round % 3) ? 0x7FF : 0x7F;
+        can_filter_init(&f, mem, 64);
+
+        for (uint32_t i = 0; i < count; i++) {
+            const can_t can = (rand() & 1) ? can1 : can2;
+            const int type = rand() % 8;
+            const uint32_t low = rand() % spread;
+            const uint32_t len = (rand() & 1) ? 0 : rand() % 8;
+            if (0 == type) {
+                assert(can_filter_add_fullcan(&f, can, low));
+            }
+            else if (type < 5) {
+                assert(can_filter_add_range(&f, can, false, low, (low + len > 0x7FF) ? 0x7FF : low + len));
+            }
+            else {
+                assert(can_filter_add_range(&f, can, true, 0x1FFF0000 + low, 0x1FFF0000 + low + len));
+            }
+        }
+        memcpy(added, mem, count * sizeof(mem[0]));
+        assert(can_filter_compile(&f, &table));
+        assert(table.used_bytes == table.end_of_table + table.fullcan_entries * CAN_FILTER_FULLCAN_MSG);
+
+        for (uint32_t id = 0; id <= spread + 8; id++) {
+            for (int can = can1; can <= can2; can++) {
+                const can_filter_result_t std = can_filter_lookup(&table, (can_t) can, false, id, &fc_idx);
+                const can_filter_result_t ext = can_filter_lookup(&table, (can_t) can, true, 0x1FFF0000 + id, NULL);
+                assert((can_filter_rejected != std) == test_can_filter_match(added, count, (can_t) can, false, id));
+                assert((can_filter_rejected != ext) == test_can_filter_match(added, count, (can_t) can, true, 0x1FFF0000 + id));
+                assert(can_filter_rejected == can_filter_lookup(&table, (can_t) can, true, id, NULL));
+
+                /* FullCAN IDs are stored to their FullCAN message */
+                bool fullcan = false;
+                for (uint32_t i = 0; i < count; i++) {
+                    fullcan |= (can_filter_fullcan == added[i].type && can == added[i].can && id == added[i].low);
+                }
+                assert(fullcan == (can_filter_to_fullcan == std));
+                assert(!fullcan || fc_idx < table.fullcan_entries);
+            }
+        }
+    }
+
+    puts("\nCAN Filter Tests Successful!");
+}
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CAN_FILTER_H__ */
@@ -0,0 +1,394 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @ingroup Drivers
+ * @brief Transmit queue of the CAN driver that feeds the three hardware buffers in priority order
+ *
+ * This is the hardware independent part of CAN_tx(), so it is tested on the host along with
+ * a model of the CAN controller and the bus that measures the bus load and the latency of a
+ * high priority ID.
+ *
+ * The queue is a binary heap ordered the same way the CAN bus arbitrates: the lower ID wins,
+ * a standard frame wins over an extended frame with the same 11-bit base ID, and a data frame
+ * wins over an RTR frame.  Messages with the same arbitration fields are sent in the order
+ * they were queued.
+ *
+ * The controller runs in the TPM mode: of the buffers waiting to be sent, it sends the one
+ * with the lowest TPM (the 8-bit priority field of TFI) first.  A buffer cannot be changed
+ * while it waits, so can_txq_next() gives each message that it loads a TPM value that places
+ * it correctly among the messages already in the buffers:
+ *  - If the buffers are empty, the value is 128.
+ *  - If the message goes after all of them, the value is one more than the last one.
+ *  - If the message goes before all of them, the value is one less than the first one.
+ *  - If it goes between two of them, the value is half way between them.
+ *
+ * If there is no such value (a value would go below 0 or above 255, or there is no value
+ * left between two of them), the message stays queued until more of the buffers are sent.
+ * This means that a message that was loaded is never passed by a message of the same or a
+ * lower priority, so no buffer starves, and only the one message at the head of the queue
+ * waits for a buffer.  A long stream of messages that never lets the buffers become empty
+ * moves the values up by one per message, so once per 127 messages the buffers are allowed
+ * to be sent before the next one is loaded.
+ */
+#ifndef CAN_TXQ_H__
+#define CAN_TXQ_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+
+
+
+#define CAN_TXQ_HW_BUFS     3       ///< Number of transmit buffers of the CAN controller
+#define CAN_TXQ_TPM_MASK    0xFF    ///< Bits of the TPM field in can_msg_t::frame
+#define CAN_TXQ_TPM_START   128     ///< TPM of a message that is loaded while the buffers are empty
+
+/// A queued message
+typedef struct {
+    can_msg_t msg;      ///< The message
+    uint32_t key;       ///< Arbitration key, @see can_txq_arb_key()
+    uint32_t seq;       ///< Order of the message among the messages queued
+} can_txq_entry_t;
+
+/// Transmit queue and the messages in the hardware buffers
+typedef struct {
+    can_txq_entry_t *heap;  ///< The heap of queued messages
+    uint16_t size;          ///< Max number of queued messages
+    uint16_t count;         ///< Number of queued messages
+    uint32_t seq;           ///< Sequence number of the next queued message
+    struct {
+        uint32_t key;       ///< Arbitration key of the message in the buffer
+        uint32_t seq;       ///< Sequence number of the message in the buffer
+        uint8_t tpm;        ///< TPM written to the buffer
+    } hw[CAN_TXQ_HW_BUFS];  ///< The messages loaded to the buffers (valid while a buffer is busy)
+} can_txq_t;
+
+/**
+ * Initializes the queue
+ * @param mem   The memory of the queue, size * sizeof(can_txq_entry_t) bytes
+ * @param size  The max number of queued messages
+ */
+void can_txq_init(can_txq_t *q, can_txq_entry_t *mem, uint16_t size);
+
+/**
+ * @returns the arbitration key of a message: the bits a controller sends during the arbitration
+ *          of the bus (base ID, RTR or SRR, IDE, extended ID, RTR), so that the lower key wins.
+ */
+uint32_t can_txq_arb_key(const can_msg_t *msg);
+
+/**
+ * Queues a message
+ * @returns false if the queue is full
+ */
+bool can_txq_push(can_txq_t *q, const can_msg_t *msg);
+
+/// @returns the number of queued messages
+static inline uint16_t can_txq_get_count(const can_txq_t *q) { return q->count; }
+
+/**
+ * Takes the message at the head of the queue if it can be loaded to a free buffer
+ * @param [in]  free_mask  Bit mask of the free buffers: bit 0 for TX1, bit 1 for TX2, bit 2 for TX3
+ * @param [out] msg        The message with its TPM field set
+ * @param [out] buf        The buffer to load the message to (0 for TX1)
+ * @returns false if nothing can be loaded now; call again when a buffer is sent
+ */
+bool can_txq_next(can_txq_t *q, uint8_t free_mask, can_msg_t *msg, uint8_t *buf);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static inline can_msg_t test_can_txq_msg(uint32_t id, bool is_29bit, uint32_t data)
+{
+    can_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_id = id;
+    msg.frame_fields.is_29bit = is_29bit;
+    msg.frame_fields.data_len = 8;
+    msg.data.dwords[0] = data;
+    return msg;
+}
+
+/// @returns the bit times of a frame without stuff bits (not including the 3-bit interframe space)
+static inline uint32_t test_can_txq_frame_bits(const can_msg_t *msg)
+{
+    return (msg->frame_fields.is_29bit ? 64 : 44) + 8 * msg->frame_fields.data_len;
+}
+
+/**
+ * Host model of the transmit side of one CAN controller at one bit time per step.
+ *
+ * The bus sends a buffer at a time with 3 bits of interframe space.  The controller starts the
+ * next waiting buffer (lowest TPM, then the lowest buffer number) right after that, and the TX
+ * interrupt runs isr_bits after the end of a frame to load the queued messages.  The tasks
+ * that call CAN_tx() are modeled as periodic producers, plus a bulk producer (like a file
+ * transfer) that queues a low priority message whenever the queue has space.
+ *
+ * The legacy model is the driver before this queue: only TX1 is used, and the queue is a FIFO.
+ */
+typedef struct {
+    bool legacy;            ///< Model the driver that used one buffer and a FIFO queue
+    uint32_t isr_bits;      ///< Bit times from the end of a frame until the TX interrupt loads the buffers
+    uint32_t bus_bits;      ///< Bit times to run the model
+    uint32_t busy_bits;     ///< Bit times the bus was used, including the interframe space
+    uint32_t frames;        ///< Frames sent
+    uint32_t hp_frames;     ///< Frames sent of the high priority ID
+    uint32_t hp_worst;      ///< Worst bit times of the high priority ID from CAN_tx() until its frame was sent
+    bool in_order;          ///< The frames of each ID were sent in the order they were queued
+} test_can_txq_model_t;
+
+static inline void test_can_txq_model(test_can_txq_model_t *m)
+{
+    enum { qsize = 16, bulk_id = 0x700, num_periodic = 4 };
+    static const struct { uint32_t id; bool ext; uint32_t period; } periodic[num_periodic] = {
+        { 0x010, false, 997 },          /* The high priority ID */
+        { 0x100, false, 2500 },
+        { 0x0C8F00, true, 3100 },       /* Extended ID with a base ID of 3 */
+        { 0x300, false, 4000 },
+    };
+    uint32_t next_due[num_periodic] = { 0 };
+    uint32_t seq[num_periodic + 1] = { 0 };
+    uint32_t sent_seq[num_periodic + 1] = { 0 };
+    bool waiting[num_periodic] = { false };
+    can_msg_t pending[num_periodic];
+
+    can_txq_entry_t mem[qsize];
+    can_txq_t q;
+    can_msg_t fifo[qsize];
+    uint32_t fifo_head = 0, fifo_tail = 0;
+
+    can_msg_t hw[CAN_TXQ_HW_BUFS];
+    uint8_t free_mask = 0x7;
+    int tx_buf = -1;
+    uint32_t tx_end = 0, idle_at = 0, isr_at = UINT32_MAX;
+
+    can_txq_init(&q, mem, qsize);
+    m->busy_bits = m->frames = m->hp_frames = m->hp_worst = 0;
+    m->in_order = true;
+
+    for (uint32_t t = 0; t < m->bus_bits; t++) {
+        bool load = false;
+
+        /* Tasks queue their messages, the bulk task has the lowest priority */
+        for (int i = 0; i <= num_periodic; i++) {
+            const bool bulk = (num_periodic == i);
+            if (!bulk && !waiting[i] && t >= next_due[i]) {
+                pending[i] = test_can_txq_msg(periodic[i].id, periodic[i].ext, seq[i]++);
+                next_due[i] += periodic[i].period;
+                waiting[i] = true;
+            }
+            if (bulk || waiting[i]) {
+                can_msg_t msg = bulk ? test_can_txq_msg(bulk_id, false, seq[i]) : pending[i];
+                msg.data.dwords[1] = t;
+                bool queued = false;
+                if (m->legacy) {
+                    if (fifo_head - fifo_tail < qsize) {
+                        fifo[fifo_head++ % qsize] = msg;
+                        queued = true;
+                    }
+                }
+                else {
+                    queued = can_txq_push(&q, &msg);
+                }
+                if (queued) {
+                    load = true;
+                    if (bulk) { seq[i]++; } else { waiting[i] = false; }
+                }
+            }
+        }
+
+        /* CAN_tx() loads the buffers after it queues, as does the TX interrupt */
+        if (isr_at == t) {
+            isr_at = UINT32_MAX;
+            load = true;
+        }
+        while (load) {
+            if (m->legacy) {
+                load = (free_mask & 1) && fifo_head != fifo_tail;
+                if (load) {
+                    hw[0] = fifo[fifo_tail++ % qsize];
+                    free_mask &= ~1;
+                }
+            }
+            else {
+                can_msg_t msg;
+                uint8_t buf;
+                load = can_txq_next(&q, free_mask, &msg, &buf);
+                if (load) {
+                    assert(free_mask & (1 << buf));
+                    hw[buf] = msg;
+                    free_mask &= ~(1 << buf);
+                }
+            }
+        }
+
+        /* The end of the frame on the bus frees its buffer and interrupts */
+        if (tx_buf >= 0 && t == tx_end) {
+            const can_msg_t *msg = &hw[tx_buf];
+            int i = num_periodic;
+            while (i > 0 && periodic[i - 1].id != msg->msg_id) {
+                i--;
+            }
+            i = (0 == i) ? num_periodic : i - 1;
+
+            m->in_order = m->in_order && (msg->data.dwords[0] == sent_seq[i]++);
+            if (0 == i) {
+                const uint32_t latency = t - msg->data.dwords[1];
+                m->hp_worst = (latency > m->hp_worst) ? latency : m->hp_worst;
+                m->hp_frames++;
+            }
+            m->frames++;
+            free_mask |= (1 << tx_buf);
+            tx_buf = -1;
+            idle_at = t + 3;
+            if (isr_at == UINT32_MAX) {
+                isr_at = t + m->isr_bits;
+            }
+        }
+
+        /* The controller starts the waiting buffer with the lowest TPM (or the lowest buffer number) */
+        if (tx_buf < 0 && t >= idle_at) {
+            for (int b = 0; b < CAN_TXQ_HW_BUFS; b++) {
+                if (!(free_mask & (1 << b)) &&
+                    (tx_buf < 0 || (hw[b].frame & CAN_TXQ_TPM_MASK) < (hw[tx_buf].frame & CAN_TXQ_TPM_MASK))) {
+                    tx_buf = b;
+                }
+            }
+            if (tx_buf >= 0) {
+                const uint32_t bits = test_can_txq_frame_bits(&hw[tx_buf]);
+                tx_end = t + bits;
+                m->busy_bits += bits + 3;
+            }
+        }
+    }
+}
+
+static inline void test_can_txq(void)
+{
+    can_txq_entry_t mem[8];
+    can_txq_t q;
+    can_msg_t msg, msgs[4];
+    uint8_t buf = 0;
+
+    /* Arbitration: lower ID, then standard before extended, then data before RTR */
+    msgs[0] = test_can_txq_msg(0x100, false, 0);
+    msgs[1] = test_can_txq_msg(0x100 << 18, true, 0);
+    msgs[2] = test_can_txq_msg(0x100, false, 0);
+    msgs[2].frame_fields.is_rtr = 1;
+    msgs[3] = test_can_txq_msg(0x101, false, 0);
+    assert(can_txq_arb_key(&msgs[0]) < can_txq_arb_key(&msgs[2]));
+    assert(can_txq_arb_key(&msgs[2]) < can_txq_arb_key(&msgs[1]));
+    assert(can_txq_arb_key(&msgs[1]) < can_txq_arb_key(&msgs[3]));
+    msgs[2] = test_can_txq_msg((0x100 << 18) | 1, true, 0);
+    assert(can_txq_arb_key(&msgs[1]) < can_txq_arb_key(&msgs[2]));
+    assert(can_txq_arb_key(&msgs[2]) < can_txq_arb_key(&msgs[3]));
+
+    /* The head is the highest priority, and the same IDs keep their order */
+    can_txq_init(&q, mem, 8);
+    assert(!can_txq_next(&q, 0x7, &msg, &buf));
+    const uint32_t ids[] = { 0x300, 0x200, 0x300, 0x100, 0x200, 0x300 };
+    for (uint32_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        msg = test_can_txq_msg(ids[i], false, i);
+        msg.frame |= 0x55; /* TPM bits of the caller are ignored */
+        assert(can_txq_push(&q, &msg));
+    }
+    assert(6 == can_txq_get_count(&q));
+    assert(!can_txq_next(&q, 0, &msg, &buf));
+    assert(can_txq_next(&q, 0x7, &msg, &buf) && 0x100 == msg.msg_id && 0 == buf && 128 == (msg.frame & 0xFF));
+    assert(can_txq_next(&q, 0x6, &msg, &buf) && 0x200 == msg.msg_id && 1 == msg.data.dwords[0] && 1 == buf);
+    assert(129 == (msg.frame & 0xFF));
+    assert(can_txq_next(&q, 0x4, &msg, &buf) && 0x200 == msg.msg_id && 4 == msg.data.dwords[0] && 2 == buf);
+    assert(130 == (msg.frame & 0xFF));
+    assert(3 == can_txq_get_count(&q));
+
+    /* TX2 is sent, and 0x050 goes before all of the buffers */
+    msg = test_can_txq_msg(0x050, false, 0);
+    assert(can_txq_push(&q, &msg));
+    assert(can_txq_next(&q, 0x2, &msg, &buf) && 0x050 == msg.msg_id && 1 == buf && 127 == (msg.frame & 0xFF));
+
+    /* TX2 is sent, and 0x150 goes between 0x100 at 128 and 0x200 at 130 */
+    msg = test_can_txq_msg(0x150, false, 0);
+    assert(can_txq_push(&q, &msg));
+    assert(can_txq_next(&q, 0x2, &msg, &buf) && 0x150 == msg.msg_id && 1 == buf && 129 == (msg.frame & 0xFF));
+
+    /* TX1 is sent, and there is no value between 0x150 at 129 and 0x200 at 130 for 0x180 */
+    msg = test_can_txq_msg(0x180, false, 0);
+    assert(can_txq_push(&q, &msg));
+    assert(!can_txq_next(&q, 0x1, &msg, &buf));
+    assert(4 == can_txq_get_count(&q));
+
+    /* TX2 is sent, so 0x180 goes before 0x200, and the 0x300s after it in their order */
+    assert(can_txq_next(&q, 0x3, &msg, &buf) && 0x180 == msg.msg_id && 0 == buf && 129 == (msg.frame & 0xFF));
+    assert(can_txq_next(&q, 0x2, &msg, &buf) && 0x300 == msg.msg_id && 0 == msg.data.dwords[0] && 1 == buf);
+    assert(131 == (msg.frame & 0xFF));
+    assert(!can_txq_next(&q, 0, &msg, &buf));
+    assert(2 == can_txq_get_count(&q));
+
+    /* The model keeps the bus busier, and the high priority ID waits less */
+    test_can_txq_model_t legacy = { true, 20, 400 * 1000, 0, 0, 0, 0, false }, prio = legacy;
+    prio.legacy = false;
+    test_can_txq_model(&legacy);
+    test_can_txq_model(&prio);
+    assert(legacy.in_order && prio.in_order);
+    assert(legacy.hp_frames > 390 && prio.hp_frames > 390);
+    assert(prio.busy_bits > legacy.busy_bits + legacy.bus_bits / 20);
+    assert(prio.busy_bits > prio.bus_bits * 98 / 100);
+    assert(prio.hp_worst * 4 < legacy.hp_worst);
+
+    puts("\nCAN TX Queue Tests Successful!");
+}
+
+#ifndef __arm__
+/// Host only benchmark of the bus load and the high priority latency of each driver design
+static inline void test_can_txq_benchmark(void)
+{
+    const uint32_t isr_bits[] = { 5, 20, 50, 100 };
+
+    printf("\n%-12s %16s %16s %18s %18s\n", "ISR latency", "Legacy bus load", "Queue bus load",
+           "Legacy worst 0x010", "Queue worst 0x010");
+    for (uint32_t i = 0; i < sizeof(isr_bits) / sizeof(isr_bits[0]); i++) {
+        test_can_txq_model_t legacy = { true, isr_bits[i], 2000 * 1000, 0, 0, 0, 0, false }, prio = legacy;
+        prio.legacy = false;
+        test_can_txq_model(&legacy);
+        test_can_txq_model(&prio);
+
+        char name[16];
+        snprintf(name, sizeof(name), "%u bits", isr_bits[i]);
+        printf("%-12s %15.1f%% %15.1f%% %13u bits %13u bits\n", name,
+               legacy.busy_bits * 100.0 / legacy.bus_bits, prio.busy_bits * 100.0 / prio.bus_bits,
+               legacy.hp_worst, prio.hp_worst);
+    }
+    puts("Worst is from CAN_tx() of 0x010 until the end of its frame; a frame of 8 bytes is 111 bits");
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CAN_TXQ_H__ */
@@ -0,0 +1,130 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @ingroup Drivers
+ * @brief General Purpose DMA (GPDMA) channels shared by the drivers
+ *
+ * The GPDMA has one interrupt for its eight channels.  A driver attaches a callback to
+ * each channel it uses, and the DMA interrupt calls the callback of each channel that has
+ * a terminal count or an error.
+ *
+ * Channel 0 has the highest priority.  The SSP1 DMA (spi_dma.c) polls channels 0 and 1,
+ * and the UART DMA uses the channels listed by LPC_DMA_CH_UARTn_RX and LPC_DMA_CH_UARTn_TX.
+ *
+ * The GPDMA can only access the AHB SRAM (0x2007C000), which holds the global memory
+ * and the heap; the buffers and linked list items must not be in the 0x10000000 SRAM.
+ */
+#ifndef LPC_DMA_H__
+#define LPC_DMA_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include "LPC17xx.h"
+
+
+
+#define LPC_DMA_NUM_CHANNELS    8
+#define LPC_DMA_MAX_TRANSFER    0xFFF       ///< Max transfers of one channel (or linked list item)
+
+/** @{ Channels used by the UARTs (receive has the higher priority) */
+#define LPC_DMA_CH_UART0_RX     2
+#define LPC_DMA_CH_UART0_TX     3
+#define LPC_DMA_CH_UART2_RX     4
+#define LPC_DMA_CH_UART2_TX     5
+#define LPC_DMA_CH_UART3_RX     6
+#define LPC_DMA_CH_UART3_TX     7
+/** @} */
+
+/** @{ Peripheral numbers of the DMA requests (DMAREQSEL selects the UARTs instead of the timer matches) */
+#define LPC_DMA_REQ_UART0_TX    8
+#define LPC_DMA_REQ_UART0_RX    9
+#define LPC_DMA_REQ_UART2_TX    12
+#define LPC_DMA_REQ_UART2_RX    13
+#define LPC_DMA_REQ_UART3_TX    14
+#define LPC_DMA_REQ_UART3_RX    15
+/** @} */
+
+/** @{ Bits of DMACCControl */
+#define LPC_DMA_CTRL_SIZE(n)        ((n) & LPC_DMA_MAX_TRANSFER)    ///< Number of transfers
+#define LPC_DMA_CTRL_SRC_BURST(b)   ((b) << 12)     ///< 0:1, 1:4, 2:8, 3:16 transfers
+#define LPC_DMA_CTRL_DST_BURST(b)   ((b) << 15)     ///< 0:1, 1:4, 2:8, 3:16 transfers
+#define LPC_DMA_CTRL_SRC_INC        (1 << 26)
+#define LPC_DMA_CTRL_DST_INC        (1 << 27)
+#define LPC_DMA_CTRL_TC_INT         (1UL << 31)     ///< Terminal count interrupt when this transfer completes
+/** @} */
+
+/** @{ Bits of DMACCConfig */
+#define LPC_DMA_CFG_ENABLE          (1 << 0)
+#define LPC_DMA_CFG_SRC_REQ(n)      ((n) << 1)
+#define LPC_DMA_CFG_DST_REQ(n)      ((n) << 6)
+#define LPC_DMA_CFG_MEM_TO_PERIPH   (1 << 11)
+#define LPC_DMA_CFG_PERIPH_TO_MEM   (2 << 11)
+#define LPC_DMA_CFG_ERR_INT         (1 << 14)
+#define LPC_DMA_CFG_TC_INT          (1 << 15)
+/** @} */
+
+/// Linked list item that the GPDMA loads into a channel after a transfer completes (16 byte aligned is not required)
+typedef struct {
+    uint32_t src;       ///< DMACCSrcAddr
+    uint32_t dst;       ///< DMACCDestAddr
+    uint32_t next;      ///< DMACCLLI: Address of the next item, or 0
+    uint32_t control;   ///< DMACCControl
+} lpc_dma_lli_t;
+
+/**
+ * Callback of a channel, called from the DMA interrupt
+ * @param arg    The argument given to lpc_dma_attach()
+ * @param error  True if the channel had an error (the channel is then disabled)
+ * @returns true if a context switch is required (such as xTaskNotifyFromISR() woke a task)
+ */
+typedef bool (*lpc_dma_callback_t)(void *arg, bool error);
+
+/// Powers up and enables the GPDMA and its interrupt (more calls do nothing)
+void lpc_dma_init(void);
+
+/**
+ * Attaches the callback of a channel
+ * @returns false if the channel number is invalid or the channel already has a callback
+ */
+bool lpc_dma_attach(uint8_t channel, lpc_dma_callback_t callback, void *arg);
+
+/// @returns the registers of a channel
+static inline LPC_GPDMACH_TypeDef* lpc_dma_get_channel(uint8_t channel)
+{
+    return (LPC_GPDMACH_TypeDef*) (LPC_GPDMACH0_BASE + channel * 0x20);
+}
+
+/**
+ * Loads the first transfer (and its linked list) to a channel and enables it.
+ * The channel must not be enabled.
+ */
+void lpc_dma_start(uint8_t channel, const lpc_dma_lli_t *first, uint32_t config);
+
+/// Disables a channel, losing the data in its FIFO
+void lpc_dma_stop(uint8_t channel);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LPC_DMA_H__ */
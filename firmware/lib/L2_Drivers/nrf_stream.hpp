@@ -58,6 +58,8 @@ class NordicStream : public CharDev, public SingletonTemplate<NordicStream>
         /** @{ Virtual function overrides for the base class to work */
         bool getChar(char* pInputChar, unsigned int timeout=portMAX_DELAY);
         bool putChar(char out, unsigned int timeout=portMAX_DELAY);
+        uint32_t read(void *pData, uint32_t len, unsigned int timeout=portMAX_DELAY);
+        uint32_t write(const void *pData, uint32_t len, unsigned int timeout=portMAX_DELAY);
         /** @} */
 
     private:
@@ -70,11 +70,17 @@ void rtc_init (void);
 rtc_t rtc_gettime (void);
 
 /**
- * Sets the RTC time
+ * Sets the RTC time, and then calls rtc_settime_hook()
  * @param [in] rtcstruct  The rtc time structure pointer
  */
 void rtc_settime (const rtc_t* rtcstruct);
 
+/**
+ * Called by rtc_settime() after the time is changed.  The default hook does nothing, and
+ * rtc_alarm.c overrides it to schedule the RTC alarms from the new time.
+ */
+void rtc_settime_hook(void);
+
 /**
  * Get the RTC time as string in the format: "Wed Feb 13 15:46:11 2013"
  * @returns the pointer to the time string (do not modify it)
@@ -15,13 +15,17 @@
  *     You can reach the author of this software at :
  *          p r e e t . w i k i @ g m a i l . c o m
  */
+#include <stdlib.h>
 #include <string.h>
 
 #include "FreeRTOS.h"
 #include "queue.h"
+#include "semphr.h"
 #include "task.h"
 
 #include "can.h"
+#include "can_filter.h"
+#include "can_txq.h"
 #include "LPC17xx.h"
 #include "sys_config.h"
 #include "lpc_sys.h"    // sys_get_uptime_ms()
@@ -103,7 +107,7 @@ enum {
     can_mod_normal = 0x00, ///< CAN MOD register value to enable the BUS
     can_mod_reset  = 0x01, ///< CAN MOD register value to reset the BUS
     can_mod_normal_tpm = (can_mod_normal | (1 << 3)), ///< CAN bus enabled with TPM mode bits set
-    can_mod_selftest   = (1 << 2) | can_mod_normal,   ///< Used to enable global self-test
+    can_mod_selftest   = (1 << 2) | can_mod_normal_tpm, ///< Used to enable global self-test
 };
 
 /// Mask of the PCONP register
@@ -115,11 +119,12 @@ enum {
 /// Typedef of CAN queues and data
 typedef struct {
     LPC_CAN_TypeDef *pCanRegs;      ///< The pointer to the CAN registers
-    QueueHandle_t rxQ;              ///< TX queue
-    QueueHandle_t txQ;              ///< RX queue
+    QueueHandle_t rxQ;              ///< RX queue
+    SemaphoreHandle_t txSpace;      ///< Counts the free entries of txQ
+    can_txq_t txQ;                  ///< TX queue in the order of CAN ID priority
     uint16_t droppedRxMsgs;         ///< Number of messages dropped if no space found during the CAN interrupt that queues the RX messages
     uint16_t rxQWatermark;          ///< Watermark of the FreeRTOS Rx Queue
-    uint16_t txQWatermark;          ///< Watermark of the FreeRTOS Tx Queue
+    uint16_t txQWatermark;          ///< Watermark of the Tx Queue
     uint16_t txMsgCount;            ///< Number of messages sent
     uint16_t rxMsgCount;            ///< Number of received messages
     can_void_func_t bus_error;      ///< When serious BUS error occurs
@@ -139,74 +144,89 @@ static const can_intr_t g_can_bus_err_intr = intr_epi;
 
 /** @{ Private functions */
 /**
- * Sends a message using an available buffer.  Initially this chose one out of the three buffers but that's
- * a little tricky to use when messages are always queued since one of the 3 buffers can be starved and not
- * get sent.  So therefore some of that logic is #ifdef'd out to only use one HW buffer.
- *
- * @returns true if the message was written to the HW buffer to be sent, otherwise false if the HW buffer(s) are busy.
- *
- * Notes:
- *  - Using the TX message counter and the TPM bit, we can ensure that the HW chooses between the TX1/TX2/TX3
- *    in a round-robin fashion otherwise there is a possibility that if the CAN Tx queue is always full,
- *    a low message ID can be starved even if it was amongst the first ones written using this method call.
+ * Loads the queued messages to the free HW buffers in the order of their CAN ID priority.
+ * All three buffers are used, and the TPM field of each message decides which of the loaded
+ * buffers the HW sends first, @see can_txq.h
  *
+ * @returns the number of messages written to the HW buffers, which is the number of entries freed in the queue
  * @warning This should be called from critical section since this method is not thread-safe
  */
-static bool CAN_tx_now (can_struct_t *struct_ptr, can_msg_t *msg_ptr)
+static uint32_t CAN_tx_load(can_struct_t *struct_ptr)
 {
-    // 32-bit command of CMR register to start transmission of one of the buffers
-    enum {
-        go_cmd_invalid = 0,
-        go_cmd_tx1 = 0x21,
-        go_cmd_tx2 = 0x41,
-        go_cmd_tx3 = 0x81,
-    };
+    // 32-bit command of CMR register to start transmission of each of the buffers
+    static const uint32_t go_cmd[CAN_TXQ_HW_BUFS] = { 0x21, 0x41, 0x81 };
 
     LPC_CAN_TypeDef *pCAN = struct_ptr->pCanRegs;
+    volatile can_msg_t *pHwMsgRegs[CAN_TXQ_HW_BUFS] = {
+        (can_msg_t*)&(pCAN->TFI1), (can_msg_t*)&(pCAN->TFI2), (can_msg_t*)&(pCAN->TFI3)
+    };
     const uint32_t can_sr_reg = pCAN->SR;
-    volatile can_msg_t *pHwMsgRegs = NULL;
-    uint32_t go_cmd = go_cmd_invalid;
+    uint8_t free_mask = ((can_sr_reg & tx1_avail) ? 1 : 0) |
+                        ((can_sr_reg & tx2_avail) ? 2 : 0) |
+                        ((can_sr_reg & tx3_avail) ? 4 : 0);
+    uint32_t loaded = 0;
+    uint32_t go;
+    uint8_t buf;
+    can_msg_t msg;
 
-    if (can_sr_reg & tx1_avail){
-        pHwMsgRegs = (can_msg_t*)&(pCAN->TFI1);
-        go_cmd = go_cmd_tx1;
+    while (can_txq_next(&(struct_ptr->txQ), free_mask, &msg, &buf)) {
+        *pHwMsgRegs[buf] = msg;
+        free_mask &= ~(1 << buf);
+        struct_ptr->txMsgCount++;
+        loaded++;
+
+        go = go_cmd[buf];
+        #if CAN_TESTING
+        go |= (1 << 4); /* Self reception request instead of transmission request */
+        go &= ~(1 << 0);
+        #endif
+
+        /* Send the message! */
+        pCAN->CMR = go;
     }
-#if 0
-    else if (can_sr_reg & tx2_avail){
-        pHwMsgRegs = (can_msg_t*)&(pCAN->TFI2);
-        go_cmd = go_cmd_tx2;
+
+    return loaded;
+}
+
+/**
+ * Loads the queued messages, and gives back the queue entries that were freed.
+ * This is also needed after the bus is reset since the buffers become free without an interrupt,
+ * and the bus may be reset by the bus_off_cb from the CAN interrupt, so this works from an ISR too.
+ */
+static void CAN_tx_start(can_struct_t *pStruct)
+{
+    const bool in_isr = xPortIsInsideInterrupt();
+    UBaseType_t saved_mask = 0;
+    UBaseType_t count;
+    uint32_t loaded = 0;
+
+    if (in_isr) {
+        saved_mask = taskENTER_CRITICAL_FROM_ISR();
     }
-    else if (can_sr_reg & tx3_avail){
-        pHwMsgRegs = (can_msg_t*)&(pCAN->TFI3);
-        go_cmd = go_cmd_tx3;
+    else {
+        taskENTER_CRITICAL();
+    }
+    do {
+        loaded = CAN_tx_load(pStruct);
+        if ((count = can_txq_get_count(&(pStruct->txQ))) > pStruct->txQWatermark) {
+            pStruct->txQWatermark = count;
+        }
+    } while(0);
+    if (in_isr) {
+        taskEXIT_CRITICAL_FROM_ISR(saved_mask);
     }
-#endif
     else {
-        /* No buffer available, return failure */
-        return false;
+        taskEXIT_CRITICAL();
     }
 
-    /* Copy the CAN message to the HW CAN registers and write the 8 TPM bits.
-     * We set TPM bits each time by using the txMsgCount because otherwise if TX1, and TX2 are always
-     * being written with a lower message ID, then TX3 will starve and never be sent.
-     */
-#if 0
-    // Higher number will be sent later, but how do we handle the rollover from 255 to 0 because then the
-    // newly written 0 will be sent, and buffer that contains higher TPM can starve.
-    const uint8_t tpm = struct_ptr->txMsgCount;
-    msg_ptr->frame |= tpm;
-#endif
-    *pHwMsgRegs = *msg_ptr;
-    struct_ptr->txMsgCount++;
-
-    #if CAN_TESTING
-    go_cmd &= (0xF0);
-    go_cmd = (1 << 4); /* Self reception */
-    #endif
-
-    /* Send the message! */
-    pCAN->CMR = go_cmd;
-    return true;
+    while (loaded--) {
+        if (in_isr) {
+            xSemaphoreGiveFromISR(pStruct->txSpace, NULL);
+        }
+        else {
+            xSemaphoreGive(pStruct->txSpace);
+        }
+    }
 }
 
 static void CAN_handle_isr(const can_t can)
@@ -216,7 +236,6 @@ static void CAN_handle_isr(const can_t can)
     const uint32_t rbs = (1 << 0);
     const uint32_t ibits = pCAN->ICR;
     UBaseType_t count;
-    can_msg_t msg;
 
     /* Handle the received message */
     if ((ibits & intr_rx) | (pCAN->GSR & rbs)) {
@@ -234,13 +253,11 @@ static void CAN_handle_isr(const can_t can)
         pCAN->CMR = 0x04; // Release the receive buffer, no need to bitmask
     }
 
-    /* A transmit finished, send any queued message(s) */
+    /* A transmit finished, send the queued message(s) in the free buffers */
     if (ibits & intr_all_tx) {
-        if( (count = uxQueueMessagesWaitingFromISR(pStruct->txQ)) > pStruct->txQWatermark) {
-            pStruct->txQWatermark = count;
-        }
-        if (xQueueReceiveFromISR(pStruct->txQ, &msg, NULL)) {
-            CAN_tx_now(pStruct, &msg);
+        count = CAN_tx_load(pStruct);
+        while (count--) {
+            xSemaphoreGiveFromISR(pStruct->txSpace, NULL);
         }
     }
 
@@ -313,8 +330,14 @@ bool CAN_init(can_t can, uint32_t baudrate_kbps, uint16_t rxq_size, uint16_t txq
     if (!pStruct->rxQ) {
         pStruct->rxQ = xQueueCreate(rxq_size ? rxq_size : 1, sizeof(can_msg_t));
     }
-    if (!pStruct->txQ) {
-        pStruct->txQ = xQueueCreate(txq_size ? txq_size : 1, sizeof(can_msg_t));
+    if (!pStruct->txSpace) {
+        txq_size = txq_size ? txq_size : 1;
+        can_txq_entry_t *mem = malloc(txq_size * sizeof(can_txq_entry_t));
+        if (!mem || !(pStruct->txSpace = xSemaphoreCreateCounting(txq_size, txq_size))) {
+            free(mem);
+            return false;
+        }
+        can_txq_init(&(pStruct->txQ), mem, txq_size);
     }
 
     /* The CAN dividers must all be the same for both CANs
@@ -417,44 +440,25 @@ bool CAN_tx (can_t can, can_msg_t *pCanMsg, uint32_t timeout_ms)
         return false;
     }
 
-    bool ok = false;
     can_struct_t *pStruct = CAN_STRUCT_PTR(can);
-    LPC_CAN_TypeDef *CANx = pStruct->pCanRegs;
+    const TickType_t timeout = (taskSCHEDULER_RUNNING == xTaskGetSchedulerState()) ? OS_MS(timeout_ms) : 0;
+
+    /* Wait for a free entry in the queue; entries are given back as messages are loaded to the HW buffers */
+    if (!xSemaphoreTake(pStruct->txSpace, timeout)) {
+        return false;
+    }
 
-    /* Try transmitting to one of the available buffers */
+    /* Queue the message in the order of its priority, and load it right away if a HW buffer is free.
+     * The queue always has room since we took one of its entries.
+     */
     taskENTER_CRITICAL();
     do {
-        ok = CAN_tx_now(pStruct, pCanMsg);
+        can_txq_push(&(pStruct->txQ), pCanMsg);
     } while(0);
     taskEXIT_CRITICAL();
 
-    /* If HW buffer not available, then just queue the message */
-    if (!ok) {
-        if (taskSCHEDULER_RUNNING == xTaskGetSchedulerState()) {
-            ok = xQueueSend(pStruct->txQ, pCanMsg, OS_MS(timeout_ms));
-        }
-        else {
-            ok = xQueueSend(pStruct->txQ, pCanMsg, 0);
-        }
-
-        /* There is possibility that before we queued the message, we got interrupted
-         * and all hw buffers were emptied meanwhile, and our queued message will now
-         * sit in the queue forever until another Tx interrupt takes place.
-         * So we dequeue it here if all are empty and send it over.
-         */
-        taskENTER_CRITICAL();
-        do {
-            can_msg_t msg;
-            if (tx_all_avail == (CANx->SR & tx_all_avail) &&
-                xQueueReceive(pStruct->txQ, &msg, 0)
-            ) {
-                ok = CAN_tx_now(pStruct, &msg);
-            }
-        } while(0);
-        taskEXIT_CRITICAL();
-    }
-
-    return ok;
+    CAN_tx_start(pStruct);
+    return true;
 }
 
 bool CAN_rx (can_t can, can_msg_t *pCanMsg, uint32_t timeout_ms)
@@ -495,6 +499,9 @@ void CAN_reset_bus(can_t can)
         #else
             CAN_STRUCT_PTR(can)->pCanRegs->MOD = can_mod_normal_tpm;
         #endif
+
+        /* Send the messages that were queued while the bus was off */
+        CAN_tx_start(CAN_STRUCT_PTR(can));
     }
 }
 
@@ -747,6 +754,32 @@ bool CAN_setup_filter(const can_std_id_t *std_id_list,           uint16_t sid_cn
     return ok;
 }
 
+bool CAN_setup_filter_table(const can_filter_table_t *table)
+{
+    uint32_t i = 0;
+
+    if (!table || table->used_bytes > sizeof(LPC_CANAF_RAM->mask)) {
+        return false;
+    }
+
+    LPC_CANAF->AFMR = afmr_disabled;
+    do {
+        /* Copy the table, and clear the FullCAN messages after it */
+        for (i = 0; i < sizeof(LPC_CANAF_RAM->mask) / sizeof(LPC_CANAF_RAM->mask[0]); i++) {
+            LPC_CANAF_RAM->mask[i] = (i < table->end_of_table / 4) ? table->ram[i] : 0;
+        }
+
+        LPC_CANAF->SFF_sa     = table->sff_sa;
+        LPC_CANAF->SFF_GRP_sa = table->sff_grp_sa;
+        LPC_CANAF->EFF_sa     = table->eff_sa;
+        LPC_CANAF->EFF_GRP_sa = table->eff_grp_sa;
+        LPC_CANAF->ENDofTable = table->end_of_table;
+    } while(0);
+    LPC_CANAF->AFMR = (0 == table->fullcan_entries) ? afmr_enabled : afmr_fullcan;
+
+    return true;
+}
+
 #if CAN_TESTING
 #include <printf_lib.h>
 #define CAN_ASSERT(x)   if (!(x)) { u0_dbg_printf("Failed at %i, BUS: %s MOD: 0x%08x, GSR: 0x%08x\n"\
@@ -0,0 +1,303 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "can_filter.h"
+
+
+
+#define CAN_FILTER_STD_MAX      0x7FF       ///< Max 11-bit ID
+#define CAN_FILTER_EXT_MAX      0x1FFFFFFF  ///< Max 29-bit ID
+#define CAN_FILTER_STD_DISABLED 0xFFFF      ///< Disabled standard entry that sorts after all others (SCC 7)
+#define CAN_FILTER_STD_DIS_BIT  (1 << 12)   ///< Disable bit of a standard entry
+
+
+
+/// Sort order of the ranges: type (the order of the sections), CAN, then the IDs
+static int can_filter_range_cmp(const void *p1, const void *p2)
+{
+    const can_filter_range_t *r1 = (const can_filter_range_t*) p1;
+    const can_filter_range_t *r2 = (const can_filter_range_t*) p2;
+
+    if (r1->type != r2->type) {
+        return (r1->type < r2->type) ? -1 : 1;
+    }
+    if (r1->can != r2->can) {
+        return (r1->can < r2->can) ? -1 : 1;
+    }
+    if (r1->low != r2->low) {
+        return (r1->low < r2->low) ? -1 : 1;
+    }
+    return (r1->high < r2->high) ? -1 : (r1->high > r2->high);
+}
+
+/// @returns the 16-bit standard entry of the hardware
+static inline uint16_t can_filter_std_entry(uint8_t can, uint32_t id)
+{
+    return (can << 13) | id;
+}
+
+/// @returns the sort key of a standard entry: SCC and the ID without the disable and interrupt bits
+static inline uint32_t can_filter_std_key(uint16_t entry)
+{
+    return ((entry >> 13) << 11) | (entry & CAN_FILTER_STD_MAX);
+}
+
+/**
+ * Standard entries are two per word: the first one is the upper half-word and the second
+ * one is the lower half-word, @see CAN_setup_filter()
+ */
+static inline void can_filter_put_std(can_filter_table_t *table, uint32_t offset, uint16_t entry)
+{
+    uint32_t *word = &(table->ram[offset / 4]);
+    *word = (offset % 4) ? ((*word & 0xFFFF0000) | entry) : ((*word & 0xFFFF) | ((uint32_t) entry << 16));
+}
+
+static inline uint16_t can_filter_get_std(const can_filter_table_t *table, uint32_t offset)
+{
+    const uint32_t word = table->ram[offset / 4];
+    return (offset % 4) ? (word & 0xFFFF) : (word >> 16);
+}
+
+/// @returns the index of the last standard entry of the section whose key is <= key, or -1
+static int can_filter_search_std(const can_filter_table_t *table, uint32_t start, uint32_t count,
+                                 uint32_t step, uint32_t key)
+{
+    int lo = 0, hi = (int) count - 1, found = -1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        if (can_filter_std_key(can_filter_get_std(table, start + mid * step)) <= key) {
+            found = mid;
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+/// @returns the index of the last extended entry of the section whose key is <= key, or -1
+static int can_filter_search_ext(const can_filter_table_t *table, uint32_t start, uint32_t count,
+                                 uint32_t step, uint32_t key)
+{
+    int lo = 0, hi = (int) count - 1, found = -1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        if (table->ram[(start + mid * step) / 4] <= key) {
+            found = mid;
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+
+
+void can_filter_init(can_filter_t *f, can_filter_range_t *mem, uint16_t max)
+{
+    f->ranges = mem;
+    f->max = max;
+    f->count = 0;
+}
+
+static bool can_filter_add_type(can_filter_t *f, can_t can, can_filter_type_t type, uint32_t low, uint32_t high)
+{
+    const uint32_t max_id = (can_filter_ext == type) ? CAN_FILTER_EXT_MAX : CAN_FILTER_STD_MAX;
+
+    if (!(can1 == can || can2 == can) || low > high || high > max_id || f->count >= f->max) {
+        return false;
+    }
+
+    can_filter_range_t *r = &(f->ranges[f->count++]);
+    r->low = low;
+    r->high = high;
+    r->can = can;
+    r->type = type;
+    return true;
+}
+
+bool can_filter_add_range(can_filter_t *f, can_t can, bool is_29bit, uint32_t low, uint32_t high)
+{
+    return can_filter_add_type(f, can, is_29bit ? can_filter_ext : can_filter_std, low, high);
+}
+
+bool can_filter_add_ids(can_filter_t *f, can_t can, bool is_29bit, const uint32_t *ids, uint32_t count)
+{
+    bool ok = true;
+    for (uint32_t i = 0; i < count && ok; i++) {
+        ok = can_filter_add(f, can, is_29bit, ids[i]);
+    }
+    return ok;
+}
+
+bool can_filter_add_fullcan(can_filter_t *f, can_t can, uint16_t id)
+{
+    return can_filter_add_type(f, can, can_filter_fullcan, id, id);
+}
+
+bool can_filter_compile(can_filter_t *f, can_filter_table_t *table)
+{
+    uint32_t i = 0, n = 0;
+
+    /* Sort the ranges, and merge the ranges of the same type and CAN that overlap or touch.
+     * FullCAN IDs are only merged if they are the same since each has its own message.
+     */
+    qsort(f->ranges, f->count, sizeof(f->ranges[0]), can_filter_range_cmp);
+    for (i = 0; i < f->count; i++) {
+        can_filter_range_t *last = (n > 0) ? &(f->ranges[n - 1]) : NULL;
+        const can_filter_range_t *r = &(f->ranges[i]);
+        const uint32_t touch = (can_filter_fullcan == r->type) ? 0 : 1;
+
+        if (last && last->type == r->type && last->can == r->can && r->low <= last->high + touch) {
+            last->high = (r->high > last->high) ? r->high : last->high;
+        }
+        else {
+            f->ranges[n++] = *r;
+        }
+    }
+    f->count = n;
+
+    /* Count the entries of each section: one ID is an entry of a list, and more are a group */
+    uint32_t fullcan = 0, sid = 0, sgrp = 0, eid = 0, egrp = 0;
+    for (i = 0; i < f->count; i++) {
+        const can_filter_range_t *r = &(f->ranges[i]);
+        const bool single = (r->low == r->high);
+        switch (r->type) {
+            case can_filter_fullcan : fullcan++;                            break;
+            case can_filter_std     : if (single) { sid++; } else { sgrp++; } break;
+            default                 : if (single) { eid++; } else { egrp++; } break;
+        }
+    }
+
+    /* Standard entries are in pairs, so an odd count uses a disabled entry */
+    const uint32_t fullcan_entries = fullcan + (fullcan & 1);
+    const uint32_t sid_entries = sid + (sid & 1);
+
+    memset(table, 0, sizeof(*table));
+    table->fullcan_entries = fullcan_entries;
+    table->sff_sa = 2 * fullcan_entries;
+    table->sff_grp_sa = table->sff_sa + 2 * sid_entries;
+    table->eff_sa = table->sff_grp_sa + 4 * sgrp;
+    table->eff_grp_sa = table->eff_sa + 4 * eid;
+    table->end_of_table = table->eff_grp_sa + 8 * egrp;
+
+    const uint32_t used = table->end_of_table + CAN_FILTER_FULLCAN_MSG * fullcan_entries;
+    table->used_bytes = (used > UINT16_MAX) ? UINT16_MAX : used;
+    if (used > CAN_FILTER_RAM_SIZE) {
+        return false;
+    }
+
+    /* Write each section in the sorted order */
+    uint32_t fc_off = 0, sid_off = table->sff_sa, sgrp_off = table->sff_grp_sa;
+    uint32_t eid_off = table->eff_sa, egrp_off = table->eff_grp_sa;
+    for (i = 0; i < f->count; i++) {
+        const can_filter_range_t *r = &(f->ranges[i]);
+        const bool single = (r->low == r->high);
+
+        if (can_filter_fullcan == r->type) {
+            can_filter_put_std(table, fc_off, can_filter_std_entry(r->can, r->low));
+            fc_off += 2;
+        }
+        else if (can_filter_std == r->type && single) {
+            can_filter_put_std(table, sid_off, can_filter_std_entry(r->can, r->low));
+            sid_off += 2;
+        }
+        else if (can_filter_std == r->type) {
+            can_filter_put_std(table, sgrp_off, can_filter_std_entry(r->can, r->low));
+            can_filter_put_std(table, sgrp_off + 2, can_filter_std_entry(r->can, r->high));
+            sgrp_off += 4;
+        }
+        else if (single) {
+            table->ram[eid_off / 4] = ((uint32_t) r->can << 29) | r->low;
+            eid_off += 4;
+        }
+        else {
+            table->ram[egrp_off / 4] = ((uint32_t) r->can << 29) | r->low;
+            table->ram[egrp_off / 4 + 1] = ((uint32_t) r->can << 29) | r->high;
+            egrp_off += 8;
+        }
+    }
+    if (fc_off < table->sff_sa) {
+        can_filter_put_std(table, fc_off, CAN_FILTER_STD_DISABLED);
+    }
+    if (sid_off < table->sff_grp_sa) {
+        can_filter_put_std(table, sid_off, CAN_FILTER_STD_DISABLED);
+    }
+
+    return true;
+}
+
+can_filter_result_t can_filter_lookup(const can_filter_table_t *table, can_t can, bool is_29bit, uint32_t id,
+                                      uint16_t *fc_idx)
+{
+    int idx = 0;
+
+    if (id > (is_29bit ? CAN_FILTER_EXT_MAX : CAN_FILTER_STD_MAX)) {
+        return can_filter_rejected;
+    }
+    if (is_29bit) {
+        const uint32_t key = ((uint32_t) can << 29) | id;
+
+        idx = can_filter_search_ext(table, table->eff_sa, (table->eff_grp_sa - table->eff_sa) / 4, 4, key);
+        if (idx >= 0 && table->ram[(table->eff_sa + idx * 4) / 4] == key) {
+            return can_filter_accepted;
+        }
+        idx = can_filter_search_ext(table, table->eff_grp_sa, (table->end_of_table - table->eff_grp_sa) / 8, 8, key);
+        if (idx >= 0 && key <= table->ram[(table->eff_grp_sa + idx * 8) / 4 + 1]) {
+            return can_filter_accepted;
+        }
+    }
+    else {
+        const uint32_t key = can_filter_std_key(can_filter_std_entry(can, id));
+        uint16_t entry = 0;
+
+        /* FullCAN entries, then the list of IDs, then the groups */
+        idx = can_filter_search_std(table, 0, table->sff_sa / 2, 2, key);
+        if (idx >= 0) {
+            entry = can_filter_get_std(table, idx * 2);
+            if (can_filter_std_key(entry) == key && !(entry & CAN_FILTER_STD_DIS_BIT)) {
+                if (fc_idx) {
+                    *fc_idx = idx;
+                }
+                return can_filter_to_fullcan;
+            }
+        }
+        idx = can_filter_search_std(table, table->sff_sa, (table->sff_grp_sa - table->sff_sa) / 2, 2, key);
+        if (idx >= 0) {
+            entry = can_filter_get_std(table, table->sff_sa + idx * 2);
+            if (can_filter_std_key(entry) == key && !(entry & CAN_FILTER_STD_DIS_BIT)) {
+                return can_filter_accepted;
+            }
+        }
+        idx = can_filter_search_std(table, table->sff_grp_sa, (table->eff_sa - table->sff_grp_sa) / 4, 4, key);
+        if (idx >= 0) {
+            entry = can_filter_get_std(table, table->sff_grp_sa + idx * 4 + 2);
+            if (key <= can_filter_std_key(entry)) {
+                return can_filter_accepted;
+            }
+        }
+    }
+
+    return can_filter_rejected;
+}
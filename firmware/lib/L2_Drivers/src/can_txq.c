@@ -0,0 +1,159 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>
+
+#include "can_txq.h"
+
+
+
+/// @returns true if the message of (key1, seq1) is sent before the message of (key2, seq2)
+static inline bool can_txq_before(uint32_t key1, uint32_t seq1, uint32_t key2, uint32_t seq2)
+{
+    return (key1 < key2) || (key1 == key2 && (int32_t)(seq1 - seq2) < 0);
+}
+
+static inline bool can_txq_entry_before(const can_txq_entry_t *e1, const can_txq_entry_t *e2)
+{
+    return can_txq_before(e1->key, e1->seq, e2->key, e2->seq);
+}
+
+
+
+void can_txq_init(can_txq_t *q, can_txq_entry_t *mem, uint16_t size)
+{
+    memset(q, 0, sizeof(*q));
+    q->heap = mem;
+    q->size = size;
+}
+
+uint32_t can_txq_arb_key(const can_msg_t *msg)
+{
+    const uint32_t rtr = msg->frame_fields.is_rtr;
+
+    if (msg->frame_fields.is_29bit) {
+        /* Base ID, SRR (always 1), IDE (1), the 18-bit extended ID, and RTR */
+        const uint32_t id = msg->msg_id & 0x1FFFFFFF;
+        return ((id >> 18) << 21) | (1 << 20) | (1 << 19) | ((id & 0x3FFFF) << 1) | rtr;
+    }
+    else {
+        /* Base ID, RTR, and IDE (0) */
+        return ((msg->msg_id & 0x7FF) << 21) | (rtr << 20);
+    }
+}
+
+bool can_txq_push(can_txq_t *q, const can_msg_t *msg)
+{
+    if (q->count >= q->size) {
+        return false;
+    }
+
+    can_txq_entry_t entry;
+    entry.msg = *msg;
+    entry.key = can_txq_arb_key(msg);
+    entry.seq = q->seq++;
+
+    /* Move the parents down until the entry is not before its parent */
+    uint32_t idx = q->count++;
+    while (idx > 0) {
+        const uint32_t parent = (idx - 1) / 2;
+        if (!can_txq_entry_before(&entry, &q->heap[parent])) {
+            break;
+        }
+        q->heap[idx] = q->heap[parent];
+        idx = parent;
+    }
+    q->heap[idx] = entry;
+
+    return true;
+}
+
+bool can_txq_next(can_txq_t *q, uint8_t free_mask, can_msg_t *msg, uint8_t *buf)
+{
+    const can_txq_entry_t *head = &q->heap[0];
+    int lo = -1;    /* Max TPM of the busy buffers that are sent before the head */
+    int hi = 256;   /* Min TPM of the busy buffers that are sent after the head */
+    int tpm = 0;
+    uint8_t b = 0;
+
+    free_mask &= (1 << CAN_TXQ_HW_BUFS) - 1;
+    if (0 == q->count || 0 == free_mask) {
+        return false;
+    }
+
+    for (b = 0; b < CAN_TXQ_HW_BUFS; b++) {
+        if (free_mask & (1 << b)) {
+            continue;
+        }
+        if (can_txq_before(q->hw[b].key, q->hw[b].seq, head->key, head->seq)) {
+            lo = (q->hw[b].tpm > lo) ? q->hw[b].tpm : lo;
+        }
+        else {
+            hi = (q->hw[b].tpm < hi) ? q->hw[b].tpm : hi;
+        }
+    }
+
+    /* Leave the head queued if there is no TPM value left for it */
+    if (hi - lo < 2) {
+        return false;
+    }
+    if (lo < 0 && hi > 255) {
+        tpm = CAN_TXQ_TPM_START;
+    }
+    else if (hi > 255) {
+        tpm = lo + 1;
+    }
+    else if (lo < 0) {
+        tpm = hi - 1;
+    }
+    else {
+        tpm = (lo + hi) / 2;
+    }
+
+    /* Any free buffer will do since the TPM values decide the order */
+    for (b = 0; !(free_mask & (1 << b)); b++) {
+        ;
+    }
+    *buf = b;
+    *msg = head->msg;
+    msg->frame = (msg->frame & ~CAN_TXQ_TPM_MASK) | tpm;
+    q->hw[b].key = head->key;
+    q->hw[b].seq = head->seq;
+    q->hw[b].tpm = tpm;
+
+    /* Move the last entry down from the top until its children are not before it */
+    const can_txq_entry_t last = q->heap[--q->count];
+    uint32_t idx = 0;
+    while (1) {
+        uint32_t child = 2 * idx + 1;
+        if (child >= q->count) {
+            break;
+        }
+        if (child + 1 < q->count && can_txq_entry_before(&q->heap[child + 1], &q->heap[child])) {
+            child++;
+        }
+        if (!can_txq_entry_before(&q->heap[child], &last)) {
+            break;
+        }
+        q->heap[idx] = q->heap[child];
+        idx = child;
+    }
+    q->heap[idx] = last;
+
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include "lpc_dma.h"
+#include "lpc_isr.h"
+#include "lpc_sys.h"
+#include "FreeRTOS.h"
+
+
+
+/// Callback and its argument of each channel
+static struct {
+    lpc_dma_callback_t callback;
+    void *arg;
+} g_dma_channels[LPC_DMA_NUM_CHANNELS];
+
+
+
+/** DMA Interrupt function (see startup.cpp) */
+void DMA_IRQHandler(void)
+{
+    const uint32_t tc = LPC_GPDMA->DMACIntTCStat;
+    const uint32_t err = LPC_GPDMA->DMACIntErrStat;
+    BaseType_t switch_required = 0;
+
+    /* Clear before the callbacks, which may start the next transfer of their channel */
+    LPC_GPDMA->DMACIntTCClear = tc;
+    LPC_GPDMA->DMACIntErrClr = err;
+
+    for (uint8_t ch = 0; ch < LPC_DMA_NUM_CHANNELS; ch++) {
+        const uint32_t mask = (1 << ch);
+        if (((tc | err) & mask) && g_dma_channels[ch].callback) {
+            if (g_dma_channels[ch].callback(g_dma_channels[ch].arg, !!(err & mask))) {
+                switch_required = 1;
+            }
+        }
+    }
+
+    portEND_SWITCHING_ISR(switch_required);
+}
+
+void lpc_dma_init(void)
+{
+    if (LPC_GPDMA->DMACConfig & 1) {
+        return;
+    }
+
+    lpc_pconp(pconp_gpdma, true);
+    LPC_GPDMA->DMACConfig = 1;
+    while (!(LPC_GPDMA->DMACConfig & 1));
+
+    /* The UART requests share their lines with the timer matches, select the UARTs */
+    LPC_SC->DMAREQSEL = 0;
+
+    vTraceSetISRProperties(DMA_IRQn, "DMA", IP_dma);
+    NVIC_EnableIRQ(DMA_IRQn);
+}
+
+bool lpc_dma_attach(uint8_t channel, lpc_dma_callback_t callback, void *arg)
+{
+    if (channel >= LPC_DMA_NUM_CHANNELS || g_dma_channels[channel].callback) {
+        return false;
+    }
+    g_dma_channels[channel].arg = arg;
+    g_dma_channels[channel].callback = callback;
+    return true;
+}
+
+void lpc_dma_start(uint8_t channel, const lpc_dma_lli_t *first, uint32_t config)
+{
+    LPC_GPDMACH_TypeDef *dma = lpc_dma_get_channel(channel);
+    const uint32_t mask = (1 << channel);
+
+    /* A pending terminal count or error prevents the channel from starting */
+    LPC_GPDMA->DMACIntTCClear = mask;
+    LPC_GPDMA->DMACIntErrClr = mask;
+
+    dma->DMACCSrcAddr = first->src;
+    dma->DMACCDestAddr = first->dst;
+    dma->DMACCLLI = first->next;
+    dma->DMACCControl = first->control;
+    dma->DMACCConfig = config;
+    dma->DMACCConfig = config | LPC_DMA_CFG_ENABLE;
+}
+
+void lpc_dma_stop(uint8_t channel)
+{
+    LPC_GPDMACH_TypeDef *dma = lpc_dma_get_channel(channel);
+    dma->DMACCConfig &= ~LPC_DMA_CFG_ENABLE;
+    while (dma->DMACCConfig & LPC_DMA_CFG_ENABLE);
+}
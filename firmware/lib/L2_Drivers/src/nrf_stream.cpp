@@ -20,6 +20,7 @@
 
 #include "nrf_stream.hpp"
 #include "wireless.h"
+#include "task.h"
 
 
 
@@ -77,6 +78,60 @@ bool NordicStream::putChar(char out, unsigned int timeout)
     return ok;
 }
 
+uint32_t NordicStream::read(void *pData, uint32_t len, unsigned int timeout)
+{
+    uint32_t available = 0;
+    if (mRxBuffer.dataPtr < mRxBuffer.pkt.info.data_len) {
+        available = mRxBuffer.pkt.info.data_len - mRxBuffer.dataPtr;
+    }
+
+    /* If no buffered data, then try to get new packet from nordic wireless */
+    if (0 == available && len > 0) {
+        if (wireless_get_rx_pkt(&(mRxBuffer.pkt), timeout)) {
+            mRxBuffer.dataPtr = 0;
+            available = mRxBuffer.pkt.info.data_len;
+        }
+    }
+
+    const uint32_t count = (len < available) ? len : available;
+    memcpy(pData, &(mRxBuffer.pkt.data[mRxBuffer.dataPtr]), count);
+    mRxBuffer.dataPtr += count;
+
+    return count;
+}
+
+uint32_t NordicStream::write(const void *pData, uint32_t len, unsigned int timeout)
+{
+    const char *p = (const char*) pData;
+    const TickType_t start = xTaskGetTickCount();
+    uint32_t count = 0;
+
+    /* Fill the packets and send each one that is full, the same as putChar() */
+    while (count < len) {
+        uint32_t chunk = MESH_DATA_PAYLOAD_SIZE - mTxBuffer.dataPtr;
+        if (chunk > len - count) {
+            chunk = len - count;
+        }
+
+        /* Do not send another packet once the timeout expired */
+        const bool send = (mTxBuffer.dataPtr + chunk >= MESH_DATA_PAYLOAD_SIZE);
+        if (send && portMAX_DELAY != timeout && (xTaskGetTickCount() - start) >= timeout) {
+            break;
+        }
+
+        memcpy(&(mTxBuffer.pkt.data[mTxBuffer.dataPtr]), p + count, chunk);
+        mTxBuffer.dataPtr += chunk;
+
+        /* The packet was not acknowledged, so its data of this call was not written */
+        if (send && !flush()) {
+            break;
+        }
+        count += chunk;
+    }
+
+    return count;
+}
+
 bool NordicStream::flush(void)
 {
     bool ok = false;
@@ -88,6 +88,13 @@ void rtc_settime (const rtc_t *rtc)
 
 	/* Restart RTC */
 	LPC_RTC->CCR = 1;
+
+	rtc_settime_hook();
+}
+
+__attribute__ ((weak)) void rtc_settime_hook(void)
+{
+    /* Nothing depends on the time unless this is overridden */
 }
 
 const char* rtc_get_date_time_str(void)
@@ -0,0 +1,139 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>
+
+#include "uart_dma.h"
+
+
+
+/// Prevents the compiler from moving the copy of the data past the index that publishes it
+#define UART_DMA_BARRIER()  __asm volatile ("" ::: "memory")
+
+
+
+void uart_dma_rx_init(uart_dma_rx_t *rx, void *buf, uint32_t size, uint32_t (*get_pos)(void *arg), void *arg)
+{
+    memset(rx, 0, sizeof(*rx));
+    rx->buf = (uint8_t*) buf;
+    rx->size = size;
+    rx->get_pos = get_pos;
+    rx->arg = arg;
+}
+
+uint32_t uart_dma_rx_get_written(const uart_dma_rx_t *rx)
+{
+    /* Read the completed halves before the DMA position: the position can only be ahead of
+     * them, even if the interrupt of a half has not run yet.
+     */
+    const uint32_t written = rx->written;
+    UART_DMA_BARRIER();
+    const uint32_t pos = rx->get_pos(rx->arg);
+    const uint32_t half_start = written % rx->size;
+    return written + ((pos >= half_start) ? (pos - half_start) : (pos + rx->size - half_start));
+}
+
+uint32_t uart_dma_rx_get_count(const uart_dma_rx_t *rx)
+{
+    const uint32_t count = uart_dma_rx_get_written(rx) - rx->read;
+    return (count > rx->size) ? rx->size : count;
+}
+
+uint32_t uart_dma_rx_read(uart_dma_rx_t *rx, void *dst, uint32_t len)
+{
+    const uint32_t written = uart_dma_rx_get_written(rx);
+    uint32_t count = written - rx->read;
+
+    /* The DMA lapped the reader: keep the newest half that the DMA will not overwrite soon */
+    if (count > rx->size) {
+        const uint32_t keep = rx->size / 2;
+        rx->lost += count - keep;
+        rx->read = written - keep;
+        count = keep;
+    }
+
+    if (len > count) {
+        len = count;
+    }
+
+    /* Copy up to the end of the ring, then from its start */
+    const uint32_t idx = rx->read % rx->size;
+    const uint32_t first = (idx + len > rx->size) ? (rx->size - idx) : len;
+    memcpy(dst, rx->buf + idx, first);
+    memcpy((uint8_t*) dst + first, rx->buf, len - first);
+
+    rx->read += len;
+    return len;
+}
+
+void uart_dma_tx_init(uart_dma_tx_t *tx, void *buf, uint32_t size)
+{
+    memset(tx, 0, sizeof(*tx));
+    tx->buf = (uint8_t*) buf;
+    tx->size = size;
+}
+
+uint32_t uart_dma_tx_write(uart_dma_tx_t *tx, const void *src, uint32_t len)
+{
+    const uint32_t space = uart_dma_tx_get_space(tx);
+    if (len > space) {
+        len = space;
+    }
+
+    const uint32_t idx = tx->head % tx->size;
+    const uint32_t first = (idx + len > tx->size) ? (tx->size - idx) : len;
+    memcpy(tx->buf + idx, src, first);
+    memcpy(tx->buf, (const uint8_t*) src + first, len - first);
+
+    UART_DMA_BARRIER();
+    tx->head += len;
+    return len;
+}
+
+uint32_t uart_dma_tx_start(uart_dma_tx_t *tx, uart_dma_seg_t seg[2], uint32_t max_len)
+{
+    const uint32_t pending = uart_dma_tx_get_pending(tx);
+    if (tx->block || 0 == pending) {
+        return 0;
+    }
+
+    const uint32_t idx = tx->tail % tx->size;
+    const uint32_t to_end = tx->size - idx;
+    uint32_t num_segs = 1;
+
+    seg[0].ptr = tx->buf + idx;
+    seg[0].len = (pending < to_end) ? pending : to_end;
+    if (seg[0].len > max_len) {
+        seg[0].len = max_len;
+    }
+    else if (pending > to_end) {
+        seg[1].ptr = tx->buf;
+        seg[1].len = (pending - to_end < max_len) ? (pending - to_end) : max_len;
+        num_segs = 2;
+    }
+
+    tx->block = seg[0].len + ((2 == num_segs) ? seg[1].len : 0);
+    return num_segs;
+}
+
+void uart_dma_tx_done(uart_dma_tx_t *tx)
+{
+    tx->tail += tx->block;
+    tx->block = 0;
+    tx->blocks++;
+}
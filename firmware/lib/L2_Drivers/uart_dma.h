@@ -0,0 +1,448 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @ingroup Drivers
+ * @brief Receive and transmit rings of the UART DMA mode (@see UartDev::enableDma())
+ *
+ * This is the hardware independent part of the UART DMA, so it is tested on the host along
+ * with a model of the UART FIFO and the GPDMA that counts the interrupts of each design.
+ *
+ * Receive: The DMA writes the ring forever in two halves, with an interrupt at the end of
+ * each half that calls uart_dma_rx_half_done().  The number of bytes received is the count
+ * of the completed halves plus the distance of the DMA write position from the start of the
+ * current half, so it is exact even if the interrupt of a half runs late.  If the reader falls
+ * a full ring behind, the oldest bytes are dropped and counted as lost.
+ *
+ * Transmit: The writer copies to the ring, and the DMA sends the ring straight from the
+ * memory.  uart_dma_tx_start() gives the pending bytes as one block of up to two segments
+ * (the second segment exists when the block wraps around the end of the ring), which the
+ * driver turns into a linked list such that only the end of the block interrupts.  Bytes
+ * written while a block is being sent are sent as the next block.
+ *
+ * The rings are single producer and single consumer: the reader (or writer) is one task at a
+ * time, and the other side is the DMA interrupt.
+ */
+#ifndef UART_DMA_H__
+#define UART_DMA_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+/// Receive ring written by the DMA
+typedef struct {
+    uint8_t *buf;                   ///< The ring
+    uint32_t size;                  ///< Size of the ring (even)
+    uint32_t (*get_pos)(void *arg); ///< Returns the index of the ring that the DMA writes next
+    void *arg;                      ///< Argument of get_pos()
+    volatile uint32_t written;      ///< Bytes written by the completed halves (by the DMA interrupt)
+    uint32_t read;                  ///< Bytes read
+    uint32_t lost;                  ///< Bytes overwritten before they were read
+} uart_dma_rx_t;
+
+/// Transmit ring sent by the DMA
+typedef struct {
+    uint8_t *buf;                   ///< The ring
+    uint32_t size;                  ///< Size of the ring
+    volatile uint32_t head;         ///< Bytes written to the ring
+    volatile uint32_t tail;         ///< Bytes sent (by the DMA interrupt)
+    volatile uint32_t block;        ///< Bytes of the block being sent, or 0 if the DMA is idle
+    uint32_t blocks;                ///< Number of blocks sent
+} uart_dma_tx_t;
+
+/// A contiguous part of a transmit block
+typedef struct {
+    const uint8_t *ptr;
+    uint32_t len;
+} uart_dma_seg_t;
+
+/**
+ * Initializes the receive ring
+ * @param buf       The ring that the DMA writes
+ * @param size      The size of the ring (even)
+ * @param get_pos   The function that returns the index of the ring that the DMA writes next
+ * @param arg       The argument of get_pos()
+ */
+void uart_dma_rx_init(uart_dma_rx_t *rx, void *buf, uint32_t size, uint32_t (*get_pos)(void *arg), void *arg);
+
+/// Called by the DMA interrupt at the end of each half of the ring
+static inline void uart_dma_rx_half_done(uart_dma_rx_t *rx) { rx->written += rx->size / 2; }
+
+/// @returns the number of bytes written by the DMA since the start
+uint32_t uart_dma_rx_get_written(const uart_dma_rx_t *rx);
+
+/// @returns the number of bytes that can be read (up to the size of the ring)
+uint32_t uart_dma_rx_get_count(const uart_dma_rx_t *rx);
+
+/**
+ * Reads from the ring
+ * @returns the number of bytes read, up to len
+ */
+uint32_t uart_dma_rx_read(uart_dma_rx_t *rx, void *dst, uint32_t len);
+
+/// Initializes the transmit ring
+void uart_dma_tx_init(uart_dma_tx_t *tx, void *buf, uint32_t size);
+
+/// @returns the number of bytes that can be written to the transmit ring
+static inline uint32_t uart_dma_tx_get_space(const uart_dma_tx_t *tx) { return tx->size - (tx->head - tx->tail); }
+
+/// @returns the number of bytes written and not yet sent
+static inline uint32_t uart_dma_tx_get_pending(const uart_dma_tx_t *tx) { return tx->head - tx->tail; }
+
+/**
+ * Copies to the transmit ring
+ * @returns the number of bytes copied, up to len
+ * @note There can only be one writer at a time, the caller serializes the writers
+ */
+uint32_t uart_dma_tx_write(uart_dma_tx_t *tx, const void *src, uint32_t len);
+
+/**
+ * Starts the next block if the DMA is idle
+ * @param [out] seg     The segments of the block
+ * @param [in]  max_len The max length of a segment (the max transfer size of the DMA)
+ * @returns the number of segments (0 if the DMA is busy or there is nothing to send)
+ */
+uint32_t uart_dma_tx_start(uart_dma_tx_t *tx, uart_dma_seg_t seg[2], uint32_t max_len);
+
+/// Called by the DMA interrupt when the block is sent; the DMA is then idle
+void uart_dma_tx_done(uart_dma_tx_t *tx);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t g_test_uart_dma_pos;
+static uint32_t test_uart_dma_get_pos(void *arg) { (void) arg; return g_test_uart_dma_pos; }
+
+/// Writes to the receive ring like the DMA, calling the interrupt of each half unless it is late
+static inline void test_uart_dma_rx_dma_write(uart_dma_rx_t *rx, uint32_t len, uint8_t *value, bool late_isr)
+{
+    while (len--) {
+        rx->buf[g_test_uart_dma_pos] = (*value)++;
+        g_test_uart_dma_pos = (g_test_uart_dma_pos + 1) % rx->size;
+        if (!late_isr && 0 == (g_test_uart_dma_pos % (rx->size / 2))) {
+            uart_dma_rx_half_done(rx);
+        }
+    }
+}
+
+/**
+ * Host model of the UART FIFO and the GPDMA at one character time per step.
+ * It counts the interrupts and the kernel calls (queue or semaphore) per KB of the
+ * interrupt driven UartDev, and of the DMA mode, for receiving and for sending
+ * messages with a gap between them.
+ */
+typedef struct {
+    uint32_t msg_len;           ///< Bytes of each message
+    uint32_t gap;               ///< Character times between the messages
+    uint32_t work;              ///< Character times that the task works after each read or write
+    uint32_t isr;               ///< Interrupts
+    uint32_t kernel;            ///< Kernel calls from tasks and interrupts
+    uint32_t bytes;             ///< Bytes received (or sent)
+    uint32_t lost;              ///< Bytes lost
+} test_uart_dma_model_t;
+
+/// Receives with the interrupt driven UartDev: RX FIFO trigger at 4, and a queue call per byte
+static inline void test_uart_dma_model_rx_irq(test_uart_dma_model_t *m, uint32_t total)
+{
+    uint32_t fifo = 0, idle = 0, sent = 0, t = 0;
+    while (m->bytes + m->lost < total) {
+        const bool arrive = (sent < total) && (t++ % (m->msg_len + m->gap)) < m->msg_len;
+        if (arrive) {
+            sent++;
+            idle = 0;
+            if (16 == fifo) { m->lost++; } else { fifo++; }
+        }
+        else {
+            idle++;
+        }
+
+        /* RDA at the trigger level, or the character timeout after 4 idle character times */
+        if (fifo >= 4 || (fifo > 0 && idle >= 4)) {
+            m->isr++;
+            m->kernel += fifo;
+            m->bytes += fifo;
+            fifo = 0;
+        }
+    }
+}
+
+/**
+ * Receives with the DMA mode: RX FIFO trigger and DMA burst at 8 (the timeout drains the
+ * rest), a DMA interrupt per half ring, and the UART interrupt is only enabled while the
+ * task waits for an empty ring.
+ */
+static inline void test_uart_dma_model_rx_dma(test_uart_dma_model_t *m, uint32_t total, uint32_t ring)
+{
+    uint32_t fifo = 0, idle = 0, sent = 0, t = 0;
+    uint32_t written = 0, read = 0, busy = 0;
+    bool waiting = true, armed = true;
+
+    while (read + m->lost < total) {
+        const bool arrive = (sent < total) && (t++ % (m->msg_len + m->gap)) < m->msg_len;
+        bool wake = false;
+        if (arrive) {
+            sent++;
+            idle = 0;
+            if (16 == fifo) { m->lost++; } else { fifo++; }
+        }
+        else {
+            idle++;
+        }
+
+        const bool rda = (fifo >= 8), cti = (fifo > 0 && idle >= 4);
+        if (rda || cti) {
+            if (armed) {
+                m->isr++;
+                armed = false;
+                wake = true;
+            }
+            const uint32_t n = rda ? 8 : fifo;
+            fifo -= n;
+            if ((written % (ring / 2)) + n >= ring / 2) {
+                m->isr++;
+                wake = true;
+            }
+            written += n;
+        }
+
+        if (waiting && wake) {
+            m->kernel++;    /* xSemaphoreGiveFromISR() */
+            waiting = false;
+        }
+        if (!waiting && 0 == busy) {
+            if (written - read > ring) {
+                m->lost += written - read - ring / 2;
+                read = written - ring / 2;
+            }
+            if (written > read) {
+                read = written;
+                busy = m->work;
+            }
+            else {
+                waiting = armed = true;
+                m->kernel++;    /* xSemaphoreTake() */
+            }
+        }
+        else if (busy) {
+            busy--;
+        }
+    }
+    m->bytes = read;
+}
+
+/// Sends with the interrupt driven UartDev: a queue call per byte, and 16 bytes per THRE interrupt
+static inline void test_uart_dma_model_tx_irq(test_uart_dma_model_t *m, uint32_t total, uint32_t queue)
+{
+    uint32_t q = 0, fifo = 0, to_write = 0, t = 0;
+    while (m->bytes < total) {
+        if (0 == to_write && (t % (m->msg_len + m->gap + m->work)) == 0 && m->bytes + q + fifo < total) {
+            to_write = m->msg_len;
+        }
+        t++;
+
+        /* putChar() queues each byte, and writes the THR if the transmitter is idle */
+        while (to_write && q < queue) {
+            m->kernel++;
+            to_write--;
+            if (0 == fifo && 0 == q) { fifo = 1; } else { q++; }
+        }
+
+        if (fifo) {
+            fifo--;
+            m->bytes++;
+            if (0 == fifo && q) {
+                m->isr++;
+                const uint32_t n = (q < 16) ? q : 16;
+                m->kernel += n;
+                q -= n;
+                fifo = n;
+            }
+        }
+    }
+}
+
+/// Sends with the DMA mode: the ring is sent in blocks with an interrupt at the end of each block
+static inline void test_uart_dma_model_tx_dma(test_uart_dma_model_t *m, uint32_t total, uint32_t ring)
+{
+    uint32_t head = 0, tail = 0, block = 0, moved = 0, fifo = 0, to_write = 0, t = 0;
+    bool waiting = false;
+    while (m->bytes < total) {
+        if (0 == to_write && (t % (m->msg_len + m->gap + m->work)) == 0 && head < total) {
+            to_write = m->msg_len;
+        }
+        t++;
+
+        /* The writer copies what fits, and waits for the end of a block if the ring is full */
+        const uint32_t n = (to_write < ring - (head - tail)) ? to_write : ring - (head - tail);
+        if (n && !waiting) {
+            head += n;
+            to_write -= n;
+            if (0 == block) { block = head - tail; moved = 0; }
+        }
+        if (to_write && !waiting) {
+            waiting = true;
+            m->kernel++;
+        }
+
+        /* The DMA keeps the 16 byte FIFO full */
+        while (block && moved < block && fifo < 16) {
+            moved++;
+            fifo++;
+        }
+        if (block && moved == block) {
+            m->isr++;
+            tail += block;
+            block = (head > tail) ? head - tail : 0;
+            moved = 0;
+            if (waiting) {
+                m->kernel++;
+                waiting = false;
+            }
+        }
+        if (fifo) {
+            fifo--;
+            m->bytes++;
+        }
+    }
+}
+
+static inline void test_uart_dma(void)
+{
+    uint8_t buf[16];
+    uint8_t out[32];
+    uint8_t value = 0;
+    uart_dma_rx_t rx;
+    uart_dma_tx_t tx;
+    uart_dma_seg_t seg[2];
+
+    /* Receive across the end of the ring */
+    g_test_uart_dma_pos = 0;
+    uart_dma_rx_init(&rx, buf, sizeof(buf), test_uart_dma_get_pos, NULL);
+    assert(0 == uart_dma_rx_get_count(&rx) && 0 == uart_dma_rx_read(&rx, out, sizeof(out)));
+    test_uart_dma_rx_dma_write(&rx, 12, &value, false);
+    assert(12 == uart_dma_rx_get_count(&rx));
+    assert(5 == uart_dma_rx_read(&rx, out, 5) && 0 == out[0] && 4 == out[4]);
+    test_uart_dma_rx_dma_write(&rx, 8, &value, false);
+    assert(15 == uart_dma_rx_read(&rx, out, sizeof(out)) && 5 == out[0] && 19 == out[14]);
+    assert(0 == rx.lost);
+
+    /* The count is exact if the interrupt of a half is late */
+    test_uart_dma_rx_dma_write(&rx, 6, &value, true);
+    assert(20 + 6 == uart_dma_rx_get_written(&rx) && 6 == uart_dma_rx_get_count(&rx));
+    uart_dma_rx_half_done(&rx);
+    assert(26 == uart_dma_rx_get_written(&rx));
+
+    /* Falling a full ring behind drops the oldest bytes and keeps the newest half */
+    test_uart_dma_rx_dma_write(&rx, 20, &value, false);
+    assert(16 == uart_dma_rx_get_count(&rx));
+    assert(8 == uart_dma_rx_read(&rx, out, sizeof(out)) && 18 == rx.lost);
+    assert((uint8_t)(value - 8) == out[0]);
+
+    /* Transmit a block, and a block that wraps as two segments */
+    uart_dma_tx_init(&tx, buf, sizeof(buf));
+    assert(0 == uart_dma_tx_start(&tx, seg, 4095));
+    assert(10 == uart_dma_tx_write(&tx, "0123456789", 10));
+    assert(1 == uart_dma_tx_start(&tx, seg, 4095) && buf == seg[0].ptr && 10 == seg[0].len);
+    assert(6 == uart_dma_tx_write(&tx, "abcdefgh", 8));
+    assert(0 == uart_dma_tx_start(&tx, seg, 4095));
+    uart_dma_tx_done(&tx);
+    assert(6 == uart_dma_tx_get_pending(&tx) && 10 == uart_dma_tx_get_space(&tx));
+    assert(4 == uart_dma_tx_write(&tx, "ABCD", 4));
+    assert(2 == uart_dma_tx_start(&tx, seg, 4095));
+    assert(buf + 10 == seg[0].ptr && 6 == seg[0].len && buf == seg[1].ptr && 4 == seg[1].len);
+    assert(0 == memcmp("abcdef", seg[0].ptr, 6) && 0 == memcmp("ABCD", seg[1].ptr, 4));
+    uart_dma_tx_done(&tx);
+    assert(0 == uart_dma_tx_get_pending(&tx) && 2 == tx.blocks);
+
+    /* A segment is limited to the max transfer size of the DMA */
+    assert(14 == uart_dma_tx_write(&tx, "0123456789abcd", 14));
+    assert(1 == uart_dma_tx_start(&tx, seg, 4) && 4 == seg[0].len);
+    uart_dma_tx_done(&tx);
+    assert(1 == uart_dma_tx_start(&tx, seg, 4) && 4 == seg[0].len);
+    uart_dma_tx_done(&tx);
+    assert(2 == uart_dma_tx_start(&tx, seg, 4) && 4 == seg[0].len && 2 == seg[1].len);
+
+    /* The model receives and sends everything with fewer interrupts in the DMA mode */
+    test_uart_dma_model_t irq = { 64, 20, 0, 0, 0, 0, 0 }, dma = irq;
+    test_uart_dma_model_rx_irq(&irq, 8192);
+    test_uart_dma_model_rx_dma(&dma, 8192, 1024);
+    assert(8192 == irq.bytes && 8192 == dma.bytes && 0 == dma.lost);
+    assert(dma.isr < irq.isr * 2 / 3 && dma.kernel * 3 < irq.kernel);
+
+    test_uart_dma_model_t tx_irq = { 64, 20, 0, 0, 0, 0, 0 }, tx_dma = tx_irq;
+    test_uart_dma_model_tx_irq(&tx_irq, 8192, 64);
+    test_uart_dma_model_tx_dma(&tx_dma, 8192, 1024);
+    assert(8192 == tx_irq.bytes && 8192 == tx_dma.bytes);
+    assert(tx_dma.isr * 2 < tx_irq.isr && 0 == tx_dma.kernel);
+
+    puts("\nUART DMA Tests Successful!");
+}
+
+#ifndef __arm__
+/// Host only benchmark of the interrupts and kernel calls per KB of each UART design
+static inline void test_uart_dma_benchmark(void)
+{
+    const uint32_t total = 64 * 1024;
+    const uint32_t patterns[][3] = {
+        /* Message length, gap, and work of the task in character times */
+        { 1024, 0, 0 }, { 256, 0, 8 }, { 64, 20, 2 }, { 8, 50, 2 },
+    };
+
+    printf("\n%-22s %16s %16s %16s %16s\n", "Pattern (len/gap/work)",
+           "RX irq: isr/KB", "RX dma: isr/KB", "TX irq: isr/KB", "TX dma: isr/KB");
+    for (uint32_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        test_uart_dma_model_t m[4];
+        for (int j = 0; j < 4; j++) {
+            const test_uart_dma_model_t init = { patterns[i][0], patterns[i][1], patterns[i][2], 0, 0, 0, 0 };
+            m[j] = init;
+        }
+        test_uart_dma_model_rx_irq(&m[0], total);
+        test_uart_dma_model_rx_dma(&m[1], total, 1024);
+        test_uart_dma_model_tx_irq(&m[2], total, 64);
+        test_uart_dma_model_tx_dma(&m[3], total, 1024);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u/%u/%u", patterns[i][0], patterns[i][1], patterns[i][2]);
+        printf("%-22s", name);
+        for (int j = 0; j < 4; j++) {
+            char cell[32];
+            snprintf(cell, sizeof(cell), "%.1f (%.0f k)", m[j].isr * 1024.0 / total, m[j].kernel * 1024.0 / total);
+            printf(" %16s", cell);
+        }
+        printf("\n");
+    }
+    puts("(k) is the kernel calls per KB");
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* UART_DMA_H__ */
@@ -0,0 +1,284 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Min-heap of RTC alarms keyed by the time they fire next, used by rtc_alarm.c
+ * @ingroup Utilities
+ *
+ * The alarms are kept in a binary min-heap such that the next alarm is always at the top.
+ * The RTC interrupt only needs to look at the top of the heap, and the RTC alarm registers
+ * are programmed to the time of the top alarm instead of interrupting every second.
+ * Adding an alarm or firing an alarm (and re-scheduling it) is O(log n).
+ *
+ * The heap does not access the RTC hardware, so it can be tested on the host with
+ * a simulated clock.
+ *
+ * 20261015 : Initial
+ */
+#ifndef ALARM_HEAP_H__
+#define ALARM_HEAP_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+#define ALARM_HEAP_MAX_ALARMS   16      ///< Max number of alarms (recurring and timed)
+#define ALARM_HEAP_TIMED        4       ///< Frequency of an alarm at a time of the day (after alarm_freq_t)
+#define ALARM_HEAP_OFF          0xFF    ///< Heap index of an alarm that is off
+
+/**
+ * Frequency of a recurring alarm
+ */
+typedef enum {
+    everySecond = 0,
+    everyMinute = 1,
+    everyHour   = 2,
+    everyDay    = 3,
+} alarm_freq_t;
+
+/**
+ * rtc_alarm_create() returns the pointer to this structure.
+ * This structure can be used to change the alarm time after
+ * it has been created.
+ */
+typedef struct {
+    uint8_t hour, min, sec;
+} alarm_time_t;
+
+/// An alarm of the heap
+typedef struct {
+    alarm_time_t time;      ///< The time of the day of a timed alarm (must be the first member)
+    uint8_t freq;           ///< alarm_freq_t, or ALARM_HEAP_TIMED
+    uint8_t heap_index;     ///< The index in the heap, or ALARM_HEAP_OFF
+    uint32_t next_sec;      ///< The time the alarm fires next, @see alarm_heap_t::now_sec
+    void *signal;           ///< The user data of the alarm, such as the semaphore to give
+} alarm_heap_entry_t;
+
+/// The heap of alarms
+typedef struct {
+    alarm_heap_entry_t alarms[ALARM_HEAP_MAX_ALARMS];   ///< The alarms in the order they were added
+    alarm_heap_entry_t *heap[ALARM_HEAP_MAX_ALARMS];    ///< The heap of the alarms that are on
+    uint8_t num_alarms;     ///< Number of alarms used
+    uint8_t heap_size;      ///< Number of alarms in the heap
+    uint32_t now_sec;       ///< Seconds counter of the time (may wrap around)
+    uint32_t now_sod;       ///< The second of the day of now_sec
+} alarm_heap_t;
+
+/**
+ * Initializes the heap
+ * @param [in] now  The current time of the RTC
+ */
+void alarm_heap_init(alarm_heap_t *h, alarm_time_t now);
+
+/**
+ * Updates the current time of the heap.
+ * @param [in] now  The current time of the RTC, which must not be more than a day after the last call.
+ */
+void alarm_heap_set_now(alarm_heap_t *h, alarm_time_t now);
+
+/**
+ * Sets the current time of the heap after the clock was changed, and schedules all of the
+ * alarms again from the new time.  The alarms between the old and the new time do not fire.
+ * @param [in] now  The new time of the RTC
+ */
+void alarm_heap_resync(alarm_heap_t *h, alarm_time_t now);
+
+/**
+ * Adds an alarm that fires after the current time
+ * @param [in] freq    alarm_freq_t for a recurring alarm, or ALARM_HEAP_TIMED
+ * @param [in] time    The time of the day of ALARM_HEAP_TIMED alarm; hour >= 24 turns off the alarm
+ * @param [in] signal  The user data of the alarm
+ * @returns the alarm, or NULL if ALARM_HEAP_MAX_ALARMS are used
+ */
+alarm_heap_entry_t* alarm_heap_add(alarm_heap_t *h, uint8_t freq, alarm_time_t time, void *signal);
+
+/**
+ * Changes the time of an ALARM_HEAP_TIMED alarm
+ * @param [in] time  The new time of the day; hour >= 24 turns off the alarm
+ */
+void alarm_heap_set_time(alarm_heap_t *h, alarm_heap_entry_t *alarm, alarm_time_t time);
+
+/**
+ * Gets an alarm that is due at the current time, and schedules its next time.
+ * @returns the alarm, or NULL if no more alarms are due
+ */
+alarm_heap_entry_t* alarm_heap_get_due(alarm_heap_t *h);
+
+/**
+ * Gets the time of the day of the next alarm
+ * @param [out] next  The time of the next alarm
+ * @returns false if there are no alarms
+ */
+bool alarm_heap_get_next(const alarm_heap_t *h, alarm_time_t *next);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/// Simulated RTC: alarm registers are compared each second, and only then is the "ISR" run
+typedef struct {
+    uint32_t sod;           ///< Simulated time of the day
+    bool alarm_on;          ///< Alarm registers are enabled
+    alarm_time_t alarm;     ///< Alarm registers
+    uint32_t isr_calls;     ///< Number of times the interrupt occurred
+    uint32_t heap_tops;     ///< Number of alarms the interrupt inspected at the top of the heap
+    uint32_t fired[ALARM_HEAP_MAX_ALARMS];
+} test_alarm_rtc_t;
+
+static inline alarm_time_t test_alarm_time(uint32_t sod)
+{
+    const alarm_time_t t = { (uint8_t)(sod / 3600), (uint8_t)((sod / 60) % 60), (uint8_t)(sod % 60) };
+    return t;
+}
+
+/// Same as the RTC_IRQHandler() of rtc_alarm.c
+static inline void test_alarm_isr(alarm_heap_t *h, test_alarm_rtc_t *rtc)
+{
+    alarm_heap_entry_t *a = NULL;
+
+    ++rtc->isr_calls;
+    alarm_heap_set_now(h, test_alarm_time(rtc->sod));
+    while (NULL != (a = alarm_heap_get_due(h))) {
+        ++rtc->heap_tops;
+        ++rtc->fired[a - h->alarms];
+
+        /* Alarms fire in order, and at their time */
+        switch (a->freq) {
+            case everySecond: break;
+            case everyMinute: assert(0 == rtc->sod % 60);   break;
+            case everyHour:   assert(0 == rtc->sod % 3600); break;
+            case everyDay:    assert(0 == rtc->sod);        break;
+            default:
+                assert(rtc->sod == (a->time.hour * 3600u + a->time.min * 60u + a->time.sec));
+                break;
+        }
+    }
+    ++rtc->heap_tops;
+    rtc->alarm_on = alarm_heap_get_next(h, &rtc->alarm);
+}
+
+static inline void test_alarm_heap(void)
+{
+    static alarm_heap_t h;
+    test_alarm_rtc_t rtc;
+    const alarm_time_t times[] = { { 12, 30, 0 }, { 0, 0, 5 }, { 23, 59, 59 }, { 12, 30, 0 }, { 6, 0, 0 } };
+    alarm_heap_entry_t *timed[5];
+    int i;
+
+    memset(&rtc, 0, sizeof(rtc));
+    rtc.sod = 11 * 3600 + 59 * 60;  // 11:59:00
+    alarm_heap_init(&h, test_alarm_time(rtc.sod));
+    assert(!alarm_heap_get_next(&h, &rtc.alarm));
+
+    assert(alarm_heap_add(&h, everyMinute, times[0], NULL));
+    assert(alarm_heap_add(&h, everyHour, times[0], NULL));
+    assert(alarm_heap_add(&h, everyDay, times[0], NULL));
+    for (i = 0; i < 5; i++) {
+        timed[i] = alarm_heap_add(&h, ALARM_HEAP_TIMED, times[i], NULL);
+        assert(timed[i] && 0 == memcmp(&timed[i]->time, &times[i], sizeof(times[i])));
+    }
+
+    /* The next alarm is the minute alarm at 12:00:00 */
+    rtc.alarm_on = alarm_heap_get_next(&h, &rtc.alarm);
+    assert(rtc.alarm_on && 12 == rtc.alarm.hour && 0 == rtc.alarm.min && 0 == rtc.alarm.sec);
+
+    /* Turn off one alarm, and move another one */
+    alarm_heap_set_time(&h, timed[4], test_alarm_time(25 * 3600));
+    alarm_heap_set_time(&h, timed[3], test_alarm_time(13 * 3600 + 1));
+    rtc.alarm_on = alarm_heap_get_next(&h, &rtc.alarm);
+
+    /* Simulate two days; the interrupt only occurs when the time matches the alarm registers */
+    const uint32_t seconds = 2 * 24 * 3600;
+    uint32_t s;
+    for (s = 0; s < seconds; s++) {
+        rtc.sod = (rtc.sod + 1) % (24 * 3600);
+        const alarm_time_t now = test_alarm_time(rtc.sod);
+        if (rtc.alarm_on && 0 == memcmp(&now, &rtc.alarm, sizeof(now))) {
+            test_alarm_isr(&h, &rtc);
+        }
+    }
+
+    assert(2 * 24 * 60 == rtc.fired[0]);
+    assert(2 * 24 == rtc.fired[1]);
+    assert(2 == rtc.fired[2]);
+    assert(2 == rtc.fired[3] && 2 == rtc.fired[4] && 2 == rtc.fired[5] && 2 == rtc.fired[6]);
+    assert(0 == rtc.fired[7]);
+
+    /* Interrupts only occur at the seconds when an alarm fires, and each one only looks at the alarms
+     * that fire plus the next one, instead of a list scan of all alarms every second.
+     */
+    printf("\nAlarm heap: %u seconds, %u interrupts, %u heap tops inspected (list scans: %u)",
+           (unsigned) seconds, (unsigned) rtc.isr_calls, (unsigned) rtc.heap_tops, (unsigned) (seconds * h.num_alarms));
+    assert(2 * 24 * 60 + 6 == rtc.isr_calls);
+    assert(rtc.isr_calls + (2 * 24 * 60) + (2 * 24) + 2 + (4 * 2) == rtc.heap_tops);
+
+    /* An every second alarm makes the interrupt occur every second */
+    s = rtc.sod;
+    memset(&rtc, 0, sizeof(rtc));
+    rtc.sod = s;
+    assert(alarm_heap_add(&h, everySecond, times[0], NULL));
+    rtc.alarm_on = alarm_heap_get_next(&h, &rtc.alarm);
+    for (s = 0; s < 100; s++) {
+        rtc.sod = (rtc.sod + 1) % (24 * 3600);
+        const alarm_time_t now = test_alarm_time(rtc.sod);
+        if (rtc.alarm_on && 0 == memcmp(&now, &rtc.alarm, sizeof(now))) {
+            test_alarm_isr(&h, &rtc);
+        }
+    }
+    assert(100 == rtc.fired[8] && 100 == rtc.isr_calls);
+
+    /* Setting the clock back or forward schedules the alarms from the new time, and the alarms
+     * in between do not fire (alarm_heap_set_now() would take a step back as almost a day).
+     */
+    static alarm_heap_t r;
+    alarm_heap_init(&r, test_alarm_time(12 * 3600));
+    assert(alarm_heap_add(&r, everyHour, times[0], NULL));
+    timed[0] = alarm_heap_add(&r, ALARM_HEAP_TIMED, times[0], NULL);
+    alarm_heap_resync(&r, test_alarm_time(10 * 3600 + 45 * 60));
+    assert(NULL == alarm_heap_get_due(&r));
+    assert(alarm_heap_get_next(&r, &rtc.alarm) && 11 == rtc.alarm.hour && 0 == rtc.alarm.min && 0 == rtc.alarm.sec);
+    alarm_heap_resync(&r, test_alarm_time(12 * 3600 + 29 * 60 + 59));
+    assert(NULL == alarm_heap_get_due(&r));
+    assert(alarm_heap_get_next(&r, &rtc.alarm) && 12 == rtc.alarm.hour && 30 == rtc.alarm.min && 0 == rtc.alarm.sec);
+    alarm_heap_set_now(&r, times[0]);
+    assert(timed[0] == alarm_heap_get_due(&r) && NULL == alarm_heap_get_due(&r));
+    assert(alarm_heap_get_next(&r, &rtc.alarm) && 13 == rtc.alarm.hour && 0 == rtc.alarm.min && 0 == rtc.alarm.sec);
+
+    /* The heap is full */
+    while (h.num_alarms < ALARM_HEAP_MAX_ALARMS) {
+        assert(alarm_heap_add(&h, ALARM_HEAP_TIMED, times[0], NULL));
+    }
+    assert(NULL == alarm_heap_add(&h, ALARM_HEAP_TIMED, times[0], NULL));
+
+    puts("\nAlarm Heap Tests Successful!");
+}
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ALARM_HEAP_H__ */
@@ -21,6 +21,7 @@
 * @brief Circular buffer
 * @ingroup Utilities
 *
+* Version: 20261015    Added SpscCircularBuffer for lock-free ISR to task handoff
 * Version: 20140305    Initial
 */
 #ifndef CIRCULAR_BUFFER_HPP__
@@ -225,6 +226,111 @@ private:
 
 
 
+/**
+ * Lock-free single-producer single-consumer circular buffer
+ * @ingroup Utilities
+ *
+ * This buffer is meant for one writer and one reader that run in different
+ * contexts, such as an ISR filling the buffer while a task drains it.  No
+ * critical sections are needed as long as there is only ONE producer and
+ * ONE consumer.  The storage is part of the object so nothing is allocated.
+ *
+ * The CAPACITY must be a power of two such that the indexes can be masked
+ * rather than using the modulo operator.  The read and write indexes are
+ * free running and only the producer writes the write index and only the
+ * consumer writes the read index.
+ *
+ * Usage:
+ * @code
+    static SpscCircularBuffer <char, 64> rx;
+
+    // Producer (ISR)
+    rx.push_back(c);
+
+    // Consumer (task)
+    char buffer[16];
+    uint32_t n = rx.pop_n(buffer, sizeof(buffer));
+
+    // Or process the data in place without copying it
+    const char *span = 0;
+    n = rx.getReadSpan(&span);
+    process(span, n);
+    rx.commitRead(n);
+ * @endcode
+ */
+template <typename TYPE, uint32_t CAPACITY>
+class SpscCircularBuffer
+{
+public:
+    static_assert(CAPACITY >= 2 && 0 == (CAPACITY & (CAPACITY - 1)), "CAPACITY must be a power of two");
+
+    SpscCircularBuffer() : mWriteIndex(0), mReadIndex(0) { }
+
+    /**
+     * @{ Producer API; only one context should call these methods
+     */
+    bool push_back(const TYPE& data);                    ///< @returns true if the element was written
+    uint32_t push_n(const TYPE* pData, uint32_t count);  ///< @returns the number of elements written
+
+    /**
+     * Gets the contiguous free space that can be written in place.
+     * @param ppSpan  The pointer to the free space is written here
+     * @returns the number of elements that can be written at *ppSpan
+     * @post Call commitWrite() with the number of elements actually written
+     */
+    uint32_t getWriteSpan(TYPE** ppSpan);
+    void commitWrite(uint32_t count);                    ///< Publishes count elements written via getWriteSpan()
+    /** @} */
+
+    /**
+     * @{ Consumer API; only one context should call these methods
+     */
+    bool pop_front(TYPE* pData);                         ///< @returns true if an element was read to pData
+    bool peek_front(TYPE* pData) const;                  ///< @returns true if an element was copied to pData without removing it
+    uint32_t pop_n(TYPE* pData, uint32_t count);         ///< @returns the number of elements read
+
+    /**
+     * Gets the contiguous data that can be read in place.
+     * @param ppSpan  The pointer to the oldest data is written here
+     * @returns the number of elements that can be read at *ppSpan
+     * @post Call commitRead() with the number of elements actually consumed
+     */
+    uint32_t getReadSpan(const TYPE** ppSpan) const;
+    void commitRead(uint32_t count);                     ///< Frees count elements read via getReadSpan()
+    /** @} */
+
+    /// @returns the number of elements in the buffer
+    uint32_t size(void) const     { return loadAcquire(&mWriteIndex) - loadAcquire(&mReadIndex); }
+
+    /// @returns the capacity of the circular buffer
+    uint32_t capacity(void) const { return CAPACITY; }
+
+    bool isEmpty(void) const { return 0 == size(); }         ///< @returns true if the buffer is empty
+    bool isFull(void)  const { return CAPACITY == size(); }  ///< @returns true if the buffer is full
+
+    /// Clears the buffer; only safe if neither producer nor consumer is active
+    void clear(void) { storeRelease(&mReadIndex, 0); storeRelease(&mWriteIndex, 0); }
+
+#ifdef TESTING
+    /// Empties the buffer with both indexes at the given value, used to test the 32-bit wrap around
+    void clearAt(uint32_t index) { storeRelease(&mReadIndex, index); storeRelease(&mWriteIndex, index); }
+#endif
+
+private:
+    /// Mask to convert free running index to the array index
+    static const uint32_t mMask = CAPACITY - 1;
+
+    static inline uint32_t loadAcquire(const volatile uint32_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+    static inline void storeRelease(volatile uint32_t *p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+    volatile uint32_t mWriteIndex;  ///< Free running write index, only written by the producer
+    volatile uint32_t mReadIndex;   ///< Free running read index, only written by the consumer
+    TYPE mArray[CAPACITY];          ///< The array of elements
+};
+
+
+
+
 
 
 
@@ -339,6 +445,128 @@ bool CircularBuffer<TYPE>::peek_front(TYPE* dataPtr)
 
 
 
+template <typename TYPE, uint32_t CAPACITY>
+bool SpscCircularBuffer<TYPE, CAPACITY>::push_back(const TYPE& data)
+{
+    const uint32_t w = mWriteIndex;
+    const bool success = (w - loadAcquire(&mReadIndex)) < CAPACITY;
+
+    if (success) {
+        mArray[w & mMask] = data;
+        storeRelease(&mWriteIndex, w + 1);
+    }
+
+    return success;
+}
+
+template <typename TYPE, uint32_t CAPACITY>
+uint32_t SpscCircularBuffer<TYPE, CAPACITY>::push_n(const TYPE* pData, uint32_t count)
+{
+    uint32_t written = 0;
+    TYPE *pSpan = 0;
+
+    /* At most two spans are needed, one until the end of the array, and one from the start */
+    for (int i = 0; i < 2 && written < count; i++)
+    {
+        uint32_t n = getWriteSpan(&pSpan);
+        if (n > (count - written)) {
+            n = count - written;
+        }
+        for (uint32_t j = 0; j < n; j++) {
+            pSpan[j] = pData[written + j];
+        }
+        commitWrite(n);
+        written += n;
+    }
+
+    return written;
+}
+
+template <typename TYPE, uint32_t CAPACITY>
+uint32_t SpscCircularBuffer<TYPE, CAPACITY>::getWriteSpan(TYPE** ppSpan)
+{
+    const uint32_t w = mWriteIndex;
+    const uint32_t freeSpace = CAPACITY - (w - loadAcquire(&mReadIndex));
+    const uint32_t untilEnd = CAPACITY - (w & mMask);
+
+    *ppSpan = &mArray[w & mMask];
+    return (freeSpace < untilEnd) ? freeSpace : untilEnd;
+}
+
+template <typename TYPE, uint32_t CAPACITY>
+void SpscCircularBuffer<TYPE, CAPACITY>::commitWrite(uint32_t count)
+{
+    storeRelease(&mWriteIndex, mWriteIndex + count);
+}
+
+template <typename TYPE, uint32_t CAPACITY>
+bool SpscCircularBuffer<TYPE, CAPACITY>::pop_front(TYPE* pData)
+{
+    const uint32_t r = mReadIndex;
+    const bool success = (loadAcquire(&mWriteIndex) != r);
+
+    if (success) {
+        *pData = mArray[r & mMask];
+        storeRelease(&mReadIndex, r + 1);
+    }
+
+    return success;
+}
+
+template <typename TYPE, uint32_t CAPACITY>
+bool SpscCircularBuffer<TYPE, CAPACITY>::peek_front(TYPE* pData) const
+{
+    const uint32_t r = mReadIndex;
+    const bool success = (loadAcquire(&mWriteIndex) != r);
+
+    if (success) {
+        *pData = mArray[r & mMask];
+    }
+
+    return success;
+}
+
+template <typename TYPE, uint32_t CAPACITY>
+uint32_t SpscCircularBuffer<TYPE, CAPACITY>::pop_n(TYPE* pData, uint32_t count)
+{
+    uint32_t read = 0;
+    const TYPE *pSpan = 0;
+
+    for (int i = 0; i < 2 && read < count; i++)
+    {
+        uint32_t n = getReadSpan(&pSpan);
+        if (n > (count - read)) {
+            n = count - read;
+        }
+        for (uint32_t j = 0; j < n; j++) {
+            pData[read + j] = pSpan[j];
+        }
+        commitRead(n);
+        read += n;
+    }
+
+    return read;
+}
+
+template <typename TYPE, uint32_t CAPACITY>
+uint32_t SpscCircularBuffer<TYPE, CAPACITY>::getReadSpan(const TYPE** ppSpan) const
+{
+    const uint32_t r = mReadIndex;
+    const uint32_t available = loadAcquire(&mWriteIndex) - r;
+    const uint32_t untilEnd = CAPACITY - (r & mMask);
+
+    *ppSpan = &mArray[r & mMask];
+    return (available < untilEnd) ? available : untilEnd;
+}
+
+template <typename TYPE, uint32_t CAPACITY>
+void SpscCircularBuffer<TYPE, CAPACITY>::commitRead(uint32_t count)
+{
+    storeRelease(&mReadIndex, mReadIndex + count);
+}
+
+
+
 #ifdef TESTING
 #include <assert.h>
 static inline void test_CircularBuffer(void)
@@ -478,6 +706,169 @@ static inline void test_CircularBuffer(void)
 
     puts("\nCircular Buffer Tests Successful!");
 }
+
+static inline void test_SpscCircularBuffer(void)
+{
+    SpscCircularBuffer <int, 4> b;
+    int x = 0;
+
+    assert(4 == b.capacity());
+    assert(0 == b.size());
+    assert(b.isEmpty());
+    assert(!b.pop_front(&x));
+
+    assert(b.push_back(1));
+    assert(b.push_back(2));
+    assert(b.push_back(3));
+    assert(b.push_back(4));
+    assert(!b.push_back(5));
+    assert(b.isFull());
+
+    assert(b.peek_front(&x) && 1 == x);
+    assert(b.pop_front(&x) && 1 == x);
+    assert(b.pop_front(&x) && 2 == x);
+    assert(2 == b.size());
+
+    /* Write index is now at 4 and read index at 2, so the next write wraps */
+    const int in[] = { 5, 6, 7 };
+    assert(2 == b.push_n(in, 3));
+    assert(4 == b.size());
+
+    int out[4] = { 0 };
+    assert(4 == b.pop_n(out, 4));
+    assert(3 == out[0] && 4 == out[1] && 5 == out[2] && 6 == out[3]);
+    assert(b.isEmpty());
+
+    /* Spans must stop at the end of the array */
+    int *pw = 0;
+    assert(2 == b.getWriteSpan(&pw));
+    pw[0] = 10; pw[1] = 11;
+    b.commitWrite(2);
+    assert(2 == b.getWriteSpan(&pw));
+    pw[0] = 12;
+    b.commitWrite(1);
+
+    const int *pr = 0;
+    assert(2 == b.getReadSpan(&pr));
+    assert(10 == pr[0] && 11 == pr[1]);
+    b.commitRead(2);
+    assert(1 == b.getReadSpan(&pr) && 12 == pr[0]);
+    b.commitRead(1);
+    assert(0 == b.getReadSpan(&pr));
+
+    /* Indexes are free running, so they must survive the 32-bit wrap around */
+    b.clearAt(UINT32_MAX - 1);
+    assert(0 == b.size() && b.isEmpty());
+    assert(b.push_back(20));
+    assert(b.push_back(21));    /* Write index wraps to zero */
+    assert(b.push_back(22));
+    assert(b.push_back(23));
+    assert(4 == b.size() && b.isFull());
+    assert(!b.push_back(24));
+    assert(0 == b.getWriteSpan(&pw));
+
+    assert(b.pop_front(&x) && 20 == x);
+    assert(b.pop_front(&x) && 21 == x);  /* Read index wraps to zero */
+    assert(2 == b.size());
+
+    const int in2[] = { 24, 25, 26 };
+    assert(2 == b.push_n(in2, 3));
+    assert(4 == b.size() && b.isFull());
+    assert(4 == b.pop_n(out, 4));
+    assert(22 == out[0] && 23 == out[1] && 24 == out[2] && 25 == out[3]);
+    assert(b.isEmpty());
+
+    /* Partially filled buffer straddling the wrap around */
+    b.clearAt(UINT32_MAX - 2);
+    for (uint32_t i = 0; i < 10; i++) {
+        assert(b.push_back(i));
+        assert(b.push_back(i + 100));
+        assert(2 == b.size());
+        assert(b.pop_front(&x) && (int)i == x);
+        assert(1 == b.size());
+        assert(b.pop_front(&x) && (int)(i + 100) == x);
+        assert(0 == b.size());
+    }
+
+    puts("\nSPSC Circular Buffer Tests Successful!");
+}
+
+#ifndef __arm__
+#include <stdio.h>
+#include <thread>
+#include <chrono>
+/**
+ * Host only stress test and throughput benchmark.  One thread produces
+ * a sequence of numbers while another consumes them and checks that
+ * nothing was lost, duplicated, or re-ordered.
+ */
+static inline void test_SpscCircularBuffer_stress(void)
+{
+    const uint32_t count = 10 * 1000 * 1000;
+    typedef std::chrono::steady_clock clock;
+    static SpscCircularBuffer <uint32_t, 1024> spsc;
+    bool inOrder = true;
+
+    const clock::time_point start = clock::now();
+    std::thread consumer([&]() {
+        uint32_t expected = 0;
+        uint32_t buffer[64];
+        while (expected < count) {
+            const uint32_t n = spsc.pop_n(buffer, 64);
+            if (0 == n) {
+                std::this_thread::yield();
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                inOrder = inOrder && (buffer[i] == expected++);
+            }
+        }
+    });
+
+    uint32_t value = 0;
+    uint32_t *pSpan = 0;
+    while (value < count) {
+        /* Alternate between single and bulk writes to exercise both paths */
+        if (spsc.isFull()) {
+            std::this_thread::yield();
+        }
+        else if (value & 1) {
+            value += spsc.push_back(value) ? 1 : 0;
+        }
+        else {
+            uint32_t n = spsc.getWriteSpan(&pSpan);
+            if (n > count - value) {
+                n = count - value;
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                pSpan[i] = value++;
+            }
+            spsc.commitWrite(n);
+        }
+    }
+    consumer.join();
+    const double spscSec = std::chrono::duration<double>(clock::now() - start).count();
+    assert(inOrder);
+    assert(spsc.isEmpty());
+
+    /* Same amount of data through the original buffer for comparison (single thread) */
+    CircularBuffer <uint32_t> cb(1024);
+    uint32_t sum = 0, x = 0;
+    const clock::time_point cbStart = clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        cb.push_back(i);
+        if (cb.size() >= 64) {
+            while (cb.pop_front(&x)) {
+                sum += x;
+            }
+        }
+    }
+    const double cbSec = std::chrono::duration<double>(clock::now() - cbStart).count();
+
+    printf("\nSPSC two threads   : %u elements in %.3f sec (%.1f M/sec)", count, spscSec, count / spscSec / 1e6);
+    printf("\nCircularBuffer (1T): %u elements in %.3f sec (%.1f M/sec) [%u]", count, cbSec, count / cbSec / 1e6, sum);
+    puts("\nSPSC Circular Buffer Stress Test Successful!");
+}
+#endif /* #ifndef __arm__ */
 #endif /* #ifdef TESTING */
 
 
@@ -20,6 +20,8 @@
  * @brief Provides command handling mapping with a function pointer as handler
  * @ingroup Utilities
  *
+ * Version: 20261016    Added StaticCommandProcessor that does not use the heap
+ * Version: 20261015    Commands are found through a case-insensitive trie instead of linear search
  * Version: 11102013    Removed 4th parameter (size) of command handler
  * Version: 05022013    Removed output string and replaced with output interface.
  * Version: 04192013    Removed restriction of command limit, just rely on source str as the command.
@@ -31,8 +33,9 @@
 #ifndef COMMANDHANDLER_HPP_
 #define COMMANDHANDLER_HPP_
 
-#include "vector.hpp"
+#include <stdint.h>
 #include "str.hpp"
+#include "str_view.hpp"
 #include "char_dev.hpp"
 
 
@@ -58,6 +61,8 @@ typedef bool (*CmdHandlerFuncPtr)(str& cmdParams, CharDev& output, void* pDataPa
  *
  * CMD_HANDLER_FUNC(myHandler)
  * {
+ *    // Parse the parameters without copying them, see str_view
+ *    str_view params(cmdParams);
  *    ...
  * }
  * @endcode
@@ -75,6 +80,11 @@ typedef bool (*CmdHandlerFuncPtr)(str& cmdParams, CharDev& output, void* pDataPa
  * When user inputs a command, it will call the mapped handler.
  * Note that command input is capitalized to make this class case insensitive.
  *
+ * Commands are indexed in a case-insensitive trie as they are added, so finding
+ * a command (or its short-hand) only walks the characters of the input command
+ * regardless of how many commands are registered.  Nested command processors,
+ * such as the one used by the "wireless" command, get their own trie.
+ *
  * One handler is already part of this class:
  *   - "help"   : Get list of supported commands
  *
@@ -91,6 +101,9 @@ typedef bool (*CmdHandlerFuncPtr)(str& cmdParams, CharDev& output, void* pDataPa
  *
  *      CommandProcessor cp;
  *      cp.addHandler(cmdHandler, "cmd", "My Cmd Help");
+ *
+ *      // Or store the commands inside the object such that the heap is not used
+ *      StaticCommandProcessor<16> scp;
  * @endcode
  */
 class CommandProcessor
@@ -98,13 +111,11 @@ class CommandProcessor
     public:
         /**
          * Constructor
-         * @param numCmds Optional: Initial list of vector size to avoid memory re-allocation
-         * @note addHandler() will grow the vector of command handlers if more commands are added later
+         * @param numCmds Optional: Initial number of commands to avoid memory re-allocation
+         * @note addHandler() will grow the memory of the command handlers if more commands are added later
          */
-        CommandProcessor(int numCmds=8) :
-            mCmdHandlerVector(numCmds), mEnShortCmds(true)
-        {
-        }
+        CommandProcessor(int numCmds=8);
+        ~CommandProcessor();
 
         /**
          * Adds a command to the command handler list
@@ -112,11 +123,12 @@ class CommandProcessor
          * @param pPersistantCmdStr     The persistent data pointer of a command's text
          * @param pPersistentCmdHelpStr The persistent data pointer of this command's help text
          * @param pDataParam            Optional Param: The data parameter pointer to pass to your handler when it gets called
+         * @returns false if there was no memory to add the command
          * @warning pPersistentCmdStr and pPersistentCmdHelp must always exist in memory without going out of scope because
          *          these strings are not copied internally but their pointer is referenced during comparison
          * @note command is matched while ignoring case.
          */
-        void addHandler(CmdHandlerFuncPtr pFunc, const char* pPersistantCmdStr,
+        bool addHandler(CmdHandlerFuncPtr pFunc, const char* pPersistantCmdStr,
                         const char* pPersistentCmdHelpStr=0, void* pDataParam=0);
 
         /**
@@ -132,12 +144,13 @@ class CommandProcessor
         /**
          * Enables short-hand commands.  If a registered command is "information", and
          * a command comes in as "info", then it will be handled by "information" handler.
-         * First command that matches first two characters will take precedence.
+         * The short-hand must be at least two characters, and the first registered command
+         * that begins with the short-hand will take precedence.
          * @note This option is enabled by default.
          */
         inline void enableShortCmds(bool en) { mEnShortCmds = en;}
 
-    private:
+    protected:
         /// Structure of a Handler
         typedef struct
         {
@@ -147,8 +160,55 @@ class CommandProcessor
             void* pDataParam;         ///< Pointer to the data that should be passed as void pointer to pFunc
         } CmdProcessorType;
 
-        VECTOR<CmdProcessorType> mCmdHandlerVector; ///< Vector of the command handlers
-        bool mEnShortCmds; ///< Enables partial matching of command names
+        /**
+         * Node of the command trie.  Node 0 is the root, and each child node is one more
+         * lower-case character of the command.  Handler numbers are the index of
+         * mpHandlers plus one, such that zero means no handler.
+         */
+        typedef struct
+        {
+            uint16_t child;     ///< Index of the first child node, or zero if none
+            uint16_t sibling;   ///< Index of the next node with the same parent, or zero if none
+            uint16_t exact;     ///< Handler number of the command that ends at this node
+            uint16_t first;     ///< Handler number of the first registered command that begins with this node
+            char c;             ///< Lower-case character of this node
+        } CmdTrieNode;
+
+        /**
+         * Constructor that uses the given memory and never grows it
+         * @see StaticCommandProcessor
+         */
+        CommandProcessor(CmdProcessorType *pHandlers, uint16_t maxCmds, CmdTrieNode *pTrie, uint16_t maxTrieNodes);
+
+    private:
+        /// The memory is either owned or given by StaticCommandProcessor, so do not copy
+        CommandProcessor(const CommandProcessor&) = delete;
+        CommandProcessor& operator=(const CommandProcessor&) = delete;
+
+        CmdProcessorType *mpHandlers;   ///< Array of the command handlers
+        CmdTrieNode *mpTrie;            ///< Trie of the command names, node 0 is the root
+        uint16_t mNumCmds;              ///< Number of command handlers in mpHandlers
+        uint16_t mMaxCmds;              ///< Capacity of mpHandlers
+        uint16_t mNumTrieNodes;         ///< Number of nodes used in mpTrie
+        uint16_t mMaxTrieNodes;         ///< Capacity of mpTrie
+        bool mOwnsMemory;               ///< If true, the arrays are on the heap and grow as needed
+        bool mEnShortCmds;              ///< Enables partial matching of command names
+
+        /// Sets the initial state with the given memory
+        void init(CmdProcessorType *pHandlers, uint16_t maxCmds, CmdTrieNode *pTrie, uint16_t maxTrieNodes);
+
+        /// @returns true if there is room for one more handler and the trie nodes of pCmdStr, growing the memory if owned
+        bool makeRoom(const char* pCmdStr);
+
+        /// Adds the command to mpTrie with the given handler number
+        void addToTrie(const char* pCmdStr, uint16_t handlerNum);
+
+        /**
+         * Finds the handler of the command name (first word of the input)
+         * @param allowShortCmd  If true, the command name can be the short-hand of a command
+         * @returns the handler or NULL if not found
+         */
+        CmdProcessorType* findHandler(const str_view& cmdName, bool allowShortCmd);
 
         /// Handles a command stored at input and stores output in output object
         void handleCmd(str& input, CharDev& output);
@@ -169,4 +229,219 @@ class CommandProcessor
         void prepareCmdParam(str& input, const char* pCmdToRemove);
 };
 
+/**
+ * Command processor that stores its commands inside the object, so the heap is never used.
+ * addHandler() returns false once MAX_CMDS commands are added, or if the command names need
+ * more than MAX_TRIE_NODES trie nodes.  The root takes one node, and each command takes one
+ * node for each of its characters that it does not share as a prefix with an earlier command.
+ */
+template <unsigned int MAX_CMDS, unsigned int MAX_TRIE_NODES = MAX_CMDS * 6>
+class StaticCommandProcessor : public CommandProcessor
+{
+    public:
+        StaticCommandProcessor() : CommandProcessor(mHandlers, MAX_CMDS, mTrie, MAX_TRIE_NODES) { }
+
+    private:
+        static_assert(MAX_TRIE_NODES >= 2 && MAX_TRIE_NODES <= 0xFFFF, "Trie nodes must fit uint16_t indexes");
+
+        CmdProcessorType mHandlers[MAX_CMDS];  ///< Memory of the command handlers
+        CmdTrieNode mTrie[MAX_TRIE_NODES];     ///< Memory of the trie
+};
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+/// CharDev that discards the output
+class TestNullCharDev : public CharDev
+{
+    public:
+        bool getChar(char* pInputChar, unsigned int timeout=portMAX_DELAY) { return false; }
+        bool putChar(char out, unsigned int timeout=portMAX_DELAY) { return true; }
+};
+
+/// Handler that stores the parameters to the str pointed by pDataParam
+static inline CMD_HANDLER_FUNC(test_cmd_handler)
+{
+    *((str*) pDataParam) = cmdParams;
+    return true;
+}
+
+static inline void test_command_handler(void)
+{
+    TestNullCharDev out;
+    str a, b, c, d;
+    CommandProcessor cp;
+    cp.addHandler(test_cmd_handler, "cat", "", &a);
+    cp.addHandler(test_cmd_handler, "canbus", "", &b);
+    cp.addHandler(test_cmd_handler, "cp", "", &c);
+    cp.addHandler(test_cmd_handler, "CPU", "", &d);
+
+    str cmd = "cat 0:file.txt\r\n";
+    assert(cp.handleCommand(cmd, out) && a == "0:file.txt");
+    cmd = "CANBUS init";
+    assert(cp.handleCommand(cmd, out) && b == "init");
+
+    /* Exact match takes precedence over short-hand, and first registered short-hand wins */
+    cmd = "cp x";
+    assert(cp.handleCommand(cmd, out) && c == "x");
+    cmd = "cpu y";
+    assert(cp.handleCommand(cmd, out) && d == "y");
+    cmd = "ca z";
+    assert(cp.handleCommand(cmd, out) && a == "z");
+    cmd = "canb 1";
+    assert(cp.handleCommand(cmd, out) && b == "1");
+
+    /* Short-hand needs two chars, and cannot be longer than the command */
+    cmd = "c 1";
+    assert(!cp.handleCommand(cmd, out));
+    cmd = "cats";
+    assert(!cp.handleCommand(cmd, out));
+    cmd = "";
+    assert(!cp.handleCommand(cmd, out));
+
+    cp.enableShortCmds(false);
+    cmd = "canb 1";
+    assert(!cp.handleCommand(cmd, out));
+    cmd = "help cpu";
+    assert(cp.handleCommand(cmd, out));
+
+    /* Heap memory grows as commands are added */
+    CommandProcessor small(1);
+    assert(small.addHandler(test_cmd_handler, "cat", "", &a));
+    assert(small.addHandler(test_cmd_handler, "canbus", "", &b));
+    assert(small.addHandler(test_cmd_handler, "telemetry", "", &c));
+    cmd = "tel 1";
+    assert(small.handleCommand(cmd, out) && c == "1");
+
+    /* Static memory of 2 commands and 8 trie nodes, the root uses one node */
+    StaticCommandProcessor<2, 8> scp;
+    assert(!scp.addHandler(test_cmd_handler, "telemetry", "", &a));  /* Needs 9 nodes */
+    assert(scp.addHandler(test_cmd_handler, "cat", "", &a));         /* Needs 3 nodes */
+    assert(!scp.addHandler(test_cmd_handler, "cpuinfo", "", &c));    /* Shares "c", needs 6 nodes but 4 are left */
+    assert(scp.addHandler(test_cmd_handler, "canbus", "", &b));      /* Shares "ca", needs 4 nodes */
+    assert(!scp.addHandler(test_cmd_handler, "ca", "", &c));         /* No nodes needed, but 2 commands max */
+    cmd = "cat x";
+    assert(scp.handleCommand(cmd, out) && a == "x");
+    cmd = "canb y";
+    assert(scp.handleCommand(cmd, out) && b == "y");
+    cmd = "cp z";
+    assert(!scp.handleCommand(cmd, out));
+
+    puts("\nCommand Handler Tests Successful!");
+}
+
+#ifndef __arm__
+#include <string.h>
+#include <chrono>
+/**
+ * The previous linear search of the commands, only kept to compare the benchmark against it.
+ * Each command is checked as a whole word, and if none matches, the short-hand is checked
+ * by scanning the command name and copying each registered command.
+ */
+class TestLegacyCommandProcessor
+{
+    public:
+        TestLegacyCommandProcessor() : mNumCmds(0) { }
+
+        void addHandler(CmdHandlerFuncPtr pFunc, const char* pCmdStr, void* pDataParam)
+        {
+            mFuncs[mNumCmds] = pFunc;
+            mCmds[mNumCmds] = pCmdStr;
+            mParams[mNumCmds++] = pDataParam;
+        }
+
+        bool handleCommand(str& cmd, CharDev& output)
+        {
+            cmd.trimEnd("\r\n");
+            if (cmd.beginsWithWholeWordIgnoreCase("help")) {
+                return true;
+            }
+            for (int i = 0; i < mNumCmds; i++) {
+                if (cmd.beginsWithWholeWordIgnoreCase(mCmds[i])) {
+                    return call(i, cmd, output);
+                }
+            }
+            for (int i = 0; i < mNumCmds; i++) {
+                STR_ON_STACK(regCmd, 32);
+                regCmd = mCmds[i];
+                char shortCmd[8] = { 0 };
+                cmd.scanf("%7s ", shortCmd);
+                if (strlen(shortCmd) >= 2 && regCmd.beginsWithIgnoreCase(shortCmd)) {
+                    return call(i, cmd, output);
+                }
+            }
+            return false;
+        }
+
+    private:
+        bool call(int i, str& cmd, CharDev& output)
+        {
+            const int space = cmd.firstIndexOf(" ");
+            cmd.eraseFirst(space < 0 ? cmd.getLen() : space);
+            cmd.trimStart(" ");
+            mFuncs[i](cmd, output, mParams[i]);
+            return true;
+        }
+
+        CmdHandlerFuncPtr mFuncs[256];
+        const char* mCmds[256];
+        void* mParams[256];
+        int mNumCmds;
+};
+
+/// @returns the ns per command to dispatch pCmd count times
+template <typename CMD_PROC>
+static inline double test_command_handler_time(CMD_PROC& cp, const char* pCmd, int count)
+{
+    typedef std::chrono::steady_clock clock;
+    TestNullCharDev out;
+    STR_ON_STACK(cmd, 32);
+
+    const clock::time_point start = clock::now();
+    for (int i = 0; i < count; i++) {
+        cmd = pCmd;
+        cmd += " 1 2 3";
+        cp.handleCommand(cmd, out);
+    }
+    return std::chrono::duration<double>(clock::now() - start).count() * 1e9 / count;
+}
+
+/// Host only benchmark of the dispatch time as the number of commands grows, against the previous linear search
+static inline void test_command_handler_benchmark(void)
+{
+    static char names[256][8];
+    const int count = 100 * 1000;
+    str params;
+
+    printf("\nCommands | exact: previous      trie | short-hand: previous      trie");
+    for (int numCmds = 8; numCmds <= 256; numCmds *= 2)
+    {
+        CommandProcessor cp(numCmds);
+        TestLegacyCommandProcessor legacy;
+        for (int i = 0; i < numCmds; i++) {
+            sprintf(names[i], "cmd%03i", i);
+            cp.addHandler(test_cmd_handler, names[i], "", &params);
+            legacy.addHandler(test_cmd_handler, names[i], &params);
+        }
+
+        /* Last registered command is the worst case of the linear search, and its
+         * short-hand (without the last digit) is found by the second linear search
+         */
+        char shortCmd[8];
+        strcpy(shortCmd, names[numCmds - 1]);
+        shortCmd[strlen(shortCmd) - 1] = '\0';
+
+        printf("\n%8i | %12.1f ns %6.1f ns | %17.1f ns %6.1f ns", numCmds,
+               test_command_handler_time(legacy, names[numCmds - 1], count),
+               test_command_handler_time(cp, names[numCmds - 1], count),
+               test_command_handler_time(legacy, shortCmd, count),
+               test_command_handler_time(cp, shortCmd, count));
+    }
+    puts("");
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
 #endif /* COMMANDHANDLER_HPP_ */
@@ -21,6 +21,8 @@
  * @brief This is a logger that logs data to a file on the system such as an SD Card.
  * @ingroup Utilities
  *
+ * 20261015: Replaced the buffer queues with per-task lock-free rings (log_ring.h)
+ * 20261015: Added binary log mode (FILE_LOGGER_BINARY)
  * 20140714: Fixed bugs and added more API
  * 20140529: Changed completely to C and FreeRTOS based logger
  * 20120923: modified flush() to use semaphores
@@ -37,31 +39,45 @@ extern "C" {
 
 /**
  * @{
- * The main parameters are the buffer size, and number of message buffers. The buffer size controls how
+ * The main parameters are the buffer size, and the size of the task buffers. The buffer size controls how
  * much data we can cache before we are forced to write it to the output file.
  *
- * The message buffers are the maximum number of LOGGING calls (macros) that can occur at once after which
- * the caller to LOG macro will be blocked.  Note that even a small number like 5 is good enough because
- * as soon as there is time for the logging task to run, it will transfer the LOGGED message into the
- * file buffer immediately.  So this number is kind of like a double buffer.  On the other hand, please
- * note that while the file is being written, the number of buffers need to be enough because the logger
- * task will be busy writing the buffer to the file.
+ * Each task that logs gets its own task buffer the first time it logs.  This is a lock-free ring of log
+ * messages, so a LOG macro never waits for another task or for the logger task; it writes the message
+ * to its ring, and the logger task gathers the messages of all rings in the order they were logged.
+ * A message is logged if FILE_LOGGER_LOG_MSG_MAX_LEN bytes are free, but only its actual length is kept,
+ * so a 512 byte ring holds at least 5 typical text messages, or 8 binary records.
+ * When the FILE_LOGGER_MAX_TASKS rings are taken, the rest of the tasks share one more ring under a mutex.
  *
- * For example, if we anticipate logging every 10ms, and 1K of data takes 100ms to write, then we should
- * configure the number of logging buffers greater than 10 because while the logger task is busy writing
- * 1K of data for 100ms, we need to be able to write for 100ms, which will take at least 10 buffers.
+ * The task buffer needs to be large enough for the messages the task logs while the logger task is busy
+ * writing the file.  For example, if a task logs every 10ms, and 1K of data takes 100ms to write, then
+ * the ring should hold more than 10 messages.  If the ring is full, the LOG macro either drops the message
+ * or sleeps until there is space, based on FILE_LOGGER_DROP_WHEN_FULL.
  *
  * The flush timeout is the timeout after which point we are forced to flush the data buffer to the file.
  * So in an event when no logging calls occur and there is data in the buffer, we will write it to the
  * file after this time.
+ *
+ * In binary mode, the logging call does not run printf() formatting, and only stores the address of
+ * the format string and the raw arguments.  This takes a fraction of the CPU time and about half of the
+ * bytes of the text log.  Use tools/BinaryLog/log_decoder.py with the firmware .elf file that created
+ * the log to convert the .bin file back to the same text as the text log.
  */
 #define FILE_LOGGER_BUFFER_SIZE      (1 * 1024)     ///< Recommend multiples of 512
-#define FILE_LOGGER_NUM_BUFFERS      10             ///< Number of buffers (need to have enough while file is being written)
+#define FILE_LOGGER_TASK_BUFFER_SIZE (512)          ///< Size of the ring of each task (must be a power of 2)
+#define FILE_LOGGER_MAX_TASKS        (8)            ///< Max number of tasks with their own ring
+#define FILE_LOGGER_DROP_WHEN_FULL   (0)            ///< If non-zero, messages are dropped instead of blocking when the ring is full
 #define FILE_LOGGER_LOG_MSG_MAX_LEN  150            ///< Max length of a log message
+#ifndef FILE_LOGGER_BINARY
+#define FILE_LOGGER_BINARY           (0)            ///< If non-zero, logs are written as binary records (@see log_binary.h), set by the makefile
+#endif
+#if (FILE_LOGGER_BINARY)
+#define FILE_LOGGER_FILENAME         "0:log.bin"    ///< Destination filename (0: for SPI flash, 1: for SD card)
+#else
 #define FILE_LOGGER_FILENAME         "0:log.csv"    ///< Destination filename (0: for SPI flash, 1: for SD card)
+#endif
 #define FILE_LOGGER_STACK_SIZE       (3 * 512 / 4)  ///< Stack size in 32-bit (1 = 4 bytes for 32-bit CPU)
 #define FILE_LOGGER_FLUSH_TIME_SEC   (1 * 60)       ///< Logs are flushed after this time
-#define FILE_LOGGER_BLOCK_TIME_MS    (10)           ///< If no buffer available within this time, block time counter will increment
 #define FILE_LOGGER_KEEP_FILE_OPEN   (0)            ///< If non-zero, the file will be kept open
 /** @} */
 
@@ -145,8 +161,8 @@ void logger_set_printf(logger_msg_t type, bool enable);
 
 /**
  * Flushes the cached log data to the file
- * @post  This will send a special request on the logger queue to flush the data, so
- *        the actual flushing will finish by the logger task at a later time.
+ * @post  This will send a flush request to the logger task, so the actual flushing
+ *        will finish by the logger task at a later time.
  *
  * @note Flushing is not needed when the OS is running.
  */
@@ -160,26 +176,32 @@ uint32_t logger_get_logged_call_count(logger_msg_t severity);
 
 /**
  * @returns the number of logging calls that ended up blocking or sleeping the task
- *          waiting for a logger buffer to be available.
+ *          waiting for space in its task buffer.
  *
  * If the number is greater than zero, it indicates that you either need to slow
- * down logger calls, or increase the number of log buffers.
+ * down logger calls, or increase FILE_LOGGER_TASK_BUFFER_SIZE.
  */
 uint16_t logger_get_blocked_call_count(void);
 
 /**
  * @returns the highest time that was spend writing the logger buffer to file.
- * This can be useful to assess how many FILE_LOGGER_NUM_BUFFERS we need because we only
- * need enough buffers available while the file buffer is being written.
+ * This can be useful to assess FILE_LOGGER_TASK_BUFFER_SIZE because we only
+ * need enough space in the task buffers while the file buffer is being written.
  */
 uint16_t logger_get_highest_file_write_time_ms(void);
 
 /**
- * @returns the highest watermark of the number of buffers available to the logger
- * This can be useful to assess how many FILE_LOGGER_NUM_BUFFERS we need in the worst case.
+ * @returns the highest number of messages that were waiting in the task buffers
+ * when the logger task gathered them.
  */
 uint16_t logger_get_num_buffers_watermark(void);
 
+/**
+ * @returns the number of logging calls that were dropped because the task buffer was full.
+ * This is only non-zero if FILE_LOGGER_DROP_WHEN_FULL is set.
+ */
+uint32_t logger_get_dropped_call_count(void);
+
 
 
 
@@ -0,0 +1,674 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Digital filters for sensor data
+ * @ingroup Utilities
+ *
+ * Version: 20261015    Initial
+ */
+#ifndef FILTERS_HPP_
+#define FILTERS_HPP_
+
+#include <stdint.h>
+#include <math.h>
+#include <limits>
+#include "sampler.hpp"
+
+
+
+/**
+ * Math used by the filters for each sample type.
+ *
+ * The filter math is selected at compile time by the sample type :
+ *  - float    : Floating point math (slow on LPC1758 because it has no FPU)
+ *  - int16_t  : Q15 coefficients with 64-bit accumulator
+ *  - uint16_t : Q15 coefficients with 64-bit accumulator, such as for ADC or light sensor readings
+ *  - int32_t  : Q31 coefficients with 64-bit accumulator
+ *
+ * Integer samples do not need to be fractional numbers; the coefficients are fractional
+ * and the result is rounded and saturated back to the sample type.  Filters take real
+ * (float) coefficients only while they are being configured.
+ */
+template <typename TYPE>
+struct FilterMath;
+
+/// Fixed-point filter math with FRAC_BITS fractional bits of the coefficients
+template <typename TYPE, typename COEF, typename ACC, int FRAC_BITS>
+struct FixedPointFilterMath
+{
+    typedef COEF coef_t;    ///< Coefficient type
+    typedef ACC acc_t;      ///< Accumulator type
+    static const int fracBits = FRAC_BITS;
+
+    /* The EMA multiplies a coefficient by the difference of two samples, which needs one more bit than a sample */
+    static_assert(std::numeric_limits<COEF>::digits + std::numeric_limits<TYPE>::digits + 1 <= std::numeric_limits<ACC>::digits,
+                  "The product of a coefficient and the difference of two samples must fit the accumulator");
+
+    /// @returns the real coefficient c as fixed-point with frac fractional bits (rounded and saturated)
+    static coef_t toCoef(float c, int frac = FRAC_BITS)
+    {
+        const float scaled = c * (float)((acc_t)1 << frac);
+        const float max = (float)std::numeric_limits<coef_t>::max();
+        const float min = (float)std::numeric_limits<coef_t>::min();
+        return (scaled >= max) ? std::numeric_limits<coef_t>::max() :
+               (scaled <= min) ? std::numeric_limits<coef_t>::min() :
+               (coef_t)(scaled + ((scaled >= 0) ? 0.5f : -0.5f));
+    }
+
+    /// @returns c * x, both operands are widened to the accumulator before the multiplication
+    static inline acc_t mul(coef_t c, acc_t x)         { return (acc_t)c * x; }
+    static inline acc_t toAcc(TYPE x, int frac = FRAC_BITS) { return (acc_t)x * ((acc_t)1 << frac); }
+
+    /// @returns the accumulator with frac fractional bits as a rounded and saturated sample
+    static inline TYPE toSample(acc_t a, int frac = FRAC_BITS)
+    {
+        a = (a + ((acc_t)1 << (frac - 1))) >> frac;
+        return (a > std::numeric_limits<TYPE>::max()) ? std::numeric_limits<TYPE>::max() :
+               (a < std::numeric_limits<TYPE>::min()) ? std::numeric_limits<TYPE>::min() : (TYPE)a;
+    }
+};
+
+template <> struct FilterMath<int16_t>  : FixedPointFilterMath<int16_t,  int16_t, int64_t, 15> { };
+template <> struct FilterMath<uint16_t> : FixedPointFilterMath<uint16_t, int16_t, int64_t, 15> { };
+template <> struct FilterMath<int32_t>  : FixedPointFilterMath<int32_t,  int32_t, int64_t, 31> { };
+
+template <>
+struct FilterMath<float>
+{
+    typedef float coef_t;
+    typedef float acc_t;
+    static const int fracBits = 0;
+
+    static inline coef_t toCoef(float c, int = 0)        { return c; }
+    static inline acc_t mul(coef_t c, acc_t x)           { return c * x; }
+    static inline acc_t toAcc(float x, int = 0)          { return x; }
+    static inline float toSample(acc_t a, int = 0)       { return a; }
+};
+
+
+
+/**
+ * Exponential moving average filter: y += alpha * (x - y)
+ * @ingroup Utilities
+ *
+ * The output is kept with extra fractional bits, so small alpha values do not
+ * cause the output to get stuck a few counts away from the input.
+ *
+ * @code
+ * EmaFilter<uint16_t> light(0.1f);
+ * uint16_t filtered = light.filter(LS.getRawValue());
+ * @endcode
+ */
+template <typename TYPE>
+class EmaFilter
+{
+    public:
+        typedef FilterMath<TYPE> M;
+
+        /// @param alpha  The weight of each new sample from 0 to 1; smaller value filters more
+        EmaFilter(float alpha) : mAlpha(M::toCoef(alpha)), mOutput(0), mPrimed(false) { }
+
+        TYPE filter(const TYPE& x)
+        {
+            if (!mPrimed) {
+                mOutput = M::toAcc(x);
+                mPrimed = true;
+            }
+            else {
+                /* The error needs one more bit than the samples, and the product is done in the
+                 * accumulator type (int64_t) before mOutput is shifted back to a sample
+                 */
+                const typename M::acc_t error = (typename M::acc_t)x - (typename M::acc_t)getOutput();
+                mOutput += M::mul(mAlpha, error);
+            }
+            return getOutput();
+        }
+
+        inline TYPE getOutput(void) const { return M::toSample(mOutput); }
+        inline void reset(void) { mOutput = 0; mPrimed = false; }
+
+    private:
+        const typename M::coef_t mAlpha;    ///< Weight of the new sample
+        typename M::acc_t mOutput;          ///< Output with M::fracBits fractional bits
+        bool mPrimed;                       ///< Output is set to first sample to avoid a slow start from zero
+};
+
+
+
+/**
+ * Moving average (boxcar) filter over the last N samples.
+ * This uses Sampler which computes the average in O(1).
+ * @ingroup Utilities
+ */
+template <typename TYPE, typename SUM_TYPE = typename FilterMath<TYPE>::acc_t>
+class MovingAverageFilter : public Sampler<TYPE, SUM_TYPE>
+{
+    public:
+        MovingAverageFilter(int numSamples) : Sampler<TYPE, SUM_TYPE>(numSamples) { }
+
+        TYPE filter(const TYPE& x)
+        {
+            this->storeSample(x);
+            return this->getAverage();
+        }
+
+        inline TYPE getOutput(void) const { return this->getAverage(); }
+        inline void reset(void) { this->clear(); }
+};
+
+
+
+/**
+ * Running median filter of the last N samples with O(log N) cost per sample.
+ * @ingroup Utilities
+ *
+ * The samples are kept in two heaps that share the median as their root.
+ * Positions below zero are a max-heap of samples smaller than the median, and
+ * positions above zero are a min-heap of samples larger than the median.  When
+ * a new sample overwrites the oldest sample, it only needs to be moved up or
+ * down its heap (and possibly across the median).
+ *
+ * If the number of samples is even, the higher of the two middle samples is
+ * returned.  Use an odd number of samples to get the true median.
+ */
+template <typename TYPE>
+class MedianFilter
+{
+    public:
+        MedianFilter(int numSamples) : mSize(numSamples)
+        {
+            mSamples = new TYPE[numSamples];
+            mPos = new int[numSamples];
+            mHeapMem = new int[numSamples];
+            mHeap = mHeapMem + (numSamples / 2);
+            reset();
+        }
+
+        ~MedianFilter()
+        {
+            delete [] mSamples;
+            delete [] mPos;
+            delete [] mHeapMem;
+        }
+
+        TYPE filter(const TYPE& x)
+        {
+            const int slot = mNext;
+            mSamples[slot] = x;
+            if (++mNext >= mSize) {
+                mNext = 0;
+            }
+            if (mCount < mSize) {
+                mCount++;
+            }
+
+            /* The sample value at its heap position changed, so restore the heap property */
+            int p = mPos[slot];
+            if (p > 0) {
+                if (less(p, p / 2)) {
+                    if (0 == (p = minSortUp(p))) {
+                        maxSortDown(0);
+                    }
+                }
+                else {
+                    minSortDown(p);
+                }
+            }
+            else if (p < 0) {
+                if (less(p / 2, p)) {
+                    if (0 == (p = maxSortUp(p))) {
+                        minSortDown(0);
+                    }
+                }
+                else {
+                    maxSortDown(p);
+                }
+            }
+            else {
+                maxSortDown(0);
+                minSortDown(0);
+            }
+
+            return getOutput();
+        }
+
+        inline TYPE getOutput(void) const { return mSamples[mHeap[0]]; }
+
+        void reset(void)
+        {
+            mNext = mCount = 0;
+
+            /* Slots are assigned to the median, then alternating max and min heap: 0, -1, 1, -2, 2 ... */
+            for (int i = 0; i < mSize; i++) {
+                mSamples[i] = 0;
+                mPos[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+                mHeap[mPos[i]] = i;
+            }
+        }
+
+    private:
+        inline int minCount(void) const { return (mCount - 1) / 2; } ///< Number of samples in min-heap
+        inline int maxCount(void) const { return mCount / 2; }       ///< Number of samples in max-heap
+
+        /// @returns true if sample at heap position i is less than the sample at heap position j
+        inline bool less(int i, int j) const { return mSamples[mHeap[i]] < mSamples[mHeap[j]]; }
+
+        inline void swap(int i, int j)
+        {
+            const int t = mHeap[i];
+            mHeap[i] = mHeap[j];
+            mHeap[j] = t;
+            mPos[mHeap[i]] = i;
+            mPos[mHeap[j]] = j;
+        }
+
+        /// Moves the sample at i towards the median; @returns its new position
+        int minSortUp(int i)
+        {
+            while (i > 0 && less(i, i / 2)) {
+                swap(i, i / 2);
+                i /= 2;
+            }
+            return i;
+        }
+        int maxSortUp(int i)
+        {
+            while (i < 0 && less(i / 2, i)) {
+                swap(i, i / 2);
+                i /= 2;
+            }
+            return i;
+        }
+
+        /// Moves the sample at i away from the median; the only child of the median is 1 (or -1)
+        void minSortDown(int i)
+        {
+            for (int c = (0 == i) ? 1 : (2 * i); c <= minCount(); c = 2 * i)
+            {
+                if (c > 1 && c < minCount() && less(c + 1, c)) {
+                    c++;
+                }
+                if (!less(c, i)) {
+                    break;
+                }
+                swap(c, i);
+                i = c;
+            }
+        }
+        void maxSortDown(int i)
+        {
+            for (int c = (0 == i) ? -1 : (2 * i); c >= -maxCount(); c = 2 * i)
+            {
+                if (c < -1 && c > -maxCount() && less(c, c - 1)) {
+                    c--;
+                }
+                if (!less(i, c)) {
+                    break;
+                }
+                swap(c, i);
+                i = c;
+            }
+        }
+
+        const int mSize;    ///< Number of samples
+        int mNext;          ///< Slot of the next sample
+        int mCount;         ///< Number of samples stored
+        TYPE *mSamples;     ///< Samples in the order they were stored
+        int *mPos;          ///< Heap position of each sample slot
+        int *mHeapMem;      ///< Memory of the heap
+        int *mHeap;         ///< Sample slots indexed by position -N/2 to N/2; mHeap[0] is the median
+};
+
+
+
+/**
+ * Biquad (second order IIR) filter in Direct Form I
+ * y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2
+ * @ingroup Utilities
+ *
+ * For integer samples, the coefficients use one less fractional bit (Q14 or Q30)
+ * such that coefficients from -2 to 2 can be used.  Direct Form I is used because
+ * its single accumulator cannot overflow internally in fixed-point.
+ *
+ * @code
+ * BiquadFilter<int16_t> lpf;
+ * lpf.setLowPass(5, 100);   // 5Hz cutoff with 100Hz sample rate
+ * int16_t x = lpf.filter(AS.getX());
+ * @endcode
+ */
+template <typename TYPE>
+class BiquadFilter
+{
+    public:
+        typedef FilterMath<TYPE> M;
+
+        BiquadFilter() { setCoefficients(1, 0, 0, 0, 0); }
+
+        /// Sets the coefficients normalized such that a0 is 1
+        void setCoefficients(float b0, float b1, float b2, float a1, float a2)
+        {
+            mB0 = M::toCoef(b0, mFrac);
+            mB1 = M::toCoef(b1, mFrac);
+            mB2 = M::toCoef(b2, mFrac);
+            mA1 = M::toCoef(a1, mFrac);
+            mA2 = M::toCoef(a2, mFrac);
+            reset();
+        }
+
+        /**
+         * @{ \name Butterworth (q = 0.7071) or resonant filters from "Audio EQ Cookbook" by R. Bristow-Johnson
+         * @note This uses floating point math, so set the filter once during initialization
+         */
+        void setLowPass(float cutoffHz, float sampleHz, float q = 0.70710678f)
+        {
+            const float w = 2 * (float)M_PI * cutoffHz / sampleHz;
+            const float alpha = sinf(w) / (2 * q);
+            const float c = cosf(w);
+            const float a0 = 1 + alpha;
+            setCoefficients((1 - c) / 2 / a0, (1 - c) / a0, (1 - c) / 2 / a0, -2 * c / a0, (1 - alpha) / a0);
+        }
+        void setHighPass(float cutoffHz, float sampleHz, float q = 0.70710678f)
+        {
+            const float w = 2 * (float)M_PI * cutoffHz / sampleHz;
+            const float alpha = sinf(w) / (2 * q);
+            const float c = cosf(w);
+            const float a0 = 1 + alpha;
+            setCoefficients((1 + c) / 2 / a0, -(1 + c) / a0, (1 + c) / 2 / a0, -2 * c / a0, (1 - alpha) / a0);
+        }
+        /** @} */
+
+        TYPE filter(const TYPE& x)
+        {
+            typename M::acc_t acc = M::mul(mB0, x) + M::mul(mB1, mX1) + M::mul(mB2, mX2)
+                                  - M::mul(mA1, mY1) - M::mul(mA2, mY2);
+            mX2 = mX1;
+            mX1 = x;
+            mY2 = mY1;
+            mY1 = M::toSample(acc, mFrac);
+            return mY1;
+        }
+
+        inline TYPE getOutput(void) const { return mY1; }
+        inline void reset(void) { mX1 = mX2 = mY1 = mY2 = 0; }
+
+    private:
+        /// Coefficients have one less fractional bit to represent values from -2 to 2
+        static const int mFrac = (M::fracBits > 0) ? (M::fracBits - 1) : 0;
+
+        typename M::coef_t mB0, mB1, mB2, mA1, mA2;  ///< Coefficients
+        TYPE mX1, mX2, mY1, mY2;                     ///< Previous inputs and outputs
+};
+
+
+
+/**
+ * Finite impulse response filter: y = sum(h[k] * x[n-k])
+ * @ingroup Utilities
+ *
+ * The delay line is stored twice such that the convolution is a single
+ * linear loop without wrapping the index.
+ */
+template <typename TYPE, int TAPS>
+class FirFilter
+{
+    public:
+        typedef FilterMath<TYPE> M;
+
+        /**
+         * @param pTaps  TAPS number of coefficients h[0] to h[TAPS-1] (h[0] is applied to the newest sample)
+         *               For integer samples, each coefficient must be from -1 to 1.  For int32_t samples,
+         *               the sum of the absolute coefficients must also be less than 2 to fit the int64_t sum.
+         */
+        FirFilter(const float *pTaps)
+        {
+            for (int i = 0; i < TAPS; i++) {
+                mTaps[i] = M::toCoef(pTaps[i]);
+            }
+            reset();
+        }
+
+        TYPE filter(const TYPE& x)
+        {
+            /* Write the sample at both copies of the delay line */
+            if (--mIndex < 0) {
+                mIndex = TAPS - 1;
+            }
+            mDelay[mIndex] = mDelay[mIndex + TAPS] = x;
+
+            /* mDelay[mIndex] is the newest sample and mDelay[mIndex + TAPS - 1] is the oldest */
+            const TYPE *pX = &mDelay[mIndex];
+            typename M::acc_t acc = 0;
+            for (int i = 0; i < TAPS; i++) {
+                acc += M::mul(mTaps[i], pX[i]);
+            }
+
+            mOutput = M::toSample(acc);
+            return mOutput;
+        }
+
+        inline TYPE getOutput(void) const { return mOutput; }
+        void reset(void)
+        {
+            mIndex = 0;
+            mOutput = 0;
+            for (int i = 0; i < 2 * TAPS; i++) {
+                mDelay[i] = 0;
+            }
+        }
+
+    private:
+        typename M::coef_t mTaps[TAPS];  ///< Coefficients
+        TYPE mDelay[2 * TAPS];           ///< Delay line of the samples (stored twice)
+        int mIndex;                      ///< Index of the newest sample in mDelay
+        TYPE mOutput;                    ///< Last output
+};
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+static inline void test_filters(void)
+{
+    /* EMA golden vectors: step response of alpha = 0.5 */
+    do {
+        EmaFilter<float> f(0.5f);
+        const float golden[] = { 0, 0.5f, 0.75f, 0.875f, 0.9375f };
+        assert(fabsf(f.filter(0) - golden[0]) < 1e-6f);
+        for (int i = 1; i < 5; i++) {
+            assert(fabsf(f.filter(1) - golden[i]) < 1e-6f);
+        }
+
+        EmaFilter<int16_t> q(0.5f);
+        const int16_t qgolden[] = { 0, 500, 750, 875, 938, 969 };
+        assert(qgolden[0] == q.filter(0));
+        for (int i = 1; i < 6; i++) {
+            assert(qgolden[i] == q.filter(1000));
+        }
+
+        /* Small alpha must still converge to the input */
+        EmaFilter<uint16_t> slow(0.01f);
+        slow.filter(0);
+        for (int i = 0; i < 2000; i++) {
+            slow.filter(100);
+        }
+        assert(100 == slow.getOutput());
+
+        /* Full scale Q31 steps with alpha of 1 have the largest product of alpha and error */
+        EmaFilter<int32_t> q31(1.0f);
+        q31.filter(INT32_MIN);
+        for (int i = 0; i < 4; i++) {
+            assert(q31.filter(INT32_MAX) > INT32_MAX - 4);
+            assert(q31.filter(INT32_MIN) < INT32_MIN + 4);
+        }
+        EmaFilter<int32_t> half(0.5f);
+        half.filter(INT32_MIN);
+        assert(abs(half.filter(INT32_MAX)) <= 1);
+    } while (0);
+
+    /* Moving average */
+    do {
+        MovingAverageFilter<int16_t> f(4);
+        f.filter(4); f.filter(8);
+        assert(6 == f.getOutput());
+        f.filter(-4); f.filter(0); f.filter(12);
+        assert(4 == f.getOutput());
+    } while (0);
+
+    /* Median against brute force with odd and even number of samples */
+    for (int n = 1; n <= 10; n++) {
+        MedianFilter<int32_t> f(n);
+        int32_t ref[10];
+        for (int i = 0; i < 500; i++) {
+            const int32_t x = (rand() % 100) - 50;
+            const int32_t m = f.filter(x);
+            ref[i % n] = x;
+
+            const int count = (i + 1 < n) ? (i + 1) : n;
+            int32_t sorted[10];
+            for (int j = 0; j < count; j++) {
+                sorted[j] = ref[j];
+            }
+            for (int j = 0; j < count; j++) {
+                for (int k = j + 1; k < count; k++) {
+                    if (sorted[k] < sorted[j]) {
+                        const int32_t t = sorted[j]; sorted[j] = sorted[k]; sorted[k] = t;
+                    }
+                }
+            }
+            assert(sorted[count / 2] == m);
+        }
+    }
+    do {
+        MedianFilter<float> f(3);
+        f.filter(1); f.filter(100); f.filter(2);
+        assert(fabsf(2 - f.getOutput()) < 1e-6f);
+    } while (0);
+
+    /* Biquad: fixed-point must track a double precision reference */
+    do {
+        const float fc = 5, fs = 100;
+        BiquadFilter<float> ff;
+        BiquadFilter<int16_t> fq;
+        BiquadFilter<int32_t> fq31;
+        ff.setLowPass(fc, fs);
+        fq.setLowPass(fc, fs);
+        fq31.setLowPass(fc, fs);
+
+        const double w = 2 * M_PI * fc / fs, alpha = sin(w) / (2 * 0.70710678), c = cos(w), a0 = 1 + alpha;
+        const double b0 = (1 - c) / 2 / a0, b1 = (1 - c) / a0, b2 = b0, a1 = -2 * c / a0, a2 = (1 - alpha) / a0;
+        double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+        for (int i = 0; i < 200; i++) {
+            const int16_t x = (i % 40 < 20) ? 10000 : -10000;
+            const double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+            x2 = x1; x1 = x; y2 = y1; y1 = y;
+
+            assert(fabs(ff.filter(x) - y) < 1);
+            assert(fabs(fq.filter(x) - y) < 8);
+            assert(fabs(fq31.filter(x) - y) < 8);
+        }
+
+        /* DC gain of low pass is 1, and of high pass is 0 */
+        BiquadFilter<int16_t> hp;
+        hp.setHighPass(fc, fs);
+        for (int i = 0; i < 500; i++) {
+            fq.filter(1000);
+            hp.filter(1000);
+        }
+        assert(abs(fq.getOutput() - 1000) <= 2);
+        assert(abs(hp.getOutput()) <= 2);
+    } while (0);
+
+    /* FIR golden vectors: 4 tap moving average and a 3 tap differentiator */
+    do {
+        const float avg[] = { 0.25f, 0.25f, 0.25f, 0.25f };
+        FirFilter<int16_t, 4> f(avg);
+        const int16_t in[]     = { 400, 400, 400, 400, 0,   0,   0,   0 };
+        const int16_t golden[] = { 100, 200, 300, 400, 300, 200, 100, 0 };
+        for (int i = 0; i < 8; i++) {
+            assert(golden[i] == f.filter(in[i]));
+        }
+
+        const float diff[] = { 1, 0, -1 };
+        FirFilter<float, 3> d(diff);
+        const float fin[]     = { 1, 2, 4, 8, 16 };
+        const float fgolden[] = { 1, 2, 3, 6, 12 };
+        for (int i = 0; i < 5; i++) {
+            assert(fabsf(fgolden[i] - d.filter(fin[i])) < 1e-6f);
+        }
+
+        /* Saturation instead of overflow */
+        const float gain[] = { 0.9f, 0.9f };
+        FirFilter<int16_t, 2> g(gain);
+        assert(27000 == g.filter(30000));
+        assert(32767 == g.filter(30000));
+    } while (0);
+
+    puts("\nFilter Tests Successful!");
+}
+
+#ifndef __arm__
+#include <chrono>
+/// Host only benchmark of the time per sample of each filter
+template <typename FILTER, typename TYPE>
+static inline void test_filters_benchmark_one(const char *pName, FILTER& f, TYPE)
+{
+    typedef std::chrono::steady_clock clock;
+    const int count = 1000 * 1000;
+    TYPE samples[256];
+    for (int i = 0; i < 256; i++) {
+        samples[i] = (TYPE)(rand() % 2000);
+    }
+
+    double sum = 0;
+    const clock::time_point start = clock::now();
+    for (int i = 0; i < count; i++) {
+        sum += f.filter(samples[i & 255]);
+    }
+    const double sec = std::chrono::duration<double>(clock::now() - start).count();
+    printf("\n%-24s: %6.2f ns/sample [%.0f]", pName, sec * 1e9 / count, sum);
+}
+
+static inline void test_filters_benchmark(void)
+{
+    float taps[16];
+    for (int i = 0; i < 16; i++) {
+        taps[i] = 1.0f / 16;
+    }
+    EmaFilter<float> ef(0.1f);             test_filters_benchmark_one("EMA float", ef, 0.0f);
+    EmaFilter<int16_t> eq(0.1f);           test_filters_benchmark_one("EMA Q15", eq, (int16_t)0);
+    EmaFilter<int32_t> eq31(0.1f);         test_filters_benchmark_one("EMA Q31", eq31, (int32_t)0);
+    MovingAverageFilter<int16_t> ma(64);   test_filters_benchmark_one("Moving average(64) Q15", ma, (int16_t)0);
+    MedianFilter<int16_t> m7(7);           test_filters_benchmark_one("Median(7)", m7, (int16_t)0);
+    MedianFilter<int16_t> m255(255);       test_filters_benchmark_one("Median(255)", m255, (int16_t)0);
+    BiquadFilter<float> bf; bf.setLowPass(5, 100);     test_filters_benchmark_one("Biquad float", bf, 0.0f);
+    BiquadFilter<int16_t> bq; bq.setLowPass(5, 100);   test_filters_benchmark_one("Biquad Q15", bq, (int16_t)0);
+    BiquadFilter<int32_t> bq31; bq31.setLowPass(5, 100); test_filters_benchmark_one("Biquad Q31", bq31, (int32_t)0);
+    FirFilter<float, 16> ff(taps);         test_filters_benchmark_one("FIR(16) float", ff, 0.0f);
+    FirFilter<int16_t, 16> fq(taps);       test_filters_benchmark_one("FIR(16) Q15", fq, (int16_t)0);
+    FirFilter<int32_t, 16> fq31(taps);     test_filters_benchmark_one("FIR(16) Q31", fq31, (int32_t)0);
+    puts("");
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+#endif /* FILTERS_HPP_ */
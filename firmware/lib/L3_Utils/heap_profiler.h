@@ -0,0 +1,339 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Per-task and per-call-site accounting of heap memory
+ * @ingroup Utilities
+ *
+ * sys_get_mem_info() only tells how much heap is used in total.  The profiler tells who
+ * uses it: newlib/memory.cpp reports each malloc() and new (and their free() and delete)
+ * to the profiler if SYS_CFG_HEAP_PROFILER is enabled, along with the address of the code
+ * that made the allocation (the call site).
+ *
+ * For each task, the profiler counts its live bytes, its peak bytes and its number of
+ * allocations.  For each call site, it counts the same, such that the sites holding the
+ * most memory can be listed (look up their addresses in the .lst file of the firmware).
+ *
+ * The live allocations are kept in a hash table keyed by their pointer rather than a
+ * header in front of each allocation.  This way, memory allocated by newlib internally
+ * (such as by strdup()) and freed by free() is simply not found, rather than corrupting
+ * the heap.  If the table is full, the allocation is counted as untracked.
+ *
+ * The profiler does not allocate memory.  It uses about 4K of RAM with the defaults below,
+ * and sizeof(heap_prof_t) tells the exact amount.
+ *
+ * 20261016 : Initial
+ */
+#ifndef HEAP_PROFILER_H__
+#define HEAP_PROFILER_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+#ifndef HEAP_PROF_MAX_ALLOCS
+#define HEAP_PROF_MAX_ALLOCS    256     ///< Size of the live allocation table (power of 2), 3/4 of it can be used
+#endif
+#define HEAP_PROF_MAX_TASKS     16      ///< Max tasks; more tasks are counted in the last task named "other"
+#define HEAP_PROF_MAX_SITES     32      ///< Max call sites (power of 2); more sites are counted in a NULL site
+#define HEAP_PROF_TASK_NAME_LEN 12      ///< Max characters of a task name, including the NULL terminator
+
+/**
+ * The functions the profiler uses to get the current task.
+ * On the board, these use FreeRTOS; the tests provide fake tasks.
+ */
+typedef struct {
+    void* (*get_task)(void);                    ///< @returns the current task, or NULL before the RTOS runs
+    const char* (*get_task_name)(void *task);   ///< @returns the name of a task that is not NULL
+    void (*lock)(void);                         ///< Locks the profiler from other tasks (may be NULL)
+    void (*unlock)(void);                       ///< Unlocks the profiler (may be NULL)
+} heap_prof_task_provider_t;
+
+/// A live allocation
+typedef struct {
+    const void *ptr;    ///< The memory, or NULL if this entry is empty
+    uint32_t size;      ///< The requested size
+    uint8_t task;       ///< Index of the task
+    uint8_t site;       ///< Index of the call site
+} heap_prof_alloc_t;
+
+/// Statistics of a call site
+typedef struct {
+    const void *site;       ///< Address of the code that allocates, NULL for the sites that did not fit
+    uint32_t live_bytes;    ///< Bytes allocated now
+    uint32_t peak_bytes;    ///< The highest live_bytes
+    uint32_t allocs;        ///< Number of allocations ever
+} heap_prof_site_t;
+
+/// Statistics of a task @see heap_prof_get_tasks()
+typedef struct {
+    void *task;                             ///< The task handle, NULL for the allocations before the RTOS runs
+    char name[HEAP_PROF_TASK_NAME_LEN];     ///< Name of the task
+    uint32_t live_bytes;                    ///< Bytes allocated now
+    uint32_t peak_bytes;                    ///< The highest live_bytes
+    uint32_t allocs;                        ///< Number of allocations ever
+} heap_prof_task_t;
+
+/**
+ * The profiler; use the functions rather than accessing its members.
+ * The task statistics are arrays (rather than heap_prof_task_t) such that they can be
+ * registered as telemetry arrays.
+ */
+typedef struct {
+    const heap_prof_task_provider_t *provider;              ///< Set by heap_prof_init()
+
+    void *task_handles[HEAP_PROF_MAX_TASKS];                ///< Task of each task index
+    char task_names[HEAP_PROF_MAX_TASKS][HEAP_PROF_TASK_NAME_LEN]; ///< Name of each task index
+    uint32_t task_live_bytes[HEAP_PROF_MAX_TASKS];          ///< @see heap_prof_task_t
+    uint32_t task_peak_bytes[HEAP_PROF_MAX_TASKS];          ///< @see heap_prof_task_t
+    uint32_t task_allocs[HEAP_PROF_MAX_TASKS];              ///< @see heap_prof_task_t
+    uint32_t task_count;                                    ///< Number of used task indexes
+
+    heap_prof_site_t sites[HEAP_PROF_MAX_SITES + 1];        ///< Hash table of sites, and the NULL site at the end
+    uint32_t site_count;                                    ///< Number of used sites in the hash table
+
+    heap_prof_alloc_t allocs[HEAP_PROF_MAX_ALLOCS];         ///< Hash table of live allocations
+    uint32_t live_allocs;                                   ///< Number of live allocations in the table
+
+    uint32_t live_bytes;                                    ///< Bytes of all tracked allocations
+    uint32_t peak_bytes;                                    ///< The highest live_bytes
+    uint32_t total_allocs;                                  ///< Number of tracked allocations ever
+    uint32_t total_frees;                                   ///< Number of tracked frees ever
+    uint32_t untracked_allocs;                              ///< Number of allocations not tracked because the table was full
+} heap_prof_t;
+
+/**
+ * Initializes the profiler.
+ * A zeroed heap_prof_t whose provider is set is also initialized, such that the profiler
+ * can be a global variable used by malloc() before main().
+ */
+void heap_prof_init(heap_prof_t *prof, const heap_prof_task_provider_t *provider);
+
+/**
+ * Records an allocation by the current task
+ * @param ptr   The memory that was allocated; nothing is recorded if it is NULL
+ * @param size  The requested size
+ * @param site  The address of the code that allocated (such as __builtin_return_address(0))
+ */
+void heap_prof_on_alloc(heap_prof_t *prof, const void *ptr, size_t size, const void *site);
+
+/**
+ * Records that memory is about to be freed; call this before freeing the memory, because once
+ * freed, another task may get the same pointer.
+ * @returns the size of the allocation, or 0 if it was not tracked
+ */
+size_t heap_prof_on_free(heap_prof_t *prof, const void *ptr);
+
+/**
+ * Copies the statistics of the tasks
+ * @returns the number of tasks copied
+ */
+uint32_t heap_prof_get_tasks(heap_prof_t *prof, heap_prof_task_t *tasks, uint32_t max);
+
+/**
+ * Copies the call sites with the most live bytes (and then the most allocations)
+ * @returns the number of sites copied, sorted from the largest
+ */
+uint32_t heap_prof_get_top_sites(heap_prof_t *prof, heap_prof_site_t *sites, uint32_t max);
+
+/**
+ * @returns the profiler of malloc() and new
+ * This only exists if SYS_CFG_HEAP_PROFILER is enabled (newlib/memory.cpp)
+ */
+heap_prof_t* sys_get_heap_prof(void);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Fake task handles and names of the tests
+static char g_test_heap_prof_tasks[HEAP_PROF_MAX_TASKS + 4][8];
+static int g_test_heap_prof_task = -1;
+static int g_test_heap_prof_locked = 0;
+static void* test_heap_prof_get_task(void)
+{
+    return (g_test_heap_prof_task < 0) ? NULL : g_test_heap_prof_tasks[g_test_heap_prof_task];
+}
+static const char* test_heap_prof_get_task_name(void *task)
+{
+    return (const char*) task;
+}
+static void test_heap_prof_lock(void)   { assert(0 == g_test_heap_prof_locked++); }
+static void test_heap_prof_unlock(void) { assert(1 == g_test_heap_prof_locked--); }
+
+static const heap_prof_task_provider_t g_test_heap_prof_provider = {
+    test_heap_prof_get_task, test_heap_prof_get_task_name, test_heap_prof_lock, test_heap_prof_unlock
+};
+
+static inline void test_heap_prof(void)
+{
+    static heap_prof_t prof;
+    static char *ptrs[1000];
+    static uint32_t sizes[1000];
+    heap_prof_task_t tasks[HEAP_PROF_MAX_TASKS];
+    heap_prof_site_t sites[4];
+    const void *site_a = (const void*) &test_heap_prof;
+    const void *site_b = (const void*) &test_heap_prof_get_task;
+    uint32_t i = 0;
+    int t = 0;
+
+    for (i = 0; i < sizeof(g_test_heap_prof_tasks) / sizeof(g_test_heap_prof_tasks[0]); i++) {
+        snprintf(g_test_heap_prof_tasks[i], sizeof(g_test_heap_prof_tasks[i]), "task%u", (unsigned)i);
+    }
+
+    /* A zeroed profiler with a provider works without heap_prof_init(), as a global used before main() */
+    prof.provider = &g_test_heap_prof_provider;
+    char *boot = (char*) malloc(10);
+    heap_prof_on_alloc(&prof, boot, 10, site_a);
+    heap_prof_on_alloc(&prof, NULL, 10, site_a);
+    assert(1 == heap_prof_get_tasks(&prof, tasks, HEAP_PROF_MAX_TASKS));
+    assert(NULL == tasks[0].task && 0 == strcmp("boot", tasks[0].name) && 10 == tasks[0].live_bytes);
+
+    /* Task and site accounting */
+    g_test_heap_prof_task = 0;
+    char *a1 = (char*) malloc(100);
+    char *a2 = (char*) malloc(50);
+    heap_prof_on_alloc(&prof, a1, 100, site_a);
+    heap_prof_on_alloc(&prof, a2, 50, site_b);
+    g_test_heap_prof_task = 1;
+    char *b1 = (char*) malloc(300);
+    heap_prof_on_alloc(&prof, b1, 300, site_b);
+    assert(100 == heap_prof_on_free(&prof, a1));
+    assert(0 == heap_prof_on_free(&prof, a1));
+    free(a1);
+    assert(0 == heap_prof_on_free(&prof, &i));
+
+    assert(3 == heap_prof_get_tasks(&prof, tasks, HEAP_PROF_MAX_TASKS));
+    assert(tasks[1].task == g_test_heap_prof_tasks[0] && 0 == strcmp("task0", tasks[1].name));
+    assert(50 == tasks[1].live_bytes && 150 == tasks[1].peak_bytes && 2 == tasks[1].allocs);
+    assert(300 == tasks[2].live_bytes && 300 == tasks[2].peak_bytes && 1 == tasks[2].allocs);
+    assert(360 == prof.live_bytes && 460 == prof.peak_bytes && 1 == prof.total_frees);
+
+    assert(2 == heap_prof_get_top_sites(&prof, sites, 4));
+    assert(site_b == sites[0].site && 350 == sites[0].live_bytes && 2 == sites[0].allocs);
+    assert(site_a == sites[1].site && 10 == sites[1].live_bytes && 110 == sites[1].peak_bytes);
+    assert(1 == heap_prof_get_top_sites(&prof, sites, 1) && site_b == sites[0].site);
+
+    heap_prof_on_free(&prof, boot);
+    heap_prof_on_free(&prof, a2);
+    heap_prof_on_free(&prof, b1);
+    free(boot);
+    free(a2);
+    free(b1);
+    assert(0 == prof.live_bytes && 0 == prof.live_allocs);
+
+    /* Random allocations from many tasks and sites, compared against a brute force count */
+    heap_prof_init(&prof, &g_test_heap_prof_provider);
+    srand(1);
+    for (i = 0; i < 50000; i++) {
+        const uint32_t idx = rand() % 1000;
+        if (ptrs[idx]) {
+            const size_t size = heap_prof_on_free(&prof, ptrs[idx]);
+            assert(0 == size || size == sizes[idx]);
+            free(ptrs[idx]);
+            ptrs[idx] = NULL;
+        }
+        else {
+            g_test_heap_prof_task = rand() % (HEAP_PROF_MAX_TASKS + 4);
+            sizes[idx] = 1 + rand() % 200;
+            ptrs[idx] = (char*) malloc(sizes[idx]);
+            heap_prof_on_alloc(&prof, ptrs[idx], sizes[idx], (const char*)site_a + (rand() % 50));
+        }
+    }
+
+    uint32_t live_allocs = 0, task_allocs = 0;
+    for (i = 0; i < 1000; i++) {
+        size_t size = 0;
+        if (ptrs[i] && 0 != (size = heap_prof_on_free(&prof, ptrs[i]))) {
+            assert(size == sizes[i]);
+            live_allocs++;
+        }
+        free(ptrs[i]);
+        ptrs[i] = NULL;
+    }
+    assert(prof.untracked_allocs > 0);
+    assert(live_allocs <= HEAP_PROF_MAX_ALLOCS * 3 / 4);
+    assert(0 == prof.live_bytes && 0 == prof.live_allocs);
+
+    /* Tasks beyond the max are counted in "other", and sites beyond the max in the NULL site */
+    assert(HEAP_PROF_MAX_TASKS == heap_prof_get_tasks(&prof, tasks, HEAP_PROF_MAX_TASKS));
+    assert(0 == strcmp("other", tasks[HEAP_PROF_MAX_TASKS - 1].name));
+    assert(HEAP_PROF_MAX_SITES - 1 == prof.site_count && prof.sites[HEAP_PROF_MAX_SITES].allocs > 0);
+    for (t = 0; t < HEAP_PROF_MAX_TASKS; t++) {
+        assert(0 == tasks[t].live_bytes && tasks[t].peak_bytes > 0);
+        task_allocs += tasks[t].allocs;
+    }
+    assert(task_allocs == prof.total_allocs);
+
+    puts("\nHeap Profiler Tests Successful!");
+}
+
+#ifndef __arm__
+#include <time.h>
+/// Host only benchmark of the cost of the profiler on each malloc() and free()
+static inline void test_heap_prof_benchmark(void)
+{
+    static heap_prof_t prof;
+    const int count = 1000 * 1000;
+    void *ptrs[64] = { 0 };
+    int i = 0, p = 0;
+
+    heap_prof_init(&prof, &g_test_heap_prof_provider);
+    g_test_heap_prof_task = 3;
+
+    for (p = 0; p < 2; p++) {
+        clock_t start = clock();
+        for (i = 0; i < count; i++) {
+            const int idx = i & 63;
+            if (ptrs[idx]) {
+                if (p) {
+                    heap_prof_on_free(&prof, ptrs[idx]);
+                }
+                free(ptrs[idx]);
+            }
+            ptrs[idx] = malloc(16 + (i & 127));
+            if (p) {
+                heap_prof_on_alloc(&prof, ptrs[idx], 16 + (i & 127), (const char*)&prof + (i & 15));
+            }
+        }
+        const double sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+        printf("\nmalloc() + free() %s profiler: %6.1f ns", p ? "with   " : "without", sec * 1e9 / count);
+    }
+    for (i = 0; i < 64; i++) {
+        free(ptrs[i]);
+    }
+    printf("\nProfiler RAM: %u bytes\n", (unsigned) sizeof(heap_prof_t));
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* HEAP_PROFILER_H__ */
@@ -0,0 +1,251 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Binary log records with deferred formatting, used by the file logger
+ * @ingroup Utilities
+ *
+ * Instead of running printf() when a message is logged, a binary log record stores the
+ * address of the printf() format string and the raw values of its arguments.  Strings in
+ * flash memory (format strings, __FILE__ and __FUNCTION__) never change, so only their
+ * address is stored, and the host tool (tools/BinaryLog/log_decoder.py) looks them up from
+ * the firmware image to produce the same text as the text log.
+ *
+ * Record layout (little endian, no padding):
+ *  - uint8_t   Record length in bytes (including this byte)
+ *  - uint8_t   Type: logger_msg_t, or LOG_BINARY_RAW_TYPE.  Bit 7 is set if the format string is inline
+ *  - uint16_t  Line number
+ *  - uint32_t  RTC time: month << 22 | day << 17 | hour << 12 | min << 6 | sec
+ *  - uint32_t  Uptime in milliseconds
+ *  - uint32_t  Address of the filename string (zero if none)
+ *  - uint32_t  Address of the function name string (zero if none)
+ *  - Format    uint32_t address, or if inline then uint8_t length and the characters
+ *  - Arguments in the order of the format string:
+ *      - 4 bytes for char, int, long, and pointers (and '*' width or precision)
+ *      - 8 bytes for long long and double
+ *      - %s is uint8_t 0xFF followed by uint32_t address if it is in flash,
+ *        otherwise uint8_t length and the characters
+ *
+ * If the record does not fit, the arguments that do not fit are left out and the
+ * decoder stops formatting at the same point, similar to snprintf() truncation.
+ *
+ * 20261015 : Initial
+ */
+#ifndef LOG_BINARY_H__
+#define LOG_BINARY_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+
+
+#define LOG_BINARY_RAW_TYPE      0x7F    ///< Record type of a raw message that has no header
+#define LOG_BINARY_INLINE_FMT    0x80    ///< Type flag if the format string is stored inline
+#define LOG_BINARY_INLINE_STR    0xFF    ///< %s argument length that means a flash address follows
+#define LOG_BINARY_HEADER_SIZE   20      ///< Size of the record before the format string
+
+/// Header fields of a binary log record
+typedef struct {
+    uint8_t type;           ///< logger_msg_t or LOG_BINARY_RAW_TYPE
+    uint16_t line;          ///< Line number
+    uint32_t time;          ///< Packed RTC time, @see log_binary_pack_time()
+    uint32_t uptime_ms;     ///< Uptime in milliseconds
+    const char *filename;   ///< Filename or NULL
+    const char *func_name;  ///< Function name or NULL
+} log_binary_header_t;
+
+/// @returns the packed time of a log record header
+static inline uint32_t log_binary_pack_time(unsigned month, unsigned day, unsigned hour, unsigned min, unsigned sec)
+{
+    return (month << 22) | (day << 17) | (hour << 12) | (min << 6) | sec;
+}
+
+/**
+ * @returns true if the pointer is to a string in flash memory whose address can be
+ * stored instead of its characters.
+ */
+bool log_binary_is_const_str(const void *ptr);
+
+/**
+ * Encodes a binary log record.
+ * @param [out] buffer  The buffer to store the record to
+ * @param [in]  size    The size of the buffer (at most 255)
+ * @param [in]  header  The header of the record
+ * @param [in]  fmt     The printf() format string
+ * @param [in]  args    The arguments of the format string
+ * @returns the length of the record
+ */
+uint32_t log_binary_vencode(void *buffer, uint32_t size, const log_binary_header_t *header,
+                            const char *fmt, va_list args);
+
+/**
+ * Function that returns the string at the given address of the firmware image.
+ * @returns NULL if the string is not known
+ */
+typedef const char* (*log_binary_str_lookup_t)(uint32_t addr, void *arg);
+
+/**
+ * Decodes a binary log record to the same text as the text log (including the newline)
+ * This is used by the host tools and tests, and is not linked if it is not used.
+ *
+ * @param [in]  record  The record created by log_binary_vencode()
+ * @param [out] text    The output text buffer
+ * @param [in]  size    The size of the text buffer
+ * @param [in]  lookup  The function to get the string of an address
+ * @param [in]  arg     The argument passed to the lookup function
+ * @returns the length of the text, or -1 if the record is invalid
+ */
+int log_binary_decode(const void *record, char *text, uint32_t size,
+                      log_binary_str_lookup_t lookup, void *arg);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/// Test lookup of host pointers (truncated to 32-bits) that may point inside of the strings
+static const char *g_test_log_binary_strs[8];
+static const char* test_log_binary_lookup(uint32_t addr, void *arg)
+{
+    unsigned i;
+    (void) arg;
+    for (i = 0; i < sizeof(g_test_log_binary_strs) / sizeof(g_test_log_binary_strs[0]); i++) {
+        const char *s = g_test_log_binary_strs[i];
+        const uint32_t start = (uint32_t)(uintptr_t) s;
+        if (s && addr >= start && addr <= start + strlen(s)) {
+            return s + (addr - start);
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t test_log_binary_encode(void *buffer, uint32_t size, const log_binary_header_t *header,
+                                              const char *fmt, ...)
+{
+    uint32_t len;
+    va_list args;
+    va_start(args, fmt);
+    len = log_binary_vencode(buffer, size, header, fmt, args);
+    va_end(args);
+    return len;
+}
+
+static inline void test_log_binary(void)
+{
+    static const char fmt1[] = "Error %i on %s: %5.2f%% [0x%08X] %c %lld %-4u|%*d|%.*s|";
+    static const char fmt2[] = "%s %s";
+    static const char file[] = "src/file_logger.c";
+    static const char func[] = "logger_task";
+    static const char abc[] = "abcdef";
+    char ram_str[] = "sd card";
+    char ram_fmt[] = "ram %d";
+    uint8_t rec[255];
+    char text[256];
+    char expected[256];
+    log_binary_header_t hdr = { 2, 123, log_binary_pack_time(7, 14, 9, 5, 3), 98765, file + 4, func };
+
+    g_test_log_binary_strs[0] = fmt1;
+    g_test_log_binary_strs[1] = fmt2;
+    g_test_log_binary_strs[2] = file;
+    g_test_log_binary_strs[3] = func;
+    g_test_log_binary_strs[4] = abc;
+
+    /* Same text as the text logger's header and message */
+    uint32_t len = test_log_binary_encode(rec, sizeof(rec), &hdr, fmt1, -5, ram_str, 3.14159, 0xBEEFu, 'z',
+                                          -1234567890123LL, 42u, 6, -7, 3, abc);
+    assert(len == rec[0]);
+    assert(LOG_BINARY_HEADER_SIZE + 4 + 4 + 8 + 8 + 4 + 4 + 8 + 4 + 4 + 4 + 4 + 5 == len);
+    assert(log_binary_decode(rec, text, sizeof(text), test_log_binary_lookup, NULL) > 0);
+    snprintf(expected, sizeof(expected), "7/14,09:05:03,98765,warn,file_logger.c,logger_task(),123,");
+    snprintf(expected + strlen(expected), sizeof(expected) - strlen(expected), fmt1, -5, ram_str, 3.14159, 0xBEEFu,
+             'z', -1234567890123LL, 42u, 6, -7, 3, abc);
+    strcat(expected, "\n");
+    assert(0 == strcmp(expected, text));
+
+    /* Strings in flash are stored by address only */
+    if (log_binary_is_const_str(fmt2)) {
+        hdr.type = LOG_BINARY_RAW_TYPE;
+        len = test_log_binary_encode(rec, sizeof(rec), &hdr, fmt2, file, ram_str);
+        assert(LOG_BINARY_HEADER_SIZE + 4 + 5 + 8 == len);
+        assert(log_binary_decode(rec, text, sizeof(text), test_log_binary_lookup, NULL) > 0);
+        assert(0 == strcmp("src/file_logger.c sd card\n", text));
+
+        /* Arguments that do not fit are left out, and strings are truncated */
+        len = test_log_binary_encode(rec, LOG_BINARY_HEADER_SIZE + 4 + 6, &hdr, fmt2, ram_str, ram_str);
+        assert(LOG_BINARY_HEADER_SIZE + 4 + 6 == len);
+        assert(log_binary_decode(rec, text, sizeof(text), test_log_binary_lookup, NULL) > 0);
+        assert(0 == strcmp("sd ca \n", text));
+    }
+
+    /* Format string in RAM is stored inline */
+    hdr.type = 0;
+    hdr.filename = NULL;
+    hdr.func_name = NULL;
+    len = test_log_binary_encode(rec, sizeof(rec), &hdr, ram_fmt, 99);
+    assert(rec[1] & LOG_BINARY_INLINE_FMT);
+    assert(log_binary_decode(rec, text, sizeof(text), test_log_binary_lookup, NULL) > 0);
+    assert(0 == strcmp("7/14,09:05:03,98765,debug,,,123,ram 99\n", text));
+
+    puts("\nBinary Log Tests Successful!");
+}
+
+#ifndef __arm__
+#include <time.h>
+/// Host only benchmark of the text log formatting versus binary log encoding
+static inline void test_log_binary_benchmark(void)
+{
+    const int count = 200 * 1000;
+    const log_binary_header_t hdr = { 1, 250, 0, 123456, "file_logger.c", "logger_log" };
+    unsigned text_bytes = 0, bin_bytes = 0;
+    char text[150];
+    uint8_t rec[150];
+    int i;
+
+    clock_t start = clock();
+    for (i = 0; i < count; i++) {
+        int len = sprintf(text, "%d/%d,%02d:%02d:%02d,%u,%s,%s,%s%s,%u,", 7, 14, 9, 5, 3, 123456u,
+                          "info", "file_logger.c", "logger_log", "()", 250u);
+        len += snprintf(text + len, sizeof(text) - len - 1, "Sensor %i reading %u at %.2f volts", i, 1000u + i, 3.3);
+        text_bytes += len + 1;
+    }
+    const double text_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < count; i++) {
+        bin_bytes += test_log_binary_encode(rec, sizeof(rec), &hdr, "Sensor %i reading %u at %.2f volts", i, 1000u + i, 3.3);
+    }
+    const double bin_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("\nText log   : %6.1f ns/call, %u bytes/call", text_sec * 1e9 / count, text_bytes / count);
+    printf("\nBinary log : %6.1f ns/call, %u bytes/call\n", bin_sec * 1e9 / count, bin_bytes / count);
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LOG_BINARY_H__ */
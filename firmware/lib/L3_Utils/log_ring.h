@@ -0,0 +1,436 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Lock-free ring buffer of variable length log records, used by the file logger
+ * @ingroup Utilities
+ *
+ * Each ring has exactly one producer (the task that logs) and one consumer (the logger task),
+ * so neither side ever needs a lock or a critical section :
+ *  - The producer reserves space, writes the message in place, and commits the record,
+ *    which publishes it by storing the head index.
+ *  - The consumer peeks the oldest record, copies it, and pops it, which frees the space
+ *    by storing the tail index.
+ *
+ * Each record has a small header with its length and a sequence number which the consumer
+ * uses to merge the records of several rings in the order they were logged.  If the record
+ * does not fit at the end of the buffer, a pad record fills the end and the record is stored
+ * at the start of the buffer, so a record is always contiguous in memory.
+ *
+ * 20261015 : Initial
+ */
+#ifndef LOG_RING_H__
+#define LOG_RING_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+#define LOG_RING_HEADER_SIZE    8   ///< Size of the header before each record
+#define LOG_RING_ALIGN          8   ///< Records start at multiples of this
+
+/// Ring buffer of log records with one producer and one consumer
+typedef struct {
+    uint8_t *buffer;    ///< The memory of the records
+    uint32_t size;      ///< The size of the buffer; must be a power of 2
+    uint32_t head;      ///< Free running write index, only written by the producer
+    uint32_t tail;      ///< Free running read index, only written by the consumer
+} log_ring_t;
+
+/**
+ * Initializes the ring buffer
+ * @param [in] buffer  The memory of the records, aligned to LOG_RING_ALIGN
+ * @param [in] size    The size of the buffer; must be a power of 2
+ */
+void log_ring_init(log_ring_t *ring, void *buffer, uint32_t size);
+
+/**
+ * Reserves space for a record; called by the producer.
+ * @param [in] max_len  The maximum length of the record
+ * @returns the pointer to write the record to, or NULL if the ring is full
+ * @note To always fit a record when the ring is empty, max_len + LOG_RING_HEADER_SIZE
+ *       should be at most half of the size of the ring.
+ */
+void* log_ring_reserve(log_ring_t *ring, uint32_t max_len);
+
+/**
+ * Publishes the record written to the space returned by log_ring_reserve()
+ * @param [in] len  The actual length of the record (at most the max_len that was reserved)
+ * @param [in] seq  The sequence number of the record, @see log_ring_peek()
+ */
+void log_ring_commit(log_ring_t *ring, uint32_t len, uint32_t seq);
+
+/**
+ * Gets the oldest record; called by the consumer.
+ * @param [out] len  The length of the record
+ * @param [out] seq  The sequence number of the record given to log_ring_commit()
+ * @returns the pointer to the record, or NULL if the ring is empty
+ */
+const void* log_ring_peek(log_ring_t *ring, uint32_t *len, uint32_t *seq);
+
+/**
+ * Frees the record returned by log_ring_peek()
+ */
+void log_ring_pop(log_ring_t *ring);
+
+/// @returns the number of bytes used by the records in the ring
+uint32_t log_ring_get_used(const log_ring_t *ring);
+
+/// @returns true if sequence number a is before b, even after the numbers wrap around
+static inline bool log_ring_seq_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static inline void test_log_ring(void)
+{
+    static uint64_t mem[64 / 8];
+    log_ring_t ring;
+    uint32_t len = 0, seq = 0;
+    char *p;
+    const char *r;
+
+    log_ring_init(&ring, mem, sizeof(mem));
+    assert(NULL == log_ring_peek(&ring, &len, &seq));
+
+    /* Records come out in the order they were committed */
+    p = (char*) log_ring_reserve(&ring, 20);
+    assert(p);
+    strcpy(p, "hello");
+    log_ring_commit(&ring, 5, 1);
+    p = (char*) log_ring_reserve(&ring, 20);
+    strcpy(p, "world!");
+    log_ring_commit(&ring, 6, 2);
+    assert(16 + 16 == log_ring_get_used(&ring));
+
+    r = (const char*) log_ring_peek(&ring, &len, &seq);
+    assert(r && 5 == len && 1 == seq && 0 == memcmp(r, "hello", 5));
+    log_ring_pop(&ring);
+    r = (const char*) log_ring_peek(&ring, &len, &seq);
+    assert(r && 6 == len && 2 == seq && 0 == memcmp(r, "world!", 6));
+
+    /* A reservation that does not fit before the end must not overlap the unread records at the start */
+    assert(NULL == log_ring_reserve(&ring, 40));
+    p = (char*) log_ring_reserve(&ring, 16);
+    assert(p);
+    log_ring_commit(&ring, 16, 3);
+    assert(NULL == log_ring_reserve(&ring, 9));
+    log_ring_pop(&ring);
+
+    /* 8 bytes left at the end, so the record wraps to the start after a pad record */
+    p = (char*) log_ring_reserve(&ring, 12);
+    assert((void*)(p - LOG_RING_HEADER_SIZE) == (void*)mem);
+    strcpy(p, "wrapped");
+    log_ring_commit(&ring, 7, 4);
+    r = (const char*) log_ring_peek(&ring, &len, &seq);
+    assert(r && 16 == len && 3 == seq);
+    log_ring_pop(&ring);
+    r = (const char*) log_ring_peek(&ring, &len, &seq);
+    assert(r && 7 == len && 4 == seq && 0 == memcmp(r, "wrapped", 7));
+    log_ring_pop(&ring);
+    assert(NULL == log_ring_peek(&ring, &len, &seq));
+    assert(0 == log_ring_get_used(&ring));
+
+    assert(log_ring_seq_before(0xFFFFFFFF, 0));
+    assert(!log_ring_seq_before(5, 5));
+
+    puts("\nLog Ring Tests Successful!");
+}
+
+#ifndef __arm__
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @{ Host only simulation of the file logger that compares the previous logging path, which
+ * gets a buffer from a queue and sends it to another queue, against the log rings.
+ * The consumer models the logger task, and stalls after each 1K of data to model the
+ * file write.  The queues are modeled by a mutex and condition variables.
+ */
+#define TEST_LOG_SIM_TASKS      4
+#define TEST_LOG_SIM_CALLS      3000
+#define TEST_LOG_SIM_MSG_LEN    150
+#define TEST_LOG_SIM_RING_SIZE  512
+#define TEST_LOG_SIM_NUM_BUFS   10
+#define TEST_LOG_SIM_FILE_BUF   1024
+#define TEST_LOG_SIM_WRITE_US   500
+
+typedef struct {
+    int mode;                   ///< 0: queues, 1: rings that block, 2: rings that drop
+    int interval_us;            ///< Time between the logging calls of each producer
+    int done;                   ///< Number of producers that are done
+    uint32_t seq;               ///< Sequence number of the ring records
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    char *empty_q[TEST_LOG_SIM_NUM_BUFS];
+    char *write_q[TEST_LOG_SIM_NUM_BUFS];
+    int empty_count, write_head, write_count;
+    log_ring_t rings[TEST_LOG_SIM_TASKS];
+    uint64_t ring_mem[TEST_LOG_SIM_TASKS][TEST_LOG_SIM_RING_SIZE / 8];
+    char file_buffer[TEST_LOG_SIM_FILE_BUF];
+    uint32_t file_used;
+    unsigned written, out_of_order;
+} test_log_sim_t;
+
+typedef struct {
+    test_log_sim_t *sim;
+    int id;
+    unsigned blocked, dropped;
+    double max_latency_us;
+} test_log_sim_task_t;
+
+static inline double test_log_sim_now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static inline void* test_log_sim_producer(void *arg)
+{
+    test_log_sim_task_t *task = (test_log_sim_task_t*) arg;
+    test_log_sim_t *sim = task->sim;
+    log_ring_t *ring = &sim->rings[task->id];
+    int i;
+
+    for (i = 0; i < TEST_LOG_SIM_CALLS; i++)
+    {
+        const double start = test_log_sim_now_us();
+        uint32_t seq = 0;
+        char *buffer = NULL;
+        bool blocked = false;
+
+        if (0 == sim->mode) {
+            pthread_mutex_lock(&sim->lock);
+            while (0 == sim->empty_count) {
+                blocked = true;
+                pthread_cond_wait(&sim->not_full, &sim->lock);
+            }
+            buffer = sim->empty_q[--sim->empty_count];
+            pthread_mutex_unlock(&sim->lock);
+        }
+        else {
+            while (NULL == (buffer = (char*) log_ring_reserve(ring, TEST_LOG_SIM_MSG_LEN)) && 1 == sim->mode) {
+                blocked = true;
+                usleep(100);
+            }
+        }
+
+        if (buffer) {
+            /* Like the logger, the number is taken after the space is reserved */
+            seq = __atomic_fetch_add(&sim->seq, 1, __ATOMIC_RELAXED);
+            const int len = snprintf(buffer, TEST_LOG_SIM_MSG_LEN, "7/14,09:05:03,%u,info,sim.c,producer(),%d,Task %d message %d",
+                                     (unsigned) start, __LINE__, task->id, i);
+            if (0 == sim->mode) {
+                pthread_mutex_lock(&sim->lock);
+                sim->write_q[(sim->write_head + sim->write_count++) % TEST_LOG_SIM_NUM_BUFS] = buffer;
+                pthread_cond_signal(&sim->not_empty);
+                pthread_mutex_unlock(&sim->lock);
+            }
+            else {
+                log_ring_commit(ring, len, seq);
+            }
+        }
+        else {
+            ++task->dropped;
+        }
+
+        const double latency = test_log_sim_now_us() - start;
+        task->blocked += blocked;
+        task->max_latency_us = (latency > task->max_latency_us) ? latency : task->max_latency_us;
+
+        if (sim->interval_us) {
+            usleep(sim->interval_us);
+        }
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    __atomic_fetch_add(&sim->done, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&sim->not_empty);
+    pthread_mutex_unlock(&sim->lock);
+    return NULL;
+}
+
+/// Copies the message to the file buffer, and "writes" the buffer when it is full
+static inline void test_log_sim_consume(test_log_sim_t *sim, const void *msg, uint32_t len)
+{
+    const uint32_t space = TEST_LOG_SIM_FILE_BUF - sim->file_used;
+    if (len >= space) {
+        memcpy(sim->file_buffer + sim->file_used, msg, space);
+        usleep(TEST_LOG_SIM_WRITE_US);
+        memcpy(sim->file_buffer, (const char*) msg + space, len - space);
+        sim->file_used = len - space;
+    }
+    else {
+        memcpy(sim->file_buffer + sim->file_used, msg, len);
+        sim->file_used += len;
+    }
+    ++sim->written;
+}
+
+static inline void test_log_sim_consumer(test_log_sim_t *sim)
+{
+    uint32_t last_seq = 0, next_seq = 0;
+
+    while (0 == sim->mode)
+    {
+        pthread_mutex_lock(&sim->lock);
+        while (0 == sim->write_count && sim->done < TEST_LOG_SIM_TASKS) {
+            pthread_cond_wait(&sim->not_empty, &sim->lock);
+        }
+        if (0 == sim->write_count) {
+            pthread_mutex_unlock(&sim->lock);
+            break;
+        }
+        char *buffer = sim->write_q[sim->write_head];
+        sim->write_head = (sim->write_head + 1) % TEST_LOG_SIM_NUM_BUFS;
+        --sim->write_count;
+        pthread_mutex_unlock(&sim->lock);
+
+        test_log_sim_consume(sim, buffer, strlen(buffer));
+
+        pthread_mutex_lock(&sim->lock);
+        sim->empty_q[sim->empty_count++] = buffer;
+        pthread_cond_signal(&sim->not_full);
+        pthread_mutex_unlock(&sim->lock);
+    }
+
+    while (0 != sim->mode)
+    {
+        const bool done = (TEST_LOG_SIM_TASKS == __atomic_load_n(&sim->done, __ATOMIC_ACQUIRE));
+        log_ring_t *oldest = NULL;
+        const void *msg = NULL;
+        uint32_t oldest_len = 0, oldest_seq = 0;
+        int i;
+
+        /* Merge the rings by taking the record with the lowest sequence number */
+        for (i = 0; i < TEST_LOG_SIM_TASKS; i++) {
+            uint32_t len, seq;
+            const void *p = log_ring_peek(&sim->rings[i], &len, &seq);
+            if (p && (NULL == oldest || log_ring_seq_before(seq, oldest_seq))) {
+                oldest = &sim->rings[i];
+                msg = p;
+                oldest_len = len;
+                oldest_seq = seq;
+            }
+        }
+
+        /* Wait for the message of a producer that took an earlier number and did not commit yet */
+        if (NULL == oldest || log_ring_seq_before(next_seq, oldest_seq)) {
+            if (NULL == oldest && done) {
+                break;
+            }
+            usleep(20);
+            continue;
+        }
+        next_seq = oldest_seq + 1;
+
+        sim->out_of_order += (sim->written > 0 && log_ring_seq_before(oldest_seq, last_seq));
+        last_seq = oldest_seq;
+        test_log_sim_consume(sim, msg, oldest_len);
+        log_ring_pop(oldest);
+    }
+}
+
+static inline void test_log_sim_run(int mode, int interval_us)
+{
+    static const char * const names[] = { "Queues      ", "Rings, block", "Rings, drop " };
+    static char bufs[TEST_LOG_SIM_NUM_BUFS][TEST_LOG_SIM_MSG_LEN];
+    static test_log_sim_t sim;
+    test_log_sim_task_t tasks[TEST_LOG_SIM_TASKS];
+    pthread_t threads[TEST_LOG_SIM_TASKS];
+    unsigned blocked = 0, dropped = 0;
+    double max_latency_us = 0;
+    int i;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.mode = mode;
+    sim.interval_us = interval_us;
+    pthread_mutex_init(&sim.lock, NULL);
+    pthread_cond_init(&sim.not_empty, NULL);
+    pthread_cond_init(&sim.not_full, NULL);
+    for (i = 0; i < TEST_LOG_SIM_NUM_BUFS; i++) {
+        sim.empty_q[sim.empty_count++] = bufs[i];
+    }
+
+    const double start = test_log_sim_now_us();
+    for (i = 0; i < TEST_LOG_SIM_TASKS; i++) {
+        log_ring_init(&sim.rings[i], sim.ring_mem[i], TEST_LOG_SIM_RING_SIZE);
+        tasks[i].sim = &sim;
+        tasks[i].id = i;
+        tasks[i].blocked = tasks[i].dropped = 0;
+        tasks[i].max_latency_us = 0;
+        pthread_create(&threads[i], NULL, test_log_sim_producer, &tasks[i]);
+    }
+    test_log_sim_consumer(&sim);
+    for (i = 0; i < TEST_LOG_SIM_TASKS; i++) {
+        pthread_join(threads[i], NULL);
+        blocked += tasks[i].blocked;
+        dropped += tasks[i].dropped;
+        max_latency_us = (tasks[i].max_latency_us > max_latency_us) ? tasks[i].max_latency_us : max_latency_us;
+    }
+    const double sec = (test_log_sim_now_us() - start) / 1e6;
+
+    assert(sim.written + dropped == TEST_LOG_SIM_TASKS * TEST_LOG_SIM_CALLS);
+    assert(0 == sim.out_of_order);
+    printf("\n%s: %5u blocked, %5u dropped, %8.1f us max call, %7.0f msgs/sec, %u out of order",
+           names[mode], blocked, dropped, max_latency_us, sim.written / sec, sim.out_of_order);
+
+    pthread_mutex_destroy(&sim.lock);
+    pthread_cond_destroy(&sim.not_empty);
+    pthread_cond_destroy(&sim.not_full);
+}
+
+/// Runs the simulation with paced logging calls, and with back to back logging calls
+static inline void test_log_ring_simulation(void)
+{
+    int mode;
+    printf("\n%u tasks logging every 200us, %uus file write per %u bytes", TEST_LOG_SIM_TASKS,
+           TEST_LOG_SIM_WRITE_US, TEST_LOG_SIM_FILE_BUF);
+    for (mode = 0; mode < 3; mode++) {
+        test_log_sim_run(mode, 200);
+    }
+    printf("\n%u tasks logging back to back", TEST_LOG_SIM_TASKS);
+    for (mode = 0; mode < 3; mode++) {
+        test_log_sim_run(mode, 0);
+    }
+    puts("");
+}
+/** @} */
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LOG_RING_H__ */
@@ -0,0 +1,344 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Fixed size pool of objects that is safe to use from tasks and interrupts
+ * @ingroup Utilities
+ *
+ * Version: 20261015    Initial
+ */
+#ifndef OBJECT_POOL_HPP__
+#define OBJECT_POOL_HPP__
+
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+
+
+
+/**
+ * The part of the object pool that does not depend on the type of the objects.
+ * All pools are linked together when they are constructed such that their counters
+ * can be printed by the "meminfo" terminal command.
+ */
+class ObjectPoolBase
+{
+public:
+    const char* getName(void)         const { return mpName;          }  ///< @returns the name of the pool
+    uint32_t getCapacity(void)        const { return mCapacity;       }  ///< @returns the number of objects of the pool
+    uint32_t getUsed(void)            const { return mUsed;           }  ///< @returns the number of objects in use
+    uint32_t getHighWater(void)       const { return mHighWater;      }  ///< @returns the most objects ever in use
+    uint32_t getExhaustedCount(void)  const { return mExhaustedCount; }  ///< @returns the number of times alloc() failed
+    uint32_t getAvailable(void)       const { return mCapacity - mUsed; } ///< @returns the number of free objects
+
+    static ObjectPoolBase* getFirst(void) { return mpFirst; }  ///< @returns the first pool, or NULL
+    ObjectPoolBase* getNext(void) const   { return mpNext;  }  ///< @returns the next pool, or NULL
+
+    /**
+     * Prints the counters of all pools
+     * @param pBuffer  The buffer to print to
+     * @param size     The size of the buffer
+     * @returns the length of the string printed to pBuffer
+     */
+    static int printAll(char *pBuffer, int size);
+
+protected:
+    ObjectPoolBase(const char *pName, uint16_t capacity, uint8_t *pStorage, uint16_t *pNext, uint32_t objSize);
+    ~ObjectPoolBase();
+
+    void* allocRaw(void);               ///< @returns a free object, or NULL if none is available
+    bool freeRaw(void *pObj);           ///< @returns false if the object is not of this pool
+    bool owns(const void *pObj) const;  ///< @returns true if the object is of this pool
+
+private:
+    ObjectPoolBase(const ObjectPoolBase&);            ///< Pools cannot be copied
+    ObjectPoolBase& operator=(const ObjectPoolBase&); ///< Pools cannot be copied
+
+    static const uint16_t mNil = 0xFFFF;    ///< Index of the end of the free list
+
+    /**
+     * The head of the free list is the index of the first free object in the low 16-bits,
+     * and a tag in the high 16-bits that changes each time the head changes.  The tag
+     * prevents the ABA problem where the head is popped and pushed back by an interrupt
+     * in between the load and the compare-and-swap of the head.
+     */
+    volatile uint32_t mHead;
+    uint16_t * const mpNextFree;        ///< Index of the next free object of each free object
+    uint8_t * const mpStorage;          ///< Memory of the objects
+    const uint32_t mObjSize;            ///< Size of each object including its padding
+    const uint16_t mCapacity;           ///< Number of objects
+    const char * const mpName;          ///< Name of the pool
+
+    volatile uint32_t mUsed;            ///< Number of objects in use
+    volatile uint32_t mHighWater;       ///< Most objects in use
+    volatile uint32_t mExhaustedCount;  ///< Number of times there was no free object
+
+    ObjectPoolBase *mpNext;             ///< Next pool of the list of all pools
+    static ObjectPoolBase *mpFirst;     ///< The first pool of the list of all pools
+};
+
+/**
+ * Fixed size pool of objects
+ * @ingroup Utilities
+ *
+ * Objects are taken from and returned to a lock-free free list (LDREX/STREX on the
+ * Cortex-M3), so alloc() and free() are O(1), never block, and can be used from
+ * interrupts.  Rather than copying large structures through FreeRTOS queues, the
+ * queue can carry a pointer to an object of a pool.
+ *
+ * @code
+ *  static ObjectPool<can_msg_t, 16> canPool("can");
+ *  QueueHandle_t q = xQueueCreate(16, sizeof(can_msg_t*));
+ *
+ *  // Producer (may be an ISR)
+ *  can_msg_t *pMsg = canPool.alloc();
+ *  if (pMsg) {
+ *      pMsg->msg_id = 0x100;
+ *      xQueueSendFromISR(q, &pMsg, NULL);
+ *  }
+ *
+ *  // Consumer
+ *  can_msg_t *pMsg = 0;
+ *  if (xQueueReceive(q, &pMsg, portMAX_DELAY)) {
+ *      process(pMsg);
+ *      canPool.free(pMsg);
+ *  }
+ * @endcode
+ *
+ * @param TYPE      The type of the objects
+ * @param CAPACITY  The number of objects (less than 65535)
+ */
+template <typename TYPE, uint16_t CAPACITY>
+class ObjectPool : public ObjectPoolBase
+{
+public:
+    static_assert(CAPACITY > 0 && CAPACITY < 0xFFFF, "CAPACITY must be 1 to 65534");
+
+    /// @param pName  The name of the pool printed by the "meminfo" command
+    ObjectPool(const char *pName = "") :
+        ObjectPoolBase(pName, CAPACITY, reinterpret_cast<uint8_t*>(mStorage), mNextFree, sizeof(mStorage[0]))
+    {
+    }
+
+    /**
+     * Gets a default constructed object from the pool; like "new TYPE", the members of
+     * a plain struct are not zeroed, so nothing is written to the object that the user
+     * does not write.
+     * @returns NULL if all objects are in use
+     */
+    TYPE* alloc(void)
+    {
+        void *p = allocRaw();
+        return p ? new (p) TYPE : 0;
+    }
+
+    /**
+     * Destroys the object and returns it to the pool
+     * @returns false if the object is not of this pool (or is NULL)
+     */
+    bool free(TYPE *pObj)
+    {
+        if (!owns(pObj)) {
+            return false;
+        }
+        pObj->~TYPE();
+        return freeRaw(pObj);
+    }
+
+    /// @returns true if the object is of this pool
+    bool isFromPool(const TYPE *pObj) const { return owns(pObj); }
+
+private:
+    typedef typename std::aligned_storage<sizeof(TYPE), __alignof__(TYPE)>::type storage_t;
+
+    storage_t mStorage[CAPACITY];   ///< Memory of the objects
+    uint16_t mNextFree[CAPACITY];   ///< Free list links
+};
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/// Similar size to mesh_packet_t and web_req_type that are copied through queues
+typedef struct {
+    uint8_t header[8];
+    uint8_t data[32];
+} test_pool_packet_t;
+
+/// Counts constructors and destructors
+struct test_pool_obj {
+    static int& alive(void) { static int count = 0; return count; }
+    int value;
+    test_pool_obj() : value(42) { alive()++; }
+    ~test_pool_obj() { alive()--; }
+};
+
+static inline void test_ObjectPool(void)
+{
+    static ObjectPool<test_pool_packet_t, 4> pool("test");
+    test_pool_packet_t *p[5] = { 0 };
+    test_pool_packet_t other;
+
+    assert(4 == pool.getCapacity() && 4 == pool.getAvailable());
+    for (int i = 0; i < 4; i++) {
+        p[i] = pool.alloc();
+        assert(p[i] && pool.isFromPool(p[i]));
+        assert(0 == ((uintptr_t)p[i] % __alignof__(test_pool_packet_t)));
+        memset(p[i], i, sizeof(*p[i]));
+    }
+    assert(p[0] != p[1] && p[1] != p[2] && p[2] != p[3]);
+    assert(0 == pool.alloc());
+    assert(0 == pool.alloc());
+    assert(2 == pool.getExhaustedCount());
+    assert(4 == pool.getUsed() && 4 == pool.getHighWater());
+
+    /* Objects that are not of the pool are not freed */
+    assert(!pool.free(&other));
+    assert(!pool.free(0));
+    assert(!pool.free((test_pool_packet_t*)((char*)p[1] + 1)));
+
+    assert(pool.free(p[2]));
+    assert(pool.free(p[0]));
+    assert(2 == pool.getUsed() && 4 == pool.getHighWater());
+    p[4] = pool.alloc();
+    assert(p[4] == p[0]);
+    assert(3 == pool.getUsed());
+
+    /* Objects are constructed and destroyed */
+    static ObjectPool<test_pool_obj, 2> objPool("objects");
+    test_pool_obj *pObj = objPool.alloc();
+    assert(pObj && 42 == pObj->value && 1 == test_pool_obj::alive());
+    assert(objPool.free(pObj));
+    assert(0 == test_pool_obj::alive());
+
+    /* Both pools are listed */
+    char buffer[256];
+    assert(ObjectPoolBase::printAll(buffer, sizeof(buffer)) > 0);
+    assert(strstr(buffer, "test") && strstr(buffer, "objects"));
+
+    puts("\nObject Pool Tests Successful!");
+}
+
+#ifndef __arm__
+#include <thread>
+#include <chrono>
+#include "circular_buffer.hpp"
+
+/// Similar size to a large request that is copied through a queue
+typedef struct {
+    uint8_t header[8];
+    uint8_t data[248];
+} test_pool_large_packet_t;
+
+/// Benchmark of passing pointers to pool objects through a queue versus copying the objects
+template <typename PACKET>
+static inline void test_ObjectPool_queue_benchmark(void)
+{
+    typedef std::chrono::steady_clock clock;
+    const uint32_t count = 10 * 1000 * 1000;
+    static ObjectPool<PACKET, 16> pool("bench");
+    static SpscCircularBuffer<PACKET, 16> byValue;
+    static SpscCircularBuffer<PACKET*, 16> byPointer;
+    PACKET pkt;
+    PACKET *pPkt = 0;
+    uint32_t sum = 0;
+    memset(&pkt, 0, sizeof(pkt));
+
+    clock::time_point start = clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        pkt.data[0] = i;
+        byValue.push_back(pkt);
+        byValue.pop_front(&pkt);
+        sum += pkt.data[0];
+    }
+    const double valueSec = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        PACKET *p = pool.alloc();
+        p->data[0] = i;
+        byPointer.push_back(p);
+        byPointer.pop_front(&pPkt);
+        sum += pPkt->data[0];
+        pool.free(pPkt);
+    }
+    const double pointerSec = std::chrono::duration<double>(clock::now() - start).count();
+
+    printf("\nQueue of %3u byte packets by value : %5.1f ns/packet, %3u bytes of queue per packet",
+           (unsigned)sizeof(pkt), valueSec * 1e9 / count, (unsigned)sizeof(pkt));
+    printf("\nQueue of pointers to pool packets  : %5.1f ns/packet, %3u bytes of queue per packet [%u]",
+           pointerSec * 1e9 / count, (unsigned)sizeof(pPkt), (unsigned)sum);
+}
+
+/**
+ * Host only stress test of the lock-free free list with multiple threads, and a benchmark
+ * of passing pointers to pool objects through a queue versus copying the objects.
+ */
+static inline void test_ObjectPool_stress(void)
+{
+    static ObjectPool<test_pool_packet_t, 64> pool("stress");
+    const int threads = 4;
+    const int loops = 500 * 1000;
+    bool ok[threads];
+
+    /* Each thread holds a few objects, and marks them with its number to detect sharing */
+    std::thread t[threads];
+    for (int n = 0; n < threads; n++) {
+        ok[n] = true;
+        t[n] = std::thread([&, n]() {
+            test_pool_packet_t *held[8] = { 0 };
+            for (int i = 0; i < loops; i++) {
+                const int slot = i % 8;
+                if (held[slot]) {
+                    for (unsigned b = 0; b < sizeof(held[slot]->data); b++) {
+                        ok[n] = ok[n] && (held[slot]->data[b] == n);
+                    }
+                    ok[n] = ok[n] && pool.free(held[slot]);
+                    held[slot] = 0;
+                }
+                else if (0 != (held[slot] = pool.alloc())) {
+                    memset(held[slot]->data, n, sizeof(held[slot]->data));
+                }
+            }
+            for (int i = 0; i < 8; i++) {
+                pool.free(held[i]);
+            }
+        });
+    }
+    for (int n = 0; n < threads; n++) {
+        t[n].join();
+        assert(ok[n]);
+    }
+    assert(0 == pool.getUsed());
+    assert(pool.getHighWater() <= 32);
+
+    /* Producer to consumer through a queue: by value versus pointers to pool objects */
+    test_ObjectPool_queue_benchmark<test_pool_packet_t>();
+    test_ObjectPool_queue_benchmark<test_pool_large_packet_t>();
+    puts("\nObject Pool Stress Test Successful!");
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#endif /* #ifndef OBJECT_POOL_HPP__ */
@@ -0,0 +1,313 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Heap made of several RAM regions, with placement hints for what goes where
+ * @ingroup Utilities
+ *
+ * The LPC17xx has two SRAM banks that are not contiguous, and they are not equal :
+ *  - SRAM (0x10000000) is on the CPU's local bus, but the GPDMA cannot access it
+ *  - SRAM_AHB (0x2007C000) holds the global variables, and the GPDMA can access it
+ *
+ * Each region is described by a region_heap_region_t and has its own TLSF allocator
+ * (tlsf.h), such that an allocation never spans the gap between the banks, and the free
+ * and used memory of each region is known exactly.  An allocation gives a hint of what
+ * the memory is for, and the regions are tried in the order they were added :
+ *  - REGION_HEAP_GENERAL : Regions with REGION_HEAP_CAP_GENERAL
+ *  - REGION_HEAP_STACK   : Regions with REGION_HEAP_CAP_STACK, then the general regions
+ *  - REGION_HEAP_DMA     : Only the regions with REGION_HEAP_CAP_DMA
+ *
+ * Listing the DMA region after the others keeps general memory out of it until the other
+ * regions are full.  The heap is not thread safe; heap_tlsf.c.inc locks around each call.
+ *
+ * 20261016 : Initial
+ */
+#ifndef REGION_HEAP_H__
+#define REGION_HEAP_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "tlsf.h"
+
+
+
+#define REGION_HEAP_MAX_REGIONS     4           ///< Max number of regions
+
+#define REGION_HEAP_CAP_GENERAL     (1 << 0)    ///< General allocations may use the region
+#define REGION_HEAP_CAP_STACK       (1 << 1)    ///< Preferred for stacks and RTOS objects (fastest for the CPU)
+#define REGION_HEAP_CAP_DMA         (1 << 2)    ///< The DMA can access the region
+
+/// What the memory is for, @see region_heap_malloc()
+typedef enum {
+    REGION_HEAP_GENERAL = 0,    ///< Any general region
+    REGION_HEAP_STACK,          ///< The stack regions, then any general region
+    REGION_HEAP_DMA,            ///< Only the DMA regions
+    REGION_HEAP_HINT_COUNT,
+} region_heap_hint_t;
+
+/// Description of a region
+typedef struct {
+    const char *name;   ///< Name of the region
+    void *start;        ///< Start of the memory
+    size_t size;        ///< Size of the memory
+    uint32_t caps;      ///< REGION_HEAP_CAP_* bits
+} region_heap_region_t;
+
+/// The heap; use the functions rather than accessing its members
+typedef struct {
+    region_heap_region_t regions[REGION_HEAP_MAX_REGIONS];  ///< The regions in the order they are tried
+    tlsf_t tlsf[REGION_HEAP_MAX_REGIONS];                   ///< The allocator of each region
+    uint32_t region_count;                                  ///< Number of regions
+    size_t free_bytes;                                      ///< Free bytes of all regions
+    size_t min_free_bytes;                                  ///< The lowest free_bytes ever
+    uint32_t failed_allocs[REGION_HEAP_HINT_COUNT];         ///< Allocations that failed in all of their regions
+} region_heap_t;
+
+/// Initializes the heap without any region
+void region_heap_init(region_heap_t *heap);
+
+/**
+ * Adds a region to the heap; regions added first are tried first
+ * @returns false if there are too many regions or the memory is too small
+ */
+bool region_heap_add_region(region_heap_t *heap, const region_heap_region_t *region);
+
+/**
+ * Allocates memory from the first region that fits, in O(number of regions) time
+ * @returns NULL if no region of the hint has a free block large enough
+ */
+void* region_heap_malloc(region_heap_t *heap, size_t bytes, region_heap_hint_t hint);
+
+/// Frees the memory given by region_heap_malloc() or region_heap_realloc(); ptr may be NULL
+void region_heap_free(region_heap_t *heap, void *ptr);
+
+/**
+ * Changes the size of the memory within its region, such that DMA memory stays DMA memory
+ * @returns the new memory, or NULL if its region has no memory (and then ptr is not freed)
+ */
+void* region_heap_realloc(region_heap_t *heap, void *ptr, size_t bytes);
+
+/// @returns the index of the region of the memory, or -1 if it is not from the heap
+int region_heap_find_region(const region_heap_t *heap, const void *ptr);
+
+/**
+ * Gets the statistics of a region; its failed_allocs is zero because the failures are
+ * counted by the heap (a region that is full does not fail if another region fits).
+ * @returns false if the index is not of a region
+ */
+bool region_heap_get_region_stats(const region_heap_t *heap, uint32_t index, tlsf_stats_t *stats);
+
+/**
+ * Gets the statistics of all of the regions together; failed_allocs and min_free_bytes
+ * are of the heap, and fragmentation is based on the largest free block of any region.
+ */
+void region_heap_get_stats(const region_heap_t *heap, tlsf_stats_t *stats);
+
+/**
+ * @{ The heap shared by FreeRTOS, malloc() and new
+ * These only exist if the FreeRTOS heap scheme 6 is used (configMEM_MANG_TYPE).
+ * pvPortMalloc() uses REGION_HEAP_STACK, and malloc() uses REGION_HEAP_GENERAL.
+ * The memory is freed by free() or vPortFree().
+ */
+void* sys_heap_malloc(size_t bytes, region_heap_hint_t hint);
+bool sys_heap_get_region(uint32_t index, region_heap_region_t *region, tlsf_stats_t *stats);
+/** @} */
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline bool test_region_heap_in(const void *ptr, const void *start, size_t size)
+{
+    return (const uint8_t*)ptr >= (const uint8_t*)start && (const uint8_t*)ptr < (const uint8_t*)start + size;
+}
+
+static inline void test_region_heap(void)
+{
+    static uint64_t fast[4096 / 8];
+    static uint64_t dma[4096 / 8];
+    static region_heap_t heap;
+    const region_heap_region_t fast_region = { "fast", fast, sizeof(fast), REGION_HEAP_CAP_STACK | REGION_HEAP_CAP_GENERAL };
+    const region_heap_region_t dma_region = { "dma", dma, sizeof(dma), REGION_HEAP_CAP_DMA | REGION_HEAP_CAP_GENERAL };
+    tlsf_stats_t stats, fast_stats, dma_stats;
+    uint32_t i = 0;
+
+    region_heap_init(&heap);
+    assert(NULL == region_heap_malloc(&heap, 8, REGION_HEAP_GENERAL));
+    assert(region_heap_add_region(&heap, &fast_region));
+    assert(region_heap_add_region(&heap, &dma_region));
+    assert(!region_heap_get_region_stats(&heap, 2, &stats));
+
+    /* Placement by the hints */
+    void *general = region_heap_malloc(&heap, 100, REGION_HEAP_GENERAL);
+    void *stack = region_heap_malloc(&heap, 1000, REGION_HEAP_STACK);
+    void *buffer = region_heap_malloc(&heap, 500, REGION_HEAP_DMA);
+    assert(test_region_heap_in(general, fast, sizeof(fast)) && 0 == region_heap_find_region(&heap, general));
+    assert(test_region_heap_in(stack, fast, sizeof(fast)));
+    assert(test_region_heap_in(buffer, dma, sizeof(dma)) && 1 == region_heap_find_region(&heap, buffer));
+    assert(-1 == region_heap_find_region(&heap, &i));
+
+    /* Exact stats of each region */
+    assert(region_heap_get_region_stats(&heap, 0, &fast_stats));
+    assert(region_heap_get_region_stats(&heap, 1, &dma_stats));
+    assert(2 == fast_stats.used_blocks && 1 == dma_stats.used_blocks);
+    assert(fast_stats.used_bytes == tlsf_block_size(general) + tlsf_block_size(stack) + 2 * TLSF_BLOCK_OVERHEAD);
+    region_heap_get_stats(&heap, &stats);
+    assert(stats.free_bytes == fast_stats.free_bytes + dma_stats.free_bytes);
+    assert(stats.total_bytes == fast_stats.total_bytes + dma_stats.total_bytes);
+    assert(stats.free_bytes == heap.free_bytes && stats.min_free_bytes == stats.free_bytes);
+
+    /* General and stack memory go to the DMA region once the fast region is full, but DMA memory never goes to the fast region */
+    void *big = region_heap_malloc(&heap, 3000, REGION_HEAP_STACK);
+    assert(test_region_heap_in(big, dma, sizeof(dma)));
+    void *big_dma = region_heap_malloc(&heap, 1000, REGION_HEAP_DMA);
+    assert(NULL == big_dma && 1 == heap.failed_allocs[REGION_HEAP_DMA]);
+    region_heap_free(&heap, big);
+    big_dma = region_heap_malloc(&heap, 1000, REGION_HEAP_DMA);
+    assert(test_region_heap_in(big_dma, dma, sizeof(dma)));
+
+    /* Realloc stays in its region, even if another region has the memory */
+    memset(general, 0x5A, 100);
+    void *moved = region_heap_realloc(&heap, general, 3000);
+    assert(NULL == moved && 2 == heap.failed_allocs[REGION_HEAP_GENERAL]);
+    moved = region_heap_realloc(&heap, general, 2000);
+    assert(test_region_heap_in(moved, fast, sizeof(fast)) && ((uint8_t*)moved)[99] == 0x5A);
+    region_heap_free(&heap, buffer);
+    region_heap_free(&heap, big_dma);
+    assert(NULL == region_heap_realloc(&heap, moved, 3500) && 3 == heap.failed_allocs[REGION_HEAP_GENERAL]);
+
+    /* A DMA buffer is never moved to the fast region that the DMA cannot access */
+    buffer = region_heap_malloc(&heap, 500, REGION_HEAP_DMA);
+    memset(buffer, 0xA5, 500);
+    big_dma = region_heap_malloc(&heap, 3000, REGION_HEAP_DMA);
+    assert(test_region_heap_in(big_dma, dma, sizeof(dma)));
+    assert(NULL == region_heap_realloc(&heap, buffer, 800) && 2 == heap.failed_allocs[REGION_HEAP_DMA]);
+    region_heap_free(&heap, big_dma);
+    void *grown = region_heap_realloc(&heap, buffer, 3500);
+    assert(test_region_heap_in(grown, dma, sizeof(dma)) && ((uint8_t*)grown)[499] == 0xA5);
+
+    region_heap_free(&heap, grown);
+    region_heap_free(&heap, moved);
+    region_heap_free(&heap, stack);
+    region_heap_free(&heap, NULL);
+    region_heap_get_stats(&heap, &stats);
+    assert(2 == stats.free_blocks && 0 == stats.used_blocks && stats.free_bytes == stats.total_bytes);
+    assert(stats.min_free_bytes < stats.free_bytes);
+    assert(tlsf_check(&heap.tlsf[0]) && tlsf_check(&heap.tlsf[1]));
+
+    puts("\nRegion Heap Tests Successful!");
+}
+
+#ifndef __arm__
+/**
+ * Host only simulation of the two SRAM banks of the board, running tasks' stacks, DMA buffers,
+ * and general allocations of random sizes and lifetimes with and without the placement hints.
+ * Without the hints, everything is general memory, like the single heap of heap scheme 6.
+ */
+static inline void test_region_heap_simulation(void)
+{
+    enum { num_ptrs = 300, steps = 200 * 1000 };
+    static uint64_t sram[32 * 1024 / 8];
+    static uint64_t sram_ahb[24 * 1024 / 8];    /* The first 8K holds the global variables */
+    static region_heap_t heap;
+    static void *ptrs[num_ptrs];
+    static uint8_t hints[num_ptrs];
+    const char *names[] = { "general", "stack", "dma" };
+    int use_hints = 0;
+
+    for (use_hints = 0; use_hints < 2; use_hints++)
+    {
+        const region_heap_region_t sram_region = { "SRAM", sram, sizeof(sram), REGION_HEAP_CAP_STACK | REGION_HEAP_CAP_GENERAL };
+        const region_heap_region_t ahb_region = { "SRAM_AHB", sram_ahb, sizeof(sram_ahb), REGION_HEAP_CAP_DMA | REGION_HEAP_CAP_GENERAL };
+        uint32_t dma_in_wrong_region = 0;
+        uint32_t frag_sum[2] = { 0 };
+        uint32_t i = 0, r = 0;
+
+        region_heap_init(&heap);
+        region_heap_add_region(&heap, &sram_region);
+        region_heap_add_region(&heap, &ahb_region);
+        memset(ptrs, 0, sizeof(ptrs));
+        srand(1);
+
+        /* Task stacks and their RTOS objects stay for the whole uptime */
+        for (i = 0; i < 10; i++) {
+            ptrs[i] = region_heap_malloc(&heap, 512 + 256 * (rand() % 8), use_hints ? REGION_HEAP_STACK : REGION_HEAP_GENERAL);
+            hints[i] = REGION_HEAP_STACK;
+        }
+
+        for (i = 0; i < steps; i++) {
+            const uint32_t idx = 10 + rand() % (num_ptrs - 10);
+            if (ptrs[idx]) {
+                region_heap_free(&heap, ptrs[idx]);
+                ptrs[idx] = NULL;
+            }
+            else {
+                /* Mostly small strings and objects, and now and then a DMA buffer of a transfer */
+                const bool is_dma = (0 == rand() % 16);
+                const size_t size = is_dma ? (256 + 128 * (rand() % 16)) : (8 + rand() % ((rand() % 8) ? 64 : 600));
+                hints[idx] = is_dma ? REGION_HEAP_DMA : REGION_HEAP_GENERAL;
+                ptrs[idx] = region_heap_malloc(&heap, size, use_hints ? (region_heap_hint_t)hints[idx] : REGION_HEAP_GENERAL);
+                if (ptrs[idx] && is_dma && 1 != region_heap_find_region(&heap, ptrs[idx])) {
+                    dma_in_wrong_region++;
+                }
+            }
+
+            if (0 == i % 64) {
+                for (r = 0; r < 2; r++) {
+                    tlsf_stats_t stats;
+                    region_heap_get_region_stats(&heap, r, &stats);
+                    frag_sum[r] += stats.fragmentation;
+                }
+            }
+        }
+
+        printf("\n%s placement hints:", use_hints ? "With" : "Without");
+        for (r = 0; r < 2; r++) {
+            tlsf_stats_t stats;
+            region_heap_get_region_stats(&heap, r, &stats);
+            printf("\n  %-8s : %5u used, %5u free (min %5u), largest %5u, fragmentation %3u%% (average %3u%%)",
+                   heap.regions[r].name, (unsigned)stats.used_bytes, (unsigned)stats.free_bytes, (unsigned)stats.min_free_bytes,
+                   (unsigned)stats.largest_free_block, (unsigned)stats.fragmentation, (unsigned)(frag_sum[r] / (steps / 64 + 1)));
+        }
+        for (r = 0; r < REGION_HEAP_HINT_COUNT; r++) {
+            printf("\n  Failed %-7s : %u", names[r], (unsigned)heap.failed_allocs[r]);
+        }
+        printf("\n  DMA buffers in memory the DMA cannot access : %u", (unsigned)dma_in_wrong_region);
+        assert(!use_hints || 0 == dma_in_wrong_region);
+        assert(tlsf_check(&heap.tlsf[0]) && tlsf_check(&heap.tlsf[1]));
+    }
+    puts("");
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* REGION_HEAP_H__ */
@@ -20,6 +20,13 @@
  * @file
  * @brief This file provides API to enable real-time clock FreeRTOS signals or alarms
  * @ingroup Utilities
+ *
+ * The alarms are kept in a min-heap by the time they fire next (@see alarm_heap.h), and the
+ * RTC alarm registers are set to the next alarm, so the RTC interrupt only occurs when an alarm
+ * fires rather than every second.  Up to ALARM_HEAP_MAX_ALARMS alarms can be created.
+ * When the time is changed by rtc_settime(), the alarms are scheduled again from the new time.
+ *
+ * 20261015 : Use a min-heap and the RTC alarm registers instead of scanning lists every second
  */
 
 #ifndef RTC_SEM_HPP_
@@ -32,27 +39,7 @@ extern "C" {
 
 #include "FreeRTOS.h"
 #include "semphr.h"
-
-
-
-/**
- * Frequency of a recurring alarm
- */
-typedef enum {
-    everySecond = 0,
-    everyMinute = 1,
-    everyHour   = 2,
-    everyDay    = 3,
-} alarm_freq_t;
-
-/**
- * rtc_alarm_create() returns the pointer to this structure.
- * This structure can be used to change the alarm time after
- * it has been created.
- */
-typedef struct {
-    uint8_t hour, min, sec;
-} alarm_time_t;
+#include "alarm_heap.h" // alarm_freq_t, alarm_time_t
 
 
 
@@ -68,7 +55,8 @@ void rtc_alarm_create_recurring(alarm_freq_t freq, SemaphoreHandle_t *pAlarm);
 /**
  * Enables alarm at the given @param time
  * @post pAlarm semaphore will be given when RTC time matches the given time.
- * @return alarm_time_t that can be used to modify alarm time
+ * @return alarm_time_t that can be used to modify alarm time using rtc_alarm_set_time(),
+ *         or NULL if ALARM_HEAP_MAX_ALARMS alarms were created already.
  *
  * @code
  *      alarm_time_t my_time = { 12, 30, 0 }; // Alarm at 12:30 PM
@@ -80,16 +68,26 @@ void rtc_alarm_create_recurring(alarm_freq_t freq, SemaphoreHandle_t *pAlarm);
  *      }
  *
  *      // You can change the time any time :
- *      my_alarm_time->hour = 13
+ *      const alarm_time_t new_time = { 13, 30, 0 };
+ *      rtc_alarm_set_time(my_alarm_time, new_time);
  * @endcode
  */
 alarm_time_t* rtc_alarm_create(alarm_time_t time, SemaphoreHandle_t *pAlarm);
 
+/**
+ * Changes the time of an alarm that was created by rtc_alarm_create()
+ * @param p     The pointer returned by rtc_alarm_create()
+ * @param time  The new time of the alarm
+ * @note The time must be changed by this function rather than writing to the structure
+ *       because the alarms are sorted by their time.
+ */
+void rtc_alarm_set_time(alarm_time_t *p, alarm_time_t time);
+
 /**
  * Turns off an alarm that was created by rtc_alarm_create()
  * Nothing special here, the hour is set to 25, which will never occur.
  */
-static inline void rtc_alarm_off(alarm_time_t *p) { p->hour = 25; p->min = p->sec=0; }
+static inline void rtc_alarm_off(alarm_time_t *p) { const alarm_time_t off = { 25, 0, 0 }; rtc_alarm_set_time(p, off); }
 
 
 
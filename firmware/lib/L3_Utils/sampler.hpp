@@ -19,11 +19,42 @@
 #ifndef SAMPLER_HPP_
 #define SAMPLER_HPP_
 
+#include <math.h>
+#include <stdint.h>
+#include <type_traits>
+
+
+
+/**
+ * Default accumulator of the Sampler: 64-bit for integer samples such that the
+ * sum of squares does not overflow, and the sample type itself for floating point.
+ */
+template <typename TYPE>
+struct SamplerSumType
+{
+    typedef typename std::conditional<std::is_floating_point<TYPE>::value, TYPE,
+            typename std::conditional<std::is_signed<TYPE>::value, int64_t, uint64_t>::type>::type type;
+};
+
 /**
  * Sampler class.
  * The purpose of this class is to store samples of a variable type
  * and be able to get the average, low, high from the samples.
  *
+ * All statistics are maintained as samples are stored, so each query is O(1)
+ * regardless of the number of samples :
+ *  - The sum and the sum of squares are updated by adding the new sample and
+ *    subtracting the sample that falls out of the window.
+ *  - The highest and lowest use a monotonic queue of sample indexes such that
+ *    the front of each queue is always the highest (or lowest) sample.
+ *
+ * SUM_TYPE is the accumulator type, which is 64-bit for integer samples by
+ * default (see SamplerSumType).  The sum of squares needs twice the bits of the
+ * samples, so only use a narrower type if the samples are known to be small.
+ * If SUM_TYPE is floating point, the sums are re-computed each time the window
+ * wraps around such that rounding errors do not accumulate; this is amortized
+ * O(1) per sample.
+ *
  * @code
  * Sampler<int> samples(2);
  * samples.storeSample(10);
@@ -31,42 +62,70 @@
  * int avg = samples.getAverage(); // Should be 15
  * @endcode
  */
-template <typename TYPE>
+template <typename TYPE, typename SUM_TYPE = typename SamplerSumType<TYPE>::type>
 class Sampler
 {
     public:
-        Sampler(int numSamples) : mSampleArraySize(numSamples), mSampleIndex(0), mAllSamplesReady(false)
+        Sampler(int numSamples) : mSampleArraySize(numSamples)
         {
             mSamples = new TYPE[numSamples];
+            mMaxQ = new int[numSamples];
+            mMinQ = new int[numSamples];
             for(int i=0; i < numSamples; i++) {
                 mSamples[i] = 0;
             }
+            clear();
         }
 
         ~Sampler()
         {
             delete [] mSamples;
+            delete [] mMaxQ;
+            delete [] mMinQ;
         }
 
         void storeSample(const TYPE& sample)
         {
+            if (mAllSamplesReady) {
+                /* The sample at mSampleIndex is about to be overwritten, so remove it from the stats */
+                const TYPE& old = mSamples[mSampleIndex];
+                mSum -= old;
+                mSumOfSquares -= (SUM_TYPE)old * old;
+
+                if (mMaxQ[mMaxHead] == mSampleIndex) {
+                    popFront(mMaxHead, mMaxCount);
+                }
+                if (mMinQ[mMinHead] == mSampleIndex) {
+                    popFront(mMinHead, mMinCount);
+                }
+            }
+
             mSamples[mSampleIndex] = sample;
+            mSum += sample;
+            mSumOfSquares += (SUM_TYPE)sample * sample;
+
+            /* Smaller (or larger) samples before this one can never become the highest (or lowest) */
+            while (mMaxCount > 0 && !(mSamples[back(mMaxHead, mMaxCount, mMaxQ)] > sample)) {
+                mMaxCount--;
+            }
+            pushBack(mMaxHead, mMaxCount, mMaxQ, mSampleIndex);
+
+            while (mMinCount > 0 && !(mSamples[back(mMinHead, mMinCount, mMinQ)] < sample)) {
+                mMinCount--;
+            }
+            pushBack(mMinHead, mMinCount, mMinQ, mSampleIndex);
+
             if(++mSampleIndex >= mSampleArraySize) {
                 mSampleIndex = 0;
                 mAllSamplesReady = true;
+                resum(std::is_floating_point<SUM_TYPE>());
             }
         }
 
         TYPE getAverage(void) const
         {
-            const int numSamples = mAllSamplesReady ? mSampleArraySize : mSampleIndex;
-            TYPE sum = 0;
-
-            for(int i=0; i < numSamples; i++) {
-                sum += mSamples[i];
-            }
-
-            return (sum / numSamples);
+            const int numSamples = getSampleCount();
+            return (0 == numSamples) ? 0 : (TYPE)(mSum / numSamples);
         }
 
         TYPE getLatest(void) const
@@ -77,30 +136,43 @@ class Sampler
 
         TYPE getHighest(void) const
         {
-            const int numSamples = mAllSamplesReady ? mSampleArraySize : mSampleIndex;
-            TYPE highest = mSamples[0];
+            return (0 == mMaxCount) ? mSamples[0] : mSamples[mMaxQ[mMaxHead]];
+        }
 
-            for(int i=0; i < numSamples; i++) {
-                if (highest < mSamples[i]) {
-                    highest = mSamples[i];
-                }
+        TYPE getLowest(void) const
+        {
+            return (0 == mMinCount) ? mSamples[0] : mSamples[mMinQ[mMinHead]];
+        }
+
+        /// @returns the sum of the samples
+        inline SUM_TYPE getSum(void) const { return mSum; }
+
+        /// @returns the population variance of the samples, rounded down for integer samples
+        SUM_TYPE getVariance(void) const
+        {
+            SUM_TYPE m2, rem;
+            const SUM_TYPE n = getSquaredDeviations(m2, rem);
+            if (0 == n) {
+                return 0;
             }
 
-            return highest;
+            /* Rounding up rem^2 / n for integers rounds down the variance exactly */
+            const SUM_TYPE roundUp = std::is_floating_point<SUM_TYPE>::value ? 0 : (n - 1);
+            const SUM_TYPE variance = (m2 - (((rem * rem) + roundUp) / n)) / n;
+            return (variance < 0) ? 0 : variance;
         }
 
-        TYPE getLowest(void) const
+        /// @returns the population standard deviation of the samples
+        float getStdDev(void) const
         {
-            const int numSamples = mAllSamplesReady ? mSampleArraySize : mSampleIndex;
-            TYPE lowest = mSamples[0];
-
-            for(int i=0; i < numSamples; i++) {
-                if (lowest > mSamples[i]) {
-                    lowest = mSamples[i];
-                }
+            SUM_TYPE m2, rem;
+            const SUM_TYPE n = getSquaredDeviations(m2, rem);
+            if (0 == n) {
+                return 0;
             }
 
-            return lowest;
+            const float variance = ((float)m2 - ((float)(rem * rem) / (float)n)) / (float)n;
+            return (variance < 0) ? 0 : sqrtf(variance);
         }
 
         inline bool allSamplesReady(void)  const { return mAllSamplesReady; }
@@ -112,20 +184,223 @@ class Sampler
         {
             mAllSamplesReady = false;
             mSampleIndex = 0;
+            mSum = 0;
+            mSumOfSquares = 0;
+            mMaxHead = mMaxCount = 0;
+            mMinHead = mMinCount = 0;
         }
 
     private:
         /// Do not use this constructor
         Sampler() :
             mSampleArraySize(0), mSampleIndex(0),
-            mAllSamplesReady(false), mSamples(0)
+            mAllSamplesReady(false), mSamples(0),
+            mMaxQ(0), mMinQ(0)
         {
         }
 
+        /**
+         * @{ Circular queue operations of the monotonic queues.
+         * The queues cannot overflow because each sample index is pushed once and
+         * removed before it is overwritten.
+         */
+        inline int back(int head, int count, const int* q) const
+        {
+            const int idx = head + count - 1;
+            return q[idx >= mSampleArraySize ? idx - mSampleArraySize : idx];
+        }
+        inline void pushBack(int head, int& count, int* q, int value)
+        {
+            const int idx = head + count;
+            q[idx >= mSampleArraySize ? idx - mSampleArraySize : idx] = value;
+            count++;
+        }
+        inline void popFront(int& head, int& count)
+        {
+            if (++head >= mSampleArraySize) {
+                head = 0;
+            }
+            count--;
+        }
+        /** @} */
+
+        /**
+         * Gets n * variance = E[x^2] * n - sum^2 / n, written such that sum * sum does not overflow
+         * the SUM_TYPE.  With sum = mean * n + rem, this is m2 - rem^2 / n where
+         * m2 = E[x^2] * n - mean * (sum + rem), so the fraction of an integer mean is not lost.
+         * @returns the number of samples n
+         */
+        inline SUM_TYPE getSquaredDeviations(SUM_TYPE& m2, SUM_TYPE& rem) const
+        {
+            const SUM_TYPE n = getSampleCount();
+            if (0 == n) {
+                m2 = rem = 0;
+                return 0;
+            }
+
+            const SUM_TYPE mean = mSum / n;
+            rem = mSum - (mean * n);
+            m2 = mSumOfSquares - (mean * (mSum + rem));
+            return n;
+        }
+
+        /// Re-computes the sums from the samples to discard floating point rounding errors
+        void resum(std::true_type)
+        {
+            mSum = mSumOfSquares = 0;
+            for (int i = 0; i < mSampleArraySize; i++) {
+                mSum += mSamples[i];
+                mSumOfSquares += (SUM_TYPE)mSamples[i] * mSamples[i];
+            }
+        }
+        /// Integer sums are exact so nothing to do
+        void resum(std::false_type) { }
+
         const int mSampleArraySize; ///< Number of samples
         int mSampleIndex;           ///< Index of next sample that will get stored to mSamples array
         bool mAllSamplesReady;      ///< If the whole array is not filled, we can't compute the average
         TYPE* mSamples;             ///< Array of samples
+
+        SUM_TYPE mSum;              ///< Sum of the samples in the window
+        SUM_TYPE mSumOfSquares;     ///< Sum of the square of the samples in the window
+
+        int* mMaxQ;                 ///< Indexes of the samples in decreasing order of their value
+        int mMaxHead;               ///< Front of mMaxQ
+        int mMaxCount;              ///< Number of indexes in mMaxQ
+        int* mMinQ;                 ///< Indexes of the samples in increasing order of their value
+        int mMinHead;               ///< Front of mMinQ
+        int mMinCount;              ///< Number of indexes in mMinQ
 };
 
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdlib.h>
+static inline void test_sampler(void)
+{
+    Sampler<int> s(3);
+    assert(0 == s.getAverage());
+    s.storeSample(10);
+    s.storeSample(20);
+    assert(15 == s.getAverage());
+    assert(20 == s.getHighest());
+    assert(10 == s.getLowest());
+    assert(25 == s.getVariance());
+    assert(fabsf(5.0f - s.getStdDev()) < 0.0001f);
+
+    s.storeSample(30);
+    s.storeSample(5);   // 10 falls out: 20 30 5
+    assert(30 == s.getHighest());
+    assert(5 == s.getLowest());
+    s.storeSample(6);   // 20 falls out: 30 5 6
+    s.storeSample(7);   // 30 falls out: 5 6 7
+    assert(7 == s.getHighest());
+    assert(5 == s.getLowest());
+    assert(6 == s.getAverage());
+    assert(7 == s.getLatest());
+
+    /* Compare against brute force over a random sequence */
+    Sampler<int, long long> r(17);
+    int ref[17] = { 0 };
+    for (int i = 0; i < 1000; i++) {
+        const int v = (rand() % 2001) - 1000;
+        r.storeSample(v);
+        ref[i % 17] = v;
+
+        const int n = r.getSampleCount();
+        long long sum = 0, sq = 0;
+        int hi = ref[0], lo = ref[0];
+        for (int j = 0; j < n; j++) {
+            sum += ref[j];
+            sq += (long long)ref[j] * ref[j];
+            hi = (ref[j] > hi) ? ref[j] : hi;
+            lo = (ref[j] < lo) ? ref[j] : lo;
+        }
+        assert(sum == r.getSum());
+        assert(hi == r.getHighest());
+        assert(lo == r.getLowest());
+        assert((n * sq - sum * sum) / ((long long)n * n) == r.getVariance());
+        assert(fabsf(sqrtf((float)(n * sq - sum * sum) / ((float)n * n)) - r.getStdDev()) < 0.01f);
+    }
+
+    /* Floating point sums are re-computed when the window wraps */
+    Sampler<float> f(4);
+    for (int i = 0; i < 10000; i++) {
+        f.storeSample(0.1f * (i % 7));
+    }
+    assert(fabsf(f.getSum() - (0.1f * (9996 % 7 + 9997 % 7 + 9998 % 7 + 9999 % 7))) < 0.0001f);
+
+    /* Squares of int samples above 46340 need the 64-bit default accumulator */
+    Sampler<int> big(2);
+    big.storeSample(50000);
+    big.storeSample(-60000);
+    big.storeSample(-60000);   // 50000 falls out
+    big.storeSample(50000);    // -60000 falls out
+    assert(-5000 == big.getAverage());
+    assert(3025000000LL == big.getVariance());
+    assert(fabsf(55000.0f - big.getStdDev()) < 1.0f);
+
+    /* The mean is not rounded before the variance, so a large offset does not add to it */
+    Sampler<int> offset(3);
+    offset.storeSample(1000);
+    offset.storeSample(1001);
+    assert(0 == offset.getVariance());
+    assert(fabsf(0.5f - offset.getStdDev()) < 0.0001f);
+    offset.storeSample(1000007);
+    offset.storeSample(1000000);   // 1000 falls out
+    offset.storeSample(1000003);   // 1001 falls out: variance of 1000007 1000000 1000003 is 8.22
+    assert(8 == offset.getVariance());
+    assert(fabsf(2.8674f - offset.getStdDev()) < 0.001f);
+    Sampler<int> quarter(4);
+    quarter.storeSample(100);
+    quarter.storeSample(101);
+    quarter.storeSample(101);
+    quarter.storeSample(101);
+    assert(0 == quarter.getVariance());
+    assert(fabsf(0.4330f - quarter.getStdDev()) < 0.0001f);
+
+    s.clear();
+    assert(0 == s.getSampleCount());
+    s.storeSample(-1);
+    assert(-1 == s.getHighest() && -1 == s.getLowest());
+
+    puts("\nSampler Tests Successful!");
+}
+
+#ifndef __arm__
+#include <stdio.h>
+#include <chrono>
+/// Host only benchmark showing that the query cost does not depend on the window size
+static inline void test_sampler_benchmark(void)
+{
+    typedef std::chrono::steady_clock clock;
+    const int count = 100 * 1000;
+
+    for (int window = 10; window <= 100000; window *= 10)
+    {
+        Sampler<int32_t, int64_t> s(window);
+        int64_t dummy = 0;
+
+        clock::time_point start = clock::now();
+        for (int i = 0; i < count; i++) {
+            s.storeSample(rand() & 0xFFFF);
+        }
+        const double storeSec = std::chrono::duration<double>(clock::now() - start).count();
+
+        start = clock::now();
+        for (int i = 0; i < count; i++) {
+            s.storeSample(i);
+            dummy += s.getAverage() + s.getHighest() + s.getLowest() + s.getVariance();
+        }
+        const double querySec = std::chrono::duration<double>(clock::now() - start).count();
+
+        printf("\nWindow %6i: store %6.1f ns/sample, store + 4 queries %6.1f ns [%lli]",
+               window, storeSec * 1e9 / count, querySec * 1e9 / count, (long long)dummy);
+    }
+    puts("");
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
 #endif /* SAMPLER_HPP_ */
@@ -0,0 +1,291 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Lightweight scheduling trace: a ring of binary events fed by the FreeRTOS trace hooks
+ * @ingroup Utilities
+ *
+ * If SYS_CFG_SCHED_TRACE is enabled, FreeRTOSConfig.h hooks the trace macros of FreeRTOS to
+ * record when tasks are switched in, made ready, and blocked on queues, delays and task
+ * notifications.  isr_forwarder_routine() records each ISR entry and exit.  The application
+ * can add its own markers with sched_trace_mark(), sched_trace_begin() and sched_trace_end().
+ *
+ * Each event is an 8 byte record timestamped with the lower 32-bits of sys_get_uptime_us().
+ * The ring overwrites the oldest records, so it always holds the latest events, like a flight
+ * recorder.  The "trace" terminal command saves the ring to a file, and the host tool
+ * (tools/SchedTrace/sched_trace_to_json.py) converts it to Chrome trace JSON that can be opened
+ * with chrome://tracing or https://ui.perfetto.dev to see the latency from an ISR to the task
+ * it wakes up.
+ *
+ * Records are claimed with an atomic increment, so any ISR can record events without a
+ * critical section.  A record may then be out of order by the time of an ISR that preempted
+ * its writer; the host tool sorts the records by time.
+ *
+ * File format of sched_trace_save() (little endian) :
+ *  - char[4]   "STRC"
+ *  - uint8_t   Version (1), record size (8), number of task names, number of marker names
+ *  - uint32_t  Number of records, number of records that were overwritten
+ *  - Task names of task id 1 and up, then marker names of marker id 0 and up, each
+ *    SCHED_TRACE_NAME_LEN characters padded with zeroes
+ *  - The records from the oldest to the newest
+ *
+ * 20261016 : Initial
+ */
+#ifndef SCHED_TRACE_H__
+#define SCHED_TRACE_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+#define SCHED_TRACE_SIZE        512     ///< Records in the ring of the firmware (power of 2), 8 bytes each
+#define SCHED_TRACE_MAX_TASKS   32      ///< Max tasks with a name, more tasks are task id 0
+#define SCHED_TRACE_MAX_MARKERS 16      ///< Max markers with a name
+#define SCHED_TRACE_NAME_LEN    8       ///< Characters of a name in the saved file (same as configMAX_TASK_NAME_LEN)
+
+/// The type of an event, and the meaning of its id and arg
+typedef enum {
+    sched_trace_ev_none = 0,
+    sched_trace_ev_switch_in,      ///< id: Task that runs now
+    sched_trace_ev_ready,          ///< id: Task that was made ready, arg: Exception number of the ISR that did it (0 if a task)
+    sched_trace_ev_isr_enter,      ///< id: IRQ number
+    sched_trace_ev_isr_exit,       ///< id: IRQ number
+    sched_trace_ev_block_recv,     ///< Running task blocks to receive from a queue, id:arg is the lower 24-bits of its address
+    sched_trace_ev_block_send,     ///< Running task blocks to send to a queue, id:arg is the lower 24-bits of its address
+    sched_trace_ev_block_delay,    ///< Running task is delayed, arg: ticks (up to 0xFFFF)
+    sched_trace_ev_block_notify,   ///< Running task blocks for a task notification
+    sched_trace_ev_mark,           ///< id: Marker, arg: Value
+    sched_trace_ev_begin,          ///< id: Marker, arg: Value
+    sched_trace_ev_end,            ///< id: Marker, arg: Value
+    sched_trace_ev_last_event,
+} sched_trace_event_t;
+
+/// A record of the ring
+typedef struct {
+    uint32_t time_us;   ///< Lower 32-bits of the uptime in microseconds
+    uint8_t type;       ///< sched_trace_event_t
+    uint8_t id;         ///< Task, IRQ or marker
+    uint16_t arg;       ///< Argument of the event
+} sched_trace_rec_t;
+
+/**
+ * Starts recording to the given ring; tasks may be added before this is called.
+ * @param recs          The records of the ring
+ * @param count         The number of records (power of 2)
+ * @param get_time_us   The function that returns the time in microseconds
+ */
+void sched_trace_init(sched_trace_rec_t *recs, uint32_t count, uint32_t (*get_time_us)(void));
+
+/// Pauses or resumes the recording
+void sched_trace_enable(bool enable);
+bool sched_trace_is_enabled(void);
+
+/// Discards all records
+void sched_trace_clear(void);
+
+/**
+ * Adds the name of a task (from the traceTASK_CREATE() hook)
+ * @returns the task id, or 0 if there are too many tasks
+ */
+uint8_t sched_trace_add_task(const char *name);
+
+/// @returns the name of the task id, or NULL if not known
+const char* sched_trace_get_task_name(uint8_t id);
+
+/// Names a marker, the name is not copied
+void sched_trace_set_marker_name(uint8_t id, const char *name);
+
+/// Records an event
+void sched_trace_record(sched_trace_event_t type, uint8_t id, uint16_t arg);
+
+/// Records a task made ready along with the ISR that made it ready
+void sched_trace_task_ready(uint8_t id);
+
+/** @{ Hooks */
+static inline void sched_trace_switch_in(uint8_t id)  { sched_trace_record(sched_trace_ev_switch_in, id, 0); }
+static inline void sched_trace_isr_enter(uint8_t irq) { sched_trace_record(sched_trace_ev_isr_enter, irq, 0); }
+static inline void sched_trace_isr_exit(uint8_t irq)  { sched_trace_record(sched_trace_ev_isr_exit, irq, 0); }
+static inline void sched_trace_block(sched_trace_event_t type, const void *queue)
+{
+    sched_trace_record(type, (uint8_t)((uintptr_t)queue >> 16), (uint16_t)(uintptr_t)queue);
+}
+static inline void sched_trace_delay(uint32_t ticks)
+{
+    sched_trace_record(sched_trace_ev_block_delay, 0, ticks > 0xFFFF ? 0xFFFF : (uint16_t)ticks);
+}
+/** @} */
+
+/** @{ User markers: begin and end show as a slice, and mark as an instant event */
+static inline void sched_trace_mark(uint8_t id, uint16_t value)  { sched_trace_record(sched_trace_ev_mark, id, value); }
+static inline void sched_trace_begin(uint8_t id, uint16_t value) { sched_trace_record(sched_trace_ev_begin, id, value); }
+static inline void sched_trace_end(uint8_t id, uint16_t value)   { sched_trace_record(sched_trace_ev_end, id, value); }
+/** @} */
+
+/// @returns the number of records in the ring
+uint32_t sched_trace_get_count(void);
+
+/// @returns the number of records that were overwritten
+uint32_t sched_trace_get_lost(void);
+
+/**
+ * Gets a record
+ * @param index  0 for the oldest record, up to sched_trace_get_count() - 1
+ * @returns false if the index is out of range
+ */
+bool sched_trace_get(uint32_t index, sched_trace_rec_t *rec);
+
+/// @returns the name of an event type
+const char* sched_trace_get_event_name(uint8_t type);
+
+/**
+ * Saves the trace in the file format documented above.  The recording is paused while saving.
+ * @param write  The function that writes the data
+ * @param arg    The argument passed to the write function
+ * @returns the number of records saved
+ */
+uint32_t sched_trace_save(void (*write)(const void *data, uint32_t len, void *arg), void *arg);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t g_test_sched_trace_time = 0;
+static uint32_t test_sched_trace_time(void) { return g_test_sched_trace_time += 10; }
+
+typedef struct {
+    uint8_t data[512];
+    uint32_t len;
+} test_sched_trace_file_t;
+
+static void test_sched_trace_write(const void *data, uint32_t len, void *arg)
+{
+    test_sched_trace_file_t *file = (test_sched_trace_file_t*) arg;
+    assert(file->len + len <= sizeof(file->data));
+    memcpy(file->data + file->len, data, len);
+    file->len += len;
+}
+
+static inline void test_sched_trace(void)
+{
+    sched_trace_rec_t recs[8];
+    sched_trace_rec_t rec;
+    test_sched_trace_file_t file;
+    const uint32_t queue = 0x10002468;
+
+    assert(8 == sizeof(sched_trace_rec_t));
+
+    /* Tasks can be added before the ring exists, and events before the ring are ignored */
+    const uint8_t idle = sched_trace_add_task("IDLE");
+    const uint8_t logger = sched_trace_add_task("logger");
+    assert(idle > 0 && logger == idle + 1);
+    assert(0 == strcmp("logger", sched_trace_get_task_name(logger)));
+    assert(NULL == sched_trace_get_task_name(0));
+    sched_trace_switch_in(idle);
+
+    sched_trace_init(recs, 8, test_sched_trace_time);
+    assert(0 == sched_trace_get_count());
+    sched_trace_switch_in(idle);
+    sched_trace_isr_enter(5);
+    sched_trace_task_ready(logger);
+    sched_trace_isr_exit(5);
+    sched_trace_switch_in(logger);
+    sched_trace_block(sched_trace_ev_block_recv, (const void*)(uintptr_t)queue);
+    assert(6 == sched_trace_get_count() && 0 == sched_trace_get_lost());
+
+    assert(sched_trace_get(0, &rec));
+    assert(sched_trace_ev_switch_in == rec.type && idle == rec.id && 10 == rec.time_us);
+    assert(sched_trace_get(5, &rec));
+    assert(sched_trace_ev_block_recv == rec.type && 0x00 == rec.id && 0x2468 == rec.arg && 60 == rec.time_us);
+    assert(!sched_trace_get(6, &rec));
+    assert(0 == strcmp("block_recv", sched_trace_get_event_name(rec.type)));
+
+    /* Paused recording is not recorded */
+    sched_trace_enable(false);
+    sched_trace_mark(1, 2);
+    assert(6 == sched_trace_get_count());
+    sched_trace_enable(true);
+
+    /* The oldest records are overwritten */
+    sched_trace_set_marker_name(0, "send");
+    sched_trace_begin(0, 1);
+    sched_trace_delay(100000);
+    sched_trace_end(0, 1);
+    assert(8 == sched_trace_get_count() && 1 == sched_trace_get_lost());
+    assert(sched_trace_get(0, &rec) && sched_trace_ev_isr_enter == rec.type);
+    assert(sched_trace_get(6, &rec) && sched_trace_ev_block_delay == rec.type && 0xFFFF == rec.arg);
+    assert(sched_trace_get(7, &rec) && sched_trace_ev_end == rec.type && 90 == rec.time_us);
+
+    /* Saved file: header, names, then records from the oldest */
+    memset(&file, 0, sizeof(file));
+    assert(8 == sched_trace_save(test_sched_trace_write, &file));
+    assert(0 == memcmp("STRC", file.data, 4));
+    assert(1 == file.data[4] && 8 == file.data[5] && logger == file.data[6] && 1 == file.data[7]);
+    const uint32_t names_len = (logger + 1) * SCHED_TRACE_NAME_LEN;
+    assert(16 + names_len + 8 * sizeof(sched_trace_rec_t) == file.len);
+    assert(0 == strcmp("logger", (const char*)file.data + 16 + (logger - 1) * SCHED_TRACE_NAME_LEN));
+    assert(0 == strcmp("send", (const char*)file.data + 16 + logger * SCHED_TRACE_NAME_LEN));
+    memcpy(&rec, file.data + 16 + names_len, sizeof(rec));
+    assert(sched_trace_ev_isr_enter == rec.type && 5 == rec.id);
+    assert(sched_trace_is_enabled());
+
+    sched_trace_clear();
+    assert(0 == sched_trace_get_count() && 0 == sched_trace_get_lost());
+
+    puts("\nSched Trace Tests Successful!");
+}
+
+#ifndef __arm__
+#include <time.h>
+static uint32_t test_sched_trace_clock_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/// Host only benchmark of the cost of an event
+static inline void test_sched_trace_benchmark(void)
+{
+    static sched_trace_rec_t recs[1024];
+    const int count = 1000 * 1000;
+    int i;
+
+    sched_trace_init(recs, 1024, test_sched_trace_clock_us);
+    clock_t start = clock();
+    for (i = 0; i < count; i++) {
+        sched_trace_switch_in((uint8_t) i);
+    }
+    const double sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("\nSched trace : %5.1f ns/event, %u bytes/event\n", sec * 1e9 / count, (unsigned)sizeof(sched_trace_rec_t));
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* SCHED_TRACE_H__ */
@@ -20,6 +20,7 @@
  * @file
  * @brief Provides "Software Timer" or a polling timer
  *
+ * 20261015 : Added callback and task notification on expiration using the TimerService
  * 20140401 : Added more useful methods
  * 20131201 : First version history tag (this one)
  */
@@ -27,7 +28,10 @@
 #define SOFT_TIMER_H__
 
 #include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
 #include "lpc_sys.h"
+#include "timer_service.hpp"
 
 
 
@@ -39,15 +43,37 @@
  *          work well since the OS ticks will not happen to drive the timer.  In that
  *          case, you are better off using the true FreeRTOS timer which will not
  *          suppress the timer ticks if a timer expires.
+ *
+ * Instead of polling expired(), the timer can be registered with the TimerService using
+ * resetWithCallback() or resetWithNotify().  Then the service calls the callback (or notifies
+ * the task) when the timer expires, and reset(), restart() and stop() update the service.
+ * These take the timer out of the service before they change it, so they wait for a callback
+ * that is running, and the timer does not call back after stop() or its destructor returns.
+ *
+ * @code
+ *      SoftTimer timer;
+ *      timer.resetWithNotify(100, xTaskGetCurrentTaskHandle(), true);
+ *      while (1) {
+ *          ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Wakes up every 100ms
+ *      }
+ * @endcode
  */
 class SoftTimer
 {
     public:
         /// Default constructor
-        SoftTimer() : mTargetMs(0), mIntervalMs(0) {}
+        SoftTimer() : mTargetMs(0), mIntervalMs(0), mEntry(onExpired, this), mpCallback(0), mpArg(0), mPeriodic(false) {}
 
         /// Constructor to set timer while instantiating this object.
-        SoftTimer(uint32_t ms) : mTargetMs(0), mIntervalMs(0) { reset(ms); }
+        SoftTimer(uint32_t ms) : mTargetMs(0), mIntervalMs(0), mEntry(onExpired, this), mpCallback(0), mpArg(0), mPeriodic(false)
+        { reset(ms); }
+
+        /// The TimerService calls back this object, so do not copy (a copy would call the callback twice)
+        SoftTimer(const SoftTimer& copy) = delete;
+        SoftTimer& operator=(const SoftTimer& copy) = delete;
+
+        /// Destructor that removes the timer from the TimerService
+        ~SoftTimer() { cancelService(); }
 
         /// @returns true if the timer has expired
         inline bool expired(void) const
@@ -68,19 +94,48 @@ class SoftTimer
          *      }
          * @endcode
          */
-        inline void restart(void) { mTargetMs += mIntervalMs; };
+        inline void restart(void) { cancelService(); mTargetMs += mIntervalMs; updateService(); };
 
         /**
          * Resets the timer from this point of time using the new timer value given.
          * @param ms  The milliseconds at which timer should expire next.
          */
-        inline void reset(uint64_t ms) { mIntervalMs = ms; mTargetMs = getCurrentTimeMs() + ms; }
+        inline void reset(uint64_t ms) { cancelService(); mIntervalMs = ms; mTargetMs = getCurrentTimeMs() + ms; updateService(); }
 
         /// Resets the timer from this point of time using the previous timeout interval
-        inline void reset(void) { mTargetMs = getCurrentTimeMs() + mIntervalMs; }
+        inline void reset(void) { cancelService(); mTargetMs = getCurrentTimeMs() + mIntervalMs; updateService(); }
 
         /// Stops the timer.
-        inline void stop(void) { mIntervalMs = mTargetMs = 0; }
+        inline void stop(void) { cancelService(); mIntervalMs = mTargetMs = 0; }
+
+        /**
+         * Resets the timer like reset(uint64_t), and the TimerService calls the callback when the timer
+         * expires.  The callback runs in the service task, so it should be short and must not block.
+         * @param ms        The milliseconds at which timer should expire next.
+         * @param callback  The function to call when the timer expires
+         * @param pArg      The argument of the callback function
+         * @param periodic  If true, the timer will restart() after each expiration
+         */
+        inline void resetWithCallback(uint64_t ms, TimerWheelCallback_t callback, void *pArg, bool periodic=false)
+        {
+            cancelService();
+            mpCallback = callback;
+            mpArg = pArg;
+            mPeriodic = periodic;
+            reset(ms);
+        }
+
+        /**
+         * Resets the timer like reset(uint64_t), and the task is given a task notification when the
+         * timer expires, such that the task can sleep on ulTaskNotifyTake() instead of polling expired().
+         * @param ms        The milliseconds at which timer should expire next.
+         * @param task      The task to notify
+         * @param periodic  If true, the timer will restart() after each expiration
+         */
+        inline void resetWithNotify(uint64_t ms, TaskHandle_t task, bool periodic=false)
+        {
+            resetWithCallback(ms, TimerService::notifyTask, task, periodic);
+        }
 
         /// @returns true if the timer is set and running
         inline bool isRunning(void) const { return (mIntervalMs > 0); }
@@ -131,12 +186,53 @@ class SoftTimer
         uint64_t mTargetMs;     ///< Expire time with respect to OS tick
         uint64_t mIntervalMs;   ///< Timer interval
         /** @} */
+
+    private:
+        /// Takes the timer out of the TimerService (if a callback was set) before the timer is changed
+        inline void cancelService(void)
+        {
+            if (mpCallback) {
+                TimerService::cancel(mEntry);
+            }
+        }
+
+        /// Adds the timer to the TimerService if a callback was set, and the service restarts a periodic timer
+        inline void updateService(void)
+        {
+            if (mpCallback && mIntervalMs > 0) {
+                TimerService::addAt(mEntry, mTargetMs, mPeriodic ? (uint32_t) mIntervalMs : 0);
+            }
+        }
+
+        /**
+         * Called by the TimerService when the timer expires.  The service already added a periodic
+         * timer again, so only the target time follows it, and the other tasks that change the timer
+         * wait for this to return.
+         */
+        static void onExpired(void *pArg)
+        {
+            SoftTimer *pTimer = (SoftTimer*) pArg;
+            if (pTimer->mPeriodic) {
+                pTimer->mTargetMs += pTimer->mIntervalMs;
+            }
+            pTimer->mpCallback(pTimer->mpArg);
+        }
+
+        TimerWheelEntry mEntry;         ///< The timer of the TimerService
+        TimerWheelCallback_t mpCallback;///< The callback when the timer expires, NULL if the timer is polled
+        void *mpArg;                    ///< The argument of the callback
+        bool mPeriodic;                 ///< If true, the timer restarts after it expires
 };
 
 
 
 
 #ifdef TESTING
+#include "utilities.h"
+
+static inline void test_soft_timer_stop(void *pTimer) { ((SoftTimer*) pTimer)->stop(); }
+static inline void test_soft_timer_delete(void *pTimer) { delete (SoftTimer*) pTimer; }
+
 static inline void test_soft_timer_file(void)
 {
     SoftTimer t;
@@ -156,6 +252,70 @@ static inline void test_soft_timer_file(void)
     t.reset(5); assert(5 == t.getTimeToExpirationMs());
     delay_ms(10); assert(5 == t.getTimeSinceExpirationMs());
 }
+
+/**
+ * Tests the SoftTimer with the TimerService.  This has to be called by a task with a lower
+ * priority than TIMER_SERVICE_PRIORITY, and while no other timers are added or expire.
+ */
+static inline void test_soft_timer_service(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    const uint32_t count = TimerService::getCount();
+    SoftTimer t;
+
+    /* A periodic timer notifies the task at its period without drifting */
+    t.resetWithNotify(10, task, true);
+    assert(count + 1 == TimerService::getCount());
+    const uint64_t start = SoftTimer::getCurrentTimeMs();
+    for (int i = 0; i < 5; i++) {
+        assert(1 == ulTaskNotifyTake(pdTRUE, OS_MS(50)));
+    }
+    const uint64_t elapsed = SoftTimer::getCurrentTimeMs() - start;
+    assert(elapsed >= 49 && elapsed <= 55);
+    assert(t.isRunning() && !t.expired());
+
+    /* Stopping the timer takes it out of the service */
+    t.stop();
+    assert(count == TimerService::getCount());
+    assert(0 == ulTaskNotifyTake(pdTRUE, OS_MS(30)));
+
+    /* reset() moves the timer of the service, and a one-shot timer expires once */
+    t.resetWithNotify(10, task);
+    vTaskDelay(OS_MS(5));
+    t.reset();
+    assert(0 == ulTaskNotifyTake(pdTRUE, OS_MS(8)));
+    assert(1 == ulTaskNotifyTake(pdTRUE, OS_MS(20)));
+    assert(0 == ulTaskNotifyTake(pdTRUE, OS_MS(30)));
+    assert(t.expired() && count == TimerService::getCount());
+
+    /* The destructor takes the timer out of the service */
+    do {
+        SoftTimer scoped;
+        scoped.resetWithNotify(10, task);
+        assert(count + 1 == TimerService::getCount());
+    } while (0);
+    assert(count == TimerService::getCount());
+    assert(0 == ulTaskNotifyTake(pdTRUE, OS_MS(30)));
+
+    /* Stopping a periodic timer while its callback runs waits for the callback, and it does not call back again */
+    g_test_timer_service_fired = 0;
+    test_timer_service_set_preempt(test_soft_timer_stop, &t);
+    t.resetWithCallback(5, test_timer_service_busy_callback, 0, true);
+    vTaskDelay(OS_MS(40));
+    assert(1 == g_test_timer_service_fired && !g_test_timer_service_busy_after_preempt);
+    assert(!t.isRunning() && count == TimerService::getCount());
+
+    /* Destroying a periodic timer while its callback runs waits for the callback */
+    SoftTimer *pTimer = new SoftTimer();
+    g_test_timer_service_fired = 0;
+    test_timer_service_set_preempt(test_soft_timer_delete, pTimer);
+    pTimer->resetWithCallback(5, test_timer_service_busy_callback, 0, true);
+    vTaskDelay(OS_MS(40));
+    assert(1 == g_test_timer_service_fired && !g_test_timer_service_busy_after_preempt);
+    assert(count == TimerService::getCount());
+
+    puts("\nSoft Timer Service Tests Successful!");
+}
 #endif /* #ifdef TESTING */
 
 
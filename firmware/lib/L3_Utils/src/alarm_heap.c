@@ -0,0 +1,211 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <stddef.h>   // NULL
+#include "alarm_heap.h"
+
+
+
+#define SECONDS_PER_DAY     (24 * 60 * 60)
+
+/// @returns the second of the day of the time
+static inline uint32_t alarm_heap_sod(alarm_time_t t)
+{
+    return (t.hour * 3600u) + (t.min * 60u) + t.sec;
+}
+
+/// @returns true if the alarm a fires before b, even after the seconds counter wraps around
+static inline bool alarm_heap_before(const alarm_heap_entry_t *a, const alarm_heap_entry_t *b)
+{
+    return (int32_t)(a->next_sec - b->next_sec) < 0;
+}
+
+/// @returns the number of seconds after the current time when the alarm fires next
+static uint32_t alarm_heap_secs_until(const alarm_heap_t *h, const alarm_heap_entry_t *alarm)
+{
+    const uint32_t sod = h->now_sod;
+    uint32_t secs = 0;
+
+    switch (alarm->freq) {
+        case everySecond: secs = 1;                       break;
+        case everyMinute: secs = 60 - (sod % 60);         break;
+        case everyHour:   secs = 3600 - (sod % 3600);     break;
+        case everyDay:    secs = SECONDS_PER_DAY - sod;   break;
+        default:
+            secs = (alarm_heap_sod(alarm->time) + SECONDS_PER_DAY - sod) % SECONDS_PER_DAY;
+            if (0 == secs) {
+                secs = SECONDS_PER_DAY;
+            }
+            break;
+    }
+
+    return secs;
+}
+
+/// Stores the alarm at the heap index
+static inline void alarm_heap_store(alarm_heap_t *h, uint8_t index, alarm_heap_entry_t *alarm)
+{
+    h->heap[index] = alarm;
+    alarm->heap_index = index;
+}
+
+static void alarm_heap_sift_up(alarm_heap_t *h, uint8_t index)
+{
+    alarm_heap_entry_t *alarm = h->heap[index];
+
+    while (index > 0) {
+        const uint8_t parent = (index - 1) / 2;
+        if (!alarm_heap_before(alarm, h->heap[parent])) {
+            break;
+        }
+        alarm_heap_store(h, index, h->heap[parent]);
+        index = parent;
+    }
+    alarm_heap_store(h, index, alarm);
+}
+
+static void alarm_heap_sift_down(alarm_heap_t *h, uint8_t index)
+{
+    alarm_heap_entry_t *alarm = h->heap[index];
+
+    while (1) {
+        uint8_t child = (2 * index) + 1;
+        if (child >= h->heap_size) {
+            break;
+        }
+        if (child + 1 < h->heap_size && alarm_heap_before(h->heap[child + 1], h->heap[child])) {
+            ++child;
+        }
+        if (!alarm_heap_before(h->heap[child], alarm)) {
+            break;
+        }
+        alarm_heap_store(h, index, h->heap[child]);
+        index = child;
+    }
+    alarm_heap_store(h, index, alarm);
+}
+
+/// Removes the alarm from the heap
+static void alarm_heap_remove(alarm_heap_t *h, alarm_heap_entry_t *alarm)
+{
+    const uint8_t index = alarm->heap_index;
+    alarm_heap_entry_t *last = h->heap[--h->heap_size];
+
+    alarm->heap_index = ALARM_HEAP_OFF;
+    if (last != alarm) {
+        alarm_heap_store(h, index, last);
+        alarm_heap_sift_up(h, index);
+        alarm_heap_sift_down(h, last->heap_index);
+    }
+}
+
+/// Schedules the alarm after the current time, and adds it to the heap unless it is off
+static void alarm_heap_schedule(alarm_heap_t *h, alarm_heap_entry_t *alarm)
+{
+    const bool on = (ALARM_HEAP_TIMED != alarm->freq || alarm->time.hour < 24);
+
+    if (ALARM_HEAP_OFF != alarm->heap_index) {
+        alarm_heap_remove(h, alarm);
+    }
+    if (on) {
+        alarm->next_sec = h->now_sec + alarm_heap_secs_until(h, alarm);
+        alarm_heap_store(h, h->heap_size++, alarm);
+        alarm_heap_sift_up(h, alarm->heap_index);
+    }
+}
+
+void alarm_heap_init(alarm_heap_t *h, alarm_time_t now)
+{
+    h->num_alarms = 0;
+    h->heap_size = 0;
+    h->now_sec = 0;
+    h->now_sod = alarm_heap_sod(now);
+}
+
+void alarm_heap_set_now(alarm_heap_t *h, alarm_time_t now)
+{
+    const uint32_t sod = alarm_heap_sod(now);
+    h->now_sec += (sod + SECONDS_PER_DAY - h->now_sod) % SECONDS_PER_DAY;
+    h->now_sod = sod;
+}
+
+void alarm_heap_resync(alarm_heap_t *h, alarm_time_t now)
+{
+    uint8_t i = 0;
+
+    /* The seconds counter keeps counting, only the time of the day changes */
+    h->now_sod = alarm_heap_sod(now);
+    for (i = 0; i < h->heap_size; i++) {
+        h->heap[i]->next_sec = h->now_sec + alarm_heap_secs_until(h, h->heap[i]);
+    }
+
+    /* Every alarm may have moved, so build the heap again */
+    for (i = h->heap_size / 2; i > 0; i--) {
+        alarm_heap_sift_down(h, i - 1);
+    }
+}
+
+alarm_heap_entry_t* alarm_heap_add(alarm_heap_t *h, uint8_t freq, alarm_time_t time, void *signal)
+{
+    if (h->num_alarms >= ALARM_HEAP_MAX_ALARMS) {
+        return NULL;
+    }
+
+    alarm_heap_entry_t *alarm = &h->alarms[h->num_alarms++];
+    alarm->time = time;
+    alarm->freq = freq;
+    alarm->heap_index = ALARM_HEAP_OFF;
+    alarm->signal = signal;
+    alarm_heap_schedule(h, alarm);
+
+    return alarm;
+}
+
+void alarm_heap_set_time(alarm_heap_t *h, alarm_heap_entry_t *alarm, alarm_time_t time)
+{
+    alarm->time = time;
+    alarm_heap_schedule(h, alarm);
+}
+
+alarm_heap_entry_t* alarm_heap_get_due(alarm_heap_t *h)
+{
+    alarm_heap_entry_t *alarm = (h->heap_size > 0) ? h->heap[0] : NULL;
+
+    if (NULL == alarm || (int32_t)(alarm->next_sec - h->now_sec) > 0) {
+        return NULL;
+    }
+
+    /* Every alarm fires again, so schedule it and move it down the heap */
+    alarm->next_sec = h->now_sec + alarm_heap_secs_until(h, alarm);
+    alarm_heap_sift_down(h, 0);
+
+    return alarm;
+}
+
+bool alarm_heap_get_next(const alarm_heap_t *h, alarm_time_t *next)
+{
+    if (0 == h->heap_size) {
+        return false;
+    }
+
+    const uint32_t sod = (h->now_sod + (h->heap[0]->next_sec - h->now_sec)) % SECONDS_PER_DAY;
+    next->hour = sod / 3600;
+    next->min = (sod / 60) % 60;
+    next->sec = sod % 60;
+    return true;
+}
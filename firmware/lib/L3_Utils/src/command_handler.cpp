@@ -18,6 +18,7 @@
 
 #include <stdio.h>
 #include <string.h> // strlen()
+#include <ctype.h>  // tolower()
 #include "command_handler.hpp"
 
 
@@ -31,7 +32,95 @@ static const char* const COMMAND_FAILURE_HELP   = "Command failed!  Command's he
 static const char* const NO_HELP_STR_PTR        = "";
 
 
-void CommandProcessor::addHandler(CmdHandlerFuncPtr pFunc, const char* pPersistantCmdStr,
+CommandProcessor::CommandProcessor(int numCmds)
+{
+    if (numCmds < 1) {
+        numCmds = 1;
+    }
+    else if (numCmds > 0x3FFF) {
+        numCmds = 0x3FFF;
+    }
+    init(new CmdProcessorType[numCmds], numCmds, new CmdTrieNode[numCmds * 4], numCmds * 4);
+    mOwnsMemory = true;
+}
+
+CommandProcessor::CommandProcessor(CmdProcessorType *pHandlers, uint16_t maxCmds,
+                                   CmdTrieNode *pTrie, uint16_t maxTrieNodes)
+{
+    init(pHandlers, maxCmds, pTrie, maxTrieNodes);
+}
+
+CommandProcessor::~CommandProcessor()
+{
+    if (mOwnsMemory) {
+        delete [] mpHandlers;
+        delete [] mpTrie;
+    }
+}
+
+void CommandProcessor::init(CmdProcessorType *pHandlers, uint16_t maxCmds, CmdTrieNode *pTrie, uint16_t maxTrieNodes)
+{
+    const CmdTrieNode root = { 0, 0, 0, 0, '\0' };
+
+    mpHandlers = pHandlers;
+    mpTrie = pTrie;
+    mNumCmds = 0;
+    mMaxCmds = maxCmds;
+    mMaxTrieNodes = maxTrieNodes;
+    mOwnsMemory = false;
+    mEnShortCmds = true;
+
+    mpTrie[0] = root;
+    mNumTrieNodes = 1;
+}
+
+bool CommandProcessor::makeRoom(const char* pCmdStr)
+{
+    /* One node is added for each character after the prefix that is already in the trie */
+    uint16_t node = 0;
+    for ( ; *pCmdStr; pCmdStr++)
+    {
+        const char c = tolower(*pCmdStr);
+        uint16_t child = mpTrie[node].child;
+        while (0 != child && c != mpTrie[child].c) {
+            child = mpTrie[child].sibling;
+        }
+        if (0 == child) {
+            break;
+        }
+        node = child;
+    }
+    const unsigned int nodesNeeded = mNumTrieNodes + strlen(pCmdStr);
+
+    if (mNumCmds < mMaxCmds && nodesNeeded <= mMaxTrieNodes) {
+        return true;
+    }
+    if (!mOwnsMemory || nodesNeeded > 0xFFFF || mNumCmds >= 0xFFFF) {
+        return false;
+    }
+
+    if (mNumCmds >= mMaxCmds)
+    {
+        const uint16_t maxCmds = (mMaxCmds > 0x7FFF) ? 0xFFFF : (mMaxCmds * 2);
+        CmdProcessorType *pHandlers = new CmdProcessorType[maxCmds];
+        memcpy(pHandlers, mpHandlers, mNumCmds * sizeof(*pHandlers));
+        delete [] mpHandlers;
+        mpHandlers = pHandlers;
+        mMaxCmds = maxCmds;
+    }
+    if (nodesNeeded > mMaxTrieNodes)
+    {
+        const uint16_t maxNodes = (nodesNeeded > 0x7FFF) ? 0xFFFF : (nodesNeeded * 2);
+        CmdTrieNode *pTrie = new CmdTrieNode[maxNodes];
+        memcpy(pTrie, mpTrie, mNumTrieNodes * sizeof(*pTrie));
+        delete [] mpTrie;
+        mpTrie = pTrie;
+        mMaxTrieNodes = maxNodes;
+    }
+    return true;
+}
+
+bool CommandProcessor::addHandler(CmdHandlerFuncPtr pFunc, const char* pPersistantCmdStr,
                                   const char* pPersistentCmdHelpStr,  void* pDataParam)
 {
     CmdProcessorType handler;
@@ -43,9 +132,71 @@ void CommandProcessor::addHandler(CmdHandlerFuncPtr pFunc, const char* pPersista
     if (0 == handler.pCmdHelpText) {
         handler.pCmdHelpText = NO_HELP_STR_PTR;
     }
-    if (0 != handler.pCommandStr && 0 != handler.pFunc) {
-        mCmdHandlerVector += handler;
+    if (0 == handler.pCommandStr || 0 == handler.pFunc || !makeRoom(handler.pCommandStr)) {
+        return false;
+    }
+
+    mpHandlers[mNumCmds++] = handler;
+    addToTrie(handler.pCommandStr, mNumCmds);
+    return true;
+}
+
+void CommandProcessor::addToTrie(const char* pCmdStr, uint16_t handlerNum)
+{
+    uint16_t node = 0;
+
+    for ( ; *pCmdStr; pCmdStr++)
+    {
+        const char c = tolower(*pCmdStr);
+        uint16_t child = mpTrie[node].child;
+        while (0 != child && c != mpTrie[child].c) {
+            child = mpTrie[child].sibling;
+        }
+
+        /* New node is linked at the front of the children of this node */
+        if (0 == child)
+        {
+            const CmdTrieNode n = { 0, mpTrie[node].child, 0, handlerNum, c };
+            child = mNumTrieNodes++;
+            mpTrie[child] = n;
+            mpTrie[node].child = child;
+        }
+        node = child;
+    }
+
+    /* If the same command is added twice, the first one is used */
+    if (0 == mpTrie[node].exact) {
+        mpTrie[node].exact = handlerNum;
+    }
+}
+
+CommandProcessor::CmdProcessorType* CommandProcessor::findHandler(const str_view& cmdName, bool allowShortCmd)
+{
+    uint16_t node = 0;
+
+    for (int i = 0; i < cmdName.getLen(); i++)
+    {
+        const char c = tolower(cmdName[i]);
+        node = mpTrie[node].child;
+        while (0 != node && c != mpTrie[node].c) {
+            node = mpTrie[node].sibling;
+        }
+        if (0 == node) {
+            return NULL;
+        }
     }
+
+    /**
+     * Short-hand command needs at least two characters:
+     *      - Registered command may be "thermostat", when input is "th" or "th on"
+     *      - So accept this command as shorthand command
+     */
+    uint16_t handlerNum = mpTrie[node].exact;
+    if (0 == handlerNum && allowShortCmd && cmdName.getLen() >= 2) {
+        handlerNum = mpTrie[node].first;
+    }
+
+    return (0 == handlerNum) ? NULL : &mpHandlers[handlerNum - 1];
 }
 
 bool CommandProcessor::handleCommand(str& cmd, CharDev& output)
@@ -54,7 +205,7 @@ bool CommandProcessor::handleCommand(str& cmd, CharDev& output)
     cmd.trimEnd("\r\n");
 
     // Note: HELP command cannot simply have a handler because this static handler
-    //       will not be able to access the vector of commands
+    //       will not be able to access the list of commands
     if(cmd.beginsWithWholeWordIgnoreCase(HELP_STR))
     {
         prepareCmdParam(cmd, HELP_STR);
@@ -63,55 +214,23 @@ bool CommandProcessor::handleCommand(str& cmd, CharDev& output)
     }
     else
     {
-        unsigned int i=0;
-        for(i=0; i < mCmdHandlerVector.size(); i++)
-        {
-            CmdProcessorType &cp = mCmdHandlerVector[i];
-
-            // If a command matches, return the response from the attached function pointer
-            if(cmd.beginsWithWholeWordIgnoreCase(cp.pCommandStr))
-            {
-                prepareCmdParam(cmd, cp.pCommandStr);
-                if (!cp.pFunc(cmd, output, cp.pDataParam)) {
-                    output.putline(COMMAND_FAILURE_HELP);
-                    output.putline(cp.pCmdHelpText);
-                }
-                found = true;
-                break;
-            }
+        // The command name is the first word of the input
+        str_view cmdName(cmd);
+        const int space = cmdName.firstIndexOf(' ');
+        if (space >= 0) {
+            cmdName = cmdName.subView(0, space);
         }
 
-        /**
-         * If command not matched, try to partially match a command.
-         * ie: If command is "magic", match "m" as command
-         */
-        if(!found)
+        // If a command matches, return the response from the attached function pointer
+        CmdProcessorType *pCp = findHandler(cmdName, mEnShortCmds);
+        if (NULL != pCp)
         {
-            for(i=0; i < mCmdHandlerVector.size(); i++)
-            {
-                CmdProcessorType &cp = mCmdHandlerVector[i];
-                STR_ON_STACK(regCmd, 32);
-                regCmd = cp.pCommandStr;  /* Set to the command text */
-
-                /**
-                 * Check here if pCommandStr contains partial command :
-                 *      - regCmd may be "thermostat", when input is "th" or "th on"
-                 *      - So accept this command as shorthand command
-                 */
-                char shortCmd[8] = { 0 };
-                cmd.scanf("%7s ", shortCmd);
-                if(strlen(shortCmd) >= 2 && regCmd.beginsWithIgnoreCase(shortCmd))
-                {
-                    prepareCmdParam(cmd, cp.pCommandStr);
-                    if (!cp.pFunc(cmd, output, cp.pDataParam)) {
-                        output.putline(COMMAND_FAILURE_HELP);
-                        output.putline(cp.pCmdHelpText);
-                    }
-
-                    found = true;
-                    break;
-                }
+            prepareCmdParam(cmd, pCp->pCommandStr);
+            if (!pCp->pFunc(cmd, output, pCp->pDataParam)) {
+                output.putline(COMMAND_FAILURE_HELP);
+                output.putline(pCp->pCmdHelpText);
             }
+            found = true;
         }
 
         if(!found)
@@ -128,9 +247,9 @@ void CommandProcessor::getRegisteredCommandList(CharDev& output)
     output.put(SUPPORTED_COMMANDS_STR);
     char *ptr = NULL;
 
-    for(unsigned int i=0; i<mCmdHandlerVector.size(); i++)
+    for(unsigned int i=0; i<mNumCmds; i++)
     {
-        CmdProcessorType& c = mCmdHandlerVector[i];
+        CmdProcessorType& c = mpHandlers[i];
         if (strlen(c.pCmdHelpText) > 32) {
             sprintf(buffer, "\n %10s : %.32s ...", c.pCommandStr, c.pCmdHelpText);
 
@@ -153,16 +272,13 @@ void CommandProcessor::getHelpText(str& helpForCmd, CharDev& output)
     // where this parameter itself is a command name
     if(helpForCmd.getLen() > 0)
     {
-        for(unsigned int i=0; i < mCmdHandlerVector.size(); i++)
+        const CmdProcessorType *pCp = findHandler(str_view(helpForCmd), false);
+        if (NULL != pCp)
         {
-            CmdProcessorType &cp = mCmdHandlerVector[i];
-            if(helpForCmd.compareToIgnoreCase(cp.pCommandStr))
-            {
-                const char* out = (0 == cp.pCmdHelpText || '\0' == cp.pCmdHelpText[0]) ?
-                                    NO_HELP_STR : cp.pCmdHelpText;
-                output.putline(out);
-                return;
-            }
+            const char* out = (0 == pCp->pCmdHelpText || '\0' == pCp->pCmdHelpText[0]) ?
+                                NO_HELP_STR : pCp->pCmdHelpText;
+            output.putline(out);
+            return;
         }
         output.putline(CMD_INVALID_STR);
     }
@@ -17,17 +17,20 @@
  */
 
 #include <stdlib.h>   // malloc()
-#include <stdio.h>    // sprintf()
+#include <stdio.h>    // printf()
 #include <string.h>   // strlen()
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 #include "FreeRTOS.h"
-#include "queue.h"
+#include "semphr.h"
 #include "task.h"
 
 #include "file_logger.h"
+#include "log_binary.h"
+#include "log_ring.h"
+#include "stream_printf.h"
 #include "lpc_sys.h"
 #include "rtc.h"
 #include "ff.h"
@@ -38,14 +41,34 @@
 static FIL *gp_file_ptr = NULL;                     ///< The pointer to the file object
 #endif
 
+/* A message needs to fit in an empty ring even if it has to wrap around to the start of the ring */
+#if ((FILE_LOGGER_TASK_BUFFER_SIZE & (FILE_LOGGER_TASK_BUFFER_SIZE - 1)) || \
+     (2 * (FILE_LOGGER_LOG_MSG_MAX_LEN + LOG_RING_HEADER_SIZE + LOG_RING_ALIGN) > FILE_LOGGER_TASK_BUFFER_SIZE))
+#error "FILE_LOGGER_TASK_BUFFER_SIZE must be a power of 2, and more than twice FILE_LOGGER_LOG_MSG_MAX_LEN"
+#endif
+
+/// The ring of log messages of a task
+typedef struct {
+    TaskHandle_t task;  ///< The task that owns the ring, and the only one that writes to it
+    log_ring_t ring;    ///< The log messages that the logger task reads from
+} logger_task_ring_t;
+
 static uint16_t g_blocked_calls = 0;                ///< Number of logging calls that blocked
-static uint16_t g_buffer_watermark = 0;             ///< The watermark of the number of buffers consumed
+static uint32_t g_dropped_calls = 0;                ///< Number of logging calls dropped because the ring was full
+static uint16_t g_buffer_watermark = 0;             ///< The watermark of the number of messages gathered at once
 static uint16_t g_highest_file_write_time = 0;      ///< Highest time spend while trying to write file buffer
 static char * gp_file_buffer = NULL;                ///< Pointer to local buffer space before it is written to file
-static QueueHandle_t g_write_buffer_queue = NULL;   ///< Log message pointers are written to this queue
-static QueueHandle_t g_empty_buffer_queue = NULL;   ///< Log message pointers are available from this queue
 static uint32_t g_logger_calls[log_last] = { 0 };   ///< Number of logged messages of each severity
 
+static TaskHandle_t g_logger_task = NULL;           ///< The logger task, notified when a message is logged
+static volatile bool g_flush_requested = false;     ///< Set to make the logger task write the partial buffer
+static uint32_t g_log_seq = 0;                      ///< Sequence number of the next message across all rings
+static logger_task_ring_t g_task_rings[FILE_LOGGER_MAX_TASKS];  ///< Rings owned by a task
+static uint32_t g_num_task_rings = 0;               ///< Number of g_task_rings in use
+static log_ring_t g_shared_ring;                    ///< Ring shared by tasks that did not get their own ring
+static SemaphoreHandle_t g_shared_ring_mutex = NULL;///< Protects the producer side of g_shared_ring
+static char g_direct_msg[FILE_LOGGER_LOG_MSG_MAX_LEN];  ///< Message buffer used when the OS is not running
+
 /**
  * Chooses severity levels that are printed on stdio and logged
  * By default, the debug log will be printed to stdio
@@ -116,58 +139,209 @@ static bool logger_write_to_file(const void * buffer, const uint32_t bytes_to_wr
 }
 
 /**
- * @returns a logger buffer pointer
- * @param [in] os_running If FreeRTOS is running, this will grab from the queue while potentially blocking
- *             otherwise it will return a buffer pointer without blocking since buffer will always be
- *             available if OS is not running since no multi-threaded operation is going on.
+ * @returns the ring of the calling task, allocating one the first time the task logs,
+ *          or the shared ring if the task cannot have its own ring.
  */
-static char * logger_get_buffer_ptr(const bool os_running)
+static log_ring_t * logger_get_task_ring(void)
+{
+    const TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    const uint32_t num_rings = __atomic_load_n(&g_num_task_rings, __ATOMIC_ACQUIRE);
+    log_ring_t * ring = &g_shared_ring;
+    uint32_t i = 0;
+
+    for (i = 0; i < num_rings; i++) {
+        if (task == g_task_rings[i].task) {
+            return &g_task_rings[i].ring;
+        }
+    }
+
+    /* Memory is allocated outside of the critical section, and freed if all rings were taken meanwhile */
+    void * mem = (num_rings < FILE_LOGGER_MAX_TASKS) ? malloc(FILE_LOGGER_TASK_BUFFER_SIZE) : NULL;
+    if (NULL != mem)
+    {
+        taskENTER_CRITICAL();
+        i = g_num_task_rings;
+        if (i < FILE_LOGGER_MAX_TASKS) {
+            g_task_rings[i].task = task;
+            log_ring_init(&g_task_rings[i].ring, mem, FILE_LOGGER_TASK_BUFFER_SIZE);
+            ring = &g_task_rings[i].ring;
+            mem = NULL;
+
+            /* Publish the ring to the logger task only after it is initialized */
+            __atomic_store_n(&g_num_task_rings, i + 1, __ATOMIC_RELEASE);
+        }
+        taskEXIT_CRITICAL();
+        free(mem);
+    }
+
+    return ring;
+}
+
+/**
+ * @returns a logger buffer pointer to write the log message to, or NULL if the message is dropped
+ * @param [in]  os_running If FreeRTOS is running, this will reserve space in the ring of the task, otherwise
+ *              it will return a buffer pointer without blocking since no multi-threaded operation is going on.
+ * @param [out] ring  The ring to pass to logger_write_log_message(), or NULL if the OS is not running
+ */
+static char * logger_get_buffer_ptr(const bool os_running, log_ring_t ** ring)
 {
     char * buffer = NULL;
 
-    /* Get an available buffer to write the data to, and if OS is not running, we will always get a buffer */
     if (!os_running) {
-        xQueueReceive(g_empty_buffer_queue, &buffer, 0);
+        *ring = NULL;
+        return g_direct_msg;
+    }
+
+    *ring = logger_get_task_ring();
+    if (&g_shared_ring == *ring) {
+        xSemaphoreTake(g_shared_ring_mutex, portMAX_DELAY);
     }
-    else if (!xQueueReceive(g_empty_buffer_queue, &buffer, OS_MS(FILE_LOGGER_BLOCK_TIME_MS))) {
+
+    if (NULL == (buffer = log_ring_reserve(*ring, FILE_LOGGER_LOG_MSG_MAX_LEN)))
+    {
+#if (FILE_LOGGER_DROP_WHEN_FULL)
+        ++g_dropped_calls;
+        if (&g_shared_ring == *ring) {
+            xSemaphoreGive(g_shared_ring_mutex);
+        }
+#else
         ++g_blocked_calls;
 
-        /* This time, just block forever until we get a buffer */
-        xQueueReceive(g_empty_buffer_queue, &buffer, portMAX_DELAY);
+        /* Sleep until the logger task frees some space */
+        do {
+            xTaskNotifyGive(g_logger_task);
+            vTaskDelay(1);
+        } while (NULL == (buffer = log_ring_reserve(*ring, FILE_LOGGER_LOG_MSG_MAX_LEN)));
+#endif
     }
 
     return buffer;
 }
 
 /**
- * Writes the buffer pointer to either file buffer, or directly to file if OS is not running
- * @param [in] buffer The buffer pointer to write
- * @param [in] os_running If OS is running, it will just queue the pointer, and not write directly to the file.
+ * @returns the number of bytes of the log message to write to the file
+ * @param [in] log_msg  The log message; text messages get the newline appended here
+ *                      since the logging call does not know the length without strlen()
+ */
+static size_t logger_prepare_msg(char * log_msg)
+{
+#if (FILE_LOGGER_BINARY)
+    /* First byte of a binary record is its length */
+    return (uint8_t) log_msg[0];
+#else
+    size_t len = strlen(log_msg);
+    log_msg[len] = '\n';
+    log_msg[++len] = '\0';
+    return len;
+#endif
+}
+
+/**
+ * Takes the timestamp of a log message along with its sequence number.  The logger task writes
+ * the messages of all the rings in the order of their sequence number, so both are taken in the
+ * same critical section to keep the file in the order of the timestamps.  This is called after
+ * the buffer is reserved, such that a call that blocked for space does not hold back its number
+ * while the other tasks log after it.
+ * @returns the sequence number to pass to logger_write_log_message()
+ * @param [in]  os_running If FreeRTOS is running; otherwise the message is written directly
+ *                         and does not need a sequence number
+ * @param [out] time       The RTC time of the message
+ * @param [out] uptime     The uptime of the message in milliseconds
  */
-static void logger_write_log_message(char * buffer, const bool os_running)
+static uint32_t logger_stamp_msg(const bool os_running, rtc_t * time, unsigned int * uptime)
 {
-    /* Send the buffer to the queue for the logger task to write */
-    if (os_running) {
-        xQueueSend(g_write_buffer_queue, &buffer, portMAX_DELAY);
+    uint32_t seq = 0;
+
+    if (!os_running) {
+        *time = rtc_gettime();
+        *uptime = sys_get_uptime_ms();
+        return 0;
     }
+
+    taskENTER_CRITICAL();
+    *time = rtc_gettime();
+    *uptime = sys_get_uptime_ms();
+    seq = __atomic_fetch_add(&g_log_seq, 1, __ATOMIC_RELAXED);
+    taskEXIT_CRITICAL();
+
+    return seq;
+}
+
+/**
+ * Commits the log message to the ring for the logger task, or writes it directly to file if OS is not running
+ * @param [in] buffer The buffer pointer from logger_get_buffer_ptr()
+ * @param [in] ring   The ring from logger_get_buffer_ptr()
+ * @param [in] seq    The sequence number of the message, @see logger_stamp_msg()
+ */
+static void logger_write_log_message(char * buffer, log_ring_t * ring, uint32_t seq)
+{
+    const size_t len = logger_prepare_msg(buffer);
+
     /* No logging task to write the data, so we need to do it ourselves */
-    else {
-        size_t len = strlen(buffer);
-        buffer[len] = '\n';
-        buffer[++len] = '\0';
+    if (NULL == ring) {
         logger_write_to_file(buffer, len);
+        return;
+    }
 
-        /* OS not running, so put the buffer back to the empty queue instead of write queue */
-        xQueueSend(g_empty_buffer_queue, &buffer, 0);
+    log_ring_commit(ring, len, seq);
+    if (&g_shared_ring == ring) {
+        xSemaphoreGive(g_shared_ring_mutex);
     }
+
+    xTaskNotifyGive(g_logger_task);
+}
+
+/**
+ * @returns the oldest log message of all the rings, or NULL if there are no messages
+ * @param [in,out] next_seq  The sequence number of the next message to write.  If the oldest message
+ *                           is after it, then a task took the number and is writing its message,
+ *                           so NULL is returned to wait for it, unless skip_gap is set.
+ * @param [in]  skip_gap  Set to write the oldest message even if a message before it was not committed
+ * @param [out] ring  The ring of the message to pop after the message is copied
+ * @param [out] len   The length of the message
+ */
+static const char * logger_get_oldest_msg(uint32_t * next_seq, const bool skip_gap, log_ring_t ** ring, uint32_t * len)
+{
+    const uint32_t num_rings = __atomic_load_n(&g_num_task_rings, __ATOMIC_ACQUIRE);
+    const char * oldest = NULL;
+    uint32_t oldest_seq = 0;
+    uint32_t i = 0;
+
+    /* The shared ring is checked last, at index num_rings */
+    for (i = 0; i <= num_rings; i++)
+    {
+        log_ring_t * r = (i < num_rings) ? &g_task_rings[i].ring : &g_shared_ring;
+        uint32_t msg_len = 0;
+        uint32_t seq = 0;
+        const char * msg = log_ring_peek(r, &msg_len, &seq);
+
+        if (NULL != msg && (NULL == oldest || log_ring_seq_before(seq, oldest_seq))) {
+            oldest = msg;
+            oldest_seq = seq;
+            *ring = r;
+            *len = msg_len;
+        }
+    }
+
+    if (NULL != oldest) {
+        if (!skip_gap && log_ring_seq_before(*next_seq, oldest_seq)) {
+            return NULL;
+        }
+        /* A message that was held back past skip_gap does not move the next number back */
+        if (!log_ring_seq_before(oldest_seq, *next_seq)) {
+            *next_seq = oldest_seq + 1;
+        }
+    }
+
+    return oldest;
 }
 
 /**
  * This is the actual FreeRTOS logger task responsible for:
- *      - Retrieve a log message written to the write queue
- *      - Copy it to our local buffer
+ *      - Wait until a log message is written to any of the rings
+ *      - Copy the messages of all rings to our local buffer in the order they were logged
  *      - If local buffer is full, write it to the file
- *      - Put-back the log message buffer to available queue
+ *      - Pop the log message to make the space available to the task that logged it
  */
 static void logger_task(void *p)
 {
@@ -178,77 +352,72 @@ static void logger_task(void *p)
     char * const start_ptr = gp_file_buffer;
     char * const end_ptr = start_ptr + FILE_LOGGER_BUFFER_SIZE;
 
-    char * log_msg = NULL;
+    const char * log_msg = NULL;
+    log_ring_t * ring = NULL;
     char * write_ptr = start_ptr;
-    size_t len = 0;
+    uint32_t len = 0;
+    uint32_t next_seq = 0;
+    uint16_t num_msgs = 0;
     size_t buffer_overflow_cnt = 0;
 
     while (1)
     {
-        /* Receive the log message we wish to write to our buffer.
-         * Timeout or NULL pointer received is the signal to flush the data.
+        /* Wait for a notification of a logged message.
+         * Timeout or a flush request is the signal to flush the data after gathering the messages.
          */
-        log_msg = NULL;
-        if (!xQueueReceive(g_write_buffer_queue, &log_msg, OS_MS(1000 * FILE_LOGGER_FLUSH_TIME_SEC)) ||
-            NULL == log_msg)
-        {
-            logger_write_to_file(start_ptr, (write_ptr - start_ptr));
-            write_ptr = start_ptr;
-            continue;
-        }
-
-        /* Update the watermark of the number of messages we see in the queue and note that we
-         * add one to account for the message we just dequeued.
-         */
-        if ((len = (1 + uxQueueMessagesWaiting(g_write_buffer_queue)) ) > g_buffer_watermark) {
-            g_buffer_watermark = len;
-        }
-
-        /* Get the length and append the newline character */
-        len = strlen(log_msg);
-        log_msg[len] = '\n';
-        log_msg[++len] = '\0';
+        const bool timeout = !ulTaskNotifyTake(pdTRUE, OS_MS(1000 * FILE_LOGGER_FLUSH_TIME_SEC));
 
-        /* This is test code to immediately write data to the file.  It is highly in-efficient and is
-         * included here just for reference or test purposes.
+        /* The producers never wait for us, so gather all of the messages that are available.
+         * A task that is writing a message with an earlier number notifies us when it commits,
+         * unless it was deleted in between, so the gap is skipped on the flush timeout.
          */
-        #if 0
+        num_msgs = 0;
+        while (NULL != (log_msg = logger_get_oldest_msg(&next_seq, timeout, &ring, &len)))
         {
-            logger_write_to_file(log_msg, len);
-            xQueueSend(g_empty_buffer_queue, &log_msg, portMAX_DELAY);
-            continue;
-        }
-        #endif
+            ++num_msgs;
 
-        /* If we will overflow our buffer we need to write the full buffer and do partial copy */
-        if (len + write_ptr >= end_ptr)
-        {
-            /* This could be zero when we write the last byte in the buffer */
-            buffer_overflow_cnt = (len + write_ptr - end_ptr);
+            /* If we will overflow our buffer we need to write the full buffer and do partial copy */
+            if (len + write_ptr >= end_ptr)
+            {
+                /* This could be zero when we write the last byte in the buffer */
+                buffer_overflow_cnt = (len + write_ptr - end_ptr);
 
-            /* Copy the partial message up until the end of the buffer */
-            memcpy(write_ptr, log_msg, (end_ptr - write_ptr));
+                /* Copy the partial message up until the end of the buffer */
+                memcpy(write_ptr, log_msg, (end_ptr - write_ptr));
 
-            /* Write the entire buffer to the file */
-            logger_write_to_file(start_ptr, (end_ptr - start_ptr));
+                /* Write the entire buffer to the file */
+                logger_write_to_file(start_ptr, (end_ptr - start_ptr));
 
-            /* Optional: Zero out the buffer space */
-            // memset(start_ptr, '\0', buffer_size);
+                /* Optional: Zero out the buffer space */
+                // memset(start_ptr, '\0', buffer_size);
 
-            /* Copy the left-over message to the start of "fresh" buffer space (after writing to the file) */
-            if (buffer_overflow_cnt > 0) {
-                memcpy(start_ptr, (log_msg + len - buffer_overflow_cnt), buffer_overflow_cnt);
+                /* Copy the left-over message to the start of "fresh" buffer space (after writing to the file) */
+                if (buffer_overflow_cnt > 0) {
+                    memcpy(start_ptr, (log_msg + len - buffer_overflow_cnt), buffer_overflow_cnt);
+                }
+                write_ptr = start_ptr + buffer_overflow_cnt;
+            }
+            /* Buffer has enough space, write the entire message to the buffer */
+            else {
+                memcpy(write_ptr, log_msg, len);
+                write_ptr += len;
             }
-            write_ptr = start_ptr + buffer_overflow_cnt;
+
+            /* Make the space available to the task that logged the message */
+            log_ring_pop(ring);
         }
-        /* Buffer has enough space, write the entire message to the buffer */
-        else {
-            memcpy(write_ptr, log_msg, len);
-            write_ptr += len;
+
+        /* Update the watermark of the number of messages that were waiting for us */
+        if (num_msgs > g_buffer_watermark) {
+            g_buffer_watermark = num_msgs;
         }
 
-        /* Put the data pointer back to the available buffers */
-        xQueueSend(g_empty_buffer_queue, &log_msg, portMAX_DELAY);
+        if (timeout || g_flush_requested)
+        {
+            g_flush_requested = false;
+            logger_write_to_file(start_ptr, (write_ptr - start_ptr));
+            write_ptr = start_ptr;
+        }
     }
 }
 
@@ -267,8 +436,6 @@ static bool logger_initialized(void)
  */
 static bool logger_internal_init(UBaseType_t logger_priority)
 {
-    uint32_t i = 0;
-    char * ptr = NULL;
     const bool success = true;
 
     /* Create the buffer space we write the logged messages to (before we flush it to the file) */
@@ -277,31 +444,14 @@ static bool logger_internal_init(UBaseType_t logger_priority)
         goto failure;
     }
 
-    /* Create the queues that keep track of the written buffers, and available buffers */
-    g_write_buffer_queue = xQueueCreate(FILE_LOGGER_NUM_BUFFERS, sizeof(char*));
-    g_empty_buffer_queue = xQueueCreate(FILE_LOGGER_NUM_BUFFERS, sizeof(char*));
-    if (NULL == g_write_buffer_queue || NULL == g_empty_buffer_queue) {
+    /* Create the ring for the tasks that do not get their own ring; task rings are created when a task logs */
+    log_ring_init(&g_shared_ring, malloc(FILE_LOGGER_TASK_BUFFER_SIZE), FILE_LOGGER_TASK_BUFFER_SIZE);
+    g_shared_ring_mutex = xSemaphoreCreateMutex();
+    if (NULL == g_shared_ring.buffer || NULL == g_shared_ring_mutex) {
         goto failure;
     }
 
-    vTraceSetQueueName(g_write_buffer_queue, "Logger WR-Q");
-    vTraceSetQueueName(g_empty_buffer_queue, "Logger EP-Q");
-
-    /* Create the actual buffers for log messages */
-    for (i = 0; i < FILE_LOGGER_NUM_BUFFERS; i++)
-    {
-        ptr = (char*) malloc(FILE_LOGGER_LOG_MSG_MAX_LEN);
-
-        if (NULL == ptr) {
-            goto failure;
-        }
-
-        /* DO NOT USE xQueueSendFromISR().
-         * It causes weird file write errors and corrupts the entire file system
-         * when the logger task is running.
-         */
-        xQueueSend(g_empty_buffer_queue, &ptr, 0);
-    }
+    vTraceSetMutexName(g_shared_ring_mutex, "Logger Ring");
 
 #if (FILE_LOGGER_KEEP_FILE_OPEN)
     gp_file_ptr = malloc (sizeof(*gp_file_ptr));
@@ -315,7 +465,7 @@ static bool logger_internal_init(UBaseType_t logger_priority)
     logger_priority |= portPRIVILEGE_BIT;
 #endif
 
-    if (!xTaskCreate(logger_task, "logger", FILE_LOGGER_STACK_SIZE, NULL, logger_priority, NULL))
+    if (!xTaskCreate(logger_task, "logger", FILE_LOGGER_STACK_SIZE, NULL, logger_priority, &g_logger_task))
     {
         goto failure;
     }
@@ -329,17 +479,11 @@ static bool logger_internal_init(UBaseType_t logger_priority)
             gp_file_buffer = NULL;
         }
 
-        if (g_empty_buffer_queue) {
-            for (i = 0; i < FILE_LOGGER_NUM_BUFFERS; i++) {
-                if (xQueueReceive(g_empty_buffer_queue, &ptr, 0)) {
-                    free (ptr);
-                }
-            }
+        if (g_shared_ring.buffer) {
+            free(g_shared_ring.buffer);
+            g_shared_ring.buffer = NULL;
         }
 
-        /* Delete g_write_buffer_queue */
-        /* Delete g_empty_buffer_queue */
-
         return (!success);
 }
 
@@ -347,8 +491,8 @@ void logger_send_flush_request(void)
 {
     if (taskSCHEDULER_RUNNING == xTaskGetSchedulerState() && logger_initialized())
     {
-        char * null_ptr_to_flush = NULL;
-        xQueueSend(g_write_buffer_queue, &null_ptr_to_flush, portMAX_DELAY);
+        g_flush_requested = true;
+        xTaskNotifyGive(g_logger_task);
     }
 }
 
@@ -372,6 +516,11 @@ uint16_t logger_get_num_buffers_watermark(void)
     return g_buffer_watermark;
 }
 
+uint32_t logger_get_dropped_call_count(void)
+{
+    return g_dropped_calls;
+}
+
 void logger_init(uint8_t logger_priority)
 {
     /* Prevent double init */
@@ -401,11 +550,12 @@ void logger_log(logger_msg_t type, const char * filename, const char * func_name
         return;
     }
 
-    uint32_t len = 0;
     char * buffer = NULL;
     char * temp_ptr = NULL;
-    const rtc_t time = rtc_gettime();
-    const unsigned int uptime = sys_get_uptime_ms();
+    log_ring_t * ring = NULL;
+    rtc_t time;
+    unsigned int uptime = 0;
+    uint32_t seq = 0;
     const bool os_running = (taskSCHEDULER_RUNNING == xTaskGetSchedulerState());
 
     /* This must match up with the logger_msg_t enumeration */
@@ -426,9 +576,39 @@ void logger_log(logger_msg_t type, const char * filename, const char * func_name
         func_name = "";
     }
 
-    /* Get an available buffer */
-    buffer = logger_get_buffer_ptr(os_running);
+    /* Get an available buffer, and then stamp the message in the order that it is committed */
+    if (NULL == (buffer = logger_get_buffer_ptr(os_running, &ring))) {
+        return;
+    }
+    seq = logger_stamp_msg(os_running, &time, &uptime);
+
+#if (FILE_LOGGER_BINARY)
+    /* Store the raw arguments, and only format them if they are printed */
+    do {
+        const log_binary_header_t header = { type, line_num,
+                                             log_binary_pack_time(time.month, time.day, time.hour, time.min, time.sec),
+                                             uptime, (filename[0] ? filename : NULL), (func_name[0] ? func_name : NULL) };
+        va_list args;
+        va_start(args, msg);
+        log_binary_vencode(buffer, FILE_LOGGER_LOG_MSG_MAX_LEN, &header, msg, args);
+        va_end(args);
+    } while (0);
+
+    if (g_logger_printf_mask & (1 << type)) {
+        va_list args;
+        printf("%d/%d,%02d:%02d:%02d,%u,%s,%s,%s%s,%u,",
+               (int)time.month, (int)time.day, (int)time.hour, (int)time.min, (int)time.sec, uptime,
+               type_str[type], filename, func_name, (func_name[0] ? "()" : ""), line_num);
+        va_start(args, msg);
+        vprintf(msg, args);
+        va_end(args);
+        putchar('\n');
+    }
 
+    ++g_logger_calls[type];
+    logger_write_log_message(buffer, ring, seq);
+#else
+    uint32_t len = 0;
     do {
         int mon = time.month;
         int day = time.day;
@@ -440,13 +620,16 @@ void logger_log(logger_msg_t type, const char * filename, const char * func_name
         const char *func_parens  = func_name[0] ? "()" : "";
 
         /* Write the header including time, filename, function name etc */
-        len = sprintf(buffer, "%d/%d,%02d:%02d:%02d,%u,%s,%s,%s%s,%u,",
-                      mon, day, hr, min, sec, up, log_type_str, filename, func_name, func_parens, line_num);
+        len = stream_snprintf(buffer, FILE_LOGGER_LOG_MSG_MAX_LEN - 1, "%d/%d,%02d:%02d:%02d,%u,%s,%s,%s%s,%u,",
+                              mon, day, hr, min, sec, up, log_type_str, filename, func_name, func_parens, line_num);
+        if (len > FILE_LOGGER_LOG_MSG_MAX_LEN - 1) {
+            len = FILE_LOGGER_LOG_MSG_MAX_LEN - 1;
+        }
     } while (0);
 
-    /* Append actual user message, and leave one space for \n to be appended by the logger task.
+    /* Append actual user message, and leave one space for \n to be appended by logger_prepare_msg().
      * There is no efficient way to append \n here since we will have to use strlen(),
-     * but since the logger task will take strlen() anyway, it can append it there.
+     * but since logger_prepare_msg() will take strlen() anyway, it can append it there.
      *
      * Example: max length = 10, and say we printed 5 chars so far "hello"
      *          we will sprintf "world" to "hello" where n = 10-5-1 = 4
@@ -460,17 +643,18 @@ void logger_log(logger_msg_t type, const char * filename, const char * func_name
     do {
         va_list args;
         va_start(args, msg);
-        vsnprintf(buffer + len, FILE_LOGGER_LOG_MSG_MAX_LEN-len-1, msg, args);
+        stream_vsnprintf(buffer + len, FILE_LOGGER_LOG_MSG_MAX_LEN-len-1, msg, args);
         va_end(args);
     } while (0);
 
-    ++g_logger_calls[type];
-    logger_write_log_message(buffer, os_running);
-
-    /* Print the message out if the printf mask was set */
+    /* Print the message out if the printf mask was set (before the buffer is given to the logger task) */
     if (g_logger_printf_mask & (1 << type)) {
         puts(buffer);
     }
+
+    ++g_logger_calls[type];
+    logger_write_log_message(buffer, ring, seq);
+#endif
 }
 
 void logger_log_raw(const char * msg, ...)
@@ -480,15 +664,26 @@ void logger_log_raw(const char * msg, ...)
     }
 
     const bool os_running = (taskSCHEDULER_RUNNING == xTaskGetSchedulerState());
-    char * buffer = logger_get_buffer_ptr(os_running);
+    log_ring_t * ring = NULL;
+    char * buffer = logger_get_buffer_ptr(os_running, &ring);
+
+    if (NULL == buffer) {
+        return;
+    }
+    const uint32_t seq = os_running ? __atomic_fetch_add(&g_log_seq, 1, __ATOMIC_RELAXED) : 0;
 
     /* Print the actual user message to the buffer */
     do {
         va_list args;
         va_start(args, msg);
-        vsnprintf(buffer, FILE_LOGGER_LOG_MSG_MAX_LEN-1, msg, args);
+#if (FILE_LOGGER_BINARY)
+        const log_binary_header_t header = { LOG_BINARY_RAW_TYPE, 0, 0, 0, NULL, NULL };
+        log_binary_vencode(buffer, FILE_LOGGER_LOG_MSG_MAX_LEN, &header, msg, args);
+#else
+        stream_vsnprintf(buffer, FILE_LOGGER_LOG_MSG_MAX_LEN-1, msg, args);
+#endif
         va_end(args);
     } while (0);
 
-    logger_write_log_message(buffer, os_running);
+    logger_write_log_message(buffer, ring, seq);
 }
@@ -0,0 +1,251 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>
+
+#include "heap_profiler.h"
+
+
+
+#define HEAP_PROF_ALLOC_MASK    (HEAP_PROF_MAX_ALLOCS - 1)
+#define HEAP_PROF_SITE_MASK     (HEAP_PROF_MAX_SITES - 1)
+#define HEAP_PROF_OTHER_TASK    (HEAP_PROF_MAX_TASKS - 1)   ///< Index of the task of all tasks that did not fit
+#define HEAP_PROF_OTHER_SITE    (HEAP_PROF_MAX_SITES)       ///< Index of the site of all sites that did not fit
+
+/// @returns the hash of a pointer; allocations are at least 8 byte aligned, and code is 2 byte aligned
+static inline uint32_t heap_prof_hash(const void *ptr, uint32_t shift)
+{
+    return (uint32_t)(((uintptr_t)ptr >> shift) * 2654435761u);
+}
+
+static inline void heap_prof_lock(const heap_prof_t *prof)
+{
+    if (prof->provider->lock) {
+        prof->provider->lock();
+    }
+}
+
+static inline void heap_prof_unlock(const heap_prof_t *prof)
+{
+    if (prof->provider->unlock) {
+        prof->provider->unlock();
+    }
+}
+
+static inline void heap_prof_add_bytes(uint32_t *live, uint32_t *peak, uint32_t bytes)
+{
+    *live += bytes;
+    if (*live > *peak) {
+        *peak = *live;
+    }
+}
+
+/// @returns the index of the task, adding it if it is new
+static uint32_t heap_prof_get_task_index(heap_prof_t *prof, void *task)
+{
+    uint32_t i = 0;
+    for (i = 0; i < prof->task_count; i++) {
+        if (task == prof->task_handles[i]) {
+            return i;
+        }
+    }
+
+    if (prof->task_count >= HEAP_PROF_MAX_TASKS) {
+        return HEAP_PROF_OTHER_TASK;
+    }
+
+    i = prof->task_count++;
+    if (HEAP_PROF_OTHER_TASK == i) {
+        prof->task_handles[i] = (void*) prof;   /* Not a task, so only the search above ends here */
+        strncpy(prof->task_names[i], "other", HEAP_PROF_TASK_NAME_LEN - 1);
+    }
+    else {
+        prof->task_handles[i] = task;
+        strncpy(prof->task_names[i], task ? prof->provider->get_task_name(task) : "boot", HEAP_PROF_TASK_NAME_LEN - 1);
+    }
+    return i;
+}
+
+/// @returns the index of the site, adding it if it is new
+static uint32_t heap_prof_get_site_index(heap_prof_t *prof, const void *site)
+{
+    uint32_t i = heap_prof_hash(site, 1) >> (32 - __builtin_ctz(HEAP_PROF_MAX_SITES));
+    uint32_t probes = 0;
+
+    if (NULL == site) {
+        return HEAP_PROF_OTHER_SITE;
+    }
+
+    for (probes = 0; probes < HEAP_PROF_MAX_SITES; probes++, i = (i + 1) & HEAP_PROF_SITE_MASK) {
+        if (site == prof->sites[i].site) {
+            return i;
+        }
+        if (NULL == prof->sites[i].site) {
+            /* Keep one entry empty such that searches always end */
+            if (prof->site_count >= HEAP_PROF_MAX_SITES - 1) {
+                break;
+            }
+            prof->sites[i].site = site;
+            prof->site_count++;
+            return i;
+        }
+    }
+    return HEAP_PROF_OTHER_SITE;
+}
+
+/// @returns the index of the allocation of ptr, or of the empty entry where it would be
+static uint32_t heap_prof_find_alloc(const heap_prof_t *prof, const void *ptr)
+{
+    uint32_t i = heap_prof_hash(ptr, 3) >> (32 - __builtin_ctz(HEAP_PROF_MAX_ALLOCS));
+    while (NULL != prof->allocs[i].ptr && ptr != prof->allocs[i].ptr) {
+        i = (i + 1) & HEAP_PROF_ALLOC_MASK;
+    }
+    return i;
+}
+
+/// Removes the allocation at the index, and moves the entries after it that would not be found otherwise
+static void heap_prof_remove_alloc(heap_prof_t *prof, uint32_t i)
+{
+    uint32_t j = i;
+    for (;;) {
+        prof->allocs[i].ptr = NULL;
+        do {
+            j = (j + 1) & HEAP_PROF_ALLOC_MASK;
+            if (NULL == prof->allocs[j].ptr) {
+                return;
+            }
+            /* The entry at j can move to i if its home is not between i (exclusive) and j (inclusive) */
+            const uint32_t home = heap_prof_hash(prof->allocs[j].ptr, 3) >> (32 - __builtin_ctz(HEAP_PROF_MAX_ALLOCS));
+            if (((j - home) & HEAP_PROF_ALLOC_MASK) >= ((j - i) & HEAP_PROF_ALLOC_MASK)) {
+                break;
+            }
+        } while (1);
+        prof->allocs[i] = prof->allocs[j];
+        i = j;
+    }
+}
+
+void heap_prof_init(heap_prof_t *prof, const heap_prof_task_provider_t *provider)
+{
+    memset(prof, 0, sizeof(*prof));
+    prof->provider = provider;
+}
+
+void heap_prof_on_alloc(heap_prof_t *prof, const void *ptr, size_t size, const void *site)
+{
+    if (NULL == ptr) {
+        return;
+    }
+
+    /* The task is found before locking because its name may take a lock of its own */
+    void *task = prof->provider->get_task();
+
+    heap_prof_lock(prof);
+    if (prof->live_allocs >= (HEAP_PROF_MAX_ALLOCS * 3 / 4)) {
+        prof->untracked_allocs++;
+    }
+    else {
+        const uint32_t i = heap_prof_find_alloc(prof, ptr);
+        heap_prof_alloc_t *alloc = &prof->allocs[i];
+        alloc->ptr = ptr;
+        alloc->size = (uint32_t) size;
+        alloc->task = (uint8_t) heap_prof_get_task_index(prof, task);
+        alloc->site = (uint8_t) heap_prof_get_site_index(prof, site);
+        prof->live_allocs++;
+
+        heap_prof_add_bytes(&prof->live_bytes, &prof->peak_bytes, alloc->size);
+        prof->total_allocs++;
+        heap_prof_add_bytes(&prof->task_live_bytes[alloc->task], &prof->task_peak_bytes[alloc->task], alloc->size);
+        prof->task_allocs[alloc->task]++;
+        heap_prof_add_bytes(&prof->sites[alloc->site].live_bytes, &prof->sites[alloc->site].peak_bytes, alloc->size);
+        prof->sites[alloc->site].allocs++;
+    }
+    heap_prof_unlock(prof);
+}
+
+size_t heap_prof_on_free(heap_prof_t *prof, const void *ptr)
+{
+    size_t size = 0;
+    if (NULL == ptr) {
+        return size;
+    }
+
+    heap_prof_lock(prof);
+    const uint32_t i = heap_prof_find_alloc(prof, ptr);
+    const heap_prof_alloc_t alloc = prof->allocs[i];
+    if (NULL != alloc.ptr) {
+        size = alloc.size;
+        prof->live_bytes -= alloc.size;
+        prof->total_frees++;
+        prof->task_live_bytes[alloc.task] -= alloc.size;
+        prof->sites[alloc.site].live_bytes -= alloc.size;
+        prof->live_allocs--;
+        heap_prof_remove_alloc(prof, i);
+    }
+    heap_prof_unlock(prof);
+
+    return size;
+}
+
+uint32_t heap_prof_get_tasks(heap_prof_t *prof, heap_prof_task_t *tasks, uint32_t max)
+{
+    uint32_t i = 0;
+
+    heap_prof_lock(prof);
+    for (i = 0; i < prof->task_count && i < max; i++) {
+        tasks[i].task = (HEAP_PROF_OTHER_TASK == i) ? NULL : prof->task_handles[i];
+        memcpy(tasks[i].name, prof->task_names[i], HEAP_PROF_TASK_NAME_LEN);
+        tasks[i].live_bytes = prof->task_live_bytes[i];
+        tasks[i].peak_bytes = prof->task_peak_bytes[i];
+        tasks[i].allocs = prof->task_allocs[i];
+    }
+    heap_prof_unlock(prof);
+
+    return i;
+}
+
+/// @returns true if site a should be listed before site b
+static inline bool heap_prof_site_is_larger(const heap_prof_site_t *a, const heap_prof_site_t *b)
+{
+    return (a->live_bytes != b->live_bytes) ? (a->live_bytes > b->live_bytes) : (a->allocs > b->allocs);
+}
+
+uint32_t heap_prof_get_top_sites(heap_prof_t *prof, heap_prof_site_t *sites, uint32_t max)
+{
+    uint32_t count = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    /* Insertion sort of the few top sites while going through the table once */
+    heap_prof_lock(prof);
+    for (i = 0; i <= HEAP_PROF_MAX_SITES && max > 0; i++) {
+        const heap_prof_site_t *site = &prof->sites[i];
+        if (0 == site->allocs || (count == max && !heap_prof_site_is_larger(site, &sites[max - 1]))) {
+            continue;
+        }
+
+        j = (count < max) ? count++ : (max - 1);
+        for ( ; j > 0 && heap_prof_site_is_larger(site, &sites[j - 1]); j--) {
+            sites[j] = sites[j - 1];
+        }
+        sites[j] = *site;
+    }
+    heap_prof_unlock(prof);
+
+    return count;
+}
@@ -0,0 +1,478 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <stdio.h>    // snprintf()
+#include <string.h>   // memcpy(), strlen()
+
+#include "log_binary.h"
+
+
+
+/// Parsed printf() conversion specification such as "%-08.3lld"
+typedef struct {
+    const char *start;      ///< Pointer to the '%'
+    const char *end;        ///< Pointer after the conversion character
+    char conv;              ///< The conversion character such as 'd' or 's'
+    bool star_width;        ///< Width is an argument
+    bool star_precision;    ///< Precision is an argument
+    bool is_long;           ///< Length is 'l', 'z', or 't' (32-bit on ARM, but may be 64-bit on host)
+    bool is_long_long;      ///< Length is 'll', 'q', or 'j' (64-bit)
+    bool is_long_double;    ///< Length is 'L'
+} log_binary_spec_t;
+
+/**
+ * Finds the next conversion of the format string
+ * @param [in]  fmt   The format string pointer to search from
+ * @param [out] spec  The parsed conversion
+ * @returns false if there are no more conversions
+ */
+static bool log_binary_next_spec(const char *fmt, log_binary_spec_t *spec)
+{
+    const char *p = fmt;
+
+    while (*p)
+    {
+        if ('%' != *p) {
+            ++p;
+            continue;
+        }
+
+        memset(spec, 0, sizeof(*spec));
+        spec->start = p++;
+
+        while (*p && strchr("-+ #0", *p)) {
+            ++p;
+        }
+        if ('*' == *p) {
+            spec->star_width = true;
+            ++p;
+        }
+        while (*p >= '0' && *p <= '9') {
+            ++p;
+        }
+        if ('.' == *p) {
+            if ('*' == *++p) {
+                spec->star_precision = true;
+                ++p;
+            }
+            while (*p >= '0' && *p <= '9') {
+                ++p;
+            }
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            if ('l' == *p && 'l' == p[1]) {
+                spec->is_long_long = true;
+                ++p;
+            }
+            else {
+                spec->is_long_long |= ('j' == *p) || ('q' == *p);
+                spec->is_long |= ('l' == *p) || ('z' == *p) || ('t' == *p);
+                spec->is_long_double |= ('L' == *p);
+            }
+            ++p;
+        }
+
+        if ('\0' == *p) {
+            return false;
+        }
+
+        spec->conv = *p++;
+        spec->end = p;
+        return true;
+    }
+
+    return false;
+}
+
+/// @returns true if the conversion takes a double argument
+static inline bool log_binary_is_float_conv(char c)
+{
+    return (NULL != strchr("fFeEgGaA", c));
+}
+
+bool log_binary_is_const_str(const void *ptr)
+{
+#ifdef __arm__
+    /* Flash memory is below the SRAM at 0x10000000 */
+    return ((uint32_t) ptr < 0x10000000);
+#else
+    /* Code and read-only data of the host executable are before its data */
+    extern const char __executable_start[];
+    extern const char __data_start[];
+    const char *p = (const char*) ptr;
+    return (p >= __executable_start && p < __data_start);
+#endif
+}
+
+uint32_t log_binary_vencode(void *buffer, uint32_t size, const log_binary_header_t *header,
+                            const char *fmt, va_list args)
+{
+    uint8_t *rec = (uint8_t*) buffer;
+    uint32_t pos = 0;
+    uint32_t u32 = 0;
+    log_binary_spec_t spec;
+
+    if (size > 255) {
+        size = 255;
+    }
+    if (size < LOG_BINARY_HEADER_SIZE + 4) {
+        return 0;
+    }
+
+    /* Write the header */
+    do {
+        const uint32_t file = (uint32_t)(uintptr_t) header->filename;
+        const uint32_t func = (uint32_t)(uintptr_t) header->func_name;
+        rec[1] = header->type;
+        memcpy(&rec[2],  &header->line, 2);
+        memcpy(&rec[4],  &header->time, 4);
+        memcpy(&rec[8],  &header->uptime_ms, 4);
+        memcpy(&rec[12], &file, 4);
+        memcpy(&rec[16], &func, 4);
+        pos = LOG_BINARY_HEADER_SIZE;
+    } while (0);
+
+    /* Format string is stored by address unless it may change (such as in RAM) */
+    if (log_binary_is_const_str(fmt)) {
+        u32 = (uint32_t)(uintptr_t) fmt;
+        memcpy(&rec[pos], &u32, 4);
+        pos += 4;
+    }
+    else {
+        uint32_t len = strlen(fmt);
+        if (len > size - pos - 1) {
+            len = size - pos - 1;
+        }
+        rec[1] |= LOG_BINARY_INLINE_FMT;
+        rec[pos++] = len;
+        memcpy(&rec[pos], fmt, len);
+        pos += len;
+    }
+
+    /* Store the raw arguments of each conversion, stopping if we run out of space */
+    while (log_binary_next_spec(fmt, &spec))
+    {
+        fmt = spec.end;
+
+        if (spec.star_width) {
+            if (pos + 4 > size) {
+                break;
+            }
+            u32 = va_arg(args, int);
+            memcpy(&rec[pos], &u32, 4);
+            pos += 4;
+        }
+        if (spec.star_precision) {
+            if (pos + 4 > size) {
+                break;
+            }
+            u32 = va_arg(args, int);
+            memcpy(&rec[pos], &u32, 4);
+            pos += 4;
+        }
+
+        if ('%' == spec.conv) {
+            continue;
+        }
+        else if ('s' == spec.conv)
+        {
+            const char *str = va_arg(args, const char*);
+            if (NULL == str) {
+                str = "(null)";
+            }
+
+            if (log_binary_is_const_str(str)) {
+                if (pos + 5 > size) {
+                    break;
+                }
+                u32 = (uint32_t)(uintptr_t) str;
+                rec[pos++] = LOG_BINARY_INLINE_STR;
+                memcpy(&rec[pos], &u32, 4);
+                pos += 4;
+            }
+            else {
+                uint32_t len = strlen(str);
+                if (pos + 1 > size) {
+                    break;
+                }
+                if (len > size - pos - 1) {
+                    len = size - pos - 1;
+                }
+                if (len >= LOG_BINARY_INLINE_STR) {
+                    len = LOG_BINARY_INLINE_STR - 1;
+                }
+                rec[pos++] = len;
+                memcpy(&rec[pos], str, len);
+                pos += len;
+            }
+        }
+        else if (log_binary_is_float_conv(spec.conv))
+        {
+            const double d = spec.is_long_double ? (double) va_arg(args, long double) : va_arg(args, double);
+            if (pos + 8 > size) {
+                break;
+            }
+            memcpy(&rec[pos], &d, 8);
+            pos += 8;
+        }
+        else if (spec.is_long_long)
+        {
+            const uint64_t u64 = va_arg(args, long long);
+            if (pos + 8 > size) {
+                break;
+            }
+            memcpy(&rec[pos], &u64, 8);
+            pos += 8;
+        }
+        else if ('n' == spec.conv) {
+            (void) va_arg(args, void*);
+        }
+        else
+        {
+            /* char, short, int, long, and pointers are 32-bit on ARM; on a 64-bit host this truncates */
+            if ('p' == spec.conv || spec.is_long) {
+                u32 = (uint32_t) va_arg(args, long);
+            }
+            else {
+                u32 = va_arg(args, unsigned int);
+            }
+            if (pos + 4 > size) {
+                break;
+            }
+            memcpy(&rec[pos], &u32, 4);
+            pos += 4;
+        }
+    }
+
+    rec[0] = pos;
+    return pos;
+}
+
+/// Appends to the decoded text, and @returns the new length
+static uint32_t log_binary_append(char *text, uint32_t size, uint32_t len, const char *str, uint32_t str_len)
+{
+    if (len + str_len >= size) {
+        str_len = (len + 1 < size) ? (size - len - 1) : 0;
+    }
+    memcpy(text + len, str, str_len);
+    len += str_len;
+    text[len] = '\0';
+    return len;
+}
+
+int log_binary_decode(const void *record, char *text, uint32_t size,
+                      log_binary_str_lookup_t lookup, void *arg)
+{
+    /* This must match up with the logger_msg_t enumeration */
+    static const char * const type_str[] = { "debug", "info", "warn", "error" };
+
+    const uint8_t *rec = (const uint8_t*) record;
+    const uint32_t rec_len = rec[0];
+    const uint8_t type = rec[1] & ~LOG_BINARY_INLINE_FMT;
+    uint32_t pos = LOG_BINARY_HEADER_SIZE;
+    uint32_t len = 0;
+    uint32_t u32 = 0;
+    uint16_t line = 0;
+    char fmt_copy[256];
+    char str_copy[256];
+    const char *fmt = NULL;
+    char out[256];
+    bool complete = true;
+    log_binary_spec_t spec;
+
+    if (0 == size || rec_len < LOG_BINARY_HEADER_SIZE + 1) {
+        return -1;
+    }
+    text[0] = '\0';
+
+    /* Print the same header as the text logger */
+    if (LOG_BINARY_RAW_TYPE != type)
+    {
+        uint32_t time = 0, uptime = 0, file_addr = 0, func_addr = 0;
+        const char *file = NULL;
+        const char *func = NULL;
+        const char *slash = NULL;
+
+        memcpy(&line,      &rec[2],  2);
+        memcpy(&time,      &rec[4],  4);
+        memcpy(&uptime,    &rec[8],  4);
+        memcpy(&file_addr, &rec[12], 4);
+        memcpy(&func_addr, &rec[16], 4);
+
+        file = (0 == file_addr) ? "" : lookup(file_addr, arg);
+        func = (0 == func_addr) ? "" : lookup(func_addr, arg);
+        file = file ? file : "?";
+        func = func ? func : "?";
+        if (NULL != (slash = strrchr(file, '/')) || NULL != (slash = strrchr(file, '\\'))) {
+            file = slash + 1;
+        }
+
+        snprintf(out, sizeof(out), "%u/%u,%02u:%02u:%02u,%u,%s,%s,%s%s,%u,",
+                 (unsigned)(time >> 22) & 0xF, (unsigned)(time >> 17) & 0x1F, (unsigned)(time >> 12) & 0x1F,
+                 (unsigned)(time >> 6) & 0x3F, (unsigned) time & 0x3F, (unsigned) uptime,
+                 (type < sizeof(type_str) / sizeof(type_str[0])) ? type_str[type] : "?",
+                 file, func, func[0] ? "()" : "", (unsigned) line);
+        len = log_binary_append(text, size, len, out, strlen(out));
+    }
+
+    /* Get the format string */
+    if (rec[1] & LOG_BINARY_INLINE_FMT) {
+        const uint32_t fmt_len = rec[pos++];
+        if (pos + fmt_len > rec_len) {
+            return -1;
+        }
+        memcpy(fmt_copy, &rec[pos], fmt_len);
+        fmt_copy[fmt_len] = '\0';
+        fmt = fmt_copy;
+        pos += fmt_len;
+    }
+    else {
+        memcpy(&u32, &rec[pos], 4);
+        pos += 4;
+        if (NULL == (fmt = lookup(u32, arg))) {
+            return -1;
+        }
+    }
+
+    /* Format one conversion at a time with its raw argument */
+    while (log_binary_next_spec(fmt, &spec))
+    {
+        char spec_fmt[32];
+        int32_t width = 0, precision = 0;
+        uint32_t n = 0;
+
+        /* Literal text before the conversion */
+        len = log_binary_append(text, size, len, fmt, spec.start - fmt);
+        fmt = spec.end;
+
+        if (spec.star_width) {
+            if (pos + 4 > rec_len) {
+                complete = false;
+                break;
+            }
+            memcpy(&width, &rec[pos], 4);
+            pos += 4;
+        }
+        if (spec.star_precision) {
+            if (pos + 4 > rec_len) {
+                complete = false;
+                break;
+            }
+            memcpy(&precision, &rec[pos], 4);
+            pos += 4;
+        }
+
+        /* Re-build the conversion without the length and with the '*' replaced by the values */
+        do {
+            const char *p = spec.start;
+            while (p < spec.end - 1 && n < sizeof(spec_fmt) - 16) {
+                if ('*' == *p) {
+                    n += sprintf(spec_fmt + n, "%i", (int)((n > 0 && '.' == spec_fmt[n-1]) ? precision : width));
+                }
+                else if (!strchr("lLqjzt", *p)) {
+                    spec_fmt[n++] = *p;
+                }
+                ++p;
+            }
+            if (spec.is_long_long && !log_binary_is_float_conv(spec.conv)) {
+                spec_fmt[n++] = 'l';
+                spec_fmt[n++] = 'l';
+            }
+            spec_fmt[n++] = spec.conv;
+            spec_fmt[n] = '\0';
+        } while (0);
+
+        if ('%' == spec.conv) {
+            len = log_binary_append(text, size, len, "%", 1);
+        }
+        else if ('s' == spec.conv)
+        {
+            const char *str = NULL;
+            if (pos + 1 > rec_len) {
+                complete = false;
+                break;
+            }
+            if (LOG_BINARY_INLINE_STR == rec[pos]) {
+                if (pos + 5 > rec_len) {
+                    complete = false;
+                    break;
+                }
+                memcpy(&u32, &rec[pos + 1], 4);
+                pos += 5;
+                str = lookup(u32, arg);
+                str = str ? str : "?";
+            }
+            else {
+                const uint32_t str_len = rec[pos++];
+                if (pos + str_len > rec_len) {
+                    complete = false;
+                    break;
+                }
+                memcpy(str_copy, &rec[pos], str_len);
+                str_copy[str_len] = '\0';
+                str = str_copy;
+                pos += str_len;
+            }
+            snprintf(out, sizeof(out), spec_fmt, str);
+            len = log_binary_append(text, size, len, out, strlen(out));
+        }
+        else if (log_binary_is_float_conv(spec.conv) || spec.is_long_long)
+        {
+            double d = 0;
+            uint64_t u64 = 0;
+            if (pos + 8 > rec_len) {
+                complete = false;
+                break;
+            }
+            memcpy(&d, &rec[pos], 8);
+            memcpy(&u64, &rec[pos], 8);
+            pos += 8;
+            if (log_binary_is_float_conv(spec.conv)) {
+                snprintf(out, sizeof(out), spec_fmt, d);
+            }
+            else {
+                snprintf(out, sizeof(out), spec_fmt, (long long) u64);
+            }
+            len = log_binary_append(text, size, len, out, strlen(out));
+        }
+        else if ('n' != spec.conv)
+        {
+            if (pos + 4 > rec_len) {
+                complete = false;
+                break;
+            }
+            memcpy(&u32, &rec[pos], 4);
+            pos += 4;
+            if ('p' == spec.conv) {
+                snprintf(out, sizeof(out), "0x%x", (unsigned) u32);
+            }
+            else {
+                snprintf(out, sizeof(out), spec_fmt, u32);
+            }
+            len = log_binary_append(text, size, len, out, strlen(out));
+        }
+    }
+
+    /* Rest of the literal text if all conversions were decoded */
+    if (complete) {
+        len = log_binary_append(text, size, len, fmt, strlen(fmt));
+    }
+
+    len = log_binary_append(text, size, len, "\n", 1);
+    return len;
+}
@@ -0,0 +1,124 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <stddef.h>   // NULL
+#include "log_ring.h"
+
+
+
+#define LOG_RING_PAD   0x0001   ///< Flag of a record that only fills the end of the buffer
+
+/// Header stored before each record
+typedef struct {
+    uint32_t seq;
+    uint16_t len;
+    uint16_t flags;
+} log_ring_header_t;
+
+/// @returns the space taken by a record of the given length, including its header
+static inline uint32_t log_ring_record_size(uint32_t len)
+{
+    return (LOG_RING_HEADER_SIZE + len + LOG_RING_ALIGN - 1) & ~(LOG_RING_ALIGN - 1);
+}
+
+static inline log_ring_header_t* log_ring_header(const log_ring_t *ring, uint32_t index)
+{
+    return (log_ring_header_t*) (ring->buffer + (index & (ring->size - 1)));
+}
+
+void log_ring_init(log_ring_t *ring, void *buffer, uint32_t size)
+{
+    ring->buffer = (uint8_t*) buffer;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+void* log_ring_reserve(log_ring_t *ring, uint32_t max_len)
+{
+    const uint32_t head = ring->head;
+    const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    const uint32_t free_bytes = ring->size - (head - tail);
+    const uint32_t to_end = ring->size - (head & (ring->size - 1));
+    const uint32_t needed = log_ring_record_size(max_len);
+
+    if (needed <= to_end) {
+        return (needed <= free_bytes) ? (log_ring_header(ring, head) + 1) : NULL;
+    }
+
+    /* The record does not fit before the end, so pad the end and use the start of the buffer */
+    if (to_end + needed > free_bytes) {
+        return NULL;
+    }
+
+    log_ring_header_t *pad = log_ring_header(ring, head);
+    pad->len = to_end - LOG_RING_HEADER_SIZE;
+    pad->flags = LOG_RING_PAD;
+    __atomic_store_n(&ring->head, head + to_end, __ATOMIC_RELEASE);
+
+    return log_ring_header(ring, head + to_end) + 1;
+}
+
+void log_ring_commit(log_ring_t *ring, uint32_t len, uint32_t seq)
+{
+    const uint32_t head = ring->head;
+    log_ring_header_t *header = log_ring_header(ring, head);
+
+    header->seq = seq;
+    header->len = len;
+    header->flags = 0;
+
+    /* Release makes the record visible to the consumer before the new head */
+    __atomic_store_n(&ring->head, head + log_ring_record_size(len), __ATOMIC_RELEASE);
+}
+
+const void* log_ring_peek(log_ring_t *ring, uint32_t *len, uint32_t *seq)
+{
+    uint32_t tail = ring->tail;
+    const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    while (tail != head)
+    {
+        const log_ring_header_t *header = log_ring_header(ring, tail);
+        if (header->flags & LOG_RING_PAD) {
+            tail += log_ring_record_size(header->len);
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        *len = header->len;
+        *seq = header->seq;
+        return header + 1;
+    }
+
+    return NULL;
+}
+
+void log_ring_pop(log_ring_t *ring)
+{
+    const uint32_t tail = ring->tail;
+    const log_ring_header_t *header = log_ring_header(ring, tail);
+
+    /* Release makes sure that the record is read before the producer can overwrite it */
+    __atomic_store_n(&ring->tail, tail + log_ring_record_size(header->len), __ATOMIC_RELEASE);
+}
+
+uint32_t log_ring_get_used(const log_ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
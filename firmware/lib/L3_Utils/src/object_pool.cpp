@@ -0,0 +1,117 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <stdio.h>
+#include "object_pool.hpp"
+
+
+
+ObjectPoolBase *ObjectPoolBase::mpFirst = 0;
+
+ObjectPoolBase::ObjectPoolBase(const char *pName, uint16_t capacity, uint8_t *pStorage, uint16_t *pNext, uint32_t objSize) :
+    mHead(0), mpNextFree(pNext), mpStorage(pStorage), mObjSize(objSize), mCapacity(capacity), mpName(pName),
+    mUsed(0), mHighWater(0), mExhaustedCount(0), mpNext(0)
+{
+    /* All objects are free, in the order of their memory */
+    for (uint16_t i = 0; i < capacity; i++) {
+        mpNextFree[i] = (i + 1 < capacity) ? (i + 1) : mNil;
+    }
+
+    /* Pools are expected to be created at startup, but the list is updated atomically anyway */
+    mpNext = __atomic_load_n(&mpFirst, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&mpFirst, &mpNext, this, true, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+        ;
+    }
+}
+
+ObjectPoolBase::~ObjectPoolBase()
+{
+    /* Pools are not expected to be destroyed while other pools are created */
+    for (ObjectPoolBase **pp = &mpFirst; *pp; pp = &((*pp)->mpNext)) {
+        if (this == *pp) {
+            *pp = mpNext;
+            break;
+        }
+    }
+}
+
+void* ObjectPoolBase::allocRaw(void)
+{
+    uint32_t head = __atomic_load_n(&mHead, __ATOMIC_ACQUIRE);
+    uint32_t newHead = 0;
+    uint16_t index = 0;
+
+    do {
+        index = head & 0xFFFF;
+        if (mNil == index) {
+            __atomic_add_fetch(&mExhaustedCount, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        /* If another context took this object in the meantime, the tag changed and the CAS fails */
+        newHead = ((head + 0x10000) & 0xFFFF0000) | __atomic_load_n(&mpNextFree[index], __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&mHead, &head, newHead, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    const uint32_t used = __atomic_add_fetch(&mUsed, 1, __ATOMIC_RELAXED);
+    uint32_t highWater = __atomic_load_n(&mHighWater, __ATOMIC_RELAXED);
+    while (used > highWater &&
+           !__atomic_compare_exchange_n(&mHighWater, &highWater, used, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        ;
+    }
+
+    return mpStorage + (index * mObjSize);
+}
+
+bool ObjectPoolBase::freeRaw(void *pObj)
+{
+    if (!owns(pObj)) {
+        return false;
+    }
+
+    const uint16_t index = (static_cast<uint8_t*>(pObj) - mpStorage) / mObjSize;
+    uint32_t head = __atomic_load_n(&mHead, __ATOMIC_ACQUIRE);
+    uint32_t newHead = 0;
+
+    do {
+        __atomic_store_n(&mpNextFree[index], (uint16_t)(head & 0xFFFF), __ATOMIC_RELAXED);
+        newHead = ((head + 0x10000) & 0xFFFF0000) | index;
+    } while (!__atomic_compare_exchange_n(&mHead, &head, newHead, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    __atomic_sub_fetch(&mUsed, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+bool ObjectPoolBase::owns(const void *pObj) const
+{
+    const uint8_t *p = static_cast<const uint8_t*>(pObj);
+    return (p >= mpStorage && p < mpStorage + (mCapacity * mObjSize) && 0 == ((p - mpStorage) % mObjSize));
+}
+
+int ObjectPoolBase::printAll(char *pBuffer, int size)
+{
+    int len = 0;
+    if (size > 0) {
+        pBuffer[0] = '\0';
+    }
+
+    for (const ObjectPoolBase *p = mpFirst; p && len < size; p = p->mpNext) {
+        len += snprintf(pBuffer + len, size - len, "Pool %-10s: %3u/%3u used, %3u high water, %u exhausted\n",
+                        p->mpName, (unsigned)p->mUsed, (unsigned)p->mCapacity, (unsigned)p->mHighWater,
+                        (unsigned)p->mExhaustedCount);
+    }
+    return (len < size) ? len : (size > 0 ? size - 1 : 0);
+}
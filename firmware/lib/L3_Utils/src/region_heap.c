@@ -0,0 +1,194 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>
+
+#include "region_heap.h"
+
+
+
+/// @returns the region capability that a hint prefers
+static inline uint32_t region_heap_hint_caps(region_heap_hint_t hint)
+{
+    return (REGION_HEAP_DMA == hint)   ? REGION_HEAP_CAP_DMA :
+           (REGION_HEAP_STACK == hint) ? REGION_HEAP_CAP_STACK : REGION_HEAP_CAP_GENERAL;
+}
+
+/**
+ * Tries to allocate from each region with one of the caps.
+ * A region that is full is not a failure of the heap, so the failures are not counted
+ * by the regions' allocators.
+ */
+static void* region_heap_malloc_caps(region_heap_t *heap, size_t bytes, uint32_t caps, uint32_t skip_caps)
+{
+    void *ptr = NULL;
+    uint32_t i = 0;
+
+    for (i = 0; i < heap->region_count && NULL == ptr; i++) {
+        const uint32_t region_caps = heap->regions[i].caps;
+        if ((region_caps & caps) && !(region_caps & skip_caps)) {
+            ptr = tlsf_malloc(&heap->tlsf[i], bytes);
+            heap->tlsf[i].failed_allocs = 0;
+        }
+    }
+    return ptr;
+}
+
+/// Updates the free bytes after the memory of a region changed by the given bytes
+static inline void region_heap_update_free(region_heap_t *heap, size_t old_free, size_t new_free)
+{
+    heap->free_bytes = heap->free_bytes - old_free + new_free;
+    if (heap->free_bytes < heap->min_free_bytes) {
+        heap->min_free_bytes = heap->free_bytes;
+    }
+}
+
+/// @returns the free bytes of all regions
+static size_t region_heap_sum_free(const region_heap_t *heap)
+{
+    size_t free_bytes = 0;
+    uint32_t i = 0;
+    for (i = 0; i < heap->region_count; i++) {
+        free_bytes += heap->tlsf[i].free_bytes;
+    }
+    return free_bytes;
+}
+
+void region_heap_init(region_heap_t *heap)
+{
+    memset(heap, 0, sizeof(*heap));
+}
+
+bool region_heap_add_region(region_heap_t *heap, const region_heap_region_t *region)
+{
+    if (heap->region_count >= REGION_HEAP_MAX_REGIONS) {
+        return false;
+    }
+
+    tlsf_t *tlsf = &heap->tlsf[heap->region_count];
+    tlsf_init(tlsf);
+    if (!tlsf_add_pool(tlsf, region->start, region->size)) {
+        return false;
+    }
+
+    heap->regions[heap->region_count++] = *region;
+    heap->free_bytes += tlsf->free_bytes;
+    heap->min_free_bytes += tlsf->free_bytes;
+    return true;
+}
+
+void* region_heap_malloc(region_heap_t *heap, size_t bytes, region_heap_hint_t hint)
+{
+    const size_t old_free = heap->free_bytes;
+    void *ptr = region_heap_malloc_caps(heap, bytes, region_heap_hint_caps(hint), 0);
+
+    /* Stacks that do not fit in their regions use the general regions that were not tried yet */
+    if (NULL == ptr && REGION_HEAP_STACK == hint) {
+        ptr = region_heap_malloc_caps(heap, bytes, REGION_HEAP_CAP_GENERAL, REGION_HEAP_CAP_STACK);
+    }
+
+    if (NULL == ptr) {
+        heap->failed_allocs[hint]++;
+    }
+    else {
+        region_heap_update_free(heap, old_free, region_heap_sum_free(heap));
+    }
+    return ptr;
+}
+
+int region_heap_find_region(const region_heap_t *heap, const void *ptr)
+{
+    const uint8_t *p = (const uint8_t*) ptr;
+    uint32_t i = 0;
+
+    for (i = 0; i < heap->region_count; i++) {
+        const uint8_t *start = (const uint8_t*) heap->regions[i].start;
+        if (p >= start && p < start + heap->regions[i].size) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+void region_heap_free(region_heap_t *heap, void *ptr)
+{
+    const int i = region_heap_find_region(heap, ptr);
+    if (i >= 0) {
+        const size_t old_free = heap->tlsf[i].free_bytes;
+        tlsf_free(&heap->tlsf[i], ptr);
+        region_heap_update_free(heap, old_free, heap->tlsf[i].free_bytes);
+    }
+}
+
+void* region_heap_realloc(region_heap_t *heap, void *ptr, size_t bytes)
+{
+    const int i = region_heap_find_region(heap, ptr);
+    void *new_ptr = NULL;
+
+    if (i < 0) {
+        return ptr ? NULL : region_heap_malloc(heap, bytes, REGION_HEAP_GENERAL);
+    }
+
+    /* The memory does not know its hint, so it stays in its region; a DMA buffer
+     * must not move to a region that the DMA cannot access.
+     */
+    const size_t old_free = heap->tlsf[i].free_bytes;
+    new_ptr = tlsf_realloc(&heap->tlsf[i], ptr, bytes);
+    heap->tlsf[i].failed_allocs = 0;
+    region_heap_update_free(heap, old_free, heap->tlsf[i].free_bytes);
+
+    if (NULL == new_ptr && bytes > 0) {
+        heap->failed_allocs[(heap->regions[i].caps & REGION_HEAP_CAP_DMA) ? REGION_HEAP_DMA : REGION_HEAP_GENERAL]++;
+    }
+    return new_ptr;
+}
+
+bool region_heap_get_region_stats(const region_heap_t *heap, uint32_t index, tlsf_stats_t *stats)
+{
+    if (index >= heap->region_count) {
+        return false;
+    }
+    tlsf_get_stats(&heap->tlsf[index], stats);
+    return true;
+}
+
+void region_heap_get_stats(const region_heap_t *heap, tlsf_stats_t *stats)
+{
+    tlsf_stats_t region;
+    uint32_t i = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < heap->region_count; i++) {
+        tlsf_get_stats(&heap->tlsf[i], &region);
+        stats->total_bytes += region.total_bytes;
+        stats->used_bytes += region.used_bytes;
+        stats->free_bytes += region.free_bytes;
+        stats->free_blocks += region.free_blocks;
+        stats->used_blocks += region.used_blocks;
+        if (region.largest_free_block > stats->largest_free_block) {
+            stats->largest_free_block = region.largest_free_block;
+        }
+    }
+    for (i = 0; i < REGION_HEAP_HINT_COUNT; i++) {
+        stats->failed_allocs += heap->failed_allocs[i];
+    }
+
+    stats->min_free_bytes = heap->min_free_bytes;
+    stats->fragmentation = (0 == stats->free_bytes) ? 0 :
+                           (uint32_t)(100 - ((uint64_t)stats->largest_free_block * 100) / stats->free_bytes);
+}
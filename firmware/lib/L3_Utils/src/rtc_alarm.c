@@ -16,65 +16,98 @@
  *          p r e e t . w i k i @ g m a i l . c o m
  */
 
-#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
 
 #include "rtc_alarm.h"
+#include "alarm_heap.h"
 #include "rtc.h"
-#include "c_list.h"
 #include "LPC17xx.h"
 
 
 
 /**
- * Structure that holds the time alarm will trigger, and
- * the semaphore that will be given when the alarm triggers
+ * Bits of the RTC registers
  */
-typedef struct {
-    SemaphoreHandle_t *pAlarm;  ///< Semaphore that is given when alarm is triggered
-    alarm_time_t time;          ///< The time that triggers the alarm
-} sem_alarm_t;
+enum {
+    rtc_ilr_alarm       = (1 << 1),     ///< ILR bit to clear the alarm interrupt
+    rtc_amr_compare_hms = 0xF8,         ///< AMR value to compare the hour, minute and second only
+    rtc_amr_disabled    = 0xFF,         ///< AMR value to disable the alarm
+};
 
-static c_list_ptr g_list_timed_alarms = 0;        ///< Alarms for a specified time
-static c_list_ptr g_list_recur_alarms[4] = { 0 }; ///< Recurring alarms, such as "every second"
+static alarm_heap_t g_alarm_heap;           ///< All of the alarms, sorted by the time they fire next
+static bool g_alarm_heap_init = false;      ///< Set after g_alarm_heap has been initialized
 
-static void rtc_enable_intr(void)
+/// @returns the current RTC time
+static alarm_time_t rtc_alarm_get_now(void)
 {
-    LPC_RTC->CIIR |= (1 << 0);
-    vTraceSetISRProperties(RTC_IRQn, "RTC", IP_rtc);
-    NVIC_EnableIRQ(RTC_IRQn);
+    const rtc_t time = rtc_gettime();
+    const alarm_time_t now = { time.hour, time.min, time.sec };
+    return now;
 }
 
-static bool for_each_recur_alarm_callback(void *item, void *arg1, void *arg2, void *arg3)
+/**
+ * Gives the semaphores of the alarms that are due, and sets the RTC alarm registers to the next alarm.
+ * This must be called from the RTC interrupt, or in a critical section.
+ * @param [out] do_yield  Set to non-zero if a context switch is required
+ */
+static void rtc_alarm_service(long *do_yield)
 {
-    long *do_yield = arg1;
-    long yield_required = 0;
-
-    SemaphoreHandle_t *signal = (SemaphoreHandle_t*)item;
-    xSemaphoreGiveFromISR(*signal, &yield_required);
-    if (yield_required) {
-        *do_yield |= 1;
-    }
+    alarm_heap_entry_t *alarm = NULL;
+    alarm_time_t now;
+    alarm_time_t next;
+
+    /* If the second changes while the alarm registers are being set, the alarm may have been
+     * missed, so check the alarms again.
+     */
+    do {
+        now = rtc_alarm_get_now();
+        alarm_heap_set_now(&g_alarm_heap, now);
+
+        while (NULL != (alarm = alarm_heap_get_due(&g_alarm_heap))) {
+            long yield_required = 0;
+            xSemaphoreGiveFromISR(*(SemaphoreHandle_t*) alarm->signal, &yield_required);
+            *do_yield |= yield_required;
+        }
 
-    return 1;
+        if (alarm_heap_get_next(&g_alarm_heap, &next)) {
+            LPC_RTC->ALHOUR = next.hour;
+            LPC_RTC->ALMIN = next.min;
+            LPC_RTC->ALSEC = next.sec;
+            LPC_RTC->AMR = rtc_amr_compare_hms;
+        }
+        else {
+            LPC_RTC->AMR = rtc_amr_disabled;
+        }
+    } while (now.sec != LPC_RTC->SEC);
 }
 
-static bool for_each_alarm_callback(void *item, void *arg1, void *arg2, void *arg3)
+/**
+ * Adds an alarm, and enables the RTC interrupt upon the first alarm
+ * @returns the alarm, or NULL if no more alarms can be added
+ */
+static alarm_heap_entry_t* rtc_alarm_add(uint8_t freq, alarm_time_t time, SemaphoreHandle_t *pAlarm)
 {
-    const rtc_t time = rtc_gettime();
-    sem_alarm_t *a = (sem_alarm_t*)item;
+    alarm_heap_entry_t *alarm = NULL;
+    long do_yield = 0;
 
-    if(a->time.hour == time.hour &&
-       a->time.min == time.min &&
-       a->time.sec == time.sec)
-    {
-        long *do_yield = arg1;
-        long switch_required = 0;
-        xSemaphoreGiveFromISR(*(a->pAlarm), &switch_required);
-        if (switch_required) {
-            *do_yield |= 1;
-        }
+    taskENTER_CRITICAL();
+    if (!g_alarm_heap_init) {
+        alarm_heap_init(&g_alarm_heap, rtc_alarm_get_now());
+        g_alarm_heap_init = true;
+
+        vTraceSetISRProperties(RTC_IRQn, "RTC", IP_rtc);
+        NVIC_EnableIRQ(RTC_IRQn);
     }
-    return 1;
+
+    alarm_heap_set_now(&g_alarm_heap, rtc_alarm_get_now());
+    alarm = alarm_heap_add(&g_alarm_heap, freq, time, pAlarm);
+    rtc_alarm_service(&do_yield);
+    taskEXIT_CRITICAL();
+
+    /* A task waiting on an alarm that is due may have a higher priority */
+    portYIELD_FROM_ISR(do_yield);
+    return alarm;
 }
 
 
@@ -84,13 +117,7 @@ void rtc_alarm_create_recurring(alarm_freq_t freq, SemaphoreHandle_t *pAlarm)
 {
     if(pAlarm && freq >= everySecond && freq <= everyDay)
     {
-        if (!g_list_recur_alarms[freq]) {
-            g_list_recur_alarms[freq] = c_list_create();
-            rtc_enable_intr();
-        }
-        if (NULL != pAlarm) {
-            c_list_insert_elm_end(g_list_recur_alarms[freq], pAlarm);
-        }
+        rtc_alarm_add(freq, rtc_alarm_get_now(), pAlarm);
     }
 }
 
@@ -100,30 +127,38 @@ alarm_time_t* rtc_alarm_create(alarm_time_t time, SemaphoreHandle_t *pAlarm)
         return NULL;
     }
 
-    if (NULL == g_list_timed_alarms) {
-        g_list_timed_alarms = c_list_create();
-        rtc_enable_intr();
-    }
-    if (NULL == g_list_timed_alarms) {
-        return NULL;
-    }
+    alarm_heap_entry_t *pNewAlarm = rtc_alarm_add(ALARM_HEAP_TIMED, time, pAlarm);
+    return (NULL == pNewAlarm) ? NULL : &(pNewAlarm->time);
+}
 
-    sem_alarm_t *pNewAlarm = (sem_alarm_t*) malloc(sizeof(sem_alarm_t));
-    if (NULL == pNewAlarm) {
-        return NULL;
+void rtc_alarm_set_time(alarm_time_t *p, alarm_time_t time)
+{
+    /* The time is the first member of the alarm */
+    alarm_heap_entry_t *alarm = (alarm_heap_entry_t*) p;
+    long do_yield = 0;
+
+    if (NULL != p) {
+        taskENTER_CRITICAL();
+        alarm_heap_set_now(&g_alarm_heap, rtc_alarm_get_now());
+        alarm_heap_set_time(&g_alarm_heap, alarm, time);
+        rtc_alarm_service(&do_yield);
+        taskEXIT_CRITICAL();
+        portYIELD_FROM_ISR(do_yield);
     }
+}
 
-    pNewAlarm->time.hour = time.hour;
-    pNewAlarm->time.min  = time.min;
-    pNewAlarm->time.sec  = time.sec;
-    pNewAlarm->pAlarm = pAlarm;
+void rtc_settime_hook(void)
+{
+    long do_yield = 0;
 
-    if (!c_list_insert_elm_end(g_list_timed_alarms, pNewAlarm)) {
-        free(pNewAlarm);
-        return NULL;
+    /* The hook is also called by rtc_init() before any alarm is created and before the OS runs */
+    if (g_alarm_heap_init) {
+        taskENTER_CRITICAL();
+        alarm_heap_resync(&g_alarm_heap, rtc_alarm_get_now());
+        rtc_alarm_service(&do_yield);
+        taskEXIT_CRITICAL();
+        portYIELD_FROM_ISR(do_yield);
     }
-
-    return &(pNewAlarm->time);
 }
 
 #ifdef __cplusplus
@@ -131,22 +166,10 @@ extern "C" {
 #endif
 void RTC_IRQHandler(void)
 {
-    LPC_RTC->ILR |= (1 << 0); // Clear Increment Interrupt
     long do_yield = 0;
+    LPC_RTC->ILR = rtc_ilr_alarm; // Clear Alarm Interrupt
 
-    const rtc_t time = rtc_gettime();
-    c_list_for_each_elm(g_list_recur_alarms[everySecond], for_each_recur_alarm_callback, &do_yield, NULL, NULL);
-    if(0 == time.sec) {
-        c_list_for_each_elm(g_list_recur_alarms[everyMinute], for_each_recur_alarm_callback, &do_yield, NULL, NULL);
-        if(0 == time.min) {
-            c_list_for_each_elm(g_list_recur_alarms[everyHour], for_each_recur_alarm_callback, &do_yield, NULL, NULL);
-            if(0 == time.hour) {
-                c_list_for_each_elm(g_list_recur_alarms[everyDay], for_each_recur_alarm_callback, &do_yield, NULL, NULL);
-            }
-        }
-    }
-
-    c_list_for_each_elm(g_list_timed_alarms, for_each_alarm_callback, &do_yield, NULL, NULL);
+    rtc_alarm_service(&do_yield);
     portEND_SWITCHING_ISR(do_yield);
 }
 #ifdef __cplusplus
@@ -0,0 +1,198 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>
+
+#include "sched_trace.h"
+
+
+
+/// The trace; the ring is given by sched_trace_init()
+typedef struct {
+    sched_trace_rec_t *recs;                ///< The records of the ring
+    uint32_t mask;                          ///< Number of records - 1
+    volatile uint32_t write_idx;            ///< Number of records ever written
+    volatile uint32_t start_idx;            ///< write_idx when the ring was cleared
+    uint32_t (*get_time_us)(void);          ///< Clock of the timestamps
+    volatile bool enabled;
+
+    uint8_t task_count;                     ///< Number of task names
+    char task_names[SCHED_TRACE_MAX_TASKS][SCHED_TRACE_NAME_LEN + 1];
+    const char *marker_names[SCHED_TRACE_MAX_MARKERS];
+} sched_trace_t;
+
+static sched_trace_t g_trace;
+
+static const char * const g_event_names[] = {
+    "none", "switch_in", "ready", "isr_enter", "isr_exit", "block_recv", "block_send",
+    "block_delay", "block_notify", "mark", "begin", "end",
+};
+
+/// @returns the exception number of the ISR that runs now, or 0 if a task runs
+static inline uint16_t sched_trace_get_exception_num(void)
+{
+#ifdef __arm__
+    uint32_t ipsr = 0;
+    __asm volatile ("mrs %0, ipsr" : "=r" (ipsr));
+    return (uint16_t)(ipsr & 0x1FF);
+#else
+    return 0;
+#endif
+}
+
+
+
+void sched_trace_init(sched_trace_rec_t *recs, uint32_t count, uint32_t (*get_time_us)(void))
+{
+    g_trace.enabled = false;
+    g_trace.recs = recs;
+    g_trace.mask = count - 1;
+    g_trace.get_time_us = get_time_us;
+    g_trace.write_idx = g_trace.start_idx = 0;
+    g_trace.enabled = (NULL != recs && NULL != get_time_us && count > 0 && 0 == (count & (count - 1)));
+}
+
+void sched_trace_enable(bool enable)
+{
+    g_trace.enabled = enable && (NULL != g_trace.recs);
+}
+
+bool sched_trace_is_enabled(void)
+{
+    return g_trace.enabled;
+}
+
+void sched_trace_clear(void)
+{
+    g_trace.start_idx = g_trace.write_idx;
+}
+
+uint8_t sched_trace_add_task(const char *name)
+{
+    if (g_trace.task_count >= SCHED_TRACE_MAX_TASKS) {
+        return 0;
+    }
+
+    /* Tasks are created one at a time by the kernel, so no lock is needed */
+    char *dst = g_trace.task_names[g_trace.task_count];
+    strncpy(dst, name ? name : "", SCHED_TRACE_NAME_LEN);
+    dst[SCHED_TRACE_NAME_LEN] = '\0';
+    return ++g_trace.task_count;
+}
+
+const char* sched_trace_get_task_name(uint8_t id)
+{
+    return (id > 0 && id <= g_trace.task_count) ? g_trace.task_names[id - 1] : NULL;
+}
+
+void sched_trace_set_marker_name(uint8_t id, const char *name)
+{
+    if (id < SCHED_TRACE_MAX_MARKERS) {
+        g_trace.marker_names[id] = name;
+    }
+}
+
+void sched_trace_record(sched_trace_event_t type, uint8_t id, uint16_t arg)
+{
+    if (!g_trace.enabled) {
+        return;
+    }
+
+    const uint32_t idx = __atomic_fetch_add(&g_trace.write_idx, 1, __ATOMIC_RELAXED);
+    sched_trace_rec_t *rec = &g_trace.recs[idx & g_trace.mask];
+    rec->time_us = g_trace.get_time_us();
+    rec->type = type;
+    rec->id = id;
+    rec->arg = arg;
+}
+
+void sched_trace_task_ready(uint8_t id)
+{
+    sched_trace_record(sched_trace_ev_ready, id, sched_trace_get_exception_num());
+}
+
+uint32_t sched_trace_get_count(void)
+{
+    const uint32_t written = g_trace.write_idx - g_trace.start_idx;
+    return (NULL == g_trace.recs) ? 0 : (written > g_trace.mask ? g_trace.mask + 1 : written);
+}
+
+uint32_t sched_trace_get_lost(void)
+{
+    return (g_trace.write_idx - g_trace.start_idx) - sched_trace_get_count();
+}
+
+bool sched_trace_get(uint32_t index, sched_trace_rec_t *rec)
+{
+    if (index >= sched_trace_get_count()) {
+        return false;
+    }
+    const uint32_t oldest = g_trace.write_idx - sched_trace_get_count();
+    *rec = g_trace.recs[(oldest + index) & g_trace.mask];
+    return true;
+}
+
+const char* sched_trace_get_event_name(uint8_t type)
+{
+    return (type < sched_trace_ev_last_event) ? g_event_names[type] : "?";
+}
+
+uint32_t sched_trace_save(void (*write)(const void *data, uint32_t len, void *arg), void *arg)
+{
+    const bool was_enabled = g_trace.enabled;
+    g_trace.enabled = false;
+
+    uint8_t num_markers = 0;
+    for (uint8_t i = 0; i < SCHED_TRACE_MAX_MARKERS; i++) {
+        if (g_trace.marker_names[i]) {
+            num_markers = i + 1;
+        }
+    }
+
+    const uint32_t count = sched_trace_get_count();
+    const uint32_t lost = sched_trace_get_lost();
+    uint8_t header[16] = { 'S', 'T', 'R', 'C', 1, sizeof(sched_trace_rec_t), g_trace.task_count, num_markers };
+    memcpy(&header[8], &count, sizeof(count));
+    memcpy(&header[12], &lost, sizeof(lost));
+    write(header, sizeof(header), arg);
+
+    /* Task names are already padded with zeroes by sched_trace_add_task() */
+    for (uint8_t i = 0; i < g_trace.task_count; i++) {
+        write(g_trace.task_names[i], SCHED_TRACE_NAME_LEN, arg);
+    }
+    for (uint8_t i = 0; i < num_markers; i++) {
+        char name[SCHED_TRACE_NAME_LEN] = { 0 };
+        const char *marker = g_trace.marker_names[i] ? g_trace.marker_names[i] : "";
+        const size_t len = strlen(marker);
+        memcpy(name, marker, len < sizeof(name) ? len : sizeof(name));
+        write(name, sizeof(name), arg);
+    }
+
+    /* Write the ring in up to two chunks: from the oldest record to the end, then from the start */
+    const uint32_t oldest = (g_trace.write_idx - count) & g_trace.mask;
+    const uint32_t first = (oldest + count > g_trace.mask + 1) ? (g_trace.mask + 1 - oldest) : count;
+    if (first > 0) {
+        write(&g_trace.recs[oldest], first * sizeof(sched_trace_rec_t), arg);
+    }
+    if (count > first) {
+        write(&g_trace.recs[0], (count - first) * sizeof(sched_trace_rec_t), arg);
+    }
+
+    g_trace.enabled = was_enabled;
+    return count;
+}
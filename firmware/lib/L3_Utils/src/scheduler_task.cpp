@@ -30,7 +30,7 @@
 
 #include "c_tlm_comp.h"
 #include "c_tlm_var.h"
-#include "c_tlm_stream.h"
+#include "c_tlm_journal.h"
 
 
 
@@ -282,11 +282,7 @@ bool scheduler_init_all(bool register_internal_tlm)
 
         dbg_print("*  Restoring disk telemetry\n");
         // Restore telemetry registered by "disk" component
-        FILE *fd = fopen(SYS_CFG_DISK_TLM_NAME, "r");
-        if (fd) {
-            tlm_stream_decode_file(fd);
-            fclose(fd);
-        }
+        tlm_journal_restore(tlm_component_get_by_name(SYS_CFG_DISK_TLM_NAME), SYS_CFG_DISK_TLM_NAME);
     } while (0);
     #endif
 
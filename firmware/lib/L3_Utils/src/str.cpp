@@ -17,6 +17,8 @@
  */
 
 #include "str.hpp"
+#include "str_view.hpp"
+#include "stream_printf.h"
 #include <string.h> // memcpy, strcmp
 #include <ctype.h>  // tolower/toupper
 #include <stdlib.h> // realloc()
@@ -122,7 +124,7 @@ int str::printf(const char* format, ...)
 
         // getCapacity() doesn't include NULL
         int mem = getCapacity() + 1;
-        len = vsnprintf(mpStr, mem, format, args_copy);
+        len = stream_vsnprintf(mpStr, mem, format, args_copy);
         va_end(args_copy);
 
         // Output is only written if len is greater than 0 and less than our capacity.
@@ -1003,6 +1005,50 @@ str::str(const str& copy)
     *this = copy;
 }
 
+str::str(const str_view& v)
+{
+    this->init(v.getLen());
+    *this = v;
+}
+
+void str::operator=(const str_view& v)
+{
+    int len = v.getLen();
+
+    // If we can't allocate memory, only copy up to capacity
+    if (len > mCapacity && !reAllocateMem(len)) {
+        len = mCapacity;
+    }
+
+    // View may refer to our own memory, so use memmove()
+    memmove(mpStr, v.data(), len);
+    mpStr[len] = '\0';
+}
+
+void str::append(const str_view& v)
+{
+    const int ourLen = getLen();
+    const bool isOurMem = (v.data() >= mpStr && v.data() <= mpStr + ourLen);
+    const int offset = v.data() - mpStr;
+
+    if (ensureMemoryToInsertNChars(v.getLen())) {
+        // Memory may have been re-allocated, so get the pointer again if view is our own memory
+        const char *pData = isOurMem ? (mpStr + offset) : v.data();
+        memmove(mpStr + ourLen, pData, v.getLen());
+        mpStr[ourLen + v.getLen()] = '\0';
+    }
+}
+
+bool str::compareTo(const str_view& v) const
+{
+    return str_view(*this).compareTo(v);
+}
+
+bool str::compareToIgnoreCase(const str_view& v) const
+{
+    return str_view(*this).compareToIgnoreCase(v);
+}
+
 
 
 
@@ -0,0 +1,251 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include "str_view.hpp"
+#include <string.h> // strlen()
+#include <ctype.h>  // tolower()
+
+
+
+str_view::str_view(const char* pString) : mpStr(pString ? pString : ""), mLen(0)
+{
+    mLen = strlen(mpStr);
+}
+
+bool str_view::copyTo(char* pBuffer, int size) const
+{
+    if (size <= 0) {
+        return false;
+    }
+
+    const int n = (mLen < size) ? mLen : (size - 1);
+    memcpy(pBuffer, mpStr, n);
+    pBuffer[n] = '\0';
+
+    return (n == mLen);
+}
+
+bool str_view::compareTo(const char* pString) const
+{
+    return compareTo(str_view(pString));
+}
+bool str_view::compareTo(const str_view& v) const
+{
+    return (mLen == v.mLen) && (0 == memcmp(mpStr, v.mpStr, mLen));
+}
+bool str_view::compareToIgnoreCase(const char* pString) const
+{
+    return compareToIgnoreCase(str_view(pString));
+}
+bool str_view::compareToIgnoreCase(const str_view& v) const
+{
+    if (mLen != v.mLen) {
+        return false;
+    }
+    for (int i = 0; i < mLen; i++) {
+        if (tolower(mpStr[i]) != tolower(v.mpStr[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool str_view::beginsWith(const char* pString) const
+{
+    const int theirLen = strlen(pString);
+    return (mLen >= theirLen) && subView(0, theirLen).compareTo(str_view(pString, theirLen));
+}
+bool str_view::beginsWithIgnoreCase(const char* pString) const
+{
+    const int theirLen = strlen(pString);
+    return (mLen >= theirLen) && subView(0, theirLen).compareToIgnoreCase(str_view(pString, theirLen));
+}
+bool str_view::beginsWithWholeWord(const char* pString, char seperator) const
+{
+    // After comparison, the char must be the separator or the end of the view
+    const int len = strlen(pString);
+    return beginsWith(pString) && (len == mLen || seperator == mpStr[len]);
+}
+bool str_view::beginsWithWholeWordIgnoreCase(const char* pString, char seperator) const
+{
+    const int len = strlen(pString);
+    return beginsWithIgnoreCase(pString) && (len == mLen || seperator == mpStr[len]);
+}
+
+int str_view::firstIndexOf(char c) const
+{
+    const char *p = (const char*) memchr(mpStr, c, mLen);
+    return p ? (p - mpStr) : -1;
+}
+
+str_view str_view::trimStart(const char* pChars) const
+{
+    int i = 0;
+    while (i < mLen && isOneOf(mpStr[i], pChars)) {
+        i++;
+    }
+    return str_view(mpStr + i, mLen - i);
+}
+str_view str_view::trimEnd(const char* pChars) const
+{
+    int len = mLen;
+    while (len > 0 && isOneOf(mpStr[len - 1], pChars)) {
+        len--;
+    }
+    return str_view(mpStr, len);
+}
+str_view str_view::subView(int fromIndex, int charCount) const
+{
+    if (fromIndex < 0 || fromIndex >= mLen || charCount <= 0) {
+        return str_view();
+    }
+
+    // Cap the charCount if it is greater than remaining length
+    if (charCount > mLen - fromIndex) {
+        charCount = mLen - fromIndex;
+    }
+    return str_view(mpStr + fromIndex, charCount);
+}
+
+str_view str_view::nextToken(const char* pDelimiters)
+{
+    *this = trimStart(pDelimiters);
+
+    int len = 0;
+    while (len < mLen && !isOneOf(mpStr[len], pDelimiters)) {
+        len++;
+    }
+
+    const str_view token(mpStr, len);
+
+    // Remove the token, and the delimiter after it
+    const int consumed = (len < mLen) ? (len + 1) : len;
+    mpStr += consumed;
+    mLen -= consumed;
+
+    return token;
+}
+
+int str_view::split(str_view* pTokens, int maxTokens, const char* pDelimiters) const
+{
+    str_view rest = *this;
+    int count = 0;
+
+    while (count < maxTokens)
+    {
+        rest = rest.trimStart(pDelimiters);
+        if (rest.isEmpty()) {
+            break;
+        }
+
+        // Last token gets the remaining view
+        const bool last = (count == maxTokens - 1);
+        pTokens[count++] = last ? rest.trimEnd(pDelimiters) : rest.nextToken(pDelimiters);
+    }
+
+    return count;
+}
+
+bool str_view::toUint(uint32_t* pValue, int base) const
+{
+    const char *p = mpStr;
+    const char *end = mpStr + mLen;
+
+    // Detect or skip the prefix
+    if (mLen > 2 && '0' == p[0]) {
+        const char prefix = tolower(p[1]);
+        if ('x' == prefix && (0 == base || 16 == base)) {
+            base = 16;
+            p += 2;
+        }
+        else if ('b' == prefix && (0 == base || 2 == base)) {
+            base = 2;
+            p += 2;
+        }
+    }
+    if (0 == base) {
+        base = 10;
+    }
+
+    if (p >= end) {
+        return false;
+    }
+
+    uint32_t value = 0;
+    for ( ; p < end; p++)
+    {
+        const char c = tolower(*p);
+        uint32_t digit = 0;
+
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        }
+        else if (c >= 'a' && c <= 'z') {
+            digit = c - 'a' + 10;
+        }
+        else {
+            return false;
+        }
+
+        // Check for invalid digit or overflow
+        if (digit >= (uint32_t) base || value > (UINT32_MAX - digit) / base) {
+            return false;
+        }
+        value = (value * base) + digit;
+    }
+
+    *pValue = value;
+    return true;
+}
+
+bool str_view::toInt(int32_t* pValue, int base) const
+{
+    const bool negative = (mLen > 0 && '-' == mpStr[0]);
+    const bool sign = negative || (mLen > 0 && '+' == mpStr[0]);
+    uint32_t value = 0;
+
+    if (!subView(sign ? 1 : 0).toUint(&value, base)) {
+        return false;
+    }
+
+    if (negative ? (value > (uint32_t)INT32_MAX + 1) : (value > (uint32_t)INT32_MAX)) {
+        return false;
+    }
+
+    *pValue = negative ? (int32_t)(0 - value) : (int32_t) value;
+    return true;
+}
+
+bool str_view::nextInt(int32_t* pValue, int base, const char* pDelimiters)
+{
+    str_view rest = *this;
+    const bool ok = rest.nextToken(pDelimiters).toInt(pValue, base);
+    if (ok) {
+        *this = rest;
+    }
+    return ok;
+}
+bool str_view::nextUint(uint32_t* pValue, int base, const char* pDelimiters)
+{
+    str_view rest = *this;
+    const bool ok = rest.nextToken(pDelimiters).toUint(pValue, base);
+    if (ok) {
+        *this = rest;
+    }
+    return ok;
+}
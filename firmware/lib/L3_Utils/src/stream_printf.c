@@ -0,0 +1,732 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>   // memcpy(), memmove(), memset()
+
+#include "stream_printf.h"
+
+
+
+#define STREAM_LEFT         (1 << 0)    ///< '-' flag
+#define STREAM_PLUS         (1 << 1)    ///< '+' flag
+#define STREAM_SPACE        (1 << 2)    ///< ' ' flag
+#define STREAM_ALT          (1 << 3)    ///< '#' flag
+#define STREAM_ZERO         (1 << 4)    ///< '0' flag
+#define STREAM_UPPER        (1 << 5)    ///< Upper case conversion such as 'X'
+#define STREAM_HEX_PREFIX   (1 << 6)    ///< Prefix "0x" even if the value is zero (%p)
+
+#define STREAM_MAX_DIGITS   17          ///< Exact significant digits of floating-point numbers
+#define STREAM_BIG_WORDS    36          ///< 1152 bits, enough for the exact digits of any double
+
+/// Lengths of the conversions
+typedef enum {
+    stream_len_int, stream_len_char, stream_len_short, stream_len_long, stream_len_llong,
+    stream_len_intmax, stream_len_size, stream_len_ptrdiff, stream_len_ldouble,
+} stream_len_t;
+
+/// State of one stream_vprintf() call
+typedef struct {
+    stream_printf_out_t out;
+    void *arg;
+    int count;                              ///< Characters formatted so far
+    uint32_t used;                          ///< Characters in the chunk
+    bool stopped;                           ///< The output function returned false
+    char chunk[STREAM_PRINTF_CHUNK_SIZE];
+} stream_state_t;
+
+/// Parsed conversion specification
+typedef struct {
+    uint8_t flags;
+    int width;
+    int precision;  ///< -1 if not given
+} stream_spec_t;
+
+/// Decimal digits of a floating-point number : d[0] is at 10^exp, and the digits after len are zeros
+typedef struct {
+    char d[STREAM_MAX_DIGITS];
+    int len;
+    int exp;
+} stream_digits_t;
+
+/// Unsigned big integer of the exact digits of floating-point numbers
+typedef struct {
+    uint32_t w[STREAM_BIG_WORDS];   ///< Little endian words
+    int len;                        ///< Words in use, the top one is not zero
+} stream_big_t;
+
+
+
+static void stream_flush(stream_state_t *st)
+{
+    if (st->used > 0 && !st->stopped) {
+        st->stopped = !st->out(st->chunk, st->used, st->arg);
+    }
+    st->used = 0;
+}
+
+static void stream_putc(stream_state_t *st, char c)
+{
+    st->count++;
+    if (st->used >= sizeof(st->chunk)) {
+        stream_flush(st);
+    }
+    st->chunk[st->used++] = c;
+}
+
+static void stream_write(stream_state_t *st, const char *data, uint32_t len)
+{
+    st->count += len;
+    if (len > sizeof(st->chunk) - st->used) {
+        stream_flush(st);
+
+        /* Text that does not fit in the chunk is passed as it is */
+        if (len >= sizeof(st->chunk)) {
+            if (!st->stopped) {
+                st->stopped = !st->out(data, len, st->arg);
+            }
+            return;
+        }
+    }
+    memcpy(st->chunk + st->used, data, len);
+    st->used += len;
+}
+
+static void stream_fill(stream_state_t *st, char c, int n)
+{
+    while (n-- > 0) {
+        stream_putc(st, c);
+    }
+}
+
+/// Outputs the spaces before a right aligned field, and the zeros of the '0' flag
+static void stream_pad_before(stream_state_t *st, const stream_spec_t *spec, int len, const char *prefix, bool zeros)
+{
+    const int pad = spec->width - len - (int) strlen(prefix);
+    if (!(spec->flags & STREAM_LEFT) && !zeros) {
+        stream_fill(st, ' ', pad);
+    }
+    stream_write(st, prefix, strlen(prefix));
+    if (!(spec->flags & STREAM_LEFT) && zeros) {
+        stream_fill(st, '0', pad);
+    }
+}
+
+/// Outputs the spaces after a left aligned field
+static void stream_pad_after(stream_state_t *st, const stream_spec_t *spec, int len, const char *prefix)
+{
+    if (spec->flags & STREAM_LEFT) {
+        stream_fill(st, ' ', spec->width - len - (int) strlen(prefix));
+    }
+}
+
+static const char* stream_sign(const stream_spec_t *spec, bool negative)
+{
+    return negative ? "-" : (spec->flags & STREAM_PLUS) ? "+" : (spec->flags & STREAM_SPACE) ? " " : "";
+}
+
+static void stream_integer(stream_state_t *st, const stream_spec_t *spec, unsigned long long value,
+                           bool negative, bool is_signed, unsigned base)
+{
+    const char *hex = (spec->flags & STREAM_UPPER) ? "0123456789ABCDEF" : "0123456789abcdef";
+    char digits[24];    /* 22 octal digits of 64-bits */
+    const char *prefix = "";
+    int len = 0;
+
+    /* 64-bit division is a slow library call on the Cortex-M3, so it is only used for large values */
+    if (10 != base) {
+        const unsigned shift = (16 == base) ? 4 : 3;
+        for ( ; value > 0; value >>= shift) {
+            digits[sizeof(digits) - ++len] = hex[value & (base - 1)];
+        }
+    }
+    else {
+        for ( ; value > 0xFFFFFFFFULL; value /= 10) {
+            digits[sizeof(digits) - ++len] = '0' + (value % 10);
+        }
+        for (uint32_t v = (uint32_t) value; v > 0; v /= 10) {
+            digits[sizeof(digits) - ++len] = '0' + (v % 10);
+        }
+    }
+
+    /* Zeros of the precision, or a zero if there is no precision */
+    int zeros = (spec->precision < 0) ? (0 == len) : (spec->precision - len);
+    if (zeros < 0) {
+        zeros = 0;
+    }
+
+    if (is_signed) {
+        prefix = stream_sign(spec, negative);
+    }
+    else if (8 == base && (spec->flags & STREAM_ALT) && 0 == zeros) {
+        zeros = 1;
+    }
+    else if (16 == base && ((spec->flags & STREAM_HEX_PREFIX) || ((spec->flags & STREAM_ALT) && len > 0))) {
+        prefix = (spec->flags & STREAM_UPPER) ? "0X" : "0x";
+    }
+
+    const bool zero_pad = (spec->flags & STREAM_ZERO) && spec->precision < 0;
+    stream_pad_before(st, spec, zeros + len, prefix, zero_pad);
+    stream_fill(st, '0', zeros);
+    stream_write(st, digits + sizeof(digits) - len, len);
+    stream_pad_after(st, spec, zeros + len, prefix);
+}
+
+static void stream_string(stream_state_t *st, const stream_spec_t *spec, const char *s)
+{
+    int len = 0;
+    if (!s) {
+        s = "(null)";
+    }
+    while ((spec->precision < 0 || len < spec->precision) && s[len]) {
+        len++;
+    }
+
+    stream_pad_before(st, spec, len, "", false);
+    stream_write(st, s, len);
+    stream_pad_after(st, spec, len, "");
+}
+
+
+
+static void stream_big_set(stream_big_t *b, uint64_t value)
+{
+    b->w[0] = (uint32_t) value;
+    b->w[1] = (uint32_t) (value >> 32);
+    b->len = b->w[1] ? 2 : (b->w[0] ? 1 : 0);
+}
+
+static void stream_big_mul(stream_big_t *b, uint32_t m)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < b->len; i++) {
+        carry += (uint64_t) b->w[i] * m;
+        b->w[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    if (carry) {
+        b->w[b->len++] = (uint32_t) carry;
+    }
+}
+
+static void stream_big_mul_pow10(stream_big_t *b, int n)
+{
+    static const uint32_t pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+    for ( ; n >= 9; n -= 9) {
+        stream_big_mul(b, 1000000000);
+    }
+    stream_big_mul(b, pow10[n]);
+}
+
+static void stream_big_shl(stream_big_t *b, int bits)
+{
+    const int words = bits / 32;
+    const int shift = bits % 32;
+
+    if (shift > 0) {
+        const uint32_t top = b->w[b->len - 1] >> (32 - shift);
+        for (int i = b->len - 1; i > 0; i--) {
+            b->w[i] = (b->w[i] << shift) | (b->w[i - 1] >> (32 - shift));
+        }
+        b->w[0] <<= shift;
+        if (top) {
+            b->w[b->len++] = top;
+        }
+    }
+    if (words > 0) {
+        memmove(b->w + words, b->w, b->len * sizeof(b->w[0]));
+        memset(b->w, 0, words * sizeof(b->w[0]));
+        b->len += words;
+    }
+}
+
+static int stream_big_cmp(const stream_big_t *a, const stream_big_t *b)
+{
+    if (a->len != b->len) {
+        return (a->len < b->len) ? -1 : 1;
+    }
+    for (int i = a->len - 1; i >= 0; i--) {
+        if (a->w[i] != b->w[i]) {
+            return (a->w[i] < b->w[i]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/// a -= b, where a >= b
+static void stream_big_sub(stream_big_t *a, const stream_big_t *b)
+{
+    uint32_t borrow = 0;
+    for (int i = 0; i < a->len; i++) {
+        const uint64_t sub = (uint64_t) ((i < b->len) ? b->w[i] : 0) + borrow;
+        borrow = (a->w[i] < sub);
+        a->w[i] = (uint32_t) (a->w[i] - sub);
+    }
+    while (a->len > 0 && 0 == a->w[a->len - 1]) {
+        a->len--;
+    }
+}
+
+/**
+ * @returns floor(log10(value)) of value > 0, or one more than that if the value is just
+ * below a power of 10, because the multiplications are not exact.
+ */
+static int stream_estimate_exp(double value)
+{
+    static const double pow10[] = { 1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256 };
+    int exp = 0;
+
+    if (value >= 1) {
+        for (int i = 8; i >= 0; i--) {
+            if (value >= pow10[i]) {
+                value /= pow10[i];
+                exp += (1 << i);
+            }
+        }
+    }
+    else {
+        for (int i = 8; i >= 0; i--) {
+            if (value * pow10[i] < 1) {
+                value *= pow10[i];
+                exp -= (1 << i);
+            }
+        }
+        value *= 10;
+        exp--;
+    }
+    return (value > 9.99999) ? (exp + 1) : exp;
+}
+
+/**
+ * Gets the exact decimal digits of value >= 0 rounded half to even, like the C library.
+ * The value is the big integer fraction r / s, scaled by a power of 10 to [1, 10), and
+ * each digit is the integer part of r / s.
+ *
+ * @param digits  The number of significant digits, or if fixed, the digits after the point
+ */
+static void stream_get_digits(double value, int digits, bool fixed, stream_digits_t *dg)
+{
+    stream_big_t r, s;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    int exp2 = (int) ((bits >> 52) & 0x7FF);
+    uint64_t mantissa = bits & ((1ULL << 52) - 1);
+    if (exp2 > 0) {
+        mantissa |= (1ULL << 52);
+    }
+    else {
+        exp2 = 1;
+    }
+    exp2 -= 1075;
+
+    dg->len = 0;
+    dg->exp = 0;
+    if (0 == mantissa) {
+        return;
+    }
+
+    /* value = mantissa * 2^exp2 = r / s * 10^exp, with r / s in [1, 10) */
+    int exp = stream_estimate_exp(value);
+    stream_big_set(&r, mantissa);
+    stream_big_set(&s, 1);
+    if (exp2 > 0) {
+        stream_big_shl(&r, exp2);
+    }
+    else {
+        stream_big_shl(&s, -exp2);
+    }
+    if (exp > 0) {
+        stream_big_mul_pow10(&s, exp);
+    }
+    else {
+        stream_big_mul_pow10(&r, -exp);
+    }
+    if (stream_big_cmp(&r, &s) < 0) {
+        stream_big_mul(&r, 10);
+        exp--;
+    }
+
+    int n = fixed ? (exp + 1 + digits) : digits;
+    if (n > STREAM_MAX_DIGITS) {
+        n = STREAM_MAX_DIGITS;
+    }
+    dg->exp = exp;
+    if (n < 0) {
+        return;
+    }
+
+    for (dg->len = 0; dg->len < n; dg->len++) {
+        char d = '0';
+        while (stream_big_cmp(&r, &s) >= 0) {
+            stream_big_sub(&r, &s);
+            d++;
+        }
+        dg->d[dg->len] = d;
+        stream_big_mul(&r, 10);
+    }
+
+    /* The rest is r / 10s, so round up if r > 5s, or if r == 5s and the last digit is odd */
+    stream_big_mul(&s, 5);
+    const int cmp = stream_big_cmp(&r, &s);
+    if (cmp > 0 || (0 == cmp && n > 0 && (dg->d[n - 1] & 1))) {
+        int i = n - 1;
+        while (i >= 0 && '9' == dg->d[i]) {
+            dg->d[i--] = '0';
+        }
+        if (i >= 0) {
+            dg->d[i]++;
+        }
+        else {
+            /* All nines (or no digits) round up to the next power of 10 */
+            dg->d[0] = '1';
+            dg->len = 1;
+            dg->exp++;
+        }
+    }
+
+    while (dg->len > 0 && '0' == dg->d[dg->len - 1]) {
+        dg->len--;
+    }
+}
+
+/// @returns the digit at 10^pos
+static char stream_digit(const stream_digits_t *dg, int pos)
+{
+    const int i = dg->exp - pos;
+    return (i >= 0 && i < dg->len) ? dg->d[i] : '0';
+}
+
+static void stream_float(stream_state_t *st, const stream_spec_t *spec, double value, char conv)
+{
+    stream_digits_t dg;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const bool negative = (bits >> 63);
+    const bool upper = (spec->flags & STREAM_UPPER);
+    const char *prefix = stream_sign(spec, negative);
+    int precision = (spec->precision < 0) ? 6 : spec->precision;
+    if (negative) {
+        value = -value;
+    }
+
+    /* Infinity and NaN are padded with spaces */
+    if (0x7FF == ((bits >> 52) & 0x7FF)) {
+        const char *text = (bits & ((1ULL << 52) - 1)) ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf");
+        stream_pad_before(st, spec, 3, prefix, false);
+        stream_write(st, text, 3);
+        stream_pad_after(st, spec, 3, prefix);
+        return;
+    }
+
+    /* %g is %e or %f with the precision as the significant digits, and no trailing zeros */
+    bool exp_style = ('e' == conv);
+    if ('g' == conv) {
+        const int p = (0 == precision) ? 1 : precision;
+        stream_get_digits(value, p, false, &dg);
+        exp_style = !(p > dg.exp && dg.exp >= -4);
+        precision = exp_style ? (p - 1) : (p - 1 - dg.exp);
+        if (!(spec->flags & STREAM_ALT)) {
+            const int needed = exp_style ? (dg.len - 1) : (dg.len - 1 - dg.exp);
+            if (precision > needed) {
+                precision = (needed > 0) ? needed : 0;
+            }
+        }
+    }
+    else {
+        stream_get_digits(value, exp_style ? (precision + 1) : precision, !exp_style, &dg);
+    }
+
+    const int point = (precision > 0 || (spec->flags & STREAM_ALT)) ? 1 : 0;
+    const int exp = (dg.len > 0) ? dg.exp : 0;
+    const int exp_abs = (exp < 0) ? -exp : exp;
+    const int exp_digits = (exp_abs >= 100) ? 3 : 2;
+    const int int_digits = exp_style ? 1 : ((dg.exp >= 0) ? (dg.exp + 1) : 1);
+    const int len = int_digits + point + precision + (exp_style ? (2 + exp_digits) : 0);
+
+    stream_pad_before(st, spec, len, prefix, (spec->flags & STREAM_ZERO));
+    if (exp_style) {
+        stream_putc(st, stream_digit(&dg, exp));
+        if (point) {
+            stream_putc(st, '.');
+        }
+        for (int i = 1; i <= precision; i++) {
+            stream_putc(st, stream_digit(&dg, exp - i));
+        }
+        stream_putc(st, upper ? 'E' : 'e');
+        stream_putc(st, (exp < 0) ? '-' : '+');
+        if (exp_digits > 2) {
+            stream_putc(st, '0' + exp_abs / 100);
+        }
+        stream_putc(st, '0' + (exp_abs / 10) % 10);
+        stream_putc(st, '0' + exp_abs % 10);
+    }
+    else {
+        for (int pos = int_digits - 1; pos >= 0; pos--) {
+            stream_putc(st, stream_digit(&dg, pos));
+        }
+        if (point) {
+            stream_putc(st, '.');
+        }
+        for (int pos = -1; pos >= -precision; pos--) {
+            stream_putc(st, stream_digit(&dg, pos));
+        }
+    }
+    stream_pad_after(st, spec, len, prefix);
+}
+
+
+
+int stream_vprintf(stream_printf_out_t out, void *arg, const char *format, va_list args)
+{
+    stream_state_t st;
+    st.out = out;
+    st.arg = arg;
+    st.count = 0;
+    st.used = 0;
+    st.stopped = false;
+
+    const char *p = format;
+    while (*p)
+    {
+        /* Literal text up to the next conversion */
+        const char *start = p;
+        while (*p && '%' != *p) {
+            ++p;
+        }
+        if (p > start) {
+            stream_write(&st, start, p - start);
+        }
+        if (!*p) {
+            break;
+        }
+
+        stream_spec_t spec = { 0, 0, -1 };
+        start = p++;
+
+        for ( ; ; ++p) {
+            if      ('-' == *p) spec.flags |= STREAM_LEFT;
+            else if ('+' == *p) spec.flags |= STREAM_PLUS;
+            else if (' ' == *p) spec.flags |= STREAM_SPACE;
+            else if ('#' == *p) spec.flags |= STREAM_ALT;
+            else if ('0' == *p) spec.flags |= STREAM_ZERO;
+            else break;
+        }
+
+        if ('*' == *p) {
+            spec.width = va_arg(args, int);
+            if (spec.width < 0) {
+                spec.flags |= STREAM_LEFT;
+                spec.width = -spec.width;
+            }
+            ++p;
+        }
+        while (*p >= '0' && *p <= '9') {
+            spec.width = spec.width * 10 + (*p++ - '0');
+        }
+
+        if ('.' == *p) {
+            spec.precision = 0;
+            if ('*' == *++p) {
+                spec.precision = va_arg(args, int);
+                if (spec.precision < 0) {
+                    spec.precision = -1;
+                }
+                ++p;
+            }
+            while (*p >= '0' && *p <= '9') {
+                spec.precision = spec.precision * 10 + (*p++ - '0');
+            }
+        }
+
+        stream_len_t length = stream_len_int;
+        switch (*p) {
+            case 'h': length = ('h' == p[1]) ? (++p, stream_len_char) : stream_len_short; ++p; break;
+            case 'l': length = ('l' == p[1]) ? (++p, stream_len_llong) : stream_len_long;  ++p; break;
+            case 'j': length = stream_len_intmax;  ++p; break;
+            case 'z': length = stream_len_size;    ++p; break;
+            case 't': length = stream_len_ptrdiff; ++p; break;
+            case 'L': length = stream_len_ldouble; ++p; break;
+            default: break;
+        }
+
+        char conv = *p;
+        if (conv) {
+            ++p;
+        }
+        if (conv >= 'A' && conv <= 'Z' && 'X' != conv) {
+            spec.flags |= STREAM_UPPER;
+            conv += 'a' - 'A';
+        }
+
+        switch (conv)
+        {
+            case 'd':
+            case 'i':
+            {
+                long long value;
+                switch (length) {
+                    case stream_len_char:    value = (signed char) va_arg(args, int);   break;
+                    case stream_len_short:   value = (short) va_arg(args, int);         break;
+                    case stream_len_long:    value = va_arg(args, long);                break;
+                    case stream_len_llong:   value = va_arg(args, long long);           break;
+                    case stream_len_intmax:  value = va_arg(args, intmax_t);            break;
+                    case stream_len_size:
+                    case stream_len_ptrdiff: value = va_arg(args, ptrdiff_t);           break;
+                    default:                 value = va_arg(args, int);                 break;
+                }
+                const bool negative = (value < 0);
+                stream_integer(&st, &spec, negative ? (0ULL - (unsigned long long) value) : (unsigned long long) value,
+                               negative, true, 10);
+                break;
+            }
+
+            case 'X':
+                spec.flags |= STREAM_UPPER;
+                /* Fall through */
+            case 'u':
+            case 'o':
+            case 'x':
+            {
+                unsigned long long value;
+                switch (length) {
+                    case stream_len_char:    value = (unsigned char) va_arg(args, unsigned);    break;
+                    case stream_len_short:   value = (unsigned short) va_arg(args, unsigned);   break;
+                    case stream_len_long:    value = va_arg(args, unsigned long);               break;
+                    case stream_len_llong:   value = va_arg(args, unsigned long long);          break;
+                    case stream_len_intmax:  value = va_arg(args, uintmax_t);                   break;
+                    case stream_len_size:
+                    case stream_len_ptrdiff: value = va_arg(args, size_t);                      break;
+                    default:                 value = va_arg(args, unsigned);                    break;
+                }
+                stream_integer(&st, &spec, value, false, false, ('u' == conv) ? 10 : ('o' == conv) ? 8 : 16);
+                break;
+            }
+
+            case 'p':
+                spec.flags |= STREAM_HEX_PREFIX;
+                stream_integer(&st, &spec, (uintptr_t) va_arg(args, void*), false, false, 16);
+                break;
+
+            case 'c':
+            {
+                const char c = (char) va_arg(args, int);
+                stream_pad_before(&st, &spec, 1, "", false);
+                stream_putc(&st, c);
+                stream_pad_after(&st, &spec, 1, "");
+                break;
+            }
+
+            case 's':
+                stream_string(&st, &spec, va_arg(args, const char*));
+                break;
+
+            case 'f':
+            case 'e':
+            case 'g':
+            {
+                const double value = (stream_len_ldouble == length) ? (double) va_arg(args, long double)
+                                                                    : va_arg(args, double);
+                stream_float(&st, &spec, value, conv);
+                break;
+            }
+
+            case 'n':
+            {
+                void *ptr = va_arg(args, void*);
+                switch (length) {
+                    case stream_len_char:  *(signed char*) ptr = st.count;  break;
+                    case stream_len_short: *(short*) ptr = st.count;        break;
+                    case stream_len_long:  *(long*) ptr = st.count;         break;
+                    case stream_len_llong: *(long long*) ptr = st.count;    break;
+                    default:               *(int*) ptr = st.count;          break;
+                }
+                break;
+            }
+
+            case '%':
+                stream_putc(&st, '%');
+                break;
+
+            default:
+                /* Unknown conversion is printed as it is */
+                stream_write(&st, start, p - start);
+                break;
+        }
+    }
+
+    stream_flush(&st);
+    return st.count;
+}
+
+int stream_printf(stream_printf_out_t out, void *arg, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int len = stream_vprintf(out, arg, format, args);
+    va_end(args);
+    return len;
+}
+
+
+
+/// Output of stream_vsnprintf() to its buffer
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t len;
+} stream_buffer_t;
+
+static bool stream_buffer_out(const char *data, uint32_t len, void *arg)
+{
+    stream_buffer_t *b = (stream_buffer_t*) arg;
+    const size_t space = b->size - 1 - b->len;
+    const size_t n = (len < space) ? len : space;
+
+    memcpy(b->buffer + b->len, data, n);
+    b->len += n;
+    return (b->len + 1 < b->size);
+}
+
+int stream_vsnprintf(char *buffer, size_t size, const char *format, va_list args)
+{
+    stream_buffer_t b = { buffer, size, 0 };
+    int len = 0;
+
+    if (size > 0) {
+        len = stream_vprintf(stream_buffer_out, &b, format, args);
+        buffer[b.len] = '\0';
+    }
+    else {
+        /* Only count the characters */
+        char c;
+        b.buffer = &c;
+        b.size = 1;
+        len = stream_vprintf(stream_buffer_out, &b, format, args);
+    }
+    return len;
+}
+
+int stream_snprintf(char *buffer, size_t size, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int len = stream_vsnprintf(buffer, size, format, args);
+    va_end(args);
+    return len;
+}
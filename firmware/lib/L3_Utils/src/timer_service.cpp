@@ -0,0 +1,140 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "timer_service.hpp"
+#include "lpc_sys.h"
+
+
+
+static TimerWheel g_timer_wheel;                ///< The timers of the service
+static TaskHandle_t g_service_task = NULL;      ///< The task that expires the timers
+static bool g_service_task_created = false;     ///< Set once the task is being created
+static TimerWheelEntry * volatile g_running_entry = NULL;  ///< The timer whose callback the service task calls
+static volatile bool g_running_skipped = false;  ///< Set if the running timer was cancelled before its callback
+
+void TimerService::add(TimerWheelEntry& entry, uint32_t delayMs, uint32_t periodMs)
+{
+    addAt(entry, sys_get_uptime_ms() + delayMs, periodMs);
+}
+
+void TimerService::addAt(TimerWheelEntry& entry, uint64_t targetMs, uint32_t periodMs)
+{
+    const uint64_t nowMs = sys_get_uptime_ms();
+    const uint32_t delayMs = (targetMs > nowMs) ? (uint32_t)(targetMs - nowMs) : 0;
+    bool createTask = false;
+
+    taskENTER_CRITICAL();
+    skipCallback(entry);
+    entry.setPeriodMs(periodMs);
+    g_timer_wheel.add(entry, (uint32_t) nowMs, delayMs);
+    createTask = !g_service_task_created;
+    g_service_task_created = true;
+    taskEXIT_CRITICAL();
+
+    /* The service task may be sleeping past the new timer, so wake it up to check again */
+    if (createTask) {
+        xTaskCreate(serviceTask, "timers", TIMER_SERVICE_STACK_SIZE, NULL, TIMER_SERVICE_PRIORITY, &g_service_task);
+    }
+    else if (g_service_task) {
+        xTaskNotifyGive(g_service_task);
+    }
+}
+
+void TimerService::cancel(TimerWheelEntry& entry)
+{
+    taskENTER_CRITICAL();
+    const bool running = skipCallback(entry);
+    g_timer_wheel.cancel(entry);
+    taskEXIT_CRITICAL();
+
+    /* The callback was preempted by this task, so let it return before the timer can be destroyed */
+    if (running && xTaskGetCurrentTaskHandle() != g_service_task) {
+        while (&entry == g_running_entry) {
+            vTaskDelay(1);
+        }
+    }
+}
+
+uint32_t TimerService::getCount(void)
+{
+    return g_timer_wheel.getCount();
+}
+
+void TimerService::notifyTask(void *pTaskHandle)
+{
+    xTaskNotifyGive((TaskHandle_t) pTaskHandle);
+}
+
+bool TimerService::skipCallback(TimerWheelEntry& entry)
+{
+    if (&entry != g_running_entry) {
+        return false;
+    }
+    g_running_skipped = true;
+    return true;
+}
+
+void TimerService::serviceTask(void *p)
+{
+    while (1)
+    {
+        uint32_t nowMs = (uint32_t) sys_get_uptime_ms();
+        TimerWheelEntry *pEntry = NULL;
+        uint32_t waitMs = 0;
+
+        /* Call the callbacks outside of the critical section; they may add or cancel timers.
+         * A periodic timer is added again here such that it keeps its period even if the callback
+         * is late, and a timer cancelled after it expired but before its callback is skipped.
+         */
+        do {
+            TimerWheelEntry expired;
+
+            taskENTER_CRITICAL();
+            if (NULL != (pEntry = g_timer_wheel.expireNext(nowMs))) {
+                expired = *pEntry;
+                if (pEntry->getPeriodMs() > 0) {
+                    g_timer_wheel.add(*pEntry, pEntry->getExpireMs(), pEntry->getPeriodMs());
+                }
+            }
+            g_running_entry = pEntry;
+            g_running_skipped = false;
+            taskEXIT_CRITICAL();
+
+            if (pEntry) {
+                if (!g_running_skipped) {
+                    expired.runCallback();
+                }
+                g_running_entry = NULL;
+            }
+        } while (pEntry);
+
+        /* The callbacks took some time, so the wait is computed from the time after them */
+        nowMs = (uint32_t) sys_get_uptime_ms();
+        taskENTER_CRITICAL();
+        waitMs = g_timer_wheel.getMsToNextCheck(nowMs);
+        taskEXIT_CRITICAL();
+
+        /* Sleep until a timer may expire, or until a timer is added */
+        if (waitMs > 0) {
+            ulTaskNotifyTake(pdTRUE, (UINT32_MAX == waitMs) ? portMAX_DELAY : OS_MS(waitMs));
+        }
+    }
+}
@@ -0,0 +1,179 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>   // memset()
+#include "timer_wheel.hpp"
+
+
+
+TimerWheel::TimerWheel(uint32_t nowMs) : mpExpired(0), mNextMs(nowMs), mCount(0)
+{
+    memset(mpSlots, 0, sizeof(mpSlots));
+}
+
+void TimerWheel::add(TimerWheelEntry& entry, uint32_t nowMs, uint32_t delayMs)
+{
+    if (entry.isPending()) {
+        cancel(entry);
+    }
+
+    /* Skip the empty slots that were not expired yet */
+    if (0 == mCount) {
+        mNextMs = nowMs;
+    }
+
+    entry.mExpireMs = nowMs + delayMs;
+    place(&entry);
+    ++mCount;
+}
+
+void TimerWheel::cancel(TimerWheelEntry& entry)
+{
+    if (entry.isPending()) {
+        unlink(&entry);
+        --mCount;
+    }
+}
+
+TimerWheelEntry* TimerWheel::expireNext(uint32_t nowMs)
+{
+    while (1)
+    {
+        if (mpExpired) {
+            TimerWheelEntry *pEntry = mpExpired;
+            unlink(pEntry);
+            --mCount;
+            return pEntry;
+        }
+
+        if (0 == mCount || (int32_t)(nowMs - mNextMs) < 0) {
+            return 0;
+        }
+
+        /* When level 0 wraps around, move the timers of the next slot of level 1 down, and so on */
+        const uint32_t index = mNextMs & kMask;
+        if (0 == index) {
+            for (uint32_t level = 1; level < kLevels; level++)
+            {
+                const uint32_t levelIndex = (mNextMs >> (kBits * level)) & kMask;
+                TimerWheelEntry *pList = 0;
+                moveList(&mpSlots[level][levelIndex], &pList);
+                while (pList) {
+                    TimerWheelEntry *pEntry = pList;
+                    unlink(pEntry);
+                    place(pEntry);
+                }
+
+                if (0 != levelIndex) {
+                    break;
+                }
+            }
+        }
+
+        moveList(&mpSlots[0][index], &mpExpired);
+        ++mNextMs;
+    }
+}
+
+uint32_t TimerWheel::advance(uint32_t nowMs)
+{
+    uint32_t count = 0;
+    TimerWheelEntry *pEntry = 0;
+
+    while (0 != (pEntry = expireNext(nowMs))) {
+        pEntry->runCallback();
+        ++count;
+    }
+
+    return count;
+}
+
+uint32_t TimerWheel::getMsToNextCheck(uint32_t nowMs) const
+{
+    if (mpExpired || (mCount > 0 && (int32_t)(nowMs - mNextMs) >= 0)) {
+        return 0;
+    }
+    if (0 == mCount) {
+        return UINT32_MAX;
+    }
+
+    /* Find the next timer of level 0 before timers of higher levels are moved down */
+    const uint32_t index = mNextMs & kMask;
+    const uint32_t toWrap = (kSlots - index) & kMask;
+    uint32_t i = 0;
+    for (i = 0; i < toWrap; i++) {
+        if (mpSlots[0][index + i]) {
+            break;
+        }
+    }
+
+    return (mNextMs + i) - nowMs;
+}
+
+void TimerWheel::place(TimerWheelEntry *pEntry)
+{
+    const int32_t delta = (int32_t)(pEntry->mExpireMs - mNextMs);
+
+    /* Timers that are due are expired by the next call to expireNext() */
+    if (delta < 0) {
+        link(&mpExpired, pEntry);
+        return;
+    }
+
+    uint32_t level = 0;
+    uint32_t slotMs = pEntry->mExpireMs;
+    while (level < (kLevels - 1) && (uint32_t)delta >= (UINT32_C(1) << (kBits * (level + 1)))) {
+        ++level;
+    }
+
+    /* Timers beyond the top level go to its last slot, and are placed again when that slot is reached */
+    if ((uint32_t)delta >= (UINT32_C(1) << (kBits * kLevels))) {
+        slotMs = mNextMs + (UINT32_C(1) << (kBits * kLevels)) - 1;
+    }
+
+    link(&mpSlots[level][(slotMs >> (kBits * level)) & kMask], pEntry);
+}
+
+void TimerWheel::link(TimerWheelEntry **ppHead, TimerWheelEntry *pEntry)
+{
+    pEntry->mpNext = *ppHead;
+    if (pEntry->mpNext) {
+        pEntry->mpNext->mppPrev = &pEntry->mpNext;
+    }
+    pEntry->mppPrev = ppHead;
+    *ppHead = pEntry;
+}
+
+void TimerWheel::unlink(TimerWheelEntry *pEntry)
+{
+    *pEntry->mppPrev = pEntry->mpNext;
+    if (pEntry->mpNext) {
+        pEntry->mpNext->mppPrev = pEntry->mppPrev;
+    }
+    pEntry->mpNext = 0;
+    pEntry->mppPrev = 0;
+}
+
+void TimerWheel::moveList(TimerWheelEntry **ppFrom, TimerWheelEntry **ppTo)
+{
+    *ppTo = *ppFrom;
+    *ppFrom = 0;
+    if (*ppTo) {
+        (*ppTo)->mppPrev = ppTo;
+    }
+}
@@ -0,0 +1,454 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>
+
+#include "tlsf.h"
+
+
+
+#define TLSF_BLOCK_FREE         ((size_t) 1)    ///< Size bit if the block is free
+#define TLSF_BLOCK_PREV_FREE    ((size_t) 2)    ///< Size bit if the previous physical block is free
+#define TLSF_BLOCK_SIZE_MASK    (~(size_t)(TLSF_ALIGN - 1))
+
+/// @returns the index of the most significant bit (size must not be zero)
+static inline int tlsf_fls(size_t size)
+{
+    return (int)(sizeof(unsigned long) * 8) - 1 - __builtin_clzl((unsigned long) size);
+}
+
+/// @returns the index of the least significant bit (word must not be zero)
+static inline int tlsf_ffs(uint32_t word)
+{
+    return __builtin_ctz(word);
+}
+
+static inline size_t tlsf_align_up(size_t size)
+{
+    return (size + TLSF_ALIGN - 1) & ~((size_t)TLSF_ALIGN - 1);
+}
+
+/// @{ Block accessors
+static inline size_t block_size(const tlsf_block_t *block)  { return block->size & TLSF_BLOCK_SIZE_MASK; }
+static inline bool block_is_free(const tlsf_block_t *block) { return 0 != (block->size & TLSF_BLOCK_FREE); }
+static inline bool block_is_prev_free(const tlsf_block_t *block) { return 0 != (block->size & TLSF_BLOCK_PREV_FREE); }
+static inline bool block_is_last(const tlsf_block_t *block) { return 0 == block_size(block); }
+
+static inline void block_set_size(tlsf_block_t *block, size_t size)
+{
+    block->size = size | (block->size & (TLSF_BLOCK_FREE | TLSF_BLOCK_PREV_FREE));
+}
+
+static inline void* block_to_ptr(const tlsf_block_t *block)
+{
+    return (void*)((uint8_t*)block + TLSF_BLOCK_OVERHEAD);
+}
+
+static inline tlsf_block_t* block_from_ptr(const void *ptr)
+{
+    return (tlsf_block_t*)((uint8_t*)ptr - TLSF_BLOCK_OVERHEAD);
+}
+
+static inline tlsf_block_t* block_next(const tlsf_block_t *block)
+{
+    return (tlsf_block_t*)((uint8_t*)block_to_ptr(block) + block_size(block));
+}
+
+/// Marks the block free or used, and updates the "previous free" bit of the next block
+static inline void block_mark_free(tlsf_block_t *block)
+{
+    tlsf_block_t *next = block_next(block);
+    next->prev_phys = block;
+    next->size |= TLSF_BLOCK_PREV_FREE;
+    block->size |= TLSF_BLOCK_FREE;
+}
+
+static inline void block_mark_used(tlsf_block_t *block)
+{
+    block_next(block)->size &= ~TLSF_BLOCK_PREV_FREE;
+    block->size &= ~TLSF_BLOCK_FREE;
+}
+/// @}
+
+/// Gets the list of the size of a free block
+static inline void tlsf_mapping_insert(size_t size, int *fl, int *sl)
+{
+    if (size < ((size_t)1 << TLSF_FL_SHIFT)) {
+        *fl = 0;
+        *sl = (int)(size >> TLSF_ALIGN_LOG2);
+    }
+    else {
+        const int bit = tlsf_fls(size);
+        *sl = (int)(size >> (bit - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = bit - (TLSF_FL_SHIFT - 1);
+    }
+}
+
+/**
+ * Gets the first list whose blocks are all large enough for the size, by rounding the
+ * size up to the next list
+ * @returns false if the size is too large
+ */
+static inline bool tlsf_mapping_search(size_t size, int *fl, int *sl)
+{
+    if (size >= ((size_t)1 << TLSF_FL_SHIFT)) {
+        size += ((size_t)1 << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+    }
+    tlsf_mapping_insert(size, fl, sl);
+    return *fl < TLSF_FL_COUNT;
+}
+
+/// @returns the first free block of the list (fl, sl) or of a larger list, or NULL
+static tlsf_block_t* tlsf_search_suitable_block(tlsf_t *tlsf, int *fl, int *sl)
+{
+    uint32_t sl_map = tlsf->sl_bitmap[*fl] & (~0U << *sl);
+
+    if (0 == sl_map) {
+        /* No block of this first level, so use the smallest block of a larger first level */
+        const uint32_t fl_map = tlsf->fl_bitmap & ((*fl + 1 < 32) ? (~0U << (*fl + 1)) : 0);
+        if (0 == fl_map) {
+            return NULL;
+        }
+        *fl = tlsf_ffs(fl_map);
+        sl_map = tlsf->sl_bitmap[*fl];
+    }
+    *sl = tlsf_ffs(sl_map);
+    return tlsf->blocks[*fl][*sl];
+}
+
+static void tlsf_remove_free_block(tlsf_t *tlsf, tlsf_block_t *block, int fl, int sl)
+{
+    tlsf_block_t *prev = block->prev_free;
+    tlsf_block_t *next = block->next_free;
+
+    next->prev_free = prev;
+    prev->next_free = next;
+
+    if (tlsf->blocks[fl][sl] == block) {
+        tlsf->blocks[fl][sl] = next;
+        if (next == &tlsf->null_block) {
+            tlsf->sl_bitmap[fl] &= ~(1U << sl);
+            if (0 == tlsf->sl_bitmap[fl]) {
+                tlsf->fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+    tlsf->free_blocks--;
+    tlsf->free_bytes -= block_size(block);
+}
+
+static void tlsf_insert_free_block(tlsf_t *tlsf, tlsf_block_t *block)
+{
+    int fl = 0, sl = 0;
+    tlsf_mapping_insert(block_size(block), &fl, &sl);
+
+    tlsf_block_t *current = tlsf->blocks[fl][sl];
+    block->next_free = current;
+    block->prev_free = &tlsf->null_block;
+    current->prev_free = block;
+
+    tlsf->blocks[fl][sl] = block;
+    tlsf->fl_bitmap |= (1U << fl);
+    tlsf->sl_bitmap[fl] |= (1U << sl);
+    tlsf->free_blocks++;
+    tlsf->free_bytes += block_size(block);
+}
+
+static inline void tlsf_remove_block(tlsf_t *tlsf, tlsf_block_t *block)
+{
+    int fl = 0, sl = 0;
+    tlsf_mapping_insert(block_size(block), &fl, &sl);
+    tlsf_remove_free_block(tlsf, block, fl, sl);
+}
+
+/**
+ * Splits the block if the remaining memory is large enough for another block
+ * @returns the remaining block, or NULL if the block was not split
+ */
+static tlsf_block_t* tlsf_split(tlsf_block_t *block, size_t size)
+{
+    const size_t remaining = block_size(block) - size;
+    tlsf_block_t *rest = NULL;
+
+    if (block_size(block) >= size + TLSF_BLOCK_OVERHEAD + TLSF_BLOCK_MIN_SIZE) {
+        rest = (tlsf_block_t*)((uint8_t*)block_to_ptr(block) + size);
+        rest->size = remaining - TLSF_BLOCK_OVERHEAD;
+        block_set_size(block, size);
+    }
+    return rest;
+}
+
+/// Merges the free block with the next block (which must be free)
+static void tlsf_merge_next(tlsf_block_t *block, tlsf_block_t *next)
+{
+    block_set_size(block, block_size(block) + TLSF_BLOCK_OVERHEAD + block_size(next));
+}
+
+/// @returns the size to allocate for the requested bytes, or zero if it is too large
+static inline size_t tlsf_adjust_size(size_t bytes)
+{
+    size_t size = tlsf_align_up(bytes);
+    if (bytes > TLSF_BLOCK_MAX_SIZE || size > TLSF_BLOCK_MAX_SIZE) {
+        return 0;
+    }
+    return (size < TLSF_BLOCK_MIN_SIZE) ? TLSF_BLOCK_MIN_SIZE : size;
+}
+
+/// Takes the used block, and gives back its unused end as a free block
+static void tlsf_trim_used(tlsf_t *tlsf, tlsf_block_t *block, size_t size)
+{
+    tlsf_block_t *rest = tlsf_split(block, size);
+    if (rest) {
+        tlsf_block_t *next = block_next(rest);
+        rest->size &= ~(TLSF_BLOCK_PREV_FREE);
+        if (block_is_free(next)) {
+            tlsf_remove_block(tlsf, next);
+            tlsf_merge_next(rest, next);
+        }
+        block_mark_free(rest);
+        tlsf_insert_free_block(tlsf, rest);
+    }
+}
+
+void tlsf_init(tlsf_t *tlsf)
+{
+    int fl = 0, sl = 0;
+
+    memset(tlsf, 0, sizeof(*tlsf));
+    tlsf->null_block.next_free = &tlsf->null_block;
+    tlsf->null_block.prev_free = &tlsf->null_block;
+    for (fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        for (sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            tlsf->blocks[fl][sl] = &tlsf->null_block;
+        }
+    }
+}
+
+bool tlsf_add_pool(tlsf_t *tlsf, void *mem, size_t bytes)
+{
+    const size_t skip = tlsf_align_up((uintptr_t)mem) - (uintptr_t)mem;
+    tlsf_block_t *block = (tlsf_block_t*)((uint8_t*)mem + skip);
+    size_t size = 0;
+
+    /* The pool is a free block followed by a used block of zero size to stop merging */
+    if (tlsf->pool_count >= TLSF_MAX_POOLS || bytes < skip + (2 * TLSF_BLOCK_OVERHEAD) + TLSF_BLOCK_MIN_SIZE) {
+        return false;
+    }
+    size = (bytes - skip - (2 * TLSF_BLOCK_OVERHEAD)) & TLSF_BLOCK_SIZE_MASK;
+    if (size > TLSF_BLOCK_MAX_SIZE) {
+        size = TLSF_BLOCK_MAX_SIZE;
+    }
+
+    block->prev_phys = NULL;
+    block->size = size;
+    block_next(block)->size = 0;
+    block_mark_free(block);
+    tlsf_insert_free_block(tlsf, block);
+
+    tlsf->pools[tlsf->pool_count++] = block;
+    tlsf->total_bytes += size;
+    tlsf->min_free_bytes = tlsf->free_bytes;
+    return true;
+}
+
+void* tlsf_malloc(tlsf_t *tlsf, size_t bytes)
+{
+    const size_t size = tlsf_adjust_size(bytes);
+    tlsf_block_t *block = NULL;
+    int fl = 0, sl = 0;
+
+    if (0 != size && tlsf_mapping_search(size, &fl, &sl)) {
+        block = tlsf_search_suitable_block(tlsf, &fl, &sl);
+    }
+    if (NULL == block) {
+        tlsf->failed_allocs++;
+        return NULL;
+    }
+
+    tlsf_remove_free_block(tlsf, block, fl, sl);
+    block_mark_used(block);
+    tlsf->used_blocks++;
+    tlsf_trim_used(tlsf, block, size);
+
+    if (tlsf->free_bytes < tlsf->min_free_bytes) {
+        tlsf->min_free_bytes = tlsf->free_bytes;
+    }
+    return block_to_ptr(block);
+}
+
+void tlsf_free(tlsf_t *tlsf, void *ptr)
+{
+    tlsf_block_t *block = NULL;
+    tlsf_block_t *next = NULL;
+
+    if (NULL == ptr) {
+        return;
+    }
+    block = block_from_ptr(ptr);
+    tlsf->used_blocks--;
+
+    /* Merge with the previous and the next blocks if they are free */
+    if (block_is_prev_free(block)) {
+        tlsf_block_t *prev = block->prev_phys;
+        tlsf_remove_block(tlsf, prev);
+        tlsf_merge_next(prev, block);
+        block = prev;
+    }
+    next = block_next(block);
+    if (block_is_free(next)) {
+        tlsf_remove_block(tlsf, next);
+        tlsf_merge_next(block, next);
+    }
+
+    block_mark_free(block);
+    tlsf_insert_free_block(tlsf, block);
+}
+
+void* tlsf_realloc(tlsf_t *tlsf, void *ptr, size_t bytes)
+{
+    tlsf_block_t *block = NULL;
+    tlsf_block_t *next = NULL;
+    size_t size = 0;
+    void *new_ptr = NULL;
+
+    if (NULL == ptr) {
+        return tlsf_malloc(tlsf, bytes);
+    }
+    size = tlsf_adjust_size(bytes);
+    if (0 == size) {
+        tlsf->failed_allocs++;
+        return NULL;
+    }
+
+    block = block_from_ptr(ptr);
+    next = block_next(block);
+
+    /* Grow in place by taking the next block if it is free and large enough */
+    if (size > block_size(block) && block_is_free(next) &&
+        size <= block_size(block) + TLSF_BLOCK_OVERHEAD + block_size(next))
+    {
+        tlsf_remove_block(tlsf, next);
+        tlsf_merge_next(block, next);
+        block_mark_used(block);
+    }
+
+    if (size <= block_size(block)) {
+        tlsf_trim_used(tlsf, block, size);
+        if (tlsf->free_bytes < tlsf->min_free_bytes) {
+            tlsf->min_free_bytes = tlsf->free_bytes;
+        }
+        return ptr;
+    }
+
+    new_ptr = tlsf_malloc(tlsf, bytes);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, block_size(block));
+        tlsf_free(tlsf, ptr);
+    }
+    return new_ptr;
+}
+
+size_t tlsf_block_size(const void *ptr)
+{
+    return ptr ? block_size(block_from_ptr(ptr)) : 0;
+}
+
+void tlsf_get_stats(const tlsf_t *tlsf, tlsf_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->total_bytes = tlsf->total_bytes;
+    stats->free_bytes = tlsf->free_bytes;
+    stats->used_bytes = tlsf->total_bytes - tlsf->free_bytes;
+    stats->min_free_bytes = tlsf->min_free_bytes;
+    stats->free_blocks = tlsf->free_blocks;
+    stats->used_blocks = tlsf->used_blocks;
+    stats->failed_allocs = tlsf->failed_allocs;
+
+    /* The largest block is in the highest non-empty list */
+    if (tlsf->fl_bitmap) {
+        const int fl = tlsf_fls(tlsf->fl_bitmap);
+        const int sl = tlsf_fls(tlsf->sl_bitmap[fl]);
+        const tlsf_block_t *block = NULL;
+
+        for (block = tlsf->blocks[fl][sl]; block != &tlsf->null_block; block = block->next_free) {
+            if (block_size(block) > stats->largest_free_block) {
+                stats->largest_free_block = block_size(block);
+            }
+        }
+    }
+    if (stats->free_bytes > 0) {
+        stats->fragmentation = 100 - (uint32_t)((100 * (uint64_t)stats->largest_free_block) / stats->free_bytes);
+    }
+}
+
+bool tlsf_check(const tlsf_t *tlsf)
+{
+    size_t free_bytes = 0;
+    uint32_t free_blocks = 0;
+    uint32_t used_blocks = 0;
+    uint32_t i = 0;
+    int fl = 0, sl = 0;
+
+    for (i = 0; i < tlsf->pool_count; i++) {
+        const tlsf_block_t *block = tlsf->pools[i];
+        bool prev_free = false;
+
+        for ( ; !block_is_last(block); block = block_next(block)) {
+            if (block_is_prev_free(block) != prev_free || (prev_free && block_next(block->prev_phys) != block)) {
+                return false;
+            }
+            prev_free = block_is_free(block);
+            if (prev_free) {
+                const tlsf_block_t *b = NULL;
+                /* Two free blocks are never next to each other, and the block is in its list */
+                if (block_is_free(block_next(block))) {
+                    return false;
+                }
+                tlsf_mapping_insert(block_size(block), &fl, &sl);
+                for (b = tlsf->blocks[fl][sl]; b != &tlsf->null_block && b != block; b = b->next_free) {
+                }
+                if (b != block) {
+                    return false;
+                }
+                free_bytes += block_size(block);
+                free_blocks++;
+            }
+            else {
+                used_blocks++;
+            }
+        }
+        if (block_is_prev_free(block) != prev_free) {
+            return false;
+        }
+    }
+
+    /* The bitmaps match the lists */
+    for (fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        for (sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            const bool empty = (tlsf->blocks[fl][sl] == &tlsf->null_block);
+            if (empty == (0 != (tlsf->sl_bitmap[fl] & (1U << sl)))) {
+                return false;
+            }
+        }
+        if ((0 == tlsf->sl_bitmap[fl]) == (0 != (tlsf->fl_bitmap & (1U << fl)))) {
+            return false;
+        }
+    }
+
+    return (free_bytes == tlsf->free_bytes && free_blocks == tlsf->free_blocks && used_blocks == tlsf->used_blocks);
+}
@@ -21,6 +21,7 @@
  * @brief Provides string class with a small foot-print
  * @ingroup Utilities
  *
+ * Version: 20261015    Added str_view overloads
  * Version: 01102013    Added eraseFirstWords()
  * Version: 05052013    Added tokenize() to get char* tokens.  Added clearAll().  Fixed str::printf()
  * Version: 02122013    Added support for str memory on a stack (external memory).
@@ -33,6 +34,8 @@
 #ifndef STR_HPP__
 #define STR_HPP__
 
+class str_view;
+
 
 
 /**
@@ -122,6 +125,7 @@ class str
         str(const char* pString);   ///< Construct from char* pointer
         str(char *buff, int size);  ///< Construct to use external memory
         str(const str& s);          ///< Copy Constructor
+        str(const str_view& v);     ///< Construct from a string view
         ~str();                     ///< Destructor
         /** @} */
 
@@ -191,6 +195,7 @@ class str
          */
         void append(const char* pString);           ///< Appends constant string pointer
         void append(const str& s) { append(s()); }  ///< Appends another str
+        void append(const str_view& v);             ///< Appends a string view
         void append(int x);                         ///< Appends integer as characters
         void append(float x);                       ///< Appends float as characters
         void appendAsHex(unsigned int num);         ///< Appends as hexadecimal ie: DEADBEEF
@@ -206,6 +211,8 @@ class str
         bool compareTo(const str& s) const { return compareTo(s.c_str()); }
         bool compareToIgnoreCase(const char* pString) const;
         bool compareToIgnoreCase(const str& s) const { return compareToIgnoreCase(s()); }
+        bool compareTo(const str_view& v) const;
+        bool compareToIgnoreCase(const str_view& v) const;
         /** @} */
 
 
@@ -361,6 +368,7 @@ class str
         void operator=(int num);              ///< Assign an int : myCStr = 123;
         void operator=(float num);            ///< Assign a float: myCStr = 1.23;
         str& operator=(const str& rhs);       ///< Assign Operator for str a = str b
+        void operator=(const str_view& v);    ///< Assign a string view (which may refer to this str)
         /** @} */
 
 
@@ -0,0 +1,287 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Provides non-owning read-only view of a string to parse without memory allocation
+ * @ingroup Utilities
+ *
+ * Version: 20261015    Initial
+ */
+#ifndef STR_VIEW_HPP__
+#define STR_VIEW_HPP__
+
+#include <stdint.h>
+#include "str.hpp"
+
+
+
+/**
+ * String view class
+ * @ingroup Utilities
+ *
+ * str_view refers to characters owned by someone else (such as a str or a char array)
+ * and never copies, allocates, or modifies them.  All operations such as trimming or
+ * tokenizing simply adjust the pointer and the length of the view, so the view does
+ * not need to be NULL terminated.  This is much faster than str::scanf() which goes
+ * through vsscanf(), and uses only a few bytes of the stack.
+ *
+ * @warning The referenced string must remain in memory while the view is used.
+ *
+ * Parsing Example:
+ * @code
+ *      CMD_HANDLER_FUNC(i2cHandler)
+ *      {
+ *          // cmdParams is "read 0x38 0x01 6"
+ *          str_view params(cmdParams);
+ *          str_view action = params.nextToken();
+ *          uint32_t addr = 0, reg = 0, count = 1;
+ *
+ *          if (action.compareToIgnoreCase("read") &&
+ *              params.nextUint(&addr, 16) && params.nextUint(&reg, 16)) {
+ *              params.nextUint(&count); // Optional parameter
+ *          }
+ *      }
+ * @endcode
+ */
+class str_view
+{
+    public:
+        /**
+         * @{ \name Constructors
+         */
+        str_view() : mpStr(""), mLen(0) { }                     ///< Empty view
+        str_view(const char* pString);                          ///< View of NULL terminated string
+        str_view(const char* pString, int len) : mpStr(pString), mLen(len > 0 ? len : 0) { }  ///< View of len chars
+        str_view(const str& s) : mpStr(s.c_str()), mLen(s.getLen()) { }                       ///< View of a str
+        /** @} */
+
+        inline int getLen() const          { return mLen; }        ///< @returns Number of characters in the view
+        inline bool isEmpty() const        { return 0 == mLen; }   ///< @returns true if the view has no characters
+        inline const char* data() const    { return mpStr; }       ///< @returns pointer to the first character (not NULL terminated)
+        inline char operator[](int i) const { return (i >= 0 && i < mLen) ? mpStr[i] : '\0'; }
+
+        /**
+         * Copies the view to a NULL terminated buffer, such as to use it as a filename.
+         * @returns false if the buffer is too small, but buffer will still contain truncated string
+         */
+        bool copyTo(char* pBuffer, int size) const;
+
+        /**
+         * @{ \name Comparison functions
+         */
+        bool compareTo(const char* pString) const;
+        bool compareTo(const str_view& v) const;
+        bool compareToIgnoreCase(const char* pString) const;
+        bool compareToIgnoreCase(const str_view& v) const;
+        bool operator==(const char* pString) const { return compareTo(pString); }
+        bool operator!=(const char* pString) const { return !compareTo(pString); }
+
+        bool beginsWith(const char* pString) const;
+        bool beginsWithIgnoreCase(const char* pString) const;
+
+        /// @see str::beginsWithWholeWord()
+        bool beginsWithWholeWord(const char* pString, char seperator=' ') const;
+        bool beginsWithWholeWordIgnoreCase(const char* pString, char seperator=' ') const;
+
+        int firstIndexOf(char c) const;   ///< @returns the index of c or -1 if not found
+        /** @} */
+
+        /**
+         * @{ \name Trimming and sub-view functions that return a new view
+         * Example: str_view("..Hello..").trim(".") --> "Hello"
+         */
+        str_view trimStart(const char* pChars = " ") const;
+        str_view trimEnd(const char* pChars = " ") const;
+        str_view trim(const char* pChars = " ") const { return trimStart(pChars).trimEnd(pChars); }
+        str_view subView(int fromIndex, int charCount = 0x7FFFFFFF) const;
+        /** @} */
+
+        /**
+         * Removes and returns the next token from the beginning of this view.
+         * Leading delimiters are skipped, and the delimiter after the token is removed.
+         * @code
+         *   str_view v("read 0x38  0x01");
+         *   v.nextToken(); // "read"
+         *   v.nextToken(); // "0x38"
+         *   v.nextToken(); // "0x01"
+         *   v.nextToken(); // "" and v is empty
+         * @endcode
+         */
+        str_view nextToken(const char* pDelimiters = " ");
+
+        /**
+         * Splits the view into at most maxTokens tokens.  Empty tokens are skipped, and
+         * the last token contains the rest of the view if there are more tokens.
+         * @returns the number of tokens stored to pTokens
+         */
+        int split(str_view* pTokens, int maxTokens, const char* pDelimiters = " ") const;
+
+        /**
+         * @{ \name Number parsing
+         * @param base  The base of the number: 10, 16, or 2.  Zero will detect the base
+         *              from "0x" or "0b" prefix and default to 10.  The prefix is optional
+         *              if the base is 16 or 2.
+         * @returns true only if the whole view is a valid number
+         */
+        bool toInt(int32_t* pValue, int base = 0) const;
+        bool toUint(uint32_t* pValue, int base = 0) const;
+        /** @} */
+
+        /**
+         * @{ \name Parse the next token as a number
+         * The token is only removed from the view if it was a valid number.
+         */
+        bool nextInt(int32_t* pValue, int base = 0, const char* pDelimiters = " ");
+        bool nextUint(uint32_t* pValue, int base = 0, const char* pDelimiters = " ");
+        /** @} */
+
+    private:
+        const char* mpStr;  ///< Pointer to the first character
+        int mLen;           ///< Number of characters in the view
+
+        /// @returns true if c is one of the characters of the NULL terminated pChars
+        static inline bool isOneOf(char c, const char* pChars)
+        {
+            while (*pChars) {
+                if (c == *pChars++) {
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+static inline void test_str_view(void)
+{
+    str_view v("  i2c read 0x38 0x01 6  ");
+    assert(24 == v.getLen());
+
+    str_view t = v.trim();
+    assert(t.compareTo("i2c read 0x38 0x01 6"));
+    assert(t.beginsWithWholeWordIgnoreCase("I2C"));
+    assert(!t.beginsWithWholeWord("i2"));
+    assert(t.beginsWith("i2"));
+
+    assert(v.nextToken().compareTo("i2c"));
+    assert(v.nextToken().compareToIgnoreCase("READ"));
+
+    uint32_t addr = 0, reg = 0, count = 0;
+    int32_t neg = 0;
+    assert(v.nextUint(&addr, 16) && 0x38 == addr);
+    assert(v.nextUint(&reg) && 1 == reg);
+    assert(v.nextUint(&count) && 6 == count);
+    assert(!v.nextUint(&count));
+    assert(v.trim().isEmpty());
+
+    assert(str_view("38").toUint(&addr, 16) && 0x38 == addr);
+    assert(str_view("0b101").toUint(&addr) && 5 == addr);
+    assert(str_view("-123").toInt(&neg) && -123 == neg);
+    assert(!str_view("12a").toInt(&neg));
+    assert(!str_view("").toInt(&neg));
+    assert(!str_view("-").toInt(&neg));
+    assert(!str_view("0x").toUint(&addr));
+    assert(!str_view("4294967296").toUint(&addr));
+
+    str_view tokens[3];
+    assert(3 == str_view("tx 0x100 8 1 2 3").split(tokens, 3));
+    assert(tokens[0] == "tx" && tokens[1] == "0x100" && tokens[2] == "8 1 2 3");
+    assert(2 == str_view("a,,b", 4).split(tokens, 3, ","));
+    assert(tokens[1] == "b");
+
+    char buffer[4];
+    assert(str_view("abc").copyTo(buffer, sizeof(buffer)));
+    assert(!str_view("abcd").copyTo(buffer, sizeof(buffer)));
+    assert(0 == strcmp(buffer, "abc"));
+
+    str s = "hello world";
+    str_view sv(s);
+    assert(sv.subView(6) == "world");
+    assert(6 == sv.firstIndexOf('w'));
+
+    str s2(sv.subView(0, 5));
+    assert(s2 == "hello");
+    s2.append(str_view(" there", 3));
+    assert(s2 == "hello th");
+    assert(s2.compareTo(str_view("hello th")));
+
+    puts("\nString View Tests Successful!");
+}
+
+#ifndef __arm__
+#include <stdio.h>
+#include <chrono>
+/// Host only benchmark of typical terminal command parsing with str::scanf() and str_view
+static inline void test_str_view_benchmark(void)
+{
+    typedef std::chrono::steady_clock clock;
+    const int count = 100 * 1000;
+    unsigned int sum = 0;
+
+    str i2c = "read 0x38 0x01 6";
+    str can = "tx 0x100 8 1 2 3 4 5 6 7 8";
+
+    clock::time_point start = clock::now();
+    for (int i = 0; i < count; i++) {
+        unsigned int addr = 0, reg = 0, n = 0, id = 0, len = 0;
+        unsigned int b[8];
+        if (i2c.beginsWithIgnoreCase("read")) {
+            i2c.scanf("%*s %0x %0x %u", &addr, &reg, &n);
+        }
+        if (can.beginsWithIgnoreCase("tx")) {
+            can.scanf("%*s %x %i", &id, &len);
+            can.scanf("%*s %*s %*s %x %x %x %x %x %x %x %x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &b[6], &b[7]);
+        }
+        sum += addr + reg + n + id + len + b[7];
+    }
+    const double scanfSec = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (int i = 0; i < count; i++) {
+        uint32_t addr = 0, reg = 0, n = 0, id = 0, len = 0;
+        uint32_t b[8];
+        str_view p(i2c);
+        if (p.nextToken().compareToIgnoreCase("read")) {
+            p.nextUint(&addr, 16) && p.nextUint(&reg, 16) && p.nextUint(&n);
+        }
+        p = str_view(can);
+        if (p.nextToken().compareToIgnoreCase("tx")) {
+            p.nextUint(&id, 16) && p.nextUint(&len);
+            for (int j = 0; j < 8 && p.nextUint(&b[j], 16); j++) {
+            }
+        }
+        sum += addr + reg + n + id + len + b[7];
+    }
+    const double viewSec = std::chrono::duration<double>(clock::now() - start).count();
+
+    printf("\nstr::scanf() parse x %i : %.3f ms", count, scanfSec * 1000);
+    printf("\nstr_view    parse x %i : %.3f ms [%u]", count, viewSec * 1000, sum);
+    puts("");
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#endif /* STR_VIEW_HPP__ */
@@ -0,0 +1,269 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief printf() engine that streams the output in chunks, used by CharDev, str and the file logger
+ * @ingroup Utilities
+ *
+ * The text is formatted into a small chunk on the stack, and the chunk is passed to an
+ * output function whenever it fills up.  Literal text of the format string longer than a
+ * chunk is passed straight from the format string.  So the output of any length needs no
+ * heap memory and no buffer for the whole message, and the stack use is bounded, plus the
+ * stack of the output function :
+ *  - The chunk (STREAM_PRINTF_CHUNK_SIZE) and the state of the conversions.
+ *  - The digits of %f, %e and %g are exact, like the C library, which takes two big integers
+ *    of 148 bytes, but only in the function that %f, %e and %g call.
+ * test_stream_printf_benchmark() measures the stack on the host : on x86-64 it is 968 bytes
+ * with floats and 776 bytes without, where snprintf() of glibc takes 2720 bytes.
+ *
+ * Supported : %d %i %u %o %x %X %c %s %p %f %F %e %E %g %G %% %n, the flags "-+ #0", the width
+ * and precision (including '*'), and the lengths hh h l ll j z t L.
+ * Floating-point numbers are exact to 17 significant digits, and the digits beyond that
+ * are printed as zeros.  Unknown conversions are printed as they are.
+ *
+ * 20261016 : Initial
+ */
+#ifndef STREAM_PRINTF_H__
+#define STREAM_PRINTF_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+
+
+#ifndef STREAM_PRINTF_CHUNK_SIZE
+#define STREAM_PRINTF_CHUNK_SIZE    32  ///< Bytes formatted on the stack before the output function is called
+#endif
+
+/**
+ * Function that receives the formatted text
+ * @param data  The text, which is not null terminated
+ * @param len   The length of the text
+ * @param arg   The argument given to stream_vprintf()
+ * @returns false to discard the rest of the output
+ */
+typedef bool (*stream_printf_out_t)(const char *data, uint32_t len, void *arg);
+
+/**
+ * Formats the text and passes it to the output function in chunks
+ * @returns the number of characters formatted, like printf(), even if the output function stopped
+ */
+int stream_vprintf(stream_printf_out_t out, void *arg, const char *format, va_list args);
+int stream_printf(stream_printf_out_t out, void *arg, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * Same as vsnprintf() and snprintf(), with the formatter above
+ * @returns the length of the complete text, which is size or more if it was truncated
+ */
+int stream_vsnprintf(char *buffer, size_t size, const char *format, va_list args);
+int stream_snprintf(char *buffer, size_t size, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/// Output function of the tests that appends to a string
+static inline bool test_stream_printf_out(const char *data, uint32_t len, void *arg)
+{
+    char *s = (char*) arg;
+    strncat(s, data, len);
+    return true;
+}
+
+/// Compares the text of stream_vsnprintf() and stream_vprintf() with vsnprintf() of the C library
+static inline void test_stream_printf_check(const char *format, ...)
+{
+    char expected[400], actual[400], streamed[400] = "";
+    va_list args, args2, args3;
+    va_start(args, format);
+    va_copy(args2, args);
+    va_copy(args3, args);
+    const int expected_len = vsnprintf(expected, sizeof(expected), format, args);
+    const int actual_len = stream_vsnprintf(actual, sizeof(actual), format, args2);
+    const int streamed_len = stream_vprintf(test_stream_printf_out, streamed, format, args3);
+    va_end(args3);
+    va_end(args2);
+    va_end(args);
+
+    if (expected_len != actual_len || 0 != strcmp(expected, actual)) {
+        printf("'%s' : expected '%s' (%i), got '%s' (%i)\n", format, expected, expected_len, actual, actual_len);
+        assert(0);
+    }
+    assert(streamed_len == actual_len && 0 == strcmp(actual, streamed));
+}
+
+static inline void test_stream_printf(void)
+{
+    const double inf = __builtin_inf();
+    char buf[128];
+    int n = 0;
+
+    /* Integers */
+    test_stream_printf_check("%d %i %u %x %X %o %c %%", -123, 456, 789u, 0xbeefu, 0xBEEFu, 0755u, 'z');
+    test_stream_printf_check("[%5d] [%-5d] [%05d] [%+d] [% d] [%+05d] [%.3d] [%8.3d] [%-8.3d|", 42, 42, 42, 42, 42, -42, 7, -7, 7);
+    test_stream_printf_check("[%#x] [%#X] [%#o] [%#o] [%#x] [%#08x] [%.0d] [%.0x] [%5.0d]", 255u, 255u, 8u, 0u, 0u, 255u, 0, 0u, 0);
+    test_stream_printf_check("%hhd %hhu %hd %hu %ld %lu %lld %llu %llx", (signed char)-5, (unsigned char)250, (short)-30000,
+                             (unsigned short)60000, -2147483647L, 4294967295UL, -9223372036854775807LL,
+                             18446744073709551615ULL, 0x123456789abcdefULL);
+    test_stream_printf_check("%zu %td %jd %*d %-*d %.*d %*.*d", (size_t)12345, (ptrdiff_t)-6, (intmax_t)-7, 6, 1, 6, 2, 4, 3, 8, 5, 4);
+    test_stream_printf_check("%d %d %u", 0, -2147483647 - 1, 0u);
+
+    /* Strings, chars and pointers */
+    test_stream_printf_check("[%s] [%10s] [%-10s] [%.3s] [%10.2s] [%c] [%3c] [%-3c]", "hello", "hi", "hi", "hello", "hello", 'a', 'b', 'c');
+    test_stream_printf_check("[%s] [%.2s]", "", "a");
+    test_stream_printf_check("%p", (void*) buf);
+
+    /* Floating-point */
+    test_stream_printf_check("%f %f %f %f %f", 0.0, 1.0, -1.5, 3.14159265358979, 123456.789);
+    test_stream_printf_check("%.0f %.0f %.0f %.0f %.1f %.2f %.2f %.3f", 0.5, 1.5, 2.5, 0.4, 0.05, 0.125, 2.675, 1e-5);
+    test_stream_printf_check("[%10.3f] [%-10.3f] [%010.3f] [%+.2f] [% .2f] [%#.0f] [%08.2f]", 3.14159, 3.14159, -3.14159, 2.0, 2.0, 3.0, -1.5);
+    test_stream_printf_check("%f %.10f %.15f %f", 1e15, 1.0 / 3, 0.1, 9.9999999);
+    test_stream_printf_check("%f %.0f", 1e20, 12345678901234567.0);
+    test_stream_printf_check("%e %E %.0e %.2e %#.0e %12.3e %-12.3e| %e %e", 12345.678, 0.000123, 5.5, 9.999, 2.0, -1.5, 1.5, 1e100, 1e-100);
+    test_stream_printf_check("%e %e %e", 0.0, 1.7976931348623157e308, 2.2250738585072014e-308);
+    test_stream_printf_check("%g %g %g %g %g %g %g %g", 0.0, 1.0, 100000.0, 1000000.0, 0.0001, 0.00001, 123.456, 1e-10);
+    test_stream_printf_check("%.3g %.10g %#g %#.3g %G %g %.0g %10.4g|", 3.14159, 1.0 / 3, 1.0, 100.0, 1e-20, 0.5, 25.0, 2.5);
+    test_stream_printf_check("%g %g %g", 999999.5, 9.9999995, 0.00009999995);
+    test_stream_printf_check("%f %F %e %g %5f %-5f| %+f %05f", inf, inf, -inf, inf, inf, inf, inf, -inf);
+    test_stream_printf_check("%f %e %g", -0.0, -0.0, -0.0);
+    assert(3 == stream_snprintf(buf, sizeof(buf), "%f", __builtin_nan("")) && 0 == strcmp("nan", buf));
+    assert(3 == stream_snprintf(buf, sizeof(buf), "%G", __builtin_nan("")) && 0 == strcmp("NAN", buf));
+
+    /* Truncation, %n and unknown conversions */
+    assert(11 == stream_snprintf(buf, 6, "hello world") && 0 == strcmp("hello", buf));
+    assert(3 == stream_snprintf(buf, 1, "abc") && 0 == buf[0]);
+    assert(3 == stream_snprintf(NULL, 0, "abc"));
+    const char *unknown = "%k%d";
+    assert(6 == stream_snprintf(buf, sizeof(buf), "abc%n de", &n) && 3 == n);
+    assert(3 == stream_snprintf(buf, sizeof(buf), unknown, 1) && 0 == strcmp("%k1", buf));
+
+    /* Output of more than a chunk is passed in pieces */
+    buf[0] = '\0';
+    assert(69 == stream_printf(test_stream_printf_out, buf, "%s|%50d|%s", "0123456789", 7, "abcdefg"));
+    assert(0 == strncmp(buf, "0123456789|", 11) && 69 == strlen(buf) && 0 == strcmp(buf + 60, "7|abcdefg"));
+
+    puts("\nStream printf Tests Successful!");
+}
+
+#ifndef __arm__
+#include <time.h>
+#include <ucontext.h>
+
+static ucontext_t g_test_stream_printf_main_ctx, g_test_stream_printf_fn_ctx;
+static void (*g_test_stream_printf_fn)(void);
+static void test_stream_printf_run_fn(void)
+{
+    g_test_stream_printf_fn();
+}
+
+/// @returns the bytes of stack used by fn(), measured with a painted stack like uxTaskGetStackHighWaterMark()
+static inline size_t test_stream_printf_stack_use(void (*fn)(void))
+{
+    static uint8_t stack[64 * 1024];
+    size_t unused = 0;
+
+    memset(stack, 0xA5, sizeof(stack));
+    getcontext(&g_test_stream_printf_fn_ctx);
+    g_test_stream_printf_fn_ctx.uc_stack.ss_sp = stack;
+    g_test_stream_printf_fn_ctx.uc_stack.ss_size = sizeof(stack);
+    g_test_stream_printf_fn_ctx.uc_link = &g_test_stream_printf_main_ctx;
+    g_test_stream_printf_fn = fn;
+    makecontext(&g_test_stream_printf_fn_ctx, test_stream_printf_run_fn, 0);
+    swapcontext(&g_test_stream_printf_main_ctx, &g_test_stream_printf_fn_ctx);
+
+    while (unused < sizeof(stack) && 0xA5 == stack[unused]) {
+        unused++;
+    }
+    return sizeof(stack) - unused;
+}
+
+static uint32_t g_test_stream_printf_bytes;
+static bool test_stream_printf_null_out(const char *data, uint32_t len, void *arg)
+{
+    (void) data;
+    (void) arg;
+    g_test_stream_printf_bytes += len;
+    return true;
+}
+
+#define TEST_STREAM_PRINTF_FMT  "Sensor %i reading %u at %.2f volts, %s %08X\n"
+#define TEST_STREAM_PRINTF_ARGS 12, 3456u, 3.3, "status ok", 0xBEEFu
+
+static void test_stream_printf_stack_vsnprintf(void)
+{
+    char text[128];
+    snprintf(text, sizeof(text), TEST_STREAM_PRINTF_FMT, TEST_STREAM_PRINTF_ARGS);
+}
+static void test_stream_printf_stack_stream(void)
+{
+    stream_printf(test_stream_printf_null_out, NULL, TEST_STREAM_PRINTF_FMT, TEST_STREAM_PRINTF_ARGS);
+}
+static void test_stream_printf_stack_stream_int(void)
+{
+    stream_printf(test_stream_printf_null_out, NULL, "Sensor %i reading %u, %s %08X\n", 12, 3456u, "status ok", 0xBEEFu);
+}
+
+/// Host only benchmark of the formatter and vsnprintf() of the C library, and their stack use
+static inline void test_stream_printf_benchmark(void)
+{
+    const int count = 500 * 1000;
+    char text[128];
+    int i;
+
+    clock_t start = clock();
+    for (i = 0; i < count; i++) {
+        snprintf(text, sizeof(text), TEST_STREAM_PRINTF_FMT, i, 3456u + i, 3.3, "status ok", 0xBEEFu);
+    }
+    const double libc_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < count; i++) {
+        stream_snprintf(text, sizeof(text), TEST_STREAM_PRINTF_FMT, i, 3456u + i, 3.3, "status ok", 0xBEEFu);
+    }
+    const double snprintf_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < count; i++) {
+        stream_printf(test_stream_printf_null_out, NULL, TEST_STREAM_PRINTF_FMT, i, 3456u + i, 3.3, "status ok", 0xBEEFu);
+    }
+    const double stream_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("\nC library snprintf() : %6.1f ns/call, %5u bytes of stack", libc_sec * 1e9 / count,
+           (unsigned) test_stream_printf_stack_use(test_stream_printf_stack_vsnprintf));
+    printf("\nstream_snprintf()    : %6.1f ns/call", snprintf_sec * 1e9 / count);
+    printf("\nstream_printf()      : %6.1f ns/call, %5u bytes of stack (%u bytes without floats)\n", stream_sec * 1e9 / count,
+           (unsigned) test_stream_printf_stack_use(test_stream_printf_stack_stream),
+           (unsigned) test_stream_printf_stack_use(test_stream_printf_stack_stream_int));
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* STREAM_PRINTF_H__ */
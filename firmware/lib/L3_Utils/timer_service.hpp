@@ -0,0 +1,269 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Timer service that expires TimerWheel timers from a FreeRTOS task
+ * @ingroup Utilities
+ *
+ * The service is a task that sleeps until the next timer of the wheel may expire, using
+ * sys_get_uptime_ms() as the time.  Adding and cancelling a timer is O(1) in a critical section,
+ * and the callbacks are called by the service task outside of the critical section.
+ * The task is created when the first timer is added.
+ *
+ * The service remembers the timer whose callback it is calling, so a timer that is cancelled
+ * by another task does not call back after cancel() returns, and can be destroyed then.
+ * Periodic timers are added again by the service when they expire, before their callback.
+ *
+ * @see SoftTimer::resetWithCallback() and SoftTimer::resetWithNotify() to use the service
+ *      with a SoftTimer instead of polling SoftTimer::expired()
+ *
+ * Version: 20261015  Initial
+ */
+#ifndef TIMER_SERVICE_HPP_
+#define TIMER_SERVICE_HPP_
+
+#include <stdint.h>
+#include "timer_wheel.hpp"
+
+
+
+#define TIMER_SERVICE_PRIORITY      PRIORITY_HIGH       ///< Priority of the service task that calls the callbacks
+#define TIMER_SERVICE_STACK_SIZE    STACK_BYTES(1024)   ///< Stack size of the service task
+
+
+
+/**
+ * The timer service.
+ * The callbacks run in the service task, so they should be short and must not block.
+ * The methods use a critical section, so they must not be used from an interrupt.
+ *
+ * @code
+ *      static void ledOff(void *p) { ... }
+ *      static TimerWheelEntry timer(ledOff, NULL);
+ *      TimerService::add(timer, 500);  // ledOff() is called in 500ms
+ * @endcode
+ */
+class TimerService
+{
+    public:
+        /**
+         * Adds the timer to the service, or moves it if it was added already.
+         * @param entry     The timer, which must stay in memory until it expires or is cancelled
+         * @param delayMs   The time from now when the timer expires
+         * @param periodMs  If non-zero, the timer expires again every periodMs after the first time
+         */
+        static void add(TimerWheelEntry& entry, uint32_t delayMs, uint32_t periodMs=0);
+
+        /**
+         * Adds the timer to the service to expire at an absolute time
+         * @param entry     The timer, which must stay in memory until it expires or is cancelled
+         * @param targetMs  The time when the timer expires with respect to sys_get_uptime_ms()
+         * @param periodMs  If non-zero, the timer expires again every periodMs after targetMs
+         */
+        static void addAt(TimerWheelEntry& entry, uint64_t targetMs, uint32_t periodMs=0);
+
+        /**
+         * Cancels the timer such that it will not expire.  If its callback is running in the service
+         * task, this waits until the callback returns, unless this is called by the callback itself.
+         */
+        static void cancel(TimerWheelEntry& entry);
+
+        /// @returns the number of timers in the service
+        static uint32_t getCount(void);
+
+        /**
+         * Callback that gives a task notification to the task given as the argument
+         * @code
+         *      TimerWheelEntry timeout(TimerService::notifyTask, xTaskGetCurrentTaskHandle());
+         *      TimerService::add(timeout, 100);
+         *      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+         * @endcode
+         */
+        static void notifyTask(void *pTaskHandle);
+
+    private:
+        /// The service task
+        static void serviceTask(void *p);
+
+        /**
+         * Skips the callback of the timer if the service task expired it, but did not call it yet
+         * @returns true if the service task is calling the callback of the timer
+         */
+        static bool skipCallback(TimerWheelEntry& entry);
+};
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lpc_sys.h"
+
+/// Test callback that records the order and the time of the expired timers
+static volatile uint32_t g_test_timer_service_fired = 0;
+static uint32_t g_test_timer_service_order[4];
+static uint64_t g_test_timer_service_ms[4];
+static inline void test_timer_service_callback(void *pArg)
+{
+    const uint32_t i = g_test_timer_service_fired;
+    g_test_timer_service_order[i] = (uint32_t) (uintptr_t) pArg;
+    g_test_timer_service_ms[i] = sys_get_uptime_ms();
+    g_test_timer_service_fired = i + 1;
+}
+
+/// Test callback that takes a long time, such as a callback that is preempted
+static inline void test_timer_service_slow_callback(void *pArg)
+{
+    const uint64_t start = sys_get_uptime_ms();
+    test_timer_service_callback(pArg);
+    while (sys_get_uptime_ms() - start < 30) {
+        ;
+    }
+}
+
+/// Function that a task with a higher priority than the service calls while a callback is busy
+static void (*gp_test_timer_service_preempt)(void *pArg) = 0;
+static void *gp_test_timer_service_preempt_arg = 0;
+static TaskHandle_t g_test_timer_service_preempt_task = 0;
+static volatile bool g_test_timer_service_busy = false;
+static volatile bool g_test_timer_service_busy_after_preempt = false;
+static void test_timer_service_preempt_task(void *p)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        gp_test_timer_service_preempt(gp_test_timer_service_preempt_arg);
+        g_test_timer_service_busy_after_preempt = g_test_timer_service_busy;
+    }
+}
+
+/// Sets the function that preempts test_timer_service_busy_callback()
+static inline void test_timer_service_set_preempt(void (*pFunc)(void *pArg), void *pArg)
+{
+    if (!g_test_timer_service_preempt_task) {
+        xTaskCreate(test_timer_service_preempt_task, "preempt", STACK_BYTES(2048), NULL,
+                    PRIORITY_CRITICAL, &g_test_timer_service_preempt_task);
+    }
+    gp_test_timer_service_preempt = pFunc;
+    gp_test_timer_service_preempt_arg = pArg;
+    g_test_timer_service_busy_after_preempt = true;
+}
+
+/// Test callback that is preempted by the function set by test_timer_service_set_preempt()
+static inline void test_timer_service_busy_callback(void *pArg)
+{
+    test_timer_service_callback(pArg);
+    g_test_timer_service_busy = true;
+    xTaskNotifyGive(g_test_timer_service_preempt_task);
+
+    const uint64_t start = sys_get_uptime_ms();
+    while (sys_get_uptime_ms() - start < 10) {
+        ;
+    }
+    g_test_timer_service_busy = false;
+}
+
+static inline void test_timer_service_cancel(void *pEntry)
+{
+    TimerService::cancel(*(TimerWheelEntry*) pEntry);
+}
+
+/**
+ * Tests the service with the OS running.  This has to be called by a task with a lower priority
+ * than TIMER_SERVICE_PRIORITY, and while no other timers are added or expire.
+ */
+static inline void test_timer_service(void)
+{
+    const uint32_t tolerance = 5;
+    const uint32_t delays[] = { 30, 10, 20, 40 };
+    const uint32_t count = TimerService::getCount();
+    TimerWheelEntry e[4];
+
+    /* The timers expire in the order of their time, and a cancelled timer does not expire */
+    uint64_t start = sys_get_uptime_ms();
+    for (uint32_t i = 0; i < 4; i++) {
+        e[i].setCallback(test_timer_service_callback, (void*) (uintptr_t) i);
+        TimerService::add(e[i], delays[i]);
+    }
+    assert(count + 4 == TimerService::getCount());
+    TimerService::cancel(e[3]);
+    assert(count + 3 == TimerService::getCount());
+
+    vTaskDelay(OS_MS(60));
+    assert(3 == g_test_timer_service_fired);
+    assert(1 == g_test_timer_service_order[0] && 2 == g_test_timer_service_order[1] && 0 == g_test_timer_service_order[2]);
+    for (uint32_t i = 0; i < 3; i++) {
+        const uint64_t elapsed = g_test_timer_service_ms[i] - start;
+        const uint32_t delay = delays[g_test_timer_service_order[i]];
+        assert(elapsed >= delay && elapsed <= delay + tolerance);
+    }
+    assert(!e[3].isPending() && count == TimerService::getCount());
+
+    /* A timer added while the service sleeps wakes it up to expire on time */
+    g_test_timer_service_fired = 0;
+    TimerService::add(e[3], 1000);
+    vTaskDelay(OS_MS(5));
+    start = sys_get_uptime_ms();
+    TimerService::add(e[0], 5);
+    vTaskDelay(OS_MS(20));
+    assert(1 == g_test_timer_service_fired && 0 == g_test_timer_service_order[0]);
+    assert(g_test_timer_service_ms[0] - start <= 5 + tolerance);
+    TimerService::cancel(e[3]);
+
+    /* A timer that became due during a slow callback expires right after the callback */
+    g_test_timer_service_fired = 0;
+    e[1].setCallback(test_timer_service_slow_callback, (void*) (uintptr_t) 1);
+    start = sys_get_uptime_ms();
+    TimerService::add(e[1], 5);
+    TimerService::add(e[2], 15);
+    vTaskDelay(OS_MS(60));
+    assert(2 == g_test_timer_service_fired && 2 == g_test_timer_service_order[1]);
+    assert(g_test_timer_service_ms[1] - start <= 35 + tolerance);
+    assert(count == TimerService::getCount());
+
+    /* A periodic timer is added again by the service */
+    g_test_timer_service_fired = 0;
+    e[0].setCallback(test_timer_service_callback, (void*) (uintptr_t) 0);
+    start = sys_get_uptime_ms();
+    TimerService::add(e[0], 10, 10);
+    vTaskDelay(OS_MS(45));
+    assert(4 == g_test_timer_service_fired && e[0].isPending());
+    for (uint32_t i = 0; i < 4; i++) {
+        const uint64_t elapsed = g_test_timer_service_ms[i] - start;
+        assert(elapsed >= 10 * (i + 1) && elapsed <= 10 * (i + 1) + tolerance);
+    }
+    TimerService::cancel(e[0]);
+
+    /* Cancelling a periodic timer while its callback runs waits for the callback, and it does not expire again */
+    g_test_timer_service_fired = 0;
+    e[0].setCallback(test_timer_service_busy_callback, (void*) (uintptr_t) 0);
+    test_timer_service_set_preempt(test_timer_service_cancel, &e[0]);
+    TimerService::add(e[0], 5, 5);
+    vTaskDelay(OS_MS(40));
+    assert(1 == g_test_timer_service_fired && !g_test_timer_service_busy_after_preempt);
+    assert(!e[0].isPending() && count == TimerService::getCount());
+
+    puts("\nTimer Service Tests Successful!");
+}
+#endif /* #ifdef TESTING */
+
+
+
+#endif /* TIMER_SERVICE_HPP_ */
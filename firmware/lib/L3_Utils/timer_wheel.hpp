@@ -0,0 +1,352 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Hierarchical timing wheel to run many timers with O(1) insert, cancel and expire
+ * @ingroup Utilities
+ *
+ * The wheel has 4 levels of 64 slots.  Level 0 has a slot for each millisecond of the next 64ms,
+ * level 1 has a slot for each 64ms of the next 4 seconds, and so on up to 4.6 hours.  A timer is
+ * linked to the slot of its expiration time, and when the time reaches the start of a slot of a
+ * higher level, the timers of that slot are moved down to the lower level.  So each timer is moved
+ * at most 3 times regardless of the number of timers, and time never needs to be compared
+ * between timers.  Timers longer than 4.6 hours are moved again when they reach the top level.
+ *
+ * The wheel is not thread-safe; @see TimerService for the FreeRTOS service that uses it.
+ *
+ * Version: 20261015  Initial
+ */
+#ifndef TIMER_WHEEL_HPP_
+#define TIMER_WHEEL_HPP_
+
+#include <stdint.h>
+
+
+
+/// Function called when a timer expires
+typedef void (*TimerWheelCallback_t)(void *pArg);
+
+/**
+ * A timer of the TimerWheel.
+ * The timer is linked into the wheel, so it must stay in memory while it is added to the wheel.
+ */
+class TimerWheelEntry
+{
+    public:
+        TimerWheelEntry(TimerWheelCallback_t pCallback = 0, void *pArg = 0) :
+            mpNext(0), mppPrev(0), mExpireMs(0), mPeriodMs(0), mpCallback(pCallback), mpArg(pArg) {}
+
+        /// Copies the callback only; the copy is not added to the wheel
+        TimerWheelEntry(const TimerWheelEntry& copy) :
+            mpNext(0), mppPrev(0), mExpireMs(0), mPeriodMs(0), mpCallback(copy.mpCallback), mpArg(copy.mpArg) {}
+        TimerWheelEntry& operator=(const TimerWheelEntry& copy)
+        {
+            mpCallback = copy.mpCallback;
+            mpArg = copy.mpArg;
+            return *this;
+        }
+
+        /// Sets the function called when the timer expires
+        inline void setCallback(TimerWheelCallback_t pCallback, void *pArg) { mpCallback = pCallback; mpArg = pArg; }
+
+        /// Calls the callback function
+        inline void runCallback(void) const { if (mpCallback) { mpCallback(mpArg); } }
+
+        /// @returns true if the callback is set
+        inline bool hasCallback(void) const { return (0 != mpCallback); }
+
+        /// @returns true if the timer is added to the wheel and has not expired yet
+        inline bool isPending(void) const { return (0 != mppPrev); }
+
+        /// @returns the time when the timer expires (or expired)
+        inline uint32_t getExpireMs(void) const { return mExpireMs; }
+
+        /// Sets the period after which the TimerService adds the timer again, 0 for a one-shot timer
+        inline void setPeriodMs(uint32_t periodMs) { mPeriodMs = periodMs; }
+
+        /// @returns the period of the timer, 0 for a one-shot timer
+        inline uint32_t getPeriodMs(void) const { return mPeriodMs; }
+
+    private:
+        friend class TimerWheel;
+
+        TimerWheelEntry *mpNext;        ///< Next timer in the slot
+        TimerWheelEntry **mppPrev;      ///< The pointer that points to this timer, NULL if not in the wheel
+        uint32_t mExpireMs;             ///< The time when the timer expires
+        uint32_t mPeriodMs;             ///< The period used by the TimerService, the wheel itself ignores it
+        TimerWheelCallback_t mpCallback;///< The function called when the timer expires
+        void *mpArg;                    ///< The argument of the function
+};
+
+/**
+ * Hierarchical timing wheel.
+ * Time is in milliseconds and may wrap around, so timers have to be less than 24 days.
+ *
+ * @code
+ *      TimerWheel wheel(now);
+ *      TimerWheelEntry timer(callback, pArg);
+ *      wheel.add(timer, now, 100);
+ *
+ *      // Periodically, or after getMsToNextCheck() :
+ *      wheel.advance(now);
+ * @endcode
+ */
+class TimerWheel
+{
+    public:
+        /// Constructor that sets the current time
+        TimerWheel(uint32_t nowMs = 0);
+
+        /**
+         * Adds the timer to the wheel, or moves it if it was added already.
+         * @param entry    The timer
+         * @param nowMs    The current time
+         * @param delayMs  The time from now when the timer expires
+         */
+        void add(TimerWheelEntry& entry, uint32_t nowMs, uint32_t delayMs);
+
+        /// Removes the timer from the wheel such that it will not expire
+        void cancel(TimerWheelEntry& entry);
+
+        /**
+         * Removes the next timer that has expired at the given time.
+         * This is useful to call the callbacks outside of a lock that protects the wheel.
+         * @returns the timer, or NULL if no more timers have expired
+         */
+        TimerWheelEntry* expireNext(uint32_t nowMs);
+
+        /**
+         * Calls the callback of all of the timers that expired at the given time.
+         * The callbacks may add or cancel timers.
+         * @returns the number of timers that expired
+         */
+        uint32_t advance(uint32_t nowMs);
+
+        /**
+         * @returns the time until expireNext() or advance() needs to be called again, which
+         *          is at most 64ms if timers are pending, or UINT32_MAX if no timers are pending.
+         */
+        uint32_t getMsToNextCheck(uint32_t nowMs) const;
+
+        /// @returns the number of timers in the wheel
+        inline uint32_t getCount(void) const { return mCount; }
+
+    private:
+        static const uint32_t kBits = 6;
+        static const uint32_t kSlots = (1 << kBits);
+        static const uint32_t kMask = (kSlots - 1);
+        static const uint32_t kLevels = 4;
+
+        /// Links the timer into the slot of its expiration time
+        void place(TimerWheelEntry *pEntry);
+
+        /// Links the timer at the front of the list
+        static void link(TimerWheelEntry **ppHead, TimerWheelEntry *pEntry);
+
+        /// Unlinks the timer from its list
+        static void unlink(TimerWheelEntry *pEntry);
+
+        /// Moves the list of timers to another list
+        static void moveList(TimerWheelEntry **ppFrom, TimerWheelEntry **ppTo);
+
+        TimerWheelEntry *mpSlots[kLevels][kSlots];  ///< The lists of the timers of each slot
+        TimerWheelEntry *mpExpired;                 ///< Timers that expired, but not returned by expireNext() yet
+        uint32_t mNextMs;                           ///< The next time (slot) that has not been expired
+        uint32_t mCount;                            ///< The number of timers in the wheel
+};
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Test callback that checks that the timer expires exactly at its time
+static uint32_t g_test_timer_wheel_now = 0;
+static uint32_t g_test_timer_wheel_fired = 0;
+static inline void test_timer_wheel_callback(void *pArg)
+{
+    const TimerWheelEntry *e = (const TimerWheelEntry*) pArg;
+    assert(e->getExpireMs() == g_test_timer_wheel_now);
+    ++g_test_timer_wheel_fired;
+}
+
+static TimerWheel *gp_test_timer_wheel = 0;
+static inline void test_timer_wheel_periodic(void *pArg)
+{
+    TimerWheelEntry *e = (TimerWheelEntry*) pArg;
+    test_timer_wheel_callback(pArg);
+    gp_test_timer_wheel->add(*e, g_test_timer_wheel_now, 7);
+}
+
+static inline void test_timer_wheel(void)
+{
+    const uint32_t start = 0xFFFFF000;  // Wraps around during the test
+    TimerWheel w(start);
+    const uint32_t delays[] = { 0, 1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300000 };
+    const int n = sizeof(delays) / sizeof(delays[0]);
+    TimerWheelEntry e[n];
+
+    assert(0xFFFFFFFF == w.getMsToNextCheck(start));
+    for (int i = 0; i < n; i++) {
+        e[i].setCallback(test_timer_wheel_callback, &e[i]);
+        w.add(e[i], start, delays[i]);
+        assert(e[i].isPending());
+    }
+    assert(n == (int) w.getCount());
+
+    /* Each timer expires exactly at its time when the wheel is advanced every ms */
+    for (g_test_timer_wheel_now = start; g_test_timer_wheel_now != start + 300001; g_test_timer_wheel_now++) {
+        w.advance(g_test_timer_wheel_now);
+    }
+    assert(n == (int) g_test_timer_wheel_fired);
+    assert(0 == w.getCount());
+
+    /* Cancelled timers do not expire, and added timers can be moved */
+    g_test_timer_wheel_fired = 0;
+    const uint32_t now = g_test_timer_wheel_now;
+    w.add(e[0], now, 100);
+    w.add(e[1], now, 5000);
+    w.add(e[2], now, 10);
+    w.cancel(e[1]);
+    w.add(e[2], now, 200);
+    assert(!e[1].isPending() && 2 == w.getCount());
+    assert(0 == w.advance(now));
+    assert(w.getMsToNextCheck(now) > 0 && w.getMsToNextCheck(now) <= 64);
+
+    /* Advancing by a large step expires the timers that are due */
+    g_test_timer_wheel_now = now + 150;
+    assert(0 == w.getMsToNextCheck(g_test_timer_wheel_now));
+    TimerWheelEntry *pExpired = w.expireNext(now + 150);
+    assert(&e[0] == pExpired && !e[0].isPending());
+    assert(0 == w.expireNext(now + 150));
+    g_test_timer_wheel_now = now + 200;
+    assert(1 == w.advance(now + 200));
+    assert(1 == g_test_timer_wheel_fired);
+
+    /* A callback can add its timer again to make it periodic */
+    TimerWheelEntry p(test_timer_wheel_periodic, 0);
+    p.setCallback(test_timer_wheel_periodic, &p);
+    gp_test_timer_wheel = &w;
+    g_test_timer_wheel_fired = 0;
+    w.add(p, g_test_timer_wheel_now, 7);
+    for (int i = 0; i < 70; i++) {
+        w.advance(++g_test_timer_wheel_now);
+    }
+    assert(10 == g_test_timer_wheel_fired);
+    w.cancel(p);
+
+    /* Random timers compared against the expected expiration times */
+    static TimerWheelEntry r[1000];
+    g_test_timer_wheel_fired = 0;
+    const uint32_t rstart = g_test_timer_wheel_now;
+    for (int i = 0; i < 1000; i++) {
+        r[i].setCallback(test_timer_wheel_callback, &r[i]);
+        w.add(r[i], rstart, rand() % 20000);
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        w.cancel(r[i]);
+    }
+    while (w.getCount() > 0) {
+        const uint32_t wait = w.getMsToNextCheck(g_test_timer_wheel_now);
+        assert(wait <= 64);
+
+        /* Nothing expires before the time given by getMsToNextCheck() */
+        if (wait > 1) {
+            assert(0 == w.expireNext(g_test_timer_wheel_now + wait - 1));
+        }
+        g_test_timer_wheel_now += (wait ? wait : 1);
+        w.advance(g_test_timer_wheel_now);
+    }
+    assert(666 == g_test_timer_wheel_fired);
+
+    puts("\nTimer Wheel Tests Successful!");
+}
+
+#ifndef __arm__
+#include <chrono>
+/**
+ * Host only benchmark with 10,000 concurrent timers comparing the wheel against
+ * polling of each timer every millisecond (such as SoftTimer::expired())
+ */
+static inline void test_timer_wheel_benchmark(void)
+{
+    typedef std::chrono::steady_clock clock;
+    const int count = 10 * 1000;
+    const uint32_t duration = 60 * 1000;
+    static TimerWheelEntry timers[count];
+    static uint32_t targets[count];
+    TimerWheel w(0);
+    uint32_t fired = 0;
+
+    for (int i = 0; i < count; i++) {
+        targets[i] = 1 + rand() % duration;
+    }
+
+    clock::time_point start = clock::now();
+    for (int i = 0; i < count; i++) {
+        w.add(timers[i], 0, targets[i]);
+    }
+    const double addSec = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (int i = 0; i < count; i++) {
+        w.cancel(timers[i]);
+    }
+    const double cancelSec = std::chrono::duration<double>(clock::now() - start).count();
+
+    for (int i = 0; i < count; i++) {
+        w.add(timers[i], 0, targets[i]);
+    }
+    start = clock::now();
+    for (uint32_t now = 1; now <= duration; now++) {
+        while (w.expireNext(now)) {
+            ++fired;
+        }
+    }
+    const double wheelSec = std::chrono::duration<double>(clock::now() - start).count();
+    assert(count == (int) fired);
+
+    /* Polling needs to compare each timer every millisecond */
+    fired = 0;
+    start = clock::now();
+    for (uint32_t now = 1; now <= duration; now++) {
+        for (int i = 0; i < count; i++) {
+            if (targets[i] && now >= targets[i]) {
+                targets[i] = 0;
+                ++fired;
+            }
+        }
+    }
+    const double pollSec = std::chrono::duration<double>(clock::now() - start).count();
+    assert(count == (int) fired);
+
+    printf("\n%i timers over %u ms:", count, (unsigned) duration);
+    printf("\nWheel add    : %6.1f ns/timer", addSec * 1e9 / count);
+    printf("\nWheel cancel : %6.1f ns/timer", cancelSec * 1e9 / count);
+    printf("\nWheel expire : %6.1f ns/ms tick (all timers expired)", wheelSec * 1e9 / duration);
+    printf("\nPolling      : %6.1f ns/ms tick\n", pollSec * 1e9 / duration);
+}
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
+
+
+
+#endif /* TIMER_WHEEL_HPP_ */
@@ -18,7 +18,8 @@
 
 #ifndef C_TLM_COMP_H__
 #define C_TLM_COMP_H__
-#include "c_list.h"
+#include <stdint.h>
+#include <stdbool.h>
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -42,15 +43,40 @@ extern "C" {
  *      tlm_variable_register(comp, "a", &a, sizeof(a)));
  *      TLM_REG_VAR(comp, b); // Macro to register variable b
  * @endcode
+ *
+ * Components and variables are looked up by name through open addressing hash tables,
+ * so lookups and registration do not slow down as more variables are registered.
+ * The components and variables themselves are carved out of arena blocks of
+ * TLM_ARENA_BLOCK_SIZE bytes rather than allocated one at a time, and are never freed.
  */
 
+/// Size of each memory block that components and variables are allocated from
+#define TLM_ARENA_BLOCK_SIZE    1024
+
+/// Initial number of slots of a hash table (must be a power of 2)
+#define TLM_INDEX_MIN_SIZE      8
+
+struct tlm_reg_var;
+
 /**
  * Structure of a telemetry component.
- * Each component has a name, and a list of variables
+ * Each component has a name, and a list of variables in the order they were registered.
+ * To go through the variables of a component :
+ * @code
+ *      for (const tlm_reg_var_type *var = comp->first_var; NULL != var; var = var->next) { }
+ * @endcode
  */
-typedef struct {
-    const char *name;    /** Name of the telemetry component */
-    c_list_ptr var_list; /** List of the telemetry variables of this component */
+typedef struct tlm_component {
+    const char *name;                   /**< Name of the telemetry component */
+    struct tlm_component *next;         /**< Next component in the order they were added */
+
+    struct tlm_reg_var *first_var;      /**< First variable registered to this component */
+    struct tlm_reg_var *last_var;       /**< Last variable registered to this component */
+    uint32_t var_count;                 /**< Number of variables registered to this component */
+
+    uint32_t index_size;                /**< Number of slots of name_index and ptr_index (power of 2) */
+    struct tlm_reg_var **name_index;    /**< Hash table of the variables by their name */
+    struct tlm_reg_var **ptr_index;     /**< Hash table of the variables by their data pointer */
 } tlm_component;
 
 /**
@@ -80,6 +106,15 @@ tlm_component* tlm_component_get_by_name(const char *name);
  */
 void tlm_component_for_each(tlm_comp_callback callback, void *arg1, void *arg2);
 
+/**
+ * @{ Used by c_tlm_var.c to allocate and index the variables.
+ * tlm_arena_alloc() returns zeroed memory which cannot be freed, or NULL if out of memory.
+ * tlm_hash_name() returns the hash value of a name (FNV-1a).
+ */
+void* tlm_arena_alloc(uint32_t size);
+uint32_t tlm_hash_name(const char *name);
+/** @} */
+
 
 
 #ifdef __cplusplus
@@ -0,0 +1,325 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#ifndef C_TLM_JOURNAL_H__
+#define C_TLM_JOURNAL_H__
+#include "c_tlm_comp.h"
+#include <stdio.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/**
+ * @file
+ * @brief Incremental saving of telemetry variables to an append-only journal file.
+ *
+ * Rather than re-writing every variable of a component when one of them changes, only
+ * the changed variables are appended to the journal file.  When the journal grows to
+ * TLM_JOURNAL_COMPACT_RATIO times the size of all of the variables, it is compacted by
+ * writing all of the variables to a new file which then replaces the journal.
+ *
+ * Changed variables are found by their generation counter which is incremented by
+ * tlm_variable_set_value() and tlm_variable_mark_changed().  Variables that are written
+ * directly are found by comparing them with the last value written to the journal unless
+ * scan_unmarked is set to false.
+ *
+ * File format (little endian) :
+ *  - TLM_JOURNAL_MAGIC (4 bytes)
+ *  - Records of variables, each with :
+ *      - uint8_t   Length of the name
+ *      - uint16_t  Length of the data in bytes
+ *      - uint16_t  CRC-16 of the name and data
+ *      - The name and the data
+ *
+ * If the power is lost while writing a record, the truncated record (or any record that
+ * fails the CRC) and everything after it is ignored when the journal is restored, so the
+ * variables get their last completely written values.
+ *
+ * @code
+ *      // At startup, after the variables are registered
+ *      tlm_journal_restore(disk, "disk");
+ *      tlm_journal_t journal;
+ *      tlm_journal_init(&journal, disk, "disk");
+ *
+ *      // Periodically
+ *      tlm_journal_sync(&journal);
+ * @endcode
+ *
+ * @warning  Like c_tlm_binary.h, tlm_journal_init() should be called after all of the
+ *           variables of the component are registered.
+ */
+
+#define TLM_JOURNAL_MAGIC           "TLJ1"  ///< First bytes of a journal file
+#define TLM_JOURNAL_COMPACT_RATIO   4       ///< Compact once the journal is this many times the full size
+#define TLM_JOURNAL_MAX_FILENAME    32      ///< Max length of the journal filename
+
+/// Journal of a telemetry component
+typedef struct {
+    tlm_component *comp;    ///< The component being saved
+    const char *filename;   ///< The journal filename
+    char *shadow;           ///< Values of the variables as last written to the journal
+    uint32_t *saved_gen;    ///< Generation counter of each variable as last written to the journal
+    uint32_t var_count;     ///< Number of variables of the component at tlm_journal_init()
+    uint32_t full_size;     ///< Size of the journal file if it had each variable once
+    uint32_t file_size;     ///< Current size of the journal file
+    uint32_t bytes_written; ///< Total bytes written to the journal file
+    bool scan_unmarked;     ///< Compare the data of the variables whose generation did not change
+    bool compact_needed;    ///< Compact at the next sync (such as after a failed write)
+} tlm_journal_t;
+
+/**
+ * Restores the variables of a component from a journal file.
+ * A file that was saved by tlm_stream_one_file() is also accepted.
+ * @param comp_ptr   The component pointer
+ * @param filename   The journal filename
+ * @returns the number of variables restored (including duplicate records), or -1 if the file
+ *          could not be opened.
+ */
+int tlm_journal_restore(tlm_component *comp_ptr, const char *filename);
+
+/**
+ * Writes all variables of a component to a new journal file.  The new file is written to
+ * "<filename>.tmp" first, so the previous journal is replaced only if this succeeds.
+ * @returns the size of the journal file, or 0 upon failure
+ */
+uint32_t tlm_journal_save_all(tlm_component *comp_ptr, const char *filename);
+
+/**
+ * Initializes the journal with the current values of the variables.
+ * The journal file is compacted if it is not a valid journal.
+ * @returns false if memory could not be allocated
+ */
+bool tlm_journal_init(tlm_journal_t *journal, tlm_component *comp_ptr, const char *filename);
+
+/// Frees the memory of a journal initialized by tlm_journal_init()
+void tlm_journal_free(tlm_journal_t *journal);
+
+/**
+ * Appends the variables that changed since the last sync to the journal, and compacts the journal
+ * if it grew too large.
+ * @returns the number of variables that changed, or -1 upon a write failure
+ */
+int tlm_journal_sync(tlm_journal_t *journal);
+
+/**
+ * Writes the current values of all of the variables to a new journal file.
+ * @returns true upon success
+ */
+bool tlm_journal_compact(tlm_journal_t *journal);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <string.h>
+#include "c_tlm_var.h"
+#include "c_tlm_stream.h"
+
+/// Test variables of the journal, and a copy of their values at each record boundary
+typedef struct {
+    int32_t a;
+    int16_t b;
+    char s[16];
+    uint32_t arr[4];
+} test_tlm_journal_vars_t;
+
+static inline void test_tlm_journal_copy(test_tlm_journal_vars_t *copy, const test_tlm_journal_vars_t *v)
+{
+    memcpy(copy, v, sizeof(*copy));
+}
+
+/// @returns true if the variables are the same (the padding bytes are not compared)
+static inline bool test_tlm_journal_equal(const test_tlm_journal_vars_t *v1, const test_tlm_journal_vars_t *v2)
+{
+    return (v1->a == v2->a && v1->b == v2->b && 0 == memcmp(v1->s, v2->s, sizeof(v1->s)) &&
+            0 == memcmp(v1->arr, v2->arr, sizeof(v1->arr)));
+}
+
+static inline long test_tlm_journal_file_size(const char *filename)
+{
+    long size = -1;
+    FILE *file = fopen(filename, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+        fclose(file);
+    }
+    return size;
+}
+
+static inline void test_tlm_journal(void)
+{
+    const char *filename = "tlm_journal_test";
+    static test_tlm_journal_vars_t v;
+    enum { max_changes = 64 };
+    static test_tlm_journal_vars_t history[max_changes + 1];
+    static long history_size[max_changes + 1];
+    static uint8_t file_data[4096];
+    tlm_journal_t journal;
+    int i = 0;
+
+    remove(filename);
+    tlm_component *comp = tlm_component_add("journal_test");
+    assert(comp);
+    assert(TLM_REG_VAR(comp, v.a, tlm_int));
+    assert(TLM_REG_VAR(comp, v.b, tlm_int));
+    assert(TLM_REG_VAR(comp, v.s, tlm_string));
+    assert(TLM_REG_ARR(comp, v.arr, tlm_uint));
+    const uint32_t full_size = 4 + (5 + 3 + 4) + (5 + 3 + 2) + (5 + 3 + 16) + (5 + 5 + 16);
+
+    /* Without a journal file, the first sync writes all variables */
+    assert(-1 == tlm_journal_restore(comp, filename));
+    assert(tlm_journal_init(&journal, comp, filename));
+    assert(journal.compact_needed && full_size == journal.full_size);
+    assert(0 == tlm_journal_sync(&journal));
+    assert((long)full_size == test_tlm_journal_file_size(filename));
+
+    /* Only the changed variables are written */
+    v.a = 123;
+    assert(TLM_MARK_CHANGED(comp, v.a));
+    assert(1 == tlm_journal_sync(&journal));
+    assert((long)full_size + 12 == test_tlm_journal_file_size(filename));
+    assert(0 == tlm_journal_sync(&journal));
+
+    /* Unmarked changes are found by comparing, unless scan_unmarked is false */
+    v.b = -5;
+    strcpy(v.s, "hello");
+    assert(2 == tlm_journal_sync(&journal));
+    journal.scan_unmarked = false;
+    v.b = 7;
+    assert(0 == tlm_journal_sync(&journal));
+    assert(tlm_variable_set_value("journal_test", "v.b", "8"));
+    assert(1 == tlm_journal_sync(&journal));
+    journal.scan_unmarked = true;
+
+    /* Restore gets the last values */
+    test_tlm_journal_copy(&history[0], &v);
+    memset(&v, 0, sizeof(v));
+    assert(4 + 4 == tlm_journal_restore(comp, filename));
+    assert(test_tlm_journal_equal(&v, &history[0]));
+
+    /* Reopening the journal appends to it */
+    tlm_journal_free(&journal);
+    assert(tlm_journal_init(&journal, comp, filename));
+    assert(!journal.compact_needed);
+    history_size[0] = test_tlm_journal_file_size(filename);
+    assert(history_size[0] == (long)journal.file_size);
+
+    /* One change per sync so that there is a known value at each record boundary
+     * (few enough syncs that the journal is not compacted)
+     */
+    const int syncs = 4;
+    for (i = 1; i <= syncs; i++) {
+        v.arr[i % 4] = i * 1000;
+        v.a = i;
+        assert(2 == tlm_journal_sync(&journal));
+        test_tlm_journal_copy(&history[i], &v);
+        history_size[i] = test_tlm_journal_file_size(filename);
+        assert(history_size[i] == history_size[i - 1] + 12 + 26);
+    }
+
+    /* Truncate the journal at every byte (like losing the power while writing), and make
+     * sure the variables are restored as of the last complete sync, or in between the records
+     * of a sync.
+     */
+    FILE *file = fopen(filename, "rb");
+    const size_t file_size = fread(file_data, 1, sizeof(file_data), file);
+    fclose(file);
+    assert((long)file_size == history_size[syncs]);
+
+    int last = 0;
+    for (long len = history_size[0]; len <= (long)file_size; len++) {
+        while (last < syncs && len >= history_size[last + 1]) {
+            last++;
+        }
+        file = fopen(filename, "wb");
+        fwrite(file_data, 1, len, file);
+        fclose(file);
+
+        memset(&v, 0xAA, sizeof(v));
+        assert(tlm_journal_restore(comp, filename) > 0);
+        test_tlm_journal_vars_t expected = history[last];
+        if (last < syncs && len >= history_size[last] + 12) {
+            /* The record of 'a' of the next sync was written, but not the array */
+            expected.a = history[last + 1].a;
+        }
+        assert(test_tlm_journal_equal(&v, &expected));
+
+        /* A truncated journal is compacted instead of appending after the partial record */
+        tlm_journal_free(&journal);
+        assert(tlm_journal_init(&journal, comp, filename));
+        assert(journal.compact_needed == (len != history_size[last] && len != history_size[last] + 12));
+    }
+
+    /* A corrupted record stops the restore at that record */
+    file_data[history_size[2] + 9] ^= 0x01;
+    file = fopen(filename, "wb");
+    fwrite(file_data, 1, file_size, file);
+    fclose(file);
+    memset(&v, 0, sizeof(v));
+    tlm_journal_restore(comp, filename);
+    assert(history[2].a == v.a);
+
+    /* The journal is compacted before it grows beyond TLM_JOURNAL_COMPACT_RATIO times the full size */
+    tlm_journal_free(&journal);
+    assert(tlm_journal_init(&journal, comp, filename));
+    assert(0 == tlm_journal_sync(&journal));
+    const uint32_t bytes_before = journal.bytes_written;
+    for (i = 0; i < max_changes; i++) {
+        v.a = i;
+        assert(1 == tlm_journal_sync(&journal));
+        assert(journal.file_size <= full_size * TLM_JOURNAL_COMPACT_RATIO);
+        assert((long)journal.file_size == test_tlm_journal_file_size(filename));
+    }
+
+    const uint32_t bytes_per_change = (journal.bytes_written - bytes_before) / max_changes;
+    tlm_journal_free(&journal);
+
+    /* If the power is lost after the old journal is removed, the compacted journal is restored */
+    char tmp_name[TLM_JOURNAL_MAX_FILENAME + 5];
+    sprintf(tmp_name, "%s.tmp", filename);
+    rename(filename, tmp_name);
+    memset(&v, 0, sizeof(v));
+    assert(tlm_journal_restore(comp, filename) > 0);
+    assert(max_changes - 1 == v.a);
+    remove(tmp_name);
+
+    /* The old ASCII telemetry file is still restored */
+    file = fopen(filename, "w");
+    tlm_stream_one_file(comp, file);
+    fclose(file);
+    const long ascii_size = test_tlm_journal_file_size(filename);
+    v.a = 0;
+    assert(4 == tlm_journal_restore(comp, filename));
+    assert(max_changes - 1 == v.a);
+    remove(filename);
+
+    printf("\nBytes written per change of one variable: ASCII file %li, journal %u (including compaction)",
+           ascii_size, (unsigned)bytes_per_change);
+    puts("\nTelemetry Journal Tests Successful!");
+}
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* C_TLM_JOURNAL_H__ */
@@ -0,0 +1,367 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#ifndef C_TLM_RECORDER_H__
+#define C_TLM_RECORDER_H__
+#include "c_tlm_comp.h"
+#include "c_tlm_var.h"
+#include "c_tlm_stream.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/**
+ * @file
+ * @brief Flight recorder of telemetry variables
+ *
+ * The recorder samples a chosen set of registered variables at a fixed rate into a RAM
+ * ring buffer, so that the history of the variables can be seen after something goes
+ * wrong.  When the ring is full, the oldest samples are discarded.
+ *
+ * To keep the memory small, each sample only stores the bytes that changed since the
+ * previous sample :
+ *  - uint8_t   Number of periods since the previous sample (bits 0-6), and bit 7
+ *              set if nothing changed, in which case nothing else follows.
+ *  - uint32_t  Number of periods (little endian), only if bits 0-6 are TLM_RECORDER_EXT_PERIODS
+ *              such that the time of the samples stays exact after a long gap.
+ *  - Bit mask of the changed bytes of the row (1 bit per byte of all of the variables)
+ *  - The changed bytes
+ *
+ * The recorder also keeps the full row of the oldest sample of the ring, and each
+ * discarded sample is applied to it, so the ring never needs a full "key" sample.
+ *
+ * Once triggered, the recorder stores a configured number of samples and then freezes
+ * such that the history before (and a little after) the trigger is kept until it is dumped.
+ *
+ * @code
+ *      static uint8_t ring[4096];
+ *      static tlm_recorder_t rec;
+ *      tlm_recorder_init(&rec, ring, sizeof(ring), 10);
+ *      tlm_recorder_add(&rec, comp, "speed");
+ *      tlm_recorder_add(&rec, comp, "state");
+ *      tlm_recorder_set_trigger(&rec, NULL, NULL, 50);
+ *
+ *      // At 100Hz
+ *      tlm_recorder_sample(&rec, sys_get_uptime_ms());
+ *
+ *      // Upon an error
+ *      tlm_recorder_trigger(&rec);
+ *
+ *      // Later, once frozen
+ *      tlm_recorder_dump(&rec, stream_func, stream_arg);
+ * @endcode
+ *
+ * @warning  The recorder is not thread safe.  Sample it from one task, and dump it from
+ *           the same task or once it is frozen.
+ */
+
+#define TLM_RECORDER_MAX_VARS       16      ///< Max number of variables of a recorder
+#define TLM_RECORDER_UNCHANGED      0x80    ///< Sample header bit if no bytes changed
+#define TLM_RECORDER_PERIODS_MASK   0x7F    ///< Bits of the sample header with the periods since the previous sample
+#define TLM_RECORDER_EXT_PERIODS    0x7F    ///< Sample header periods if the periods follow as a uint32_t
+
+/**
+ * The trigger callback type, which is called after each sample
+ * @returns true to trigger the recorder
+ */
+typedef bool (*tlm_recorder_trigger_func)(void *arg);
+
+/**
+ * Callback for each sample (row) of the recorder @see tlm_recorder_for_each_row()
+ * @param row      The data of the variables in the order they were added
+ * @param time_ms  The time of the sample
+ */
+typedef void (*tlm_recorder_row_func)(const uint8_t *row, uint32_t time_ms, void *arg);
+
+/// Flight recorder structure; use the functions rather than accessing its members
+typedef struct {
+    tlm_component *comps[TLM_RECORDER_MAX_VARS];        ///< Component of each variable
+    const tlm_reg_var_type *vars[TLM_RECORDER_MAX_VARS]; ///< The variables being recorded
+    uint32_t offsets[TLM_RECORDER_MAX_VARS];            ///< Offset of each variable in a row
+    uint32_t var_count;         ///< Number of variables
+    uint32_t row_size;          ///< Size of all variables in bytes
+    uint32_t mask_size;         ///< Size of the changed bytes mask
+
+    uint8_t *buffer;            ///< The memory given to tlm_recorder_init()
+    uint32_t buffer_size;       ///< Size of the buffer
+    uint8_t *base_row;          ///< Row of the oldest sample
+    uint8_t *prev_row;          ///< Row of the newest sample
+    uint8_t *scratch_row;       ///< Row that is being sampled or dumped
+    uint8_t *ring;              ///< The delta encoded samples after the oldest sample
+    uint32_t ring_size;         ///< Size of the ring
+    uint32_t ring_head;         ///< Index at which the next sample is written
+    uint32_t ring_used;         ///< Number of bytes used in the ring
+
+    uint32_t sample_count;      ///< Number of samples, including the oldest sample
+    uint32_t period_ms;         ///< Sample period
+    uint32_t base_ms;           ///< Time of the oldest sample
+    uint32_t last_ms;           ///< Time of the newest sample
+
+    tlm_recorder_trigger_func trigger;  ///< Trigger function, or NULL
+    void *trigger_arg;                  ///< Argument of the trigger function
+    uint32_t post_trigger_samples;      ///< Samples to store after the trigger before freezing
+    int32_t samples_to_freeze;          ///< Samples left before freezing, or -1 if not triggered
+    bool frozen;                        ///< True once frozen
+} tlm_recorder_t;
+
+/**
+ * Initializes the recorder
+ * @param buffer     The memory used for the ring and three rows of the variables
+ * @param size       The size of the memory
+ * @param period_ms  The sample period
+ */
+void tlm_recorder_init(tlm_recorder_t *rec, void *buffer, uint32_t size, uint32_t period_ms);
+
+/**
+ * Adds a variable to record.  Variables can only be added before the first sample.
+ * @returns false if the variable is not registered, or if too many variables are added
+ */
+bool tlm_recorder_add(tlm_recorder_t *rec, tlm_component *comp_ptr, const char *name);
+
+/**
+ * Sets the trigger of the recorder
+ * @param trigger       The function called after each sample to check if the recorder
+ *                      should be triggered, or NULL to only use tlm_recorder_trigger()
+ * @param post_samples  Number of samples to store after the trigger before freezing
+ */
+void tlm_recorder_set_trigger(tlm_recorder_t *rec, tlm_recorder_trigger_func trigger, void *arg,
+                              uint32_t post_samples);
+
+/**
+ * Samples the variables if at least one period has elapsed since the last sample.
+ * This can be called more often than the period.
+ * @param now_ms  The current time
+ * @returns true if a sample was stored
+ */
+bool tlm_recorder_sample(tlm_recorder_t *rec, uint32_t now_ms);
+
+/// Triggers the recorder, which freezes it after the post trigger samples are stored
+void tlm_recorder_trigger(tlm_recorder_t *rec);
+
+/// @returns true if the recorder is frozen
+static inline bool tlm_recorder_is_frozen(const tlm_recorder_t *rec) { return rec->frozen; }
+
+/// @returns the number of samples in the recorder
+static inline uint32_t tlm_recorder_get_sample_count(const tlm_recorder_t *rec) { return rec->sample_count; }
+
+/// @returns the number of bytes used by the delta encoded samples
+static inline uint32_t tlm_recorder_get_used_bytes(const tlm_recorder_t *rec) { return rec->ring_used; }
+
+/// Discards the samples, and un-freezes the recorder
+void tlm_recorder_restart(tlm_recorder_t *rec);
+
+/**
+ * Calls the callback with each sample from the oldest to the newest
+ * @returns the number of samples
+ */
+uint32_t tlm_recorder_for_each_row(tlm_recorder_t *rec, tlm_recorder_row_func callback, void *arg);
+
+/**
+ * Dumps the samples as CSV, with a header line, and then a line per sample :
+ *      time_ms,<comp>.<var>,...
+ *      1000,5,1.500000,...
+ * Array values are quoted, such as "1,2,3"
+ * @param stream  The stream function, such as the one used by tlm_stream_all()
+ * @returns the number of samples
+ */
+uint32_t tlm_recorder_dump(tlm_recorder_t *rec, stream_callback_type stream, void *arg);
+
+/// Dumps the samples as CSV to a file @see tlm_recorder_dump()
+uint32_t tlm_recorder_dump_file(tlm_recorder_t *rec, FILE *file);
+
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+/// Synthetic variables of the recorder test
+typedef struct {
+    uint32_t counter;
+    float temperature;
+    uint8_t state;
+    int16_t accel[3];
+    double position;
+    char mode[8];
+} test_tlm_recorder_vars_t;
+
+/// The expected samples of the recorder test
+typedef struct {
+    enum { test_tlm_recorder_max = 4096 } size;
+    test_tlm_recorder_vars_t vars[test_tlm_recorder_max];
+    uint32_t time_ms[test_tlm_recorder_max];
+    uint32_t count;     ///< Number of samples that were stored
+    uint32_t checked;   ///< Index of the next sample to check
+} test_tlm_recorder_history_t;
+
+static inline void test_tlm_recorder_check_row(const uint8_t *row, uint32_t time_ms, void *arg)
+{
+    test_tlm_recorder_history_t *h = arg;
+    const uint32_t i = (h->checked++) % test_tlm_recorder_max;
+    const test_tlm_recorder_vars_t *v = &h->vars[i];
+
+    /* Rows store the variables at their natural alignment */
+    assert(time_ms == h->time_ms[i]);
+    assert(0 == memcmp(row + 0, &v->counter, 4));
+    assert(0 == memcmp(row + 4, &v->temperature, 4));
+    assert(row[8] == v->state);
+    assert(0 == memcmp(row + 10, v->accel, sizeof(v->accel)));
+    assert(0 == memcmp(row + 16, &v->position, sizeof(v->position)));
+    assert(0 == memcmp(row + 24, v->mode, sizeof(v->mode)));
+}
+
+static inline bool test_tlm_recorder_trigger(void *arg)
+{
+    return 3 == ((const test_tlm_recorder_vars_t*)arg)->state;
+}
+
+/// Changes the synthetic variables like sensors would change
+static inline void test_tlm_recorder_update(test_tlm_recorder_vars_t *v, uint32_t i)
+{
+    v->counter++;
+    if (0 == i % 10) {
+        v->temperature += 0.25f;
+    }
+    v->state = (i / 500) % 3;
+    v->accel[0] = rand() % 4;
+    v->accel[2] = -1 - (rand() % 4);
+    v->position += 0.5;
+    strcpy(v->mode, (i % 1000) < 500 ? "idle" : "drive");
+}
+
+static inline void test_tlm_recorder(void)
+{
+    static test_tlm_recorder_vars_t v;
+    static test_tlm_recorder_history_t h;
+    static uint8_t buffer[2048 + 5];
+    const uint32_t period_ms = 10;
+    tlm_recorder_t rec;
+    char line[256] = "";
+    uint32_t now = 1000;
+    uint32_t lines = 0;
+    uint32_t i = 0;
+
+    tlm_component *comp = tlm_component_add("recorder");
+    assert(comp);
+    assert(TLM_REG_VAR(comp, v.counter, tlm_uint));
+    assert(TLM_REG_VAR(comp, v.temperature, tlm_float));
+    assert(TLM_REG_VAR(comp, v.state, tlm_uint));
+    assert(TLM_REG_ARR(comp, v.accel, tlm_int));
+    assert(TLM_REG_VAR(comp, v.position, tlm_double));
+    assert(tlm_variable_register(comp, "v.mode", v.mode, sizeof(v.mode), 1, tlm_string));
+
+    /* Unaligned buffer to check that the rows are aligned */
+    tlm_recorder_init(&rec, buffer + 1, sizeof(buffer) - 1, period_ms);
+    assert(!tlm_recorder_add(&rec, comp, "not_registered"));
+    assert(tlm_recorder_add(&rec, comp, "v.counter"));
+    assert(tlm_recorder_add(&rec, comp, "v.temperature"));
+    assert(tlm_recorder_add(&rec, comp, "v.state"));
+    assert(tlm_recorder_add(&rec, comp, "v.accel"));
+    assert(tlm_recorder_add(&rec, comp, "v.position"));
+    assert(tlm_recorder_add(&rec, comp, "v.mode"));
+    assert(32 == rec.row_size);
+
+    /* The ring wraps many times; sampling is late sometimes, and some periods are missed,
+     * including gaps that need the extended number of periods.
+     */
+    for (i = 0; i < 3000; i++) {
+        test_tlm_recorder_update(&v, i);
+        const uint32_t slot = now;
+        now += (0 == i % 97) ? (3 * period_ms) : period_ms;
+        now += (0 == i % 499) ? (TLM_RECORDER_EXT_PERIODS * period_ms) : 0;
+        now += (0 == i % 1499) ? (100000 * period_ms) : 0;
+        assert(tlm_recorder_sample(&rec, slot + (i % 7)));
+        assert(!tlm_recorder_sample(&rec, slot + (i % 7)));
+        assert(!tlm_recorder_is_frozen(&rec));
+
+        h.vars[h.count % test_tlm_recorder_max] = v;
+        h.time_ms[h.count % test_tlm_recorder_max] = slot;
+        h.count++;
+    }
+    assert(tlm_recorder_get_sample_count(&rec) > 100);
+    assert(tlm_recorder_get_sample_count(&rec) < h.count);
+
+    h.checked = h.count - tlm_recorder_get_sample_count(&rec);
+    assert(tlm_recorder_get_sample_count(&rec) == tlm_recorder_for_each_row(&rec, test_tlm_recorder_check_row, &h));
+    assert(h.checked == h.count);
+
+    const double bytes_per_sample = (double)tlm_recorder_get_used_bytes(&rec) / (tlm_recorder_get_sample_count(&rec) - 1);
+    printf("\nRecorder memory per sample: %.1f bytes (%u bytes raw), %u samples in %u bytes",
+           bytes_per_sample, (unsigned)rec.row_size, (unsigned)tlm_recorder_get_sample_count(&rec),
+           (unsigned)sizeof(buffer));
+    assert(bytes_per_sample < rec.row_size / 2);
+
+    /* Dump as CSV */
+    FILE *file = tmpfile();
+    assert(file);
+    assert(tlm_recorder_get_sample_count(&rec) == tlm_recorder_dump_file(&rec, file));
+    rewind(file);
+    assert(fgets(line, sizeof(line), file));
+    assert(0 == strcmp("time_ms,recorder.v.counter,recorder.v.temperature,recorder.v.state,"
+                       "recorder.v.accel,recorder.v.position,recorder.v.mode\n", line));
+    while (fgets(line, sizeof(line), file)) {
+        lines++;
+    }
+    fclose(file);
+    assert(lines == tlm_recorder_get_sample_count(&rec));
+    snprintf(line + 128, 128, "%u,%u,", (unsigned)h.time_ms[(h.count - 1) % test_tlm_recorder_max], (unsigned)v.counter);
+    assert(line == strstr(line, line + 128));
+    assert(strstr(line, ",\"") && strstr(line, "\",") && strstr(line, ",drive\n"));
+
+    /* Freeze a few samples after the trigger */
+    tlm_recorder_set_trigger(&rec, test_tlm_recorder_trigger, &v, 5);
+    for (i = 3000; !tlm_recorder_is_frozen(&rec); i++) {
+        test_tlm_recorder_update(&v, i);
+        v.state = (3005 == i) ? 3 : v.state;
+        assert(tlm_recorder_sample(&rec, now));
+        h.vars[h.count % test_tlm_recorder_max] = v;
+        h.time_ms[h.count % test_tlm_recorder_max] = now;
+        h.count++;
+        now += period_ms;
+    }
+    assert(3005 + 6 == i);
+    assert(!tlm_recorder_sample(&rec, now + 100));
+
+    h.checked = h.count - tlm_recorder_get_sample_count(&rec);
+    assert(tlm_recorder_get_sample_count(&rec) == tlm_recorder_for_each_row(&rec, test_tlm_recorder_check_row, &h));
+
+    /* A sample without changes is a single byte, and a trigger without post trigger samples freezes right away */
+    tlm_recorder_restart(&rec);
+    assert(0 == tlm_recorder_get_sample_count(&rec));
+    tlm_recorder_set_trigger(&rec, NULL, NULL, 0);
+    assert(tlm_recorder_sample(&rec, now));
+    assert(tlm_recorder_sample(&rec, now + period_ms));
+    assert(1 == tlm_recorder_get_used_bytes(&rec));
+    tlm_recorder_trigger(&rec);
+    assert(tlm_recorder_is_frozen(&rec));
+    assert(2 == tlm_recorder_get_sample_count(&rec));
+
+    puts("\nTelemetry Recorder Tests Successful!");
+}
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* C_TLM_RECORDER_H__ */
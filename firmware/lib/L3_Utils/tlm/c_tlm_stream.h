@@ -66,8 +66,31 @@ extern "C" {
  *      std::string str = "";
  *      tlm_stream_one(my_comp, string_stream, &str);
  * @endcode
+ *
+ * The binary stream is a more compact alternative to the ASCII stream.  The names, types
+ * and sizes of the variables are sent once in a schema frame, and then each values frame
+ * only has the raw data of the variables.  Each frame is :
+ *  - uint8_t   Frame type: TLM_STREAM_BIN_SCHEMA or TLM_STREAM_BIN_VALUES
+ *  - uint32_t  Length of the payload (little endian, as are all of the numbers)
+ *  - The payload
+ *
+ * The schema payload is :
+ *  - uint16_t  Number of components, and then for each component :
+ *      - uint8_t   Length of the name, and the name
+ *      - uint16_t  Number of variables, and then for each variable :
+ *          - uint8_t   Length of the name, and the name
+ *          - uint8_t   Type, @see tlm_type at c_tlm_var.h
+ *          - uint16_t  Number of bytes per variable
+ *          - uint16_t  Number of elements per array (1 for a single variable)
+ *
+ * The values payload is the data of each variable of each component in the order of the schema.
+ * tools/Telemetry/tlm_decoder.py converts the binary stream to CSV or JSON.
  */
 
+#define TLM_STREAM_BIN_SCHEMA   0xF1    ///< Frame type of the schema frame of the binary stream
+#define TLM_STREAM_BIN_VALUES   0xF2    ///< Frame type of the values frame of the binary stream
+#define TLM_STREAM_BIN_HDR_SIZE 5       ///< Size of the frame type and the payload length
+
 
 /**
  * Typedef of the stream callback function
@@ -108,10 +131,42 @@ void tlm_stream_all_file(FILE *file);
 /**
  * This is similar to tlm_stream_decode(char*) except that it decodes stream
  * from an opened file handle.  The file will be read until fgets() fails.
+ * If the file contains the binary stream, tlm_stream_bin_decode_file() is used instead.
  * @returns true when telemetry decode finds correct stream header.
  */
 bool tlm_stream_decode_file(FILE *file);
 
+/**
+ * Typedef of the binary stream callback function
+ * @param data  The data containing partial stream
+ * @param len   The length of the data
+ */
+typedef void (*stream_bin_callback_type)(const void *data, uint32_t len, void *arg);
+
+/**
+ * @{ Streams the schema frame, or a values frame of the binary stream.
+ * @param comp_ptr  The component to stream, or NULL to stream all of the components
+ * @param stream    The callback stream function that will receive the data
+ * @param arg       This argument will be passed to your stream function as its argument
+ */
+void tlm_stream_bin_schema(tlm_component *comp_ptr, stream_bin_callback_type stream, void *arg);
+void tlm_stream_bin_values(tlm_component *comp_ptr, stream_bin_callback_type stream, void *arg);
+/** @} */
+
+/**
+ * Streams the schema frame, and one values frame into a file pointer
+ * @param comp_ptr  The component to stream, or NULL to stream all of the components
+ * @param file      An opened file handle
+ */
+void tlm_stream_bin_file(tlm_component *comp_ptr, FILE *file);
+
+/**
+ * Decodes the binary stream from an opened file handle.  The variables are set to the
+ * data of each values frame, and variables in the schema that are not registered are skipped.
+ * @returns true if at least one values frame was decoded
+ */
+bool tlm_stream_bin_decode_file(FILE *file);
+
 
 
 #ifdef __cplusplus
@@ -46,7 +46,7 @@ static bool test_tlm(void)
     assert(0 != (first_comp = tlm_component_add("first")));
 
     char str_stream[128] = { 0 };
-    tlm_stream_one(first_comp, string_stream, str_stream);
+    tlm_stream_one(first_comp, string_stream, NULL, str_stream);
     assert(0 == strcmp(str_stream, "START:first:0\nEND:first\n"));
 
     puts("Test: Add 2 components");
@@ -93,12 +93,11 @@ static bool test_tlm(void)
     puts("Test: TLM Stream decode");
     b = 0;
     d = 0;
-    char stream_start[100] = "START:second:2\n";
-    char stream_var_a[100] = "b:4:1:0:01,01,00,00";
-    char stream_var_d[100] = "d:1:1:0:11";
-    assert(tlm_stream_decode(stream_start));
-    assert(!tlm_stream_decode(stream_var_a));
-    assert(!tlm_stream_decode(stream_var_d));
+    FILE *stream_file = tmpfile();
+    fputs("START:second:2\nb:4:1:0:01,01,00,00\nd:1:1:0:11\nEND:second\n", stream_file);
+    rewind(stream_file);
+    assert(tlm_stream_decode_file(stream_file));
+    fclose(stream_file);
     assert(257 == b);
     assert(17 == d);
 
@@ -158,6 +157,165 @@ static bool test_tlm(void)
     return true;
 }
 
+static void test_tlm_stream_bin_file(const void *data, uint32_t len, void *arg) {
+    fwrite(data, 1, len, (FILE*)arg);
+}
+
+static void test_tlm_stream_bin(void)
+{
+    static int32_t i32 = -123456;
+    static uint8_t u8[3] = { 1, 2, 3 };
+    static char str[12] = "hello";
+    static float f = 1.5f;
+    tlm_component *comp = tlm_component_add("bin_stream");
+    assert(comp);
+    assert(TLM_REG_VAR(comp, i32, tlm_int));
+    assert(TLM_REG_ARR(comp, u8, tlm_uint));
+    assert(TLM_REG_VAR(comp, str, tlm_string));
+    assert(TLM_REG_VAR(comp, f, tlm_float));
+
+    puts("Test: Binary stream");
+    FILE *file = tmpfile();
+    tlm_stream_bin_file(comp, file);
+    const long schema_len = 2 + (1 + 10 + 2) + (1 + 3 + 5) + (1 + 2 + 5) + (1 + 3 + 5) + (1 + 1 + 5);
+    const long values_len = 4 + 3 + 12 + 4;
+    assert(TLM_STREAM_BIN_HDR_SIZE + schema_len + TLM_STREAM_BIN_HDR_SIZE + values_len == ftell(file));
+
+    /* A second values frame overrides the first */
+    i32 = 42;
+    tlm_stream_bin_values(comp, test_tlm_stream_bin_file, file);
+
+    i32 = 0;
+    memset(u8, 0, sizeof(u8));
+    memset(str, 0, sizeof(str));
+    f = 0;
+    rewind(file);
+    assert(tlm_stream_decode_file(file));
+    assert(42 == i32);
+    assert(3 == u8[2]);
+    assert(0 == strcmp(str, "hello"));
+    assert(f > 1.49f && f < 1.51f);
+    fclose(file);
+
+    /* Values frame with the wrong length for the schema is ignored */
+    const uint8_t bad_values[] = { TLM_STREAM_BIN_VALUES, 1, 0, 0, 0, 0xFF };
+    file = tmpfile();
+    tlm_stream_bin_schema(comp, test_tlm_stream_bin_file, file);
+    fwrite(bad_values, 1, sizeof(bad_values), file);
+    rewind(file);
+    assert(!tlm_stream_decode_file(file));
+    assert(42 == i32);
+    fclose(file);
+}
+
+#ifndef __arm__
+#include <time.h>
+/// Host only benchmark that registers and looks up 1000 variables of one component
+static void test_tlm_benchmark(void)
+{
+    enum { count = 1000, lookups = 100 };
+    static int vars[count];
+    static char names[count][12];
+    static int other;
+    const tlm_reg_var_type *var = NULL;
+    tlm_component *comp = tlm_component_add("benchmark");
+    int i, j, found = 0;
+    assert(comp);
+
+    clock_t start = clock();
+    for (i = 0; i < count; i++) {
+        sprintf(names[i], "var_%i", i);
+        assert(tlm_variable_register(comp, names[i], &vars[i], sizeof(vars[i]), 1, tlm_int));
+    }
+    const double reg_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+    assert(count == comp->var_count);
+    assert(!tlm_variable_register(comp, names[count / 2], &other, sizeof(other), 1, tlm_int));
+
+    start = clock();
+    for (j = 0; j < lookups; j++) {
+        for (i = 0; i < count; i++) {
+            found += (&vars[i] == tlm_variable_get_by_comp_and_name("benchmark", names[i])->data_ptr);
+        }
+    }
+    const double hash_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+    assert(count * lookups == found);
+
+    /* Same lookups by walking the list, which is how the variables used to be found */
+    start = clock();
+    for (j = 0; j < lookups; j++) {
+        for (i = 0; i < count; i++) {
+            for (var = comp->first_var; NULL != var && 0 != strcmp(var->name, names[i]); var = var->next) {
+            }
+            found -= (&vars[i] == var->data_ptr);
+        }
+    }
+    const double list_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+    assert(0 == found);
+
+    printf("\nRegister %i variables : %8.1f us", count, reg_sec * 1e6);
+    printf("\nHashed lookup         : %8.1f ns/lookup", hash_sec * 1e9 / (count * lookups));
+    printf("\nList walk lookup      : %8.1f ns/lookup\n", list_sec * 1e9 / (count * lookups));
+}
+
+/// Host only benchmark of the ASCII (hex) stream versus the binary stream of 1000 variables
+static void test_tlm_stream_benchmark(void)
+{
+    enum { count = 1000, repeat = 20 };
+    static uint8_t data[count][8];
+    static char names[count][16];
+    tlm_component *comp = tlm_component_add("stream_benchmark");
+    int i, r;
+    assert(comp);
+
+    /* A mix of 4 byte variables, 2 byte variables, and 8 byte arrays */
+    for (i = 0; i < count; i++) {
+        sprintf(names[i], "variable_%i", i);
+        memset(data[i], i, sizeof(data[i]));
+        const uint16_t size = (0 == i % 3) ? 4 : (1 == i % 3) ? 2 : 1;
+        const uint16_t arr_size = (2 == i % 3) ? 8 : 1;
+        assert(tlm_variable_register(comp, names[i], data[i], size, arr_size, tlm_uint));
+    }
+
+    for (int binary = 0; binary <= 1; binary++)
+    {
+        FILE *file = tmpfile();
+        long size = 0;
+
+        clock_t start = clock();
+        for (r = 0; r < repeat; r++) {
+            rewind(file);
+            if (binary) {
+                tlm_stream_bin_file(comp, file);
+            } else {
+                tlm_stream_one_file(comp, file);
+            }
+            size = ftell(file);
+        }
+        const double stream_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        for (r = 0; r < repeat; r++) {
+            memset(data, 0, sizeof(data));
+            rewind(file);
+            assert(tlm_stream_decode_file(file));
+        }
+        const double decode_sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+        assert((uint8_t)(count - 1) == data[count - 1][0]);
+        assert((uint8_t)(count - 2) == data[count - 2][7]);
+        fclose(file);
+
+        printf("\n%s stream of %i variables : %6li bytes, stream %7.1f us, decode %7.1f us",
+               binary ? "Binary" : "ASCII ", count, size, stream_sec * 1e6 / repeat, decode_sec * 1e6 / repeat);
+    }
+
+    /* After the schema is sent once, each update is only a values frame */
+    FILE *file = tmpfile();
+    tlm_stream_bin_values(comp, test_tlm_stream_bin_file, file);
+    printf("\nBinary values frame only       : %6li bytes\n", ftell(file));
+    fclose(file);
+}
+#endif /* #ifndef __arm__ */
+
 
 #ifdef __cplusplus
 }
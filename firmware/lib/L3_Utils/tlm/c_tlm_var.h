@@ -18,7 +18,6 @@
 
 #ifndef C_TLM_VAR_H__
 #define C_TLM_VAR_H__
-#include "c_list.h"
 #include "c_tlm_comp.h"
 #ifdef __cplusplus
 extern "C" {
@@ -50,13 +49,16 @@ typedef enum {
 /**
  * Structure of a single variable registration
  */
-typedef struct {
+typedef struct tlm_reg_var {
     const char *name;      /**< Name of the variable */
     const void *data_ptr;  /**< Data pointer of the variable */
 
     uint32_t elm_size_bytes; /**< Size of the variable in bytes */
     uint32_t elm_arr_size;   /**< If an array, the size of the array */
     tlm_type elm_type;       /**< The type of the element */
+    uint32_t generation;     /**< Incremented each time the variable is changed, @see tlm_variable_mark_changed() */
+
+    struct tlm_reg_var *next; /**< Next variable of the same component */
 } tlm_reg_var_type;
 
 
@@ -112,6 +114,22 @@ const tlm_reg_var_type* tlm_variable_get_by_name(tlm_component *comp_ptr,
 const tlm_reg_var_type* tlm_variable_get_by_comp_and_name(const char *comp_name,
                                                           const char *name);
 
+/**
+ * Marks a variable as changed by incrementing its generation counter.
+ * This lets the telemetry journal find the changed variables without comparing their data.
+ * @see c_tlm_journal.h
+ * @param comp_ptr   The component pointer that contains the variable
+ * @param data_ptr   The registered data pointer of the variable
+ * @returns false if no variable is registered with this data pointer
+ */
+bool tlm_variable_mark_changed(tlm_component *comp_ptr, const void *data_ptr);
+
+/**
+ * Macro to mark a variable as changed.
+ */
+#define TLM_MARK_CHANGED(comp, var) \
+    tlm_variable_mark_changed(comp, &var)
+
 /**
  * Sets a value to one of the telemetry variables.  This is sort of a back-door way to force
  * a value to the telemetry variable.
@@ -31,21 +31,17 @@
  */
 static void get_tlm_one_comp(tlm_component *comp_ptr, void *arg_size, void *binary)
 {
-    void *hint = 0;
-    tlm_reg_var_type *var = NULL;
+    const tlm_reg_var_type *var = NULL;
     uint32_t *size = arg_size;
-    uint32_t i = 0, sizeOfVar = 0;
+    uint32_t sizeOfVar = 0;
 
     if (NULL != size && NULL != comp_ptr) {
-        for(i=0; i < c_list_node_count(comp_ptr->var_list); i++) {
-            var = c_list_get_elm_at(comp_ptr->var_list, i, &hint);
-            if (NULL != var) {
-                sizeOfVar = (var->elm_arr_size) * (var->elm_size_bytes);
-                if (binary) {
-                    memcpy(((char*)binary + (*size)), var->data_ptr, sizeOfVar);
-                }
-                (*size) += sizeOfVar;
+        for (var = comp_ptr->first_var; NULL != var; var = var->next) {
+            sizeOfVar = (var->elm_arr_size) * (var->elm_size_bytes);
+            if (binary) {
+                memcpy(((char*)binary + (*size)), var->data_ptr, sizeOfVar);
             }
+            (*size) += sizeOfVar;
         }
     }
 }
@@ -83,23 +79,19 @@ uint32_t tlm_binary_get_all(char *binary)
  */
 static void cmp_tlm_one_comp(tlm_component *comp_ptr, void *binary, void *offset_arg)
 {
-    void *hint = 0;
-    tlm_reg_var_type *var = NULL;
-    uint32_t size = 0, i = 0;
+    const tlm_reg_var_type *var = NULL;
+    uint32_t size = 0;
     uint32_t *offset = offset_arg;
 
     if (NULL != comp_ptr) {
-        for(i=0; i < c_list_node_count(comp_ptr->var_list); i++) {
-            var = c_list_get_elm_at(comp_ptr->var_list, i, &hint);
-            if (NULL != var) {
-                size = (var->elm_arr_size) * (var->elm_size_bytes);
-                if (0 != memcmp(((char*)binary + (*offset)), var->data_ptr, size)) {
-                    *offset = 0;
-                    break;
-                }
-                else {
-                    *offset += size;
-                }
+        for (var = comp_ptr->first_var; NULL != var; var = var->next) {
+            size = (var->elm_arr_size) * (var->elm_size_bytes);
+            if (0 != memcmp(((char*)binary + (*offset)), var->data_ptr, size)) {
+                *offset = 0;
+                break;
+            }
+            else {
+                *offset += size;
             }
         }
     }
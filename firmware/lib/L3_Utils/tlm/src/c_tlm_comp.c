@@ -22,23 +22,84 @@
 #include <string.h>
 #include "c_tlm_comp.h"
 
-/** Private member of this file */
-static c_list_ptr mp_tlm_component_list = NULL;
-
-static bool tlm_component_find_by_name(void *elm_ptr, void *arg1, void *arg2, void *arg3)
+/** Private members of this file */
+static tlm_component *mp_tlm_first_comp = NULL;
+static tlm_component *mp_tlm_last_comp = NULL;
+static tlm_component **mp_tlm_comp_index = NULL; ///< Hash table of the components by name
+static uint32_t m_tlm_comp_index_size = 0;
+static uint32_t m_tlm_comp_count = 0;
+
+/**
+ * @returns the slot of the component index that has the component by this name, or
+ * the empty slot at which it should be added.
+ */
+static tlm_component** tlm_component_find_slot(const char *name)
 {
-    tlm_component *comp = elm_ptr;
-    char *new_comp_name = arg1;
-    return (0 != strcmp(comp->name, new_comp_name));
+    const uint32_t mask = m_tlm_comp_index_size - 1;
+    uint32_t i = tlm_hash_name(name) & mask;
+
+    while (NULL != mp_tlm_comp_index[i] && 0 != strcmp(mp_tlm_comp_index[i]->name, name)) {
+        i = (i + 1) & mask;
+    }
+    return &mp_tlm_comp_index[i];
 }
 
-static bool tlm_component_for_each_callback(void *elm_ptr, void *arg1, void *arg2, void *arg3)
+/// Doubles the size of the component index if it is 3/4 full
+static bool tlm_component_grow_index(void)
 {
-    tlm_comp_callback callback = arg1;
-    callback(elm_ptr, arg2, arg3);
+    if ((m_tlm_comp_count + 1) * 4 <= m_tlm_comp_index_size * 3) {
+        return true;
+    }
+
+    const uint32_t new_size = (0 == m_tlm_comp_index_size) ? TLM_INDEX_MIN_SIZE : (m_tlm_comp_index_size * 2);
+    tlm_component **new_index = calloc(new_size, sizeof(*new_index));
+    if (NULL == new_index) {
+        return false;
+    }
+
+    free(mp_tlm_comp_index);
+    mp_tlm_comp_index = new_index;
+    m_tlm_comp_index_size = new_size;
+
+    tlm_component *comp = NULL;
+    for (comp = mp_tlm_first_comp; NULL != comp; comp = comp->next) {
+        *tlm_component_find_slot(comp->name) = comp;
+    }
     return true;
 }
 
+void* tlm_arena_alloc(uint32_t size)
+{
+    static uint8_t *block = NULL;
+    static uint32_t block_free = 0;
+
+    /* Keep the allocations aligned for the pointers they contain */
+    size = (size + 7) & ~7;
+
+    if (size > block_free) {
+        const uint32_t block_size = (size > TLM_ARENA_BLOCK_SIZE) ? size : TLM_ARENA_BLOCK_SIZE;
+        block = malloc(block_size);
+        block_free = (NULL == block) ? 0 : block_size;
+        if (NULL == block) {
+            return NULL;
+        }
+    }
+
+    void *mem = block;
+    block += size;
+    block_free -= size;
+    memset(mem, 0, size);
+    return mem;
+}
+
+uint32_t tlm_hash_name(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (uint8_t)(*name++)) * 16777619u;
+    }
+    return hash;
+}
 
 tlm_component* tlm_component_add(const char *name)
 {
@@ -46,37 +107,31 @@ tlm_component* tlm_component_add(const char *name)
         return NULL;
     }
 
-    /* Create component list if it doesn't exist */
-    if(NULL == mp_tlm_component_list) {
-        mp_tlm_component_list = c_list_create();
-    }
-
     /* Check if this component exists */
     if (NULL != tlm_component_get_by_name(name)) {
         return NULL;
     }
 
-    /* Allocate new component */
-    tlm_component *new_comp = malloc(sizeof(tlm_component));
-    if(NULL == new_comp) {
+    /* Make room in the index before allocating the component so nothing is lost upon failure */
+    if (!tlm_component_grow_index()) {
         return NULL;
     }
-    memset(new_comp, 0, sizeof(tlm_component));
 
-    /* Create the component and the list of variables of this component*/
-    new_comp->name = name;
-    new_comp->var_list = c_list_create();
-    if(NULL == new_comp->var_list) {
-        free(new_comp);
+    tlm_component *new_comp = tlm_arena_alloc(sizeof(tlm_component));
+    if(NULL == new_comp) {
         return NULL;
     }
+    new_comp->name = name;
 
-    /* Finally, add this component to our list */
-    if(!c_list_insert_elm_end(mp_tlm_component_list, new_comp)) {
-        free(new_comp->var_list);
-        free(new_comp);
-        return NULL;
+    /* Finally, add this component to our list, and the index */
+    if (NULL == mp_tlm_first_comp) {
+        mp_tlm_first_comp = new_comp;
+    } else {
+        mp_tlm_last_comp->next = new_comp;
     }
+    mp_tlm_last_comp = new_comp;
+    *tlm_component_find_slot(name) = new_comp;
+    ++m_tlm_comp_count;
 
     return new_comp;
 }
@@ -85,9 +140,8 @@ tlm_component* tlm_component_get_by_name(const char *name)
 {
     tlm_component *comp = NULL;
 
-    if (NULL != name) {
-        comp = c_list_find_elm(mp_tlm_component_list, tlm_component_find_by_name,
-                               (void*)name, NULL, NULL);
+    if (NULL != name && NULL != mp_tlm_comp_index) {
+        comp = *tlm_component_find_slot(name);
     }
 
     return comp;
@@ -95,13 +149,11 @@ tlm_component* tlm_component_get_by_name(const char *name)
 
 void tlm_component_for_each(tlm_comp_callback callback, void *arg1, void *arg2)
 {
-    /*
-     * c_list_for_each_elm() callback only has room for 3 arguments:
-     * We only take 2 customer arguments because one of the argument is
-     * our own callback
-     */
+    tlm_component *comp = NULL;
+
     if (NULL != callback) {
-        c_list_for_each_elm(mp_tlm_component_list, tlm_component_for_each_callback,
-                            callback, arg1, arg2);
+        for (comp = mp_tlm_first_comp; NULL != comp; comp = comp->next) {
+            callback(comp, arg1, arg2);
+        }
     }
 }
@@ -0,0 +1,363 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_tlm_journal.h"
+#include "c_tlm_var.h"
+#include "c_tlm_stream.h"
+
+
+
+#define TLM_JOURNAL_MAGIC_SIZE      4   ///< Size of TLM_JOURNAL_MAGIC without the NULL terminator
+#define TLM_JOURNAL_RECORD_HDR_SIZE 5   ///< Size of a record before the name and the data
+
+/// CRC-16-CCITT of the data
+static uint16_t tlm_journal_crc16(uint16_t crc, const void *data, uint32_t len)
+{
+    const uint8_t *p = data;
+    int bit = 0;
+
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static inline uint32_t tlm_journal_var_size(const tlm_reg_var_type *var)
+{
+    return (var->elm_size_bytes) * (var->elm_arr_size);
+}
+
+static inline uint32_t tlm_journal_record_size(const tlm_reg_var_type *var)
+{
+    return TLM_JOURNAL_RECORD_HDR_SIZE + strlen(var->name) + tlm_journal_var_size(var);
+}
+
+/**
+ * Writes a record of the variable to the file
+ * @param data  The data of the variable to write, which may be a copy of the variable
+ */
+static bool tlm_journal_write_record(FILE *file, const tlm_reg_var_type *var, const void *data)
+{
+    const uint32_t name_len = strlen(var->name);
+    const uint32_t data_len = tlm_journal_var_size(var);
+
+    if (name_len > UINT8_MAX || data_len > UINT16_MAX) {
+        return false;
+    }
+
+    const uint16_t crc = tlm_journal_crc16(tlm_journal_crc16(0xFFFF, var->name, name_len), data, data_len);
+    const uint8_t header[TLM_JOURNAL_RECORD_HDR_SIZE] = {
+        (uint8_t)name_len,
+        (uint8_t)(data_len & 0xFF), (uint8_t)(data_len >> 8),
+        (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8)
+    };
+
+    return (sizeof(header) == fwrite(header, 1, sizeof(header), file) &&
+            name_len == fwrite(var->name, 1, name_len, file) &&
+            data_len == fwrite(data, 1, data_len, file));
+}
+
+/**
+ * Reads the records of a journal file, starting after the magic bytes.
+ * Reading stops at the end of the file, or at the first truncated or corrupted record.
+ * @param apply       If true, the variables are set to the data of the records
+ * @param valid_size  Updated with the size of the journal up to the last valid record
+ * @returns the number of records of the variables of the component
+ */
+static int tlm_journal_read_records(FILE *file, tlm_component *comp_ptr, bool apply, uint32_t *valid_size)
+{
+    uint8_t header[TLM_JOURNAL_RECORD_HDR_SIZE];
+    char name[UINT8_MAX + 1];
+    uint8_t *data = NULL;
+    uint32_t data_buffer_size = 0;
+    int count = 0;
+
+    *valid_size = TLM_JOURNAL_MAGIC_SIZE;
+    while (sizeof(header) == fread(header, 1, sizeof(header), file))
+    {
+        const uint32_t name_len = header[0];
+        const uint32_t data_len = header[1] | (header[2] << 8);
+        const uint16_t crc = header[3] | (header[4] << 8);
+
+        if (data_len > data_buffer_size) {
+            uint8_t *new_data = realloc(data, data_len);
+            if (NULL == new_data) {
+                break;
+            }
+            data = new_data;
+            data_buffer_size = data_len;
+        }
+
+        if (name_len != fread(name, 1, name_len, file) ||
+            data_len != fread(data, 1, data_len, file) ||
+            crc != tlm_journal_crc16(tlm_journal_crc16(0xFFFF, name, name_len), data, data_len)) {
+            break;
+        }
+        name[name_len] = '\0';
+        *valid_size += sizeof(header) + name_len + data_len;
+
+        /* Records of variables that are no longer registered, or changed size are skipped */
+        const tlm_reg_var_type *var = tlm_variable_get_by_name(comp_ptr, name);
+        if (NULL != var && tlm_journal_var_size(var) == data_len) {
+            if (apply) {
+                memcpy((void*)var->data_ptr, data, data_len);
+            }
+            ++count;
+        }
+    }
+
+    free(data);
+    return count;
+}
+
+/// @returns true if the file begins with the journal magic bytes
+static bool tlm_journal_read_magic(FILE *file)
+{
+    char magic[TLM_JOURNAL_MAGIC_SIZE];
+    return (sizeof(magic) == fread(magic, 1, sizeof(magic), file) &&
+            0 == memcmp(magic, TLM_JOURNAL_MAGIC, sizeof(magic)));
+}
+
+/// Gets the name of the file that the journal is written to before it replaces the journal
+static bool tlm_journal_get_tmp_name(char *tmp_name, const char *filename)
+{
+    if (NULL == filename || strlen(filename) > TLM_JOURNAL_MAX_FILENAME) {
+        return false;
+    }
+    strcpy(tmp_name, filename);
+    strcat(tmp_name, ".tmp");
+    return true;
+}
+
+int tlm_journal_restore(tlm_component *comp_ptr, const char *filename)
+{
+    char tmp_name[TLM_JOURNAL_MAX_FILENAME + 5];
+    uint32_t valid_size = 0;
+    int count = -1;
+
+    if (NULL == comp_ptr || !tlm_journal_get_tmp_name(tmp_name, filename)) {
+        return count;
+    }
+
+    /* If the journal is missing, then the power was lost while the compacted
+     * journal was replacing it, so restore from the compacted journal.
+     */
+    FILE *file = fopen(filename, "rb");
+    if (NULL == file) {
+        file = fopen(tmp_name, "rb");
+    }
+
+    if (NULL != file) {
+        if (tlm_journal_read_magic(file)) {
+            count = tlm_journal_read_records(file, comp_ptr, true, &valid_size);
+        }
+        else {
+            /* Not a journal, but it may have been saved by tlm_stream_one_file() */
+            rewind(file);
+            count = tlm_stream_decode_file(file) ? (int)comp_ptr->var_count : 0;
+        }
+        fclose(file);
+    }
+
+    return count;
+}
+
+uint32_t tlm_journal_save_all(tlm_component *comp_ptr, const char *filename)
+{
+    char tmp_name[TLM_JOURNAL_MAX_FILENAME + 5];
+    const tlm_reg_var_type *var = NULL;
+    uint32_t size = TLM_JOURNAL_MAGIC_SIZE;
+
+    if (NULL == comp_ptr || !tlm_journal_get_tmp_name(tmp_name, filename)) {
+        return 0;
+    }
+
+    FILE *file = fopen(tmp_name, "wb");
+    if (NULL == file) {
+        return 0;
+    }
+
+    bool success = (TLM_JOURNAL_MAGIC_SIZE == fwrite(TLM_JOURNAL_MAGIC, 1, TLM_JOURNAL_MAGIC_SIZE, file));
+    for (var = comp_ptr->first_var; NULL != var && success; var = var->next) {
+        success = tlm_journal_write_record(file, var, var->data_ptr);
+        size += tlm_journal_record_size(var);
+    }
+    success = (0 == fclose(file)) && success;
+
+    /* Replace the journal only after the new one is completely written */
+    if (success) {
+        remove(filename);
+        success = (0 == rename(tmp_name, filename));
+    }
+
+    return success ? size : 0;
+}
+
+bool tlm_journal_init(tlm_journal_t *journal, tlm_component *comp_ptr, const char *filename)
+{
+    const tlm_reg_var_type *var = NULL;
+    uint32_t shadow_size = 0;
+    uint32_t valid_size = 0;
+
+    if (NULL == journal || NULL == comp_ptr || NULL == filename) {
+        return false;
+    }
+
+    memset(journal, 0, sizeof(*journal));
+    journal->comp = comp_ptr;
+    journal->filename = filename;
+    journal->scan_unmarked = true;
+    journal->var_count = comp_ptr->var_count;
+    journal->full_size = TLM_JOURNAL_MAGIC_SIZE;
+
+    for (var = comp_ptr->first_var; NULL != var; var = var->next) {
+        shadow_size += tlm_journal_var_size(var);
+        journal->full_size += tlm_journal_record_size(var);
+    }
+
+    /* Allocate at least 1 byte so a component without variables is still initialized */
+    journal->shadow = malloc(shadow_size + 1);
+    journal->saved_gen = malloc((journal->var_count + 1) * sizeof(uint32_t));
+    if (NULL == journal->shadow || NULL == journal->saved_gen) {
+        tlm_journal_free(journal);
+        return false;
+    }
+
+    /* The variables should have been restored from the journal, so it has their current values */
+    uint32_t i = 0, offset = 0;
+    for (var = comp_ptr->first_var; NULL != var; var = var->next, i++) {
+        memcpy(journal->shadow + offset, var->data_ptr, tlm_journal_var_size(var));
+        journal->saved_gen[i] = var->generation;
+        offset += tlm_journal_var_size(var);
+    }
+
+    /* Records can only be appended to a valid journal that does not end with a truncated record */
+    journal->compact_needed = true;
+    FILE *file = fopen(filename, "rb");
+    if (NULL != file) {
+        if (tlm_journal_read_magic(file)) {
+            tlm_journal_read_records(file, comp_ptr, false, &valid_size);
+            if (0 == fseek(file, 0, SEEK_END) && valid_size == (uint32_t)ftell(file)) {
+                journal->file_size = valid_size;
+                journal->compact_needed = false;
+            }
+        }
+        fclose(file);
+    }
+
+    return true;
+}
+
+void tlm_journal_free(tlm_journal_t *journal)
+{
+    if (NULL != journal) {
+        free(journal->shadow);
+        free(journal->saved_gen);
+        journal->shadow = NULL;
+        journal->saved_gen = NULL;
+    }
+}
+
+bool tlm_journal_compact(tlm_journal_t *journal)
+{
+    const tlm_reg_var_type *var = NULL;
+    uint32_t i = 0, offset = 0;
+
+    if (NULL == journal || NULL == journal->shadow) {
+        return false;
+    }
+
+    /* Take the snapshot before saving so that changes made while saving are not missed */
+    for (var = journal->comp->first_var; NULL != var && i < journal->var_count; var = var->next, i++) {
+        memcpy(journal->shadow + offset, var->data_ptr, tlm_journal_var_size(var));
+        journal->saved_gen[i] = var->generation;
+        offset += tlm_journal_var_size(var);
+    }
+
+    const uint32_t size = tlm_journal_save_all(journal->comp, journal->filename);
+    journal->compact_needed = (0 == size);
+    if (0 != size) {
+        journal->file_size = size;
+        journal->bytes_written += size;
+    }
+
+    return (0 != size);
+}
+
+int tlm_journal_sync(tlm_journal_t *journal)
+{
+    const tlm_reg_var_type *var = NULL;
+    uint32_t i = 0, offset = 0;
+    FILE *file = NULL;
+    int changed = 0;
+
+    if (NULL == journal || NULL == journal->shadow || journal->var_count != journal->comp->var_count) {
+        return -1;
+    }
+
+    for (var = journal->comp->first_var; NULL != var; var = var->next, i++)
+    {
+        const uint32_t size = tlm_journal_var_size(var);
+        char *shadow = journal->shadow + offset;
+        offset += size;
+
+        if (var->generation == journal->saved_gen[i] &&
+            (!journal->scan_unmarked || 0 == memcmp(shadow, var->data_ptr, size))) {
+            continue;
+        }
+
+        /* Write the copy so the record is consistent even if the variable changes while writing */
+        journal->saved_gen[i] = var->generation;
+        memcpy(shadow, var->data_ptr, size);
+        ++changed;
+
+        /* If a write fails, the journal is compacted which writes every variable anyway */
+        if (journal->compact_needed) {
+            continue;
+        }
+        if (NULL == file && NULL == (file = fopen(journal->filename, "ab"))) {
+            journal->compact_needed = true;
+            continue;
+        }
+        if (tlm_journal_write_record(file, var, shadow)) {
+            journal->file_size += tlm_journal_record_size(var);
+            journal->bytes_written += tlm_journal_record_size(var);
+        }
+        else {
+            journal->compact_needed = true;
+        }
+    }
+
+    if (NULL != file && 0 != fclose(file)) {
+        journal->compact_needed = true;
+    }
+
+    if (journal->compact_needed || journal->file_size > (journal->full_size * TLM_JOURNAL_COMPACT_RATIO)) {
+        if (!tlm_journal_compact(journal)) {
+            changed = -1;
+        }
+    }
+
+    return changed;
+}
@@ -0,0 +1,390 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <string.h>
+
+#include "c_tlm_recorder.h"
+
+
+
+#define TLM_RECORDER_ALIGN      8   ///< Alignment of the rows, such that 64-bit variables can be printed from a row
+#define TLM_RECORDER_PRINT_SIZE 128 ///< Size of the buffer to print a single value
+#define TLM_RECORDER_EXT_SIZE   4   ///< Size of the extended periods after the sample header
+
+static inline uint32_t tlm_recorder_align(uint32_t size)
+{
+    return (size + TLM_RECORDER_ALIGN - 1) & ~(TLM_RECORDER_ALIGN - 1);
+}
+
+/// @returns the offset of a variable at the end of the row; variables are stored at their natural alignment
+static uint32_t tlm_recorder_next_offset(const tlm_recorder_t *rec, const tlm_reg_var_type *var)
+{
+    const uint32_t align = var->elm_size_bytes;
+    uint32_t offset = rec->row_size;
+
+    if (align > 1 && align <= TLM_RECORDER_ALIGN && 0 == (align & (align - 1))) {
+        offset = (offset + align - 1) & ~(align - 1);
+    }
+    return offset;
+}
+
+/// Carves out the rows and the ring from the buffer once the variables are known
+static bool tlm_recorder_start(tlm_recorder_t *rec)
+{
+    const uint32_t skip = tlm_recorder_align((uint32_t)(uintptr_t)rec->buffer) - (uint32_t)(uintptr_t)rec->buffer;
+    const uint32_t row_space = tlm_recorder_align(rec->row_size);
+
+    /* The ring needs to fit at least the largest sample */
+    if (0 == rec->var_count ||
+        rec->buffer_size < skip + (3 * row_space) + 1 + TLM_RECORDER_EXT_SIZE + rec->mask_size + rec->row_size) {
+        return false;
+    }
+
+    rec->base_row = rec->buffer + skip;
+    rec->prev_row = rec->base_row + row_space;
+    rec->scratch_row = rec->prev_row + row_space;
+    rec->ring = rec->scratch_row + row_space;
+    rec->ring_size = rec->buffer_size - skip - (3 * row_space);
+    memset(rec->base_row, 0, 3 * row_space);
+    return true;
+}
+
+/// Copies the variables to a row
+static void tlm_recorder_read_vars(const tlm_recorder_t *rec, uint8_t *row)
+{
+    uint32_t i = 0;
+    for (i = 0; i < rec->var_count; i++) {
+        const tlm_reg_var_type *var = rec->vars[i];
+        memcpy(row + rec->offsets[i], var->data_ptr, var->elm_size_bytes * var->elm_arr_size);
+    }
+}
+
+static inline uint8_t tlm_recorder_ring_get(const tlm_recorder_t *rec, uint32_t *index)
+{
+    const uint8_t byte = rec->ring[*index];
+    if (++(*index) >= rec->ring_size) {
+        *index = 0;
+    }
+    return byte;
+}
+
+static inline void tlm_recorder_ring_put(tlm_recorder_t *rec, uint8_t byte)
+{
+    rec->ring[rec->ring_head] = byte;
+    if (++(rec->ring_head) >= rec->ring_size) {
+        rec->ring_head = 0;
+    }
+}
+
+static inline uint32_t tlm_recorder_ring_tail(const tlm_recorder_t *rec)
+{
+    return (rec->ring_head >= rec->ring_used) ? (rec->ring_head - rec->ring_used)
+                                              : (rec->ring_head + rec->ring_size - rec->ring_used);
+}
+
+/**
+ * Applies the sample at the index of the ring to the row
+ * @param [in,out] index  The index of the sample, which is set to the index of the next sample
+ * @param [out] periods   The number of periods since the previous sample
+ * @returns the size of the sample in the ring
+ */
+static uint32_t tlm_recorder_apply(const tlm_recorder_t *rec, uint32_t *index, uint8_t *row, uint32_t *periods)
+{
+    const uint8_t header = tlm_recorder_ring_get(rec, index);
+    uint32_t mask_index = 0;
+    uint32_t size = 1;
+    uint32_t i = 0;
+    uint8_t mask = 0;
+
+    *periods = header & TLM_RECORDER_PERIODS_MASK;
+    if (TLM_RECORDER_EXT_PERIODS == *periods) {
+        *periods = 0;
+        for (i = 0; i < TLM_RECORDER_EXT_SIZE; i++) {
+            *periods |= (uint32_t)tlm_recorder_ring_get(rec, index) << (8 * i);
+        }
+        size += TLM_RECORDER_EXT_SIZE;
+    }
+    if (header & TLM_RECORDER_UNCHANGED) {
+        return size;
+    }
+
+    /* The changed bytes follow the mask */
+    mask_index = *index;
+    size += rec->mask_size;
+    *index = (*index + rec->mask_size) % rec->ring_size;
+    for (i = 0; i < rec->row_size; i++) {
+        if (0 == (i & 7)) {
+            mask = tlm_recorder_ring_get(rec, &mask_index);
+        }
+        if (mask & (1 << (i & 7))) {
+            row[i] = tlm_recorder_ring_get(rec, index);
+            size++;
+        }
+    }
+    return size;
+}
+
+/// Discards the oldest sample by applying the next sample to the oldest row
+static void tlm_recorder_discard_oldest(tlm_recorder_t *rec)
+{
+    uint32_t index = tlm_recorder_ring_tail(rec);
+    uint32_t periods = 0;
+
+    rec->ring_used -= tlm_recorder_apply(rec, &index, rec->base_row, &periods);
+    rec->base_ms += periods * rec->period_ms;
+    rec->sample_count--;
+}
+
+/// Stores the scratch row as the bytes changed since the previous row
+static void tlm_recorder_store(tlm_recorder_t *rec, uint32_t periods)
+{
+    uint32_t changed = 0;
+    uint32_t size = 1;
+    uint32_t i = 0;
+    uint8_t mask = 0;
+
+    const bool extended = (periods >= TLM_RECORDER_EXT_PERIODS);
+
+    for (i = 0; i < rec->row_size; i++) {
+        changed += (rec->scratch_row[i] != rec->prev_row[i]);
+    }
+    if (changed > 0) {
+        size += rec->mask_size + changed;
+    }
+    if (extended) {
+        size += TLM_RECORDER_EXT_SIZE;
+    }
+
+    while (rec->ring_size - rec->ring_used < size) {
+        tlm_recorder_discard_oldest(rec);
+    }
+
+    tlm_recorder_ring_put(rec, (extended ? TLM_RECORDER_EXT_PERIODS : (uint8_t)periods) |
+                               (changed ? 0 : TLM_RECORDER_UNCHANGED));
+    if (extended) {
+        for (i = 0; i < TLM_RECORDER_EXT_SIZE; i++) {
+            tlm_recorder_ring_put(rec, (uint8_t)(periods >> (8 * i)));
+        }
+    }
+
+    if (changed > 0) {
+        for (i = 0; i < rec->row_size; i++) {
+            if (rec->scratch_row[i] != rec->prev_row[i]) {
+                mask |= (1 << (i & 7));
+            }
+            if (7 == (i & 7) || i + 1 == rec->row_size) {
+                tlm_recorder_ring_put(rec, mask);
+                mask = 0;
+            }
+        }
+        for (i = 0; i < rec->row_size; i++) {
+            if (rec->scratch_row[i] != rec->prev_row[i]) {
+                tlm_recorder_ring_put(rec, rec->scratch_row[i]);
+            }
+        }
+    }
+
+    rec->ring_used += size;
+    rec->sample_count++;
+    memcpy(rec->prev_row, rec->scratch_row, rec->row_size);
+}
+
+void tlm_recorder_init(tlm_recorder_t *rec, void *buffer, uint32_t size, uint32_t period_ms)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->buffer = buffer;
+    rec->buffer_size = size;
+    rec->period_ms = period_ms ? period_ms : 1;
+    rec->samples_to_freeze = -1;
+}
+
+bool tlm_recorder_add(tlm_recorder_t *rec, tlm_component *comp_ptr, const char *name)
+{
+    const tlm_reg_var_type *var = tlm_variable_get_by_name(comp_ptr, name);
+    if (NULL == var || rec->var_count >= TLM_RECORDER_MAX_VARS || NULL != rec->ring) {
+        return false;
+    }
+
+    rec->comps[rec->var_count] = comp_ptr;
+    rec->vars[rec->var_count] = var;
+    rec->offsets[rec->var_count] = tlm_recorder_next_offset(rec, var);
+    rec->row_size = rec->offsets[rec->var_count] + (var->elm_size_bytes * var->elm_arr_size);
+    rec->mask_size = (rec->row_size + 7) / 8;
+    rec->var_count++;
+    return true;
+}
+
+void tlm_recorder_set_trigger(tlm_recorder_t *rec, tlm_recorder_trigger_func trigger, void *arg,
+                              uint32_t post_samples)
+{
+    rec->trigger = trigger;
+    rec->trigger_arg = arg;
+    rec->post_trigger_samples = post_samples;
+}
+
+bool tlm_recorder_sample(tlm_recorder_t *rec, uint32_t now_ms)
+{
+    uint32_t periods = 0;
+
+    if (rec->frozen) {
+        return false;
+    }
+    if (NULL == rec->ring && !tlm_recorder_start(rec)) {
+        return false;
+    }
+
+    if (0 == rec->sample_count) {
+        tlm_recorder_read_vars(rec, rec->base_row);
+        memcpy(rec->prev_row, rec->base_row, rec->row_size);
+        rec->base_ms = rec->last_ms = now_ms;
+        rec->sample_count = 1;
+    }
+    else {
+        /* Samples stay on the period boundaries even if this is called late */
+        periods = (now_ms - rec->last_ms) / rec->period_ms;
+        if (0 == periods) {
+            return false;
+        }
+        rec->last_ms += periods * rec->period_ms;
+
+        tlm_recorder_read_vars(rec, rec->scratch_row);
+        tlm_recorder_store(rec, periods);
+    }
+
+    if (rec->samples_to_freeze < 0 && rec->trigger && rec->trigger(rec->trigger_arg)) {
+        tlm_recorder_trigger(rec);
+    }
+    else if (rec->samples_to_freeze > 0 && 0 == --(rec->samples_to_freeze)) {
+        rec->frozen = true;
+    }
+    return true;
+}
+
+void tlm_recorder_trigger(tlm_recorder_t *rec)
+{
+    if (rec->samples_to_freeze < 0) {
+        rec->samples_to_freeze = rec->post_trigger_samples;
+        rec->frozen = (0 == rec->post_trigger_samples);
+    }
+}
+
+void tlm_recorder_restart(tlm_recorder_t *rec)
+{
+    rec->ring_head = 0;
+    rec->ring_used = 0;
+    rec->sample_count = 0;
+    rec->samples_to_freeze = -1;
+    rec->frozen = false;
+}
+
+uint32_t tlm_recorder_for_each_row(tlm_recorder_t *rec, tlm_recorder_row_func callback, void *arg)
+{
+    uint32_t index = tlm_recorder_ring_tail(rec);
+    uint32_t time_ms = rec->base_ms;
+    uint32_t periods = 0;
+    uint32_t i = 0;
+
+    if (0 == rec->sample_count) {
+        return 0;
+    }
+
+    memcpy(rec->scratch_row, rec->base_row, rec->row_size);
+    callback(rec->scratch_row, time_ms, arg);
+
+    for (i = 1; i < rec->sample_count; i++) {
+        tlm_recorder_apply(rec, &index, rec->scratch_row, &periods);
+        time_ms += periods * rec->period_ms;
+        callback(rec->scratch_row, time_ms, arg);
+    }
+    return rec->sample_count;
+}
+
+typedef struct {
+    const tlm_recorder_t *rec;
+    stream_callback_type stream;
+    void *arg;
+} tlm_recorder_dump_args_t;
+
+/// Streams a row as a CSV line
+static void tlm_recorder_dump_row(const uint8_t *row, uint32_t time_ms, void *arg)
+{
+    const tlm_recorder_dump_args_t *dump = arg;
+    const tlm_recorder_t *rec = dump->rec;
+    char buffer[TLM_RECORDER_PRINT_SIZE];
+    uint32_t i = 0;
+
+    snprintf(buffer, sizeof(buffer), "%lu", (unsigned long)time_ms);
+    dump->stream(buffer, dump->arg);
+
+    for (i = 0; i < rec->var_count; i++) {
+        const uint8_t *data = row + rec->offsets[i];
+        tlm_reg_var_type var = *(rec->vars[i]);
+        const char *value = buffer;
+
+        if (tlm_string == var.elm_type) {
+            snprintf(buffer, sizeof(buffer), "%.*s", (int)(var.elm_size_bytes * var.elm_arr_size), (const char*)data);
+        }
+        else {
+            /* Print the value of the row rather than the variable, and skip the "type:" prefix */
+            var.data_ptr = data;
+            if (!tlm_variable_print_value(&var, buffer, sizeof(buffer))) {
+                buffer[0] = '\0';
+            }
+            value = strchr(buffer, ':');
+            value = value ? (value + 1) : buffer;
+        }
+
+        dump->stream(",", dump->arg);
+        if (strchr(value, ',')) {
+            dump->stream("\"", dump->arg);
+            dump->stream(value, dump->arg);
+            dump->stream("\"", dump->arg);
+        }
+        else {
+            dump->stream(value, dump->arg);
+        }
+    }
+    dump->stream("\n", dump->arg);
+}
+
+uint32_t tlm_recorder_dump(tlm_recorder_t *rec, stream_callback_type stream, void *arg)
+{
+    tlm_recorder_dump_args_t dump = { rec, stream, arg };
+    uint32_t i = 0;
+
+    stream("time_ms", arg);
+    for (i = 0; i < rec->var_count; i++) {
+        stream(",", arg);
+        stream(rec->comps[i]->name, arg);
+        stream(".", arg);
+        stream(rec->vars[i]->name, arg);
+    }
+    stream("\n", arg);
+
+    return tlm_recorder_for_each_row(rec, tlm_recorder_dump_row, &dump);
+}
+
+static void tlm_recorder_file_stream(const char *str, void *arg)
+{
+    fputs(str, (FILE*)arg);
+}
+
+uint32_t tlm_recorder_dump_file(tlm_recorder_t *rec, FILE *file)
+{
+    return tlm_recorder_dump(rec, tlm_recorder_file_stream, file);
+}
@@ -50,14 +50,12 @@ static void tlm_stream_file_ptr(const char *str, void *fptr)
 }
 
 /**
- * Callback function for each component's variables
+ * Streams one of the component's variables
  */
-static bool tlm_stream_for_each_component_var(void *elm_ptr, void *arg1, void *arg2, void *print_ascii)
+static bool tlm_stream_one_var(const tlm_reg_var_type *var, stream_callback_type stream,
+                               void *stream_arg, void *print_ascii)
 {
     char buff[256];
-    tlm_reg_var_type *var = elm_ptr;
-    stream_callback_type stream = arg1;
-    void *stream_arg = arg2;
     char *p = (char*)(var->data_ptr);
     uint32_t i = 0;
 
@@ -180,7 +178,7 @@ void tlm_stream_one(tlm_component *comp, stream_callback_type stream, void *prin
 
     /* sca : stream callback argument */
     char buff[16] = { 0 };
-    sprintf(buff, "%u\n", (unsigned int)c_list_node_count((comp->var_list)));
+    sprintf(buff, "%u\n", (unsigned int)(comp->var_count));
 
     /* Send: "START:<name>:<#>\n" */
     stream("START:", sca);
@@ -188,14 +186,11 @@ void tlm_stream_one(tlm_component *comp, stream_callback_type stream, void *prin
     stream(":", sca);
     stream(buff, sca);
 
-    /* Now for each variable list of this component, make a call-back to our
-     * component for each function that will stream data of each variable
-     */
-    c_list_for_each_elm((comp->var_list), tlm_stream_for_each_component_var,
-                        stream,     /* arg1 */
-                        sca,        /* arg2 */
-                        print_ascii /* arg3 */
-                        );
+    /* Now stream the data of each variable of this component */
+    const tlm_reg_var_type *var = NULL;
+    for (var = comp->first_var; NULL != var; var = var->next) {
+        tlm_stream_one_var(var, stream, sca, print_ascii);
+    }
 
     /* Send: "END:<name>\n" */
     stream("END:", sca);
@@ -269,6 +264,13 @@ bool tlm_stream_decode_file(FILE *file)
     tlm_component *component = NULL;
     bool success = false;
 
+    /* The binary stream begins with its schema frame instead of "START:" */
+    const int first_char = fgetc(file);
+    ungetc(first_char, file);
+    if (TLM_STREAM_BIN_SCHEMA == first_char) {
+        return tlm_stream_bin_decode_file(file);
+    }
+
     /* Telemetry begins with: "START:<name>:<#>\n"
      * A file can contain telemetry of multiple components so it may have
      * START ... END
@@ -308,3 +310,259 @@ bool tlm_stream_decode_file(FILE *file)
     /* success only changed to true if we got atleast one "START" in the file */
     return success;
 }
+
+
+/**
+ * Binary stream output that either streams the data, or only counts the bytes
+ * to get the length of the payload of a frame.
+ */
+typedef struct {
+    stream_bin_callback_type stream; ///< The stream function, or NULL to only count the bytes
+    void *arg;                       ///< The argument of the stream function
+    uint32_t len;                    ///< The number of bytes streamed
+    uint32_t comp_count;             ///< The number of components streamed
+} tlm_stream_bin_out_t;
+
+static void tlm_stream_bin_out(tlm_stream_bin_out_t *out, const void *data, uint32_t len)
+{
+    if (NULL != out->stream && 0 != len) {
+        out->stream(data, len, out->arg);
+    }
+    out->len += len;
+}
+
+static void tlm_stream_bin_out_uint(tlm_stream_bin_out_t *out, uint32_t value, uint32_t bytes)
+{
+    const uint8_t le[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    tlm_stream_bin_out(out, le, bytes);
+}
+
+static void tlm_stream_bin_out_name(tlm_stream_bin_out_t *out, const char *name)
+{
+    const uint32_t len = strlen(name);
+    const uint32_t name_len = (len > UINT8_MAX) ? UINT8_MAX : len;
+
+    tlm_stream_bin_out_uint(out, name_len, 1);
+    tlm_stream_bin_out(out, name, name_len);
+}
+
+/// Callback of tlm_component_for_each() to stream the schema of one component
+static void tlm_stream_bin_comp_schema(tlm_component *comp_ptr, void *arg1, void *arg2)
+{
+    tlm_stream_bin_out_t *out = arg1;
+    const tlm_reg_var_type *var = NULL;
+
+    tlm_stream_bin_out_name(out, comp_ptr->name);
+    tlm_stream_bin_out_uint(out, comp_ptr->var_count, 2);
+    for (var = comp_ptr->first_var; NULL != var; var = var->next) {
+        tlm_stream_bin_out_name(out, var->name);
+        tlm_stream_bin_out_uint(out, var->elm_type, 1);
+        tlm_stream_bin_out_uint(out, var->elm_size_bytes, 2);
+        tlm_stream_bin_out_uint(out, var->elm_arr_size, 2);
+    }
+    ++out->comp_count;
+}
+
+/// Callback of tlm_component_for_each() to stream the values of one component
+static void tlm_stream_bin_comp_values(tlm_component *comp_ptr, void *arg1, void *arg2)
+{
+    tlm_stream_bin_out_t *out = arg1;
+    const tlm_reg_var_type *var = NULL;
+
+    for (var = comp_ptr->first_var; NULL != var; var = var->next) {
+        tlm_stream_bin_out(out, var->data_ptr, (var->elm_size_bytes) * (var->elm_arr_size));
+    }
+    ++out->comp_count;
+}
+
+/**
+ * Streams a frame of the binary stream.  The payload is produced twice by the callback :
+ * once to get its length for the frame header, and then to actually stream it.
+ */
+static void tlm_stream_bin_frame(tlm_component *comp_ptr, uint8_t type, tlm_comp_callback callback,
+                                 stream_bin_callback_type stream, void *arg)
+{
+    tlm_stream_bin_out_t count = { NULL, NULL, 0, 0 };
+    tlm_stream_bin_out_t out = { stream, arg, 0, 0 };
+    const uint32_t count_size = (TLM_STREAM_BIN_SCHEMA == type) ? 2 : 0;
+
+    if (NULL == stream) {
+        return;
+    }
+
+    if (NULL != comp_ptr) {
+        callback(comp_ptr, &count, NULL);
+    } else {
+        tlm_component_for_each(callback, &count, NULL);
+    }
+
+    tlm_stream_bin_out_uint(&out, type, 1);
+    tlm_stream_bin_out_uint(&out, count_size + count.len, 4);
+    tlm_stream_bin_out_uint(&out, count.comp_count, count_size);
+
+    if (NULL != comp_ptr) {
+        callback(comp_ptr, &out, NULL);
+    } else {
+        tlm_component_for_each(callback, &out, NULL);
+    }
+}
+
+void tlm_stream_bin_schema(tlm_component *comp_ptr, stream_bin_callback_type stream, void *arg)
+{
+    tlm_stream_bin_frame(comp_ptr, TLM_STREAM_BIN_SCHEMA, tlm_stream_bin_comp_schema, stream, arg);
+}
+
+void tlm_stream_bin_values(tlm_component *comp_ptr, stream_bin_callback_type stream, void *arg)
+{
+    tlm_stream_bin_frame(comp_ptr, TLM_STREAM_BIN_VALUES, tlm_stream_bin_comp_values, stream, arg);
+}
+
+static void tlm_stream_bin_file_ptr(const void *data, uint32_t len, void *fptr)
+{
+    fwrite(data, 1, len, (FILE*)fptr);
+}
+
+void tlm_stream_bin_file(tlm_component *comp_ptr, FILE *file)
+{
+    if (file) {
+        tlm_stream_bin_schema(comp_ptr, tlm_stream_bin_file_ptr, file);
+        tlm_stream_bin_values(comp_ptr, tlm_stream_bin_file_ptr, file);
+    }
+}
+
+/// Location of a variable of the schema within the values frame
+typedef struct {
+    const tlm_reg_var_type *var; ///< The registered variable, or NULL if it is not registered
+    uint32_t size;               ///< Size of the variable in the values frame
+} tlm_stream_bin_var_t;
+
+/// @returns the little endian number at p, and advances p
+static uint32_t tlm_stream_bin_get_uint(const uint8_t **p, uint32_t bytes)
+{
+    uint32_t value = 0, i = 0;
+    for (i = 0; i < bytes; i++) {
+        value |= (uint32_t)(*p)[i] << (8 * i);
+    }
+    *p += bytes;
+    return value;
+}
+
+/// Gets the name at p as a NULL terminated string, and advances p
+static bool tlm_stream_bin_get_name(const uint8_t **p, const uint8_t *end, char name[UINT8_MAX + 1])
+{
+    if (*p >= end || *p + 1 + **p > end) {
+        return false;
+    }
+    const uint32_t len = tlm_stream_bin_get_uint(p, 1);
+    memcpy(name, *p, len);
+    name[len] = '\0';
+    *p += len;
+    return true;
+}
+
+/**
+ * Parses the schema payload
+ * @param vars  The array to store the location of each variable to, or NULL to just count them
+ * @param var_count   Updated with the number of variables of the schema
+ * @param values_len  Updated with the expected length of the values frame
+ * @returns false if the schema is invalid
+ */
+static bool tlm_stream_bin_parse_schema(const uint8_t *p, uint32_t len, tlm_stream_bin_var_t *vars,
+                                        uint32_t *var_count, uint32_t *values_len)
+{
+    const uint8_t *end = p + len;
+    char name[UINT8_MAX + 1];
+    uint32_t c = 0, v = 0;
+
+    *var_count = 0;
+    *values_len = 0;
+    if (len < 2) {
+        return false;
+    }
+
+    const uint32_t comp_count = tlm_stream_bin_get_uint(&p, 2);
+    for (c = 0; c < comp_count; c++)
+    {
+        if (!tlm_stream_bin_get_name(&p, end, name) || p + 2 > end) {
+            return false;
+        }
+        tlm_component *comp_ptr = tlm_component_get_by_name(name);
+        const uint32_t comp_var_count = tlm_stream_bin_get_uint(&p, 2);
+
+        for (v = 0; v < comp_var_count; v++)
+        {
+            if (!tlm_stream_bin_get_name(&p, end, name) || p + 5 > end) {
+                return false;
+            }
+            tlm_stream_bin_get_uint(&p, 1); /* Type is only needed by the host tools */
+            const uint32_t elm_size = tlm_stream_bin_get_uint(&p, 2);
+            const uint32_t arr_size = tlm_stream_bin_get_uint(&p, 2);
+
+            if (NULL != vars) {
+                const tlm_reg_var_type *var = tlm_variable_get_by_name(comp_ptr, name);
+                vars[*var_count].size = elm_size * arr_size;
+                vars[*var_count].var = (NULL != var && (var->elm_size_bytes * var->elm_arr_size) ==
+                                        elm_size * arr_size) ? var : NULL;
+            }
+            ++(*var_count);
+            *values_len += elm_size * arr_size;
+        }
+    }
+
+    return true;
+}
+
+bool tlm_stream_bin_decode_file(FILE *file)
+{
+    uint8_t header[TLM_STREAM_BIN_HDR_SIZE];
+    uint8_t *payload = NULL;
+    uint32_t payload_buffer_size = 0;
+    tlm_stream_bin_var_t *vars = NULL;
+    uint32_t var_count = 0, values_len = 0, i = 0;
+    bool success = false;
+
+    /* Each frame is read as a whole, and then decoded */
+    while (sizeof(header) == fread(header, 1, sizeof(header), file))
+    {
+        const uint8_t *p = &header[1];
+        const uint32_t len = tlm_stream_bin_get_uint(&p, 4);
+
+        if (len > payload_buffer_size) {
+            uint8_t *new_payload = realloc(payload, len);
+            if (NULL == new_payload) {
+                break;
+            }
+            payload = new_payload;
+            payload_buffer_size = len;
+        }
+        if (len != fread(payload, 1, len, file)) {
+            break;
+        }
+
+        if (TLM_STREAM_BIN_SCHEMA == header[0])
+        {
+            free(vars);
+            vars = NULL;
+            if (!tlm_stream_bin_parse_schema(payload, len, NULL, &var_count, &values_len) ||
+                NULL == (vars = malloc((var_count + 1) * sizeof(*vars)))) {
+                break;
+            }
+            tlm_stream_bin_parse_schema(payload, len, vars, &var_count, &values_len);
+        }
+        else if (TLM_STREAM_BIN_VALUES == header[0] && NULL != vars && len == values_len)
+        {
+            p = payload;
+            for (i = 0; i < var_count; i++) {
+                if (NULL != vars[i].var) {
+                    memcpy((void*)vars[i].var->data_ptr, p, vars[i].size);
+                }
+                p += vars[i].size;
+            }
+            success = true;
+        }
+    }
+
+    free(vars);
+    free(payload);
+    return success;
+}
@@ -19,35 +19,68 @@
 
 
 #include <stdio.h>
-#include <stdlib.h> /* malloc() */
+#include <stdlib.h> /* calloc() */
 #include <string.h> /* strcmp() */
 #include <inttypes.h>
 
 #include "c_tlm_var.h"
 
 
-/** Private function of this file */
-static bool tlm_variable_check_dup(void *elm_ptr, void *arg1,
-                                     void *arg2, void *arg3)
+/**
+ * @returns the slot of the name index that has the variable by this name, or
+ * the empty slot at which it should be added.
+ */
+static tlm_reg_var_type** tlm_variable_find_name_slot(const tlm_component *comp_ptr, const char *name)
 {
-    tlm_reg_var_type *reg_var = elm_ptr;
-    tlm_reg_var_type *new_var = arg1;
+    const uint32_t mask = comp_ptr->index_size - 1;
+    uint32_t i = tlm_hash_name(name) & mask;
 
-    return (reg_var->data_ptr != new_var->data_ptr &&
-            0 != strcmp(reg_var->name, new_var->name)
-            );
+    while (NULL != comp_ptr->name_index[i] && 0 != strcmp(comp_ptr->name_index[i]->name, name)) {
+        i = (i + 1) & mask;
+    }
+    return &comp_ptr->name_index[i];
 }
 
-/** Private function of this file */
-static bool tlm_component_find_callback(void *elm_ptr, void *arg1, void *arg2, void *arg3)
+/**
+ * @returns the slot of the pointer index that has the variable with this data pointer,
+ * or the empty slot at which it should be added.
+ */
+static tlm_reg_var_type** tlm_variable_find_ptr_slot(const tlm_component *comp_ptr, const void *data_ptr)
 {
-    tlm_reg_var_type *reg_var = elm_ptr;
-    const char *name = arg1;
+    const uint32_t mask = comp_ptr->index_size - 1;
+    uint32_t i = (((uintptr_t)data_ptr >> 2) * 2654435761u) & mask;
 
-    /* If we locate the name, make copy of the pointer, and return false
-     * to stop iterating further through the list
-     */
-    return (0 != strcmp(name, reg_var->name));
+    while (NULL != comp_ptr->ptr_index[i] && data_ptr != comp_ptr->ptr_index[i]->data_ptr) {
+        i = (i + 1) & mask;
+    }
+    return &comp_ptr->ptr_index[i];
+}
+
+/// Doubles the size of the indexes of the component if they are 3/4 full
+static bool tlm_variable_grow_index(tlm_component *comp_ptr)
+{
+    if ((comp_ptr->var_count + 1) * 4 <= comp_ptr->index_size * 3) {
+        return true;
+    }
+
+    /* Both indexes are the same size, so allocate them together */
+    const uint32_t new_size = (0 == comp_ptr->index_size) ? TLM_INDEX_MIN_SIZE : (comp_ptr->index_size * 2);
+    tlm_reg_var_type **new_index = calloc(2 * new_size, sizeof(*new_index));
+    if (NULL == new_index) {
+        return false;
+    }
+
+    free(comp_ptr->name_index);
+    comp_ptr->name_index = new_index;
+    comp_ptr->ptr_index = new_index + new_size;
+    comp_ptr->index_size = new_size;
+
+    tlm_reg_var_type *var = NULL;
+    for (var = comp_ptr->first_var; NULL != var; var = var->next) {
+        *tlm_variable_find_name_slot(comp_ptr, var->name) = var;
+        *tlm_variable_find_ptr_slot(comp_ptr, var->data_ptr) = var;
+    }
+    return true;
 }
 
 
@@ -63,7 +96,19 @@ bool tlm_variable_register(tlm_component *comp_ptr,
         return false;
     }
 
-    tlm_reg_var_type *new_var = malloc(sizeof(tlm_reg_var_type));
+    /* Make room in the indexes before allocating the variable so nothing is lost upon failure */
+    if (!tlm_variable_grow_index(comp_ptr)) {
+        return false;
+    }
+
+    /* Another variable by the same name or same memory pointer is a duplicate */
+    tlm_reg_var_type **name_slot = tlm_variable_find_name_slot(comp_ptr, name);
+    tlm_reg_var_type **ptr_slot = tlm_variable_find_ptr_slot(comp_ptr, data_ptr);
+    if (NULL != *name_slot || NULL != *ptr_slot) {
+        return false;
+    }
+
+    tlm_reg_var_type *new_var = tlm_arena_alloc(sizeof(tlm_reg_var_type));
     if(NULL == new_var) {
         return false;
     }
@@ -77,16 +122,15 @@ bool tlm_variable_register(tlm_component *comp_ptr,
     new_var->elm_arr_size = 0 == arr_size ? 1 : arr_size;
     new_var->elm_type = type;
 
-    if (!c_list_for_each_elm(comp_ptr->var_list, tlm_variable_check_dup,
-                             (void*)new_var, NULL, NULL)) {
-        free(new_var);
-        return false;
-    }
-
-    if (!c_list_insert_elm_end(comp_ptr->var_list, new_var)) {
-        free(new_var);
-        return false;
+    if (NULL == comp_ptr->first_var) {
+        comp_ptr->first_var = new_var;
+    } else {
+        comp_ptr->last_var->next = new_var;
     }
+    comp_ptr->last_var = new_var;
+    *name_slot = new_var;
+    *ptr_slot = new_var;
+    ++comp_ptr->var_count;
 
     return true;
 }
@@ -94,24 +138,28 @@ bool tlm_variable_register(tlm_component *comp_ptr,
 const tlm_reg_var_type* tlm_variable_get_by_name(tlm_component *comp_ptr, const char *name)
 {
     tlm_reg_var_type *reg_var = NULL;
-    if (NULL != comp_ptr && NULL != name && '\0' != *name) {
-        reg_var = c_list_find_elm(comp_ptr->var_list, tlm_component_find_callback,
-                                  (void*)name, NULL, NULL);
+    if (NULL != comp_ptr && NULL != name && '\0' != *name && 0 != comp_ptr->var_count) {
+        reg_var = *tlm_variable_find_name_slot(comp_ptr, name);
     }
     return reg_var;
 }
 
 const tlm_reg_var_type* tlm_variable_get_by_comp_and_name(const char *comp_name, const char *name)
 {
-    tlm_reg_var_type *reg_var = NULL;
-    tlm_component *comp_ptr = tlm_component_get_by_name(comp_name);
+    return tlm_variable_get_by_name(tlm_component_get_by_name(comp_name), name);
+}
 
-    if (NULL != comp_ptr && NULL != name && '\0' != *name) {
-        reg_var = c_list_find_elm(comp_ptr->var_list, tlm_component_find_callback,
-                                  (void*)name, NULL, NULL);
+bool tlm_variable_mark_changed(tlm_component *comp_ptr, const void *data_ptr)
+{
+    tlm_reg_var_type *reg_var = NULL;
+    if (NULL != comp_ptr && NULL != data_ptr && 0 != comp_ptr->var_count) {
+        reg_var = *tlm_variable_find_ptr_slot(comp_ptr, data_ptr);
     }
 
-    return reg_var;
+    if (NULL != reg_var) {
+        ++reg_var->generation;
+    }
+    return (NULL != reg_var);
 }
 
 bool tlm_variable_set_value(const char *comp_name, const char *name, const char *value)
@@ -212,6 +260,10 @@ bool tlm_variable_set_value(const char *comp_name, const char *name, const char
             break;
     }
 
+    if (success) {
+        ++((tlm_reg_var_type*)reg_var)->generation;
+    }
+
     return success;
 }
 
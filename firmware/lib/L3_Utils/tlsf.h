@@ -0,0 +1,301 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Two-Level Segregated Fit (TLSF) memory allocator, used by the heap scheme 6
+ * @ingroup Utilities
+ *
+ * Free blocks are kept in segregated lists by their size.  The first level splits sizes
+ * by powers of two, and the second level splits each power of two into TLSF_SL_COUNT
+ * linear ranges.  A bitmap of each level tells which lists are not empty, so finding a
+ * free block, and splitting or merging blocks, is O(1) using the CLZ instruction.
+ * The worst-case time does not depend on the number of blocks, unlike heap_2 and heap_4
+ * that walk their list of free blocks.
+ *
+ * Block layout (TLSF_BLOCK_OVERHEAD bytes of header before the memory given out) :
+ *  - Pointer to the previous physical block (only valid if the previous block is free)
+ *  - Size of the block's memory, with bit 0 set if the block is free, and bit 1 set
+ *    if the previous physical block is free
+ *  - If free: next and previous pointers of the free list
+ *
+ * Multiple pools (such as the two SRAM regions) can be added, and the allocations may
+ * come from any of the pools.  The allocator is not thread safe; heap_tlsf.c.inc locks
+ * around each call.
+ *
+ * 20261015 : Initial
+ */
+#ifndef TLSF_H__
+#define TLSF_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+#define TLSF_ALIGN_LOG2     3                       ///< Blocks are aligned to 8 bytes (for double and long long)
+#define TLSF_ALIGN          (1 << TLSF_ALIGN_LOG2)  ///< Alignment of the memory given out
+#define TLSF_SL_LOG2        4                       ///< Log2 of the number of second level lists
+#define TLSF_SL_COUNT       (1 << TLSF_SL_LOG2)     ///< Number of second level lists of each first level
+#define TLSF_FL_SHIFT       (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2) ///< Sizes below (1 << TLSF_FL_SHIFT) use the first list
+#define TLSF_MAX_POOLS      4                       ///< Max number of pools
+
+#ifndef TLSF_FL_MAX_LOG2
+#define TLSF_FL_MAX_LOG2    17                      ///< Blocks are smaller than (1 << TLSF_FL_MAX_LOG2) bytes
+#endif
+#define TLSF_FL_COUNT       (TLSF_FL_MAX_LOG2 - TLSF_FL_SHIFT + 1)  ///< Number of first level lists
+
+/// Header of a block
+typedef struct tlsf_block {
+    struct tlsf_block *prev_phys;   ///< The previous physical block, only valid if it is free
+    size_t size;                    ///< Size of the memory of this block, and the free bits
+    struct tlsf_block *next_free;   ///< Next free block of the same list, if this block is free
+    struct tlsf_block *prev_free;   ///< Previous free block of the same list, if this block is free
+} tlsf_block_t;
+
+#define TLSF_BLOCK_OVERHEAD (offsetof(tlsf_block_t, next_free))                 ///< Bytes used by a block
+#define TLSF_BLOCK_MIN_SIZE (sizeof(tlsf_block_t) - TLSF_BLOCK_OVERHEAD)        ///< Smallest memory of a block
+#define TLSF_BLOCK_MAX_SIZE (((size_t)1 << TLSF_FL_MAX_LOG2) - TLSF_ALIGN)      ///< Largest memory of a block
+
+/// Statistics of the allocator @see tlsf_get_stats()
+typedef struct {
+    size_t total_bytes;         ///< Memory of all pools that can be given out (without the block overhead)
+    size_t used_bytes;          ///< Memory that is not free, including the overhead of the blocks
+    size_t free_bytes;          ///< Memory of the free blocks
+    size_t min_free_bytes;      ///< The lowest free_bytes ever
+    size_t largest_free_block;  ///< The largest memory that can be allocated now
+    uint32_t free_blocks;       ///< Number of free blocks
+    uint32_t used_blocks;       ///< Number of used blocks
+    uint32_t failed_allocs;     ///< Number of allocations that failed
+    uint32_t fragmentation;     ///< 0-100%: 100 * (1 - largest_free_block / free_bytes)
+} tlsf_stats_t;
+
+/// The allocator; use the functions rather than accessing its members
+typedef struct {
+    tlsf_block_t null_block;                        ///< All empty lists point to this block
+    uint32_t fl_bitmap;                             ///< Bit set for each first level with free blocks
+    uint32_t sl_bitmap[TLSF_FL_COUNT];              ///< Bit set for each second level list with free blocks
+    tlsf_block_t *blocks[TLSF_FL_COUNT][TLSF_SL_COUNT]; ///< The free lists
+
+    tlsf_block_t *pools[TLSF_MAX_POOLS];            ///< The first block of each pool
+    uint32_t pool_count;                            ///< Number of pools
+    size_t total_bytes;                             ///< @see tlsf_stats_t
+    size_t free_bytes;                              ///< @see tlsf_stats_t
+    size_t min_free_bytes;                          ///< @see tlsf_stats_t
+    uint32_t free_blocks;                           ///< @see tlsf_stats_t
+    uint32_t used_blocks;                           ///< @see tlsf_stats_t
+    uint32_t failed_allocs;                         ///< @see tlsf_stats_t
+} tlsf_t;
+
+/// Initializes the allocator without any memory
+void tlsf_init(tlsf_t *tlsf);
+
+/**
+ * Adds a pool of memory to the allocator
+ * @param mem    The memory, which is aligned to TLSF_ALIGN if it is not already aligned
+ * @param bytes  The size of the memory; memory beyond a single block of TLSF_BLOCK_MAX_SIZE is not used
+ * @returns false if the memory is too small, or if there are too many pools
+ */
+bool tlsf_add_pool(tlsf_t *tlsf, void *mem, size_t bytes);
+
+/**
+ * Allocates memory in O(1) time
+ * @returns NULL if there is no free block large enough
+ */
+void* tlsf_malloc(tlsf_t *tlsf, size_t bytes);
+
+/// Frees the memory given by tlsf_malloc() in O(1) time; ptr may be NULL
+void tlsf_free(tlsf_t *tlsf, void *ptr);
+
+/**
+ * Changes the size of the memory, in place if possible
+ * @returns the new memory, or NULL if there is no memory (and then ptr is not freed)
+ */
+void* tlsf_realloc(tlsf_t *tlsf, void *ptr, size_t bytes);
+
+/// @returns the usable size of the memory given by tlsf_malloc()
+size_t tlsf_block_size(const void *ptr);
+
+/// Gets the statistics of the allocator; this is O(number of free blocks of the largest list)
+void tlsf_get_stats(const tlsf_t *tlsf, tlsf_stats_t *stats);
+
+/**
+ * Walks all of the blocks of the pools, and checks that they are consistent with the
+ * free lists and the statistics.  This is O(number of blocks), and meant for tests.
+ * @returns true if the heap is consistent
+ */
+bool tlsf_check(const tlsf_t *tlsf);
+
+/**
+ * Gets the statistics of the heap shared by FreeRTOS, malloc() and new, for all of its
+ * regions (@see sys_heap_get_region() for each region)
+ * This only exists if the FreeRTOS heap scheme 6 is used (configMEM_MANG_TYPE)
+ */
+void tlsf_heap_get_stats(tlsf_stats_t *stats);
+
+
+
+#ifdef TESTING
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Fills the memory with a pattern of its index, such that overlapping blocks are detected
+static inline void test_tlsf_fill(void *ptr, size_t bytes, uint32_t index)
+{
+    memset(ptr, (int)(index & 0xFF), bytes);
+}
+
+static inline bool test_tlsf_verify(const void *ptr, size_t bytes, uint32_t index)
+{
+    const uint8_t *p = (const uint8_t*) ptr;
+    size_t i = 0;
+    for (i = 0; i < bytes; i++) {
+        if (p[i] != (index & 0xFF)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline void test_tlsf(void)
+{
+    enum { num_ptrs = 256 };
+    static uint64_t pool1[4096 / 8];
+    static uint64_t pool2[8192 / 8];
+    static void *ptrs[num_ptrs];
+    static size_t sizes[num_ptrs];
+    tlsf_stats_t stats;
+    tlsf_t tlsf;
+    uint32_t i = 0;
+
+    tlsf_init(&tlsf);
+    assert(NULL == tlsf_malloc(&tlsf, 8));
+    assert(!tlsf_add_pool(&tlsf, pool1, 8));
+    assert(tlsf_add_pool(&tlsf, (uint8_t*)pool1 + 1, sizeof(pool1) - 1));
+    assert(tlsf_add_pool(&tlsf, pool2, sizeof(pool2)));
+    assert(tlsf_check(&tlsf));
+
+    tlsf_get_stats(&tlsf, &stats);
+    assert(2 == stats.free_blocks);
+    assert(0 == stats.used_blocks);
+    assert(stats.free_bytes == stats.total_bytes);
+    assert(stats.largest_free_block >= sizeof(pool2) - 4 * TLSF_BLOCK_OVERHEAD);
+    assert(stats.fragmentation > 0);
+
+    /* Alignment, minimum size, and the usable size */
+    void *p1 = tlsf_malloc(&tlsf, 1);
+    void *p2 = tlsf_malloc(&tlsf, 100);
+    void *p3 = tlsf_malloc(&tlsf, 0);
+    assert(p1 && p2 && p3);
+    assert(0 == ((uintptr_t)p1 % TLSF_ALIGN) && 0 == ((uintptr_t)p2 % TLSF_ALIGN));
+    assert(tlsf_block_size(p1) >= TLSF_BLOCK_MIN_SIZE);
+    assert(tlsf_block_size(p2) >= 100 && tlsf_block_size(p2) < 100 + TLSF_ALIGN);
+    assert(NULL == tlsf_malloc(&tlsf, sizeof(pool2)));
+    assert(tlsf_check(&tlsf));
+
+    /* Freeing the middle block, and then its neighbors merges them back to a single block */
+    tlsf_free(&tlsf, p2);
+    tlsf_free(&tlsf, p1);
+    tlsf_free(&tlsf, p3);
+    tlsf_free(&tlsf, NULL);
+    tlsf_get_stats(&tlsf, &stats);
+    assert(2 == stats.free_blocks && stats.free_bytes == stats.total_bytes);
+    assert(2 == stats.failed_allocs);
+
+    /* Realloc grows in place if the next block is free, and keeps the data */
+    p1 = tlsf_malloc(&tlsf, 64);
+    test_tlsf_fill(p1, 64, 0xA5);
+    p2 = tlsf_realloc(&tlsf, p1, 512);
+    assert(p2 == p1 && test_tlsf_verify(p2, 64, 0xA5));
+    p3 = tlsf_malloc(&tlsf, 16);
+    p2 = tlsf_realloc(&tlsf, p1, 1024);
+    assert(p2 && p2 != p1 && test_tlsf_verify(p2, 64, 0xA5));
+    p2 = tlsf_realloc(&tlsf, p2, 32);
+    assert(p2 && test_tlsf_verify(p2, 32, 0xA5));
+    assert(tlsf_check(&tlsf));
+    tlsf_free(&tlsf, p2);
+    tlsf_free(&tlsf, p3);
+    assert(NULL != (p1 = tlsf_realloc(&tlsf, NULL, 10)));
+    tlsf_free(&tlsf, p1);
+
+    /* Random allocations and frees, checking that no two blocks overlap */
+    srand(1);
+    for (i = 0; i < 20000; i++) {
+        const uint32_t idx = rand() % num_ptrs;
+        if (ptrs[idx]) {
+            assert(test_tlsf_verify(ptrs[idx], sizes[idx], idx));
+            if (rand() % 4) {
+                tlsf_free(&tlsf, ptrs[idx]);
+                ptrs[idx] = NULL;
+            }
+            else {
+                const size_t size = 1 + rand() % 300;
+                void *p = tlsf_realloc(&tlsf, ptrs[idx], size);
+                if (p) {
+                    assert(test_tlsf_verify(p, sizes[idx] < size ? sizes[idx] : size, idx));
+                    ptrs[idx] = p;
+                    sizes[idx] = size;
+                    test_tlsf_fill(p, size, idx);
+                }
+            }
+        }
+        else {
+            sizes[idx] = (rand() % 8) ? (1 + rand() % 64) : (1 + rand() % 1500);
+            ptrs[idx] = tlsf_malloc(&tlsf, sizes[idx]);
+            if (ptrs[idx]) {
+                assert(tlsf_block_size(ptrs[idx]) >= sizes[idx]);
+                test_tlsf_fill(ptrs[idx], sizes[idx], idx);
+            }
+        }
+        if (0 == i % 256) {
+            assert(tlsf_check(&tlsf));
+        }
+    }
+    assert(tlsf_check(&tlsf));
+    tlsf_get_stats(&tlsf, &stats);
+    assert(stats.min_free_bytes < stats.free_bytes);
+    size_t used = 0;
+    for (i = 0; i < num_ptrs; i++) {
+        used += ptrs[i] ? (tlsf_block_size(ptrs[i]) + TLSF_BLOCK_OVERHEAD) : 0;
+    }
+    assert(used + (stats.free_blocks - 2) * TLSF_BLOCK_OVERHEAD == stats.used_bytes);
+    assert(stats.used_bytes + stats.free_bytes == stats.total_bytes);
+
+    for (i = 0; i < num_ptrs; i++) {
+        tlsf_free(&tlsf, ptrs[i]);
+        ptrs[i] = NULL;
+    }
+    tlsf_get_stats(&tlsf, &stats);
+    assert(2 == stats.free_blocks && 0 == stats.used_blocks);
+    assert(stats.free_bytes == stats.total_bytes);
+
+    puts("\nTLSF Tests Successful!");
+}
+#endif /* #ifdef TESTING */
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* TLSF_H__ */
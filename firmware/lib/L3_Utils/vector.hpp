@@ -21,6 +21,7 @@
 * @brief  Vector Class with a small footprint
 * @ingroup Utilities
 *
+* Version: 20261015    Contiguous storage with inline buffer, move support, and geometric growth
 * Version: 05172013    Added at() to ease element access when vector is a pointer.
 * Version: 06192012    Initial
 */
@@ -28,6 +29,24 @@
 #define _VECTOR_H__
 
 #include <stdlib.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+
+
+/// Inline storage of the VECTOR, specialized below such that zero elements use no memory
+template <typename TYPE, unsigned int COUNT>
+struct VectorInlineStorage
+{
+    TYPE* get(void) { return reinterpret_cast<TYPE*>(&mData[0]); }
+    typename std::aligned_storage<sizeof(TYPE), std::alignment_of<TYPE>::value>::type mData[COUNT];
+};
+template <typename TYPE>
+struct VectorInlineStorage<TYPE, 0>
+{
+    TYPE* get(void) { return 0; }
+};
 
 
 
@@ -38,8 +57,14 @@
  * This vector class can by used as a dynamic array.
  * This can provide fast-index based retrieval of stored elements
  * and also provides fast methods to erase or rotate the elements.
- * The underlining storage uses pointer-based storage and entire
- * objects are not created or deleted when the vector contents change.
+ *
+ * The elements are stored contiguously and are only constructed when added
+ * to the vector.  The first INLINE_COUNT elements are stored inside the object
+ * itself, so a vector that never grows beyond INLINE_COUNT never uses malloc.
+ * When the vector needs to grow, the capacity grows by 50% (or by the growth
+ * factor if that is larger) such that push_back() is amortized O(1).
+ * pop_front() is O(1) because the front of the vector can move forward within
+ * the storage, and push_front() reuses that space if available.
  *
  * Usage:
  * @code
@@ -51,30 +76,39 @@
  *  intVec.remove(2);    // Vector now: 1 3
  *  intVec.rotateLeft(); // 1 3 --> 3 1
  *  printf("%i %i", intVec[0], intVec[1]); // Prints: 3 1
+ *
+ *  VECTOR<int, 4> smallVec; // Up to 4 elements without using the heap
  * @endcode
  */
-template <typename TYPE>
+template <typename TYPE, unsigned int INLINE_COUNT = 0>
 class VECTOR
 {
 public:
     VECTOR();                               ///< Default Constructor
     VECTOR(int initialCapacity);            ///< Constructor with initial capacity as Vector size
     VECTOR(const VECTOR& copy);             ///< Copy Constructor
+    VECTOR(VECTOR&& other);                 ///< Move Constructor
     VECTOR& operator=(const VECTOR& copy);  ///<  =Operator to copy the vector.
+    VECTOR& operator=(VECTOR&& other);      ///<  =Operator to move the vector.
     ~VECTOR();                              ///< Destructor of the vector
 
     const TYPE& front();                    ///< @returns the first(oldest) element of the vector (index 0).
     const TYPE& back();                     ///< @returns the last added element of the vector.
-    const TYPE& pop_front();                ///< Pops & returns the first(oldest) element of the vector (index 0).  (SLOW)
-    const TYPE& pop_back();                 ///< Pops & returns the last element from the vector. (FAST)
+    TYPE pop_front();                       ///< Pops & returns the first(oldest) element of the vector (index 0).  (FAST)
+    TYPE pop_back();                        ///< Pops & returns the last element from the vector. (FAST)
     void push_back(const TYPE& element);    ///< Pushes the element to the end of the vector. (FAST)
-    void push_front(const TYPE& element);   ///< Pushes the element at the 1st location (index 0).  (SLOW)
+    void push_back(TYPE&& element);         ///< Moves the element to the end of the vector. (FAST)
+    void push_front(const TYPE& element);   ///< Pushes the element at the 1st location (index 0).  (FAST after pop_front(), otherwise SLOW)
+
+    /// Constructs the element in place at the end of the vector. (FAST)
+    template <typename... ARGS>
+    TYPE& emplace_back(ARGS&&... args);
 
     void reverse();             ///< Reverses the order of the vector contents.
     const TYPE& rotateRight();  ///< Rotates the vector right by 1 and @returns front() value
     const TYPE& rotateLeft();   ///< Rotates the vector left by 1 and @returns  front() value
 
-    const TYPE& eraseAt(unsigned int pos);  ///< Erases the element at pos and returns it. All elements are shifted left from this pos.
+    TYPE eraseAt(unsigned int pos);         ///< Erases the element at pos and returns it. All elements are shifted left from this pos.
     int  getFirstIndexOf(const TYPE& find); ///< @returns the first index at which the element find is located at
     bool remove(const TYPE& element);       ///< Removes the first Vector Element match from this vector, @returns true if successful
     int  removeAll(const TYPE& element);    ///< Removes all Vector Elements that match the given element, @returns number of elements removed
@@ -88,9 +122,10 @@ public:
     unsigned int size() const;          ///< @returns The size of the vector (actual usage)
     unsigned int capacity() const;      ///< @returns The capacity of the vector (allocated memory)
     void reserve(unsigned int size);    ///< Reserves the memory for the vector up front.
-    void setGrowthFactor(int factor);   ///< Changes the size the vector grows by.
+    void setGrowthFactor(int factor);   ///< Changes the minimum number of elements the vector grows by.
     void clear();                       ///< Clears the entire vector
     bool isEmpty();                     ///< @returns True if the vector is empty
+    bool isInline() const;              ///< @returns True if the elements are stored inside the object (no heap memory)
 
     TYPE& at(const unsigned int i);                         ///< Access element at given index
     TYPE& operator[](const unsigned int i );                ///< [] Operator for Left-hand-side.
@@ -98,23 +133,31 @@ public:
     void operator+=(const TYPE& item) { push_back(item); }  ///< += Operator which is same as push_back() of an item
 
 private:
-    void changeCapacity(unsigned int newSize);      ///< Changes the capacity of this vector to the new size and handles internal memory move
-    TYPE* shiftLeftFromPosition(unsigned int pos);  ///< @returns Pointer at the pos, and all pointers get shifted left from this pos
-    TYPE* shiftRightFromPosition(unsigned int pos); ///< @returns Pointer at the last position, and all pointers get shifted right from ths pos
+    void changeCapacity(unsigned int newSize);      ///< Changes the capacity of this vector to the new size and moves the elements
+    void makeRoomAtBack();                          ///< Ensures there is space for one more element at the end
+    void compact();                                 ///< Moves the elements to the start of the storage
+    void destroyAll();                              ///< Destroys all elements and frees the heap memory (if any)
+    void moveFrom(VECTOR& other);                   ///< Takes the contents of the other vector, leaving it empty
+
+    /// @returns pointer to the element at index i, relative to the front of the vector
+    inline TYPE* ptr(unsigned int i) const { return mpData + mHead + i; }
 
-    unsigned int mGrowthRate;       ///< Number of elements added when vector needs to grow
+    unsigned int mGrowthRate;       ///< Minimum number of elements added when vector needs to grow
     unsigned int mVectorCapacity;   ///< Capacity of this vector
     unsigned int mVectorSize;       ///< Used size of this vector
-    TYPE **mpObjPtrs;               ///< Pointer array of TYPE
+    unsigned int mHead;             ///< Index of the front element within mpData
+    TYPE *mpData;                   ///< Storage of the elements; points to mInline or to the heap
     TYPE mNullItem;                 ///< Null Item is returned when invalid vector element is accessed
+    VectorInlineStorage<TYPE, INLINE_COUNT> mInline; ///< Storage used until INLINE_COUNT is exceeded
 
     /// Initializes all member variables of this vector
     void init()
     {
         mGrowthRate = 4;
-        mVectorCapacity = 0;
+        mVectorCapacity = INLINE_COUNT;
         mVectorSize = 0;
-        mpObjPtrs   = 0;
+        mHead = 0;
+        mpData = mInline.get();
     }
 };
 
@@ -133,157 +176,239 @@ private:
 
 
 
-template <typename TYPE>
-VECTOR<TYPE>::VECTOR()
+template <typename TYPE, unsigned int INLINE_COUNT>
+VECTOR<TYPE, INLINE_COUNT>::VECTOR() : mNullItem()
 {
     init();
 }
-template <typename TYPE>
-VECTOR<TYPE>::VECTOR(int initialCapacity)
+template <typename TYPE, unsigned int INLINE_COUNT>
+VECTOR<TYPE, INLINE_COUNT>::VECTOR(int initialCapacity) : mNullItem()
 {
     init();
     changeCapacity(initialCapacity);
 }
 
-template <typename TYPE>
-VECTOR<TYPE>::VECTOR(const VECTOR& copy)
+template <typename TYPE, unsigned int INLINE_COUNT>
+VECTOR<TYPE, INLINE_COUNT>::VECTOR(const VECTOR& copy) : mNullItem()
 {
     init();
     *this = copy; // Call = Operator below to copy vector contents
 }
 
-template <typename TYPE>
-VECTOR<TYPE>& VECTOR<TYPE>::operator=(const VECTOR<TYPE>& copy)
+template <typename TYPE, unsigned int INLINE_COUNT>
+VECTOR<TYPE, INLINE_COUNT>::VECTOR(VECTOR&& other) : mNullItem()
+{
+    init();
+    moveFrom(other);
+}
+
+template <typename TYPE, unsigned int INLINE_COUNT>
+VECTOR<TYPE, INLINE_COUNT>& VECTOR<TYPE, INLINE_COUNT>::operator=(const VECTOR& copy)
 {
     if(this != &copy)
     {
         // Clear this vector and reserve enough for the vector to copy
         this->clear();
-        this->reserve(copy.capacity());
+        this->reserve(copy.size());
 
         // Now copy other vectors contents into this vector
         for(unsigned int i = 0; i < copy.size(); i++)
         {
-            *(this->mpObjPtrs[i]) = copy[i];
+            new (ptr(i)) TYPE(copy[i]);
         }
+        mVectorSize = copy.size();
+        mGrowthRate = copy.mGrowthRate;
     }
     return *this;
 }
 
-template <typename TYPE>
-VECTOR<TYPE>::~VECTOR()
+template <typename TYPE, unsigned int INLINE_COUNT>
+VECTOR<TYPE, INLINE_COUNT>& VECTOR<TYPE, INLINE_COUNT>::operator=(VECTOR&& other)
 {
-    for(unsigned int i=0; i < mVectorCapacity; i++) {
-        delete mpObjPtrs[i];
+    if(this != &other)
+    {
+        destroyAll();
+        init();
+        moveFrom(other);
     }
-    delete [] mpObjPtrs;
+    return *this;
+}
+
+template <typename TYPE, unsigned int INLINE_COUNT>
+VECTOR<TYPE, INLINE_COUNT>::~VECTOR()
+{
+    destroyAll();
 }
 
 
-template <typename TYPE>
-const TYPE& VECTOR<TYPE>::pop_back()
+template <typename TYPE, unsigned int INLINE_COUNT>
+TYPE VECTOR<TYPE, INLINE_COUNT>::pop_back()
 {
-    return (mVectorSize > 0) ? *mpObjPtrs[--mVectorSize] : mNullItem;
+    if (0 == mVectorSize) {
+        return mNullItem;
+    }
+
+    TYPE *item = ptr(--mVectorSize);
+    TYPE ret(std::move(*item));
+    item->~TYPE();
+    return ret;
 }
 
 
-template <typename TYPE>
-const TYPE& VECTOR<TYPE>::pop_front()
+template <typename TYPE, unsigned int INLINE_COUNT>
+TYPE VECTOR<TYPE, INLINE_COUNT>::pop_front()
 {
-    return eraseAt(0);
+    if (0 == mVectorSize) {
+        return mNullItem;
+    }
+
+    TYPE *item = ptr(0);
+    TYPE ret(std::move(*item));
+    item->~TYPE();
+
+    // Rather than shifting the elements, just move the front of the vector
+    if (0 == --mVectorSize) {
+        mHead = 0;
+    }
+    else {
+        mHead++;
+    }
+    return ret;
 }
 
-template <typename TYPE>
-void VECTOR<TYPE>::push_back(const TYPE& element)
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::push_back(const TYPE& element)
 {
-    if(mVectorSize >= mVectorCapacity)
-    {
-        changeCapacity( (mVectorCapacity + mGrowthRate) );
+    // Copy the element first if the storage moves, in case it refers to an element of this vector
+    if ((mHead + mVectorSize) >= mVectorCapacity) {
+        push_back(TYPE(element));
+        return;
     }
-    *mpObjPtrs[mVectorSize++] = element;
+    new (ptr(mVectorSize)) TYPE(element);
+    mVectorSize++;
 }
 
-template <typename TYPE>
-void VECTOR<TYPE>::push_front(const TYPE& element)
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::push_back(TYPE&& element)
+{
+    makeRoomAtBack();
+    new (ptr(mVectorSize)) TYPE(std::move(element));
+    mVectorSize++;
+}
+
+template <typename TYPE, unsigned int INLINE_COUNT>
+template <typename... ARGS>
+TYPE& VECTOR<TYPE, INLINE_COUNT>::emplace_back(ARGS&&... args)
+{
+    makeRoomAtBack();
+    TYPE *item = new (ptr(mVectorSize)) TYPE(std::forward<ARGS>(args)...);
+    mVectorSize++;
+    return *item;
+}
+
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::push_front(const TYPE& element)
 {
-    if(mVectorSize >= mVectorCapacity)
+    // Use the space left behind by pop_front() if available
+    if (mHead > 0)
     {
-        changeCapacity( (mVectorCapacity + mGrowthRate) );
+        mHead--;
+        new (ptr(0)) TYPE(element);
+        mVectorSize++;
+        return;
     }
 
-    // Make room to put new item at mpData[0] by moving free right-most pointer back to 0
-    if( mVectorSize++ >= 1)
+    // Copy the element first in case it refers to an element of this vector
+    TYPE copy(element);
+    makeRoomAtBack();
+
+    // Make room at index 0 by moving all elements right by one
+    if (mVectorSize > 0)
     {
-        mpObjPtrs[0] = shiftRightFromPosition(0);
+        new (ptr(mVectorSize)) TYPE(std::move(*ptr(mVectorSize - 1)));
+        for(unsigned int i = mVectorSize - 1; i > 0; i--) {
+            *ptr(i) = std::move(*ptr(i - 1));
+        }
+        *ptr(0) = std::move(copy);
     }
-
-    // 1st element was moved to 2nd by shifting right, place new item at 1st location.
-    *mpObjPtrs[0] = element;
+    else
+    {
+        new (ptr(0)) TYPE(std::move(copy));
+    }
+    mVectorSize++;
 }
 
-template <typename TYPE>
-const TYPE& VECTOR<TYPE>::front()
+template <typename TYPE, unsigned int INLINE_COUNT>
+const TYPE& VECTOR<TYPE, INLINE_COUNT>::front()
 {
     return (*this)[0];
 }
 
-template <typename TYPE>
-const TYPE& VECTOR<TYPE>::back()
+template <typename TYPE, unsigned int INLINE_COUNT>
+const TYPE& VECTOR<TYPE, INLINE_COUNT>::back()
 {
     return (*this)[mVectorSize-1];
 }
 
-template <typename TYPE>
-unsigned int VECTOR<TYPE>::size() const
+template <typename TYPE, unsigned int INLINE_COUNT>
+unsigned int VECTOR<TYPE, INLINE_COUNT>::size() const
 {
     return mVectorSize;
 }
 
-template <typename TYPE>
-unsigned int VECTOR<TYPE>::capacity() const
+template <typename TYPE, unsigned int INLINE_COUNT>
+unsigned int VECTOR<TYPE, INLINE_COUNT>::capacity() const
 {
     return mVectorCapacity;
 }
 
-template <typename TYPE>
-void VECTOR<TYPE>::reserve(unsigned int theSize)
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::reserve(unsigned int theSize)
 {
     changeCapacity(theSize);
 }
 
-template <typename TYPE>
-void VECTOR<TYPE>::setGrowthFactor(int factor)
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::setGrowthFactor(int factor)
 {
     if(factor > 1)
         mGrowthRate = factor;
 }
 
-template <typename TYPE>
-int VECTOR<TYPE>::getFirstIndexOf(const TYPE& find)
+template <typename TYPE, unsigned int INLINE_COUNT>
+int VECTOR<TYPE, INLINE_COUNT>::getFirstIndexOf(const TYPE& find)
 {
     for(unsigned int i = 0; i < mVectorSize; i++) {
-        if(*mpObjPtrs[i] == find) {
+        if(*ptr(i) == find) {
             return i;
         }
     }
     return -1;
 }
 
-template <typename TYPE>
-const TYPE& VECTOR<TYPE>::eraseAt(unsigned int elementNumber)
+template <typename TYPE, unsigned int INLINE_COUNT>
+TYPE VECTOR<TYPE, INLINE_COUNT>::eraseAt(unsigned int elementNumber)
 {
-    TYPE* item = 0;
-    if(elementNumber < mVectorSize && elementNumber >= 0)
-    {
-        // Must save the pointer even though we are erasing
-        item = (mpObjPtrs[mVectorSize-1] = shiftLeftFromPosition(elementNumber));
-        mVectorSize--;
+    if (elementNumber >= mVectorSize) {
+        return mNullItem;
+    }
+    else if (0 == elementNumber) {
+        return pop_front();
     }
-    return 0 == item ? mNullItem : *item;
+
+    TYPE ret(std::move(*ptr(elementNumber)));
+
+    // Shift elements left by one and destroy the last one that is now unused
+    for(unsigned int i = elementNumber; i < (mVectorSize-1); i++) {
+        *ptr(i) = std::move(*ptr(i+1));
+    }
+    ptr(--mVectorSize)->~TYPE();
+
+    return ret;
 }
 
-template <typename TYPE>
-bool VECTOR<TYPE>::remove(const TYPE&  element)
+template <typename TYPE, unsigned int INLINE_COUNT>
+bool VECTOR<TYPE, INLINE_COUNT>::remove(const TYPE&  element)
 {
     const int index = getFirstIndexOf(element);
     const bool found = (index >= 0);
@@ -293,191 +418,449 @@ bool VECTOR<TYPE>::remove(const TYPE&  element)
     return found;
 }
 
-template <typename TYPE>
-int VECTOR<TYPE>::removeAll(const TYPE&  element)
+template <typename TYPE, unsigned int INLINE_COUNT>
+int VECTOR<TYPE, INLINE_COUNT>::removeAll(const TYPE&  element)
 {
-    // Optimize vector::removeAll() ???
-    int itemsRemoved = 0;
-    while(remove(element)) { itemsRemoved++; }
+    // Single pass: keep the elements that do not match, then destroy the tail
+    unsigned int keep = 0;
+    for(unsigned int i = 0; i < mVectorSize; i++) {
+        if(!(*ptr(i) == element)) {
+            if (keep != i) {
+                *ptr(keep) = std::move(*ptr(i));
+            }
+            keep++;
+        }
+    }
+
+    const int itemsRemoved = mVectorSize - keep;
+    for(unsigned int i = keep; i < mVectorSize; i++) {
+        ptr(i)->~TYPE();
+    }
+    mVectorSize = keep;
     return itemsRemoved;
 }
 
-template <typename TYPE>
-bool VECTOR<TYPE>::replace(const TYPE&  find, const TYPE& replaceWith)
+template <typename TYPE, unsigned int INLINE_COUNT>
+bool VECTOR<TYPE, INLINE_COUNT>::replace(const TYPE&  find, const TYPE& replaceWith)
 {
     const int index = getFirstIndexOf(find);
     const bool found = (index >= 0);
 
     if(found) {
-        *mpObjPtrs[index] = replaceWith;
+        *ptr(index) = replaceWith;
     }
 
     return found;
 }
 
-template <typename TYPE>
-int VECTOR<TYPE>::replaceAll(const TYPE& find, const TYPE& replaceWith)
+template <typename TYPE, unsigned int INLINE_COUNT>
+int VECTOR<TYPE, INLINE_COUNT>::replaceAll(const TYPE& find, const TYPE& replaceWith)
 {
     int itemsReplaced = 0;
     for(unsigned int i = 0; i < mVectorSize; i++) {
-        if(*mpObjPtrs[i] == find) {
-            *mpObjPtrs[i] = replaceWith;
+        if(*ptr(i) == find) {
+            *ptr(i) = replaceWith;
             itemsReplaced++;
         }
     }
     return itemsReplaced;
 }
 
-template <typename TYPE>
-void VECTOR<TYPE>::fill(const TYPE& fillElement)
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::fill(const TYPE& fillElement)
 {
-    for(unsigned int i = 0; i < mVectorCapacity; i++) {
-        *mpObjPtrs[i] = fillElement;
+    for(unsigned int i = 0; i < mVectorSize; i++) {
+        *ptr(i) = fillElement;
     }
-    mVectorSize = mVectorCapacity;
+    fillUnused(fillElement);
 }
 
-template <typename TYPE>
-void VECTOR<TYPE>::fillUnused(const TYPE& fillElement)
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::fillUnused(const TYPE& fillElement)
 {
+    compact();
     for(unsigned int i = mVectorSize; i < mVectorCapacity; i++) {
-        *mpObjPtrs[i] = fillElement;
+        new (ptr(i)) TYPE(fillElement);
     }
     mVectorSize = mVectorCapacity;
 }
 
-template <typename TYPE>
-void VECTOR<TYPE>::clear()
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::clear()
 {
+    for(unsigned int i = 0; i < mVectorSize; i++) {
+        ptr(i)->~TYPE();
+    }
     mVectorSize = 0;
+    mHead = 0;
 }
 
-template <typename TYPE>
-bool VECTOR<TYPE>::isEmpty()
+template <typename TYPE, unsigned int INLINE_COUNT>
+bool VECTOR<TYPE, INLINE_COUNT>::isEmpty()
 {
     return (0 == mVectorSize);
 }
 
-template <typename TYPE>
-void VECTOR<TYPE>::reverse()
+template <typename TYPE, unsigned int INLINE_COUNT>
+bool VECTOR<TYPE, INLINE_COUNT>::isInline() const
+{
+    return (mpData == const_cast<VectorInlineStorage<TYPE, INLINE_COUNT>&>(mInline).get());
+}
+
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::reverse()
 {
     for(unsigned int i = 0; i < (mVectorSize/2); i++)
     {
-        TYPE* temp = mpObjPtrs[i];
-        mpObjPtrs[i] = mpObjPtrs[ (mVectorSize-1-i) ];
-        mpObjPtrs[ (mVectorSize-1-i) ] = temp;
+        std::swap(*ptr(i), *ptr(mVectorSize-1-i));
     }
 }
 
-template <typename TYPE>
-const TYPE& VECTOR<TYPE>::rotateLeft()
+template <typename TYPE, unsigned int INLINE_COUNT>
+const TYPE& VECTOR<TYPE, INLINE_COUNT>::rotateLeft()
 {
     if(mVectorSize >= 2)
     {
-        // Shift right and set shifted element to index 0
-        mpObjPtrs[0] = shiftRightFromPosition(0);
+        // Move the last element to index 0
+        TYPE last(std::move(*ptr(mVectorSize-1)));
+        for(unsigned int i = mVectorSize-1; i > 0; i--) {
+            *ptr(i) = std::move(*ptr(i-1));
+        }
+        *ptr(0) = std::move(last);
     }
     return (*this)[0];
 }
 
-template <typename TYPE>
-const TYPE& VECTOR<TYPE>::rotateRight()
+template <typename TYPE, unsigned int INLINE_COUNT>
+const TYPE& VECTOR<TYPE, INLINE_COUNT>::rotateRight()
 {
     if(mVectorSize >= 2)
     {
-        // Shift left, and set the last element to shifted element.
-        mpObjPtrs[ (mVectorSize-1) ] = shiftLeftFromPosition(0);
+        // Move the first element to the last index
+        TYPE first(std::move(*ptr(0)));
+        for(unsigned int i = 0; i < (mVectorSize-1); i++) {
+            *ptr(i) = std::move(*ptr(i+1));
+        }
+        *ptr(mVectorSize-1) = std::move(first);
     }
     return (*this)[0];
 }
 
-template <typename TYPE>
-TYPE& VECTOR<TYPE>::at(const unsigned int i )
+template <typename TYPE, unsigned int INLINE_COUNT>
+TYPE& VECTOR<TYPE, INLINE_COUNT>::at(const unsigned int i )
 {
     return (*this)[i];
 }
 
-template <typename TYPE>
-TYPE& VECTOR<TYPE>::operator[](const unsigned int i )
+template <typename TYPE, unsigned int INLINE_COUNT>
+TYPE& VECTOR<TYPE, INLINE_COUNT>::operator[](const unsigned int i )
 {
-    return ( i >= 0 && i < mVectorSize) ? *mpObjPtrs[i] : mNullItem;
+    return (i < mVectorSize) ? *ptr(i) : mNullItem;
 }
 
-template <typename TYPE>
-const TYPE& VECTOR<TYPE>::operator[](const unsigned int i ) const
+template <typename TYPE, unsigned int INLINE_COUNT>
+const TYPE& VECTOR<TYPE, INLINE_COUNT>::operator[](const unsigned int i ) const
 {
-    return ( i >= 0 && i < mVectorSize) ? *mpObjPtrs[i] : mNullItem;
+    return (i < mVectorSize) ? *ptr(i) : mNullItem;
 }
 
 
 
 // ******* PRIVATE FUNCTIONS:
-template <typename TYPE>
-void VECTOR<TYPE>::changeCapacity(unsigned int newSize)
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::changeCapacity(unsigned int newSize)
 {
-    if(newSize < mVectorCapacity)
+    if(newSize <= mVectorCapacity)
         return;
 
-    // This is slow code so it is #ifdef'd out
-#if 0
-    // Allocate new memory and call TYPE's default constructor
-    TYPE **newData = new TYPE*[ (newSize) ];
-    for(unsigned int i = 0; i < newSize; i++) {
-        newData[i] = new TYPE();
+    // Move the elements to the new memory, and destroy them at the old memory
+    TYPE *newData = (TYPE*) malloc(sizeof(TYPE) * newSize);
+    for(unsigned int i = 0; i < mVectorSize; i++)
+    {
+        new (&newData[i]) TYPE(std::move(*ptr(i)));
+        ptr(i)->~TYPE();
     }
 
-    // Copy old memory to new one & delete old memory
-    if(mpObjPtrs)
-    {
-        for(unsigned int i = 0; i < mVectorSize; i++)
-        {
-            newData[i] = mpObjPtrs[i];
-        }
-        delete [] mpObjPtrs;
+    if (!isInline()) {
+        free(mpData);
     }
 
-    // Point data to new memory
-    mpObjPtrs = newData;
-#else
-    // Allocate pointers of the datatype
-    mpObjPtrs = (TYPE**)realloc(mpObjPtrs, sizeof(TYPE*)*newSize);
+    mpData = newData;
+    mHead = 0;
+    mVectorCapacity = newSize;
+}
 
-    // Allocate new objects ONLY at each of the new pointers
-    for(unsigned int i = mVectorSize; i < newSize; i++) {
-        mpObjPtrs[i] = new TYPE();
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::makeRoomAtBack()
+{
+    if ((mHead + mVectorSize) < mVectorCapacity) {
+        return;
     }
-#endif
 
-    mVectorCapacity = newSize;
+    /**
+     * If at least half of the elements worth of space is unused at the front,
+     * re-use that space, otherwise grow the vector by at least 50%.  Either case
+     * gives amortized O(1) cost to add an element.
+     */
+    if (mHead > 0 && mHead >= (mVectorSize / 2)) {
+        compact();
+    }
+    else {
+        const unsigned int geometric = mVectorCapacity + (mVectorCapacity / 2);
+        const unsigned int linear = mVectorCapacity + mGrowthRate;
+        changeCapacity(geometric > linear ? geometric : linear);
+    }
 }
 
-template <typename TYPE>
-TYPE* VECTOR<TYPE>::shiftLeftFromPosition(unsigned int pos)
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::compact()
 {
-    TYPE* leftMostItem = mpObjPtrs[pos];
-    if(mVectorSize > 1 && (mVectorSize-pos) > 1)
+    if (0 == mHead) {
+        return;
+    }
+
+    for(unsigned int i = 0; i < mVectorSize; i++)
     {
-        // Shift elements left by one.
-        for( unsigned int i = pos; i < (mVectorSize-1); i++)
-        {
-            mpObjPtrs[i] = mpObjPtrs[i+1];
+        TYPE *from = ptr(i);
+        new (&mpData[i]) TYPE(std::move(*from));
+        from->~TYPE();
+    }
+    mHead = 0;
+}
+
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::destroyAll()
+{
+    clear();
+    if (!isInline()) {
+        free(mpData);
+    }
+}
+
+template <typename TYPE, unsigned int INLINE_COUNT>
+void VECTOR<TYPE, INLINE_COUNT>::moveFrom(VECTOR& other)
+{
+    mGrowthRate = other.mGrowthRate;
+
+    if (!other.isInline())
+    {
+        // Steal the heap memory of the other vector
+        mpData = other.mpData;
+        mHead = other.mHead;
+        mVectorSize = other.mVectorSize;
+        mVectorCapacity = other.mVectorCapacity;
+        other.init();
+    }
+    else
+    {
+        // Inline elements cannot be stolen, so move them one by one
+        reserve(other.size());
+        for(unsigned int i = 0; i < other.size(); i++) {
+            new (ptr(i)) TYPE(std::move(other[i]));
         }
+        mVectorSize = other.size();
+        other.clear();
     }
-    return leftMostItem;
 }
 
+
+
+#ifdef TESTING
+#include <assert.h>
+static inline void test_vector(void)
+{
+    VECTOR<int> v;
+    assert(0 == v.size());
+    assert(v.isEmpty());
+
+    v += 1;
+    v += 2;
+    v += 3;
+    assert(3 == v.size());
+    assert(v.remove(2));
+    assert(1 == v[0] && 3 == v[1]);
+    assert(3 == v.rotateLeft());
+    assert(1 == v.rotateRight());
+
+    // Capacity grows geometrically
+    for (int i = 0; i < 100; i++) {
+        v.push_back(i);
+    }
+    assert(102 == v.size());
+    assert(v.capacity() >= 102 && v.capacity() < 102 * 2);
+
+    // pop_front() followed by push_front() should re-use the space
+    const unsigned int cap = v.capacity();
+    assert(1 == v.pop_front());
+    assert(3 == v.pop_front());
+    v.push_front(3);
+    v.push_front(1);
+    assert(cap == v.capacity());
+    assert(1 == v[0] && 3 == v[1] && 0 == v[2] && 99 == v.back());
+    assert(99 == v.pop_back());
+    assert(2 == v.eraseAt(4));
+
+    v.clear();
+    v += 1; v += 5; v += 1; v += 1; v += 7;
+    assert(3 == v.removeAll(1));
+    assert(2 == v.size() && 5 == v[0] && 7 == v[1]);
+    assert(1 == v.replaceAll(7, 8));
+    assert(8 == v[1]);
+
+    // Queue like usage should not grow the capacity
+    v.clear();
+    v.reserve(8);
+    const unsigned int qcap = v.capacity();
+    for (int i = 0; i < 1000; i++) {
+        v.push_back(i);
+        if (v.size() > 4) {
+            assert(i - 4 == v.pop_front());
+        }
+    }
+    assert(qcap == v.capacity());
+
+    // Inline storage
+    VECTOR<int, 3> s;
+    s += 1; s += 2; s += 3;
+    assert(s.isInline() && 3 == s.capacity());
+    s += 4;
+    assert(!s.isInline() && 4 == s[3]);
+
+    // Copy and move
+    VECTOR<int, 3> c(s);
+    assert(4 == c.size() && 1 == c[0] && 4 == c[3]);
+    VECTOR<int, 3> m(std::move(c));
+    assert(4 == m.size() && 0 == c.size());
+    VECTOR<int, 3> small;
+    small += 9;
+    m = std::move(small);
+    assert(1 == m.size() && 9 == m[0] && m.isInline());
+
+    // Emplace back and non-trivial types
+    VECTOR<VECTOR<int>, 2> vv;
+    vv.emplace_back(10);
+    assert(10 == vv[0].capacity());
+    vv[0] += 42;
+    vv.push_back(VECTOR<int>());
+    vv.push_back(vv[0]);
+    assert(3 == vv.size() && 42 == vv[2][0]);
+    VECTOR<int> popped = vv.pop_front();
+    assert(42 == popped[0]);
+
+    puts("\nVector Tests Successful!");
+}
+
+#ifndef __arm__
+#include <stdio.h>
+#include <chrono>
+/**
+ * The previous VECTOR implementation, only kept to compare the benchmark against it.
+ * Elements are heap allocated one by one and the vector stores their pointers, the
+ * pointer array grows by 4 elements, and pop_front() shifts all of the pointers.
+ */
 template <typename TYPE>
-TYPE* VECTOR<TYPE>::shiftRightFromPosition(unsigned int pos)
+class TestLegacyVector
 {
-    // Vector size must be at least 1 before calling this function
-    TYPE* rightMostItem = mpObjPtrs[mVectorSize-1];
+public:
+    TestLegacyVector() : mGrowthRate(4), mVectorCapacity(0), mVectorSize(0), mpObjPtrs(0) { }
+    TestLegacyVector(const TestLegacyVector& copy) : mGrowthRate(4), mVectorCapacity(0), mVectorSize(0), mpObjPtrs(0)
+    {
+        changeCapacity(copy.mVectorCapacity);
+        for (unsigned int i = 0; i < copy.mVectorSize; i++) {
+            *mpObjPtrs[i] = *copy.mpObjPtrs[i];
+        }
+        mVectorSize = copy.mVectorSize;
+    }
+    ~TestLegacyVector()
+    {
+        for (unsigned int i = 0; i < mVectorCapacity; i++) {
+            delete mpObjPtrs[i];
+        }
+        free(mpObjPtrs);
+    }
 
-    // Shift elements right by one.
-    for( unsigned int i = mVectorSize-1; i > pos; i--)
+    void push_back(const TYPE& element)
     {
-        mpObjPtrs[i] = mpObjPtrs[i-1];
+        if (mVectorSize >= mVectorCapacity) {
+            changeCapacity(mVectorCapacity + mGrowthRate);
+        }
+        *mpObjPtrs[mVectorSize++] = element;
     }
-    return rightMostItem;
+    void operator+=(const TYPE& item) { push_back(item); }
+
+    const TYPE& pop_front()
+    {
+        /* Shift the pointers left, and keep the popped element at the end */
+        TYPE *item = mpObjPtrs[0];
+        for (unsigned int i = 0; i + 1 < mVectorSize; i++) {
+            mpObjPtrs[i] = mpObjPtrs[i + 1];
+        }
+        mpObjPtrs[--mVectorSize] = item;
+        return *item;
+    }
+
+    bool isEmpty() const { return 0 == mVectorSize; }
+    const TYPE& operator[](const unsigned int i) const { return *mpObjPtrs[i]; }
+
+private:
+    void changeCapacity(unsigned int newSize)
+    {
+        mpObjPtrs = (TYPE**) realloc(mpObjPtrs, sizeof(TYPE*) * newSize);
+        for (unsigned int i = mVectorCapacity; i < newSize; i++) {
+            mpObjPtrs[i] = new TYPE();
+        }
+        mVectorCapacity = newSize;
+    }
+
+    unsigned int mGrowthRate;
+    unsigned int mVectorCapacity;
+    unsigned int mVectorSize;
+    TYPE **mpObjPtrs;
+};
+
+/// Host only benchmark of push/erase/copy costs of VECTOR_TYPE, SMALL_TYPE is a vector of 3 ints
+template <typename VECTOR_TYPE, typename SMALL_TYPE>
+static inline void test_vector_benchmark_run(const char *pName)
+{
+    typedef std::chrono::steady_clock clock;
+    const int count = 100 * 1000;
+    unsigned int sum = 0;
+
+    clock::time_point start = clock::now();
+    VECTOR_TYPE v;
+    for (int i = 0; i < count; i++) {
+        v.push_back(i);
+    }
+    const double pushSec = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    while (!v.isEmpty()) {
+        sum += v.pop_front();
+    }
+    const double popSec = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (int i = 0; i < count; i++) {
+        SMALL_TYPE small;
+        small += i; small += i; small += i;
+        SMALL_TYPE copy(small);
+        sum += copy[2];
+    }
+    const double copySec = std::chrono::duration<double>(clock::now() - start).count();
+
+    printf("\n%-8s | %12.3f ms | %12.3f ms | %12.3f ms [%u]",
+           pName, pushSec * 1000, popSec * 1000, copySec * 1000, sum);
+}
+
+/// Host only benchmark of push/erase/copy costs against the previous implementation
+static inline void test_vector_benchmark(void)
+{
+    printf("\n         | push_back x100k | pop_front x100k | copy of 3 x100k");
+    test_vector_benchmark_run<TestLegacyVector<int>, TestLegacyVector<int> >("Previous");
+    test_vector_benchmark_run<VECTOR<int>, VECTOR<int, 4> >("VECTOR");
+    puts("");
 }
+#endif /* #ifndef __arm__ */
+#endif /* #ifdef TESTING */
 
 #endif /* #ifndef _VECTOR_H__ */
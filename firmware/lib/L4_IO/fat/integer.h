@@ -24,9 +24,14 @@ typedef unsigned short	WCHAR;
 typedef int				INT;
 typedef unsigned int	UINT;
 
-/* These types MUST be 32 bit */
+/* These types MUST be 32 bit (long is 64 bit on a 64 bit host, see tools/HostPort) */
+#ifdef __LP64__
+typedef int				LONG;
+typedef unsigned int	DWORD;
+#else
 typedef long			LONG;
 typedef unsigned long	DWORD;
+#endif
 
 #endif
 
@@ -69,7 +69,7 @@ class FileSystemObject
 
             *pTotalDriveSpaceKB = 0;
             *pAvailableSpaceKB = 0;
-            unsigned long int fre_clust = 0;
+            DWORD fre_clust = 0;
             FRESULT result;
 
             if (FR_OK == (result = f_getfree(mVolStr, &fre_clust, &pFatFs)))
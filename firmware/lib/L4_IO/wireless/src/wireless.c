@@ -36,6 +36,7 @@
 static QueueHandle_t g_rx_queue = NULL;     ///< Queue handle for RX queue
 static QueueHandle_t g_ack_queue = NULL;    ///< Queue handle for RX Ack packet
 static SemaphoreHandle_t g_nrf_activity_sem = NULL; ///< If FreeRTOS is running, we will not poll for nordic activity
+static volatile uint32_t g_nrf_rx_count = 0;        ///< Number of packets read from nordic
 
 /** @{ Functions used for nordic wireless mesh network
  * These are call-back functions for mesh_service() so you shouldn't use these directly.
@@ -127,7 +128,17 @@ void wireless_service(void)
             const TickType_t blockTime = mesh_get_pnd_pkt_count() ? 1 : portMAX_DELAY;
             xSemaphoreTake(g_nrf_activity_sem, blockTime);
         }
+
+        const uint32_t rx_count = g_nrf_rx_count;
         mesh_service();
+
+        /* If a lower priority task is in mesh_send(), mesh_service() is locked out and
+         * did not read the pending packet, so block for a tick to let that task finish
+         * instead of polling the interrupt signal forever.
+         */
+        if (nordic_intr_signal() && rx_count == g_nrf_rx_count) {
+            vTaskDelay(1);
+        }
     }
     /* A timer ISR is calling us, so we can't use FreeRTOS API, hence we poll */
     else {
@@ -229,6 +240,7 @@ static int nrf_driver_receive(void* p, int len)
 		    nordic_clear_packet_available_flag();
 		}
 		packetWasReceived = 1;
+		++g_nrf_rx_count;
 	}
 
 	return packetWasReceived;
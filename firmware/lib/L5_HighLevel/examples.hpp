@@ -92,7 +92,8 @@ class example_logger_qset : public scheduler_task
 /**
  * This example shows how to save variables on disk.
  * You will notice that the 'someVarWeDontWantToLose' variable will automatically
- * get saved if no command is entered in terminalTask() for 120 seconds.
+ * get saved if no command is entered in terminalTask() for 120 seconds, as long as
+ * it is marked by TLM_MARK_CHANGED() after it is changed.
  * Instead of booting up from zero value, we will actually get the previous value
  * recalled from a file saved onto the flash memory called "disk"
  */
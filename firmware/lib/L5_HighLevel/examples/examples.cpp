@@ -298,8 +298,11 @@ bool example_nv_vars::regTlm(void)
 
 bool example_nv_vars::run(void *p)
 {
-    // Change the variable every 60 seconds :
+    // Change the variable every 60 seconds, and mark it so the terminal task saves it :
     mVarWeDontWantToLose++;
+    #if SYS_CFG_ENABLE_TLM
+        TLM_MARK_CHANGED(tlm_component_get_by_name(SYS_CFG_DISK_TLM_NAME), mVarWeDontWantToLose);
+    #endif
     vTaskDelay(60 * 1000);
 
     return true;
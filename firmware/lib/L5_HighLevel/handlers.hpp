@@ -31,6 +31,12 @@ CMD_HANDLER_FUNC(taskListHandler);
 /// Handler to list memory information
 CMD_HANDLER_FUNC(memInfoHandler);
 
+/// Handler to list the heap memory of each task and call site
+CMD_HANDLER_FUNC(heapProfHandler);
+
+/// Handler to control and save the scheduling trace
+CMD_HANDLER_FUNC(schedTraceHandler);
+
 /// Handler to get system health
 CMD_HANDLER_FUNC(healthHandler);
 
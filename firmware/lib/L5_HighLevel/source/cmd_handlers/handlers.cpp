@@ -19,6 +19,7 @@
 #include <stdio.h>              // printf()
 #include <string.h>
 #include <time.h>
+#include <reent.h>              // _malloc_r()
 
 #include "FreeRTOS.h"
 #include "task.h"               // uxTaskGetSystemState()
@@ -27,6 +28,10 @@
 #include "rtc.h"                // Set and Get System Time
 #include "sys_config.h"         // TERMINAL_END_CHARS
 #include "lpc_sys.h"
+#include "region_heap.h"
+#include "object_pool.hpp"
+#include "heap_profiler.h"
+#include "sched_trace.h"
 
 #include "utilities.h"          // printMemoryInfo()
 #include "storage.hpp"          // Get Storage Device instances
@@ -44,6 +49,7 @@
 
 #include "c_tlm_stream.h"
 #include "c_tlm_var.h"
+#include "c_tlm_journal.h"
 
 
 
@@ -117,8 +123,156 @@ CMD_HANDLER_FUNC(memInfoHandler)
     char buffer[512];
     sys_get_mem_info_str(buffer);
     output.putline(buffer);
+
+#if 6 == configMEM_MANG_TYPE
+    tlsf_stats_t heap;
+    tlsf_heap_get_stats(&heap);
+    output.printf("TLSF free blocks : %u (largest %u)\n", (unsigned)heap.free_blocks, (unsigned)heap.largest_free_block);
+    output.printf("TLSF min. free   : %u\n", (unsigned)heap.min_free_bytes);
+    output.printf("TLSF fragmented  : %u%%\n", (unsigned)heap.fragmentation);
+    output.printf("TLSF failed      : %u\n", (unsigned)heap.failed_allocs);
+
+    region_heap_region_t region;
+    output.printf("%-9s %10s %6s %6s %6s %7s %5s\n", "Region", "Start", "Used", "Free", "Min", "Largest", "Frag");
+    for (uint32_t i = 0; sys_heap_get_region(i, &region, &heap); i++) {
+        output.printf("%-9s 0x%08X %6u %6u %6u %7u %4u%%\n", region.name, (unsigned)region.start,
+                      (unsigned)heap.used_bytes, (unsigned)heap.free_bytes, (unsigned)heap.min_free_bytes,
+                      (unsigned)heap.largest_free_block, (unsigned)heap.fragmentation);
+    }
+#endif
+
+    if (ObjectPoolBase::getFirst()) {
+        ObjectPoolBase::printAll(buffer, sizeof(buffer));
+        output.putline(buffer);
+    }
+    return true;
+}
+
+#if SYS_CFG_HEAP_PROFILER
+CMD_HANDLER_FUNC(heapProfHandler)
+{
+    heap_prof_t *prof = sys_get_heap_prof();
+
+    if (cmdParams == "bench") {
+        /* Time the same allocations with, and without the profiler (newlib's _r functions) */
+        const int count = 500;
+        void *ptrs[16] = { 0 };
+        uint64_t elapsed_us[2] = { 0 };
+
+        for (int p = 0; p < 2; p++) {
+            const uint64_t start = sys_get_uptime_us();
+            for (int i = 0; i < count; i++) {
+                const int idx = i % 16;
+                if (p) {
+                    _free_r(_REENT, ptrs[idx]);
+                    ptrs[idx] = _malloc_r(_REENT, 16 + (i % 64));
+                }
+                else {
+                    free(ptrs[idx]);
+                    ptrs[idx] = malloc(16 + (i % 64));
+                }
+            }
+            elapsed_us[p] = sys_get_uptime_us() - start;
+
+            for (int i = 0; i < 16; i++) {
+                p ? _free_r(_REENT, ptrs[i]) : free(ptrs[i]);
+                ptrs[i] = 0;
+            }
+        }
+
+        output.printf("malloc() + free() with profiler    : %u ns\n", (unsigned)(elapsed_us[0] * 1000 / count));
+        output.printf("malloc() + free() without profiler : %u ns\n", (unsigned)(elapsed_us[1] * 1000 / count));
+        output.printf("Profiler RAM : %u bytes\n", (unsigned)sizeof(*prof));
+        return true;
+    }
+
+    heap_prof_task_t tasks[HEAP_PROF_MAX_TASKS];
+    const uint32_t num_tasks = heap_prof_get_tasks(prof, tasks, HEAP_PROF_MAX_TASKS);
+    output.printf("%-12s %8s %8s %8s\n", "Task", "Live", "Peak", "Allocs");
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        output.printf("%-12s %8u %8u %8u\n", tasks[i].name, (unsigned)tasks[i].live_bytes,
+                      (unsigned)tasks[i].peak_bytes, (unsigned)tasks[i].allocs);
+    }
+
+    int top = 8;
+    if (cmdParams.isUint()) {
+        top = (int)cmdParams;
+    }
+    heap_prof_site_t sites[HEAP_PROF_MAX_SITES + 1];
+    const uint32_t num_sites = heap_prof_get_top_sites(prof, sites, (top < (int)HEAP_PROF_MAX_SITES + 1) ? top : HEAP_PROF_MAX_SITES + 1);
+    output.printf("\n%-12s %8s %8s %8s\n", "Call site", "Live", "Peak", "Allocs");
+    for (uint32_t i = 0; i < num_sites; i++) {
+        output.printf("0x%08X   %8u %8u %8u\n", (unsigned)sites[i].site, (unsigned)sites[i].live_bytes,
+                      (unsigned)sites[i].peak_bytes, (unsigned)sites[i].allocs);
+    }
+
+    output.printf("\nLive: %u bytes in %u allocations, peak %u bytes\n",
+                  (unsigned)prof->live_bytes, (unsigned)prof->live_allocs, (unsigned)prof->peak_bytes);
+    output.printf("Allocations: %u, frees: %u, untracked: %u\n",
+                  (unsigned)prof->total_allocs, (unsigned)prof->total_frees, (unsigned)prof->untracked_allocs);
     return true;
 }
+#endif
+
+#if SYS_CFG_SCHED_TRACE
+/// Writes the scheduling trace to the file given by sched_trace_save()
+static void schedTraceWrite(const void *data, uint32_t len, void *arg)
+{
+    FIL *file = (FIL*) arg;
+    UINT bw = 0;
+    f_write(file, data, len, &bw);
+}
+
+CMD_HANDLER_FUNC(schedTraceHandler)
+{
+    if (cmdParams == "start" || cmdParams == "stop") {
+        sched_trace_enable(cmdParams == "start");
+    }
+    else if (cmdParams == "clear") {
+        sched_trace_clear();
+    }
+    else if (cmdParams.beginsWith("save ")) {
+        cmdParams.eraseFirstWords(1);
+        FIL file;
+        if (FR_OK != f_open(&file, cmdParams(), FA_WRITE | FA_CREATE_ALWAYS)) {
+            output.printf("Unable to open '%s' to write the trace\n", cmdParams());
+            return true;
+        }
+        const uint32_t count = sched_trace_save(schedTraceWrite, &file);
+        const uint32_t size = f_size(&file);
+        f_close(&file);
+        output.printf("Saved %u events (%u bytes) to %s\n", (unsigned)count, (unsigned)size, cmdParams());
+        return true;
+    }
+    else if (cmdParams.beginsWith("list")) {
+        cmdParams.eraseFirstWords(1);
+        const uint32_t count = sched_trace_get_count();
+        const uint32_t n = cmdParams.isUint() ? (uint32_t)(int)cmdParams : 20;
+        sched_trace_rec_t rec;
+
+        /* Pause recording such that the records do not move while printing them */
+        const bool enabled = sched_trace_is_enabled();
+        sched_trace_enable(false);
+        for (uint32_t i = (n < count) ? (count - n) : 0; sched_trace_get(i, &rec); i++) {
+            const char *name = sched_trace_get_task_name(rec.id);
+            const bool is_task = (sched_trace_ev_switch_in == rec.type || sched_trace_ev_ready == rec.type);
+            output.printf("%10u %-12s %3u %-8s %u\n", (unsigned)rec.time_us, sched_trace_get_event_name(rec.type),
+                          rec.id, (is_task && name) ? name : "", rec.arg);
+        }
+        sched_trace_enable(enabled);
+        return true;
+    }
+    else if (cmdParams.getLen() > 0) {
+        return false;
+    }
+
+    output.printf("Trace %s: %u events, %u overwritten, %u bytes of RAM\n",
+                  sched_trace_is_enabled() ? "running" : "stopped",
+                  (unsigned)sched_trace_get_count(), (unsigned)sched_trace_get_lost(),
+                  (unsigned)(SCHED_TRACE_SIZE * sizeof(sched_trace_rec_t)));
+    return true;
+}
+#endif
 
 CMD_HANDLER_FUNC(healthHandler)
 {
@@ -184,10 +338,12 @@ CMD_HANDLER_FUNC(timeHandler)
      * If cmdParam contains "set" with six spaces, we can parse the time
      * Example: set 11 30 2014 8 25 0 1
      */
-    if(cmdParams.beginsWith("set"))
+    str_view params(cmdParams);
+    if(params.nextToken() == "set")
     {
-        unsigned m, d, y, hr, mn, sc, w;
-        if( 7 != cmdParams.scanf("%*s %u %u %u %u %u %u %u", &m, &d, &y, &hr, &mn, &sc, &w))
+        uint32_t m, d, y, hr, mn, sc, w;
+        if (!(params.nextUint(&m) && params.nextUint(&d) && params.nextUint(&y) &&
+              params.nextUint(&hr) && params.nextUint(&mn) && params.nextUint(&sc) && params.nextUint(&w)))
         {
             return false;
         }
@@ -212,7 +368,8 @@ CMD_HANDLER_FUNC(logHandler)
     }
     else if (cmdParams == "status") {
         output.printf("Blocked calls  : %u\n", logger_get_blocked_call_count());
-        output.printf("Queue watermark: %u\n", logger_get_num_buffers_watermark());
+        output.printf("Dropped calls  : %u\n", (unsigned) logger_get_dropped_call_count());
+        output.printf("Msgs watermark : %u\n", logger_get_num_buffers_watermark());
         output.printf("Highest file write time: %ums\n", logger_get_highest_file_write_time_ms());
         output.printf("Call counts    : %u dgb %u info %u warn %u err\n",
                       logger_get_logged_call_count(log_debug),
@@ -304,9 +461,7 @@ CMD_HANDLER_FUNC(catHandler)
             totalBytesRead += bytesRead;
 
             if(printToScreen) {
-                for (UINT i = 0; i < bytesRead; i++) {
-                    output.putChar(buffer[i]);
-                }
+                output.write(buffer, bytesRead);
 
                 //output.getChar(&c, portMAX_DELAY);
                 if ('x' == c) {
@@ -419,20 +574,23 @@ CMD_HANDLER_FUNC(rmHandler)
 
 CMD_HANDLER_FUNC(i2cIoHandler)
 {
-    bool read = cmdParams.beginsWithIgnoreCase("read");
-    bool write = cmdParams.beginsWithIgnoreCase("write");
-    bool discover = cmdParams.beginsWithIgnoreCase("discover");
+    str_view params(cmdParams);
+    const str_view action = params.nextToken();
+    bool read = action.beginsWithIgnoreCase("read");
+    bool write = action.beginsWithIgnoreCase("write");
+    bool discover = action.beginsWithIgnoreCase("discover");
 
-    int addr = 0;
-    int reg = 0;
-    int data = 0;
-    unsigned int count = 0;
+    uint32_t addr = 0;
+    uint32_t reg = 0;
+    uint32_t data = 0;
+    uint32_t count = 0;
 
     if (read) {
-        if (cmdParams.scanf("%*s %0x %0x %u", &addr, &reg, &count) < 2) {
+        if (!params.nextUint(&addr, 16) || !params.nextUint(&reg, 16)) {
             output.putline("Need device and register address");
             return false;
         }
+        params.nextUint(&count);
 
         uint8_t buffer[256] = { 0 };
         if (count <= 0) {
@@ -449,7 +607,7 @@ CMD_HANDLER_FUNC(i2cIoHandler)
         }
     }
     else if (write) {
-        if (3 != cmdParams.scanf("%*s %0x %0x %0x", &addr, &reg, &data)) {
+        if (!params.nextUint(&addr, 16) || !params.nextUint(&reg, 16) || !params.nextUint(&data, 16)) {
             output.putline("Need device, register address and data");
             return false;
         }
@@ -608,10 +766,12 @@ CMD_HANDLER_FUNC(rebootHandler)
 static void stream_tlm(const char *s, void *arg)
 {
     CharDev *out = (CharDev*) arg;
-    while (*s) {
-        out->putChar(*s);
-        s++;
-    }
+    out->put(s);
+}
+static void stream_tlm_bin(const void *data, uint32_t len, void *arg)
+{
+    CharDev *out = (CharDev*) arg;
+    out->write(data, len);
 }
 
 CMD_HANDLER_FUNC(telemetryHandler)
@@ -624,11 +784,20 @@ CMD_HANDLER_FUNC(telemetryHandler)
     {
         tlm_stream_all(stream_tlm, &output, true);
     }
+    else if (cmdParams.beginsWithIgnoreCase("binary"))
+    {
+        tlm_stream_bin_schema(NULL, stream_tlm_bin, &output);
+        tlm_stream_bin_values(NULL, stream_tlm_bin, &output);
+    }
     else if(cmdParams == "save") {
-        FILE *fd = fopen(SYS_CFG_DISK_TLM_NAME, "w");
-        tlm_stream_one_file(tlm_component_get_by_name(SYS_CFG_DISK_TLM_NAME), fd);
-        fclose(fd);
-        output.putline("Telemetry was saved to disk");
+        /* Compact the terminal's journal such that its size and its copy of the variables stay in sync with the file */
+        tlm_journal_t *journal = (tlm_journal_t*) pDataParam;
+        if (NULL != journal && tlm_journal_compact(journal)) {
+            output.putline("Telemetry was saved to disk");
+        }
+        else {
+            output.putline("Failed to save telemetry to disk");
+        }
     }
     else if(cmdParams.beginsWithIgnoreCase("get")) {
         char *compName = NULL;
@@ -684,6 +853,7 @@ CMD_HANDLER_FUNC(learnIrHandler)
 
 #if TERMINAL_USE_CAN_BUS_HANDLER
 #include "can.h"
+#include "can_filter.h"
 #include "printf_lib.h"
 void can_BusOffCallback(uint32_t ibits)
 {
@@ -714,44 +884,54 @@ CMD_HANDLER_FUNC(canBusHandler)
         output.printf("CAN init: %s\n", ok ? "OK" : "ERROR");
 
         CAN_reset_bus(can);
-        CAN_bypass_filter_ack_all_msgs();
+        CAN_bypass_filter_accept_all_msgs();
     }
     else if (cmdParams.beginsWithIgnoreCase("filter"))
     {
+        can_filter_range_t ranges[16];
+        can_filter_t filter;
         uint32_t id = 0;
-        if (cmdParams.scanf("%*s %x", &id))
-        {
-            can_std_id_t *nosid = NULL;
-            can_std_grp_id_t *nosgp = NULL;
-            can_ext_grp_id_t *noeid = NULL;
-            can_ext_id_t eid = CAN_gen_eid(can, id);
+        str_view params(cmdParams);
+        params.nextToken();
 
-            CAN_setup_filter(nosid, 0,
-                             nosgp, 0,
-                             &eid, 1,
-                             noeid, 0);
+        can_filter_init(&filter, ranges, sizeof(ranges) / sizeof(ranges[0]));
+        while (params.nextUint(&id, 16) && can_filter_add(&filter, can, true, id)) {
+            ;
+        }
+
+        can_filter_table_t *table = (can_filter_table_t*) malloc(sizeof(*table));
+        if (0 == filter.count) {
+            output.printf("Please specify the ID(s) to filter: 'filter 0x100 0x200'\n");
+        }
+        else if (!table) {
+            output.printf("Not enough memory\n");
         }
         else {
-            output.printf("Please specify the ID to filter: 'filter 0x100'\n");
+            const bool ok = can_filter_compile(&filter, table) && CAN_setup_filter_table(table);
+            output.printf("CAN filter: %s, %u/%u bytes used\n", ok ? "OK" : "ERROR",
+                          table->used_bytes, CAN_FILTER_RAM_SIZE);
         }
+        free(table);
     }
     else if (cmdParams.beginsWithIgnoreCase("tx"))
     {
-        int length = 0;
-        int message_id = 0;
+        uint32_t length = 0;
+        uint32_t message_id = 0;
         can_msg_t msg = { 0 };
+        str_view params(cmdParams);
+        params.nextToken();
 
         /* Get length and message id */
-        if (2 != cmdParams.scanf("%*s %x %i", &message_id, &length)) {
+        if (!params.nextUint(&message_id, 16) || !params.nextUint(&length)) {
             output.printf("Need <message id> <length> <bytes>\n");
             return true;
         }
 
-        /* Remove first three words, then scan for data bytes of can message */
-        cmdParams.eraseFirstWords(3);
-        cmdParams.scanf("%x %x %x %x %x %x %x %x",
-                        &msg.data.bytes[0], &msg.data.bytes[1], &msg.data.bytes[2], &msg.data.bytes[3],
-                        &msg.data.bytes[4], &msg.data.bytes[5], &msg.data.bytes[6], &msg.data.bytes[7]);
+        /* Scan for data bytes of can message */
+        uint32_t byte = 0;
+        for (unsigned int i = 0; i < sizeof(msg.data.bytes) && params.nextUint(&byte, 16); i++) {
+            msg.data.bytes[i] = byte;
+        }
 
         msg.frame_fields.data_len = length;
         msg.frame_fields.is_29bit = 1;
@@ -773,8 +953,10 @@ CMD_HANDLER_FUNC(canBusHandler)
     }
     else if (cmdParams.beginsWithIgnoreCase("rx"))
     {
-        int timeout = 0;
-        cmdParams.scanf("%*s %i", &timeout);
+        int32_t timeout = 0;
+        str_view params(cmdParams);
+        params.nextToken();
+        params.nextInt(&timeout);
 
         bool rx = false;
         can_msg_t msg;
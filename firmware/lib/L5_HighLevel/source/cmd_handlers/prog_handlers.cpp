@@ -60,9 +60,13 @@ CMD_HANDLER_FUNC(getFileHandler)
     if (cmdParams.beginsWithIgnoreCase("commit"))
     {
         char filename[128] = { 0 };
-        int offset = 0;
-        int size = 0;
-        cmdParams.scanf("%*s %128s %i %i", &filename[0], &offset, &size);
+        int32_t offset = 0;
+        int32_t size = 0;
+        str_view params(cmdParams);
+        params.nextToken();
+        params.nextToken().copyTo(filename, sizeof(filename));
+        params.nextInt(&offset);
+        params.nextInt(&size);
 
         FRESULT writeStatus = FR_INT_ERR;
         if(0 == offset) {
@@ -75,26 +79,32 @@ CMD_HANDLER_FUNC(getFileHandler)
     }
     else if (cmdParams.beginsWithIgnoreCase("buffer"))
     {
-        int offset = 0;
-        int numBytes = 0;
+        int32_t offset = 0;
+        int32_t numBytes = 0;
         int checksum = 0;
-        char c = 0;
 
-        cmdParams.scanf("%*s %i %i", &offset, &numBytes);
+        str_view params(cmdParams);
+        params.nextToken();
+        params.nextInt(&offset);
+        params.nextInt(&numBytes);
 
         if (offset + numBytes > maxBufferSize) {
             output.printf("ERROR: Max buffer size is %i bytes\n", maxBufferSize);
             return true;
         }
 
-        for(int i=offset; i - offset < numBytes && i < maxBufferSize; i++) {
-            if(! output.getChar(&c, OS_MS(2000))) {
+        for (int32_t received = 0; received < numBytes; ) {
+            char *p = spBuffer + offset + received;
+            const uint32_t n = output.read(p, numBytes - received, OS_MS(2000));
+            if (0 == n) {
                 output.printf("ERROR: TIMEOUT\n");
                 return true;
             }
 
-            spBuffer[i] = c;
-            checksum += c;
+            for (uint32_t i = 0; i < n; i++) {
+                checksum += p[i];
+            }
+            received += n;
         }
 
         output.printf("Checksum %i\n", checksum);
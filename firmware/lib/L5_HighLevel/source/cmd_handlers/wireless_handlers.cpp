@@ -24,11 +24,14 @@ static CMD_HANDLER_FUNC(wsStreamHandler)
 {
     const int outBlockTime = 1;
     const int timeout_ms = 1000;
-    int addr = 0;
-    cmdParams.scanf("%i", &addr);
-    cmdParams.eraseFirstWords(1);
+    int32_t addr = 0;
+    str_view params(cmdParams);
+    params.nextInt(&addr);
 
-    if (0 == addr || 0 == cmdParams.getLen())
+    /* The command is the rest of cmdParams, so it is still NULL terminated */
+    const str_view command = params.trimStart();
+
+    if (0 == addr || command.isEmpty())
     {
         output.putline("Parse error: try: 'stream <addr> <command>'");
     }
@@ -43,7 +46,7 @@ static CMD_HANDLER_FUNC(wsStreamHandler)
             ;
         }
         n.setDestAddr(addr);
-        n.putline(cmdParams());
+        n.putline(command.data());
         n.flush();
 
         // Terminal sends unique last four chars to indicate end of output
@@ -111,10 +114,13 @@ static CMD_HANDLER_FUNC(wsFileTxHandler)
     char srcFile[128] = { 0 };
     char dstFile[128] = { 0 };
     int timeout = 1000;
-    int addr = 0;
+    int32_t addr = 0;
     FIL file;
 
-    if (3 != cmdParams.scanf("%128s %128s %i", &srcFile[0], &dstFile[0], &addr)) {
+    str_view params(cmdParams);
+    if (!params.nextToken().copyTo(srcFile, sizeof(srcFile)) ||
+        !params.nextToken().copyTo(dstFile, sizeof(dstFile)) ||
+        !params.nextInt(&addr)) {
         return false;
     }
     if (FR_OK != f_open(&file, srcFile, FA_OPEN_EXISTING | FA_READ)) {
@@ -148,8 +154,11 @@ static CMD_HANDLER_FUNC(wsFileTxHandler)
         n.flush();
 
         expectedChecksum = 0;
+        if (n.write(buffer, bytesRead) != bytesRead) {
+            output.printf("ERROR: Sending the data failed\n");
+            doRetry();
+        }
         for (unsigned int i=0; i < bytesRead; i++) {
-            n.putChar(buffer[i]);
             expectedChecksum += buffer[i];
         }
         n.flush();
@@ -188,10 +197,10 @@ static CMD_HANDLER_FUNC(wsFileTxHandler)
 static CMD_HANDLER_FUNC(wsRxHandler)
 {
     bool rx = false;
-    int timeout_ms = 1000;
+    int32_t timeout_ms = 1000;
     mesh_packet_t pkt;
 
-    cmdParams.scanf("%i", &timeout_ms);
+    str_view(cmdParams).nextInt(&timeout_ms);
 
     while (wireless_get_rx_pkt(&pkt, timeout_ms)) {
         output.printf("Received data from %i\n", pkt.nwk.src);
@@ -252,9 +261,6 @@ static CMD_HANDLER_FUNC(wsStatsHandler)
 
 static CMD_HANDLER_FUNC(wsTxHandler)
 {
-    char *addr_str = NULL;
-    char *data_str = NULL;
-
     const bool ack = pDataParam;
     const int max_hops_to_use = 2;
     int timeout_ms = 1000;
@@ -263,13 +269,16 @@ static CMD_HANDLER_FUNC(wsTxHandler)
     mesh_stats_t stats = { 0 };
     #endif
 
-    if (cmdParams.tokenize(" ", 2, &addr_str, &data_str) < 1) {
+    uint32_t addr = 0;
+    str_view params(cmdParams);
+    if (!params.nextUint(&addr)) {
         return false;
     }
 
     /* Data is optional */
-    const uint8_t dst_addr = atoi(addr_str);
-    const uint8_t len = data_str ? strlen(data_str) : 0;
+    const str_view data = params.trimStart();
+    const uint8_t dst_addr = addr;
+    const uint8_t len = data.getLen();
 
     // Flush any packets
     while (wireless_get_rx_pkt(&pkt, 0)) {
@@ -277,7 +286,7 @@ static CMD_HANDLER_FUNC(wsTxHandler)
         ;
     }
 
-    if (! wireless_send(dst_addr, ack ? mesh_pkt_ack : mesh_pkt_nack, data_str, len, max_hops_to_use)) {
+    if (! wireless_send(dst_addr, ack ? mesh_pkt_ack : mesh_pkt_nack, data.data(), len, max_hops_to_use)) {
         output.putline("Error sending packet, check parameters!");
     }
     /* If ack was requested, then we wait for the ack */
@@ -305,7 +314,7 @@ static CMD_HANDLER_FUNC(wsTxHandler)
             }
         }
         else {
-            output.printf("Packet sent to %s but no ACK received", addr_str);
+            output.printf("Packet sent to %u but no ACK received", dst_addr);
         }
     }
 
@@ -43,6 +43,7 @@
 #include "wireless.h"
 #include "fault_registers.h"
 #include "c_tlm_comp.h"
+#include "sched_trace.h"
 
 
 
@@ -75,6 +76,11 @@ static void hl_handle_board_id(void);
 /// Prints out the board programming info (how many times the board was programmed etc.)
 static void hl_show_prog_info(void);
 
+#if SYS_CFG_SCHED_TRACE
+/// The clock of the scheduling trace: lower 32-bits of the uptime in microseconds
+static uint32_t hl_sched_trace_time_us(void) { return (uint32_t) sys_get_uptime_us(); }
+#endif
+
 
 
 /**
@@ -122,6 +128,14 @@ void high_level_init(void)
         puts("ERROR: Failed to initialize wireless");
     }
 
+    /* Start the scheduling trace now that the uptime timer runs; the tasks created so far
+     * already have their trace id, and the scheduler has not started yet.
+     */
+    #if SYS_CFG_SCHED_TRACE
+        static sched_trace_rec_t sched_trace_recs[SCHED_TRACE_SIZE];
+        sched_trace_init(sched_trace_recs, SCHED_TRACE_SIZE, hl_sched_trace_time_us);
+    #endif
+
     /* Add default telemetry components if telemetry is enabled */
     #if SYS_CFG_ENABLE_TLM
         tlm_component_add(SYS_CFG_DISK_TLM_NAME);
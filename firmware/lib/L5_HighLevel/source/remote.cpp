@@ -90,6 +90,11 @@ bool remoteTask::run(void *p)
             LD.setNumber(i);
         }
 
+        #if SYS_CFG_ENABLE_TLM
+        /* Disk variables are only saved if they are marked as changed */
+        TLM_MARK_CHANGED(tlm_component_get_by_name(SYS_CFG_DISK_TLM_NAME), mNumCodes);
+        #endif
+
         puts("Learned all numbers!");
         vTaskDelayMs(2000);
     }
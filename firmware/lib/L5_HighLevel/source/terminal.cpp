@@ -37,6 +37,8 @@
 #include "c_tlm_comp.h"
 #include "c_tlm_stream.h"
 #include "c_tlm_binary.h"
+#include "c_tlm_journal.h"
+#include "heap_profiler.h"
 
 
 
@@ -47,9 +49,7 @@
 
 terminalTask::terminalTask(uint8_t priority) :
         scheduler_task("terminal", 1024*4, priority),
-        mCmdIface(2), /* 2 interfaces can be added without memory reallocation */
-        mCmdProc(24), /* 24 commands can be added without memory reallocation */
-        mCommandCount(0), mDiskTlmSize(0), mpBinaryDiskTlm(NULL),
+        mCommandCount(0), mDiskTlmSize(0), mDiskJournal(),
         mCmdTimer(CMD_TIMEOUT_DISK_VARS)
 {
     /* Nothing to do */
@@ -58,6 +58,21 @@ terminalTask::terminalTask(uint8_t priority) :
 bool terminalTask::regTlm(void)
 {
     #if SYS_CFG_ENABLE_TLM
+    #if SYS_CFG_HEAP_PROFILER
+    /* The task of each array index is listed by the "heapprof" command */
+    tlm_component *debug = tlm_component_get_by_name(SYS_CFG_DEBUG_TLM_NAME);
+    heap_prof_t *prof = sys_get_heap_prof();
+    const uint16_t u32 = sizeof(uint32_t);
+    if (!tlm_variable_register(debug, "heap_live_bytes", &prof->live_bytes, u32, 1, tlm_uint) ||
+        !tlm_variable_register(debug, "heap_peak_bytes", &prof->peak_bytes, u32, 1, tlm_uint) ||
+        !tlm_variable_register(debug, "heap_untracked", &prof->untracked_allocs, u32, 1, tlm_uint) ||
+        !tlm_variable_register(debug, "heap_task_live", prof->task_live_bytes, u32, HEAP_PROF_MAX_TASKS, tlm_uint) ||
+        !tlm_variable_register(debug, "heap_task_peak", prof->task_peak_bytes, u32, HEAP_PROF_MAX_TASKS, tlm_uint) ||
+        !tlm_variable_register(debug, "heap_task_allocs", prof->task_allocs, u32, HEAP_PROF_MAX_TASKS, tlm_uint)) {
+        return false;
+    }
+    #endif
+
     return (TLM_REG_VAR(tlm_component_get_by_name(SYS_CFG_DEBUG_TLM_NAME), mCommandCount, tlm_uint) &&
             TLM_REG_VAR(tlm_component_get_by_name(SYS_CFG_DEBUG_TLM_NAME), mDiskTlmSize, tlm_uint));
     #else
@@ -73,6 +88,17 @@ bool terminalTask::taskEntry()
     // System information handlers
     cp.addHandler(taskListHandler, "info",    "Task/CPU Info.  Use 'info 200' to get CPU during 200ms");
     cp.addHandler(memInfoHandler,  "meminfo", "See memory info");
+    #if SYS_CFG_HEAP_PROFILER
+    cp.addHandler(heapProfHandler, "heapprof", "'heapprof' : Heap memory of each task and the top 8 call sites\n"
+                                               "'heapprof <n>' : Heap memory of each task and the top <n> call sites\n"
+                                               "'heapprof bench' : Time of malloc() and free() with and without the profiler");
+    #endif
+    #if SYS_CFG_SCHED_TRACE
+    cp.addHandler(schedTraceHandler, "trace", "'trace' : Status of the scheduling trace\n"
+                                              "'trace start', 'trace stop' or 'trace clear' : Control the trace\n"
+                                              "'trace list <n>' : List the last n events\n"
+                                              "'trace save <file>' : Save the trace to convert with tools/SchedTrace");
+    #endif
     cp.addHandler(healthHandler,   "health",  "Output system health");
     cp.addHandler(timeHandler,     "time",    "'time' to view time.  'time set MM DD YYYY HH MM SS Wday' to set time");
 
@@ -94,7 +120,7 @@ bool terminalTask::taskEntry()
     #if TERMINAL_USE_CAN_BUS_HANDLER
     CMD_HANDLER_FUNC(canBusHandler);
     cp.addHandler(canBusHandler,  "canbus", "'canbus init' : initialize CAN-1\n"
-                                            "'canbus filter <id>' : Add 29-bit ID fitler\n"
+                                            "'canbus filter <id> <id> ...' : Accept only these 29-bit IDs\n"
                                             "'canbus tx <msg id> <len> <byte0> <byte1> ...' : Send CAN Message\n"
                                             "'canbus rx <timeout in ms>' : Receive a CAN message\n"
                                             "'canbus registers' : See some of CAN BUS registers");
@@ -125,8 +151,10 @@ bool terminalTask::taskEntry()
     cp.addHandler(telemetryHandler, "telemetry", "Outputs registered telemetry: "
                                                  "'telemetry save' : Saves disk tel\n"
                                                  "'telemetry ascii' : Prints all telemetry in human readable format\n"
+                                                 "'telemetry binary' : Outputs all telemetry as the binary stream\n"
                                                  "'telemetry <comp. name> <name> <value>' to set a telemetry variable\n"
-                                                 "'telemetry get <comp. name> <name>' to get variable value\n");
+                                                 "'telemetry get <comp. name> <name>' to get variable value\n",
+                                                 &mDiskJournal);
     #endif
 
     // Initialize Interrupt driven version of getchar & putchar
@@ -148,18 +176,17 @@ bool terminalTask::taskEntry()
     #endif
 
     #if SYS_CFG_ENABLE_TLM
-    /* Telemetry should be registered at this point, so initialize the binary
-     * telemetry space that we periodically check to save data to disk
+    /* Telemetry should be registered (and restored) at this point, so initialize the
+     * journal that we periodically append the changed disk variables to
      */
     tlm_component *disk = tlm_component_get_by_name(SYS_CFG_DISK_TLM_NAME);
     mDiskTlmSize = tlm_binary_get_size_one(disk);
-    mpBinaryDiskTlm = new char[mDiskTlmSize];
-    if (success) {
-        success = (NULL != mpBinaryDiskTlm);
+    if (!tlm_journal_init(&mDiskJournal, disk, SYS_CFG_DISK_TLM_NAME)) {
+        success = false;
     }
 
-    /* Now update our copy of disk telemetry */
-    tlm_binary_get_one(disk, mpBinaryDiskTlm);
+    /* The writers of the disk variables mark them, so do not compare all of them at each sync */
+    mDiskJournal.scan_unmarked = false;
     #endif
 
     /* Display "help" command on UART0 */
@@ -220,27 +247,23 @@ bool terminalTask::saveDiskTlm(void)
     #if SYS_CFG_ENABLE_TLM
     tlm_component *disk = tlm_component_get_by_name(SYS_CFG_DISK_TLM_NAME);
 
-    /* Size of telemetry shouldn't change */
-    if (0 == mDiskTlmSize || mDiskTlmSize != tlm_binary_get_size_one(disk)) {
+    /* Variables registered after the journal was initialized are not saved */
+    if (0 == mDiskTlmSize || NULL == disk || mDiskJournal.var_count != disk->var_count) {
         return changed;
     }
 
-    if (!tlm_binary_compare_one(disk, mpBinaryDiskTlm))
+    /* Only the changed variables are appended to the journal */
+    const int count = tlm_journal_sync(&mDiskJournal);
+    if (0 != count)
     {
         changed = true;
-        puts("Disk variables changed...");
-
-        FILE *file = fopen(SYS_CFG_DISK_TLM_NAME, "w");
-        if (file) {
-            // Only update variables if we could open the file
-            tlm_binary_get_one(disk, mpBinaryDiskTlm);
-
-            tlm_stream_one_file(disk, file);
-            fclose(file);
-
-            puts("Changes saved to disk...");
+        if (count > 0) {
+            printf("%i disk variable(s) saved to disk...\n", count);
             LOG_SIMPLE_MSG("Disk variables saved to disk");
         }
+        else {
+            puts("Failed to save disk variables");
+        }
     }
     #endif
 
@@ -26,8 +26,10 @@
 #include "scheduler_task.hpp"
 #include "soft_timer.hpp"
 #include "command_handler.hpp"
+#include "vector.hpp"
 #include "wireless.h"
 #include "char_dev.hpp"
+#include "c_tlm_journal.h"
 
 #include "FreeRTOS.h"
 #include "semphr.h"
@@ -38,7 +40,8 @@
  * Terminal task is our UART0 terminal that handles our commands into the board.
  * This also saves and restores the "disk" telemetry.  Disk telemetry variables
  * are automatically saved and restored across power-cycles to help us preserve
- * any non-volatile information.
+ * any non-volatile information.  Only the variables marked by TLM_MARK_CHANGED(),
+ * or set by the "telemetry" command, are saved; the data is not compared.
  */
 class terminalTask : public scheduler_task
 {
@@ -56,11 +59,11 @@ class terminalTask : public scheduler_task
             bool echo;      ///< If input should be echo'd back
         } cmdChan_t;
 
-        VECTOR<cmdChan_t> mCmdIface;   ///< Command interfaces
-        CommandProcessor mCmdProc;     ///< Command processor
+        VECTOR<cmdChan_t, 2> mCmdIface; ///< Command interfaces (2 are stored without using the heap)
+        StaticCommandProcessor<32, 160> mCmdProc; ///< Command processor (32 commands are stored without using the heap)
         uint16_t mCommandCount;        ///< terminal command count
         uint16_t mDiskTlmSize;         ///< Size of disk variables in bytes
-        char *mpBinaryDiskTlm;         ///< Binary disk telemetry
+        tlm_journal_t mDiskJournal;    ///< Journal file of the disk telemetry
         SoftTimer mCmdTimer;           ///< Command timer
 
         cmdChan_t getCommand(void);
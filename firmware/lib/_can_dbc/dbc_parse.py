@@ -11,6 +11,7 @@ This parses the Vector DBC file to generate code to marshal and unmarshal DBC de
 Use Python (I used Python 3.5)
 python dbc_parse.py -i 243.dbc -s MOTOR
 Generate all code: dbc_parse.py -i 243.dbc -s MOTOR -a all > generated.h
+Add the IDs that MOTOR receives for the CAN acceptance filter: dbc_parse.py -i 243.dbc -s MOTOR -f > generated.h
 """
 
 LINE_BEG = '%'
@@ -620,22 +621,37 @@ class DBC(object):
 
         return code
 
+    def gen_rx_msg_ids(self):
+        ids = []
+        for mkey in self.messages:
+            m = self.messages[mkey]
+            if self.gen_all or m.is_recipient_of_at_least_one_sig(self.self_node):
+                ids.append(m.mid)
+
+        code = ("/// Message IDs that '%s' receives, to accept with the CAN acceptance filter, see can_filter_add_ids()\n" % self.self_node)
+        if ids:
+            code += ("static const uint32_t dbc_rx_msg_ids[] = { " + ", ".join(ids) + " };\n")
+        else:
+            code += ("// No messages are received by '%s'\n" % self.self_node)
+        return code
+
 
 def main(argv):
     dbcfile = '243.dbc'  # Default value unless overriden
     self_node = 'DRIVER'  # Default value unless overriden
     gen_all = False
+    gen_filter = False
     muxed_signal = False
     mux_bit_width = 0
     msg_ids_used = []
     try:
-        opts, args = getopt.getopt(argv, "i:s:a", ["ifile=", "self=", "all"])
+        opts, args = getopt.getopt(argv, "i:s:af", ["ifile=", "self=", "all", "filter"])
     except getopt.GetoptError:
-        print('dbc_parse.py -i <dbcfile> -s <self_node> <-a>')
+        print('dbc_parse.py -i <dbcfile> -s <self_node> <-a> <-f>')
         sys.exit(2)
     for opt, arg in opts:
         if opt == '-h':
-            print('dbc_parse.py -i <dbcfile> -s <self_node> <-a> <-b>')
+            print('dbc_parse.py -i <dbcfile> -s <self_node> <-a> <-f>')
             sys.exit()
         elif opt in ("-i", "--ifile"):
             dbcfile = arg
@@ -643,6 +659,8 @@ def main(argv):
             self_node = arg
         elif opt in ("-a", "--all"):
             gen_all = True
+        elif opt in ("-f", "--filter"):
+            gen_filter = True
 
     # Parse the DBC file
     dbc = DBC(dbcfile, self_node, gen_all)
@@ -923,6 +941,10 @@ def main(argv):
             print(m.get_decode_code())
 
     print(dbc.gen_mia_funcs())
+
+    # Generate the message IDs for the CAN acceptance filter
+    if gen_filter:
+        print(dbc.gen_rx_msg_ids())
     print("#endif")
 
 
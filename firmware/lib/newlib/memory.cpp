@@ -21,6 +21,15 @@
 #include <stddef.h>
 
 #include "lpc_sys.h"
+#include "sys_config.h"
+#include "FreeRTOSConfig.h"
+
+#if SYS_CFG_HEAP_PROFILER
+#include <reent.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "heap_profiler.h"
+#endif
 
 
 
@@ -53,6 +62,15 @@ extern "C" void * _sbrk(size_t req_bytes)
 {
     char  *ret_mem = 0;
 
+#if 6 == configMEM_MANG_TYPE
+    /* The TLSF heap (heap_tlsf.c.inc) owns all of the RAM, so there is nothing to give */
+    if (req_bytes > 0) {
+        ++g_sbrk_calls;
+        g_last_sbrk_size = req_bytes;
+    }
+    return (void*) -1;
+#endif
+
     /* Initialize Heap pointer to bottom of RAM region 1 */
     if (!g_next_heap_ptr) {
         g_next_heap_ptr = (char*) ram_region_1_base;
@@ -99,12 +117,99 @@ extern "C" void * _sbrk(size_t req_bytes)
     return ret_mem;        /*  Return pointer to start of new heap area.   */
 }
 
+#if SYS_CFG_HEAP_PROFILER
+/**
+ * @{ The heap profiler's view of FreeRTOS.
+ * Allocations before the scheduler starts (such as by the constructors of the tasks)
+ * are counted as the "boot" task.
+ */
+static void* heap_prof_get_task(void)
+{
+    return (taskSCHEDULER_NOT_STARTED == xTaskGetSchedulerState()) ? NULL : xTaskGetCurrentTaskHandle();
+}
+static const char* heap_prof_get_task_name(void *task)  {   return pcTaskGetName((TaskHandle_t) task);  }
+static void heap_prof_lock(void)                        {   taskENTER_CRITICAL();                       }
+static void heap_prof_unlock(void)                      {   taskEXIT_CRITICAL();                        }
+static const heap_prof_task_provider_t g_heap_prof_provider = {
+    heap_prof_get_task, heap_prof_get_task_name, heap_prof_lock, heap_prof_unlock
+};
+/** @} */
+
+/// Zeroed with the provider set, so it works before main() without heap_prof_init()
+static heap_prof_t g_heap_prof = { &g_heap_prof_provider };
+
+extern "C" heap_prof_t* sys_get_heap_prof(void)
+{
+    return &g_heap_prof;
+}
+
+static inline void *heap_prof_malloc(size_t size, const void *site)
+{
+    void *ptr = _malloc_r(_REENT, size);
+    heap_prof_on_alloc(&g_heap_prof, ptr, size, site);
+    return ptr;
+}
+
+static inline void heap_prof_free(void *ptr)
+{
+    /* Forget the memory before it is freed and possibly given to another task */
+    heap_prof_on_free(&g_heap_prof, ptr);
+    _free_r(_REENT, ptr);
+}
+
+/**
+ * @{ Profiled replacements of the newlib malloc() functions.
+ * These replace the newlib malloc.o (that has malloc() and free()), realloc.o and calloc.o,
+ * and use the same reentrant _r functions.  Memory allocated by newlib internally goes
+ * straight to the _r functions, and is not profiled.
+ */
+extern "C" void *malloc(size_t size)
+{
+    return heap_prof_malloc(size, __builtin_return_address(0));
+}
+
+extern "C" void free(void *ptr)
+{
+    heap_prof_free(ptr);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    const size_t old_size = heap_prof_on_free(&g_heap_prof, ptr);
+    void *new_ptr = _realloc_r(_REENT, ptr, size);
+
+    if (new_ptr) {
+        heap_prof_on_alloc(&g_heap_prof, new_ptr, size, __builtin_return_address(0));
+    }
+    else if (old_size > 0 && size > 0) {
+        /* realloc() failed, so the old memory is still allocated */
+        heap_prof_on_alloc(&g_heap_prof, ptr, old_size, __builtin_return_address(0));
+    }
+    return new_ptr;
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    void *ptr = _calloc_r(_REENT, count, size);
+    heap_prof_on_alloc(&g_heap_prof, ptr, count * size, __builtin_return_address(0));
+    return ptr;
+}
+/** @} */
+
+/** @{ Redirect C++ memory functions to C, with the caller of new as the call site */
+void *operator new(size_t size)     {   return heap_prof_malloc(size, __builtin_return_address(0)); }
+void *operator new[](size_t size)   {   return heap_prof_malloc(size, __builtin_return_address(0)); }
+void operator delete(void *p)       {   heap_prof_free(p);      }
+void operator delete[](void *p)     {   heap_prof_free(p);      }
+/** @} */
+#else
 /** @{ Redirect C++ memory functions to C */
 void *operator new(size_t size)     {   return malloc(size);    }
 void *operator new[](size_t size)   {   return malloc(size);    }
 void operator delete(void *p)       {   free(p);                }
 void operator delete[](void *p)     {   free(p);                }
 /** @} */
+#endif /* SYS_CFG_HEAP_PROFILER */
 
 extern "C" sys_mem_t sys_get_mem_info()
 {
@@ -123,6 +228,16 @@ extern "C" sys_mem_t sys_get_mem_info()
     meminfo.avail_heap = info.fordblks;
     meminfo.used_heap = info.uordblks;
 
+#if 6 == configMEM_MANG_TYPE
+    /* The TLSF heap has all of the RAM from the start, and its mallinfo() is accurate */
+    meminfo.avail_sys = 0;
+    meminfo.next_malloc_ptr = 0;
+    meminfo.last_sbrk_ptr = 0;
+    meminfo.last_sbrk_size = g_last_sbrk_size;
+    meminfo.num_sbrk_calls = g_sbrk_calls;
+    return meminfo;
+#endif
+
     /* HACK: 20131214 (GCC 4.7.4)
      *  Current version newlib nano returns zero for all mallinfo struct members.
      *  So this is a hack to deduce the used heap.
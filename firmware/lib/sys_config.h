@@ -69,6 +69,8 @@ extern "C" {
 #define SYS_CFG_DEBUG_TLM_NAME          "debug"     ///< Name of the debug telemetry component
 #define SYS_CFG_ENABLE_CFILE_IO         0           ///< Allow stdio fopen() fclose() to redirect to ff.h
 #define SYS_CFG_MAX_FILES_OPENED        3           ///< Maximum files that can be opened at once
+#define SYS_CFG_HEAP_PROFILER           0           ///< If non-zero, malloc() and new are counted by task and call site (@see heap_profiler.h)
+#define SYS_CFG_SCHED_TRACE             0           ///< If non-zero, task switches, ISRs and blocking are recorded to a ring (@see sched_trace.h)
 
 
 
@@ -0,0 +1,238 @@
+"""
+Decodes the binary log of the file logger (FILE_LOGGER_BINARY) back to the text log.
+
+The binary log stores the flash address of the format strings, filenames and function
+names, so the string table of the firmware that created the log is needed to decode it.
+The string table is extracted from the .elf file during the build, see the makefile.
+
+    python log_decoder.py strings build/bin/firmware.elf -o build/bin/firmware.logstr
+    python log_decoder.py decode log.bin -s build/bin/firmware.logstr > log.csv
+
+The record format is documented in firmware/lib/L3_Utils/log_binary.h
+"""
+from __future__ import print_function
+
+import argparse
+import bisect
+import json
+import re
+import struct
+import sys
+
+TYPE_STR = ['debug', 'info', 'warn', 'error']
+RAW_TYPE = 0x7F
+INLINE_FMT = 0x80
+INLINE_STR = 0xFF
+HEADER_SIZE = 20
+
+SHT_PROGBITS = 1
+SHF_WRITE = 0x1
+SHF_ALLOC = 0x2
+
+SPEC_RE = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|L|q|j|z|t)?([diouxXeEfFgGaAcspn%])')
+
+
+def extract_strings(elf_bytes):
+    """ Returns a dictionary of address to string of all strings in read-only sections of an ELF32 file """
+    if elf_bytes[0:4] != b'\x7fELF' or bytearray(elf_bytes)[4] != 1:
+        raise ValueError('Not an ELF32 file')
+
+    shoff, = struct.unpack_from('<I', elf_bytes, 0x20)
+    shentsize, shnum = struct.unpack_from('<HH', elf_bytes, 0x2E)
+    strings = {}
+
+    for i in range(shnum):
+        _, sh_type, flags, addr, offset, size = struct.unpack_from('<IIIIII', elf_bytes, shoff + i * shentsize)
+        if sh_type != SHT_PROGBITS or not (flags & SHF_ALLOC) or (flags & SHF_WRITE):
+            continue
+
+        # Printable runs that end with a NULL character
+        data = elf_bytes[offset:offset + size]
+        for m in re.finditer(b'[\x20-\x7e\t\r\n]+\x00', data):
+            strings[addr + m.start()] = m.group()[:-1].decode('ascii')
+
+    return strings
+
+
+class StringTable(object):
+    """ Looks up strings by address including addresses inside of a string (such as filename without path) """
+
+    def __init__(self, strings):
+        self.addrs = sorted(strings.keys())
+        self.strings = strings
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return None
+        start = self.addrs[i]
+        s = self.strings[start]
+        return s[addr - start:] if addr - start <= len(s) else None
+
+
+class Record(object):
+    """ Reads the fields of a record """
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def read(self, fmt):
+        size = struct.calcsize(fmt)
+        if self.pos + size > len(self.data):
+            raise EOFError()
+        values = struct.unpack_from(fmt, self.data, self.pos)
+        self.pos += size
+        return values[0] if len(values) == 1 else values
+
+    def peek(self):
+        """ Returns the next byte without reading it """
+        if self.pos >= len(self.data):
+            raise EOFError()
+        return bytearray(self.data)[self.pos]
+
+    def read_bytes(self, size):
+        if self.pos + size > len(self.data):
+            raise EOFError()
+        b = self.data[self.pos:self.pos + size]
+        self.pos += size
+        return b.decode('ascii', 'replace')
+
+
+def format_arg(rec, table, flags, width, precision, length, conv):
+    """ Reads the argument of one conversion from the record, and returns its text """
+    if width == '*':
+        width = str(rec.read('<i'))
+    if precision == '*':
+        precision = str(rec.read('<i'))
+
+    spec = '%' + flags + (width or '') + ('.' + precision if precision is not None else '')
+    if conv == '%':
+        return '%'
+    if conv == 'n':
+        return ''
+
+    if conv == 's':
+        if rec.peek() == INLINE_STR:
+            rec.pos += 1
+            s = table.lookup(rec.read('<I'))
+            s = '?' if s is None else s
+        else:
+            s = rec.read_bytes(rec.read('<B'))
+        return (spec + 's') % s
+
+    if conv in 'fFeEgGaA':
+        d = rec.read('<d')
+        if conv in 'aA':
+            return d.hex() if conv == 'a' else d.hex().upper()
+        return (spec + conv) % d
+
+    if length in ('ll', 'q', 'j'):
+        value = rec.read('<q' if conv in 'di' else '<Q')
+    else:
+        value = rec.read('<i' if conv in 'di' else '<I')
+        if length == 'hh':
+            value = ((value & 0xFF) ^ 0x80) - 0x80 if conv in 'di' else value & 0xFF
+        elif length == 'h':
+            value = ((value & 0xFFFF) ^ 0x8000) - 0x8000 if conv in 'di' else value & 0xFFFF
+
+    if conv == 'p':
+        return '0x%x' % value
+    if conv == 'c':
+        return (spec + 'c') % chr(value & 0xFF)
+    if conv == 'o' and '#' in flags:
+        # Python would print 0o17 instead of 017
+        return (spec.replace('#', '') + 's') % ('0%o' % value if value else '0')
+    return (spec + ('d' if conv == 'i' else conv)) % value
+
+
+def decode_record(data, table):
+    """ Returns the text of one record, which is the same as the text log """
+    rec = Record(data)
+    _, rec_type, line, time, uptime, file_addr, func_addr = rec.read('<BBHIIII')
+    text = ''
+
+    if (rec_type & ~INLINE_FMT) != RAW_TYPE:
+        file_name = '' if file_addr == 0 else (table.lookup(file_addr) or '?')
+        func_name = '' if func_addr == 0 else (table.lookup(func_addr) or '?')
+        file_name = re.split(r'[/\\]', file_name)[-1]
+        log_type = rec_type & ~INLINE_FMT
+        text = '%u/%u,%02u:%02u:%02u,%u,%s,%s,%s%s,%u,' % (
+            (time >> 22) & 0xF, (time >> 17) & 0x1F, (time >> 12) & 0x1F, (time >> 6) & 0x3F, time & 0x3F,
+            uptime, TYPE_STR[log_type] if log_type < len(TYPE_STR) else '?',
+            file_name, func_name, '()' if func_name else '', line)
+
+    try:
+        if rec_type & INLINE_FMT:
+            fmt = rec.read_bytes(rec.read('<B'))
+        else:
+            fmt = table.lookup(rec.read('<I'))
+    except EOFError:
+        return text + '<truncated record>\n'
+    if fmt is None:
+        return text + '<unknown format string>\n'
+
+    # Arguments that did not fit in the record stop the formatting like snprintf()
+    pos = 0
+    try:
+        for m in SPEC_RE.finditer(fmt):
+            text += fmt[pos:m.start()]
+            pos = m.end()
+            flags, width, precision, length, conv = m.groups()
+            text += format_arg(rec, table, flags, width, precision, length, conv)
+        text += fmt[pos:]
+    except EOFError:
+        pass
+
+    return text + '\n'
+
+
+def decode(log_bytes, table, out):
+    """ Decodes all records of a binary log """
+    pos = 0
+    while pos < len(log_bytes):
+        length = bytearray(log_bytes)[pos]
+        if length < HEADER_SIZE + 1 or pos + length > len(log_bytes):
+            print('Invalid record at offset %u, stopping' % pos, file=sys.stderr)
+            break
+        out.write(decode_record(log_bytes[pos:pos + length], table))
+        pos += length
+
+
+def main():
+    parser = argparse.ArgumentParser(description='File logger binary log decoder')
+    sub = parser.add_subparsers(dest='command')
+
+    p = sub.add_parser('strings', help='Extract the string table of the firmware .elf file')
+    p.add_argument('elf', help='Firmware .elf file')
+    p.add_argument('-o', '--output', required=True, help='Output string table file')
+
+    p = sub.add_parser('decode', help='Decode a binary log file')
+    p.add_argument('log', help='Binary log file (such as log.bin)')
+    p.add_argument('-s', '--strings', help='String table created by the strings command')
+    p.add_argument('-e', '--elf', help='Firmware .elf file (instead of the string table)')
+
+    args = parser.parse_args()
+
+    if args.command == 'strings':
+        with open(args.elf, 'rb') as f:
+            strings = extract_strings(f.read())
+        with open(args.output, 'w') as f:
+            json.dump(dict(('0x%08x' % a, s) for a, s in strings.items()), f, indent=0, sort_keys=True)
+    elif args.command == 'decode':
+        if args.elf:
+            with open(args.elf, 'rb') as f:
+                strings = extract_strings(f.read())
+        elif args.strings:
+            with open(args.strings) as f:
+                strings = dict((int(a, 16), s) for a, s in json.load(f).items())
+        else:
+            parser.error('String table (-s) or .elf file (-e) is required')
+        with open(args.log, 'rb') as f:
+            decode(f.read(), StringTable(strings), sys.stdout)
+    else:
+        parser.print_help()
+
+
+if __name__ == '__main__':
+    main()
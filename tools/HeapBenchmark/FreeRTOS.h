@@ -0,0 +1,24 @@
+/*
+ * Minimal FreeRTOS definitions to compile heap_4.c.inc on the host for heap_benchmark.c
+ */
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#define configSUPPORT_DYNAMIC_ALLOCATION    1
+#define configAPPLICATION_ALLOCATED_HEAP    0
+#define configUSE_MALLOC_FAILED_HOOK        0
+#define configTOTAL_HEAP_SIZE               HEAP_BENCHMARK_SIZE
+#define configASSERT(x)                     assert(x)
+
+#define portBYTE_ALIGNMENT                  8
+#define portBYTE_ALIGNMENT_MASK             0x0007
+
+#define traceMALLOC(ptr, size)
+#define traceFREE(ptr, size)
+#define mtCOVERAGE_TEST_MARKER()
+
+#endif /* INC_FREERTOS_H */
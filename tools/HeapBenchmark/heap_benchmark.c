@@ -0,0 +1,179 @@
+/*
+ * Host benchmark of the TLSF heap (heap scheme 6) versus the FreeRTOS heap_4.
+ *
+ * Both heaps get the same memory, and run the same random sequence of allocations and
+ * frees, sized like strings, vectors and telemetry buffers.  The fragmentation of the
+ * free memory is sampled as the sequence runs.
+ *
+ * The time of each call is measured, and the sequence is repeated such that the fastest
+ * time of each call is used.  This filters out the host interrupting the benchmark,
+ * so the worst-case is the slowest call of the heap itself.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+
+#define HEAP_BENCHMARK_SIZE     (48 * 1024)     ///< Same RAM as the SJ-One heap
+#include "heap_4.c.inc"
+#include "tlsf.h"
+
+#define NUM_SLOTS       400             ///< Number of live allocations
+#define NUM_OPS         (500 * 1000)
+#define NUM_REPEATS     5               ///< Times the sequence is repeated
+
+static float g_op_ns[NUM_OPS];          ///< Fastest time of each call of the sequence
+
+typedef struct {
+    const char *name;
+    void* (*alloc)(size_t);
+    void (*release)(void*);
+    void (*stats)(size_t *free_bytes, size_t *largest);
+} heap_api_t;
+
+typedef struct {
+    double malloc_ns, malloc_max_ns;
+    double free_ns, free_max_ns;
+    uint32_t mallocs, frees, failed;
+    double frag_sum;
+    uint32_t frag_samples;
+    uint32_t frag_max;
+} heap_result_t;
+
+static tlsf_t g_tlsf;
+static uint64_t g_tlsf_pool1[(32 * 1024) / 8];
+static uint64_t g_tlsf_pool2[(16 * 1024) / 8];
+
+static void* tlsf_alloc_wrapper(size_t size)   { return tlsf_malloc(&g_tlsf, size); }
+static void tlsf_free_wrapper(void *ptr)        { tlsf_free(&g_tlsf, ptr); }
+static void tlsf_stats_wrapper(size_t *free_bytes, size_t *largest)
+{
+    tlsf_stats_t stats;
+    tlsf_get_stats(&g_tlsf, &stats);
+    *free_bytes = stats.free_bytes;
+    *largest = stats.largest_free_block;
+}
+
+static void heap4_stats(size_t *free_bytes, size_t *largest)
+{
+    const BlockLink_t *block = NULL;
+    *free_bytes = xPortGetFreeHeapSize();
+    *largest = 0;
+    for (block = xStart.pxNextFreeBlock; block && block != pxEnd; block = block->pxNextFreeBlock) {
+        if (block->xBlockSize > *largest) {
+            *largest = block->xBlockSize;
+        }
+    }
+}
+
+static inline double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+/// Sizes like the firmware: mostly small strings, some vectors, and a few large buffers
+static size_t random_size(void)
+{
+    const int r = rand() % 100;
+    if (r < 70) {
+        return 8 + rand() % 57;
+    }
+    else if (r < 95) {
+        return 64 + rand() % 449;
+    }
+    return 512 + rand() % 1537;
+}
+
+static void run(const heap_api_t *heap, heap_result_t *result, unsigned seed, bool last)
+{
+    static void *slots[NUM_SLOTS];
+    static bool is_malloc[NUM_OPS];
+    uint32_t i = 0;
+
+    memset(result, 0, sizeof(*result));
+    memset(slots, 0, sizeof(slots));
+    srand(seed);
+
+    for (i = 0; i < NUM_OPS; i++) {
+        const uint32_t idx = rand() % NUM_SLOTS;
+        double ns = 0;
+        if (slots[idx]) {
+            const double start = now_ns();
+            heap->release(slots[idx]);
+            ns = now_ns() - start;
+            slots[idx] = NULL;
+            is_malloc[i] = false;
+        }
+        else {
+            const size_t size = random_size();
+            const double start = now_ns();
+            slots[idx] = heap->alloc(size);
+            ns = now_ns() - start;
+            result->failed += (NULL == slots[idx]);
+            is_malloc[i] = true;
+        }
+        if (ns < g_op_ns[i]) {
+            g_op_ns[i] = ns;
+        }
+
+        if (last) {
+            if (is_malloc[i]) {
+                result->malloc_ns += g_op_ns[i];
+                result->malloc_max_ns = (g_op_ns[i] > result->malloc_max_ns) ? g_op_ns[i] : result->malloc_max_ns;
+                result->mallocs++;
+            }
+            else {
+                result->free_ns += g_op_ns[i];
+                result->free_max_ns = (g_op_ns[i] > result->free_max_ns) ? g_op_ns[i] : result->free_max_ns;
+                result->frees++;
+            }
+        }
+
+        if (0 == i % 1000) {
+            size_t free_bytes = 0, largest = 0;
+            heap->stats(&free_bytes, &largest);
+            const uint32_t frag = free_bytes ? (uint32_t)(100 - (100 * largest) / free_bytes) : 0;
+            result->frag_sum += frag;
+            result->frag_samples++;
+            result->frag_max = (frag > result->frag_max) ? frag : result->frag_max;
+        }
+    }
+
+    for (i = 0; i < NUM_SLOTS; i++) {
+        heap->release(slots[i]);
+    }
+}
+
+int main(void)
+{
+    const heap_api_t heaps[] = {
+        { "heap_4", pvPortMalloc, vPortFree, heap4_stats },
+        { "TLSF  ", tlsf_alloc_wrapper, tlsf_free_wrapper, tlsf_stats_wrapper },
+    };
+    uint32_t h = 0;
+    uint32_t i = 0;
+
+    tlsf_init(&g_tlsf);
+    tlsf_add_pool(&g_tlsf, g_tlsf_pool1, sizeof(g_tlsf_pool1));
+    tlsf_add_pool(&g_tlsf, g_tlsf_pool2, sizeof(g_tlsf_pool2));
+
+    printf("%u operations, %u live slots, %u KB heap\n", NUM_OPS, NUM_SLOTS, HEAP_BENCHMARK_SIZE / 1024);
+    printf("         malloc avg/max (ns)   free avg/max (ns)   failed   fragmentation avg/max\n");
+    for (h = 0; h < sizeof(heaps) / sizeof(heaps[0]); h++) {
+        heap_result_t r;
+        int rep = 0;
+        for (i = 0; i < NUM_OPS; i++) {
+            g_op_ns[i] = 1e9;
+        }
+        for (rep = 0; rep < NUM_REPEATS; rep++) {
+            run(&heaps[h], &r, 1, (NUM_REPEATS - 1) == rep);
+        }
+        printf("%s  %8.1f / %8.0f   %8.1f / %8.0f   %6.2f%%   %5.1f%% / %u%%\n", heaps[h].name,
+               r.malloc_ns / r.mallocs, r.malloc_max_ns, r.free_ns / r.frees, r.free_max_ns,
+               (100.0 * r.failed) / r.mallocs, r.frag_sum / r.frag_samples, (unsigned)r.frag_max);
+    }
+    return 0;
+}
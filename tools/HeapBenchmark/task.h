@@ -0,0 +1,10 @@
+/*
+ * Minimal FreeRTOS definitions to compile heap_4.c.inc on the host for heap_benchmark.c
+ */
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+#define vTaskSuspendAll()
+#define xTaskResumeAll()    0
+
+#endif /* INC_TASK_H */
@@ -0,0 +1,182 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief RAM-backed stand-ins of the SPI flash and the SD card, @see host_disk.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "host_disk.h"
+#include "disk/diskio.h"
+#include "disk/spi_flash.h"
+#include "disk/sd.h"
+
+
+
+/// A drive of host memory
+typedef struct {
+    uint8_t *mem;               ///< The sectors
+    uint32_t sector_count;      ///< Number of sectors
+    host_disk_stats_t stats;
+} host_disk_t;
+
+static host_disk_t g_disks[2];  ///< driveNumFlashMem and driveNumSdCard
+
+
+
+bool host_disk_init(uint8_t drive, uint32_t size_bytes, const char *image_path)
+{
+    host_disk_t *disk = NULL;
+    void *mem = NULL;
+
+    if (drive >= sizeof(g_disks) / sizeof(g_disks[0]) || 0 != (size_bytes % HOST_DISK_SECTOR_SIZE)) {
+        return false;
+    }
+    disk = &g_disks[drive];
+
+    if (NULL == image_path) {
+        mem = calloc(1, size_bytes);
+    }
+    else {
+        const int fd = open(image_path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0 || 0 != ftruncate(fd, size_bytes)) {
+            perror(image_path);
+            return false;
+        }
+        mem = mmap(NULL, size_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        mem = (MAP_FAILED == mem) ? NULL : mem;
+    }
+
+    disk->mem = (uint8_t*) mem;
+    disk->sector_count = size_bytes / HOST_DISK_SECTOR_SIZE;
+    memset(&disk->stats, 0, sizeof(disk->stats));
+    return (NULL != disk->mem);
+}
+
+host_disk_stats_t host_disk_get_stats(uint8_t drive)
+{
+    return g_disks[drive].stats;
+}
+
+static DRESULT host_disk_read(host_disk_t *disk, uint8_t *data, uint32_t sector, uint32_t count)
+{
+    if (NULL == disk->mem || sector + count > disk->sector_count) {
+        return RES_PARERR;
+    }
+    memcpy(data, disk->mem + (sector * HOST_DISK_SECTOR_SIZE), count * HOST_DISK_SECTOR_SIZE);
+    disk->stats.sectors_read += count;
+    return RES_OK;
+}
+
+static DRESULT host_disk_write(host_disk_t *disk, const uint8_t *data, uint32_t sector, uint32_t count)
+{
+    if (NULL == disk->mem || sector + count > disk->sector_count) {
+        return RES_PARERR;
+    }
+    memcpy(disk->mem + (sector * HOST_DISK_SECTOR_SIZE), data, count * HOST_DISK_SECTOR_SIZE);
+    disk->stats.sectors_written += count;
+    return RES_OK;
+}
+
+static DRESULT host_disk_ioctl(host_disk_t *disk, BYTE ctrl, void *buff)
+{
+    DRESULT status = RES_OK;
+
+    switch (ctrl)
+    {
+        case CTRL_POWER:
+        case CTRL_LOCK:
+        case CTRL_EJECT:
+            break;
+
+        case CTRL_SYNC:
+            disk->stats.syncs++;
+            break;
+
+        case GET_SECTOR_COUNT:
+            *(DWORD*) buff = disk->sector_count;
+            break;
+
+        case GET_SECTOR_SIZE:
+            *(WORD*) buff = HOST_DISK_SECTOR_SIZE;
+            break;
+
+        case GET_BLOCK_SIZE:
+            *(DWORD*) buff = 8;     /* Erase block in sectors, same as a 4K flash block */
+            break;
+
+        default:
+            status = RES_PARERR;
+            break;
+    }
+    return status;
+}
+
+
+
+DSTATUS flash_initialize()
+{
+    return (NULL != g_disks[driveNumFlashMem].mem) ? RES_OK : STA_NOINIT;
+}
+
+DRESULT flash_read_sectors(unsigned char* pData, int sectorNum, int sectorCount)
+{
+    return host_disk_read(&g_disks[driveNumFlashMem], pData, sectorNum, sectorCount);
+}
+
+DRESULT flash_write_sectors(unsigned char* pData, int sectorNum, int sectorCount)
+{
+    return host_disk_write(&g_disks[driveNumFlashMem], pData, sectorNum, sectorCount);
+}
+
+DRESULT flash_ioctl(BYTE ctrl, void *buff)
+{
+    return host_disk_ioctl(&g_disks[driveNumFlashMem], ctrl, buff);
+}
+
+DSTATUS sd_initialize()
+{
+    return (NULL != g_disks[driveNumSdCard].mem) ? RES_OK : STA_NODISK;
+}
+
+DSTATUS sd_status()
+{
+    return sd_initialize();
+}
+
+DRESULT sd_read(BYTE *buff, DWORD sector, BYTE count)
+{
+    return host_disk_read(&g_disks[driveNumSdCard], buff, sector, count);
+}
+
+DRESULT sd_write(const BYTE *buff, DWORD sector, BYTE count)
+{
+    return host_disk_write(&g_disks[driveNumSdCard], buff, sector, count);
+}
+
+DRESULT sd_ioctl(BYTE ctrl, void *buff)
+{
+    return host_disk_ioctl(&g_disks[driveNumSdCard], ctrl, buff);
+}
@@ -0,0 +1,63 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief RAM-backed stand-ins of the SPI flash and the SD card for tools/HostPort
+ *
+ * These replace spi_flash.cpp and sd.c, so disk/diskio.c and FatFs run unchanged.  A
+ * drive is either in memory only, or a memory mapped image file that is kept across
+ * runs and can be inspected on the host (for example with mtools).
+ */
+#ifndef HOST_DISK_H__
+#define HOST_DISK_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+#define HOST_DISK_SECTOR_SIZE   512     ///< Same as the flash and the SD card driver
+
+/**
+ * Creates the drive.  Call this before FatFs uses it.
+ * @param drive       driveNumFlashMem or driveNumSdCard
+ * @param size_bytes  The size of the drive (multiple of HOST_DISK_SECTOR_SIZE)
+ * @param image_path  The image file, or NULL to keep the drive in memory only
+ * @returns true if successful
+ */
+bool host_disk_init(uint8_t drive, uint32_t size_bytes, const char *image_path);
+
+/// Counters of the sector accesses of a drive
+typedef struct {
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t syncs;
+} host_disk_stats_t;
+
+/// @returns the sector counters of the drive
+host_disk_stats_t host_disk_get_stats(uint8_t drive);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* HOST_DISK_H__ */
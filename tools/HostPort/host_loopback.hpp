@@ -0,0 +1,97 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Loopback CharDev stand-in for the CharDev benchmark of tools/HostPort
+ *
+ * The data written is read back from a ring, like a UART with its TX wired to its RX.
+ * Each call locks the ring with a critical section, like the rings of the UART DMA mode,
+ * so the benchmark measures the calls per byte rather than the hardware.  If bulk is
+ * false, read() and write() are the default ones of CharDev that call getChar() and
+ * putChar() for each byte.
+ */
+#ifndef HOST_LOOPBACK_HPP_
+#define HOST_LOOPBACK_HPP_
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "char_dev.hpp"
+
+
+
+class HostLoopback : public CharDev
+{
+    public:
+        HostLoopback(bool bulk) : mBulk(bulk), mHead(0), mTail(0) { }
+
+        /** @{ CharDev interface, these do not wait because the same task writes and reads */
+        bool getChar(char* pInputChar, unsigned int timeout=portMAX_DELAY) { return 1 == pop(pInputChar, 1); }
+        bool putChar(char out, unsigned int timeout=portMAX_DELAY) { return 1 == push(&out, 1); }
+
+        uint32_t read(void *pData, uint32_t len, unsigned int timeout=portMAX_DELAY)
+        {
+            return mBulk ? pop(pData, len) : CharDev::read(pData, len, timeout);
+        }
+        uint32_t write(const void *pData, uint32_t len, unsigned int timeout=portMAX_DELAY)
+        {
+            return mBulk ? push(pData, len) : CharDev::write(pData, len, timeout);
+        }
+        /** @} */
+
+        static const uint32_t size = 1024;  ///< Size of the ring
+
+    private:
+        uint32_t push(const void *pData, uint32_t len)
+        {
+            taskENTER_CRITICAL();
+            const uint32_t space = size - (mHead - mTail);
+            const uint32_t n = (len < space) ? len : space;
+            const uint32_t idx = mHead % size;
+            const uint32_t first = (n < size - idx) ? n : (size - idx);
+            memcpy(mBuf + idx, pData, first);
+            memcpy(mBuf, (const char*) pData + first, n - first);
+            mHead += n;
+            taskEXIT_CRITICAL();
+            return n;
+        }
+
+        uint32_t pop(void *pData, uint32_t len)
+        {
+            taskENTER_CRITICAL();
+            const uint32_t count = mHead - mTail;
+            const uint32_t n = (len < count) ? len : count;
+            const uint32_t idx = mTail % size;
+            const uint32_t first = (n < size - idx) ? n : (size - idx);
+            memcpy(pData, mBuf + idx, first);
+            memcpy((char*) pData + first, mBuf, n - first);
+            mTail += n;
+            taskEXIT_CRITICAL();
+            return n;
+        }
+
+        const bool mBulk;
+        uint32_t mHead, mTail;  ///< Free running write and read counts
+        char mBuf[size];
+};
+
+
+
+#endif /* HOST_LOOPBACK_HPP_ */
@@ -0,0 +1,82 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Common definitions of the peripheral stand-ins of tools/HostPort
+ *
+ * A stand-in is split like its hardware: a host thread plays the device and only
+ * exchanges data through a small FIFO and raises its simulated interrupt, and the
+ * interrupt handler runs on the simulated CPU and uses the FromISR() functions of
+ * FreeRTOS just like the firmware's driver.  Host threads must never call FreeRTOS.
+ */
+#ifndef HOST_PORT_H__
+#define HOST_PORT_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+/// Simulated interrupt numbers of the stand-ins (portHOST_TICK_INTERRUPT is 0)
+typedef enum {
+    host_irq_uart = 1,
+    host_irq_radio = 2,
+} host_irq_t;
+
+/**
+ * Starts the host thread of a device.  The thread never takes the simulated interrupts,
+ * even if it is started from a FreeRTOS task.
+ * @returns true if successful
+ */
+bool host_port_start_thread(void* (*func)(void*), void *arg);
+
+/// Lock-free FIFO between one host thread and the interrupt handler
+typedef struct {
+    uint8_t data[16];               ///< Same depth as the LPC UART FIFO
+    volatile uint32_t write_idx;    ///< Only changed by the producer
+    volatile uint32_t read_idx;     ///< Only changed by the consumer
+} host_fifo_t;
+
+static inline uint32_t host_fifo_count(const host_fifo_t *f)
+{
+    return __atomic_load_n(&f->write_idx, __ATOMIC_ACQUIRE) - __atomic_load_n(&f->read_idx, __ATOMIC_ACQUIRE);
+}
+static inline uint32_t host_fifo_space(const host_fifo_t *f) { return sizeof(f->data) - host_fifo_count(f); }
+
+static inline void host_fifo_put(host_fifo_t *f, uint8_t byte)
+{
+    f->data[f->write_idx % sizeof(f->data)] = byte;
+    __atomic_store_n(&f->write_idx, f->write_idx + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint8_t host_fifo_get(host_fifo_t *f)
+{
+    const uint8_t byte = f->data[f->read_idx % sizeof(f->data)];
+    __atomic_store_n(&f->read_idx, f->read_idx + 1, __ATOMIC_RELEASE);
+    return byte;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* HOST_PORT_H__ */
@@ -0,0 +1,259 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief In-process radio, @see host_radio.h
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+#include <unistd.h>
+
+#include "host_radio.h"
+#include "host_port.h"
+#include "FreeRTOS.h"
+#include "src/nrf24L01Plus.h"
+#include "wireless.h"
+#include "eint.h"
+
+
+
+#define HOST_RADIO_RX_FIFO_SIZE   3     ///< Same as the nordic chip
+#define HOST_RADIO_TX_QUEUE_SIZE  8     ///< Packets on the air at a time
+
+/// Lock-free ring of packets between one host thread and the firmware
+typedef struct {
+    mesh_packet_t pkts[HOST_RADIO_TX_QUEUE_SIZE];
+    volatile uint32_t write_idx;
+    volatile uint32_t read_idx;
+    uint32_t size;                              ///< Number of packets it can hold
+} host_radio_ring_t;
+
+/// A node of the mesh network played by the air thread
+typedef struct {
+    uint8_t addr;
+    uint8_t next_seq_num;
+    uint8_t last_seq_num[256];                  ///< Sequence number of the last packet from each node
+} host_radio_peer_t;
+
+static host_radio_ring_t g_rx = { .size = HOST_RADIO_RX_FIFO_SIZE };
+static host_radio_ring_t g_tx = { .size = HOST_RADIO_TX_QUEUE_SIZE };
+static sem_t g_tx_sem;                          ///< Posted for each packet the firmware sends
+static host_radio_peer_t g_peers[HOST_RADIO_MAX_PEERS];
+static uint8_t g_peer_count = 0;
+static uint32_t g_air_time_us = 0;
+static uint8_t g_loss_percent = 0;
+static host_radio_stats_t g_stats;
+static void_func_t g_irq_callback = NULL;      ///< The nordic interrupt pin callback of wireless.c
+static bool g_started = false;
+
+
+
+static inline uint32_t ring_count(const host_radio_ring_t *r)
+{
+    return __atomic_load_n(&r->write_idx, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->read_idx, __ATOMIC_ACQUIRE);
+}
+
+static bool ring_put(host_radio_ring_t *r, const mesh_packet_t *pkt)
+{
+    if (ring_count(r) >= r->size) {
+        return false;
+    }
+    r->pkts[r->write_idx % r->size] = *pkt;
+    __atomic_store_n(&r->write_idx, r->write_idx + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool ring_get(host_radio_ring_t *r, mesh_packet_t *pkt)
+{
+    if (0 == ring_count(r)) {
+        return false;
+    }
+    *pkt = r->pkts[r->read_idx % r->size];
+    __atomic_store_n(&r->read_idx, r->read_idx + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline bool air_loses_packet(void)
+{
+    return (g_loss_percent > 0 && (rand() % 100) < g_loss_percent);
+}
+
+/// Sends a packet from a peer to the firmware
+static void peer_send(host_radio_peer_t *peer, const mesh_packet_t *orig, mesh_protocol_t type)
+{
+    mesh_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.info.version = MESH_VERSION;
+    pkt.info.retries_rem = orig->info.retries_rem;
+    pkt.info.pkt_type = type;
+    pkt.info.hop_count_max = orig->info.hop_count_max;
+    pkt.info.pkt_seq_num = ++peer->next_seq_num;
+    pkt.info.data_len = orig->info.data_len;
+    memcpy(pkt.data, orig->data, sizeof(pkt.data));
+    pkt.nwk.src = pkt.mac.src = peer->addr;
+    pkt.nwk.dst = orig->nwk.src;
+    pkt.mac.dst = orig->mac.src;
+
+    if (air_loses_packet()) {
+        g_stats.lost++;
+    }
+    else if (!ring_put(&g_rx, &pkt)) {
+        g_stats.rx_overflow++;
+    }
+    else {
+        g_stats.received++;
+        vPortHostRaiseInterrupt(host_irq_radio);
+    }
+}
+
+/// A peer hears a packet sent by the firmware
+static void peer_receive(host_radio_peer_t *peer, const mesh_packet_t *pkt)
+{
+    if (pkt->nwk.dst != peer->addr || (MESH_ZERO_ADDR != pkt->mac.dst && peer->addr != pkt->mac.dst)) {
+        return;
+    }
+
+    /* A retry of a packet we already got is acknowledged again, but not echoed again */
+    const bool duplicate = (peer->last_seq_num[pkt->nwk.src] == pkt->info.pkt_seq_num);
+    peer->last_seq_num[pkt->nwk.src] = pkt->info.pkt_seq_num;
+
+    if (mesh_pkt_ack == pkt->info.pkt_type || mesh_pkt_ack_app == pkt->info.pkt_type) {
+        peer_send(peer, pkt, mesh_pkt_ack_rsp);
+    }
+    else if (mesh_pkt_nack == pkt->info.pkt_type && pkt->info.data_len > 0 && !duplicate) {
+        peer_send(peer, pkt, mesh_pkt_nack);
+    }
+}
+
+/// The air: delivers the packets of the firmware to the peers
+static void* air_thread(void *p)
+{
+    mesh_packet_t pkt;
+    (void) p;
+
+    for (;;) {
+        sem_wait(&g_tx_sem);
+        if (!ring_get(&g_tx, &pkt)) {
+            continue;
+        }
+        if (g_air_time_us > 0) {
+            usleep(g_air_time_us);
+        }
+        if (air_loses_packet()) {
+            g_stats.lost++;
+            continue;
+        }
+        for (uint8_t i = 0; i < g_peer_count; i++) {
+            peer_receive(&g_peers[i], &pkt);
+        }
+    }
+    return NULL;
+}
+
+/// Interrupt of the nordic IRQ pin
+static void host_radio_isr(void)
+{
+    if (g_irq_callback && 0 != ring_count(&g_rx)) {
+        g_irq_callback();
+    }
+}
+
+
+
+bool host_radio_add_peer(uint8_t addr)
+{
+    if (g_peer_count >= HOST_RADIO_MAX_PEERS || MESH_ZERO_ADDR == addr || MESH_BROADCAST_ADDR == addr) {
+        return false;
+    }
+    memset(&g_peers[g_peer_count], 0, sizeof(g_peers[0]));
+    g_peers[g_peer_count].addr = addr;
+    g_peer_count++;
+    return true;
+}
+
+void host_radio_set_air_time_us(uint32_t air_time_us) { g_air_time_us = air_time_us; }
+void host_radio_set_loss_percent(uint8_t percent)     { g_loss_percent = percent; }
+host_radio_stats_t host_radio_get_stats(void)         { return g_stats; }
+
+
+
+/** @{ Nordic functions used by wireless.c */
+char board_io_nordic_irq_sig(void)
+{
+    /* Active low */
+    return (0 == ring_count(&g_rx));
+}
+
+void eint3_enable_port0(uint8_t pin_num, eint_intr_t type, void_func_t func)
+{
+    (void) pin_num;
+    (void) type;
+    g_irq_callback = func;
+    vPortHostSetInterruptHandler(host_irq_radio, host_radio_isr);
+}
+
+void nordic_init(unsigned char payload, unsigned short channel, unsigned short airDataRate)
+{
+    (void) payload;
+    (void) channel;
+    (void) airDataRate;
+
+    if (!g_started) {
+        sem_init(&g_tx_sem, 0, 0);
+        g_started = host_port_start_thread(air_thread, NULL);
+    }
+}
+
+void nordic_mode1_send_single_packet(char *data, unsigned short length)
+{
+    mesh_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    memcpy(&pkt, data, length < sizeof(pkt) ? length : sizeof(pkt));
+
+    /* The packet is lost if too many are on the air already */
+    if (ring_put(&g_tx, &pkt)) {
+        g_stats.sent++;
+        sem_post(&g_tx_sem);
+    }
+    else {
+        g_stats.lost++;
+    }
+}
+
+bool nordic_is_packet_available()
+{
+    return (0 != ring_count(&g_rx));
+}
+
+char nordic_read_rx_fifo(char *data, unsigned short length)
+{
+    mesh_packet_t pkt;
+    if (ring_get(&g_rx, &pkt)) {
+        memcpy(data, &pkt, length < sizeof(pkt) ? length : sizeof(pkt));
+    }
+    return 0;
+}
+
+void nordic_clear_packet_available_flag()   { }
+void nordic_clear_packet_sent_flag()        { }
+void nordic_rx_to_Stanby1()                 { }
+void nordic_standby1_to_rx()                { }
+void nordic_standby1_to_tx_mode1()          { }
+/** @} */
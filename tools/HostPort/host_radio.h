@@ -0,0 +1,70 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief In-process radio for tools/HostPort that replaces the nordic chip of wireless.c
+ *
+ * wireless.c and mesh.c run unchanged on top of the nordic functions of this file.  The
+ * "air" is a host thread that takes the packets the firmware sends, and delivers them
+ * to the peers.  A peer is a simple node of the mesh network that answers its packets :
+ *  - mesh_pkt_ack and mesh_pkt_ack_app are answered with a mesh_pkt_ack_rsp that
+ *    echoes the data, which is what wireless_get_ack_pkt() waits for.
+ *  - mesh_pkt_nack with data is echoed back as a mesh_pkt_nack packet.
+ *
+ * The RX FIFO holds 3 packets like the nordic chip, and its interrupt signal is asserted
+ * while the FIFO is not empty.  Packets can be lost on purpose to exercise the retries
+ * of the mesh network.
+ */
+#ifndef HOST_RADIO_H__
+#define HOST_RADIO_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+#define HOST_RADIO_MAX_PEERS    8
+
+/// Adds a peer node with the given mesh address; @returns true if successful
+bool host_radio_add_peer(uint8_t addr);
+
+/// Sets the time each packet takes on the air (0 by default to run as fast as possible)
+void host_radio_set_air_time_us(uint32_t air_time_us);
+
+/// Sets the percentage of the packets that are lost on the air in each direction
+void host_radio_set_loss_percent(uint8_t percent);
+
+/// Counters of the air
+typedef struct {
+    uint32_t sent;          ///< Packets sent by the firmware
+    uint32_t received;      ///< Packets received by the firmware
+    uint32_t lost;          ///< Packets lost on purpose
+    uint32_t rx_overflow;   ///< Packets dropped because the RX FIFO was full
+} host_radio_stats_t;
+
+host_radio_stats_t host_radio_get_stats(void);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* HOST_RADIO_H__ */
@@ -0,0 +1,210 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Host stand-ins of the system services: uptime, RTC, delays and FreeRTOS hooks
+ *
+ * These replace the code of L0_LowLevel, utilities.c and hooks.c that accesses the LPC
+ * registers.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lpc_sys.h"
+#include "utilities.h"
+#include "rtc.h"
+#include "host_port.h"
+
+
+
+static struct timespec g_boot_time;     ///< Monotonic time the process started
+static time_t g_rtc_offset;             ///< Seconds added to the host time by rtc_settime()
+static rtc_t g_rtc_boot_time;
+
+/// Sets the boot time before main(), same as the firmware's system timer
+__attribute__((constructor)) static void host_sys_init(void)
+{
+    lpc_sys_setup_system_timer();
+    g_rtc_boot_time = rtc_gettime();
+}
+
+void lpc_sys_setup_system_timer(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &g_boot_time);
+}
+
+uint64_t sys_get_uptime_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - g_boot_time.tv_sec) * 1000000ULL +
+           (uint64_t)((now.tv_nsec - g_boot_time.tv_nsec) / 1000);
+}
+
+sys_boot_t sys_get_boot_type() { return boot_power_on; }
+rtc_t sys_get_boot_time()      { return g_rtc_boot_time; }
+
+void sys_set_outchar_func(char_func_t func) { (void) func; }
+void sys_set_inchar_func(char_func_t func)  { (void) func; }
+
+sys_mem_t sys_get_mem_info()
+{
+    sys_mem_t info;
+    const struct mallinfo2 mi = mallinfo2();
+    memset(&info, 0, sizeof(info));
+    info.used_heap = (uint32_t) mi.uordblks;
+    info.avail_heap = (uint32_t) mi.fordblks;
+    return info;
+}
+
+void sys_get_mem_info_str(char buffer[280])
+{
+    const sys_mem_t info = sys_get_mem_info();
+    snprintf(buffer, 280, "Heap used : %u\nHeap avail: %u\n", (unsigned) info.used_heap, (unsigned) info.avail_heap);
+}
+
+
+
+void rtc_init(void)
+{
+}
+
+rtc_t rtc_gettime(void)
+{
+    rtc_t t;
+    struct tm tm;
+    const time_t now = time(NULL) + g_rtc_offset;
+    localtime_r(&now, &tm);
+
+    memset(&t, 0, sizeof(t));
+    t.sec = tm.tm_sec;
+    t.min = tm.tm_min;
+    t.hour = tm.tm_hour;
+    t.dow = tm.tm_wday;
+    t.day = tm.tm_mday;
+    t.month = tm.tm_mon + 1;
+    t.year = tm.tm_year + 1900;
+    t.doy = tm.tm_yday + 1;
+    return t;
+}
+
+void rtc_settime(const rtc_t* rtcstruct)
+{
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_sec = rtcstruct->sec;
+    tm.tm_min = rtcstruct->min;
+    tm.tm_hour = rtcstruct->hour;
+    tm.tm_mday = rtcstruct->day;
+    tm.tm_mon = rtcstruct->month - 1;
+    tm.tm_year = rtcstruct->year - 1900;
+    tm.tm_isdst = -1;
+    g_rtc_offset = mktime(&tm) - time(NULL);
+}
+
+const char* rtc_get_date_time_str(void)
+{
+    static char buffer[32];
+    struct tm tm;
+    const time_t now = time(NULL) + g_rtc_offset;
+    localtime_r(&now, &tm);
+    strftime(buffer, sizeof(buffer), "%a %b %d %H:%M:%S %Y\n", &tm);
+    return buffer;
+}
+
+
+
+void delay_us(unsigned int microsec)
+{
+    /* Busy wait like the firmware, such that the task keeps the CPU */
+    const uint64_t target = sys_get_uptime_us() + microsec;
+    while (sys_get_uptime_us() < target)
+    {
+        ;
+    }
+}
+
+void delay_ms(unsigned int millisec)
+{
+    if (is_freertos_running()) {
+        vTaskDelay(OS_MS(millisec));
+    }
+    else {
+        delay_us(1000 * millisec);
+    }
+}
+
+char is_freertos_running()
+{
+    return (taskSCHEDULER_RUNNING == xTaskGetSchedulerState());
+}
+
+void log_boot_info(const char *pExtraInfo)
+{
+    (void) pExtraInfo;
+}
+
+
+
+bool host_port_start_thread(void* (*func)(void*), void *arg)
+{
+    pthread_t thread;
+    sigset_t signals, old;
+    bool ok;
+
+    /* The thread inherits the blocked interrupt signal */
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, &old);
+    ok = (0 == pthread_create(&thread, NULL, func, arg));
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ok) {
+        pthread_detach(thread);
+    }
+    return ok;
+}
+
+
+
+/// The idle task sleeps until the next interrupt instead of using a whole host CPU
+void vApplicationIdleHook(void)
+{
+    vPortHostWaitForInterrupt();
+}
+
+void vApplicationStackOverflowHook(TaskHandle_t *pxTask, char *pcTaskName)
+{
+    (void) pxTask;
+    fprintf(stderr, "HALTING SYSTEM: Stack overflow by task: %s\n", pcTaskName);
+    abort();
+}
+
+void vApplicationMallocFailedHook(void)
+{
+    fprintf(stderr, "HALTING SYSTEM: Your system ran out of memory (RAM)!\n");
+    abort();
+}
@@ -0,0 +1,221 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "host_uart.hpp"
+#include "lpc_sys.h"
+
+
+
+bool HostUart::init(bool pty, int rxQSize, int txQSize)
+{
+    if (pty) {
+        mFdIn = mFdOut = posix_openpt(O_RDWR | O_NOCTTY);
+        if (mFdIn < 0 || 0 != grantpt(mFdIn) || 0 != unlockpt(mFdIn) ||
+            0 != ptsname_r(mFdIn, mPtyName, sizeof(mPtyName))) {
+            perror("posix_openpt()");
+            return false;
+        }
+
+        /* Raw terminal on the other side, like the serial port of the board */
+        struct termios tio;
+        if (0 == tcgetattr(mFdIn, &tio)) {
+            cfmakeraw(&tio);
+            tcsetattr(mFdIn, TCSANOW, &tio);
+        }
+    }
+
+    if (!mRxQueue) {
+        mRxQueue = xQueueCreate(rxQSize, sizeof(char));
+        mTxQueue = xQueueCreate(txQSize, sizeof(char));
+        vPortHostSetInterruptHandler(host_irq_uart, isr);
+
+        if (!host_port_start_thread(rxThread, this) || !host_port_start_thread(txThread, this)) {
+            return false;
+        }
+    }
+
+    setReady(mRxQueue && mTxQueue);
+    return isReady();
+}
+
+bool HostUart::getChar(char* pInputChar, unsigned int timeout)
+{
+    if (!pInputChar || !mRxQueue) {
+        return false;
+    }
+    else if (taskSCHEDULER_RUNNING == xTaskGetSchedulerState()) {
+        if (!xQueueReceive(mRxQueue, pInputChar, timeout)) {
+            return false;
+        }
+    }
+    else {
+        unsigned int timeout_of_char = sys_get_uptime_ms() + timeout;
+        while (! xQueueReceive(mRxQueue, pInputChar, 0)) {
+            if (sys_get_uptime_ms() > timeout_of_char) {
+                return false;
+            }
+        }
+    }
+
+    /* The queue has space again for the data the interrupt left in the FIFO */
+    if (host_fifo_count(&mRxFifo) > 0) {
+        vPortHostRaiseInterrupt(host_irq_uart);
+    }
+    return true;
+}
+
+bool HostUart::putChar(char out, unsigned int timeout)
+{
+    /* If OS not running, just send data directly and return */
+    if (taskSCHEDULER_RUNNING != xTaskGetSchedulerState()) {
+        mTxBytes++;
+        return (1 == ::write(mFdOut, &out, 1));
+    }
+
+    if (!xQueueSend(mTxQueue, &out, timeout)) {
+        return false;
+    }
+
+    /* If the transmitter is idle, the interrupt fills its FIFO from the queue */
+    if (mTxIdle) {
+        mTxIdle = false;
+        vPortHostRaiseInterrupt(host_irq_uart);
+    }
+    return true;
+}
+
+bool HostUart::flush(void)
+{
+    if (taskSCHEDULER_RUNNING == xTaskGetSchedulerState()) {
+        while (uxQueueMessagesWaiting(mTxQueue) > 0 || host_fifo_count(&mTxFifo) > 0) {
+            vTaskDelay(1);
+        }
+    }
+    return true;
+}
+
+void HostUart::handleInterrupt(void)
+{
+    long higherPriorityTaskWoken = 0;
+    long switchRequired = 0;
+    char c = 0;
+
+    /* Data available; unlike the board, the data stays in the FIFO if the queue is full
+     * such that piped input is not lost, and getChar() raises the interrupt again.
+     */
+    if (host_fifo_count(&mRxFifo) > 0) {
+        while (host_fifo_count(&mRxFifo) > 0 && !xQueueIsQueueFullFromISR(mRxQueue)) {
+            c = host_fifo_get(&mRxFifo);
+            xQueueSendFromISR(mRxQueue, &c, &higherPriorityTaskWoken);
+            if (higherPriorityTaskWoken) {
+                switchRequired = 1;
+            }
+        }
+        sem_post(&mRxFifoRead);
+    }
+
+    /* Transmitter empty: send as many bytes as the FIFO holds */
+    if (0 == host_fifo_count(&mTxFifo)) {
+        unsigned charsSent = 0;
+        while (host_fifo_space(&mTxFifo) > 0 && xQueueReceiveFromISR(mTxQueue, &c, &higherPriorityTaskWoken)) {
+            host_fifo_put(&mTxFifo, c);
+            charsSent++;
+            if (higherPriorityTaskWoken) {
+                switchRequired = 1;
+            }
+        }
+        if (charsSent > 0) {
+            mTxIdle = false;
+            sem_post(&mTxFifoWritten);
+        }
+    }
+
+    portEND_SWITCHING_ISR(switchRequired);
+}
+
+void* HostUart::rxThread(void *p)
+{
+    HostUart *uart = (HostUart*) p;
+    uint8_t buffer[sizeof(uart->mRxFifo.data)];
+
+    for (;;) {
+        while (0 == host_fifo_space(&uart->mRxFifo)) {
+            sem_wait(&uart->mRxFifoRead);
+        }
+
+        const ssize_t count = ::read(uart->mFdIn, buffer, host_fifo_space(&uart->mRxFifo));
+        if (count <= 0) {
+            /* Stop at the end of stdin, such as when the input is piped */
+            break;
+        }
+        for (ssize_t i = 0; i < count; i++) {
+            host_fifo_put(&uart->mRxFifo, buffer[i]);
+        }
+        uart->mRxBytes += count;
+        vPortHostRaiseInterrupt(host_irq_uart);
+    }
+    return NULL;
+}
+
+void* HostUart::txThread(void *p)
+{
+    HostUart *uart = (HostUart*) p;
+    uint8_t buffer[sizeof(uart->mTxFifo.data)];
+
+    for (;;) {
+        sem_wait(&uart->mTxFifoWritten);
+
+        uint32_t count = 0;
+        while (host_fifo_count(&uart->mTxFifo) > count) {
+            buffer[count] = uart->mTxFifo.data[(uart->mTxFifo.read_idx + count) % sizeof(buffer)];
+            count++;
+        }
+        if (count > 0 && ::write(uart->mFdOut, buffer, count) > 0) {
+            uart->mTxBytes += count;
+        }
+        while (count-- > 0) {
+            host_fifo_get(&uart->mTxFifo);
+        }
+
+        /* Transmitter empty interrupt */
+        uart->mTxIdle = true;
+        vPortHostRaiseInterrupt(host_irq_uart);
+    }
+    return NULL;
+}
+
+HostUart::HostUart() : CharDev(),
+        mFdIn(STDIN_FILENO), mFdOut(STDOUT_FILENO),
+        mRxQueue(0), mTxQueue(0),
+        mTxIdle(true), mRxBytes(0), mTxBytes(0)
+{
+    mPtyName[0] = '\0';
+    memset(&mRxFifo, 0, sizeof(mRxFifo));
+    memset(&mTxFifo, 0, sizeof(mTxFifo));
+    sem_init(&mRxFifoRead, 0, 0);
+    sem_init(&mTxFifoWritten, 0, 0);
+}
@@ -0,0 +1,91 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Host stand-in of Uart0 for tools/HostPort
+ *
+ * The UART is either stdin and stdout of the process, or a pseudo terminal that a
+ * terminal program (such as screen or minicom) connects to, like the USB-UART of the
+ * board.  The host threads play the UART hardware with a 16 byte FIFO in each
+ * direction, and handleInterrupt() moves the data between the FIFOs and the FreeRTOS
+ * queues the same way as UartDev::handleInterrupt().
+ */
+#ifndef HOST_UART_HPP_
+#define HOST_UART_HPP_
+
+#include <semaphore.h>
+
+#include "char_dev.hpp"
+#include "singleton_template.hpp"
+#include "host_port.h"
+
+
+
+class HostUart : public CharDev, public SingletonTemplate<HostUart>
+{
+    public:
+        /**
+         * Opens the host side of the UART
+         * @param pty       If true, creates a pseudo terminal, see getPtyName().
+         *                  Otherwise uses stdin and stdout.
+         * @param rxQSize   The size of the receive queue
+         * @param txQSize   The size of the transmit queue
+         */
+        bool init(bool pty, int rxQSize=32, int txQSize=64);
+
+        /// @returns the name of the pseudo terminal to connect to, or NULL if not used
+        const char* getPtyName(void) const { return mPtyName[0] ? mPtyName : NULL; }
+
+        /** @{ CharDev interface, same as UartDev */
+        bool getChar(char* pInputChar, unsigned int timeout=portMAX_DELAY);
+        bool putChar(char out, unsigned int timeout=portMAX_DELAY);
+        bool flush(void);
+        /** @} */
+
+        /// @returns the bytes received by the UART and transmitted by the UART
+        uint32_t getRxCount(void) const { return mRxBytes; }
+        uint32_t getTxCount(void) const { return mTxBytes; }
+
+    private:
+        HostUart();
+        friend class SingletonTemplate<HostUart>;
+
+        static void isr(void) { getInstance().handleInterrupt(); }
+        void handleInterrupt(void);
+
+        static void* rxThread(void *p);     ///< Reads the host into the RX FIFO
+        static void* txThread(void *p);     ///< Writes the TX FIFO to the host
+
+        int mFdIn, mFdOut;                  ///< File descriptors of the host side
+        char mPtyName[64];
+
+        QueueHandle_t mRxQueue;
+        QueueHandle_t mTxQueue;
+        host_fifo_t mRxFifo;                ///< Hardware RX FIFO
+        host_fifo_t mTxFifo;                ///< Hardware TX FIFO
+        sem_t mRxFifoRead;                  ///< Posted by the ISR when it reads the RX FIFO
+        sem_t mTxFifoWritten;               ///< Posted by the ISR when it writes the TX FIFO
+        volatile bool mTxIdle;              ///< The TX FIFO is empty, so putChar() has to kick the ISR
+        volatile uint32_t mRxBytes;
+        volatile uint32_t mTxBytes;
+};
+
+
+
+#endif /* HOST_UART_HPP_ */
@@ -0,0 +1,63 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Host stand-in of L4_IO/bio.h for tools/HostPort
+ *
+ * The pins of the SPI devices do nothing, and the nordic interrupt signal comes from
+ * the in-process radio (host_radio.c).
+ */
+#ifndef BIO_H__
+#define BIO_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/** @{ Board Pin defines */
+#define BIO_FLASH_CS_P0PIN      6   ///< P0.6
+#define BIO_NORDIC_CS_P0PIN     16  ///< P0.16
+#define BIO_NORDIC_IRQ_P0PIN    22  ///< P0.22
+#define BIO_NORDIC_CE_P1PIN     24  ///< P1.24
+#define BIO_LIGHT_ADC_CH_NUM    2   ///< ADC0.2
+#define BIO_SD_CARD_CS_P1PIN    25  ///< P1.25
+#define BIO_SD_CARD_CD_P1PIN    26  ///< P1.26
+/** @} */
+
+static inline char board_io_flash_cs(void)  { return 1; }
+static inline char board_io_flash_ds(void)  { return 0; }
+static inline char board_io_sd_cs(void)     { return 1; }
+static inline char board_io_sd_ds(void)     { return 0; }
+
+static inline char board_io_nordic_cs(void)      { return 1; }
+static inline char board_io_nordic_ds(void)      { return 0; }
+char board_io_nordic_irq_sig(void);              ///< Active low, @see host_radio.c
+static inline char board_io_sd_card_cd_sig(void) { return 0; }
+static inline void board_io_nordic_ce_high(void) { }
+static inline void board_io_nordic_ce_low (void) { }
+
+static inline void board_io_pins_initialize(void) { }
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BIO_H__ */
@@ -0,0 +1,101 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Host stand-in of L0_LowLevel/lpc_sys.h for tools/HostPort
+ *
+ * Same API as the firmware, except that there is no watchdog, and a reboot exits the
+ * process.  The uptime is the time since the process started.
+ */
+#ifndef LPC_SYS_H__
+#define LPC_SYS_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "rtc.h"
+#include "sys_config.h"
+
+
+
+/// Enumeration of the reboot type
+typedef enum {
+    boot_unknown  = 0,
+    boot_power_on = 1,      ///< Cold boot (power on)
+    boot_reset    = 2,      ///< Boot after reset condition
+    boot_watchdog = 4,      ///< Boot after watchdog reset (intentional)
+    boot_watchdog_recover,  ///< Boot after watchdog reset after an error (or crash)
+    boot_brown_out          ///< Boot after under-voltage
+} sys_boot_t;
+
+/// @see lpc_sys.h of the firmware; only the heap fields are filled on the host
+typedef struct
+{
+    uint32_t used_global; ///< Global Memory allocated
+    uint32_t used_heap;   ///< Memory granted by Heap (malloc, new etc.)
+    uint32_t avail_heap;  ///< Memory available at Heap
+    uint32_t avail_sys;   ///< Memory available to Heap (from sbrk function)
+
+    uint32_t num_sbrk_calls;  ///< Number of calls to the sbrk() function
+    uint32_t last_sbrk_size;  ///< Last size requested from the sbrk() function
+    void*    last_sbrk_ptr;   ///< Last pointer given by the sbrk() function
+    void*    next_malloc_ptr; ///< The next pointer that will be returned to malloc() from sbrk()
+} sys_mem_t;
+
+/** Void function pointer */
+typedef void (*void_func_t)(void);
+
+/** Function pointer of a function returning a char and taking a char as parameter */
+typedef char (*char_func_t)(char);
+
+
+
+sys_boot_t sys_get_boot_type();  ///< @returns boot_power_on
+rtc_t      sys_get_boot_time();  ///< @returns the time the process started
+
+/** @{ printf() and scanf() use stdin and stdout of the process, so these are not used */
+void sys_set_outchar_func(char_func_t func);
+void sys_set_inchar_func(char_func_t func);
+/** @} */
+
+void lpc_sys_setup_system_timer(void);  ///< Starts the uptime
+
+/// @returns the system up time in microseconds
+uint64_t sys_get_uptime_us(void);
+
+/// @returns the system up time in milliseconds.
+static inline uint64_t sys_get_uptime_ms(void) { return sys_get_uptime_us() / 1000; }
+
+sys_mem_t sys_get_mem_info();               ///< @returns the heap usage from mallinfo()
+void sys_get_mem_info_str(char buffer[280]);
+
+static inline void sys_watchdog_feed()      { }
+static inline void sys_watchdog_enable()    { }
+static inline void sys_reboot()             { exit(0); }
+static inline void sys_reboot_abnormal(void){ abort(); }
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LPC_SYS_H__ */
@@ -0,0 +1,44 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Host stand-in of L2_Drivers/ssp0.h for tools/HostPort
+ *
+ * The devices on the SPI bus are replaced as a whole (host_disk.c and host_radio.c), so
+ * the bus itself does nothing.
+ */
+#ifndef SPI0_H__
+#define SPI0_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+static inline void ssp0_init(unsigned int max_clock_mhz)           { (void) max_clock_mhz; }
+static inline void ssp0_set_max_clock(unsigned int max_clock_mhz)  { (void) max_clock_mhz; }
+static inline char ssp0_exchange_byte(char out)                    { (void) out; return (char) 0xFF; }
+static inline void ssp0_exchange_data(void *data, int len)         { (void) data; (void) len; }
+
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* SPI0_H__ */
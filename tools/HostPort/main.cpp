@@ -0,0 +1,397 @@
+/*
+ *     SocialLedge.com - Copyright (C) 2013
+ *
+ *     This file is part of free software framework for embedded processors.
+ *     You can use it and/or distribute it as long as this copyright header
+ *     remains unmodified.  The code is free for personal use and requires
+ *     permission to use in a commercial product.
+ *
+ *      THIS SOFTWARE IS PROVIDED "AS IS".  NO WARRANTIES, WHETHER EXPRESS, IMPLIED
+ *      OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+ *      MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE.
+ *      I SHALL NOT, IN ANY CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR
+ *      CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
+ *
+ *     You can reach the author of this software at :
+ *          p r e e t . w i k i @ g m a i l . c o m
+ */
+
+/**
+ * @file
+ * @brief Runs the firmware on a Linux host with the POSIX FreeRTOS port
+ *
+ * The scenario has the same tasks as the board : the file logger writes to the flash
+ * drive (a RAM disk, or an image file), the wireless task runs the mesh network over
+ * the in-process radio, and a host terminal runs commands over the host UART.
+ *
+ * With --bench, a task sends packets that require an ACK to a peer and logs each of
+ * them, then prints the rates and exits.  This is what to run with perf.
+ *
+ * With --chardev-bench, a task moves data through a loopback CharDev one byte at a time,
+ * and with the bulk read() and write() calls, then prints the rates and exits.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "scheduler_task.hpp"
+#include "command_handler.hpp"
+#include "file_logger.h"
+#include "storage.hpp"
+#include "wireless.h"
+#include "lpc_sys.h"
+#include "sched_trace.h"
+
+#include "host_uart.hpp"
+#include "host_loopback.hpp"
+#include "host_disk.h"
+#include "host_radio.h"
+
+
+
+static const uint8_t g_peer_addr = 200;     ///< Address of the peer that echoes our packets
+
+/// Host settings from the command line
+typedef struct {
+    bool pty;                   ///< Terminal on a pseudo terminal instead of stdin/stdout
+    uint32_t bench_pkts;        ///< Packets sent by the benchmark, or 0 to run the terminal
+    uint32_t chardev_bench_kb;  ///< KB moved by the CharDev benchmark, or 0 to not run it
+    const char *flash_image;    ///< Image file of the flash drive, or NULL for a RAM disk
+} host_args_t;
+
+/// Sends a packet that requires an ACK to the peer; @returns true if the ACK was received
+static bool host_ping(uint8_t addr, uint32_t n)
+{
+    mesh_packet_t pkt;
+    wireless_flush_rx();
+    if (!wireless_send(addr, mesh_pkt_ack, &n, sizeof(n), 0)) {
+        return false;
+    }
+    return wireless_get_ack_pkt(&pkt, 100) && 0 == memcmp(pkt.data, &n, sizeof(n));
+}
+
+
+
+CMD_HANDLER_FUNC(pingHandler)
+{
+    int addr = g_peer_addr, count = 1, ok = 0;
+    cmdParams.scanf("%i %i", &addr, &count);
+
+    const uint64_t start = sys_get_uptime_us();
+    for (int i = 0; i < count; i++) {
+        ok += host_ping(addr, i);
+    }
+    output.printf("%i/%i ACKs from %i in %u us\n", ok, count, addr, (unsigned)(sys_get_uptime_us() - start));
+    return true;
+}
+
+CMD_HANDLER_FUNC(radioHandler)
+{
+    const host_radio_stats_t s = host_radio_get_stats();
+    output.printf("Sent %u, received %u, lost %u, RX overflow %u\n",
+                  (unsigned)s.sent, (unsigned)s.received, (unsigned)s.lost, (unsigned)s.rx_overflow);
+    return true;
+}
+
+CMD_HANDLER_FUNC(diskHandler)
+{
+    const host_disk_stats_t s = host_disk_get_stats(driveNumFlashMem);
+    output.printf("Flash: %u sectors read, %u sectors written, %u syncs\n",
+                  (unsigned)s.sectors_read, (unsigned)s.sectors_written, (unsigned)s.syncs);
+    return true;
+}
+
+CMD_HANDLER_FUNC(logHandler)
+{
+    LOG_INFO("%s", cmdParams());
+    LOG_FLUSH();
+    output.printf("Logged to %s\n", FILE_LOGGER_FILENAME);
+    return true;
+}
+
+#if SYS_CFG_SCHED_TRACE
+static uint32_t host_sched_trace_time_us(void) { return (uint32_t) sys_get_uptime_us(); }
+
+static void host_sched_trace_write(const void *data, uint32_t len, void *arg)
+{
+    fwrite(data, 1, len, (FILE*) arg);
+}
+
+CMD_HANDLER_FUNC(traceHandler)
+{
+    FILE *file = fopen(cmdParams(), "wb");
+    if (!file) {
+        output.printf("Unable to open '%s'\n", cmdParams());
+        return true;
+    }
+    const uint32_t count = sched_trace_save(host_sched_trace_write, file);
+    fclose(file);
+    output.printf("Saved %u events (%u overwritten) to %s\n", (unsigned)count,
+                  (unsigned)sched_trace_get_lost(), cmdParams());
+    return true;
+}
+#endif
+
+CMD_HANDLER_FUNC(exitHandler)
+{
+    LOG_FLUSH();
+    vTaskDelay(100);
+    vTaskEndScheduler();
+    return true;
+}
+
+
+
+/// The wireless task of tasks.hpp, which cannot be included because of the board sensors
+class hostWirelessTask : public scheduler_task
+{
+    public:
+        hostWirelessTask(uint8_t priority) : scheduler_task("wireless", 512, priority) { }
+        bool run(void *p)
+        {
+            wireless_service();
+            return true;
+        }
+};
+
+/// The terminal of terminal.cpp with the commands that make sense on the host
+class hostTerminalTask : public scheduler_task
+{
+    public:
+        hostTerminalTask(uint8_t priority) : scheduler_task("terminal", 1024, priority), mCmd(128) { }
+
+        bool init(void)
+        {
+            mCmdProc.addHandler(pingHandler,  "ping",  "'ping <addr> <count>' : Sends packets that require an ACK");
+            mCmdProc.addHandler(radioHandler, "radio", "Prints the counters of the in-process radio");
+            mCmdProc.addHandler(diskHandler,  "disk",  "Prints the sector counters of the flash drive");
+            mCmdProc.addHandler(logHandler,   "log",   "'log <msg>' : Logs a message to the file logger");
+            #if SYS_CFG_SCHED_TRACE
+            mCmdProc.addHandler(traceHandler, "trace", "'trace <file>' : Saves the scheduling trace to a host file");
+            #endif
+            mCmdProc.addHandler(exitHandler,  "exit",  "Stops the scheduler and exits");
+            return true;
+        }
+
+        bool run(void *p)
+        {
+            HostUart& uart = HostUart::getInstance();
+            char line[128];
+
+            uart.put("LPC: ");
+            uart.flush();
+            if (uart.gets(line, sizeof(line))) {
+                mCmd = line;
+                if (mCmd.getLen() > 0) {
+                    mCmdProc.handleCommand(mCmd, uart);
+                }
+                uart.flush();
+            }
+            else {
+                /* EOF of the host side, so wait for the pty to be opened again */
+                vTaskDelay(100);
+            }
+            return true;
+        }
+
+    private:
+        CommandProcessor mCmdProc;
+        str mCmd;
+};
+
+/// Sends packets to the peer and logs each of them, then prints the rates and exits
+class hostBenchTask : public scheduler_task
+{
+    public:
+        hostBenchTask(uint8_t priority, uint32_t pkts) : scheduler_task("bench", 1024, priority), mPkts(pkts) { }
+
+        bool run(void *p)
+        {
+            uint32_t acks = 0;
+            const uint64_t start = sys_get_uptime_us();
+
+            for (uint32_t i = 0; i < mPkts; i++) {
+                const bool ok = host_ping(g_peer_addr, i);
+                acks += ok;
+                LOG_INFO("Packet %u to %u : %s", (unsigned)i, (unsigned)g_peer_addr, ok ? "ACK" : "no ACK");
+            }
+
+            const double sec = (sys_get_uptime_us() - start) / 1e6;
+            LOG_FLUSH();
+            vTaskDelay(100);
+
+            const host_radio_stats_t r = host_radio_get_stats();
+            const host_disk_stats_t d = host_disk_get_stats(driveNumFlashMem);
+            printf("Packets   : %u/%u ACKs in %.3f sec (%.0f packets/sec)\n",
+                   (unsigned)acks, (unsigned)mPkts, sec, mPkts / sec);
+            printf("Radio     : sent %u, received %u, lost %u\n", (unsigned)r.sent, (unsigned)r.received, (unsigned)r.lost);
+            printf("Logger    : %u messages, %u blocked calls, %u ms highest write time\n",
+                   (unsigned)logger_get_logged_call_count(log_info), (unsigned)logger_get_blocked_call_count(),
+                   (unsigned)logger_get_highest_file_write_time_ms());
+            printf("Flash     : %u sectors written, %u syncs\n", (unsigned)d.sectors_written, (unsigned)d.syncs);
+
+            vTaskEndScheduler();
+            return false;
+        }
+
+    private:
+        const uint32_t mPkts;
+};
+
+
+/// Moves data through a loopback CharDev with each of the APIs, then prints the rates and exits
+class hostCharDevBenchTask : public scheduler_task
+{
+    public:
+        hostCharDevBenchTask(uint8_t priority, uint32_t kb) : scheduler_task("cdbench", 1024, priority), mKb(kb) { }
+
+        bool run(void *p)
+        {
+            HostLoopback perChar(false), defaultBulk(false), bulk(true);
+
+            printf("CharDev loopback of %u KB in blocks of %u bytes:\n", (unsigned)mKb, (unsigned)sizeof(mTx));
+            report("getChar() and putChar()", measure(perChar, true));
+            report("CharDev read() and write()", measure(defaultBulk, false));
+            report("Bulk read() and write()", measure(bulk, false));
+
+            vTaskEndScheduler();
+            return false;
+        }
+
+    private:
+        /// @returns the bytes per second, or 0 if the data read back was not the data written
+        double measure(HostLoopback &dev, bool perChar)
+        {
+            const uint32_t blocks = mKb * 1024 / sizeof(mTx);
+            bool ok = true;
+
+            const uint64_t start = sys_get_uptime_us();
+            for (uint32_t b = 0; b < blocks; b++) {
+                memset(mTx, 'a' + (b % 26), sizeof(mTx));
+                if (perChar) {
+                    for (uint32_t i = 0; i < sizeof(mTx); i++) {
+                        dev.putChar(mTx[i], 0);
+                    }
+                    for (uint32_t i = 0; i < sizeof(mRx); i++) {
+                        dev.getChar(&mRx[i], 0);
+                    }
+                }
+                else {
+                    dev.write(mTx, sizeof(mTx), 0);
+                    dev.read(mRx, sizeof(mRx), 0);
+                }
+                ok = ok && (0 == memcmp(mTx, mRx, sizeof(mTx)));
+            }
+            const double sec = (sys_get_uptime_us() - start) / 1e6;
+
+            return ok ? (2.0 * blocks * sizeof(mTx) / sec) : 0;
+        }
+
+        static void report(const char *name, double bytesPerSec)
+        {
+            printf("  %-28s : %8.2f MB/sec%s\n", name, bytesPerSec / (1024 * 1024), bytesPerSec ? "" : " (data error)");
+        }
+
+        const uint32_t mKb;
+        char mTx[256];
+        char mRx[256];
+};
+
+
+
+static void host_parse_args(int argc, char **argv, host_args_t *args)
+{
+    memset(args, 0, sizeof(*args));
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--pty")) {
+            args->pty = true;
+        }
+        else if (0 == strcmp(argv[i], "--bench") && i + 1 < argc) {
+            args->bench_pkts = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "--chardev-bench") && i + 1 < argc) {
+            args->chardev_bench_kb = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "--loss") && i + 1 < argc) {
+            host_radio_set_loss_percent(atoi(argv[++i]));
+        }
+        else if (0 == strcmp(argv[i], "--air-us") && i + 1 < argc) {
+            host_radio_set_air_time_us(atoi(argv[++i]));
+        }
+        else if (0 == strcmp(argv[i], "--flash") && i + 1 < argc) {
+            args->flash_image = argv[++i];
+        }
+        else {
+            printf("Usage: %s [--pty] [--bench <packets>] [--chardev-bench <KB>] [--loss <percent>] [--air-us <us>] [--flash <image>]\n", argv[0]);
+            exit(1);
+        }
+    }
+}
+
+/// Mounts the flash drive like high_level_init(), and formats it if it is new
+static bool host_mount_flash(void)
+{
+    FileSystemObject& flash = Storage::getFlashDrive();
+    if (FR_OK == flash.mount()) {
+        return true;
+    }
+    printf("Formatting the flash drive ... ");
+    const bool ok = (FR_OK == flash.format() && FR_OK == flash.mount());
+    puts(ok ? "Done" : "Error");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    host_args_t args;
+    host_parse_args(argc, argv, &args);
+
+    /* printf() of the tasks is unbuffered, like the UART of the board */
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    if (!host_disk_init(driveNumFlashMem, 2 * 1024 * 1024, args.flash_image) ||
+        !host_disk_init(driveNumSdCard, 8 * 1024 * 1024, NULL)) {
+        puts("ERROR: Failed to create the disks");
+        return 1;
+    }
+    if (!host_mount_flash()) {
+        return 1;
+    }
+
+    host_radio_add_peer(g_peer_addr);
+    if (!wireless_init()) {
+        puts("ERROR: Failed to initialize wireless");
+        return 1;
+    }
+
+    #if SYS_CFG_SCHED_TRACE
+    static sched_trace_rec_t sched_trace_recs[SCHED_TRACE_SIZE];
+    sched_trace_init(sched_trace_recs, SCHED_TRACE_SIZE, host_sched_trace_time_us);
+    #endif
+
+    logger_init(PRIORITY_LOW);
+    scheduler_add_task(new hostWirelessTask(PRIORITY_CRITICAL));
+
+    if (args.bench_pkts > 0) {
+        scheduler_add_task(new hostBenchTask(PRIORITY_MEDIUM, args.bench_pkts));
+    }
+    else if (args.chardev_bench_kb > 0) {
+        scheduler_add_task(new hostCharDevBenchTask(PRIORITY_MEDIUM, args.chardev_bench_kb));
+    }
+    else {
+        HostUart& uart = HostUart::getInstance();
+        if (!uart.init(args.pty)) {
+            puts("ERROR: Failed to open the host UART");
+            return 1;
+        }
+        if (uart.getPtyName()) {
+            printf("Terminal is at %s\n", uart.getPtyName());
+        }
+        scheduler_add_task(new hostTerminalTask(PRIORITY_HIGH));
+    }
+
+    scheduler_start();
+    return 0;
+}
@@ -0,0 +1,217 @@
+"""
+Converts the scheduling trace of the firmware (SYS_CFG_SCHED_TRACE) to Chrome trace JSON.
+
+Save the trace on the board with the "trace save trace.bin" terminal command, copy the file,
+then convert it and open the JSON with chrome://tracing or https://ui.perfetto.dev
+
+    python sched_trace_to_json.py trace.bin -o trace.json
+
+Each task is a thread that shows when it ran and when it blocked, and each ISR is a thread
+that shows when it ran.  An arrow goes from the ISR (or task) that made a task ready to the
+time that the task ran, so the length of the arrow is the wake-up latency.
+
+The file format is documented in firmware/lib/L3_Utils/sched_trace.h
+"""
+from __future__ import print_function
+
+import argparse
+import json
+import struct
+import sys
+
+EVENTS = ['none', 'switch_in', 'ready', 'isr_enter', 'isr_exit', 'block_recv', 'block_send',
+          'block_delay', 'block_notify', 'mark', 'begin', 'end']
+(NONE, SWITCH_IN, READY, ISR_ENTER, ISR_EXIT, BLOCK_RECV, BLOCK_SEND,
+ BLOCK_DELAY, BLOCK_NOTIFY, MARK, BEGIN, END) = range(len(EVENTS))
+
+HEADER_SIZE = 16
+NAME_LEN = 8
+ISR_TID = 1000          # Thread id of an ISR is this plus its exception number
+EXCEPTION_NAMES = {11: 'SVCall', 14: 'PendSV', 15: 'SysTick'}
+PID = 1
+
+
+def parse(data):
+    """ Returns the task names, marker names, lost count and records (time, type, id, arg) of a trace file """
+    if data[0:4] != b'STRC':
+        raise ValueError('Not a scheduling trace file')
+    version, rec_size, num_tasks, num_markers, count, lost = struct.unpack_from('<BBBBII', data, 4)
+    if version != 1 or rec_size != 8:
+        raise ValueError('Unsupported version %u or record size %u' % (version, rec_size))
+
+    def name_at(i):
+        raw = data[HEADER_SIZE + i * NAME_LEN:HEADER_SIZE + (i + 1) * NAME_LEN]
+        return raw.split(b'\x00')[0].decode('ascii', 'replace')
+
+    tasks = dict((i + 1, name_at(i)) for i in range(num_tasks))
+    markers = dict((i, name_at(num_tasks + i)) for i in range(num_markers) if name_at(num_tasks + i))
+
+    pos = HEADER_SIZE + (num_tasks + num_markers) * NAME_LEN
+    count = min(count, (len(data) - pos) // rec_size)
+    records = [struct.unpack_from('<IBBH', data, pos + i * rec_size) for i in range(count)]
+    return tasks, markers, lost, records
+
+
+def unwrap_times(records):
+    """
+    Returns the records with 64-bit times starting at zero, sorted by time.  The 32-bit time
+    wraps every 71 minutes and records may be slightly out of order if an ISR preempted the
+    writer of a record, so each time is the signed difference from the previous one.
+    """
+    out = []
+    prev = records[0][0] if records else 0
+    now = 0
+    for raw, typ, id, arg in records:
+        delta = (raw - prev) & 0xFFFFFFFF
+        if delta >= 0x80000000:
+            delta -= 0x100000000
+        now += delta
+        prev = raw
+        out.append((now, typ, id, arg))
+
+    # Stable sort keeps the order of records with the same time
+    out.sort(key=lambda r: r[0])
+    start = out[0][0] if out else 0
+    return [(t - start, typ, id, arg) for t, typ, id, arg in out]
+
+
+class Converter(object):
+    """ Tracks the running task and the ISRs to turn the records into trace events """
+
+    def __init__(self, tasks, markers):
+        self.tasks = tasks
+        self.markers = markers
+        self.events = []
+        self.threads = {}
+        self.running = None         # (task id, switched in time)
+        self.isr_stack = []         # (exception number, enter time)
+        self.pending_flows = {}     # Task id to the flow id from the readier
+        self.flow_id = 0
+
+    def task_tid(self, task_id):
+        self.threads[task_id] = self.tasks.get(task_id, 'task %u' % task_id if task_id else 'unknown')
+        return task_id
+
+    def isr_tid(self, exception):
+        if exception in EXCEPTION_NAMES:
+            name = EXCEPTION_NAMES[exception]
+        else:
+            name = 'IRQ %u' % (exception - 16)
+        self.threads[ISR_TID + exception] = name
+        return ISR_TID + exception
+
+    def context_tid(self):
+        """ Returns the thread of the code that runs now: the innermost ISR, or the running task """
+        if self.isr_stack:
+            return self.isr_tid(self.isr_stack[-1][0])
+        return self.task_tid(self.running[0] if self.running else 0)
+
+    def add(self, ph, name, tid, ts, **kwargs):
+        event = {'ph': ph, 'name': name, 'pid': PID, 'tid': tid, 'ts': ts}
+        event.update(kwargs)
+        self.events.append(event)
+
+    def add_isr(self, exception, start, now):
+        tid = self.isr_tid(exception)
+        self.add('X', self.threads[tid], tid, start, dur=now - start, cat='isr')
+
+    def end_running(self, now):
+        if self.running:
+            task_id, start = self.running
+            tid = self.task_tid(task_id)
+            self.add('X', self.threads[tid], tid, start, dur=now - start, cat='task')
+            self.running = None
+
+    def record(self, now, typ, id, arg):
+        if typ == SWITCH_IN:
+            self.end_running(now)
+            self.running = (id, now)
+            tid = self.task_tid(id)
+            if id in self.pending_flows:
+                self.add('f', 'wake', tid, now, id=self.pending_flows.pop(id), cat='wake', bp='e')
+
+        elif typ == READY:
+            if arg:
+                tid = self.isr_tid(arg)
+                if not any(exc == arg for exc, _ in self.isr_stack):
+                    # SysTick and PendSV are not traced, so give the flow a slice to start from
+                    self.add('X', self.threads[tid], tid, now, dur=1, cat='isr')
+            else:
+                tid = self.context_tid()
+            self.flow_id += 1
+            self.pending_flows[id] = self.flow_id
+            self.add('i', 'ready ' + self.tasks.get(id, str(id)), tid, now, s='t', cat='ready')
+            self.add('s', 'wake', tid, now, id=self.flow_id, cat='wake')
+
+        elif typ == ISR_ENTER:
+            self.isr_stack.append((id + 16, now))
+
+        elif typ == ISR_EXIT:
+            # Pop to the matching ISR in case the oldest records of the trace were overwritten
+            while self.isr_stack:
+                exception, start = self.isr_stack.pop()
+                self.add_isr(exception, start, now)
+                if exception == id + 16:
+                    break
+
+        elif typ in (BLOCK_RECV, BLOCK_SEND):
+            queue = (id << 16) | arg
+            self.add('i', EVENTS[typ], self.context_tid(), now, s='t', cat='block',
+                     args={'queue': '0x%06x' % queue})
+
+        elif typ == BLOCK_DELAY:
+            self.add('i', EVENTS[typ], self.context_tid(), now, s='t', cat='block', args={'ticks': arg})
+
+        elif typ == BLOCK_NOTIFY:
+            self.add('i', EVENTS[typ], self.context_tid(), now, s='t', cat='block')
+
+        elif typ in (MARK, BEGIN, END):
+            name = self.markers.get(id, 'marker %u' % id)
+            ph = {MARK: 'i', BEGIN: 'B', END: 'E'}[typ]
+            extra = {'s': 't'} if typ == MARK else {}
+            self.add(ph, name, self.context_tid(), now, cat='marker', args={'value': arg}, **extra)
+
+    def finish(self, now):
+        self.end_running(now)
+        while self.isr_stack:
+            exception, start = self.isr_stack.pop()
+            self.add_isr(exception, start, now)
+
+
+def convert(data):
+    """ Returns the Chrome trace JSON object of a trace file """
+    tasks, markers, lost, records = parse(data)
+    conv = Converter(tasks, markers)
+    records = unwrap_times(records)
+    for now, typ, id, arg in records:
+        if NONE < typ < len(EVENTS):
+            conv.record(now, typ, id, arg)
+    conv.finish(records[-1][0] if records else 0)
+
+    meta = [{'ph': 'M', 'name': 'process_name', 'pid': PID, 'tid': 0,
+             'args': {'name': 'Firmware (%u events, %u overwritten)' % (len(records), lost)}}]
+    for tid, name in sorted(conv.threads.items()):
+        meta.append({'ph': 'M', 'name': 'thread_name', 'pid': PID, 'tid': tid, 'args': {'name': name}})
+        meta.append({'ph': 'M', 'name': 'thread_sort_index', 'pid': PID, 'tid': tid, 'args': {'sort_index': tid}})
+
+    return {'traceEvents': meta + conv.events, 'displayTimeUnit': 'ns'}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Scheduling trace to Chrome trace JSON converter')
+    parser.add_argument('trace', help='Trace file saved by the "trace save" command')
+    parser.add_argument('-o', '--output', help='Output JSON file (default is stdout)')
+    args = parser.parse_args()
+
+    with open(args.trace, 'rb') as f:
+        trace = convert(f.read())
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
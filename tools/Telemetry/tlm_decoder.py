@@ -0,0 +1,162 @@
+"""
+Converts the binary telemetry stream to CSV or JSON.
+
+The binary stream has one schema frame with the names, types and sizes of the variables,
+and then a values frame for each time the telemetry was streamed.  Each values frame
+becomes one row of the CSV, or one object of the JSON list.
+
+    python tlm_decoder.py tlm.bin -f csv > tlm.csv
+    python tlm_decoder.py tlm.bin -f json > tlm.json
+
+The stream format is documented in firmware/lib/L3_Utils/tlm/c_tlm_stream.h
+"""
+from __future__ import print_function
+
+import argparse
+import binascii
+import csv
+import json
+import struct
+import sys
+
+SCHEMA_FRAME = 0xF1
+VALUES_FRAME = 0xF2
+FRAME_HDR_SIZE = 5
+
+# tlm_type of c_tlm_var.h
+TLM_INT, TLM_UINT, TLM_CHAR, TLM_FLOAT, TLM_DOUBLE, TLM_STRING, TLM_BINARY, TLM_BOOL = range(1, 9)
+
+INT_FMT = {1: 'b', 2: 'h', 4: 'i', 8: 'q'}
+UINT_FMT = {1: 'B', 2: 'H', 4: 'I', 8: 'Q'}
+
+
+class Reader(object):
+    """ Reads little endian numbers and strings from a buffer """
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def read(self, fmt):
+        values = struct.unpack_from('<' + fmt, self.data, self.pos)
+        self.pos += struct.calcsize('<' + fmt)
+        return values[0] if len(values) == 1 else values
+
+    def read_name(self):
+        length = self.read('B')
+        name = self.data[self.pos:self.pos + length].decode('ascii', 'replace')
+        self.pos += length
+        return name
+
+
+class Variable(object):
+    """ A variable of the schema """
+
+    def __init__(self, comp, name, tlm_type, elm_size, arr_size):
+        self.name = comp + '.' + name
+        self.type = tlm_type
+        self.elm_size = elm_size
+        self.arr_size = arr_size
+        self.size = elm_size * arr_size
+
+    def decode(self, data):
+        """ Returns the value of the variable, which is a list if it is an array """
+        if self.type == TLM_STRING:
+            return data.split(b'\0', 1)[0].decode('ascii', 'replace')
+        if self.type == TLM_BINARY:
+            return binascii.hexlify(data).decode('ascii')
+
+        fmt = None
+        if self.type == TLM_INT:
+            fmt = INT_FMT.get(self.elm_size)
+        elif self.type in (TLM_UINT, TLM_CHAR, TLM_BOOL):
+            fmt = UINT_FMT.get(self.elm_size)
+        elif self.type == TLM_FLOAT and self.elm_size == 4:
+            fmt = 'f'
+        elif self.type == TLM_DOUBLE and self.elm_size == 8:
+            fmt = 'd'
+        if fmt is None:
+            return binascii.hexlify(data).decode('ascii')
+
+        values = list(struct.unpack('<%i%s' % (self.arr_size, fmt), data))
+        if self.type == TLM_CHAR:
+            values = [chr(v) for v in values]
+        elif self.type == TLM_BOOL:
+            values = [v != 0 for v in values]
+        return values[0] if self.arr_size == 1 else values
+
+
+def parse_schema(payload):
+    """ Returns the list of variables of the schema frame """
+    r = Reader(payload)
+    variables = []
+    for _ in range(r.read('H')):
+        comp = r.read_name()
+        for _ in range(r.read('H')):
+            name = r.read_name()
+            tlm_type, elm_size, arr_size = r.read('BHH')
+            variables.append(Variable(comp, name, tlm_type, elm_size, arr_size))
+    return variables
+
+
+def decode(stream_bytes):
+    """ Yields the schema variables and a dictionary of the values of each values frame """
+    variables = None
+    pos = 0
+    while pos + FRAME_HDR_SIZE <= len(stream_bytes):
+        frame_type, length = struct.unpack_from('<BI', stream_bytes, pos)
+        payload = stream_bytes[pos + FRAME_HDR_SIZE:pos + FRAME_HDR_SIZE + length]
+        pos += FRAME_HDR_SIZE + length
+        if len(payload) != length:
+            print('Truncated frame at the end of the stream', file=sys.stderr)
+            break
+
+        if frame_type == SCHEMA_FRAME:
+            variables = parse_schema(payload)
+        elif frame_type == VALUES_FRAME and variables is not None:
+            if length != sum(v.size for v in variables):
+                print('Skipping values frame that does not match the schema', file=sys.stderr)
+                continue
+            values = []
+            offset = 0
+            for v in variables:
+                values.append((v.name, v.decode(payload[offset:offset + v.size])))
+                offset += v.size
+            yield variables, values
+
+
+def write_csv(stream_bytes, out):
+    writer = csv.writer(out, lineterminator='\n')
+    header = None
+    for variables, values in decode(stream_bytes):
+        names = [v.name for v in variables]
+        if names != header:
+            header = names
+            writer.writerow(names)
+        writer.writerow([';'.join(str(x) for x in value) if isinstance(value, list) else value
+                         for _, value in values])
+
+
+def write_json(stream_bytes, out):
+    frames = [dict(values) for _, values in decode(stream_bytes)]
+    json.dump(frames, out, indent=1, sort_keys=True)
+    out.write('\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Binary telemetry stream decoder')
+    parser.add_argument('stream', help='Binary telemetry stream file')
+    parser.add_argument('-f', '--format', choices=['csv', 'json'], default='csv', help='Output format')
+    args = parser.parse_args()
+
+    with open(args.stream, 'rb') as f:
+        stream_bytes = f.read()
+
+    if args.format == 'csv':
+        write_csv(stream_bytes, sys.stdout)
+    else:
+        write_json(stream_bytes, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()